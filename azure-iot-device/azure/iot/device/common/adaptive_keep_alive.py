@@ -0,0 +1,117 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+"""This module contains the logic for adapting the MQTT keep alive interval to the network.
+
+NATs and firewalls (cellular carrier NATs in particular) silently drop the mapping for a flow
+once it has been idle for some period, after which the connection is dead, even though neither
+end has closed it. Pinging more often than this keeps the mapping alive, but pinging much more
+often than necessary wastes battery and data on healthy links.
+
+AdaptiveKeepAlive probes for the longest interval that keeps the connection alive: it starts
+from a short interval, lengthens it while pings sent after an idle interval are answered, and
+shortens it again when a connection dies waiting for one, converging (by binary search) between the longest interval known to work and
+the shortest one known to fail.
+"""
+
+import logging
+import threading
+
+logger = logging.getLogger(__name__)
+
+# Shortest interval, in seconds, ever used. Shorter than the idle timeout of almost any NAT.
+MIN_INTERVAL = 30
+# Once the longest safe and shortest unsafe intervals are this close (in seconds), the interval is
+# considered settled, and is no longer probed
+RESOLUTION = 10
+
+
+class AdaptiveKeepAlive(object):
+    """Tracks the keep alive interval to use on a connection, between MIN_INTERVAL and a maximum.
+
+    Intervals are reported as having succeeded (the connection stayed alive while pinging at that
+    interval) or failed (the connection died while pinging at that interval). Reports are
+    thread-safe.
+    """
+
+    def __init__(self, max_interval):
+        """Initializer for AdaptiveKeepAlive
+
+        :param int max_interval: The longest interval, in seconds, to use. This should be the
+            keep alive sent to the broker when connecting.
+        """
+        self._max_interval = max_interval
+        self._min_interval = min(MIN_INTERVAL, max_interval)
+        self._lock = threading.Lock()
+        # Longest interval that has succeeded (or the minimum, which is assumed to)
+        self.safe_interval = self._min_interval
+        # Shortest interval that has failed, if any
+        self.unsafe_interval = None
+        self.interval = self._min_interval
+
+    @property
+    def settled(self):
+        """True if the interval is no longer being probed"""
+        with self._lock:
+            return self._is_settled()
+
+    def _is_settled(self):
+        if self.safe_interval >= self._max_interval:
+            return True
+        return (
+            self.unsafe_interval is not None
+            and self.unsafe_interval - self.safe_interval <= RESOLUTION
+        )
+
+    def on_interval_succeeded(self, interval):
+        """Report that the connection stayed alive while pinging at the given interval.
+
+        :returns: The interval to use from now on.
+        """
+        with self._lock:
+            if interval > self.safe_interval:
+                self.safe_interval = interval
+            if self.unsafe_interval is not None and self.unsafe_interval <= self.safe_interval:
+                # The network has changed since that interval failed
+                self.unsafe_interval = None
+            if self._is_settled():
+                self.interval = self.safe_interval
+            elif self.unsafe_interval is None:
+                self.interval = min(self.safe_interval * 2, self._max_interval)
+            else:
+                self.interval = (self.safe_interval + self.unsafe_interval) // 2
+            logger.debug(
+                "Keep alive interval %s succeeded. Using %s (safe=%s unsafe=%s)",
+                interval,
+                self.interval,
+                self.safe_interval,
+                self.unsafe_interval,
+            )
+            return self.interval
+
+    def on_interval_failed(self, interval):
+        """Report that the connection died while pinging at the given interval.
+
+        :returns: The interval to use from now on.
+        """
+        with self._lock:
+            if self.unsafe_interval is None or interval < self.unsafe_interval:
+                self.unsafe_interval = interval
+            if self.safe_interval >= self.unsafe_interval:
+                # An interval that used to work no longer does, so the network has changed.
+                # Start probing again from a shorter interval.
+                self.safe_interval = max(self._min_interval, self.unsafe_interval // 2)
+                if self.safe_interval >= self.unsafe_interval:
+                    # Even the minimum failed, which is most likely not down to the NAT
+                    self.unsafe_interval = None
+            self.interval = self.safe_interval
+            logger.info(
+                "Keep alive interval %s failed. Using %s (safe=%s unsafe=%s)",
+                interval,
+                self.interval,
+                self.safe_interval,
+                self.unsafe_interval,
+            )
+            return self.interval
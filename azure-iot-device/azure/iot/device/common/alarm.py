@@ -4,31 +4,169 @@
 # license information.
 # --------------------------------------------------------------------------
 from threading import Thread, Event
+import heapq
+import itertools
+import logging
+import threading
 import time
+from azure.iot.device.common import handle_exceptions
 
+logger = logging.getLogger(__name__)
 
-class Alarm(Thread):
-    """Call a function at a specified time"""
+# The longest time, in seconds, the scheduler thread sleeps before checking the time again
+MAX_SLEEP_INTERVAL = 1.0
 
-    def __init__(self, alarm_time, function, args=None, kwargs=None):
-        Thread.__init__(self)
+
+class ScheduledAlarm(object):
+    """An alarm scheduled on an AlarmScheduler"""
+
+    def __init__(self, scheduler, alarm_time, function, args, kwargs):
+        self._scheduler = scheduler
         self.alarm_time = alarm_time
         self.function = function
-        self.args = args if args is not None else []
-        self.kwargs = kwargs if kwargs is not None else {}
+        self.args = args
+        self.kwargs = kwargs
         self.finished = Event()
 
     def cancel(self):
         """Stop the alarm if it hasn't finished yet."""
-        self.finished.set()
+        self._scheduler._cancel(self)
+
+
+class AlarmScheduler(object):
+    """Call functions at specified (wall clock) times, all from a single thread.
+
+    The thread sleeps until the earliest alarm time, or is woken early when an alarm is scheduled
+    or cancelled. The sleep is measured on a clock which does not follow changes to the system
+    time, so it is capped at MAX_SLEEP_INTERVAL seconds, after which the (wall clock) time is
+    checked again. That way alarms still fire on time after the system time jumps forward, or the
+    system is suspended and resumed.
+
+    The functions are called on the scheduler's thread, one at a time, so they should not block.
+    """
 
-    def run(self):
-        """Method representing the thread's activity.
-        Overrides the method inherited from Thread.
-        Will invoke the Alarm's given function at the given alarm time.
+    def __init__(self, name="alarm-scheduler"):
+        self._name = name
+        self._heap = []
+        self._counter = itertools.count()
+        self._cancelled_count = 0
+        self._cv = threading.Condition()
+        self._thread = None
+        self._stopped = False
+
+    @property
+    def pending_count(self):
+        """The number of alarms that have not yet fired or been cancelled"""
+        with self._cv:
+            return len(self._heap) - self._cancelled_count
+
+    def schedule(self, alarm_time, function, args=None, kwargs=None):
+        """Call a function at a specified time.
+
+        :param float alarm_time: The time to call the function at (in seconds since the epoch).
+            If it is in the past, the function is called as soon as possible.
+        :param function: The function to call.
+        :param list args: Positional arguments for the function.
+        :param dict kwargs: Keyword arguments for the function.
+
+        :returns: A :class:`ScheduledAlarm`, which can be cancelled.
+        :raises: RuntimeError if the scheduler has been stopped.
         """
-        interval = self.alarm_time - time.time()
-        self.finished.wait(interval)
-        if not self.finished.is_set():
-            self.function(*self.args, **self.kwargs)
-        self.finished.set()
+        scheduled_alarm = ScheduledAlarm(
+            self,
+            alarm_time,
+            function,
+            args if args is not None else [],
+            kwargs if kwargs is not None else {},
+        )
+        with self._cv:
+            if self._stopped:
+                raise RuntimeError("AlarmScheduler has been stopped")
+            heapq.heappush(self._heap, (alarm_time, next(self._counter), scheduled_alarm))
+            if self._thread is None:
+                self._thread = Thread(target=self._run, name=self._name)
+                self._thread.daemon = True
+                self._thread.start()
+            # Wake the thread, in case this alarm is due before the one it is waiting for
+            self._cv.notify()
+        return scheduled_alarm
+
+    def stop(self):
+        """Stop the scheduler thread. Pending alarms will not fire."""
+        with self._cv:
+            self._stopped = True
+            self._cv.notify()
+            thread = self._thread
+        if thread and thread is not threading.current_thread():
+            thread.join()
+
+    def _cancel(self, scheduled_alarm):
+        with self._cv:
+            if scheduled_alarm.finished.is_set():
+                return
+            scheduled_alarm.finished.set()
+            # Drop the references held by the alarm, since it may stay in the heap until it is due
+            scheduled_alarm.function = None
+            scheduled_alarm.args = None
+            scheduled_alarm.kwargs = None
+            self._cancelled_count += 1
+            # Cancelled alarms are left in the heap until they are due, unless they make up most
+            # of it, so that cancelling is cheap but they don't accumulate
+            if self._cancelled_count > len(self._heap) // 2:
+                self._heap = [entry for entry in self._heap if not entry[2].finished.is_set()]
+                heapq.heapify(self._heap)
+                self._cancelled_count = 0
+            # Wake the thread, in case it is waiting for this alarm, so that it waits for the
+            # next one instead
+            self._cv.notify()
+
+    def _pop_due_alarm(self):
+        """Wait for the next alarm to be due, and return it, or None once stopped"""
+        with self._cv:
+            while not self._stopped:
+                if not self._heap:
+                    self._cv.wait()
+                    continue
+                alarm_time, _, scheduled_alarm = self._heap[0]
+                if scheduled_alarm.finished.is_set():
+                    heapq.heappop(self._heap)
+                    self._cancelled_count -= 1
+                    continue
+                interval = alarm_time - time.time()
+                if interval <= 0:
+                    heapq.heappop(self._heap)
+                    scheduled_alarm.finished.set()
+                    return scheduled_alarm
+                self._cv.wait(min(interval, MAX_SLEEP_INTERVAL))
+            return None
+
+    def _run(self):
+        while True:
+            scheduled_alarm = self._pop_due_alarm()
+            if scheduled_alarm is None:
+                return
+            try:
+                scheduled_alarm.function(*scheduled_alarm.args, **scheduled_alarm.kwargs)
+            except Exception as e:
+                logger.error("Unhandled exception in alarm function")
+                handle_exceptions.handle_background_exception(e)
+
+
+_default_scheduler = None
+_default_scheduler_lock = threading.Lock()
+
+
+def _get_default_scheduler():
+    global _default_scheduler
+    with _default_scheduler_lock:
+        if _default_scheduler is None:
+            _default_scheduler = AlarmScheduler()
+        return _default_scheduler
+
+
+def schedule(alarm_time, function, args=None, kwargs=None):
+    """Call a function at a specified time, on the alarm thread shared by the whole process.
+
+    See :meth:`AlarmScheduler.schedule`
+    """
+    return _get_default_scheduler().schedule(alarm_time, function, args=args, kwargs=kwargs)
@@ -8,6 +8,7 @@
 import base64
 import hmac
 import hashlib
+import threading
 import time
 import six.moves.urllib as urllib
 from azure.iot.device.common.chainable_exception import ChainableException
@@ -50,6 +51,9 @@ class RenewableSasToken(object):
         self._key_name = key_name
         self._expiry_time = None  # This will be overwritten by the .refresh() call below
         self._token = None  # This will be overwritten by the .refresh() call below
+        # (expiry time, token) built ahead of time by .prepare_refresh(), if any
+        self._prepared = None
+        self._prepared_lock = threading.Lock()
 
         self.ttl = ttl
         self.refresh()
@@ -60,17 +64,41 @@ class RenewableSasToken(object):
     def refresh(self):
         """
         Refresh the SasToken lifespan, giving it a new expiry time, and generating a new token.
+
+        If a token was built ahead of time by .prepare_refresh(), it is used instead of signing
+        a new one, as long as at least half of its lifespan remains.
+        """
+        with self._prepared_lock:
+            prepared, self._prepared = self._prepared, None
+        if prepared and prepared[0] - time.time() >= self.ttl / 2:
+            self._expiry_time, self._token = prepared
+        else:
+            expiry_time = int(time.time() + self.ttl)
+            self._token = self._build_token(expiry_time)
+            self._expiry_time = expiry_time
+
+    def prepare_refresh(self):
         """
-        self._expiry_time = int(time.time() + self.ttl)
-        self._token = self._build_token()
+        Build and sign the token for the next .refresh() ahead of time, so that the refresh
+        itself does not have to wait for the signing mechanism (which may make a network
+        request). The prepared token's lifespan starts when it is prepared.
 
-    def _build_token(self):
+        :raises: SasTokenError if an error occurs building the token
+        """
+        expiry_time = int(time.time() + self.ttl)
+        token = self._build_token(expiry_time)
+        with self._prepared_lock:
+            self._prepared = (expiry_time, token)
+
+    def _build_token(self, expiry_time):
         """Buid SasToken representation
 
+        :param int expiry_time: The expiry time for the token (in UTC, since epoch)
+
         :returns: String representation of the token
         """
         url_encoded_uri = urllib.parse.quote(self._uri, safe="")
-        message = url_encoded_uri + "\n" + str(self.expiry_time)
+        message = url_encoded_uri + "\n" + str(expiry_time)
         try:
             signature = self._signing_mechanism.sign(message)
         except Exception as e:
@@ -82,14 +110,14 @@ class RenewableSasToken(object):
             token = self._auth_rule_token_format.format(
                 resource=url_encoded_uri,
                 signature=url_encoded_signature,
-                expiry=str(self.expiry_time),
+                expiry=str(expiry_time),
                 keyname=self._key_name,
             )
         else:
             token = self._simple_token_format.format(
                 resource=url_encoded_uri,
                 signature=url_encoded_signature,
-                expiry=str(self.expiry_time),
+                expiry=str(expiry_time),
             )
         return token
 
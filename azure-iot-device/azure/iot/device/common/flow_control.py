@@ -0,0 +1,156 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+"""This module contains the accounting used to apply flow control to the operations sent by a
+client.
+
+While the connection is down, operations are held in the pipeline (by the ReconnectStage and the
+RetryStage, and by the transport until they are acknowledged) for as long as it takes to
+reconnect. An application which keeps sending during an outage would keep adding to them without
+limit. FlowControl tracks how much is pending, so that the application can wait for capacity
+instead.
+"""
+
+import logging
+import threading
+import time
+from azure.iot.device.common import handle_exceptions
+
+logger = logging.getLogger(__name__)
+
+
+class FlowControl(object):
+    """Tracks the operations and bytes pending in a pipeline, against a pair of watermarks.
+
+    Once the pending bytes go above the high watermark, there is no capacity until they have
+    dropped to the low watermark again. Without a high watermark there is always capacity.
+    All methods are thread-safe.
+    """
+
+    def __init__(self, high_watermark=None, low_watermark=None):
+        """Initializer for FlowControl
+
+        :param int high_watermark: Number of pending bytes above which there is no capacity.
+            If not provided, there is no limit.
+        :param int low_watermark: Number of pending bytes at or below which there is capacity
+            again. Defaults to half of the high watermark.
+        """
+        if high_watermark is not None and low_watermark is None:
+            low_watermark = high_watermark // 2
+        self.high_watermark = high_watermark
+        self.low_watermark = low_watermark
+        self._condition = threading.Condition()
+        self._pending_ops = 0
+        self._pending_bytes = 0
+        self._full = False
+        self._capacity_callbacks = []
+
+    @property
+    def pending_ops(self):
+        """Number of operations which have been started, but have not yet completed"""
+        return self._pending_ops
+
+    @property
+    def pending_bytes(self):
+        """Number of bytes in the operations which have been started, but not yet completed"""
+        return self._pending_bytes
+
+    @property
+    def has_capacity(self):
+        """False from when the pending bytes go above the high watermark, until they drop to the
+        low watermark"""
+        return not self._full
+
+    def add(self, size=0):
+        """Account for an operation which has been started.
+
+        :param int size: The number of bytes in the operation
+        """
+        with self._condition:
+            self._pending_ops += 1
+            self._pending_bytes += size
+            if (
+                not self._full
+                and self.high_watermark is not None
+                and self._pending_bytes > self.high_watermark
+            ):
+                logger.info(
+                    "Pending bytes (%s) above high watermark (%s). No capacity.",
+                    self._pending_bytes,
+                    self.high_watermark,
+                )
+                self._full = True
+
+    def remove(self, size=0):
+        """Account for an operation which has completed, whether successfully or not.
+
+        :param int size: The number of bytes in the operation, as passed to add()
+        """
+        with self._condition:
+            self._pending_ops -= 1
+            self._pending_bytes -= size
+            if not self._full or self._pending_bytes > self.low_watermark:
+                return
+            logger.info(
+                "Pending bytes (%s) at or below low watermark (%s). Capacity available.",
+                self._pending_bytes,
+                self.low_watermark,
+            )
+            self._full = False
+            self._condition.notify_all()
+            callbacks = self._capacity_callbacks
+            self._capacity_callbacks = []
+        # A failing callback must not stop the others, nor the completion of the operation
+        for callback in callbacks:
+            try:
+                callback()
+            except Exception as e:
+                logger.error("Unhandled exception in capacity callback")
+                handle_exceptions.handle_background_exception(e)
+
+    def wait_for_capacity(self, timeout=None):
+        """Block until there is capacity.
+
+        :param float timeout: Maximum number of seconds to wait. If not provided, waits
+            indefinitely.
+
+        :returns: True if there is capacity, False if the timeout expired first.
+        """
+        with self._condition:
+            if timeout is None:
+                while self._full:
+                    self._condition.wait()
+            else:
+                deadline = time.time() + timeout
+                while self._full:
+                    remaining = deadline - time.time()
+                    if remaining <= 0:
+                        return False
+                    self._condition.wait(remaining)
+            return True
+
+    def on_capacity(self, callback):
+        """Call the given callback, with no arguments, once there is capacity.
+
+        If there is capacity already, the callback is called immediately. Otherwise it is called
+        on the thread which completes the operation that frees up the capacity.
+        """
+        with self._condition:
+            if self._full:
+                self._capacity_callbacks.append(callback)
+                return
+        callback()
+
+    def remove_capacity_callback(self, callback):
+        """Remove a callback passed to on_capacity(), if it has not been called yet.
+
+        This must be used once the callback is no longer wanted (e.g. the wait it was for has been
+        cancelled), so that callbacks don't accumulate while there is no capacity.
+        """
+        with self._condition:
+            try:
+                self._capacity_callbacks.remove(callback)
+            except ValueError:
+                pass
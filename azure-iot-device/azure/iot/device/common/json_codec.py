@@ -0,0 +1,158 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+"""This module contains the JSON codec used for twin, method and provisioning payloads.
+
+The pipeline encodes and decodes all of these payloads with encode() and decode() from this
+module, so the implementation can be replaced in one place. Payloads are bytes on both sides,
+which is what is sent and received on the wire, so a codec that works on bytes natively does not
+have to go through an intermediate str.
+
+If the orjson package is installed, it is used by default. Otherwise, the json module from the
+standard library is used. A different codec can be set with set_codec(), e.g.
+
+    json_codec.set_codec(json_codec.StandardJsonCodec())
+
+A codec is any object with the encode() and decode() methods of StandardJsonCodec.
+"""
+
+import json
+import logging
+import math
+import threading
+import six
+
+try:
+    import orjson
+except ImportError:
+    orjson = None
+
+logger = logging.getLogger(__name__)
+
+
+class StandardJsonCodec(object):
+    """JSON codec using the json module from the standard library"""
+
+    name = "json"
+
+    def encode(self, obj, default=None, sort_keys=False):
+        """Encode an object as JSON.
+
+        :param obj: The object to encode.
+        :param default: A function returning a serializable version of an object which can not
+            otherwise be serialized (optional).
+        :param bool sort_keys: Sort the keys of dictionaries in the output.
+
+        :returns: The UTF-8 encoded JSON.
+        :rtype: bytes
+        :raises: TypeError if the object can not be serialized.
+        """
+        return json.dumps(obj, default=default, sort_keys=sort_keys).encode("utf-8")
+
+    def decode(self, data):
+        """Decode JSON.
+
+        :param data: The JSON to decode.
+        :type data: bytes, bytearray or str. bytes are decoded as UTF-8.
+
+        :returns: The decoded object.
+        :raises: ValueError if the data is not valid JSON.
+        """
+        if isinstance(data, (bytes, bytearray)):
+            data = data.decode("utf-8")
+        return json.loads(data)
+
+
+def _may_contain_non_finite_float(obj):
+    """Return True if the object contains a float which is NaN or infinite, or an object which
+    is only encoded by the default function, and so could be converted to one"""
+    pending = [obj]
+    while pending:
+        value = pending.pop()
+        if isinstance(value, float):
+            if math.isnan(value) or math.isinf(value):
+                return True
+        elif isinstance(value, dict):
+            pending.extend(value.keys())
+            pending.extend(value.values())
+        elif isinstance(value, (list, tuple)):
+            pending.extend(value)
+        elif not (value is None or isinstance(value, (six.string_types, six.integer_types))):
+            return True
+    return False
+
+
+class OrjsonCodec(object):
+    """JSON codec using the orjson package, which encodes to and decodes from bytes directly.
+
+    orjson is stricter than the json module (e.g. it does not accept integers over 64 bits, and
+    does not decode NaN), so anything it rejects is passed on to the json module, to give the same
+    results for any payload the json module can handle.
+
+    orjson encodes NaN and infinity as null rather than rejecting them, which in a twin patch
+    would delete the property. Payloads containing them are encoded with the json module instead.
+    Since only a payload with null in it can be affected, others are not checked.
+    """
+
+    name = "orjson"
+
+    def __init__(self):
+        if orjson is None:
+            raise ImportError("The orjson package is not installed")
+        self._fallback = StandardJsonCodec()
+
+    def encode(self, obj, default=None, sort_keys=False):
+        option = orjson.OPT_NON_STR_KEYS
+        if sort_keys:
+            option |= orjson.OPT_SORT_KEYS
+        try:
+            data = orjson.dumps(obj, default=default, option=option)
+        except TypeError:
+            return self._fallback.encode(obj, default=default, sort_keys=sort_keys)
+        if b"null" in data and _may_contain_non_finite_float(obj):
+            return self._fallback.encode(obj, default=default, sort_keys=sort_keys)
+        return data
+
+    def decode(self, data):
+        try:
+            return orjson.loads(data)
+        except ValueError:
+            return self._fallback.decode(data)
+
+
+def _create_default_codec():
+    if orjson is not None:
+        return OrjsonCodec()
+    return StandardJsonCodec()
+
+
+_codec = _create_default_codec()
+_lock = threading.Lock()
+
+
+def get_codec():
+    """Return the codec in use"""
+    return _codec
+
+
+def set_codec(codec):
+    """Set the codec used for all payloads in the process.
+
+    :param codec: The codec to use, or None to go back to the default codec.
+    """
+    global _codec
+    with _lock:
+        _codec = codec if codec is not None else _create_default_codec()
+    logger.debug("Using the %s JSON codec", getattr(_codec, "name", type(_codec).__name__))
+
+
+def encode(obj, default=None, sort_keys=False):
+    """Encode an object as JSON bytes, with the codec in use"""
+    return _codec.encode(obj, default=default, sort_keys=sort_keys)
+
+
+def decode(data):
+    """Decode JSON bytes (or str), with the codec in use"""
+    return _codec.decode(data)
@@ -0,0 +1,224 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+"""This module contains a network loop which drives the connections of many Paho clients from a
+single thread.
+
+By default each MQTTTransport starts a Paho loop thread for its connection. When hosting many
+identities in one process, this means one OS thread per identity, most of which are idle. An
+MQTTNetworkLoop instead waits on the sockets of all of its clients at once, and calls the Paho
+client's loop_read(), loop_write() and loop_misc() methods when there is work to do. Only this
+public "external loop" API of Paho is used.
+"""
+
+import collections
+import logging
+import socket
+import threading
+import time
+import traceback
+
+try:
+    import selectors
+except ImportError:
+    # Python 2.7
+    selectors = None
+
+logger = logging.getLogger(__name__)
+
+# How often loop_misc() is called on every client, to handle keep alive pings and timeouts
+MISC_INTERVAL = 1
+
+
+class MQTTNetworkLoop(object):
+    """Drives the network traffic of many Paho clients from a single thread.
+
+    Clients are added after they have connected, and removed when they disconnect.  All
+    changes to the set of clients are made on the loop thread.  Other threads queue them and
+    wake the loop.
+    """
+
+    def __init__(self, name="mqtt-network-loop"):
+        if selectors is None:
+            raise NotImplementedError("MQTTNetworkLoop requires Python 3")
+        self.name = name
+        self._selector = selectors.DefaultSelector()
+        # Maps Paho client -> the socket registered for it (or None)
+        self._clients = {}
+        self._requests = collections.deque()
+        self._lock = threading.Lock()
+        self._wakeup_pending = False
+        self._wakeup_r, self._wakeup_w = socket.socketpair()
+        self._wakeup_r.setblocking(False)
+        self._selector.register(self._wakeup_r, selectors.EVENT_READ, None)
+        self._running = True
+        self._thread = threading.Thread(target=self._run, name=name)
+        self._thread.daemon = True
+        self._thread.start()
+
+    @property
+    def client_count(self):
+        return len(self._clients)
+
+    def add_client(self, client):
+        """Start driving the network traffic of a connected Paho client.
+
+        :param client: The Paho client.  It must already be connected.
+        """
+        if hasattr(client, "on_socket_register_write"):
+            # Paho >= 1.5.1 tells us when it has data to write, so we don't have to wait for
+            # the next call to loop_misc() to notice
+            client.on_socket_register_write = self._on_socket_register_write
+        self._queue_request(self._add_client, client, wait=False)
+
+    def remove_client(self, client):
+        """Stop driving the network traffic of a Paho client.
+
+        When called from any thread other than the loop thread, this blocks until the client
+        has been removed, so the loop is guaranteed to no longer be using the client when it
+        returns.
+
+        :param client: The Paho client.  Removing a client that was never added does nothing.
+        """
+        if hasattr(client, "on_socket_register_write"):
+            client.on_socket_register_write = None
+        self._queue_request(self._remove_client, client, wait=True)
+
+    def stop(self):
+        """Stop the loop thread.  Clients which are still connected are no longer serviced."""
+        self._running = False
+        self._wakeup()
+        if threading.current_thread() is not self._thread:
+            self._thread.join()
+
+    def _on_socket_register_write(self, client, userdata, sock):
+        self._queue_request(self._update_client, client, wait=False)
+
+    def _queue_request(self, fn, client, wait):
+        if threading.current_thread() is self._thread:
+            fn(client)
+            return
+        done = threading.Event() if wait else None
+        with self._lock:
+            self._requests.append((fn, client, done))
+        self._wakeup()
+        if done:
+            while self._thread.is_alive() and not done.wait(1):
+                pass
+
+    def _wakeup(self):
+        with self._lock:
+            if self._wakeup_pending:
+                return
+            self._wakeup_pending = True
+        try:
+            self._wakeup_w.send(b"x")
+        except socket.error:
+            pass
+
+    def _run_requests(self):
+        try:
+            self._wakeup_r.recv(4096)
+        except socket.error:
+            pass
+        with self._lock:
+            self._wakeup_pending = False
+            requests = list(self._requests)
+            self._requests.clear()
+        for fn, client, done in requests:
+            try:
+                fn(client)
+            finally:
+                if done:
+                    done.set()
+
+    def _add_client(self, client):
+        if client not in self._clients:
+            self._clients[client] = None
+        self._update_client(client)
+
+    def _remove_client(self, client):
+        if client in self._clients:
+            self._unregister(client)
+            del self._clients[client]
+
+    def _unregister(self, client):
+        sock = self._clients.get(client)
+        if sock is not None:
+            try:
+                self._selector.unregister(sock)
+            except (KeyError, ValueError):
+                pass
+            self._clients[client] = None
+
+    def _update_client(self, client):
+        """Make the registration of the client's socket match the client's current state"""
+        if client not in self._clients:
+            return
+        sock = client.socket()
+        if sock is None:
+            # Paho closes the socket when the connection is lost or disconnected.  Don't keep
+            # track of the client any more, a new connection will add it again.
+            self._remove_client(client)
+            return
+        events = selectors.EVENT_READ
+        if client.want_write():
+            events |= selectors.EVENT_WRITE
+        registered = self._clients[client]
+        if registered is not sock:
+            self._unregister(client)
+            self._selector.register(sock, events, client)
+            self._clients[client] = sock
+        elif self._selector.get_key(sock).events != events:
+            self._selector.modify(sock, events, client)
+
+    def _service_client(self, client, mask):
+        sock = self._clients[client]
+        if mask & selectors.EVENT_READ:
+            rc = client.loop_read()
+            # Data which has already been decrypted by the SSL layer doesn't make the socket
+            # readable again, so keep reading while it is there.
+            while not rc and client.socket() is sock and _pending(sock):
+                rc = client.loop_read()
+        if mask & selectors.EVENT_WRITE and client.socket() is sock:
+            client.loop_write()
+        self._update_client(client)
+
+    def _service_misc(self):
+        for client in list(self._clients):
+            client.loop_misc()
+            self._update_client(client)
+
+    def _run(self):
+        logger.debug("%s: starting", self.name)
+        next_misc = time.time() + MISC_INTERVAL
+        while self._running:
+            timeout = max(0, next_misc - time.time())
+            for key, mask in self._selector.select(timeout):
+                if key.data is None:
+                    self._run_requests()
+                elif key.data in self._clients:
+                    try:
+                        self._service_client(key.data, mask)
+                    except Exception:
+                        logger.error("%s: Unexpected error servicing Paho client", self.name)
+                        logger.error(traceback.format_exc())
+                        self._remove_client(key.data)
+            if time.time() >= next_misc:
+                try:
+                    self._service_misc()
+                except Exception:
+                    logger.error("%s: Unexpected error in Paho loop_misc", self.name)
+                    logger.error(traceback.format_exc())
+                next_misc = time.time() + MISC_INTERVAL
+        self._run_requests()
+        logger.debug("%s: stopped", self.name)
+
+
+def _pending(sock):
+    try:
+        return sock.pending()
+    except AttributeError:
+        return 0
@@ -9,14 +9,31 @@ import logging
 import ssl
 import sys
 import threading
+import time
 import traceback
 import weakref
 import socket
 from . import transport_exceptions as exceptions
+from . import trace_buffer
+from . import ssl_context_cache
+from . import alarm
+from .adaptive_keep_alive import AdaptiveKeepAlive
 import socks
 
 logger = logging.getLogger(__name__)
 
+# Slack, in seconds, when comparing the time a connection was idle before a ping with the keep
+# alive interval. Paho pings once the connection has been idle for the interval, but it times
+# packets itself, slightly before they are reported to us.
+IDLE_PING_MARGIN = 1
+
+# Prefixes of the lines Paho logs for the packets it sends and receives. Paho reports pings only in
+# its log, so this is where they are tracked from for the adaptive keep alive.
+PAHO_LOG_PING_SENT = "Sending PINGREQ"
+PAHO_LOG_PING_RESPONSE = "Received PINGRESP"
+PAHO_LOG_SENT = "Sending "
+PAHO_LOG_RECEIVED = "Received "
+
 # Mapping of Paho CONNACK rc codes to Error object classes
 # Used for connection callbacks
 paho_connack_rc_to_error = {
@@ -98,6 +115,9 @@ class MQTTTransport(object):
         cipher=None,
         proxy_options=None,
         keep_alive=None,
+        network_loop=None,
+        adaptive_keep_alive=False,
+        ack_timeout=None,
     ):
         """
         Constructor to instantiate an MQTT protocol wrapper.
@@ -109,6 +129,13 @@ class MQTTTransport(object):
         :param bool websockets: Indicates whether or not to enable a websockets connection in the Transport.
         :param str cipher: Cipher string in OpenSSL cipher list format
         :param proxy_options: Options for sending traffic through proxy servers.
+        :param int keep_alive: Maximum period in seconds between communications with the broker.
+        :param network_loop: An MQTTNetworkLoop to drive the connection, shared with other
+            transports.  If not provided, the transport starts its own Paho loop thread.
+        :param bool adaptive_keep_alive: Ping the broker at the longest interval (up to keep_alive)
+            that keeps the connection alive through NATs and firewalls, rather than at keep_alive.
+        :param int ack_timeout: If operations are pending and none is acknowledged for this many
+            seconds, the connection is considered dead, and is dropped (optional).
         """
         self._client_id = client_id
         self._hostname = hostname
@@ -120,6 +147,24 @@ class MQTTTransport(object):
         self._cipher = cipher
         self._proxy_options = proxy_options
         self._keep_alive = keep_alive
+        self._network_loop = network_loop
+        if adaptive_keep_alive and keep_alive:
+            self._adaptive_keep_alive = AdaptiveKeepAlive(max_interval=keep_alive)
+        else:
+            self._adaptive_keep_alive = None
+        self._ack_timeout = ack_timeout
+
+        # State of the current connection, used for keep alive and dead connection detection
+        self._connection_lock = threading.Lock()
+        self._connected_time = None  # None while not connected
+        self._connection_keep_alive = None  # Keep alive sent to the broker for this connection
+        self._last_traffic_time = None  # Last packet sent or received, other than pings
+        self._idle_ping_time = None  # Outstanding ping sent after an idle keep alive interval
+        self._keep_alive_proven = False  # True once this connection's interval has succeeded
+        self._ack_check = None
+        # Set from when a connection is detected as dead until the next connect, so that the
+        # disconnect reported by Paho for it is reported as unacknowledged operations
+        self._dead_connection_detected = False
 
         self.on_mqtt_connected_handler = None
         self.on_mqtt_disconnected_handler = None
@@ -177,7 +222,8 @@ class MQTTTransport(object):
 
         def on_connect(client, userdata, flags, rc):
             this = self_weakref()
-            logger.info("connected with result code: {}".format(rc))
+            logger.info("connected with result code: %s", rc)
+            trace_buffer.record(trace_buffer.CONNECT, rc)
 
             if rc:  # i.e. if there is an error
                 if this.on_mqtt_connection_failure_handler:
@@ -192,23 +238,31 @@ class MQTTTransport(object):
                     logger.error(
                         "connection failed, but no on_mqtt_connection_failure_handler handler callback provided"
                     )
-            elif this.on_mqtt_connected_handler:
-                try:
-                    this.on_mqtt_connected_handler()
-                except Exception:
-                    logger.error("Unexpected error calling on_mqtt_connected_handler")
-                    logger.error(traceback.format_exc())
             else:
-                logger.error("No event handler callback set for on_mqtt_connected_handler")
+                this._on_connection_established()
+                if this.on_mqtt_connected_handler:
+                    try:
+                        this.on_mqtt_connected_handler()
+                    except Exception:
+                        logger.error("Unexpected error calling on_mqtt_connected_handler")
+                        logger.error(traceback.format_exc())
+                else:
+                    logger.error("No event handler callback set for on_mqtt_connected_handler")
 
         def on_disconnect(client, userdata, rc):
             this = self_weakref()
-            logger.info("disconnected with result code: {}".format(rc))
+            logger.info("disconnected with result code: %s", rc)
+            trace_buffer.record(trace_buffer.DISCONNECT, rc)
 
             cause = None
             if rc:  # i.e. if there is an error
-                logger.debug("".join(traceback.format_stack()))
-                cause = _create_error_from_rc_code(rc)
+                if logger.isEnabledFor(logging.DEBUG):
+                    logger.debug("".join(traceback.format_stack()))
+                trace_buffer.dump()
+                if this and this._dead_connection_detected:
+                    cause = exceptions.ConnectionDroppedError("Operations were not acknowledged")
+                else:
+                    cause = _create_error_from_rc_code(rc)
                 if this:
                     this._force_transport_disconnect_and_cleanup()
 
@@ -220,6 +274,7 @@ class MQTTTransport(object):
                 )
                 client.loop_stop()
             else:
+                this._on_connection_lost(dropped=bool(rc))
                 if this.on_mqtt_disconnected_handler:
                     try:
                         this.on_mqtt_disconnected_handler(cause)
@@ -231,28 +286,32 @@ class MQTTTransport(object):
 
         def on_subscribe(client, userdata, mid, granted_qos):
             this = self_weakref()
-            logger.info("suback received for {}".format(mid))
+            logger.info("suback received for %s", mid)
+            trace_buffer.record(trace_buffer.SUBACK, mid)
             # subscribe failures are returned from the subscribe() call.  This is just
             # a notification that a SUBACK was received, so there is no failure case here
             this._op_manager.complete_operation(mid)
 
         def on_unsubscribe(client, userdata, mid):
             this = self_weakref()
-            logger.info("UNSUBACK received for {}".format(mid))
+            logger.info("UNSUBACK received for %s", mid)
+            trace_buffer.record(trace_buffer.UNSUBACK, mid)
             # unsubscribe failures are returned from the unsubscribe() call.  This is just
             # a notification that a SUBACK was received, so there is no failure case here
             this._op_manager.complete_operation(mid)
 
         def on_publish(client, userdata, mid):
             this = self_weakref()
-            logger.info("payload published for {}".format(mid))
+            logger.info("payload published for %s", mid)
+            trace_buffer.record(trace_buffer.PUBACK, mid)
             # publish failures are returned from the publish() call.  This is just
             # a notification that a PUBACK was received, so there is no failure case here
             this._op_manager.complete_operation(mid)
 
         def on_message(client, userdata, mqtt_message):
             this = self_weakref()
-            logger.info("message received on {}".format(mqtt_message.topic))
+            logger.info("message received on %s", mqtt_message.topic)
+            trace_buffer.record(trace_buffer.MESSAGE_RECEIVED, mqtt_message.mid)
 
             if this.on_mqtt_message_received_handler:
                 try:
@@ -265,12 +324,25 @@ class MQTTTransport(object):
                     "No event handler callback set for on_mqtt_message_received_handler - DROPPING MESSAGE"
                 )
 
+        def on_log(client, userdata, level, buf):
+            this = self_weakref()
+            if not this:
+                return
+            if buf.startswith(PAHO_LOG_PING_SENT):
+                this._on_ping_sent()
+            elif buf.startswith(PAHO_LOG_PING_RESPONSE):
+                this._on_ping_response()
+            elif buf.startswith(PAHO_LOG_SENT) or buf.startswith(PAHO_LOG_RECEIVED):
+                this._on_traffic()
+
         mqtt_client.on_connect = on_connect
         mqtt_client.on_disconnect = on_disconnect
         mqtt_client.on_subscribe = on_subscribe
         mqtt_client.on_unsubscribe = on_unsubscribe
         mqtt_client.on_publish = on_publish
         mqtt_client.on_message = on_message
+        if self._adaptive_keep_alive:
+            mqtt_client.on_log = on_log
 
         # Set paho automatic-reconnect delay to 2 hours.  Ideally we would turn
         # paho auto-reconnect off entirely, but this is the best we can do.  Without
@@ -307,7 +379,7 @@ class MQTTTransport(object):
         # Paho is as clean as possible.  Our call to disconnect() above is enough to stop the
         # loop and exit the tread, but the call to loop_stop() is necessary to complete the cleanup.
 
-        self._mqtt_client.loop_stop()
+        self._stop_loop()
 
         # Finally, because of a bug in Paho, we need to null out the _thread pointer.  This
         # is necessary because the code that sets _thread to None only gets called if you
@@ -318,46 +390,177 @@ class MQTTTransport(object):
 
         logger.debug("Done forcing paho disconnect")
 
-    def _create_ssl_context(self):
-        """
-        This method creates the SSLContext object used by Paho to authenticate the connection.
-        """
-        logger.debug("creating a SSL context")
-        ssl_context = ssl.SSLContext(protocol=ssl.PROTOCOL_TLSv1_2)
+    def _start_loop(self):
+        if self._network_loop:
+            self._network_loop.add_client(self._mqtt_client)
+        else:
+            self._mqtt_client.loop_start()
 
-        if self._server_verification_cert:
-            logger.debug("configuring SSL context with custom server verification cert")
-            ssl_context.load_verify_locations(cadata=self._server_verification_cert)
+    def _stop_loop(self):
+        if self._network_loop:
+            self._network_loop.remove_client(self._mqtt_client)
         else:
-            logger.debug("configuring SSL context with default certs")
-            ssl_context.load_default_certs()
+            self._mqtt_client.loop_stop()
 
-        if self._cipher:
-            try:
-                logger.debug("configuring SSL context with cipher suites")
-                ssl_context.set_ciphers(self._cipher)
-            except ssl.SSLError as e:
-                # TODO: custom error with more detail?
-                raise e
-
-        if self._x509_cert is not None:
-            logger.debug("configuring SSL context with client-side certificate and key")
-            ssl_context.load_cert_chain(
-                self._x509_cert.certificate_file,
-                self._x509_cert.key_file,
-                self._x509_cert.pass_phrase,
+    def _current_keep_alive(self):
+        """Return the keep alive interval currently in use, if any"""
+        if self._adaptive_keep_alive:
+            return self._adaptive_keep_alive.interval
+        return self._keep_alive
+
+    def _on_connection_established(self):
+        """Start tracking a new connection, once it has been acknowledged by the broker"""
+        with self._connection_lock:
+            self._connected_time = time.time()
+            self._last_traffic_time = self._connected_time
+            self._idle_ping_time = None
+            self._keep_alive_proven = False
+        # Unacknowledged operations will be sent again, and timed from now
+        self._schedule_ack_check()
+
+    def _on_connection_lost(self, dropped):
+        """Stop tracking the current connection.
+
+        :param bool dropped: True if the connection was lost unexpectedly.
+        """
+        with self._connection_lock:
+            connected = self._connected_time is not None
+            idle_ping_time = self._idle_ping_time
+            self._connected_time = None
+            self._idle_ping_time = None
+            self._cancel_alarms()
+            # Only a connection that died waiting for the response to a ping sent after an idle
+            # interval shows that the interval is too long. Anything else isn't down to the NAT.
+            if dropped and connected and idle_ping_time is not None:
+                self._adaptive_keep_alive.on_interval_failed(self._connection_keep_alive)
+
+    def _cancel_alarms(self):
+        if self._ack_check:
+            self._ack_check.cancel()
+            self._ack_check = None
+
+    def _on_traffic(self):
+        """Record a packet, other than a ping, being sent or received"""
+        with self._connection_lock:
+            self._last_traffic_time = time.time()
+
+    def _on_ping_sent(self):
+        """Record a ping being sent, and whether the connection was idle for the keep alive
+        interval before it"""
+        with self._connection_lock:
+            if self._connected_time is None:
+                return
+            now = time.time()
+            idle_time = now - self._last_traffic_time
+            if idle_time + IDLE_PING_MARGIN >= self._connection_keep_alive:
+                self._idle_ping_time = now
+            else:
+                # Paho also pings when only one direction has been idle
+                self._idle_ping_time = None
+
+    def _on_ping_response(self):
+        """Report the keep alive interval as having succeeded, if the ping was sent after the
+        connection was idle for the interval"""
+        with self._connection_lock:
+            if self._connected_time is None or self._idle_ping_time is None:
+                return
+            self._idle_ping_time = None
+            if self._keep_alive_proven:
+                return
+            self._keep_alive_proven = True
+            # The next interval is probed on the next connection
+            self._adaptive_keep_alive.on_interval_succeeded(self._connection_keep_alive)
+
+    def _schedule_ack_check(self):
+        """Schedule a check that pending operations are still being acknowledged, if the
+        ack_timeout option is set, and there isn't a check scheduled already.
+
+        Paho only detects a dead connection from a missing PINGRESP, and doesn't ping while it is
+        sending, so without this, a connection that dies while publishing is only detected after
+        two keep alive intervals.
+        """
+        if not self._ack_timeout:
+            return
+        with self._connection_lock:
+            if self._ack_check or self._connected_time is None:
+                return
+            waiting_since = self._op_manager.get_waiting_since()
+            if waiting_since is None:
+                return
+            # Operations are sent again on reconnect, so they are only timed from the connection
+            deadline = max(waiting_since, self._connected_time) + self._ack_timeout
+            self_weakref = weakref.ref(self)
+
+            def on_ack_check():
+                this = self_weakref()
+                if this:
+                    this._check_acks()
+
+            self._ack_check = alarm.schedule(deadline, on_ack_check)
+
+    def _check_acks(self):
+        with self._connection_lock:
+            self._ack_check = None
+            if self._connected_time is None:
+                return
+            waiting_since = self._op_manager.get_waiting_since()
+            dead = (
+                waiting_since is not None
+                and time.time() - max(waiting_since, self._connected_time) >= self._ack_timeout
+            )
+        if dead:
+            logger.warning(
+                "No acknowledgement from the broker for %s seconds. Dropping connection",
+                self._ack_timeout,
             )
+            self._on_connection_lost(dropped=True)
+            self._dead_connection_detected = True
+            self._shutdown_socket()
+        else:
+            self._schedule_ack_check()
 
-        ssl_context.verify_mode = ssl.CERT_REQUIRED
-        ssl_context.check_hostname = True
+    def _shutdown_socket(self):
+        """Shut down the socket of a connection that has been detected as dead.
+
+        This doesn't block, unlike disconnecting, which waits for the Paho thread to stop, so it is
+        safe on the alarm thread. The thread running the connection then reads the end of the
+        stream, and Paho reports the disconnect from there, which cleans up as for any other
+        dropped connection.
+        """
+        sock = self._mqtt_client.socket()
+        if sock is None:
+            # Paho is already disconnected, and reports it itself
+            return
+        try:
+            # The socket may be wrapped (e.g. for TLS or websockets), so the underlying connection
+            # is shut down through a duplicate of its file descriptor
+            dup = socket.fromfd(sock.fileno(), socket.AF_INET, socket.SOCK_STREAM)
+            try:
+                dup.shutdown(socket.SHUT_RDWR)
+            finally:
+                dup.close()
+        except (socket.error, OSError, ValueError) as e:
+            logger.warning("Unable to shut down the dead connection: %s", e)
 
-        return ssl_context
+    def _create_ssl_context(self):
+        """
+        This method gets the SSLContext object used by Paho to authenticate the connection.
+        The context is shared with other transports using the same TLS settings.
+        """
+        return ssl_context_cache.get_ssl_context(
+            server_verification_cert=self._server_verification_cert,
+            cipher=self._cipher,
+            x509_cert=self._x509_cert,
+        )
 
     def shutdown(self):
         """Shut down the transport. This is (currently) irreversible."""
         # Remove the disconnect handler from Paho. We don't want to trigger any events in response
         # to the shutdown and confuse the higher level layers of code. Just end it.
         self._mqtt_client.on_disconnect = None
+        with self._connection_lock:
+            self._connected_time = None
+            self._cancel_alarms()
         # Now disconnect and do some additional cleanup.
         self._force_transport_disconnect_and_cleanup()
 
@@ -381,19 +584,25 @@ class MQTTTransport(object):
         """
         logger.debug("connecting to mqtt broker")
 
+        if self._network_loop:
+            # Make sure the network loop isn't still servicing a previous connection
+            self._network_loop.remove_client(self._mqtt_client)
+
         self._mqtt_client.username_pw_set(username=self._username, password=password)
+        self._dead_connection_detected = False
+
+        # Paho does not allow the keep alive to change once connected, so an adapted interval is
+        # applied from the next connection (e.g. the reauthorization when the SAS token is renewed)
+        keep_alive = self._current_keep_alive()
+        self._connection_keep_alive = keep_alive
 
         try:
             if self._websockets:
                 logger.info("Connect using port 443 (websockets)")
-                rc = self._mqtt_client.connect(
-                    host=self._hostname, port=443, keepalive=self._keep_alive
-                )
+                rc = self._mqtt_client.connect(host=self._hostname, port=443, keepalive=keep_alive)
             else:
                 logger.info("Connect using port 8883 (TCP)")
-                rc = self._mqtt_client.connect(
-                    host=self._hostname, port=8883, keepalive=self._keep_alive
-                )
+                rc = self._mqtt_client.connect(host=self._hostname, port=8883, keepalive=keep_alive)
         except socket.error as e:
             self._force_transport_disconnect_and_cleanup()
 
@@ -431,10 +640,10 @@ class MQTTTransport(object):
                 message="Unexpected Paho failure during connect", cause=e
             )
 
-        logger.debug("_mqtt_client.connect returned rc={}".format(rc))
+        logger.debug("_mqtt_client.connect returned rc=%s", rc)
         if rc:
             raise _create_error_from_rc_code(rc)
-        self._mqtt_client.loop_start()
+        self._start_loop()
 
     def disconnect(self, clear_pending=False):
         """
@@ -450,13 +659,13 @@ class MQTTTransport(object):
                 message="Unexpected Paho failure during disconnect", cause=e
             )
         finally:
-            self._mqtt_client.loop_stop()
+            self._stop_loop()
 
             if threading.current_thread() == self._mqtt_client._thread:
                 logger.debug("in paho thread.  nulling _thread")
                 self._mqtt_client._thread = None
 
-        logger.debug("_mqtt_client.disconnect returned rc={}".format(rc))
+        logger.debug("_mqtt_client.disconnect returned rc=%s", rc)
         if rc:
             # This could result in ConnectionDroppedError or ProtocolClientError
             # No matter what, we always raise here to give upper layers a chance to respond
@@ -486,7 +695,7 @@ class MQTTTransport(object):
         :raises: ConnectionDroppedError if connection is dropped during execution.
         :raises: ProtocolClientError if there is some other client error.
         """
-        logger.info("subscribing to {} with qos {}".format(topic, qos))
+        logger.info("subscribing to %s with qos %s", topic, qos)
         try:
             (rc, mid) = self._mqtt_client.subscribe(topic, qos=qos)
         except ValueError:
@@ -495,11 +704,13 @@ class MQTTTransport(object):
             raise exceptions.ProtocolClientError(
                 message="Unexpected Paho failure during subscribe", cause=e
             )
-        logger.debug("_mqtt_client.subscribe returned rc={}".format(rc))
+        logger.debug("_mqtt_client.subscribe returned rc=%s", rc)
+        trace_buffer.record(trace_buffer.SUBSCRIBE, mid)
         if rc:
             # This could result in ConnectionDroppedError or ProtocolClientError
             raise _create_error_from_rc_code(rc)
         self._op_manager.establish_operation(mid, callback)
+        self._schedule_ack_check()
 
     def unsubscribe(self, topic, callback=None):
         """
@@ -512,7 +723,7 @@ class MQTTTransport(object):
         :raises: ConnectionDroppedError if connection is dropped during execution.
         :raises: ProtocolClientError if there is some other client error.
         """
-        logger.info("unsubscribing from {}".format(topic))
+        logger.info("unsubscribing from %s", topic)
         try:
             (rc, mid) = self._mqtt_client.unsubscribe(topic)
         except ValueError:
@@ -521,11 +732,13 @@ class MQTTTransport(object):
             raise exceptions.ProtocolClientError(
                 message="Unexpected Paho failure during unsubscribe", cause=e
             )
-        logger.debug("_mqtt_client.unsubscribe returned rc={}".format(rc))
+        logger.debug("_mqtt_client.unsubscribe returned rc=%s", rc)
+        trace_buffer.record(trace_buffer.UNSUBSCRIBE, mid)
         if rc:
             # This could result in ConnectionDroppedError or ProtocolClientError
             raise _create_error_from_rc_code(rc)
         self._op_manager.establish_operation(mid, callback)
+        self._schedule_ack_check()
 
     def publish(self, topic, payload, qos=1, callback=None):
         """
@@ -545,7 +758,7 @@ class MQTTTransport(object):
         :raises: ConnectionDroppedError if connection is dropped during execution.
         :raises: ProtocolClientError if there is some other client error.
         """
-        logger.info("publishing on {}".format(topic))
+        logger.info("publishing on %s", topic)
         try:
             (rc, mid) = self._mqtt_client.publish(topic=topic, payload=payload, qos=qos)
         except ValueError:
@@ -556,11 +769,13 @@ class MQTTTransport(object):
             raise exceptions.ProtocolClientError(
                 message="Unexpected Paho failure during publish", cause=e
             )
-        logger.debug("_mqtt_client.publish returned rc={}".format(rc))
+        logger.debug("_mqtt_client.publish returned rc=%s", rc)
+        trace_buffer.record(trace_buffer.PUBLISH, mid)
         if rc:
             # This could result in ConnectionDroppedError or ProtocolClientError
             raise _create_error_from_rc_code(rc)
         self._op_manager.establish_operation(mid, callback)
+        self._schedule_ack_check()
 
 
 class OperationManager(object):
@@ -572,6 +787,9 @@ class OperationManager(object):
         # but the reponse has not yet been received
         self._pending_operation_callbacks = {}
 
+        # Time of the last acknowledgement, or of the first operation after there were none pending
+        self._waiting_since = None
+
         # Maps mid->mid for responses received that are NOT established in the _pending_operation_callbacks dict.
         # Necessary because sometimes an operation will complete with a response before the
         # Paho call returns.
@@ -600,15 +818,15 @@ class OperationManager(object):
 
             else:
                 # Store the operation as pending, along with callback
+                if not self._pending_operation_callbacks:
+                    self._waiting_since = time.time()
                 self._pending_operation_callbacks[mid] = callback
-                logger.debug("Waiting for response on MID: {}".format(mid))
+                logger.debug("Waiting for response on MID: %s", mid)
 
         # Now that the lock has been released, if the callback should be triggered,
         # go ahead and trigger it now.
         if trigger_callback:
-            logger.debug(
-                "Response for MID: {} was received early - triggering callback".format(mid)
-            )
+            logger.debug("Response for MID: %s was received early - triggering callback", mid)
             if callback:
                 try:
                     callback()
@@ -617,7 +835,7 @@ class OperationManager(object):
                     logger.error(traceback.format_exc())
             else:
                 # Not entirely unexpected becuase of QOS=1
-                logger.debug("No callback for MID: {}".format(mid))
+                logger.debug("No callback for MID: %s", mid)
 
     def complete_operation(self, mid):
         """Complete an operation identified by MID and trigger the associated completion callback.
@@ -629,6 +847,9 @@ class OperationManager(object):
         trigger_callback = False
 
         with self._lock:
+            # Any acknowledgement shows that the broker is still responding
+            self._waiting_since = time.time()
+
             # If the mid is associated with an established pending operation, trigger the associated callback
             if mid in self._pending_operation_callbacks:
 
@@ -641,7 +862,7 @@ class OperationManager(object):
 
             else:
                 # Otherwise, store the mid as an unknown response
-                logger.debug("Response received for unknown MID: {}".format(mid))
+                logger.debug("Response received for unknown MID: %s", mid)
                 self._unknown_operation_completions[
                     mid
                 ] = mid  # TODO: set something more useful here
@@ -649,9 +870,7 @@ class OperationManager(object):
         # Now that the lock has been released, if the callback should be triggered,
         # go ahead and trigger it now.
         if trigger_callback:
-            logger.debug(
-                "Response received for recognized MID: {} - triggering callback".format(mid)
-            )
+            logger.debug("Response received for recognized MID: %s - triggering callback", mid)
             if callback:
                 try:
                     callback()
@@ -660,7 +879,20 @@ class OperationManager(object):
                     logger.error(traceback.format_exc())
             else:
                 # fully expected.  QOS=1 means we might get 2 PUBACKs
-                logger.debug("No callback set for MID: {}".format(mid))
+                logger.debug("No callback set for MID: %s", mid)
+
+    def get_waiting_since(self):
+        """Return the time since which pending operations have been waiting without any
+        acknowledgement, or None if there are no pending operations.
+
+        This is the time of the last acknowledgement, rather than the time the oldest pending
+        operation was established, as Paho queues operations beyond its in-flight limit until
+        earlier ones are acknowledged.
+        """
+        with self._lock:
+            if not self._pending_operation_callbacks:
+                return None
+            return self._waiting_since
 
     def cancel_all_operations(self):
         """Complete all pending operations with cancellation, removing MID tracking"""
@@ -682,11 +914,11 @@ class OperationManager(object):
             mid = pending_op[0]
             callback = pending_op[1]
             if callback:
-                logger.debug("Cancelling {} - Triggering callback".format(mid))
+                logger.debug("Cancelling %s - Triggering callback", mid)
                 try:
                     callback(cancelled=True)
                 except Exception:
                     logger.error("Unexpected error calling callback for MID: {}".format(mid))
                     logger.error(traceback.format_exc())
             else:
-                logger.debug("Cancelling {} - No callback set for MID".format(mid))
+                logger.debug("Cancelling %s - No callback set for MID", mid)
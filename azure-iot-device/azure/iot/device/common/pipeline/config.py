@@ -33,6 +33,9 @@ class BasePipelineConfig(object):
         proxy_options=None,
         keep_alive=DEFAULT_KEEPALIVE,
         auto_connect=True,
+        network_loop=None,
+        adaptive_keep_alive=False,
+        ack_timeout=None,
     ):
         """Initializer for BasePipelineConfig
 
@@ -55,12 +58,22 @@ class BasePipelineConfig(object):
         :param int keepalive: Maximum period in seconds between communications with the
             broker.
         :param bool auto_connect: Indicates if automatic connects should occur
+        :param network_loop: A network loop shared with other clients, which drives the MQTT
+            connection instead of a dedicated thread.
+        :type network_loop: :class:`azure.iot.device.common.mqtt_network_loop.MQTTNetworkLoop`
+        :param bool adaptive_keep_alive: Indicates if the keep alive interval should adapt to the
+            network, using keep_alive as the maximum
+        :param int ack_timeout: Time in seconds after which the connection is considered dead if
+            operations are pending and none has been acknowledged. Disabled if not provided.
         """
         # Network
         self.hostname = hostname
         self.gateway_hostname = gateway_hostname
         self.keep_alive = self._validate_keep_alive(keep_alive)
         self.auto_connect = auto_connect
+        self.network_loop = network_loop
+        self.adaptive_keep_alive = adaptive_keep_alive
+        self.ack_timeout = ack_timeout
 
         # Auth
         self.sastoken = sastoken
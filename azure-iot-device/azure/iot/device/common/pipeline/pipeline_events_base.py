@@ -20,8 +20,13 @@ class PipelineEvent(object):
 
     :ivar name: The name of the event.  This is used primarily for logging
     :type name: str
+
+    As with PipelineOperation, only derived events that are created for every message define
+    __slots__.  Other derived events have a __dict__.
     """
 
+    __slots__ = ("name",)
+
     def __init__(self):
         """
         Initializer for PipelineEvent objects.
@@ -20,6 +20,12 @@ class OperationCancelled(PipelineException):
     pass
 
 
+class OperationTimeout(PipelineException):
+    """Operation did not complete before its deadline"""
+
+    pass
+
+
 class OperationError(PipelineException):
     """Error while executing an Operation"""
 
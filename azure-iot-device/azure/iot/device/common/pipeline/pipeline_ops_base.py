@@ -12,6 +12,14 @@ from azure.iot.device.common import handle_exceptions
 
 logger = logging.getLogger(__name__)
 
+# Priority classes for operations.  Stages that hold operations (e.g. while waiting for a
+# connection) release operations with a lower priority value first.  Operations with the same
+# priority are released in the order they were received.
+PRIORITY_CONTROL = 0
+PRIORITY_METHOD_RESPONSE = 1
+PRIORITY_TWIN = 2
+PRIORITY_TELEMETRY = 3
+
 
 class PipelineOperation(object):
     """
@@ -33,11 +41,33 @@ class PipelineOperation(object):
         requires a connection to operate.  This is currently used by the AutoConnectStage
         stage, but this functionality will be revamped shortly.
     :type needs_connection: Boolean
+    :ivar priority: The priority class of the operation (one of the PRIORITY_* values).  Stages
+        that hold operations release higher priority (lower value) operations first.
+    :type priority: int
+    :ivar deadline: The time (in seconds since the epoch) after which the operation should no
+        longer be run or retried, or None if it has no deadline.
+    :type deadline: float
     :ivar error: The presence of a value in the error attribute indicates that the operation failed,
         absence of this value indicates that the operation either succeeded or hasn't been handled yet.
     :type error: Error
+
+    The attributes common to all operations are stored in slots.  Derived operations that are
+    created for every message (e.g. telemetry) also define __slots__ so that they don't need a
+    __dict__.  Other derived operations don't, so attributes can still be added to them
+    dynamically.
     """
 
+    __slots__ = (
+        "name",
+        "callback_stack",
+        "needs_connection",
+        "priority",
+        "deadline",
+        "completed",
+        "completing",
+        "error",
+    )
+
     def __init__(self, callback):
         """
         Initializer for PipelineOperation objects.
@@ -53,6 +83,8 @@ class PipelineOperation(object):
         self.name = self.__class__.__name__
         self.callback_stack = []
         self.needs_connection = False
+        self.priority = PRIORITY_CONTROL
+        self.deadline = None
         self.completed = False  # Operation has been fully completed
         self.completing = False  # Operation is in the process of completing
         self.error = None  # Error associated with Operation completion
@@ -104,9 +136,9 @@ class PipelineOperation(object):
             the completion. Providing an error indicates that the operation was unsucessful.
         """
         if error:
-            logger.debug("{}: completing with error {}".format(self.name, error))
+            logger.debug("%s: completing with error %s", self.name, error)
         else:
-            logger.debug("{}: completing without error".format(self.name))
+            logger.debug("%s: completing without error", self.name)
 
         if self.completed or self.completing:
             e = pipeline_exceptions.OperationError(
@@ -122,7 +154,7 @@ class PipelineOperation(object):
 
             while self.callback_stack:
                 if not self.completing:
-                    logger.debug("{}: Completion halted!".format(self.name))
+                    logger.debug("%s: Completion halted!", self.name)
                     break
                 if self.completed:
                     # This block should never be reached - this is an invalid state.
@@ -139,9 +171,7 @@ class PipelineOperation(object):
                 try:
                     callback(op=self, error=error)
                 except Exception as e:
-                    logger.warning(
-                        "Unhandled error while triggering callback for {}".format(self.name)
-                    )
+                    logger.warning("Unhandled error while triggering callback for %s", self.name)
                     # This could happen in a foreground or background thread, so err on the side of caution
                     # and send it to the background handler.
                     handle_exceptions.handle_background_exception(e)
@@ -174,10 +204,36 @@ class PipelineOperation(object):
             )
             handle_exceptions.handle_background_exception(e)
         else:
-            logger.debug("{}: Halting completion...".format(self.name))
+            logger.debug("%s: Halting completion...", self.name)
             self.completing = False
             self.error = None
 
+    @pipeline_thread.runs_on_pipeline_thread
+    def abandon(self, callback, error):
+        """Trigger the callbacks added before the given callback with an error, in LIFO order, and
+        remove them from the operation, along with the given callback.
+
+        This lets a stage give up on an operation (e.g. when its deadline passes) while the stages
+        below it are still working on it.  Their callbacks stay on the operation, and run when
+        they complete it, so that their state (e.g. a connection lock) stays consistent.  The
+        operation is not completed until then.
+
+        :param callback: The callback that the abandoning stage added to the operation.
+        :param error: The Exception object to trigger the removed callbacks with.
+        """
+        logger.debug("%s: abandoning with error %s", self.name, error)
+        index = self.callback_stack.index(callback)
+        abandoned_callbacks = self.callback_stack[:index]
+        del self.callback_stack[: index + 1]
+
+        while abandoned_callbacks:
+            callback = abandoned_callbacks.pop()
+            try:
+                callback(op=self, error=error)
+            except Exception as e:
+                logger.warning("Unhandled error while triggering callback for %s", self.name)
+                handle_exceptions.handle_background_exception(e)
+
     @pipeline_thread.runs_on_pipeline_thread
     def spawn_worker_op(self, worker_op_type, **kwargs):
         """Create and return a new operation, which, when completed, will complete the operation
@@ -190,24 +246,30 @@ class PipelineOperation(object):
 
         :returns: A new worker operation of the type specified in the worker_op_type parameter.
         """
-        logger.debug("{}: creating worker op of type {}".format(self.name, worker_op_type.__name__))
-
-        @pipeline_thread.runs_on_pipeline_thread
-        def on_worker_op_complete(op, error):
-            logger.debug("{}: Worker op ({}) has been completed".format(self.name, op.name))
-            self.complete(error=error)
+        logger.debug("%s: creating worker op of type %s", self.name, worker_op_type.__name__)
 
         if "callback" in kwargs:
             provided_callback = kwargs["callback"]
-            kwargs["callback"] = on_worker_op_complete
+            kwargs["callback"] = self._on_worker_op_complete
             worker_op = worker_op_type(**kwargs)
             worker_op.add_callback(provided_callback)
         else:
-            kwargs["callback"] = on_worker_op_complete
+            kwargs["callback"] = self._on_worker_op_complete
             worker_op = worker_op_type(**kwargs)
 
+        # The worker op does the work of this op, so it gets the same priority and deadline
+        worker_op.priority = self.priority
+        worker_op.deadline = self.deadline
+
         return worker_op
 
+    @pipeline_thread.runs_on_pipeline_thread
+    def _on_worker_op_complete(self, op, error):
+        # Shared by all worker ops spawned from this op, rather than creating a new closure
+        # for each one.
+        logger.debug("%s: Worker op (%s) has been completed", self.name, op.name)
+        self.complete(error=error)
+
 
 class InitializePipelineOperation(PipelineOperation):
     """
@@ -370,6 +432,7 @@ class RequestAndResponseOperation(PipelineOperation):
             the specific operation which has completed or failed.
         """
         super(RequestAndResponseOperation, self).__init__(callback=callback)
+        self.priority = PRIORITY_TWIN
         self.request_type = request_type
         self.method = method
         self.resource_location = resource_location
@@ -417,6 +480,7 @@ class RequestOperation(PipelineOperation):
         Example is the id of the operation as returned by the initial provisioning request.
         """
         super(RequestOperation, self).__init__(callback=callback)
+        self.priority = PRIORITY_TWIN
         self.method = method
         self.resource_location = resource_location
         self.request_type = request_type
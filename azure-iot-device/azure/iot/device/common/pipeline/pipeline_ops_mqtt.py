@@ -3,7 +3,7 @@
 # Licensed under the MIT License. See License.txt in the project root for
 # license information.
 # --------------------------------------------------------------------------
-from . import PipelineOperation
+from . import PipelineOperation, pipeline_ops_base
 
 
 class MQTTPublishOperation(PipelineOperation):
@@ -13,6 +13,8 @@ class MQTTPublishOperation(PipelineOperation):
     This operation is in the group of MQTT operations because its attributes are very specific to the MQTT protocol.
     """
 
+    __slots__ = ("topic", "payload", "retry_timer")
+
     def __init__(self, topic, payload, callback):
         """
         Initializer for MQTTPublishOperation objects.
@@ -24,6 +26,7 @@ class MQTTPublishOperation(PipelineOperation):
           has completed or failed.
         """
         super(MQTTPublishOperation, self).__init__(callback=callback)
+        self.priority = pipeline_ops_base.PRIORITY_TELEMETRY
         self.topic = topic
         self.payload = payload
         self.needs_connection = True
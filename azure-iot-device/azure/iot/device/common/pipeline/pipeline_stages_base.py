@@ -6,11 +6,13 @@
 
 import logging
 import abc
+import heapq
+import itertools
+import random
 import six
 import sys
 import time
 import traceback
-import uuid
 import weakref
 import threading
 from six.moves import queue
@@ -97,8 +99,18 @@ class PipelineStage(object):
         thing you can assume is that the operation will _eventually_ complete successfully or fail, and the
         operation's callback will be called when that happens.
 
+        An operation whose deadline has passed is not run.  It is failed with OperationTimeout.
+
         :param PipelineOperation op: The operation to run.
         """
+        if op.deadline is not None and time.time() >= op.deadline:
+            logger.info("{}({}): Deadline passed. Failing".format(self.name, op.name))
+            op.complete(
+                error=pipeline_exceptions.OperationTimeout(
+                    "{} deadline passed before it could run".format(op.name)
+                )
+            )
+            return
         try:
             self._run_op(op)
         except Exception as e:
@@ -205,6 +217,11 @@ class PipelineRootStage(PipelineStage):
       events from the pipeline (such as C2D messages).  This function is called with
       a PipelineEvent object every time any such event occurs.
     :type on_pipeline_event_handler: Function
+    :ivar on_pipeline_event_batch_handler: Optional handler which can be set by users of the
+      pipeline to receive PipelineEvent objects in batches.  If set, it is called instead of
+      on_pipeline_event_handler, with a list of all the events which arrived since the callback
+      thread last delivered events, in the order they arrived.
+    :type on_pipeline_event_batch_handler: Function
     :ivar on_connected_handler: Handler which can be set by users of the pipeline to
       receive events every time the underlying transport connects
     :type on_connected_handler: Function
@@ -216,10 +233,15 @@ class PipelineRootStage(PipelineStage):
     def __init__(self, pipeline_configuration):
         super(PipelineRootStage, self).__init__()
         self.on_pipeline_event_handler = None
+        self.on_pipeline_event_batch_handler = None
         self.on_connected_handler = None
         self.on_disconnected_handler = None
         self.connected = False
         self.pipeline_configuration = pipeline_configuration
+        # Events waiting for the callback thread to deliver them. Events which arrive while a
+        # batch is waiting are added to it, rather than each waking up the callback thread.
+        self._event_batch = None
+        self._event_batch_lock = threading.Lock()
 
     def run_op(self, op):
         # CT-TODO: make this more elegant
@@ -256,30 +278,118 @@ class PipelineRootStage(PipelineStage):
           through the handle_pipeline_event (if provided).
         """
         if isinstance(event, pipeline_events_base.ConnectedEvent):
-            logger.debug(
-                "{}: ConnectedEvent received. Calling on_connected_handler".format(self.name)
-            )
+            logger.debug("%s: ConnectedEvent received. Calling on_connected_handler", self.name)
             self.connected = True
+            self._close_event_batch()
             if self.on_connected_handler:
                 pipeline_thread.invoke_on_callback_thread_nowait(self.on_connected_handler)()
 
         elif isinstance(event, pipeline_events_base.DisconnectedEvent):
             logger.debug(
-                "{}: DisconnectedEvent received. Calling on_disconnected_handler".format(self.name)
+                "%s: DisconnectedEvent received. Calling on_disconnected_handler", self.name
             )
             self.connected = False
+            self._close_event_batch()
             if self.on_disconnected_handler:
                 pipeline_thread.invoke_on_callback_thread_nowait(self.on_disconnected_handler)()
 
         else:
-            if self.on_pipeline_event_handler:
-                pipeline_thread.invoke_on_callback_thread_nowait(self.on_pipeline_event_handler)(
-                    event
-                )
+            if self.on_pipeline_event_handler or self.on_pipeline_event_batch_handler:
+                self._add_to_event_batch(event)
             else:
                 # unexpected condition: we should be handling all pipeline events
                 logger.error("incoming {} event with no handler.  dropping.".format(event.name))
 
+    @pipeline_thread.runs_on_pipeline_thread
+    def _add_to_event_batch(self, event):
+        """Add the event to the batch waiting for the callback thread, scheduling delivery of a
+        new batch if there is none waiting.
+        """
+        with self._event_batch_lock:
+            batch = self._event_batch
+            if batch is not None:
+                batch.append(event)
+                return
+            batch = self._event_batch = [event]
+        pipeline_thread.invoke_on_callback_thread_nowait(self._deliver_event_batch)(batch)
+
+    def _close_event_batch(self):
+        """Stop adding events to the waiting batch, so that events which arrive after this are not
+        delivered before callbacks which have already been scheduled (e.g. on_connected_handler)
+        """
+        with self._event_batch_lock:
+            self._event_batch = None
+
+    def _deliver_event_batch(self, batch):
+        """Deliver a batch of events to the handler(s). Runs on the callback thread."""
+        with self._event_batch_lock:
+            if self._event_batch is batch:
+                self._event_batch = None
+        logger.debug("%s: Delivering %d event(s)", self.name, len(batch))
+        if self.on_pipeline_event_batch_handler:
+            self.on_pipeline_event_batch_handler(batch)
+            return
+        handler = self.on_pipeline_event_handler
+        if not handler:
+            logger.error("%d incoming event(s) with no handler.  dropping.", len(batch))
+            return
+        for event in batch:
+            try:
+                handler(event)
+            except Exception as e:
+                # Don't let an error delivering one event prevent delivering the rest
+                handle_exceptions.handle_background_exception(e)
+
+
+class OpDeadlineStage(PipelineStage):
+    """
+    PipelineStage which fails operations that are still pending when their deadline passes.
+
+    The client sets an operation's deadline from the timeout passed to the API call, and any
+    worker operations spawned from it share the same deadline.  For each operation with a
+    deadline, this stage schedules an alarm.  If the operation has not completed when the alarm
+    goes off, wherever in the pipeline it is waiting (e.g. for a connection, or to be retried),
+    this stage fails it with an OperationTimeout error.
+
+    Nothing below this stage runs an operation after its deadline (see PipelineStage.run_op),
+    and RetryStage does not retry an operation past its deadline.  So an operation that has
+    timed out is not sent later.  The operation is abandoned rather than completed (see
+    PipelineOperation.abandon), so the stage that was holding it still completes it once,
+    when it is done with it.
+
+    This stage should come right after the root, so that the deadline covers all of the time the
+    operation spends in the pipeline.
+    """
+
+    def __init__(self):
+        super(OpDeadlineStage, self).__init__()
+        # Maps each pending operation that has a deadline to its deadline alarm
+        self.deadline_alarms = {}
+
+    @pipeline_thread.runs_on_pipeline_thread
+    def _run_op(self, op):
+        if op.deadline is not None:
+            logger.debug("%s(%s): Scheduling deadline alarm", self.name, op.name)
+            self.deadline_alarms[op] = alarm.schedule(op.deadline, self._on_deadline, args=[op])
+            op.add_callback(self._on_op_complete)
+        self.send_op_down(op)
+
+    @pipeline_thread.runs_on_pipeline_thread
+    def _on_op_complete(self, op, error):
+        self.deadline_alarms.pop(op).cancel()
+
+    @pipeline_thread.invoke_on_pipeline_thread_nowait
+    def _on_deadline(self, op):
+        if op in self.deadline_alarms:
+            del self.deadline_alarms[op]
+            logger.info("%s(%s): Deadline passed. Failing", self.name, op.name)
+            op.abandon(
+                self._on_op_complete,
+                error=pipeline_exceptions.OperationTimeout(
+                    "{} did not complete before its deadline".format(op.name)
+                ),
+            )
+
 
 # NOTE: This stage could be a candidate for being refactored into some kind of other
 # pipeline-related structure. What's odd about it as a stage is that it doesn't really respond
@@ -288,9 +398,12 @@ class PipelineRootStage(PipelineStage):
 class SasTokenRenewalStage(PipelineStage):
     # Amount of time, in seconds, prior to token expiration, when the renewal process will begin
     DEFAULT_TOKEN_RENEWAL_MARGIN = 120
+    # Amount of time, in seconds, prior to renewal, when the next token will be signed
+    DEFAULT_TOKEN_PREPARE_LEAD_TIME = 60
 
     def __init__(self):
         super(SasTokenRenewalStage, self).__init__()
+        self._token_prepare_alarm = None
         self._token_renewal_alarm = None
 
     @pipeline_thread.runs_on_pipeline_thread
@@ -309,7 +422,12 @@ class SasTokenRenewalStage(PipelineStage):
 
     @pipeline_thread.runs_on_pipeline_thread
     def _cancel_token_renewal_alarm(self):
-        """Cancel and delete any pending renewal alarm"""
+        """Cancel and delete any pending renewal alarm (and the alarm preparing for it)"""
+        old_prepare_alarm = self._token_prepare_alarm
+        self._token_prepare_alarm = None
+        if old_prepare_alarm:
+            old_prepare_alarm.cancel()
+            old_prepare_alarm = None
         old_alarm = self._token_renewal_alarm
         self._token_renewal_alarm = None
         if old_alarm:
@@ -328,7 +446,7 @@ class SasTokenRenewalStage(PipelineStage):
             - self.DEFAULT_TOKEN_RENEWAL_MARGIN
         )
 
-        logger.debug("Scheduling SAS Token renewal at epoch time: {}".format(renew_time))
+        logger.debug("Scheduling SAS Token renewal at epoch time: %s", renew_time)
         self_weakref = weakref.ref(self)
 
         @pipeline_thread.runs_on_pipeline_thread
@@ -336,16 +454,15 @@ class SasTokenRenewalStage(PipelineStage):
             this = self_weakref()
             if error:
                 logger.info(
-                    "{}({}): reauthorize connection operation failed.  Error={}".format(
-                        this.name, op.name, error
-                    )
+                    "%s(%s): reauthorize connection operation failed.  Error=%s",
+                    this.name,
+                    op.name,
+                    error,
                 )
                 handle_exceptions.handle_background_exception(error)
             else:
                 logger.info(
-                    "{}({}): reauthorize connection operation is complete".format(
-                        this.name, op.name
-                    )
+                    "%s(%s): reauthorize connection operation is complete", this.name, op.name
                 )
 
         @pipeline_thread.invoke_on_pipeline_thread_nowait
@@ -366,9 +483,24 @@ class SasTokenRenewalStage(PipelineStage):
             # Once again, start a renewal alarm
             this._start_renewal_alarm()
 
-        self._token_renewal_alarm = alarm.Alarm(renew_time, renew_token)
-        self._token_renewal_alarm.daemon = True
-        self._token_renewal_alarm.start()
+        @pipeline_thread.invoke_on_sastoken_thread_nowait
+        def prepare_token():
+            # Sign the next token ahead of the renewal, and off the pipeline thread, since for
+            # an IoT Edge module this is a request to the workload API.
+            this = self_weakref()
+            if this:
+                try:
+                    this.pipeline_root.pipeline_configuration.sastoken.prepare_refresh()
+                except Exception as e:
+                    # The token will be signed when it is refreshed on the pipeline thread instead
+                    logger.warning("Unable to prepare the SAS Token renewal ahead of time: %s", e)
+
+        # All renewal alarms share a single alarm thread, rather than a thread per pipeline, so
+        # the alarms only hand the work off to other threads.
+        self._token_prepare_alarm = alarm.schedule(
+            renew_time - self.DEFAULT_TOKEN_PREPARE_LEAD_TIME, prepare_token
+        )
+        self._token_renewal_alarm = alarm.schedule(renew_time, renew_token)
 
 
 class AutoConnectStage(PipelineStage):
@@ -391,30 +523,19 @@ class AutoConnectStage(PipelineStage):
                 # send something, so it's very possible that we're disconnected but don't know
                 # it yet.
 
-                @pipeline_thread.runs_on_pipeline_thread
-                def check_for_connection_failure(op, error):
-                    if error and not self.pipeline_root.connected:
-                        logger.debug(
-                            "{}({}): op failed with {} and we're not conencted.  Re-submitting.".format(
-                                self.name, op.name, error
-                            )
-                        )
-                        op.halt_completion()
-                        self.run_op(op)
-
-                op.add_callback(check_for_connection_failure)
+                op.add_callback(self._check_for_connection_failure)
                 logger.debug(
-                    "{}({}): Connected.  Sending down and adding callback to check result".format(
-                        self.name, op.name
-                    )
+                    "%s(%s): Connected.  Sending down and adding callback to check result",
+                    self.name,
+                    op.name,
                 )
                 self.send_op_down(op)
             else:
                 # operation needs connection, but pipeline is not connected.
                 logger.debug(
-                    "{}({}): Op needs connection.  Queueing this op and starting a ConnectionOperation".format(
-                        self.name, op.name
-                    )
+                    "%s(%s): Op needs connection.  Queueing this op and starting a ConnectionOperation",
+                    self.name,
+                    op.name,
                 )
                 self._do_connect(op)
 
@@ -423,6 +544,18 @@ class AutoConnectStage(PipelineStage):
         else:
             self.send_op_down(op)
 
+    @pipeline_thread.runs_on_pipeline_thread
+    def _check_for_connection_failure(self, op, error):
+        if error and not self.pipeline_root.connected:
+            logger.debug(
+                "%s(%s): op failed with %s and we're not conencted.  Re-submitting.",
+                self.name,
+                op.name,
+                error,
+            )
+            op.halt_completion()
+            self.run_op(op)
+
     @pipeline_thread.runs_on_pipeline_thread
     def _do_connect(self, op):
         """
@@ -437,25 +570,69 @@ class AutoConnectStage(PipelineStage):
         def on_connect_op_complete(op, error):
             if error:
                 logger.debug(
-                    "{}({}): Connection failed.  Completing with failure because of connection failure: {}".format(
-                        self.name, op_needs_complete.name, error
-                    )
+                    "%s(%s): Connection failed.  Completing with failure because of connection failure: %s",
+                    self.name,
+                    op_needs_complete.name,
+                    error,
                 )
                 op_needs_complete.complete(error=error)
             else:
                 logger.debug(
-                    "{}({}): connection is complete.  Running op that triggered connection.".format(
-                        self.name, op_needs_complete.name
-                    )
+                    "%s(%s): connection is complete.  Running op that triggered connection.",
+                    self.name,
+                    op_needs_complete.name,
                 )
                 # use run_op instead of send_op_down because we want the check_for_connection_failure logic
                 # above to run.  Just because we just connected, it doesn't mean the connection won't drop
                 # before we're done sending.  (This does actually happen in stress scenarios)
                 self.run_op(op_needs_complete)
 
+        # The connect op is done on behalf of the op which triggered it, so it gets the same
+        # priority.  Stages which hold connect ops (e.g. ReconnectStage) release them in priority
+        # order, which releases the ops waiting for the connection in priority order.
+        connect_op = pipeline_ops_base.ConnectOperation(callback=on_connect_op_complete)
+        connect_op.priority = op.priority
+
         # call down to the next stage to connect.
-        logger.debug("{}({}): calling down with Connect operation".format(self.name, op.name))
-        self.send_op_down(pipeline_ops_base.ConnectOperation(callback=on_connect_op_complete))
+        logger.debug("%s(%s): calling down with Connect operation", self.name, op.name)
+        self.send_op_down(connect_op)
+
+
+class OperationPriorityQueue(queue.Queue):
+    """
+    Queue of PipelineOperations which returns operations in order of their priority class, and
+    operations of the same priority in the order they were added.
+
+    Operations which change the connection state are barriers: they are returned after every
+    operation added before them, and before every operation added after them.  Only operations
+    added between two barriers are reordered, so that (for example) telemetry sent before a
+    disconnect is still released before the disconnect.
+    """
+
+    barrier_op_types = (
+        pipeline_ops_base.ConnectOperation,
+        pipeline_ops_base.DisconnectOperation,
+        pipeline_ops_base.ReauthorizeConnectionOperation,
+    )
+
+    def _init(self, maxsize):
+        self.queue = []
+        self._counter = itertools.count()
+        self._segment = 0
+
+    def _qsize(self):
+        return len(self.queue)
+
+    def _put(self, op):
+        is_barrier = isinstance(op, self.barrier_op_types)
+        if is_barrier:
+            self._segment += 1
+        heapq.heappush(
+            self.queue, (self._segment, not is_barrier, op.priority, next(self._counter), op)
+        )
+
+    def _get(self):
+        return heapq.heappop(self.queue)[-1]
 
 
 class ConnectionLockStage(PipelineStage):
@@ -465,11 +642,16 @@ class ConnectionLockStage(PipelineStage):
     time.  This way, we don't have to worry about cases like "what happens if we try to
     disconnect if we're in the middle of reauthorizing."  This stage will wait for the
     reauthorize to complete before letting the disconnect past.
+
+    Operations queued while the stage is blocked are released in priority order, so that
+    control operations, method responses, and twin operations don't wait behind a backlog of
+    telemetry after a reconnect.  Queued connect, disconnect, and reauthorize ops keep their
+    place relative to the operations queued before and after them.
     """
 
     def __init__(self):
         super(ConnectionLockStage, self).__init__()
-        self.queue = queue.Queue()
+        self.queue = OperationPriorityQueue()
         self.blocked = False
 
     @pipeline_thread.runs_on_pipeline_thread
@@ -479,16 +661,14 @@ class ConnectionLockStage(PipelineStage):
         # to complete), we queue up all operations until after the connect completes.
         if self.blocked:
             logger.debug(
-                "{}({}): pipeline is blocked waiting for a prior connect/disconnect/reauthorize to complete.  queueing.".format(
-                    self.name, op.name
-                )
+                "%s(%s): pipeline is blocked waiting for a prior connect/disconnect/reauthorize to complete.  queueing.",
+                self.name,
+                op.name,
             )
             self.queue.put_nowait(op)
 
         elif isinstance(op, pipeline_ops_base.ConnectOperation) and self.pipeline_root.connected:
-            logger.info(
-                "{}({}): Transport is already connected.  Completing.".format(self.name, op.name)
-            )
+            logger.info("%s(%s): Transport is already connected.  Completing.", self.name, op.name)
             op.complete()
 
         elif (
@@ -496,7 +676,7 @@ class ConnectionLockStage(PipelineStage):
             and not self.pipeline_root.connected
         ):
             logger.info(
-                "{}({}): Transport is already disconnected.  Completing.".format(self.name, op.name)
+                "%s(%s): Transport is already disconnected.  Completing.", self.name, op.name
             )
             op.complete()
 
@@ -511,14 +691,13 @@ class ConnectionLockStage(PipelineStage):
             def on_operation_complete(op, error):
                 if error:
                     logger.debug(
-                        "{}({}): op failed.  Unblocking queue with error: {}".format(
-                            self.name, op.name, error
-                        )
+                        "%s(%s): op failed.  Unblocking queue with error: %s",
+                        self.name,
+                        op.name,
+                        error,
                     )
                 else:
-                    logger.debug(
-                        "{}({}): op succeeded.  Unblocking queue".format(self.name, op.name)
-                    )
+                    logger.debug("%s(%s): op succeeded.  Unblocking queue", self.name, op.name)
 
                 self._unblock(op, error)
 
@@ -533,7 +712,7 @@ class ConnectionLockStage(PipelineStage):
         """
         block this stage while we're waiting for the connect/disconnect/reauthorize operation to complete.
         """
-        logger.debug("{}({}): blocking".format(self.name, op.name))
+        logger.debug("%s(%s): blocking", self.name, op.name)
         self.blocked = True
 
     @pipeline_thread.runs_on_pipeline_thread
@@ -542,33 +721,31 @@ class ConnectionLockStage(PipelineStage):
         Unblock this stage after the connect/disconnect/reauthorize operation is complete.  This also means
         releasing all the operations that were queued up.
         """
-        logger.debug("{}({}): unblocking and releasing queued ops.".format(self.name, op.name))
+        logger.debug("%s(%s): unblocking and releasing queued ops.", self.name, op.name)
         self.blocked = False
         logger.debug(
-            "{}({}): processing {} items in queue for error={}".format(
-                self.name, op.name, self.queue.qsize(), error
-            )
+            "%s(%s): processing %s items in queue for error=%s",
+            self.name,
+            op.name,
+            self.queue.qsize(),
+            error,
         )
         # Loop through our queue and release all the blocked operations
         # Put a new Queue in self.queue because releasing ops might put them back in the
         # queue, especially if there's a ConnectOperation in the list of ops to release
         old_queue = self.queue
-        self.queue = queue.Queue()
+        self.queue = OperationPriorityQueue()
         while not old_queue.empty():
             op_to_release = old_queue.get_nowait()
             if error:
                 # if we're unblocking the queue because something (like a connect operation) failed,
                 # then we fail all of the blocked operations with the same error.
                 logger.debug(
-                    "{}({}): failing {} op because of error".format(
-                        self.name, op.name, op_to_release.name
-                    )
+                    "%s(%s): failing %s op because of error", self.name, op.name, op_to_release.name
                 )
                 op_to_release.complete(error=error)
             else:
-                logger.debug(
-                    "{}({}): releasing {} op.".format(self.name, op.name, op_to_release.name)
-                )
+                logger.debug("%s(%s): releasing %s op.", self.name, op.name, op_to_release.name)
                 # call run_op directly here so operations go through this stage again (especially connect/disconnect ops)
                 self.run_op(op_to_release)
 
@@ -578,11 +755,52 @@ class CoordinateRequestAndResponseStage(PipelineStage):
     Pipeline stage which is responsible for coordinating RequestAndResponseOperation operations.  For each
     RequestAndResponseOperation operation, this stage passes down a RequestOperation operation and waits for
     an ResponseEvent event.  All other events are passed down unmodified.
+
+    Requests waiting for a response are kept in the pending_responses correlation table, keyed
+    by a compact request id made of a random per-stage prefix followed by a sequence number.
+    Every request has a deadline, a response timeout after it is made, and a single alarm
+    (scheduled for the earliest deadline) fails every request that is past its deadline with a
+    PipelineTimeoutError.  The response timeout can be set per request type.
+
+    Deadlines are wall clock times, so time spent with the host suspended counts towards them.
+    Expired requests are also swept when the connection state changes, so that they are failed
+    rather than re-sent on a reconnect that happens before the alarm thread notices.  A
+    request that is held below this stage (e.g. waiting for a connection) until its deadline has
+    passed is failed the same way, rather than being sent.
+
+    The expired_response_count and late_response_count attributes count requests that expired
+    and responses that arrived for requests which were no longer pending.
     """
 
-    def __init__(self):
+    DEFAULT_RESPONSE_TIMEOUT = 60
+
+    def __init__(self, response_timeouts=None):
+        """Initializer for CoordinateRequestAndResponseStage
+
+        :param dict response_timeouts: Optional timeouts, in seconds, by request type. Requests
+            of any other type time out after DEFAULT_RESPONSE_TIMEOUT seconds.
+        """
         super(CoordinateRequestAndResponseStage, self).__init__()
         self.pending_responses = {}
+        self.response_timeout = self.DEFAULT_RESPONSE_TIMEOUT
+        self.response_timeouts = dict(response_timeouts or {})
+        # Maps request_id -> deadline, for the pending requests
+        self.response_deadlines = {}
+        # Heap of (deadline, request_id) tuples.  Entries for requests which are no longer
+        # pending are discarded lazily.
+        self.deadline_queue = []
+        self.deadline_alarm = None
+        self.deadline_alarm_time = None
+        # The prefix keeps request ids unique across client instances, so a response for a
+        # request made by a previous session can't be mistaken for one of ours.
+        self.request_id_prefix = "{:08x}".format(random.getrandbits(32))
+        self.request_count = 0
+        self.expired_response_count = 0
+        self.late_response_count = 0
+
+    @property
+    def pending_response_count(self):
+        return len(self.pending_responses)
 
     @pipeline_thread.runs_on_pipeline_thread
     def _run_op(self, op):
@@ -592,18 +810,113 @@ class CoordinateRequestAndResponseStage(PipelineStage):
             # actual protocol client operation.  The RequestAndResponseOperation operation will be
             # completed when the corresponding IotResponse event is received in this stage.
 
-            request_id = str(uuid.uuid4())
+            request_id = self._get_next_request_id()
 
             logger.debug(
-                "{}({}): adding request {} to pending list".format(self.name, op.name, request_id)
+                "%s(%s): adding request %s to pending list", self.name, op.name, request_id
             )
+            deadline = time.time() + self._get_response_timeout(op)
             self.pending_responses[request_id] = op
+            self.response_deadlines[request_id] = deadline
+            heapq.heappush(self.deadline_queue, (deadline, request_id))
+            self._start_deadline_alarm()
 
             self._send_request_down(request_id, op)
 
         else:
             self.send_op_down(op)
 
+    def _get_response_timeout(self, op):
+        return self.response_timeouts.get(op.request_type, self.response_timeout)
+
+    def _get_next_request_id(self):
+        request_id = "{}{:x}".format(self.request_id_prefix, self.request_count)
+        self.request_count += 1
+        return request_id
+
+    def _is_own_request_id(self, request_id):
+        """Return True if the request_id was generated by this stage"""
+        request_id = str(request_id)
+        if not request_id.startswith(self.request_id_prefix):
+            return False
+        try:
+            return int(request_id[len(self.request_id_prefix) :], 16) < self.request_count
+        except ValueError:
+            return False
+
+    @pipeline_thread.runs_on_pipeline_thread
+    def _remove_pending_response(self, request_id):
+        del self.pending_responses[request_id]
+        del self.response_deadlines[request_id]
+        if not self.pending_responses:
+            # Nothing left to expire.  Drop the stale deadlines and the alarm along with them.
+            del self.deadline_queue[:]
+            self._cancel_deadline_alarm()
+
+    @pipeline_thread.runs_on_pipeline_thread
+    def _start_deadline_alarm(self):
+        """Make sure the alarm is scheduled for the earliest deadline, if there is one"""
+        if not self.deadline_queue:
+            return
+        deadline = self.deadline_queue[0][0]
+        if self.deadline_alarm:
+            if self.deadline_alarm_time <= deadline:
+                return
+            # Requests with a shorter timeout can have an earlier deadline than older requests
+            self._cancel_deadline_alarm()
+
+        self_weakref = weakref.ref(self)
+
+        @pipeline_thread.invoke_on_pipeline_thread_nowait
+        def on_deadline_alarm():
+            this = self_weakref()
+            if this:
+                this._cancel_deadline_alarm()
+                this._expire_requests()
+                this._start_deadline_alarm()
+
+        self.deadline_alarm = alarm.schedule(deadline, on_deadline_alarm)
+        self.deadline_alarm_time = deadline
+
+    @pipeline_thread.runs_on_pipeline_thread
+    def _cancel_deadline_alarm(self):
+        if self.deadline_alarm:
+            self.deadline_alarm.cancel()
+            self.deadline_alarm = None
+            self.deadline_alarm_time = None
+
+    @pipeline_thread.runs_on_pipeline_thread
+    def _expire_requests(self):
+        """Fail every pending request whose deadline has passed"""
+        now = time.time()
+        expired_ops = []
+        while self.deadline_queue and self.deadline_queue[0][0] <= now:
+            _, request_id = heapq.heappop(self.deadline_queue)
+            op = self.pending_responses.pop(request_id, None)
+            if op:
+                del self.response_deadlines[request_id]
+                expired_ops.append((request_id, op))
+
+        if not self.pending_responses:
+            del self.deadline_queue[:]
+            self._cancel_deadline_alarm()
+
+        for request_id, op in expired_ops:
+            logger.info(
+                "%s(%s): No response received for request %s.  Expiring",
+                self.name,
+                op.name,
+                request_id,
+            )
+            self.expired_response_count += 1
+            op.complete(
+                error=pipeline_exceptions.PipelineTimeoutError(
+                    "No response received for {} request to {} resource {}".format(
+                        op.request_type, op.method, op.resource_location
+                    )
+                )
+            )
+
     @pipeline_thread.runs_on_pipeline_thread
     def _send_request_down(self, request_id, op):
         # Alias to avoid overload within the callback below
@@ -613,30 +926,37 @@ class CoordinateRequestAndResponseStage(PipelineStage):
         @pipeline_thread.runs_on_pipeline_thread
         def on_send_request_done(op, error):
             logger.debug(
-                "{}({}): Finished sending {} request to {} resource {}".format(
-                    self.name,
-                    op_waiting_for_response.name,
-                    op_waiting_for_response.request_type,
-                    op_waiting_for_response.method,
-                    op_waiting_for_response.resource_location,
-                )
+                "%s(%s): Finished sending %s request to %s resource %s",
+                self.name,
+                op_waiting_for_response.name,
+                op_waiting_for_response.request_type,
+                op_waiting_for_response.method,
+                op_waiting_for_response.resource_location,
             )
             if error:
-                logger.debug(
-                    "{}({}): removing request {} from pending list".format(
-                        self.name, op_waiting_for_response.name, request_id
+                # A request held below until its deadline passed is failed like any other
+                # expired request
+                self._expire_requests()
+                if request_id in self.pending_responses:
+                    logger.debug(
+                        "%s(%s): removing request %s from pending list",
+                        self.name,
+                        op_waiting_for_response.name,
+                        request_id,
                     )
-                )
-                del (self.pending_responses[request_id])
-                op_waiting_for_response.complete(error=error)
+                    self._remove_pending_response(request_id)
+                    op_waiting_for_response.complete(error=error)
             else:
                 # request sent.  Nothing to do except wait for the response
                 pass
 
         logger.debug(
-            "{}({}): Sending {} request to {} resource {}".format(
-                self.name, op.name, op.request_type, op.method, op.resource_location
-            )
+            "%s(%s): Sending %s request to %s resource %s",
+            self.name,
+            op.name,
+            op.request_type,
+            op.method,
+            op.resource_location,
         )
 
         new_op = pipeline_ops_base.RequestOperation(
@@ -648,6 +968,10 @@ class CoordinateRequestAndResponseStage(PipelineStage):
             callback=on_send_request_done,
             query_params=op.query_params,
         )
+        # Requests are not sent (or sent again after a reconnect) once either the operation's
+        # deadline or the deadline for the response has passed
+        deadlines = [d for d in (op.deadline, self.response_deadlines[request_id]) if d is not None]
+        new_op.deadline = min(deadlines)
         self.send_op_down(new_op)
 
     @pipeline_thread.runs_on_pipeline_thread
@@ -658,32 +982,39 @@ class CoordinateRequestAndResponseStage(PipelineStage):
             # complete it.
 
             logger.debug(
-                "{}({}): Handling event with request_id {}".format(
-                    self.name, event.name, event.request_id
-                )
+                "%s(%s): Handling event with request_id %s", self.name, event.name, event.request_id
             )
             if event.request_id in self.pending_responses:
                 op = self.pending_responses[event.request_id]
-                del (self.pending_responses[event.request_id])
+                self._remove_pending_response(event.request_id)
                 op.status_code = event.status_code
                 op.response_body = event.response_body
                 op.retry_after = event.retry_after
                 logger.debug(
-                    "{}({}): Completing {} request to {} resource {} with status {}".format(
-                        self.name,
-                        op.name,
-                        op.request_type,
-                        op.method,
-                        op.resource_location,
-                        op.status_code,
-                    )
+                    "%s(%s): Completing %s request to %s resource %s with status %s",
+                    self.name,
+                    op.name,
+                    op.request_type,
+                    op.method,
+                    op.resource_location,
+                    op.status_code,
                 )
                 op.complete()
+            elif self._is_own_request_id(event.request_id):
+                # The request already expired, failed, or was answered (e.g. re-sent requests)
+                self.late_response_count += 1
+                logger.info(
+                    "%s(%s): request_id %s is no longer pending.  Dropping late response",
+                    self.name,
+                    event.name,
+                    event.request_id,
+                )
             else:
                 logger.info(
-                    "{}({}): request_id {} not found in pending list.  Nothing to do.  Dropping".format(
-                        self.name, event.name, event.request_id
-                    )
+                    "%s(%s): request_id %s not found in pending list.  Nothing to do.  Dropping",
+                    self.name,
+                    event.name,
+                    event.request_id,
                 )
 
         elif isinstance(event, pipeline_events_base.ConnectedEvent):
@@ -698,11 +1029,18 @@ class CoordinateRequestAndResponseStage(PipelineStage):
             operation.  Since we're reusing the same $rid, the server, of course, _could_
             recognize that this is a duplicate request, but the behavior in this case is
             undefined.
+
+            Requests which are already past their deadline are expired instead of re-sent.
             """
 
             self.send_event_up(event)
 
-            for request_id in self.pending_responses:
+            self._expire_requests()
+
+            for request_id in list(self.pending_responses):
+                if request_id not in self.pending_responses:
+                    # Failed while re-sending an earlier request
+                    continue
                 logger.info(
                     "{stage}: ConnectedEvent: re-publishing request {id} for {method} {type} ".format(
                         stage=self.name,
@@ -713,6 +1051,13 @@ class CoordinateRequestAndResponseStage(PipelineStage):
                 )
                 self._send_request_down(request_id, self.pending_responses[request_id])
 
+        elif isinstance(event, pipeline_events_base.DisconnectedEvent):
+            # Responses can't arrive until we reconnect.  Expire everything that has run out of
+            # time now rather than waiting for the alarm, which may be late if the host was
+            # suspended.
+            self._expire_requests()
+            self.send_event_up(event)
+
         else:
             self.send_event_up(event)
 
@@ -766,21 +1111,21 @@ class OpTimeoutStage(PipelineStage):
             @pipeline_thread.invoke_on_pipeline_thread_nowait
             def on_timeout():
                 this = self_weakref()
-                logger.info("{}({}): returning timeout error".format(this.name, op.name))
+                logger.info("%s(%s): returning timeout error", this.name, op.name)
                 op.complete(
                     error=pipeline_exceptions.PipelineTimeoutError(
                         "operation timed out before protocol client could respond"
                     )
                 )
 
-            logger.debug("{}({}): Creating timer".format(self.name, op.name))
+            logger.debug("%s(%s): Creating timer", self.name, op.name)
             op.timeout_timer = threading.Timer(self.timeout_intervals[type(op)], on_timeout)
             op.timeout_timer.start()
 
             # Send the op down, but intercept the return of the op so we can
             # remove the timer when the op is done
             op.add_callback(self._clear_timer)
-            logger.debug("{}({}): Sending down".format(self.name, op.name))
+            logger.debug("%s(%s): Sending down", self.name, op.name)
             self.send_op_down(op)
         else:
             self.send_op_down(op)
@@ -789,7 +1134,7 @@ class OpTimeoutStage(PipelineStage):
     def _clear_timer(self, op, error):
         # When an op comes back, delete the timer and pass it right up.
         if op.timeout_timer:
-            logger.debug("{}({}): Cancelling timer".format(self.name, op.name))
+            logger.debug("%s(%s): Cancelling timer", self.name, op.name)
             op.timeout_timer.cancel()
             op.timeout_timer = None
 
@@ -846,6 +1191,15 @@ class RetryStage(PipelineStage):
                     return True
         return False
 
+    @pipeline_thread.runs_on_pipeline_thread
+    def _retry_would_pass_deadline(self, op):
+        """
+        Return True if the op has a deadline that would pass before it is retried.
+        """
+        if op.deadline is None:
+            return False
+        return time.time() + self.retry_intervals[type(op)] >= op.deadline
+
     @pipeline_thread.runs_on_pipeline_thread
     def _do_retry_if_necessary(self, op, error):
         """
@@ -853,13 +1207,31 @@ class RetryStage(PipelineStage):
         is where we check to see if a retry is necessary and set a "retry timer"
         which can be used to send the op down again.
         """
-        if self._should_retry(op, error):
+        if self._should_retry(op, error) and self._retry_would_pass_deadline(op):
+            logger.info(
+                "%s(%s): Not retrying after %s, because the deadline would pass first",
+                self.name,
+                op.name,
+                error,
+            )
+            op.halt_completion()
+            if op.retry_timer:
+                op.retry_timer.cancel()
+                op.retry_timer = None
+            op.complete(
+                error=pipeline_exceptions.OperationTimeout(
+                    "{} deadline would pass before it could be retried".format(op.name),
+                    cause=error,
+                )
+            )
+
+        elif self._should_retry(op, error):
             self_weakref = weakref.ref(self)
 
             @pipeline_thread.invoke_on_pipeline_thread_nowait
             def do_retry():
                 this = self_weakref()
-                logger.debug("{}({}): retrying".format(this.name, op.name))
+                logger.debug("%s(%s): retrying", this.name, op.name)
                 op.retry_timer.cancel()
                 op.retry_timer = None
                 this.ops_waiting_to_retry.remove(op)
@@ -869,9 +1241,11 @@ class RetryStage(PipelineStage):
 
             interval = self.retry_intervals[type(op)]
             logger.info(
-                "{}({}): Op needs retry with interval {} because of {}.  Setting timer.".format(
-                    self.name, op.name, interval, error
-                )
+                "%s(%s): Op needs retry with interval %s because of %s.  Setting timer.",
+                self.name,
+                op.name,
+                interval,
+                error,
             )
 
             # if we don't keep track of this op, it might get collected.
@@ -948,16 +1322,15 @@ class ReconnectStage(PipelineStage):
         if isinstance(op, pipeline_ops_base.ConnectOperation):
             if self.state == ReconnectState.WAITING_TO_RECONNECT:
                 logger.debug(
-                    "{}({}): State is {}.  Adding to wait list".format(
-                        self.name, op.name, self.state
-                    )
+                    "%s(%s): State is %s.  Adding to wait list", self.name, op.name, self.state
                 )
                 self.waiting_connect_ops.append(op)
             else:
                 logger.info(
-                    "{}({}): State changes {}->LOGICALLY_CONNECTED.  Adding to wait list and sending new connect op down".format(
-                        self.name, op.name, self.state
-                    )
+                    "%s(%s): State changes %s->LOGICALLY_CONNECTED.  Adding to wait list and sending new connect op down",
+                    self.name,
+                    op.name,
+                    self.state,
                 )
                 self.state = ReconnectState.LOGICALLY_CONNECTED
                 # We don't send this op down.  Instead, we send a new connect op down.  This way,
@@ -973,9 +1346,10 @@ class ReconnectStage(PipelineStage):
         elif isinstance(op, pipeline_ops_base.DisconnectOperation):
             if self.state == ReconnectState.WAITING_TO_RECONNECT:
                 logger.info(
-                    "{}({}): State changes {}->LOGICALLY_DISCONNECTED.  Canceling waiting ops and sending disconnect down.".format(
-                        self.name, op.name, self.state
-                    )
+                    "%s(%s): State changes %s->LOGICALLY_DISCONNECTED.  Canceling waiting ops and sending disconnect down.",
+                    self.name,
+                    op.name,
+                    self.state,
                 )
                 self.state = ReconnectState.LOGICALLY_DISCONNECTED
                 self._clear_reconnect_timer()
@@ -986,9 +1360,10 @@ class ReconnectStage(PipelineStage):
 
             else:
                 logger.info(
-                    "{}({}): State changes {}->LOGICALLY_DISCONNECTED.  Sending op down.".format(
-                        self.name, op.name, self.state
-                    )
+                    "%s(%s): State changes %s->LOGICALLY_DISCONNECTED.  Sending op down.",
+                    self.name,
+                    op.name,
+                    self.state,
                 )
                 self.state = ReconnectState.LOGICALLY_DISCONNECTED
                 self.send_op_down(op)
@@ -1004,9 +1379,11 @@ class ReconnectStage(PipelineStage):
     def _handle_pipeline_event(self, event):
         if isinstance(event, pipeline_events_base.DisconnectedEvent):
             logger.debug(
-                "{}({}): State is {} Connected is {}.".format(
-                    self.name, event.name, self.state, self.pipeline_root.connected
-                )
+                "%s(%s): State is %s Connected is %s.",
+                self.name,
+                event.name,
+                self.state,
+                self.pipeline_root.connected,
             )
 
             if self.pipeline_root.connected and self.state == ReconnectState.LOGICALLY_CONNECTED:
@@ -1043,14 +1420,13 @@ class ReconnectStage(PipelineStage):
             this = self_weakref()
             if this:
                 logger.debug(
-                    "{}({}): on_connect_complete error={} state={} never_connected={} connected={} ".format(
-                        this.name,
-                        op.name,
-                        error,
-                        this.state,
-                        this.never_connected,
-                        this.pipeline_root.connected,
-                    )
+                    "%s(%s): on_connect_complete error=%s state=%s never_connected=%s connected=%s ",
+                    this.name,
+                    op.name,
+                    error,
+                    this.state,
+                    this.never_connected,
+                    this.pipeline_root.connected,
                 )
                 if error:
                     if this.never_connected:
@@ -1074,7 +1450,7 @@ class ReconnectStage(PipelineStage):
                     this._clear_reconnect_timer()
                     this._complete_waiting_connect_ops()
 
-        logger.debug("{}: sending new connect op down".format(self.name))
+        logger.debug("%s: sending new connect op down", self.name)
         op = pipeline_ops_base.ConnectOperation(callback=on_connect_complete)
         self.send_op_down(op)
 
@@ -1084,9 +1460,10 @@ class ReconnectStage(PipelineStage):
         Set a timer to reconnect after some period of time
         """
         logger.debug(
-            "{}: State is {}. Connected={} Starting reconnect timer".format(
-                self.name, self.state, self.pipeline_root.connected
-            )
+            "%s: State is %s. Connected=%s Starting reconnect timer",
+            self.name,
+            self.state,
+            self.pipeline_root.connected,
         )
 
         self._clear_reconnect_timer()
@@ -1097,9 +1474,10 @@ class ReconnectStage(PipelineStage):
         def on_reconnect_timer_expired():
             this = self_weakref()
             logger.debug(
-                "{}: Reconnect timer expired. State is {} Connected is {}.".format(
-                    self.name, self.state, self.pipeline_root.connected
-                )
+                "%s: Reconnect timer expired. State is %s Connected is %s.",
+                self.name,
+                self.state,
+                self.pipeline_root.connected,
             )
 
             this.reconnect_timer = None
@@ -1120,7 +1498,7 @@ class ReconnectStage(PipelineStage):
         Clear any previous reconnect timer
         """
         if self.reconnect_timer:
-            logger.debug("{}: clearing reconnect timer".format(self.name))
+            logger.debug("%s: clearing reconnect timer", self.name)
             self.reconnect_timer.cancel()
             self.reconnect_timer = None
 
@@ -1143,9 +1521,15 @@ class ReconnectStage(PipelineStage):
         to be established.  Other ops pass through this stage, and might fail in later
         stages, but that's OK.  If they needed a connection, the AutoConnectStage before
         this stage should be taking care of that.
+
+        The ops are completed in priority order (and in the order they arrived within a
+        priority).  Each ConnectOperation created by the AutoConnectStage has the priority of
+        the op which is waiting on it, and that op is sent down as soon as its ConnectOperation
+        completes, so this is the order in which the ops held during a reconnect are sent.
         """
-        logger.debug("{}: completing waiting ops with error={}".format(self.name, error))
-        list_copy = self.waiting_connect_ops
+        logger.debug("%s: completing waiting ops with error=%s", self.name, error)
+        # sorted() is stable, so ops with the same priority keep their arrival order
+        list_copy = sorted(self.waiting_connect_ops, key=lambda op: op.priority)
         self.waiting_connect_ops = []
         for op in list_copy:
             op.complete(error)
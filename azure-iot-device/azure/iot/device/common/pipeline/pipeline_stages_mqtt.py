@@ -4,6 +4,7 @@
 # license information.
 # --------------------------------------------------------------------------
 
+import functools
 import logging
 import six
 import traceback
@@ -65,7 +66,7 @@ class MQTTTransportStage(PipelineStage):
 
     @pipeline_thread.runs_on_pipeline_thread
     def _start_connection_watchdog(self, connection_op):
-        logger.debug("{}({}): Starting watchdog".format(self.name, connection_op.name))
+        logger.debug("%s(%s): Starting watchdog", self.name, connection_op.name)
 
         self_weakref = weakref.ref(self)
         op_weakref = weakref.ref(connection_op)
@@ -76,14 +77,14 @@ class MQTTTransportStage(PipelineStage):
             op = op_weakref()
             if this and op and this._pending_connection_op is op:
                 logger.info(
-                    "{}({}): Connection watchdog expired.  Cancelling op".format(this.name, op.name)
+                    "%s(%s): Connection watchdog expired.  Cancelling op", this.name, op.name
                 )
                 this.transport.disconnect()
                 if this.pipeline_root.connected:
                     logger.info(
-                        "{}({}): Pipeline is still connected on watchdog expiration.  Sending DisconnectedEvent".format(
-                            this.name, op.name
-                        )
+                        "%s(%s): Pipeline is still connected on watchdog expiration.  Sending DisconnectedEvent",
+                        this.name,
+                        op.name,
                     )
                     this.send_event_up(pipeline_events_base.DisconnectedEvent())
                 this._cancel_pending_connection_op(
@@ -100,7 +101,7 @@ class MQTTTransportStage(PipelineStage):
     def _cancel_connection_watchdog(self, op):
         try:
             if op.watchdog_timer:
-                logger.debug("{}({}): cancelling watchdog".format(self.name, op.name))
+                logger.debug("%s(%s): cancelling watchdog", self.name, op.name)
                 op.watchdog_timer.cancel()
                 op.watchdog_timer = None
         except AttributeError:
@@ -114,21 +115,19 @@ class MQTTTransportStage(PipelineStage):
             # rather than the hostname itself
             if self.pipeline_root.pipeline_configuration.gateway_hostname:
                 logger.debug(
-                    "Gateway Hostname Present. Setting Hostname to: {}".format(
-                        self.pipeline_root.pipeline_configuration.gateway_hostname
-                    )
+                    "Gateway Hostname Present. Setting Hostname to: %s",
+                    self.pipeline_root.pipeline_configuration.gateway_hostname,
                 )
                 hostname = self.pipeline_root.pipeline_configuration.gateway_hostname
             else:
                 logger.debug(
-                    "Gateway Hostname not present. Setting Hostname to: {}".format(
-                        self.pipeline_root.pipeline_configuration.hostname
-                    )
+                    "Gateway Hostname not present. Setting Hostname to: %s",
+                    self.pipeline_root.pipeline_configuration.hostname,
                 )
                 hostname = self.pipeline_root.pipeline_configuration.hostname
 
             # Create the Transport object, set it's handlers
-            logger.debug("{}({}): got connection args".format(self.name, op.name))
+            logger.debug("%s(%s): got connection args", self.name, op.name)
             self.transport = MQTTTransport(
                 client_id=op.client_id,
                 hostname=hostname,
@@ -139,6 +138,9 @@ class MQTTTransportStage(PipelineStage):
                 cipher=self.pipeline_root.pipeline_configuration.cipher,
                 proxy_options=self.pipeline_root.pipeline_configuration.proxy_options,
                 keep_alive=self.pipeline_root.pipeline_configuration.keep_alive,
+                network_loop=self.pipeline_root.pipeline_configuration.network_loop,
+                adaptive_keep_alive=self.pipeline_root.pipeline_configuration.adaptive_keep_alive,
+                ack_timeout=self.pipeline_root.pipeline_configuration.ack_timeout,
             )
             self.transport.on_mqtt_connected_handler = CallableWeakMethod(
                 self, "_on_mqtt_connected"
@@ -178,7 +180,7 @@ class MQTTTransportStage(PipelineStage):
                 op.complete()
 
         elif isinstance(op, pipeline_ops_base.ConnectOperation):
-            logger.debug("{}({}): connecting".format(self.name, op.name))
+            logger.debug("%s(%s): connecting", self.name, op.name)
 
             self._cancel_pending_connection_op()
             self._pending_connection_op = op
@@ -199,7 +201,7 @@ class MQTTTransportStage(PipelineStage):
                 op.complete(error=e)
 
         elif isinstance(op, pipeline_ops_base.DisconnectOperation):
-            logger.debug("{}({}): disconnecting".format(self.name, op.name))
+            logger.debug("%s(%s): disconnecting", self.name, op.name)
 
             self._cancel_pending_connection_op()
             self._pending_connection_op = op
@@ -216,7 +218,7 @@ class MQTTTransportStage(PipelineStage):
                 op.complete(error=e)
 
         elif isinstance(op, pipeline_ops_base.ReauthorizeConnectionOperation):
-            logger.debug("{}({}): reauthorizing".format(self.name, op.name))
+            logger.debug("%s(%s): reauthorizing", self.name, op.name)
 
             self._cancel_pending_connection_op()
             self._pending_connection_op = op
@@ -233,70 +235,38 @@ class MQTTTransportStage(PipelineStage):
                 op.complete(error=e)
 
         elif isinstance(op, pipeline_ops_mqtt.MQTTPublishOperation):
-            logger.debug("{}({}): publishing on {}".format(self.name, op.name, op.topic))
-
-            @pipeline_thread.invoke_on_pipeline_thread_nowait
-            def on_complete(cancelled=False):
-                if cancelled:
-                    op.complete(
-                        error=pipeline_exceptions.OperationCancelled(
-                            "Operation cancelled before PUBACK received"
-                        )
-                    )
-                else:
-                    logger.debug(
-                        "{}({}): PUBACK received. completing op.".format(self.name, op.name)
-                    )
-                    op.complete()
+            logger.debug("%s(%s): publishing on %s", self.name, op.name, op.topic)
 
             try:
-                self.transport.publish(topic=op.topic, payload=op.payload, callback=on_complete)
+                self.transport.publish(
+                    topic=op.topic,
+                    payload=op.payload,
+                    callback=functools.partial(self._on_mqtt_operation_complete, op, "PUBACK"),
+                )
             except transport_exceptions.ConnectionDroppedError:
                 self.send_event_up(pipeline_events_base.DisconnectedEvent())
                 raise
 
         elif isinstance(op, pipeline_ops_mqtt.MQTTSubscribeOperation):
-            logger.debug("{}({}): subscribing to {}".format(self.name, op.name, op.topic))
-
-            @pipeline_thread.invoke_on_pipeline_thread_nowait
-            def on_complete(cancelled=False):
-                if cancelled:
-                    op.complete(
-                        error=pipeline_exceptions.OperationCancelled(
-                            "Operation cancelled before SUBACK received"
-                        )
-                    )
-                else:
-                    logger.debug(
-                        "{}({}): SUBACK received. completing op.".format(self.name, op.name)
-                    )
-                    op.complete()
+            logger.debug("%s(%s): subscribing to %s", self.name, op.name, op.topic)
 
             try:
-                self.transport.subscribe(topic=op.topic, callback=on_complete)
+                self.transport.subscribe(
+                    topic=op.topic,
+                    callback=functools.partial(self._on_mqtt_operation_complete, op, "SUBACK"),
+                )
             except transport_exceptions.ConnectionDroppedError:
                 self.send_event_up(pipeline_events_base.DisconnectedEvent())
                 raise
 
         elif isinstance(op, pipeline_ops_mqtt.MQTTUnsubscribeOperation):
-            logger.debug("{}({}): unsubscribing from {}".format(self.name, op.name, op.topic))
-
-            @pipeline_thread.invoke_on_pipeline_thread_nowait
-            def on_complete(cancelled=False):
-                if cancelled:
-                    op.complete(
-                        error=pipeline_exceptions.OperationCancelled(
-                            "Operation cancelled before UNSUBACK received"
-                        )
-                    )
-                else:
-                    logger.debug(
-                        "{}({}): UNSUBACK received.  completing op.".format(self.name, op.name)
-                    )
-                    op.complete()
+            logger.debug("%s(%s): unsubscribing from %s", self.name, op.name, op.topic)
 
             try:
-                self.transport.unsubscribe(topic=op.topic, callback=on_complete)
+                self.transport.unsubscribe(
+                    topic=op.topic,
+                    callback=functools.partial(self._on_mqtt_operation_complete, op, "UNSUBACK"),
+                )
             except transport_exceptions.ConnectionDroppedError:
                 self.send_event_up(pipeline_events_base.DisconnectedEvent())
                 raise
@@ -306,13 +276,29 @@ class MQTTTransportStage(PipelineStage):
             # This will raise an error when executed.
             self.send_op_down(op)
 
+    @pipeline_thread.invoke_on_pipeline_thread_nowait
+    def _on_mqtt_operation_complete(self, op, ack_name, cancelled=False):
+        """
+        Handler that gets called by the transport when the PUBACK, SUBACK or UNSUBACK for an
+        operation is received, or when the operation is cancelled.
+        """
+        if cancelled:
+            op.complete(
+                error=pipeline_exceptions.OperationCancelled(
+                    "Operation cancelled before {} received".format(ack_name)
+                )
+            )
+        else:
+            logger.debug("%s(%s): %s received. completing op.", self.name, op.name, ack_name)
+            op.complete()
+
     @pipeline_thread.invoke_on_pipeline_thread_nowait
     def _on_mqtt_message_received(self, topic, payload):
         """
         Handler that gets called by the protocol library when an incoming message arrives.
         Convert that message into a pipeline event and pass it up for someone to handle.
         """
-        logger.debug("{}: message received on topic {}".format(self.name, topic))
+        logger.debug("%s: message received on topic %s", self.name, topic)
         self.send_event_up(
             pipeline_events_mqtt.IncomingMQTTMessageEvent(topic=topic, payload=payload)
         )
@@ -347,16 +333,16 @@ class MQTTTransportStage(PipelineStage):
         :param Exception cause: The Exception that caused the connection failure.
         """
 
-        logger.info("{}: _on_mqtt_connection_failure called: {}".format(self.name, cause))
+        logger.info("%s: _on_mqtt_connection_failure called: %s", self.name, cause)
 
         if isinstance(self._pending_connection_op, pipeline_ops_base.ConnectOperation):
-            logger.debug("{}: failing connect op".format(self.name))
+            logger.debug("%s: failing connect op", self.name)
             op = self._pending_connection_op
             self._cancel_connection_watchdog(op)
             self._pending_connection_op = None
             op.complete(error=cause)
         else:
-            logger.info("{}: Connection failure was unexpected".format(self.name))
+            logger.info("%s: Connection failure was unexpected", self.name)
             handle_exceptions.swallow_unraised_exception(
                 cause, log_msg="Unexpected connection failure.  Safe to ignore.", log_lvl="info"
             )
@@ -369,9 +355,9 @@ class MQTTTransportStage(PipelineStage):
         :param Exception cause: The Exception that caused the disconnection, if any (optional)
         """
         if cause:
-            logger.info("{}: _on_mqtt_disconnect called: {}".format(self.name, cause))
+            logger.info("%s: _on_mqtt_disconnect called: %s", self.name, cause)
         else:
-            logger.info("{}: _on_mqtt_disconnect called".format(self.name))
+            logger.info("%s: _on_mqtt_disconnect called", self.name)
 
         # Send an event to tell other pipeilne stages that we're disconnected. Do this before
         # we do anything else (in case upper stages have any "are we connected" logic.)
@@ -382,7 +368,7 @@ class MQTTTransportStage(PipelineStage):
             # behaves when there is a connection error, and it also makes sense that on_mqtt_disconnected
             # would cause a pending connection op to fail.
             logger.debug(
-                "{}: completing pending {} op".format(self.name, self._pending_connection_op.name)
+                "%s: completing pending %s op", self.name, self._pending_connection_op.name
             )
             op = self._pending_connection_op
             self._cancel_connection_watchdog(op)
@@ -407,7 +393,7 @@ class MQTTTransportStage(PipelineStage):
                         error=transport_exceptions.ConnectionDroppedError("transport disconnected")
                     )
         else:
-            logger.info("{}: disconnection was unexpected".format(self.name))
+            logger.info("%s: disconnection was unexpected", self.name)
             # Regardless of cause, it is now a ConnectionDroppedError.  log it and swallow it.
             # Higher layers will see that we're disconencted and reconnect as necessary.
             e = transport_exceptions.ConnectionDroppedError(cause=cause)
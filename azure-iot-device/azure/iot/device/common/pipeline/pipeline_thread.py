@@ -83,7 +83,7 @@ def _get_named_executor(thread_name):
     """
     global _executors
     if thread_name not in _executors:
-        logger.debug("Creating {} executor".format(thread_name))
+        logger.debug("Creating %s executor", thread_name)
         _executors[thread_name] = ThreadPoolExecutor(max_workers=1)
     return _executors[thread_name]
 
@@ -105,7 +105,7 @@ def _invoke_on_executor_thread(func, thread_name, block=True):
 
     def wrapper(*args, **kwargs):
         if threading.current_thread().name is not thread_name:
-            logger.debug("Starting {} in {} thread".format(function_name, thread_name))
+            logger.debug("Starting %s in %s thread", function_name, thread_name)
 
             def thread_proc():
                 threading.current_thread().name = thread_name
@@ -137,7 +137,7 @@ def _invoke_on_executor_thread(func, thread_name, block=True):
             else:
                 return future
         else:
-            logger.debug("Already in {} thread for {}".format(thread_name, function_name))
+            logger.debug("Already in %s thread for %s", thread_name, function_name)
             return func(*args, **kwargs)
 
     # Silly hack:  On 2.7, we can't use @functools.wraps on callables don't have a __name__ attribute
@@ -180,6 +180,15 @@ def invoke_on_http_thread_nowait(func):
     return _invoke_on_executor_thread(func=func, thread_name="azure_iot_http", block=False)
 
 
+def invoke_on_sastoken_thread_nowait(func):
+    """
+    Run the decorated function on the SAS token thread, but don't wait for it to complete.
+    Signing a token can block (e.g. on a request to the IoT Edge workload API), so it gets a
+    thread of its own rather than holding up the alarm or pipeline threads.
+    """
+    return _invoke_on_executor_thread(func=func, thread_name="azure_iot_sastoken", block=False)
+
+
 def _assert_executor_thread(func, thread_name):
     """
     Decorator which asserts that the given function only gets called inside the given
@@ -0,0 +1,111 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+"""This module contains a cache of the SSLContexts used by the MQTT and HTTP transports.
+
+Creating an SSLContext parses the whole default CA bundle (or the provided server verification
+cert), and loads the client certificate chain from disk, if any. Each context also holds its own
+copy of the parsed certificates. Transports created with the same TLS settings can instead share a
+single context, so creating many clients in one process only pays for this once.
+"""
+
+import logging
+import os
+import ssl
+import threading
+import weakref
+
+logger = logging.getLogger(__name__)
+
+# Contexts are only kept while a transport is using them
+_cache = weakref.WeakValueDictionary()
+_lock = threading.Lock()
+
+
+def get_ssl_context(server_verification_cert=None, cipher=None, x509_cert=None):
+    """Return an SSLContext for the given TLS settings, creating one if there is no context for
+    those settings in use already.
+
+    The context must not be modified, as it may be shared with other transports.
+
+    :param str server_verification_cert: Certificate which can be used to validate a server-side
+        TLS connection. If not provided, the default certificates are used.
+    :param str cipher: Cipher string in OpenSSL cipher list format
+    :param x509_cert: Certificate which can be used to authenticate the connection to a server.
+    :type x509_cert: :class:`azure.iot.device.X509`
+
+    :raises: ssl.SSLError if the context could not be configured with the given settings
+    """
+    key = _make_key(server_verification_cert, cipher, x509_cert)
+    with _lock:
+        ssl_context = _cache.get(key)
+        if ssl_context is None:
+            ssl_context = create_ssl_context(server_verification_cert, cipher, x509_cert)
+            _cache[key] = ssl_context
+        else:
+            logger.debug("using cached SSL context")
+    return ssl_context
+
+
+def clear():
+    """Remove all contexts from the cache. Contexts already in use are not affected."""
+    with _lock:
+        _cache.clear()
+
+
+def create_ssl_context(server_verification_cert=None, cipher=None, x509_cert=None):
+    """Create a new SSLContext for the given TLS settings, without using the cache"""
+    logger.debug("creating a SSL context")
+    ssl_context = ssl.SSLContext(protocol=ssl.PROTOCOL_TLSv1_2)
+
+    if server_verification_cert:
+        logger.debug("configuring SSL context with custom server verification cert")
+        ssl_context.load_verify_locations(cadata=server_verification_cert)
+    else:
+        logger.debug("configuring SSL context with default certs")
+        ssl_context.load_default_certs()
+
+    if cipher:
+        try:
+            logger.debug("configuring SSL context with cipher suites")
+            ssl_context.set_ciphers(cipher)
+        except ssl.SSLError as e:
+            # TODO: custom error with more detail?
+            raise e
+
+    if x509_cert is not None:
+        logger.debug("configuring SSL context with client-side certificate and key")
+        ssl_context.load_cert_chain(
+            x509_cert.certificate_file, x509_cert.key_file, x509_cert.pass_phrase
+        )
+
+    ssl_context.verify_mode = ssl.CERT_REQUIRED
+    ssl_context.check_hostname = True
+
+    return ssl_context
+
+
+def _make_key(server_verification_cert, cipher, x509_cert):
+    if x509_cert is None:
+        x509_key = None
+    else:
+        # Include the modification times of the files, so that a certificate which has been
+        # renewed on disk is loaded again, rather than reusing the context with the old one
+        x509_key = (
+            x509_cert.certificate_file,
+            _file_version(x509_cert.certificate_file),
+            x509_cert.key_file,
+            _file_version(x509_cert.key_file),
+            x509_cert.pass_phrase,
+        )
+    return (server_verification_cert, cipher, x509_key)
+
+
+def _file_version(path):
+    try:
+        stat = os.stat(path)
+    except (OSError, TypeError, ValueError):
+        return None
+    return (stat.st_mtime, stat.st_size)
@@ -0,0 +1,139 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+"""This module contains a compact binary ring buffer for tracing events on the message hot path.
+
+Unlike logging, recording an event does no string formatting. Each event is packed into a fixed
+size record (timestamp, event code, integer argument) in a preallocated buffer, and the most
+recent events can be dumped to the log after a failure. Tracing is disabled by default, in which
+case record() returns immediately.
+"""
+
+import logging
+import struct
+import threading
+import time
+
+logger = logging.getLogger(__name__)
+
+DEFAULT_CAPACITY = 1024
+
+# Event codes
+CONNECT = 1
+DISCONNECT = 2
+PUBLISH = 3
+PUBACK = 4
+SUBSCRIBE = 5
+SUBACK = 6
+UNSUBSCRIBE = 7
+UNSUBACK = 8
+MESSAGE_RECEIVED = 9
+
+event_names = {
+    CONNECT: "CONNECT",
+    DISCONNECT: "DISCONNECT",
+    PUBLISH: "PUBLISH",
+    PUBACK: "PUBACK",
+    SUBSCRIBE: "SUBSCRIBE",
+    SUBACK: "SUBACK",
+    UNSUBSCRIBE: "UNSUBSCRIBE",
+    UNSUBACK: "UNSUBACK",
+    MESSAGE_RECEIVED: "MESSAGE_RECEIVED",
+}
+
+# timestamp, event code, argument
+_record_struct = struct.Struct("<dHq")
+
+
+class TraceBuffer(object):
+    """Fixed capacity ring buffer of binary trace records. Once full, the oldest records are
+    overwritten.
+    """
+
+    def __init__(self, capacity=DEFAULT_CAPACITY):
+        if capacity <= 0:
+            raise ValueError("capacity must be a positive integer")
+        self.capacity = capacity
+        self._buffer = bytearray(_record_struct.size * capacity)
+        self._count = 0
+        self._lock = threading.Lock()
+
+    def record(self, event, arg=0):
+        with self._lock:
+            index = self._count % self.capacity
+            self._count += 1
+            _record_struct.pack_into(
+                self._buffer, index * _record_struct.size, time.time(), event, arg
+            )
+
+    def get_records(self):
+        """Return the records in the buffer, oldest first.
+
+        :returns: A list of (timestamp, event code, argument) tuples
+        """
+        with self._lock:
+            count = min(self._count, self.capacity)
+            start = self._count - count
+            return [
+                _record_struct.unpack_from(
+                    self._buffer, ((start + i) % self.capacity) * _record_struct.size
+                )
+                for i in range(count)
+            ]
+
+    def clear(self):
+        with self._lock:
+            self._count = 0
+
+
+_trace_buffer = None
+
+
+def enable(capacity=DEFAULT_CAPACITY):
+    """Start recording trace events into a new ring buffer of the given capacity"""
+    global _trace_buffer
+    _trace_buffer = TraceBuffer(capacity)
+
+
+def disable():
+    """Stop recording trace events and discard any recorded events"""
+    global _trace_buffer
+    _trace_buffer = None
+
+
+def is_enabled():
+    return _trace_buffer is not None
+
+
+def record(event, arg=0):
+    """Record a trace event. Does nothing if tracing is not enabled.
+
+    :param int event: The event code
+    :param int arg: An integer argument for the event (e.g. an MQTT message id)
+    """
+    trace_buffer = _trace_buffer
+    if trace_buffer is not None:
+        trace_buffer.record(event, arg)
+
+
+def get_records():
+    """Return the recorded trace events, oldest first, or an empty list if tracing is not enabled.
+
+    :returns: A list of (timestamp, event code, argument) tuples
+    """
+    trace_buffer = _trace_buffer
+    if trace_buffer is None:
+        return []
+    return trace_buffer.get_records()
+
+
+def dump(level=logging.INFO):
+    """Write the recorded trace events to the log, oldest first"""
+    records = get_records()
+    if not records or not logger.isEnabledFor(level):
+        return
+    logger.log(level, "Trace of the last %s events:", len(records))
+    for timestamp, event, arg in records:
+        logger.log(level, "  %.6f %s %s", timestamp, event_names.get(event, str(event)), arg)
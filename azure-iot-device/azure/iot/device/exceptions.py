@@ -20,6 +20,12 @@ class OperationCancelled(ChainableException):
     pass
 
 
+class OperationTimeout(ChainableException):
+    """An operation did not complete before its timeout"""
+
+    pass
+
+
 # ~~~ CLIENT ERRORS ~~~
 
 
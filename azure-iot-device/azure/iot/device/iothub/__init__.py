@@ -5,6 +5,15 @@ as a Device or Module.
 """
 
 from .sync_clients import IoTHubDeviceClient, IoTHubModuleClient
-from .models import Message, MethodRequest, MethodResponse
+from .client_farm import DeviceClientFarm
+from .models import Message, MethodRequest, MethodResponse, DesiredPropertiesPatch
 
-__all__ = ["IoTHubDeviceClient", "IoTHubModuleClient", "Message", "MethodRequest", "MethodResponse"]
+__all__ = [
+    "IoTHubDeviceClient",
+    "IoTHubModuleClient",
+    "DeviceClientFarm",
+    "Message",
+    "MethodRequest",
+    "MethodResponse",
+    "DesiredPropertiesPatch",
+]
@@ -13,6 +13,7 @@ import threading
 import os
 import io
 import time
+import concurrent.futures
 from . import pipeline
 from azure.iot.device.common.auth import connection_string as cs
 from azure.iot.device.common.auth import sastoken as st
@@ -35,6 +36,14 @@ def _validate_kwargs(exclude=[], **kwargs):
         "sastoken_ttl",
         "keep_alive",
         "auto_connect",
+        "twin_cache",
+        "reported_patch_coalesce_window",
+        "pending_bytes_high_watermark",
+        "pending_bytes_low_watermark",
+        "network_loop",
+        "adaptive_keep_alive",
+        "ack_timeout",
+        "handler_executor",
     ]
 
     for kwarg in kwargs:
@@ -52,6 +61,13 @@ def _get_config_kwargs(**kwargs):
         "proxy_options",
         "keep_alive",
         "auto_connect",
+        "twin_cache",
+        "reported_patch_coalesce_window",
+        "pending_bytes_high_watermark",
+        "pending_bytes_low_watermark",
+        "network_loop",
+        "adaptive_keep_alive",
+        "ack_timeout",
     ]
 
     config_kwargs = {}
@@ -61,6 +77,17 @@ def _get_config_kwargs(**kwargs):
     return config_kwargs
 
 
+def _get_client_kwargs(**kwargs):
+    """Get the subset of kwargs which pertain the client object"""
+    valid_client_kwargs = ["handler_executor"]
+
+    client_kwargs = {}
+    for kwarg in kwargs:
+        if kwarg in valid_client_kwargs:
+            client_kwargs[kwarg] = kwargs[kwarg]
+    return client_kwargs
+
+
 def _form_sas_uri(hostname, device_id, module_id=None):
     if module_id:
         return "{hostname}/devices/{device_id}/modules/{module_id}".format(
@@ -88,6 +115,20 @@ def _extract_sas_uri_values(uri):
     return d
 
 
+def _deadline_from_timeout(timeout):
+    """Convert the timeout (in seconds) passed to a client API into an operation deadline"""
+    if timeout is None:
+        return None
+    return time.time() + timeout
+
+
+def _timeout_from_deadline(deadline):
+    """Convert an operation deadline into the timeout (in seconds) left to pass to a client API"""
+    if deadline is None:
+        return None
+    return max(0, deadline - time.time())
+
+
 # Receive Type constant defs
 RECEIVE_TYPE_NONE_SET = "none_set"  # Type of receiving has not been set
 RECEIVE_TYPE_HANDLER = "handler"  # Only use handlers for receive
@@ -156,6 +197,18 @@ class AbstractIoTHubClient(object):
             else:
                 pass
 
+    def _message_feature_in_use(self, handler_name):
+        """Return True if the given handler is a message handler, and a message handler is still
+        set. The message handlers share the same feature, so it must not be disabled while either
+        of them is set.
+        """
+        if handler_name not in ("on_message_received", "on_message_batch_received"):
+            return False
+        return (
+            self._handler_manager.on_message_received is not None
+            or self._handler_manager.on_message_batch_received is not None
+        )
+
     def _replace_user_supplied_sastoken(self, sastoken_str):
         """
         Replaces the pipeline's NonRenewableSasToken with a new one based on a provided
@@ -220,8 +273,35 @@ class AbstractIoTHubClient(object):
             broker. If no other messages are being exchanged, this controls the
             rate at which the client will send ping messages to the broker.
             If not provided default value of 60 secs will be used.
+        :param bool adaptive_keep_alive: Ping the broker at the longest interval that keeps the
+            connection alive through NATs and firewalls, found by probing, with keep_alive as the
+            maximum. (Default: False)
+        :param int ack_timeout: If operations are waiting for the broker and none has been
+            acknowledged for this many seconds, treat the connection as dead and reconnect.
+            Disabled by default.
         :param bool auto_connect: Automatically connect the client to IoTHub when a method is
             invoked which requires a connection to be established. (Default: True)
+        :param bool twin_cache: Configuration Option. Default is False. Keep a local copy of the
+            twin that is updated by desired property patches, and return it from get_twin while
+            it is known to be current instead of requesting the full twin from the service.
+        :param float reported_patch_coalesce_window: Configuration Option. Default is 0
+            (disabled). Number of seconds to wait for further reported properties patches so
+            they can be merged and sent to the service as a single update. Every merged call
+            completes with the result of that single update.
+        :param int pending_bytes_high_watermark: Configuration Option. Default is None (no
+            limit). Number of bytes of messages waiting to be sent or acknowledged above which
+            the client has no capacity for further sends (see wait_for_capacity).
+        :param int pending_bytes_low_watermark: Configuration Option. Number of bytes of pending
+            messages at or below which the client has capacity again. Defaults to half of
+            pending_bytes_high_watermark.
+        :param network_loop: Configuration Option. Default is None. A network loop shared with
+            other clients to drive the connection, instead of a thread for this client alone.
+            Normally provided by a :class:`azure.iot.device.DeviceClientFarm`.
+        :type network_loop: :class:`azure.iot.device.common.mqtt_network_loop.MQTTNetworkLoop`
+        :param handler_executor: Configuration Option. Synchronous clients only. Default is None.
+            An executor shared with other clients to invoke handlers in, instead of threads for
+            this client alone. Normally provided by a :class:`azure.iot.device.DeviceClientFarm`.
+        :type handler_executor: :class:`concurrent.futures.Executor`
 
         :raises: ValueError if given an invalid connection_string.
         :raises: TypeError if given an unsupported parameter.
@@ -267,7 +347,7 @@ class AbstractIoTHubClient(object):
         http_pipeline = pipeline.HTTPPipeline(pipeline_configuration)
         mqtt_pipeline = pipeline.MQTTPipeline(pipeline_configuration)
 
-        return cls(mqtt_pipeline, http_pipeline)
+        return cls(mqtt_pipeline, http_pipeline, **_get_client_kwargs(**kwargs))
 
     @classmethod
     def create_from_sastoken(cls, sastoken, **kwargs):
@@ -291,8 +371,35 @@ class AbstractIoTHubClient(object):
             broker. If no other messages are being exchanged, this controls the
             rate at which the client will send ping messages to the broker.
             If not provided default value of 60 secs will be used.
+        :param bool adaptive_keep_alive: Ping the broker at the longest interval that keeps the
+            connection alive through NATs and firewalls, found by probing, with keep_alive as the
+            maximum. (Default: False)
+        :param int ack_timeout: If operations are waiting for the broker and none has been
+            acknowledged for this many seconds, treat the connection as dead and reconnect.
+            Disabled by default.
         :param bool auto_connect: Automatically connect the client to IoTHub when a method is
             invoked which requires a connection to be established. (Default: True)
+        :param bool twin_cache: Configuration Option. Default is False. Keep a local copy of the
+            twin that is updated by desired property patches, and return it from get_twin while
+            it is known to be current instead of requesting the full twin from the service.
+        :param float reported_patch_coalesce_window: Configuration Option. Default is 0
+            (disabled). Number of seconds to wait for further reported properties patches so
+            they can be merged and sent to the service as a single update. Every merged call
+            completes with the result of that single update.
+        :param int pending_bytes_high_watermark: Configuration Option. Default is None (no
+            limit). Number of bytes of messages waiting to be sent or acknowledged above which
+            the client has no capacity for further sends (see wait_for_capacity).
+        :param int pending_bytes_low_watermark: Configuration Option. Number of bytes of pending
+            messages at or below which the client has capacity again. Defaults to half of
+            pending_bytes_high_watermark.
+        :param network_loop: Configuration Option. Default is None. A network loop shared with
+            other clients to drive the connection, instead of a thread for this client alone.
+            Normally provided by a :class:`azure.iot.device.DeviceClientFarm`.
+        :type network_loop: :class:`azure.iot.device.common.mqtt_network_loop.MQTTNetworkLoop`
+        :param handler_executor: Configuration Option. Synchronous clients only. Default is None.
+            An executor shared with other clients to invoke handlers in, instead of threads for
+            this client alone. Normally provided by a :class:`azure.iot.device.DeviceClientFarm`.
+        :type handler_executor: :class:`concurrent.futures.Executor`
 
         :raises: TypeError if given an unsupported parameter.
         :raises: ValueError if the sastoken parameter is invalid.
@@ -332,7 +439,7 @@ class AbstractIoTHubClient(object):
         http_pipeline = pipeline.HTTPPipeline(pipeline_configuration)
         mqtt_pipeline = pipeline.MQTTPipeline(pipeline_configuration)
 
-        return cls(mqtt_pipeline, http_pipeline)
+        return cls(mqtt_pipeline, http_pipeline, **_get_client_kwargs(**kwargs))
 
     @abc.abstractmethod
     def shutdown(self):
@@ -381,10 +488,45 @@ class AbstractIoTHubClient(object):
         """
         return self._mqtt_pipeline.connected
 
+    @property
+    def pending_ops(self):
+        """
+        Read-only property for the number of sends (messages, method responses and reported
+        properties patches) which have been started, but have not yet completed.
+        """
+        return self._mqtt_pipeline.flow_control.pending_ops
+
+    @property
+    def pending_bytes(self):
+        """
+        Read-only property for the number of bytes in the messages which have been sent, but have
+        not yet completed.
+        """
+        return self._mqtt_pipeline.flow_control.pending_bytes
+
+    @property
+    def has_capacity(self):
+        """
+        Read-only property to indicate if the client has capacity for further sends.
+
+        This is False from when the pending bytes go above pending_bytes_high_watermark, until
+        they drop to pending_bytes_low_watermark, and is always True if no high watermark was
+        configured. Sends are not refused while there is no capacity.
+        """
+        return self._mqtt_pipeline.flow_control.has_capacity
+
+    @abc.abstractmethod
+    def wait_for_capacity(self):
+        pass
+
     @abc.abstractproperty
     def on_message_received(self):
         pass
 
+    @abc.abstractproperty
+    def on_message_batch_received(self):
+        pass
+
     @abc.abstractproperty
     def on_method_request_received(self):
         pass
@@ -426,8 +568,35 @@ class AbstractIoTHubDeviceClient(AbstractIoTHubClient):
             broker. If no other messages are being exchanged, this controls the
             rate at which the client will send ping messages to the broker.
             If not provided default value of 60 secs will be used.
+        :param bool adaptive_keep_alive: Ping the broker at the longest interval that keeps the
+            connection alive through NATs and firewalls, found by probing, with keep_alive as the
+            maximum. (Default: False)
+        :param int ack_timeout: If operations are waiting for the broker and none has been
+            acknowledged for this many seconds, treat the connection as dead and reconnect.
+            Disabled by default.
         :param bool auto_connect: Automatically connect the client to IoTHub when a method is
             invoked which requires a connection to be established. (Default: True)
+        :param bool twin_cache: Configuration Option. Default is False. Keep a local copy of the
+            twin that is updated by desired property patches, and return it from get_twin while
+            it is known to be current instead of requesting the full twin from the service.
+        :param float reported_patch_coalesce_window: Configuration Option. Default is 0
+            (disabled). Number of seconds to wait for further reported properties patches so
+            they can be merged and sent to the service as a single update. Every merged call
+            completes with the result of that single update.
+        :param int pending_bytes_high_watermark: Configuration Option. Default is None (no
+            limit). Number of bytes of messages waiting to be sent or acknowledged above which
+            the client has no capacity for further sends (see wait_for_capacity).
+        :param int pending_bytes_low_watermark: Configuration Option. Number of bytes of pending
+            messages at or below which the client has capacity again. Defaults to half of
+            pending_bytes_high_watermark.
+        :param network_loop: Configuration Option. Default is None. A network loop shared with
+            other clients to drive the connection, instead of a thread for this client alone.
+            Normally provided by a :class:`azure.iot.device.DeviceClientFarm`.
+        :type network_loop: :class:`azure.iot.device.common.mqtt_network_loop.MQTTNetworkLoop`
+        :param handler_executor: Configuration Option. Synchronous clients only. Default is None.
+            An executor shared with other clients to invoke handlers in, instead of threads for
+            this client alone. Normally provided by a :class:`azure.iot.device.DeviceClientFarm`.
+        :type handler_executor: :class:`concurrent.futures.Executor`
 
         :raises: TypeError if given an unsupported parameter.
 
@@ -448,7 +617,7 @@ class AbstractIoTHubDeviceClient(AbstractIoTHubClient):
         http_pipeline = pipeline.HTTPPipeline(pipeline_configuration)
         mqtt_pipeline = pipeline.MQTTPipeline(pipeline_configuration)
 
-        return cls(mqtt_pipeline, http_pipeline)
+        return cls(mqtt_pipeline, http_pipeline, **_get_client_kwargs(**kwargs))
 
     @classmethod
     def create_from_symmetric_key(cls, symmetric_key, hostname, device_id, **kwargs):
@@ -478,8 +647,35 @@ class AbstractIoTHubDeviceClient(AbstractIoTHubClient):
             broker. If no other messages are being exchanged, this controls the
             rate at which the client will send ping messages to the broker.
             If not provided default value of 60 secs will be used.
+        :param bool adaptive_keep_alive: Ping the broker at the longest interval that keeps the
+            connection alive through NATs and firewalls, found by probing, with keep_alive as the
+            maximum. (Default: False)
+        :param int ack_timeout: If operations are waiting for the broker and none has been
+            acknowledged for this many seconds, treat the connection as dead and reconnect.
+            Disabled by default.
         :param bool auto_connect: Automatically connect the client to IoTHub when a method is
             invoked which requires a connection to be established. (Default: True)
+        :param bool twin_cache: Configuration Option. Default is False. Keep a local copy of the
+            twin that is updated by desired property patches, and return it from get_twin while
+            it is known to be current instead of requesting the full twin from the service.
+        :param float reported_patch_coalesce_window: Configuration Option. Default is 0
+            (disabled). Number of seconds to wait for further reported properties patches so
+            they can be merged and sent to the service as a single update. Every merged call
+            completes with the result of that single update.
+        :param int pending_bytes_high_watermark: Configuration Option. Default is None (no
+            limit). Number of bytes of messages waiting to be sent or acknowledged above which
+            the client has no capacity for further sends (see wait_for_capacity).
+        :param int pending_bytes_low_watermark: Configuration Option. Number of bytes of pending
+            messages at or below which the client has capacity again. Defaults to half of
+            pending_bytes_high_watermark.
+        :param network_loop: Configuration Option. Default is None. A network loop shared with
+            other clients to drive the connection, instead of a thread for this client alone.
+            Normally provided by a :class:`azure.iot.device.DeviceClientFarm`.
+        :type network_loop: :class:`azure.iot.device.common.mqtt_network_loop.MQTTNetworkLoop`
+        :param handler_executor: Configuration Option. Synchronous clients only. Default is None.
+            An executor shared with other clients to invoke handlers in, instead of threads for
+            this client alone. Normally provided by a :class:`azure.iot.device.DeviceClientFarm`.
+        :type handler_executor: :class:`concurrent.futures.Executor`
 
         :raises: TypeError if given an unsupported parameter.
         :raises: ValueError if the provided parameters are invalid.
@@ -511,7 +707,7 @@ class AbstractIoTHubDeviceClient(AbstractIoTHubClient):
         http_pipeline = pipeline.HTTPPipeline(pipeline_configuration)
         mqtt_pipeline = pipeline.MQTTPipeline(pipeline_configuration)
 
-        return cls(mqtt_pipeline, http_pipeline)
+        return cls(mqtt_pipeline, http_pipeline, **_get_client_kwargs(**kwargs))
 
     @abc.abstractmethod
     def receive_message(self):
@@ -553,8 +749,35 @@ class AbstractIoTHubModuleClient(AbstractIoTHubClient):
             broker. If no other messages are being exchanged, this controls the
             rate at which the client will send ping messages to the broker.
             If not provided default value of 60 secs will be used.
+        :param bool adaptive_keep_alive: Ping the broker at the longest interval that keeps the
+            connection alive through NATs and firewalls, found by probing, with keep_alive as the
+            maximum. (Default: False)
+        :param int ack_timeout: If operations are waiting for the broker and none has been
+            acknowledged for this many seconds, treat the connection as dead and reconnect.
+            Disabled by default.
         :param bool auto_connect: Automatically connect the client to IoTHub when a method is
             invoked which requires a connection to be established. (Default: True)
+        :param bool twin_cache: Configuration Option. Default is False. Keep a local copy of the
+            twin that is updated by desired property patches, and return it from get_twin while
+            it is known to be current instead of requesting the full twin from the service.
+        :param float reported_patch_coalesce_window: Configuration Option. Default is 0
+            (disabled). Number of seconds to wait for further reported properties patches so
+            they can be merged and sent to the service as a single update. Every merged call
+            completes with the result of that single update.
+        :param int pending_bytes_high_watermark: Configuration Option. Default is None (no
+            limit). Number of bytes of messages waiting to be sent or acknowledged above which
+            the client has no capacity for further sends (see wait_for_capacity).
+        :param int pending_bytes_low_watermark: Configuration Option. Number of bytes of pending
+            messages at or below which the client has capacity again. Defaults to half of
+            pending_bytes_high_watermark.
+        :param network_loop: Configuration Option. Default is None. A network loop shared with
+            other clients to drive the connection, instead of a thread for this client alone.
+            Normally provided by a :class:`azure.iot.device.DeviceClientFarm`.
+        :type network_loop: :class:`azure.iot.device.common.mqtt_network_loop.MQTTNetworkLoop`
+        :param handler_executor: Configuration Option. Synchronous clients only. Default is None.
+            An executor shared with other clients to invoke handlers in, instead of threads for
+            this client alone. Normally provided by a :class:`azure.iot.device.DeviceClientFarm`.
+        :type handler_executor: :class:`concurrent.futures.Executor`
 
         :raises: OSError if the IoT Edge container is not configured correctly.
         :raises: ValueError if debug variables are invalid.
@@ -567,6 +790,8 @@ class AbstractIoTHubModuleClient(AbstractIoTHubClient):
         excluded_kwargs = ["server_verification_cert"]
         _validate_kwargs(exclude=excluded_kwargs, **kwargs)
 
+        certificate_future = None
+
         # First try the regular Edge container variables
         try:
             hostname = os.environ["IOTEDGE_IOTHUBHOSTNAME"]
@@ -628,12 +853,11 @@ class AbstractIoTHubModuleClient(AbstractIoTHubClient):
                 workload_uri=workload_uri,
                 api_version=api_version,
             )
-            try:
-                server_verification_cert = hsm.get_certificate()
-            except edge_hsm.IoTEdgeError as e:
-                new_err = OSError("Unexpected failure in IoTEdge")
-                new_err.__cause__ = e
-                raise new_err
+            # Retrieve the certificate while the first SasToken is being signed below, as both
+            # are requests to the IoT Edge workload API
+            executor = concurrent.futures.ThreadPoolExecutor(max_workers=1)
+            certificate_future = executor.submit(hsm.get_certificate)
+            executor.shutdown(wait=False)
             signing_mechanism = hsm
 
         # Create SasToken
@@ -642,10 +866,24 @@ class AbstractIoTHubModuleClient(AbstractIoTHubClient):
         try:
             sastoken = st.RenewableSasToken(uri, signing_mechanism, ttl=token_ttl)
         except st.SasTokenError as e:
+            sastoken_error = e
+        else:
+            sastoken_error = None
+
+        # A failure to retrieve the certificate takes precedence over a failure to sign
+        if certificate_future:
+            try:
+                server_verification_cert = certificate_future.result()
+            except edge_hsm.IoTEdgeError as e:
+                new_err = OSError("Unexpected failure in IoTEdge")
+                new_err.__cause__ = e
+                raise new_err
+
+        if sastoken_error:
             new_err = ValueError(
                 "Could not create a SasToken using the values provided, or in the Edge environment"
             )
-            new_err.__cause__ = e
+            new_err.__cause__ = sastoken_error
             raise new_err
 
         # Pipeline Config setup
@@ -667,7 +905,7 @@ class AbstractIoTHubModuleClient(AbstractIoTHubClient):
         http_pipeline = pipeline.HTTPPipeline(pipeline_configuration)
         mqtt_pipeline = pipeline.MQTTPipeline(pipeline_configuration)
 
-        return cls(mqtt_pipeline, http_pipeline)
+        return cls(mqtt_pipeline, http_pipeline, **_get_client_kwargs(**kwargs))
 
     @classmethod
     def create_from_x509_certificate(cls, x509, hostname, device_id, module_id, **kwargs):
@@ -700,8 +938,35 @@ class AbstractIoTHubModuleClient(AbstractIoTHubClient):
             broker. If no other messages are being exchanged, this controls the
             rate at which the client will send ping messages to the broker.
             If not provided default value of 60 secs will be used.
+        :param bool adaptive_keep_alive: Ping the broker at the longest interval that keeps the
+            connection alive through NATs and firewalls, found by probing, with keep_alive as the
+            maximum. (Default: False)
+        :param int ack_timeout: If operations are waiting for the broker and none has been
+            acknowledged for this many seconds, treat the connection as dead and reconnect.
+            Disabled by default.
         :param bool auto_connect: Automatically connect the client to IoTHub when a method is
             invoked which requires a connection to be established. (Default: True)
+        :param bool twin_cache: Configuration Option. Default is False. Keep a local copy of the
+            twin that is updated by desired property patches, and return it from get_twin while
+            it is known to be current instead of requesting the full twin from the service.
+        :param float reported_patch_coalesce_window: Configuration Option. Default is 0
+            (disabled). Number of seconds to wait for further reported properties patches so
+            they can be merged and sent to the service as a single update. Every merged call
+            completes with the result of that single update.
+        :param int pending_bytes_high_watermark: Configuration Option. Default is None (no
+            limit). Number of bytes of messages waiting to be sent or acknowledged above which
+            the client has no capacity for further sends (see wait_for_capacity).
+        :param int pending_bytes_low_watermark: Configuration Option. Number of bytes of pending
+            messages at or below which the client has capacity again. Defaults to half of
+            pending_bytes_high_watermark.
+        :param network_loop: Configuration Option. Default is None. A network loop shared with
+            other clients to drive the connection, instead of a thread for this client alone.
+            Normally provided by a :class:`azure.iot.device.DeviceClientFarm`.
+        :type network_loop: :class:`azure.iot.device.common.mqtt_network_loop.MQTTNetworkLoop`
+        :param handler_executor: Configuration Option. Synchronous clients only. Default is None.
+            An executor shared with other clients to invoke handlers in, instead of threads for
+            this client alone. Normally provided by a :class:`azure.iot.device.DeviceClientFarm`.
+        :type handler_executor: :class:`concurrent.futures.Executor`
 
         :raises: TypeError if given an unsupported parameter.
 
@@ -720,7 +985,7 @@ class AbstractIoTHubModuleClient(AbstractIoTHubClient):
         # Pipeline setup
         http_pipeline = pipeline.HTTPPipeline(pipeline_configuration)
         mqtt_pipeline = pipeline.MQTTPipeline(pipeline_configuration)
-        return cls(mqtt_pipeline, http_pipeline)
+        return cls(mqtt_pipeline, http_pipeline, **_get_client_kwargs(**kwargs))
 
     @abc.abstractmethod
     def send_message_to_output(self, message, output_name):
@@ -10,17 +10,20 @@ Azure IoTHub Device SDK for Python.
 import logging
 import asyncio
 import deprecation
-from azure.iot.device.common import async_adapter
+from azure.iot.device.common import async_adapter, asyncio_compat
 from azure.iot.device.iothub.abstract_clients import (
     AbstractIoTHubClient,
     AbstractIoTHubDeviceClient,
     AbstractIoTHubModuleClient,
+    _deadline_from_timeout,
+    _timeout_from_deadline,
 )
 from azure.iot.device.iothub.models import Message
 from azure.iot.device.iothub.pipeline import constant
 from azure.iot.device.iothub.pipeline import exceptions as pipeline_exceptions
 from azure.iot.device import exceptions
 from azure.iot.device.iothub.inbox_manager import InboxManager
+from azure.iot.device.iothub import blob_upload
 from .async_inbox import AsyncClientInbox
 from . import async_handler_manager, loop_management
 from azure.iot.device import constant as device_constant
@@ -49,6 +52,10 @@ async def handle_result(callback):
         raise exceptions.ClientError(
             message="Error in the IoTHub client raised due to proxy connections.", cause=e
         )
+    except pipeline_exceptions.OperationTimeout as e:
+        raise exceptions.OperationTimeout(
+            message="Operation did not complete before its timeout", cause=e
+        )
     except pipeline_exceptions.PipelineNotRunning as e:
         raise exceptions.ClientError(message="Client has already been shut down", cause=e)
     except Exception as e:
@@ -85,11 +92,13 @@ class GenericIoTHubClient(AbstractIoTHubClient):
         self._mqtt_pipeline.on_method_request_received = self._inbox_manager.route_method_request
         self._mqtt_pipeline.on_twin_patch_received = self._inbox_manager.route_twin_patch
 
-    async def _enable_feature(self, feature_name):
+    async def _enable_feature(self, feature_name, deadline=None):
         """Enable an Azure IoT Hub feature
 
         :param feature_name: The name of the feature to enable.
             See azure.iot.device.common.pipeline.constant for possible values.
+        :param float deadline: The time (in seconds since the epoch) by which the feature must be
+            enabled (optional).
         """
         logger.info("Enabling feature:" + feature_name + "...")
         if not self._mqtt_pipeline.feature_enabled[feature_name]:
@@ -97,7 +106,7 @@ class GenericIoTHubClient(AbstractIoTHubClient):
             enable_feature_async = async_adapter.emulate_async(self._mqtt_pipeline.enable_feature)
 
             callback = async_adapter.AwaitableCallback()
-            await enable_feature_async(feature_name, callback=callback)
+            await enable_feature_async(feature_name, callback=callback, deadline=deadline)
             await handle_result(callback)
 
             logger.info("Successfully enabled feature:" + feature_name)
@@ -166,12 +175,16 @@ class GenericIoTHubClient(AbstractIoTHubClient):
         # capability for HTTP pipeline.
         logger.info("Client shutdown complete")
 
-    async def connect(self):
+    async def connect(self, timeout=None):
         """Connects the client to an Azure IoT Hub or Azure IoT Edge Hub instance.
 
         The destination is chosen based on the credentials passed via the auth_provider parameter
         that was provided when this object was initialized.
 
+        :param float timeout: The maximum number of seconds to wait for the connection (optional).
+            If it passes first, this call fails, but the client keeps trying to connect in the
+            background.
+
         :raises: :class:`azure.iot.device.exceptions.CredentialError` if credentials are invalid
             and a connection cannot be established.
         :raises: :class:`azure.iot.device.exceptions.ConnectionFailedError` if a establishing a
@@ -180,12 +193,14 @@ class GenericIoTHubClient(AbstractIoTHubClient):
             during execution.
         :raises: :class:`azure.iot.device.exceptions.ClientError` if there is an unexpected failure
             during execution.
+        :raises: :class:`azure.iot.device.exceptions.OperationTimeout` if the timeout passed
+            before the operation completed.
         """
         logger.info("Connecting to Hub...")
         connect_async = async_adapter.emulate_async(self._mqtt_pipeline.connect)
 
         callback = async_adapter.AwaitableCallback()
-        await connect_async(callback=callback)
+        await connect_async(callback=callback, deadline=_deadline_from_timeout(timeout))
         await handle_result(callback)
 
         logger.info("Successfully connected to Hub")
@@ -269,7 +284,7 @@ class GenericIoTHubClient(AbstractIoTHubClient):
 
         logger.info("Successfully reauthorized connection to Hub")
 
-    async def send_message(self, message):
+    async def send_message(self, message, timeout=None):
         """Sends a message to the default events endpoint on the Azure IoT Hub or Azure IoT Edge Hub instance.
 
         If the connection to the service has not previously been opened by a call to connect, this
@@ -278,6 +293,8 @@ class GenericIoTHubClient(AbstractIoTHubClient):
         :param message: The actual message to send. Anything passed that is not an instance of the
             Message class will be converted to Message object.
         :type message: :class:`azure.iot.device.Message` or str
+        :param float timeout: The maximum number of seconds to wait for the operation to complete
+            (optional). Once it has passed, the operation is not sent or retried, and fails.
 
         :raises: :class:`azure.iot.device.exceptions.CredentialError` if credentials are invalid
             and a connection cannot be established.
@@ -289,6 +306,8 @@ class GenericIoTHubClient(AbstractIoTHubClient):
             connected (and there is no auto-connect enabled)
         :raises: :class:`azure.iot.device.exceptions.ClientError` if there is an unexpected failure
             during execution.
+        :raises: :class:`azure.iot.device.exceptions.OperationTimeout` if the timeout passed
+            before the operation completed.
         :raises: ValueError if the message fails size validation.
         """
         if not isinstance(message, Message):
@@ -301,11 +320,47 @@ class GenericIoTHubClient(AbstractIoTHubClient):
         send_message_async = async_adapter.emulate_async(self._mqtt_pipeline.send_message)
 
         callback = async_adapter.AwaitableCallback()
-        await send_message_async(message, callback=callback)
+        await send_message_async(
+            message, callback=callback, deadline=_deadline_from_timeout(timeout)
+        )
         await handle_result(callback)
 
         logger.info("Successfully sent message to Hub")
 
+    async def wait_for_capacity(self):
+        """Wait until the client has capacity for further sends.
+
+        Messages which have been sent but not yet acknowledged (for example, while the client is
+        reconnecting) are held by the client. Sending from many tasks, or more quickly than the
+        service acknowledges, can therefore use an unbounded amount of memory during an outage.
+        Awaiting this before each send limits the pending messages to roughly
+        pending_bytes_high_watermark.
+
+        If no high watermark was configured, this returns immediately. Use asyncio.wait_for to
+        wait with a timeout.
+        """
+        flow_control = self._mqtt_pipeline.flow_control
+        if flow_control.has_capacity:
+            return
+
+        loop = asyncio_compat.get_running_loop()
+        future = asyncio_compat.create_future(loop)
+
+        def set_result():
+            # The wait may have been cancelled in the meantime
+            if not future.done():
+                future.set_result(None)
+
+        def on_capacity():
+            loop.call_soon_threadsafe(set_result)
+
+        flow_control.on_capacity(on_capacity)
+        try:
+            await future
+        finally:
+            # Don't leave the callback behind if the wait was cancelled (e.g. by asyncio.wait_for)
+            flow_control.remove_capacity_callback(on_capacity)
+
     @deprecation.deprecated(
         deprecated_in="2.3.0",
         current_version=device_constant.VERSION,
@@ -335,7 +390,7 @@ class GenericIoTHubClient(AbstractIoTHubClient):
         logger.info("Received method request")
         return method_request
 
-    async def send_method_response(self, method_response):
+    async def send_method_response(self, method_response, timeout=None):
         """Send a response to a method request via the Azure IoT Hub or Azure IoT Edge Hub.
 
         If the connection to the service has not previously been opened by a call to connect, this
@@ -343,6 +398,8 @@ class GenericIoTHubClient(AbstractIoTHubClient):
 
         :param method_response: The MethodResponse to send
         :type method_response: :class:`azure.iot.device.MethodResponse`
+        :param float timeout: The maximum number of seconds to wait for the operation to complete
+            (optional). Once it has passed, the operation is not sent or retried, and fails.
 
         :raises: :class:`azure.iot.device.exceptions.CredentialError` if credentials are invalid
             and a connection cannot be established.
@@ -354,6 +411,8 @@ class GenericIoTHubClient(AbstractIoTHubClient):
             connected (and there is no auto-connect enabled)
         :raises: :class:`azure.iot.device.exceptions.ClientError` if there is an unexpected failure
             during execution.
+        :raises: :class:`azure.iot.device.exceptions.OperationTimeout` if the timeout passed
+            before the operation completed.
         """
         logger.info("Sending method response to Hub...")
         send_method_response_async = async_adapter.emulate_async(
@@ -363,15 +422,20 @@ class GenericIoTHubClient(AbstractIoTHubClient):
         callback = async_adapter.AwaitableCallback()
 
         # TODO: maybe consolidate method_request, result and status into a new object
-        await send_method_response_async(method_response, callback=callback)
+        await send_method_response_async(
+            method_response, callback=callback, deadline=_deadline_from_timeout(timeout)
+        )
         await handle_result(callback)
 
         logger.info("Successfully sent method response to Hub")
 
-    async def get_twin(self):
+    async def get_twin(self, timeout=None):
         """
         Gets the device or module twin from the Azure IoT Hub or Azure IoT Edge Hub service.
 
+        :param float timeout: The maximum number of seconds to wait for the operation to complete
+            (optional). Once it has passed, the operation is not sent or retried, and fails.
+
         :returns: Complete Twin as a JSON dict
         :rtype: dict
 
@@ -385,21 +449,24 @@ class GenericIoTHubClient(AbstractIoTHubClient):
             connected (and there is no auto-connect enabled)
         :raises: :class:`azure.iot.device.exceptions.ClientError` if there is an unexpected failure
             during execution.
+        :raises: :class:`azure.iot.device.exceptions.OperationTimeout` if the timeout passed
+            before the operation completed.
         """
         logger.info("Getting twin")
+        deadline = _deadline_from_timeout(timeout)
 
         if not self._mqtt_pipeline.feature_enabled[constant.TWIN]:
-            await self._enable_feature(constant.TWIN)
+            await self._enable_feature(constant.TWIN, deadline=deadline)
 
         get_twin_async = async_adapter.emulate_async(self._mqtt_pipeline.get_twin)
 
         callback = async_adapter.AwaitableCallback(return_arg_name="twin")
-        await get_twin_async(callback=callback)
+        await get_twin_async(callback=callback, deadline=deadline)
         twin = await handle_result(callback)
         logger.info("Successfully retrieved twin")
         return twin
 
-    async def patch_twin_reported_properties(self, reported_properties_patch):
+    async def patch_twin_reported_properties(self, reported_properties_patch, timeout=None):
         """
         Update reported properties with the Azure IoT Hub or Azure IoT Edge Hub service.
 
@@ -408,6 +475,8 @@ class GenericIoTHubClient(AbstractIoTHubClient):
 
         :param reported_properties_patch: Twin Reported Properties patch as a JSON dict
         :type reported_properties_patch: dict
+        :param float timeout: The maximum number of seconds to wait for the operation to complete
+            (optional). Once it has passed, the operation is not sent or retried, and fails.
 
         :raises: :class:`azure.iot.device.exceptions.CredentialError` if credentials are invalid
             and a connection cannot be established.
@@ -419,18 +488,23 @@ class GenericIoTHubClient(AbstractIoTHubClient):
             connected (and there is no auto-connect enabled)
         :raises: :class:`azure.iot.device.exceptions.ClientError` if there is an unexpected failure
             during execution.
+        :raises: :class:`azure.iot.device.exceptions.OperationTimeout` if the timeout passed
+            before the operation completed.
         """
         logger.info("Patching twin reported properties")
+        deadline = _deadline_from_timeout(timeout)
 
         if not self._mqtt_pipeline.feature_enabled[constant.TWIN]:
-            await self._enable_feature(constant.TWIN)
+            await self._enable_feature(constant.TWIN, deadline=deadline)
 
         patch_twin_async = async_adapter.emulate_async(
             self._mqtt_pipeline.patch_twin_reported_properties
         )
 
         callback = async_adapter.AwaitableCallback()
-        await patch_twin_async(patch=reported_properties_patch, callback=callback)
+        await patch_twin_async(
+            patch=reported_properties_patch, callback=callback, deadline=deadline
+        )
         await handle_result(callback)
 
         logger.info("Successfully sent twin patch")
@@ -475,7 +549,11 @@ class GenericIoTHubClient(AbstractIoTHubClient):
             fut.result()
 
         # Disable the feature if necessary
-        elif new_handler is None and self._mqtt_pipeline.feature_enabled[feature_name]:
+        elif (
+            new_handler is None
+            and self._mqtt_pipeline.feature_enabled[feature_name]
+            and not self._message_feature_in_use(handler_name)
+        ):
             # We have to call this on a loop running on a different thread in order to ensure
             # the setter can be called both within a coroutine (with a running event loop) and
             # outside of a coroutine (where no event loop is currently running)
@@ -489,7 +567,9 @@ class GenericIoTHubClient(AbstractIoTHubClient):
         patch is received.
 
         The function or coroutine definition should take one positional argument (the twin patch
-        in the form of a JSON dictionary object)"""
+        in the form of a JSON dictionary object, which is a
+        :class:`azure.iot.device.DesiredPropertiesPatch`). After a reconnect, the patch only
+        contains the desired properties which changed while the client was disconnected."""
         return self._handler_manager.on_twin_desired_properties_patch_received
 
     @on_twin_desired_properties_patch_received.setter
@@ -528,6 +608,7 @@ class IoTHubDeviceClient(GenericIoTHubClient, AbstractIoTHubDeviceClient):
         """
         super().__init__(mqtt_pipeline=mqtt_pipeline, http_pipeline=http_pipeline)
         self._mqtt_pipeline.on_c2d_message_received = self._inbox_manager.route_c2d_message
+        self._mqtt_pipeline.on_c2d_messages_received = self._inbox_manager.route_c2d_messages
 
     @deprecation.deprecated(
         deprecated_in="2.3.0",
@@ -553,25 +634,32 @@ class IoTHubDeviceClient(GenericIoTHubClient, AbstractIoTHubDeviceClient):
         logger.info("Message received")
         return message
 
-    async def get_storage_info_for_blob(self, blob_name):
+    async def get_storage_info_for_blob(self, blob_name, timeout=None):
         """Sends a POST request over HTTP to an IoTHub endpoint that will return information for uploading via the Azure Storage Account linked to the IoTHub your device is connected to.
 
         :param str blob_name: The name in string format of the blob that will be uploaded using the storage API. This name will be used to generate the proper credentials for Storage, and needs to match what will be used with the Azure Storage SDK to perform the blob upload.
+        :param float timeout: The maximum number of seconds to wait for the operation to complete
+            (optional). Once it has passed, the operation is not sent or retried, and fails.
 
         :returns: A JSON-like (dictionary) object from IoT Hub that will contain relevant information including: correlationId, hostName, containerName, blobName, sasToken.
+
+        :raises: :class:`azure.iot.device.exceptions.OperationTimeout` if the timeout passed
+            before the operation completed.
         """
         get_storage_info_for_blob_async = async_adapter.emulate_async(
             self._http_pipeline.get_storage_info_for_blob
         )
 
         callback = async_adapter.AwaitableCallback(return_arg_name="storage_info")
-        await get_storage_info_for_blob_async(blob_name=blob_name, callback=callback)
+        await get_storage_info_for_blob_async(
+            blob_name=blob_name, callback=callback, deadline=_deadline_from_timeout(timeout)
+        )
         storage_info = await handle_result(callback)
         logger.info("Successfully retrieved storage_info")
         return storage_info
 
     async def notify_blob_upload_status(
-        self, correlation_id, is_success, status_code, status_description
+        self, correlation_id, is_success, status_code, status_description, timeout=None
     ):
         """When the upload is complete, the device sends a POST request to the IoT Hub endpoint with information on the status of an upload to blob attempt. This is used by IoT Hub to notify listening clients.
 
@@ -579,6 +667,11 @@ class IoTHubDeviceClient(GenericIoTHubClient, AbstractIoTHubDeviceClient):
         :param bool is_success: A boolean that indicates whether the file was uploaded successfully.
         :param int status_code: A numeric status code that is the status for the upload of the fiel to storage.
         :param str status_description: A description that corresponds to the status_code.
+        :param float timeout: The maximum number of seconds to wait for the operation to complete
+            (optional). Once it has passed, the operation is not sent or retried, and fails.
+
+        :raises: :class:`azure.iot.device.exceptions.OperationTimeout` if the timeout passed
+            before the operation completed.
         """
         notify_blob_upload_status_async = async_adapter.emulate_async(
             self._http_pipeline.notify_blob_upload_status
@@ -591,10 +684,86 @@ class IoTHubDeviceClient(GenericIoTHubClient, AbstractIoTHubDeviceClient):
             status_code=status_code,
             status_description=status_description,
             callback=callback,
+            deadline=_deadline_from_timeout(timeout),
         )
         await handle_result(callback)
         logger.info("Successfully notified blob upload status")
 
+    async def upload_file(
+        self,
+        blob_name,
+        file_path,
+        block_size=blob_upload.DEFAULT_BLOCK_SIZE,
+        max_concurrency=blob_upload.DEFAULT_MAX_CONCURRENCY,
+        manifest_path=None,
+        timeout=None,
+    ):
+        """Upload a file to the Azure Storage Account linked to the IoTHub, and notify the IoTHub
+        of the result.
+
+        The file is uploaded in blocks which are sent in parallel, so that at most
+        block_size * max_concurrency bytes of the file are held in memory at once. If a
+        manifest_path is given, an upload of the same file to the same blob which was interrupted
+        will resume from the blocks that were already uploaded. Azure Storage is reached using
+        the server_verification_cert, cipher and proxy_options the client was created with, and
+        a failed upload is reported to the IoTHub with the status code returned by Azure Storage.
+
+        :param str blob_name: The name of the blob to upload the file to.
+        :param str file_path: The path of the file to upload.
+        :param int block_size: The size in bytes of each uploaded block.
+        :param int max_concurrency: The number of blocks to upload in parallel.
+        :param str manifest_path: Path of a local file used to track upload progress so that the
+            upload can be resumed.
+        :param float timeout: The maximum number of seconds to wait for the whole upload,
+            including getting the storage info and notifying the IoTHub (optional). The IoTHub is
+            not notified of a failed upload once the timeout has passed.
+
+        :raises: :class:`azure.iot.device.exceptions.ServiceError` if Azure Storage returns an
+            error.
+        :raises: :class:`azure.iot.device.exceptions.ConnectionFailedError` if Azure Storage
+            can't be reached.
+        :raises: :class:`azure.iot.device.exceptions.OperationTimeout` if the timeout passed
+            before the upload and notification were complete.
+        """
+        deadline = _deadline_from_timeout(timeout)
+        storage_info = await self.get_storage_info_for_blob(
+            blob_name, timeout=_timeout_from_deadline(deadline)
+        )
+        # Azure Storage is reached with the same TLS and proxy settings as the IoTHub
+        pipeline_configuration = self._mqtt_pipeline.pipeline_configuration
+        uploader = blob_upload.BlobUploader(
+            blob_upload.get_blob_url(storage_info),
+            block_size=block_size,
+            max_concurrency=max_concurrency,
+            manifest_path=manifest_path,
+            server_verification_cert=pipeline_configuration.server_verification_cert,
+            cipher=pipeline_configuration.cipher,
+            proxy_options=pipeline_configuration.proxy_options,
+            deadline=deadline,
+        )
+        upload_file_async = async_adapter.emulate_async(uploader.upload_file)
+        try:
+            status_code = await upload_file_async(file_path)
+        except Exception as e:
+            logger.error("Failed to upload {} to blob {}".format(file_path, blob_name))
+            remaining = _timeout_from_deadline(deadline)
+            if remaining is None or remaining > 0:
+                await self.notify_blob_upload_status(
+                    correlation_id=storage_info["correlationId"],
+                    is_success=False,
+                    status_code=blob_upload.get_error_status_code(e),
+                    status_description=blob_upload.get_error_status_description(e),
+                    timeout=remaining,
+                )
+            raise
+        await self.notify_blob_upload_status(
+            correlation_id=storage_info["correlationId"],
+            is_success=True,
+            status_code=status_code,
+            status_description="Uploaded {}".format(blob_name),
+            timeout=_timeout_from_deadline(deadline),
+        )
+
     @property
     def on_message_received(self):
         """The handler function or coroutine that will be called when a message is received.
@@ -607,6 +776,20 @@ class IoTHubDeviceClient(GenericIoTHubClient, AbstractIoTHubDeviceClient):
     def on_message_received(self, value):
         self._generic_handler_setter("on_message_received", constant.C2D_MSG, value)
 
+    @property
+    def on_message_batch_received(self):
+        """The handler function or coroutine that will be called with the messages which have
+        been received, as an alternative to on_message_received for high message rates.
+
+        The function or coroutine definition should take one positional argument (a list of the
+        :class:`azure.iot.device.Message` objects which have arrived since the last invocation,
+        in the order they arrived). It cannot be set while on_message_received is set."""
+        return self._handler_manager.on_message_batch_received
+
+    @on_message_batch_received.setter
+    def on_message_batch_received(self, value):
+        self._generic_handler_setter("on_message_batch_received", constant.C2D_MSG, value)
+
 
 class IoTHubModuleClient(GenericIoTHubClient, AbstractIoTHubModuleClient):
     """An asynchronous module client that connects to an Azure IoT Hub or Azure IoT Edge instance.
@@ -625,8 +808,9 @@ class IoTHubModuleClient(GenericIoTHubClient, AbstractIoTHubModuleClient):
         """
         super().__init__(mqtt_pipeline=mqtt_pipeline, http_pipeline=http_pipeline)
         self._mqtt_pipeline.on_input_message_received = self._inbox_manager.route_input_message
+        self._mqtt_pipeline.on_input_messages_received = self._inbox_manager.route_input_messages
 
-    async def send_message_to_output(self, message, output_name):
+    async def send_message_to_output(self, message, output_name, timeout=None):
         """Sends an event/message to the given module output.
 
         These are outgoing events and are meant to be "output events"
@@ -638,6 +822,8 @@ class IoTHubModuleClient(GenericIoTHubClient, AbstractIoTHubModuleClient):
             instance of the Message class will be converted to Message object.
         :type message: :class:`azure.iot.device.Message` or str
         :param str output_name: Name of the output to send the event to.
+        :param float timeout: The maximum number of seconds to wait for the operation to complete
+            (optional). Once it has passed, the operation is not sent or retried, and fails.
 
         :raises: :class:`azure.iot.device.exceptions.CredentialError` if credentials are invalid
             and a connection cannot be established.
@@ -649,6 +835,8 @@ class IoTHubModuleClient(GenericIoTHubClient, AbstractIoTHubModuleClient):
             connected (and there is no auto-connect enabled)
         :raises: :class:`azure.iot.device.exceptions.ClientError` if there is an unexpected failure
             during execution.
+        :raises: :class:`azure.iot.device.exceptions.OperationTimeout` if the timeout passed
+            before the operation completed.
         :raises: ValueError if the message fails size validation.
         """
         if not isinstance(message, Message):
@@ -665,7 +853,9 @@ class IoTHubModuleClient(GenericIoTHubClient, AbstractIoTHubModuleClient):
         )
 
         callback = async_adapter.AwaitableCallback()
-        await send_output_message_async(message, callback=callback)
+        await send_output_message_async(
+            message, callback=callback, deadline=_deadline_from_timeout(timeout)
+        )
         await handle_result(callback)
 
         logger.info("Successfully sent message to output: " + output_name)
@@ -696,16 +886,21 @@ class IoTHubModuleClient(GenericIoTHubClient, AbstractIoTHubModuleClient):
         logger.info("Input message received on: " + input_name)
         return message
 
-    async def invoke_method(self, method_params, device_id, module_id=None):
+    async def invoke_method(self, method_params, device_id, module_id=None, timeout=None):
         """Invoke a method from your client onto a device or module client, and receive the response to the method call.
 
         :param dict method_params: Should contain a methodName (str), payload (str),
             connectTimeoutInSeconds (int), responseTimeoutInSeconds (int).
         :param str device_id: Device ID of the target device where the method will be invoked.
         :param str module_id: Module ID of the target module where the method will be invoked. (Optional)
+        :param float timeout: The maximum number of seconds to wait for the operation to complete
+            (optional). Once it has passed, the operation is not sent or retried, and fails.
 
         :returns: method_result should contain a status, and a payload
         :rtype: dict
+
+        :raises: :class:`azure.iot.device.exceptions.OperationTimeout` if the timeout passed
+            before the operation completed.
         """
         logger.info(
             "Invoking {} method on {}{}".format(method_params["methodName"], device_id, module_id)
@@ -713,7 +908,13 @@ class IoTHubModuleClient(GenericIoTHubClient, AbstractIoTHubModuleClient):
 
         invoke_method_async = async_adapter.emulate_async(self._http_pipeline.invoke_method)
         callback = async_adapter.AwaitableCallback(return_arg_name="invoke_method_response")
-        await invoke_method_async(device_id, method_params, callback=callback, module_id=module_id)
+        await invoke_method_async(
+            device_id,
+            method_params,
+            callback=callback,
+            module_id=module_id,
+            deadline=_deadline_from_timeout(timeout),
+        )
 
         method_response = await handle_result(callback)
         logger.info("Successfully invoked method")
@@ -730,3 +931,17 @@ class IoTHubModuleClient(GenericIoTHubClient, AbstractIoTHubModuleClient):
     @on_message_received.setter
     def on_message_received(self, value):
         self._generic_handler_setter("on_message_received", constant.INPUT_MSG, value)
+
+    @property
+    def on_message_batch_received(self):
+        """The handler function or coroutine that will be called with the input messages which
+        have been received, as an alternative to on_message_received for high message rates.
+
+        The function or coroutine definition should take one positional argument (a list of the
+        :class:`azure.iot.device.Message` objects which have arrived since the last invocation,
+        in the order they arrived). It cannot be set while on_message_received is set."""
+        return self._handler_manager.on_message_batch_received
+
+    @on_message_batch_received.setter
+    def on_message_batch_received(self, value):
+        self._generic_handler_setter("on_message_batch_received", constant.INPUT_MSG, value)
@@ -15,6 +15,7 @@ from azure.iot.device.iothub.sync_handler_manager import (
     AbstractHandlerManager,
     HandlerManagerException,
     HandlerRunnerKillerSentinel,
+    MESSAGE_BATCH,
 )
 from . import loop_management
 
@@ -72,6 +73,10 @@ class AsyncHandlerManager(AbstractHandlerManager):
                 )
                 tpe.shutdown()
                 break
+            found_sentinel = False
+            if handler_name == MESSAGE_BATCH:
+                # Deliver everything which has arrived in one invocation
+                handler_arg, found_sentinel = self._get_batch(inbox.get_nowait, handler_arg)
             # NOTE: we MUST use getattr here using the handler name, as opposed to directly passing
             # the handler in order for the handler to be able to be updated without cancelling
             # the running task created for this coroutine
@@ -87,6 +92,14 @@ class AsyncHandlerManager(AbstractHandlerManager):
                 # Run function directly in ThreadPool
                 fut = tpe.submit(handler, handler_arg)
                 fut.add_done_callback(_handler_callback)
+            if found_sentinel:
+                logger.debug(
+                    "HANDLER RUNNER ({}): HandlerRunnerKillerSentinel found in inbox. Exiting.".format(
+                        handler_name
+                    )
+                )
+                tpe.shutdown()
+                break
 
     async def _event_handler_runner(self, handler_name):
         # TODO: implement
@@ -7,7 +7,7 @@
 import asyncio
 import threading
 import janus
-from azure.iot.device.iothub.sync_inbox import AbstractInbox
+from azure.iot.device.iothub.sync_inbox import AbstractInbox, InboxEmpty
 from . import loop_management
 
 # IMPLEMENTATION NOTE: The janus Queue exists entirely on the "client internal loop",
@@ -56,6 +56,18 @@ class AsyncClientInbox(AbstractInbox):
         """
         self._queue.sync_q.put(item)
 
+    def _put_many(self, items):
+        """Put multiple items into the Inbox, in order.
+
+        Only to be used by the InboxManager.
+
+        :param list items: The items to be put in the Inbox.
+        """
+        # janus has no public way to put several items at once, and its internals are not relied
+        # on for this.  The queue is unbounded, so putting never has to wait for a free slot.
+        for item in items:
+            self._queue.sync_q.put_nowait(item)
+
     async def get(self):
         """Remove and return an item from the Inbox.
 
@@ -67,6 +79,18 @@ class AsyncClientInbox(AbstractInbox):
         fut = asyncio.run_coroutine_threadsafe(self._queue.async_q.get(), loop)
         return await asyncio.wrap_future(fut)
 
+    def get_nowait(self):
+        """Remove and return an item from the Inbox, without waiting.
+
+        :raises: InboxEmpty if the Inbox is empty
+
+        :returns: An item from the Inbox.
+        """
+        try:
+            return self._queue.sync_q.get_nowait()
+        except janus.SyncQueueEmpty:
+            raise InboxEmpty("Inbox is empty")
+
     def empty(self):
         """Returns True if the inbox is empty, False otherwise
 
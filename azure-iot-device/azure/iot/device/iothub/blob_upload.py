@@ -0,0 +1,424 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+"""This module contains an engine for uploading files to the Azure Storage blob provided by
+IoTHub for file upload.
+
+Files are uploaded as a block blob, in fixed size blocks (Put Block) which are sent in parallel,
+and then committed all at once (Put Block List). Only a bounded number of blocks are held in
+memory at any time. If a manifest path is given, the indices of blocks which have been uploaded
+are recorded there as they complete, so that an upload interrupted by a crash or a lost
+connection can be resumed without re-sending those blocks.
+"""
+
+import base64
+import concurrent.futures
+import json
+import logging
+import os
+import threading
+import time
+import requests
+import socks
+from six.moves import urllib
+from xml.sax.saxutils import escape
+from azure.iot.device import exceptions
+from azure.iot.device.common import ssl_context_cache
+
+logger = logging.getLogger(__name__)
+
+DEFAULT_BLOCK_SIZE = 4 * 1024 * 1024
+DEFAULT_MAX_CONCURRENCY = 4
+DEFAULT_MAX_RETRIES = 5
+DEFAULT_TIMEOUT = 60
+
+# Azure Storage limit on the number of blocks in a block blob
+MAX_BLOCKS = 50000
+
+STORAGE_API_VERSION = "2019-12-12"
+
+# Status codes from Azure Storage which are worth retrying
+RETRYABLE_STATUS_CODES = [408, 429, 500, 502, 503, 504]
+
+# Status code reported for a failed upload which did not get an error response from Azure Storage
+# (e.g. because it could not be reached)
+DEFAULT_ERROR_STATUS_CODE = 500
+
+_proxy_schemes = {socks.HTTP: "http", socks.SOCKS4: "socks4", socks.SOCKS5: "socks5h"}
+
+
+def get_blob_url(storage_info, scheme="https"):
+    """Build the SAS URL of the blob described by a storage_info object returned from
+    get_storage_info_for_blob.
+
+    :param dict storage_info: The storage_info returned by get_storage_info_for_blob
+    :param str scheme: The URL scheme to use
+    :returns: The blob URL, including the SAS token
+    """
+    return "{scheme}://{host}/{container}/{blob}{sas}".format(
+        scheme=scheme,
+        host=storage_info["hostName"],
+        container=storage_info["containerName"],
+        blob=urllib.parse.quote(storage_info["blobName"]),
+        sas=storage_info["sasToken"],
+    )
+
+
+def get_error_status_code(error):
+    """Return the status code to report to the IoTHub for an upload which failed with an error.
+
+    :param error: The error raised by BlobUploader.upload_file
+    :returns: The status code of the error response from Azure Storage, or
+        DEFAULT_ERROR_STATUS_CODE if there was no error response
+    """
+    response = getattr(error.__cause__, "response", None)
+    if response is None:
+        return DEFAULT_ERROR_STATUS_CODE
+    return response.status_code
+
+
+def get_error_status_description(error):
+    """Return the status description to report to the IoTHub for an upload which failed with an
+    error.
+
+    :param error: The error raised by BlobUploader.upload_file
+    :returns: A description of the error, which does not include the local path of the file
+    """
+    if isinstance(error, EnvironmentError):
+        # Errors reading the file name its local path
+        return "Unable to read the file to upload"
+    return str(error)
+
+
+def _get_proxies(proxy_options):
+    """Convert ProxyOptions to a proxies dict for requests"""
+    if proxy_options is None:
+        return None
+    credentials = ""
+    if proxy_options.proxy_username:
+        credentials = urllib.parse.quote(proxy_options.proxy_username, safe="")
+        if proxy_options.proxy_password:
+            credentials += ":" + urllib.parse.quote(proxy_options.proxy_password, safe="")
+        credentials += "@"
+    proxy_url = "{scheme}://{credentials}{address}:{port}".format(
+        scheme=_proxy_schemes[proxy_options.proxy_type],
+        credentials=credentials,
+        address=proxy_options.proxy_address,
+        port=proxy_options.proxy_port,
+    )
+    return {"http": proxy_url, "https": proxy_url}
+
+
+class _SSLContextAdapter(requests.adapters.HTTPAdapter):
+    """HTTPAdapter which makes its TLS connections with the given SSLContext"""
+
+    def __init__(self, ssl_context, **kwargs):
+        # Set before calling the base initializer, which creates the pool manager
+        self._ssl_context = ssl_context
+        super(_SSLContextAdapter, self).__init__(**kwargs)
+
+    def init_poolmanager(self, *args, **kwargs):
+        kwargs["ssl_context"] = self._ssl_context
+        return super(_SSLContextAdapter, self).init_poolmanager(*args, **kwargs)
+
+    def proxy_manager_for(self, *args, **kwargs):
+        kwargs["ssl_context"] = self._ssl_context
+        return super(_SSLContextAdapter, self).proxy_manager_for(*args, **kwargs)
+
+
+def _get_block_id(index):
+    # All block ids in a blob must be the same length
+    return base64.b64encode("block-{:08d}".format(index).encode("utf-8")).decode("utf-8")
+
+
+def _replace_file(src, dst):
+    # os.replace is not available on Python 2.7
+    if hasattr(os, "replace"):
+        os.replace(src, dst)
+    else:
+        if os.path.exists(dst):
+            os.remove(dst)
+        os.rename(src, dst)
+
+
+class BlobUploader(object):
+    """Uploads a file to a block blob in parallel blocks.
+
+    A BlobUploader is used for a single upload to a single blob URL, and is not reusable.
+    """
+
+    def __init__(
+        self,
+        blob_url,
+        block_size=DEFAULT_BLOCK_SIZE,
+        max_concurrency=DEFAULT_MAX_CONCURRENCY,
+        manifest_path=None,
+        max_retries=DEFAULT_MAX_RETRIES,
+        timeout=DEFAULT_TIMEOUT,
+        server_verification_cert=None,
+        cipher=None,
+        proxy_options=None,
+        deadline=None,
+    ):
+        """Initializer for a BlobUploader
+
+        :param str blob_url: The URL of the blob, including the SAS token.
+        :param int block_size: The size in bytes of each block. At most max_concurrency blocks
+            are held in memory at once.
+        :param int max_concurrency: The number of blocks to upload in parallel.
+        :param str manifest_path: Path of a local file used to record uploaded blocks, so an
+            interrupted upload of the same file to the same blob can be resumed. If None, the
+            upload can't be resumed.
+        :param int max_retries: The number of times to retry a request that fails with a
+            connection error or a transient error from Azure Storage.
+        :param int timeout: The timeout in seconds for each request.
+        :param str server_verification_cert: Certificate which can be used to validate the
+            server-side TLS connection to Azure Storage (optional).
+        :param str cipher: Cipher string in OpenSSL cipher list format (optional).
+        :param proxy_options: Options for sending requests through a proxy server (optional).
+        :type proxy_options: :class:`azure.iot.device.ProxyOptions`
+        :param float deadline: The time (in seconds since the epoch) by which the upload must be
+            complete (optional). No request is made or retried after it, and each request's
+            timeout is cut short so as not to wait past it.
+        """
+        if block_size <= 0:
+            raise ValueError("block_size must be a positive integer")
+        if max_concurrency <= 0:
+            raise ValueError("max_concurrency must be a positive integer")
+        self.blob_url = blob_url
+        self.block_size = block_size
+        self.max_concurrency = max_concurrency
+        self.manifest_path = manifest_path
+        self.max_retries = max_retries
+        self.timeout = timeout
+        self.deadline = deadline
+
+        self._proxies = _get_proxies(proxy_options)
+        self._session = requests.Session()
+        if server_verification_cert or cipher:
+            # The context is not shared with the other transports, since urllib3 adds the
+            # default CA bundle to it
+            ssl_context = ssl_context_cache.create_ssl_context(
+                server_verification_cert=server_verification_cert, cipher=cipher
+            )
+            adapter = _SSLContextAdapter(ssl_context, pool_maxsize=max_concurrency)
+        else:
+            adapter = requests.adapters.HTTPAdapter(pool_maxsize=max_concurrency)
+        self._session.mount("http://", adapter)
+        self._session.mount("https://", adapter)
+        self._manifest_lock = threading.Lock()
+        self._manifest_file = None
+
+    def upload_file(self, file_path):
+        """Upload a file to the blob, resuming a previous upload if the manifest allows it.
+
+        :param str file_path: Path of the file to upload
+        :returns: The status code returned by Azure Storage when the block list was committed.
+        :raises: :class:`azure.iot.device.exceptions.ServiceError` if Azure Storage returns an
+            error.
+        :raises: :class:`azure.iot.device.exceptions.ConnectionFailedError` if Azure Storage
+            can't be reached.
+        :raises: :class:`azure.iot.device.exceptions.OperationTimeout` if the deadline passes
+            before the upload is complete.
+        """
+        file_size = os.path.getsize(file_path)
+        block_count = max(1, (file_size + self.block_size - 1) // self.block_size)
+        if block_count > MAX_BLOCKS:
+            raise ValueError(
+                "File requires {} blocks, which is more than the maximum of {}. Increase block_size".format(
+                    block_count, MAX_BLOCKS
+                )
+            )
+
+        uploaded = self._open_manifest(file_path, file_size)
+        if uploaded:
+            logger.info(
+                "Resuming upload of {}: {} of {} blocks already uploaded".format(
+                    file_path, len(uploaded), block_count
+                )
+            )
+
+        try:
+            self._upload_blocks(file_path, block_count, uploaded)
+            status_code = self._put_block_list(block_count)
+        finally:
+            self._close_manifest()
+        self._remove_manifest()
+        logger.info("Uploaded {} ({} bytes) in {} blocks".format(file_path, file_size, block_count))
+        return status_code
+
+    def _upload_blocks(self, file_path, block_count, uploaded):
+        # The semaphore bounds the number of blocks read into memory and not yet uploaded
+        slots = threading.Semaphore(self.max_concurrency)
+        executor = concurrent.futures.ThreadPoolExecutor(max_workers=self.max_concurrency)
+        futures = []
+        error = []
+
+        def on_block_done(future):
+            slots.release()
+            if future.exception() and not error:
+                error.append(future.exception())
+
+        try:
+            with open(file_path, "rb") as f:
+                for index in range(block_count):
+                    if index in uploaded:
+                        continue
+                    slots.acquire()
+                    if error:
+                        # Stop reading once any block has failed
+                        slots.release()
+                        break
+                    f.seek(index * self.block_size)
+                    data = f.read(self.block_size)
+                    future = executor.submit(self._put_block, index, data)
+                    future.add_done_callback(on_block_done)
+                    futures.append(future)
+        finally:
+            executor.shutdown(wait=True)
+
+        for future in futures:
+            if future.exception():
+                raise future.exception()
+
+    def _put_block(self, index, data):
+        self._request(
+            "PUT",
+            params={"comp": "block", "blockid": _get_block_id(index)},
+            data=data,
+            headers={"Content-Length": str(len(data))},
+        )
+        self._record_uploaded_block(index)
+
+    def _put_block_list(self, block_count):
+        body = '<?xml version="1.0" encoding="utf-8"?><BlockList>{}</BlockList>'.format(
+            "".join(
+                "<Latest>{}</Latest>".format(escape(_get_block_id(index)))
+                for index in range(block_count)
+            )
+        )
+        response = self._request(
+            "PUT",
+            params={"comp": "blocklist"},
+            data=body.encode("utf-8"),
+            headers={"Content-Type": "application/xml"},
+        )
+        return response.status_code
+
+    def _request(self, method, params, data, headers):
+        headers = dict(headers)
+        headers["x-ms-version"] = STORAGE_API_VERSION
+        attempt = 0
+        while True:
+            try:
+                response = self._session.request(
+                    method,
+                    self.blob_url,
+                    params=params,
+                    data=data,
+                    headers=headers,
+                    timeout=self._get_request_timeout(),
+                    proxies=self._proxies,
+                )
+            except requests.exceptions.RequestException as e:
+                self._check_deadline(cause=e)
+                if attempt >= self.max_retries:
+                    raise exceptions.ConnectionFailedError(
+                        message="Could not connect to Azure Storage", cause=e
+                    )
+                logger.info("Request to Azure Storage failed ({}). Retrying".format(e))
+            else:
+                if response.status_code < 300:
+                    return response
+                if (
+                    response.status_code not in RETRYABLE_STATUS_CODES
+                    or attempt >= self.max_retries
+                ):
+                    raise exceptions.ServiceError(
+                        message="Azure Storage returned {}: {}".format(
+                            response.status_code, response.text
+                        ),
+                        cause=requests.exceptions.HTTPError(response=response),
+                    )
+                logger.info("Azure Storage returned {}. Retrying".format(response.status_code))
+            delay = min(2**attempt, 30)
+            if self.deadline is not None and time.time() + delay >= self.deadline:
+                raise exceptions.OperationTimeout(
+                    message="Upload would not complete before its deadline"
+                )
+            time.sleep(delay)
+            attempt += 1
+
+    def _get_request_timeout(self):
+        self._check_deadline()
+        if self.deadline is None:
+            return self.timeout
+        return min(self.timeout, self.deadline - time.time())
+
+    def _check_deadline(self, cause=None):
+        if self.deadline is not None and time.time() >= self.deadline:
+            raise exceptions.OperationTimeout(
+                message="Upload did not complete before its deadline", cause=cause
+            )
+
+    def _manifest_key(self, file_path, file_size):
+        # The SAS token changes between attempts, so the blob is identified without it
+        return {
+            "blob": self.blob_url.split("?", 1)[0],
+            "file_path": os.path.abspath(file_path),
+            "file_size": file_size,
+            "file_mtime": os.path.getmtime(file_path),
+            "block_size": self.block_size,
+        }
+
+    def _open_manifest(self, file_path, file_size):
+        """Open the manifest for recording uploaded blocks, and return the set of blocks it
+        already records for this upload.
+
+        The manifest is a line holding the JSON manifest key, followed by a line for the index of
+        each uploaded block, which is appended as the block completes.
+        """
+        if not self.manifest_path:
+            return set()
+        key = self._manifest_key(file_path, file_size)
+        uploaded = set()
+        if os.path.exists(self.manifest_path):
+            try:
+                with open(self.manifest_path, "r") as f:
+                    saved = json.loads(f.readline())
+                    if all(saved.get(k) == v for k, v in key.items()):
+                        # A line without a newline was cut short, and is not a complete record
+                        uploaded = set(int(line) for line in f if line.endswith("\n"))
+                    else:
+                        logger.info("Upload manifest is for a different upload. Starting over")
+            except (IOError, OSError, ValueError) as e:
+                logger.warning("Ignoring unreadable upload manifest ({})".format(e))
+                uploaded = set()
+
+        # Start from a compacted manifest, so that records are never appended to a cut short line
+        tmp_path = self.manifest_path + ".tmp"
+        with open(tmp_path, "w") as f:
+            f.write(json.dumps(key) + "\n")
+            f.writelines("{}\n".format(index) for index in sorted(uploaded))
+        _replace_file(tmp_path, self.manifest_path)
+        self._manifest_file = open(self.manifest_path, "a")
+        return uploaded
+
+    def _record_uploaded_block(self, index):
+        if self._manifest_file is None:
+            return
+        with self._manifest_lock:
+            self._manifest_file.write("{}\n".format(index))
+            self._manifest_file.flush()
+
+    def _close_manifest(self):
+        if self._manifest_file is not None:
+            with self._manifest_lock:
+                self._manifest_file.close()
+                self._manifest_file = None
+
+    def _remove_manifest(self):
+        if self.manifest_path and os.path.exists(self.manifest_path):
+            os.remove(self.manifest_path)
@@ -0,0 +1,141 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+"""This module contains a farm for hosting many device identities in one process"""
+
+import logging
+import threading
+import concurrent.futures
+from azure.iot.device.common.mqtt_network_loop import MQTTNetworkLoop
+from .sync_clients import IoTHubDeviceClient
+
+logger = logging.getLogger(__name__)
+
+DEFAULT_HANDLER_THREADS = 16
+
+
+class DeviceClientFarm(object):
+    """A farm of synchronous device clients, for hosting many device identities in one process.
+
+    Each client created by the farm behaves like a client created directly from
+    :class:`azure.iot.device.IoTHubDeviceClient`, but the clients share a fixed number of threads:
+
+    - The MQTT connections of all clients are driven by a fixed number of network loop threads,
+      instead of one Paho loop thread per client.
+    - The handlers of all clients are invoked in a single shared pool of threads, instead of a
+      runner thread and pool of threads per handler per client.
+
+    The pipeline and callback threads, and the alarm thread used for scheduled work such as SAS
+    token renewal, are already shared by all clients in the process. Some pipeline stages still
+    start a short-lived timer thread per client while waiting, e.g. to retry an operation, to
+    reconnect, or to time out an operation or a connection attempt, so the number of threads is
+    not fixed while many clients are waiting at once.
+
+    Network loops require Python 3.
+    """
+
+    def __init__(self, network_threads=1, handler_threads=DEFAULT_HANDLER_THREADS):
+        """Initializer for a DeviceClientFarm.
+
+        :param int network_threads: The number of threads driving the MQTT connections of the
+            clients. Clients are assigned to them in turn. Default is 1.
+        :param int handler_threads: The maximum number of handlers (of any client) that can be
+            running at the same time. Default is 16.
+        """
+        if network_threads < 1:
+            raise ValueError("network_threads must be at least 1")
+        if handler_threads < 1:
+            raise ValueError("handler_threads must be at least 1")
+        self._network_loops = [
+            MQTTNetworkLoop(name="mqtt-network-loop-{}".format(i)) for i in range(network_threads)
+        ]
+        self._handler_executor = concurrent.futures.ThreadPoolExecutor(max_workers=handler_threads)
+        self._clients = []
+        self._lock = threading.Lock()
+        self._shut_down = False
+
+    @property
+    def clients(self):
+        """A list of the clients created by the farm"""
+        with self._lock:
+            return list(self._clients)
+
+    def create_from_connection_string(self, connection_string, **kwargs):
+        """Create a device client in the farm from an IoTHub device connection string.
+
+        Takes the same options as :meth:`IoTHubDeviceClient.create_from_connection_string`
+
+        :returns: An instance of :class:`azure.iot.device.IoTHubDeviceClient`
+        """
+        return self._create(
+            IoTHubDeviceClient.create_from_connection_string, connection_string, **kwargs
+        )
+
+    def create_from_symmetric_key(self, symmetric_key, hostname, device_id, **kwargs):
+        """Create a device client in the farm that uses a symmetric key for authentication.
+
+        Takes the same options as :meth:`IoTHubDeviceClient.create_from_symmetric_key`
+
+        :returns: An instance of :class:`azure.iot.device.IoTHubDeviceClient`
+        """
+        return self._create(
+            IoTHubDeviceClient.create_from_symmetric_key,
+            symmetric_key=symmetric_key,
+            hostname=hostname,
+            device_id=device_id,
+            **kwargs
+        )
+
+    def create_from_x509_certificate(self, x509, hostname, device_id, **kwargs):
+        """Create a device client in the farm that uses an X509 certificate for authentication.
+
+        Takes the same options as :meth:`IoTHubDeviceClient.create_from_x509_certificate`
+
+        :returns: An instance of :class:`azure.iot.device.IoTHubDeviceClient`
+        """
+        return self._create(
+            IoTHubDeviceClient.create_from_x509_certificate,
+            x509=x509,
+            hostname=hostname,
+            device_id=device_id,
+            **kwargs
+        )
+
+    def _create(self, create_method, *args, **kwargs):
+        for kwarg in ["network_loop", "handler_executor"]:
+            if kwarg in kwargs:
+                raise TypeError("Unsupported keyword argument: '{}'".format(kwarg))
+        with self._lock:
+            if self._shut_down:
+                raise RuntimeError("DeviceClientFarm has been shut down")
+            network_loop = self._network_loops[len(self._clients) % len(self._network_loops)]
+            client = create_method(
+                *args,
+                network_loop=network_loop,
+                handler_executor=self._handler_executor,
+                **kwargs
+            )
+            self._clients.append(client)
+        logger.debug("DeviceClientFarm: created client %s", len(self._clients))
+        return client
+
+    def shutdown(self):
+        """Disconnect all clients in the farm, and stop the threads shared by them.
+
+        The farm and its clients cannot be used afterwards.
+        """
+        with self._lock:
+            self._shut_down = True
+            clients = list(self._clients)
+        for client in clients:
+            try:
+                client.disconnect()
+            except Exception as e:
+                # Disconnecting stops the handlers, unless it fails
+                logger.warning("DeviceClientFarm: Error disconnecting client: %s", e)
+                client._handler_manager.stop()
+        for network_loop in self._network_loops:
+            network_loop.stop()
+        self._handler_executor.shutdown()
@@ -7,8 +7,12 @@
 import logging
 import json
 import base64
+import ssl
+import threading
+import time
 import requests
 import requests_unixsocket
+import six
 from six.moves import urllib, http_client
 from azure.iot.device.common.chainable_exception import ChainableException
 from azure.iot.device.common.auth.signing_mechanism import SigningMechanism
@@ -17,6 +21,20 @@ from azure.iot.device import user_agent
 requests_unixsocket.monkeypatch()
 logger = logging.getLogger(__name__)
 
+# Maximum time, in seconds, that a trust bundle retrieved from the workload API is reused for.
+# It is reused for less time if a certificate in it expires sooner.
+TRUST_BUNDLE_MAX_AGE = 3600
+
+# Trust bundles by (workload uri, api version) -> (certificate, time the cached value expires)
+_trust_bundle_cache = {}
+_trust_bundle_cache_lock = threading.Lock()
+
+
+def clear_certificate_cache():
+    """Discard all cached trust bundles, so that they are retrieved from IoT Edge again"""
+    with _trust_bundle_cache_lock:
+        _trust_bundle_cache.clear()
+
 
 class IoTEdgeError(ChainableException):
     pass
@@ -54,11 +72,33 @@ class IoTEdgeHsm(SigningMechanism):
         Return the server verification certificate from the trust bundle that can be used to
         validate the server-side SSL TLS connection that we use to talk to Edge
 
+        The trust bundle is cached, and reused until the earliest expiry of the certificates in it
+        (or TRUST_BUNDLE_MAX_AGE, whichever is sooner).
+
         :return: The server verification certificate to use for connections to the Azure IoT Edge
         instance, as a PEM certificate in string form.
 
         :raises: IoTEdgeError if unable to retrieve the certificate.
         """
+        key = (self.workload_uri, self.api_version)
+        with _trust_bundle_cache_lock:
+            cached = _trust_bundle_cache.get(key)
+        if cached and time.time() < cached[1]:
+            logger.debug("Using cached trust bundle")
+            return cached[0]
+
+        cert = self._request_certificate()
+
+        cache_expiry = time.time() + TRUST_BUNDLE_MAX_AGE
+        cert_expiry = _get_earliest_certificate_expiry(cert)
+        if cert_expiry is not None:
+            cache_expiry = min(cache_expiry, cert_expiry)
+        with _trust_bundle_cache_lock:
+            _trust_bundle_cache[key] = (cert, cache_expiry)
+        return cert
+
+    def _request_certificate(self):
+        """Retrieve the trust bundle from the workload API, and return the certificate from it"""
         r = requests.get(
             self.workload_uri + "trust-bundle",
             params={"api-version": self.api_version},
@@ -122,6 +162,22 @@ class IoTEdgeHsm(SigningMechanism):
         return signed_data_str  # what format is this? string? bytes?
 
 
+def _get_earliest_certificate_expiry(pem):
+    """Return the earliest expiry time (in seconds since the epoch) of the CA certificates in a
+    PEM bundle, or None if it can't be determined
+    """
+    if not isinstance(pem, six.string_types):
+        return None
+    try:
+        context = ssl.SSLContext(protocol=ssl.PROTOCOL_TLSv1_2)
+        context.load_verify_locations(cadata=pem)
+        expiries = [ssl.cert_time_to_seconds(cert["notAfter"]) for cert in context.get_ca_certs()]
+    except (ssl.SSLError, ValueError, KeyError):
+        logger.debug("Unable to determine the expiry of the certificates in the trust bundle")
+        return None
+    return min(expiries) if expiries else None
+
+
 def _format_socket_uri(old_uri):
     """
     This function takes a socket URI in one form and converts it into another form.
@@ -5,6 +5,7 @@
 # --------------------------------------------------------------------------
 """This module contains a manager for inboxes."""
 
+import collections
 import logging
 
 logger = logging.getLogger(__name__)
@@ -135,6 +136,36 @@ class InboxManager(object):
                 logger.debug("Input message sent to {} inbox".format(input_name))
                 return True
 
+    def route_input_messages(self, incoming_messages):
+        """Route multiple incoming input messages, which arrived together
+
+        Messages are routed as by route_input_message, but all the messages for an Inbox are put
+        in it at once.
+
+        :param list incoming_messages: The messages to be routed, in the order they arrived.
+
+        :returns: Boolean indicating if all the messages were successfully routed or not.
+        """
+        if self.use_unified_msg_mode:
+            self.unified_message_inbox._put_many(incoming_messages)
+            return True
+        routed = collections.OrderedDict()
+        all_routed = True
+        for incoming_message in incoming_messages:
+            input_name = incoming_message.input_name
+            inbox = self.input_message_inboxes.get(input_name)
+            if inbox is None:
+                logger.warning(
+                    "No input message inbox for {} - dropping message".format(input_name)
+                )
+                all_routed = False
+            else:
+                routed.setdefault(input_name, []).append(incoming_message)
+        for input_name, messages in routed.items():
+            self.input_message_inboxes[input_name]._put_many(messages)
+            logger.debug("{} input message(s) sent to {} inbox".format(len(messages), input_name))
+        return all_routed
+
     def route_c2d_message(self, incoming_message):
         """Route an incoming C2D message
 
@@ -155,6 +186,22 @@ class InboxManager(object):
             logger.debug("C2D message sent to inbox")
             return True
 
+    def route_c2d_messages(self, incoming_messages):
+        """Route multiple incoming C2D messages, which arrived together
+
+        Messages are routed as by route_c2d_message, but are all put in the Inbox at once.
+
+        :param list incoming_messages: The messages to be routed, in the order they arrived.
+
+        :returns: Boolean indicating if all the messages were successfully routed or not.
+        """
+        if self.use_unified_msg_mode:
+            self.unified_message_inbox._put_many(incoming_messages)
+        else:
+            self.c2d_message_inbox._put_many(incoming_messages)
+            logger.debug("{} C2D message(s) sent to inbox".format(len(incoming_messages)))
+        return True
+
     def route_method_request(self, incoming_method_request):
         """Route an incoming method request to the correct method request Inbox.
 
@@ -6,8 +6,15 @@
 """This module contains a class representing messages that are sent or received.
 """
 from azure.iot.device import constant
+from azure.iot.device.common import version_compat
+from datetime import date
+import six
+import six.moves.urllib as urllib
 import sys
 
+# Property values of these types can't be changed in place, so their encoding can be cached
+_immutable_property_types = six.string_types + six.integer_types + (float, bool, date, type(None))
+
 
 class Message(object):
     """Represents a message to or from IoTHub
@@ -47,6 +54,10 @@ class Message(object):
         self.output_name = output_name
         self.input_name = None
         self._iothub_interface_id = None
+        # (properties, encoded properties) and (data, payload size) from the last time they were
+        # computed, so that they are only computed again if the message changes
+        self._encoded_properties_cache = None
+        self._payload_size_cache = None
 
     @property
     def iothub_interface_id(self):
@@ -64,14 +75,108 @@ class Message(object):
         return str(self.data)
 
     def get_size(self):
-        total = 0
-        total = total + sum(
-            sys.getsizeof(v)
-            for v in self.__dict__.values()
-            if v is not None and v is not self.custom_properties
+        """Return the size of the message as it is sent, in bytes: the size of the encoded payload
+        plus the size of the encoded system and custom properties.
+
+        :raises: ValueError if the custom properties have duplicate keys once converted to strings
+        """
+        return self._get_payload_size() + len(self.get_encoded_properties())
+
+    def _get_payload_size(self):
+        data = self.data
+        if data is None:
+            return 0
+        elif isinstance(data, (six.binary_type, bytearray)):
+            return len(data)
+        cache = self._payload_size_cache
+        if cache is not None and cache[0] is data:
+            return cache[1]
+        if isinstance(data, six.text_type):
+            size = len(data.encode("utf-8"))
+        elif isinstance(data, (six.integer_types, float)):
+            size = len(str(data))
+        else:
+            size = sys.getsizeof(data)
+        self._payload_size_cache = (data, size)
+        return size
+
+    def _get_properties(self):
+        """Return the system and custom properties, in the order they are encoded"""
+        system_properties = (
+            ("$.on", self.output_name),
+            ("$.mid", self.message_id),
+            ("$.cid", self.correlation_id),
+            ("$.uid", self.user_id),
+            ("$.ct", self.content_type),
+            ("$.ce", self.content_encoding),
+            ("$.ifid", self.iothub_interface_id),
+            ("$.exp", self.expiry_time_utc),
         )
+        # Include the types of the custom property values, as values of different types can be
+        # equal (e.g. 1 and True), but not be encoded the same
         if self.custom_properties:
-            total = total + sum(
-                sys.getsizeof(v) for v in self.custom_properties.values() if v is not None
+            custom_properties = tuple(
+                (key, type(value), value) for (key, value) in self.custom_properties.items()
             )
-        return total
+        else:
+            custom_properties = ()
+        return (system_properties, custom_properties)
+
+    def get_encoded_properties(self):
+        """Return the system and custom properties uri-encoded as key-value pairs, in the format
+        '<key>=<value>&<key2>=<value2>(...)', with the custom properties sorted by key.
+
+        The encoding is cached, and reused until a property of the message is set to a different
+        value, so that checking the size of the message and sending it only encode it once. It is
+        not cached if a property value can be modified in place (e.g. a list), since such a
+        change could not be detected.
+
+        :raises: ValueError if the custom properties have duplicate keys once converted to strings
+        """
+        properties = self._get_properties()
+        cache = self._encoded_properties_cache
+        if cache is not None and cache[0] == properties:
+            return cache[1]
+
+        system_properties, custom_properties = properties
+        system_prop_seq = []
+        for key, value in system_properties:
+            if not value:
+                continue
+            if key == "$.exp" and isinstance(value, date):
+                value = value.isoformat()
+            elif key != "$.exp":
+                value = str(value)
+            system_prop_seq.append((key, value))
+        encoded = version_compat.urlencode(system_prop_seq, quote_via=urllib.parse.quote)
+
+        if custom_properties:
+            if system_prop_seq:
+                encoded += "&"
+
+            # Convert the custom properties to a sorted list in order to ensure the
+            # resulting ordering is consistent across versions of Python.
+            # Convert to the properties to strings for safety.
+            custom_prop_seq = [(str(key), str(value)) for (key, _, value) in custom_properties]
+            custom_prop_seq.sort()
+
+            # Validate that string conversion has not created duplicate keys
+            keys = [i[0] for i in custom_prop_seq]
+            if len(keys) != len(set(keys)):
+                raise ValueError("Duplicate keys in custom properties!")
+
+            encoded += version_compat.urlencode(custom_prop_seq, quote_via=urllib.parse.quote)
+
+        system_properties_cacheable = all(
+            isinstance(value, _immutable_property_types) for (_, value) in system_properties
+        )
+        custom_properties_cacheable = all(
+            isinstance(key, _immutable_property_types)
+            and isinstance(value, _immutable_property_types)
+            for (key, _, value) in custom_properties
+        )
+        if system_properties_cacheable and custom_properties_cacheable:
+            self._encoded_properties_cache = (properties, encoded)
+        else:
+            self._encoded_properties_cache = None
+        return encoded
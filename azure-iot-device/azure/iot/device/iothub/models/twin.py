@@ -26,3 +26,32 @@ class Twin(object):
         """
         self.desiried_properties = None
         self.reported_properties = None
+
+
+class DesiredPropertiesPatch(dict):
+    """A desired properties patch, as received by the on_twin_desired_properties_patch_received
+    handler.
+
+    This is a dict holding the patch in JSON merge patch (RFC 7386) form, as sent by the service:
+    keys which are set are changed, keys set to None are removed, and '$version' is the version of
+    the desired properties after the patch is applied.
+
+    When the patch is generated by the client after a reconnect, because desired properties may
+    have changed while it was disconnected, it only holds the properties which differ from the
+    desired properties the application has already received.
+
+    :ivar json_patch: The same changes as a list of JSON patch (RFC 6902) operations, with paths
+        relative to the desired properties, e.g.
+        [{"op": "replace", "path": "/telemetryConfig/sendFrequency", "value": "5m"}],
+        or None if the desired properties the patch applies to are not known to the client.
+    :type json_patch: list or None
+    """
+
+    def __init__(self, patch, json_patch=None):
+        """Initializer for a DesiredPropertiesPatch
+
+        :param dict patch: The patch in JSON merge patch form.
+        :param list json_patch: The patch as JSON patch operations (optional).
+        """
+        super(DesiredPropertiesPatch, self).__init__(patch)
+        self.json_patch = json_patch
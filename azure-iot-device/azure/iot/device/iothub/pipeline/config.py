@@ -5,6 +5,7 @@
 # --------------------------------------------------------------------------
 
 import logging
+import six
 from azure.iot.device.common.pipeline.config import BasePipelineConfig
 
 logger = logging.getLogger(__name__)
@@ -14,7 +15,18 @@ class IoTHubPipelineConfig(BasePipelineConfig):
     """A class for storing all configurations/options for IoTHub clients in the Azure IoT Python Device Client Library.
     """
 
-    def __init__(self, hostname, device_id, module_id=None, product_info="", **kwargs):
+    def __init__(
+        self,
+        hostname,
+        device_id,
+        module_id=None,
+        product_info="",
+        twin_cache=False,
+        reported_patch_coalesce_window=0,
+        pending_bytes_high_watermark=None,
+        pending_bytes_low_watermark=None,
+        **kwargs
+    ):
         """Initializer for IoTHubPipelineConfig which passes all unrecognized keyword-args down to BasePipelineConfig
         to be evaluated. This stacked options setting is to allow for unique configuration options to exist between the
         multiple clients, while maintaining a base configuration class with shared config options.
@@ -23,6 +35,15 @@ class IoTHubPipelineConfig(BasePipelineConfig):
         :param str device_id: The device identity being used with the IoTHub
         :param str module_id: The module identity being used with the IoTHub
         :param str product_info: A custom identification string for the type of device connecting to Azure IoT Hub.
+        :param bool twin_cache: Keep a local copy of the twin, updated by desired property patches,
+            and use it to serve twin requests while it is known to be current.
+        :param float reported_patch_coalesce_window: Number of seconds to wait for additional
+            reported properties patches to merge into a single twin PATCH request. 0 disables
+            coalescing.
+        :param int pending_bytes_high_watermark: Number of bytes of pending messages above which
+            the client reports that it has no capacity for further sends. None means no limit.
+        :param int pending_bytes_low_watermark: Number of bytes of pending messages at or below
+            which the client has capacity again. Defaults to half of the high watermark.
         """
         super(IoTHubPipelineConfig, self).__init__(hostname=hostname, **kwargs)
 
@@ -33,7 +54,52 @@ class IoTHubPipelineConfig(BasePipelineConfig):
         # Product Info
         self.product_info = product_info
 
+        # Twin
+        self.twin_cache = twin_cache
+        self.reported_patch_coalesce_window = self._validate_coalesce_window(
+            reported_patch_coalesce_window
+        )
+
+        # Flow Control
+        self.pending_bytes_high_watermark = self._validate_watermark(
+            "pending_bytes_high_watermark", pending_bytes_high_watermark
+        )
+        self.pending_bytes_low_watermark = self._validate_watermark(
+            "pending_bytes_low_watermark", pending_bytes_low_watermark
+        )
+        if pending_bytes_low_watermark is not None:
+            if pending_bytes_high_watermark is None:
+                raise ValueError(
+                    "'pending_bytes_low_watermark' requires 'pending_bytes_high_watermark'"
+                )
+            if pending_bytes_low_watermark > pending_bytes_high_watermark:
+                raise ValueError(
+                    "'pending_bytes_low_watermark' cannot be greater than 'pending_bytes_high_watermark'"
+                )
+
         # Now, the parameters below are not exposed to the user via kwargs. They need to be set by manipulating the IoTHubPipelineConfig object.
         # They are not in the BasePipelineConfig because these do not apply to the provisioning client.
         self.blob_upload = False
         self.method_invoke = False
+
+    @staticmethod
+    def _validate_coalesce_window(window):
+        try:
+            window = float(window)
+        except (ValueError, TypeError):
+            raise ValueError(
+                "Invalid type for 'reported_patch_coalesce_window'. Permissible types are int and float."
+            )
+        if window < 0:
+            raise ValueError("'reported_patch_coalesce_window' cannot be negative")
+        return window
+
+    @staticmethod
+    def _validate_watermark(name, watermark):
+        if watermark is None:
+            return None
+        if isinstance(watermark, bool) or not isinstance(watermark, six.integer_types):
+            raise ValueError("Invalid type for '{}'. Permissible type is int.".format(name))
+        if watermark < 0:
+            raise ValueError("'{}' cannot be negative".format(name))
+        return watermark
@@ -53,6 +53,7 @@ class HTTPPipeline(object):
 
         self._pipeline = (
             pipeline_stages_base.PipelineRootStage(pipeline_configuration)
+            .append_stage(pipeline_stages_base.OpDeadlineStage())
             .append_stage(pipeline_stages_iothub_http.IoTHubHTTPTranslationStage())
             .append_stage(pipeline_stages_http.HTTPTransportStage())
         )
@@ -64,7 +65,7 @@ class HTTPPipeline(object):
         self._pipeline.run_op(op)
         callback.wait_for_completion()
 
-    def invoke_method(self, device_id, method_params, callback, module_id=None):
+    def invoke_method(self, device_id, method_params, callback, module_id=None, deadline=None):
         """
         Send a request to the service to invoke a method on a target device or module.
 
@@ -74,6 +75,8 @@ class HTTPPipeline(object):
             On success, this callback is called with the error=None.
             On failure, this callback is called with error set to the cause of the failure.
         :param module_id: The target module id
+        :param float deadline: The time (in seconds since the epoch) after which the operation
+            fails with OperationTimeout instead of being sent (optional).
 
         The following exceptions are not "raised", but rather returned via the "error" parameter
             when invoking "callback":
@@ -91,16 +94,16 @@ class HTTPPipeline(object):
         def on_complete(op, error):
             callback(error=error, invoke_method_response=op.method_response)
 
-        self._pipeline.run_op(
-            pipeline_ops_iothub_http.MethodInvokeOperation(
-                target_device_id=device_id,
-                target_module_id=module_id,
-                method_params=method_params,
-                callback=on_complete,
-            )
+        op = pipeline_ops_iothub_http.MethodInvokeOperation(
+            target_device_id=device_id,
+            target_module_id=module_id,
+            method_params=method_params,
+            callback=on_complete,
         )
+        op.deadline = deadline
+        self._pipeline.run_op(op)
 
-    def get_storage_info_for_blob(self, blob_name, callback):
+    def get_storage_info_for_blob(self, blob_name, callback, deadline=None):
         """
         Sends a POST request to the IoT Hub service endpoint to retrieve an object that contains information for uploading via the Storage SDK.
 
@@ -108,6 +111,8 @@ class HTTPPipeline(object):
         :param callback: callback which is called when request has been fulfilled.
             On success, this callback is called with the error=None, and the storage_info set to the information JSON received from the service.
             On failure, this callback is called with error set to the cause of the failure, and the storage_info=None.
+        :param float deadline: The time (in seconds since the epoch) after which the operation
+            fails with OperationTimeout instead of being sent (optional).
 
         The following exceptions are not "raised", but rather returned via the "error" parameter
             when invoking "callback":
@@ -125,14 +130,14 @@ class HTTPPipeline(object):
         def on_complete(op, error):
             callback(error=error, storage_info=op.storage_info)
 
-        self._pipeline.run_op(
-            pipeline_ops_iothub_http.GetStorageInfoOperation(
-                blob_name=blob_name, callback=on_complete
-            )
+        op = pipeline_ops_iothub_http.GetStorageInfoOperation(
+            blob_name=blob_name, callback=on_complete
         )
+        op.deadline = deadline
+        self._pipeline.run_op(op)
 
     def notify_blob_upload_status(
-        self, correlation_id, is_success, status_code, status_description, callback
+        self, correlation_id, is_success, status_code, status_description, callback, deadline=None
     ):
         """
         Sends a POST request to a IoT Hub service endpoint to notify the status of the Storage SDK call for a blob upload.
@@ -145,6 +150,8 @@ class HTTPPipeline(object):
         :param callback: callback which is called when request has been fulfilled.
             On success, this callback is called with the error=None.
             On failure, this callback is called with error set to the cause of the failure.
+        :param float deadline: The time (in seconds since the epoch) after which the operation
+            fails with OperationTimeout instead of being sent (optional).
 
 
         The following exceptions are not "raised", but rather returned via the "error" parameter
@@ -163,12 +170,12 @@ class HTTPPipeline(object):
         def on_complete(op, error):
             callback(error=error)
 
-        self._pipeline.run_op(
-            pipeline_ops_iothub_http.NotifyBlobUploadStatusOperation(
-                correlation_id=correlation_id,
-                is_success=is_success,
-                status_code=status_code,
-                status_description=status_description,
-                callback=on_complete,
-            )
+        op = pipeline_ops_iothub_http.NotifyBlobUploadStatusOperation(
+            correlation_id=correlation_id,
+            is_success=is_success,
+            status_code=status_code,
+            status_description=status_description,
+            callback=on_complete,
         )
+        op.deadline = deadline
+        self._pipeline.run_op(op)
@@ -6,6 +6,7 @@
 
 import logging
 import sys
+from azure.iot.device.common import handle_exceptions, flow_control
 from azure.iot.device.common.evented_callback import EventedCallback
 from azure.iot.device.common.pipeline import (
     pipeline_stages_base,
@@ -45,9 +46,20 @@ class MQTTPipeline(object):
         self.on_disconnected = None
         self.on_c2d_message_received = None
         self.on_input_message_received = None
+        # Optional handlers for runs of consecutive messages which arrive together. If not set,
+        # the messages are passed to the handlers above one at a time.
+        self.on_c2d_messages_received = None
+        self.on_input_messages_received = None
         self.on_method_request_received = None
         self.on_twin_patch_received = None
 
+        # Accounting for the sends which have not yet completed, so the client can apply flow
+        # control. Only messages count towards the pending bytes.
+        self.flow_control = flow_control.FlowControl(
+            high_watermark=pipeline_configuration.pending_bytes_high_watermark,
+            low_watermark=pipeline_configuration.pending_bytes_low_watermark,
+        )
+
         # Currently a single timeout stage and a single retry stage for MQTT retry only.
         # Later, a higher level timeout and a higher level retry stage.
         self._pipeline = (
@@ -56,6 +68,11 @@ class MQTTPipeline(object):
             #
             pipeline_stages_base.PipelineRootStage(pipeline_configuration)
             #
+            # OpDeadlineStage comes right after the root so that an op's deadline covers all of
+            # the time it spends in the pipeline, whichever stage is holding it.
+            #
+            .append_stage(pipeline_stages_base.OpDeadlineStage())
+            #
             # SasTokenRenewalStage comes near the root by default because it should be as close
             # to the top of the pipeline as possible, and does not need to be after anything.
             #
@@ -66,6 +83,19 @@ class MQTTPipeline(object):
             #
             .append_stage(pipeline_stages_iothub.EnsureDesiredPropertiesStage())
             #
+            # ReportedPropertiesCoalescingStage needs to be before TwinCacheStage and
+            # TwinRequestResponseStage so that both of those stages only ever see the single
+            # combined patch that it sends down.
+            #
+            .append_stage(pipeline_stages_iothub.ReportedPropertiesCoalescingStage())
+            #
+            # TwinCacheStage needs to be after EnsureDesiredPropertiesStage so the GetTwinOperation
+            # that EnsureDesiredPropertiesStage sends on reconnect refreshes the cache instead of
+            # being served from it.  It needs to be before TwinRequestResponseStage because it
+            # completes GetTwinOperation ops from memory when the cached twin is current.
+            #
+            .append_stage(pipeline_stages_iothub.TwinCacheStage())
+            #
             # TwinRequestResponseStage comes near the root by default because it doesn't need to be
             # after anything
             #
@@ -148,6 +178,41 @@ class MQTTPipeline(object):
             else:
                 logger.error("Dropping unknown pipeline event {}".format(event.name))
 
+        def _on_pipeline_event_batch(events):
+            # Pass runs of consecutive messages of the same type to the batch handlers (if set),
+            # and everything else to _on_pipeline_event, preserving the order of the events
+            run = []
+            run_handler = None
+            for event in events:
+                if isinstance(event, pipeline_events_iothub.C2DMessageEvent):
+                    handler = self.on_c2d_messages_received
+                elif isinstance(event, pipeline_events_iothub.InputMessageEvent):
+                    handler = self.on_input_messages_received
+                else:
+                    handler = None
+                if run and handler is not run_handler:
+                    _deliver_message_run(run_handler, run)
+                    run = []
+                if handler:
+                    run_handler = handler
+                    run.append(event.message)
+                else:
+                    _deliver_event(event)
+            if run:
+                _deliver_message_run(run_handler, run)
+
+        def _deliver_message_run(handler, messages):
+            try:
+                handler(messages)
+            except Exception as e:
+                handle_exceptions.handle_background_exception(e)
+
+        def _deliver_event(event):
+            try:
+                _on_pipeline_event(event)
+            except Exception as e:
+                handle_exceptions.handle_background_exception(e)
+
         def _on_connected():
             if self.on_connected:
                 self.on_connected()
@@ -158,6 +223,7 @@ class MQTTPipeline(object):
 
         # Set internal event handlers
         self._pipeline.on_pipeline_event_handler = _on_pipeline_event
+        self._pipeline.on_pipeline_event_batch_handler = _on_pipeline_event_batch
         self._pipeline.on_connected_handler = _on_connected
         self._pipeline.on_disconnected_handler = _on_disconnected
 
@@ -207,11 +273,13 @@ class MQTTPipeline(object):
         # TODO: Truly complete the shutdown implementation
         self._pipeline.run_op(pipeline_ops_base.ShutdownPipelineOperation(callback=on_complete))
 
-    def connect(self, callback):
+    def connect(self, callback, deadline=None):
         """
         Connect to the service.
 
         :param callback: callback which is called when the connection to the service is complete.
+        :param float deadline: The time (in seconds since the epoch) after which the operation
+            fails with OperationTimeout instead of being sent or retried (optional).
 
         :raises: :class:`azure.iot.device.iothub.pipeline.exceptions.PipelineNotRunning` if the
             pipeline has previously been shut down
@@ -230,7 +298,9 @@ class MQTTPipeline(object):
         def on_complete(op, error):
             callback(error=error)
 
-        self._pipeline.run_op(pipeline_ops_base.ConnectOperation(callback=on_complete))
+        op = pipeline_ops_base.ConnectOperation(callback=on_complete)
+        op.deadline = deadline
+        self._pipeline.run_op(op)
 
     def disconnect(self, callback):
         """
@@ -282,12 +352,14 @@ class MQTTPipeline(object):
             pipeline_ops_base.ReauthorizeConnectionOperation(callback=on_complete)
         )
 
-    def send_message(self, message, callback):
+    def send_message(self, message, callback, deadline=None):
         """
         Send a telemetry message to the service.
 
         :param message: message to send.
         :param callback: callback which is called when the message publish has been acknowledged by the service.
+        :param float deadline: The time (in seconds since the epoch) after which the operation
+            fails with OperationTimeout instead of being sent or retried (optional).
 
         :raises: :class:`azure.iot.device.iothub.pipeline.exceptions.PipelineNotRunning` if the
             pipeline has previously been shut down
@@ -303,20 +375,25 @@ class MQTTPipeline(object):
         """
         self._verify_running()
         logger.debug("Starting SendD2CMessageOperation on the pipeline")
+        size = message.get_size()
+        self.flow_control.add(size)
 
         def on_complete(op, error):
+            self.flow_control.remove(size)
             callback(error=error)
 
-        self._pipeline.run_op(
-            pipeline_ops_iothub.SendD2CMessageOperation(message=message, callback=on_complete)
-        )
+        op = pipeline_ops_iothub.SendD2CMessageOperation(message=message, callback=on_complete)
+        op.deadline = deadline
+        self._pipeline.run_op(op)
 
-    def send_output_message(self, message, callback):
+    def send_output_message(self, message, callback, deadline=None):
         """
         Send an output message to the service.
 
         :param message: message to send.
         :param callback: callback which is called when the message publish has been acknowledged by the service.
+        :param float deadline: The time (in seconds since the epoch) after which the operation
+            fails with OperationTimeout instead of being sent or retried (optional).
 
         :raises: :class:`azure.iot.device.iothub.pipeline.exceptions.PipelineNotRunning` if the
             pipeline has previously been shut down
@@ -332,20 +409,25 @@ class MQTTPipeline(object):
         """
         self._verify_running()
         logger.debug("Starting SendOutputMessageOperation on the pipeline")
+        size = message.get_size()
+        self.flow_control.add(size)
 
         def on_complete(op, error):
+            self.flow_control.remove(size)
             callback(error=error)
 
-        self._pipeline.run_op(
-            pipeline_ops_iothub.SendOutputMessageOperation(message=message, callback=on_complete)
-        )
+        op = pipeline_ops_iothub.SendOutputMessageOperation(message=message, callback=on_complete)
+        op.deadline = deadline
+        self._pipeline.run_op(op)
 
-    def send_method_response(self, method_response, callback):
+    def send_method_response(self, method_response, callback, deadline=None):
         """
         Send a method response to the service.
 
         :param method_response: the method response to send
         :param callback: callback which is called when response has been acknowledged by the service
+        :param float deadline: The time (in seconds since the epoch) after which the operation
+            fails with OperationTimeout instead of being sent or retried (optional).
 
         :raises: :class:`azure.iot.device.iothub.pipeline.exceptions.PipelineNotRunning` if the
             pipeline has previously been shut down
@@ -361,17 +443,19 @@ class MQTTPipeline(object):
         """
         self._verify_running()
         logger.debug("Starting SendMethodResponseOperation on the pipeline")
+        self.flow_control.add()
 
         def on_complete(op, error):
+            self.flow_control.remove()
             callback(error=error)
 
-        self._pipeline.run_op(
-            pipeline_ops_iothub.SendMethodResponseOperation(
-                method_response=method_response, callback=on_complete
-            )
+        op = pipeline_ops_iothub.SendMethodResponseOperation(
+            method_response=method_response, callback=on_complete
         )
+        op.deadline = deadline
+        self._pipeline.run_op(op)
 
-    def get_twin(self, callback):
+    def get_twin(self, callback, deadline=None):
         """
         Send a request for a full twin to the service.
 
@@ -379,6 +463,8 @@ class MQTTPipeline(object):
             This callback should have two parameters.  On success, this callback is called with the
             requested twin and error=None.  On failure, this callback is called with None for the
             requested win and error set to the cause of the failure.
+        :param float deadline: The time (in seconds since the epoch) after which the operation
+            fails with OperationTimeout instead of being sent or retried (optional).
 
         :raises: :class:`azure.iot.device.iothub.pipeline.exceptions.PipelineNotRunning` if the
             pipeline has previously been shut down
@@ -401,14 +487,18 @@ class MQTTPipeline(object):
             else:
                 callback(twin=op.twin)
 
-        self._pipeline.run_op(pipeline_ops_iothub.GetTwinOperation(callback=on_complete))
+        op = pipeline_ops_iothub.GetTwinOperation(callback=on_complete)
+        op.deadline = deadline
+        self._pipeline.run_op(op)
 
-    def patch_twin_reported_properties(self, patch, callback):
+    def patch_twin_reported_properties(self, patch, callback, deadline=None):
         """
         Send a patch for a twin's reported properties to the service.
 
         :param patch: the reported properties patch to send
         :param callback: callback which is called when request has been acknowledged by the service.
+        :param float deadline: The time (in seconds since the epoch) after which the operation
+            fails with OperationTimeout instead of being sent or retried (optional).
 
         :raises: :class:`azure.iot.device.iothub.pipeline.exceptions.PipelineNotRunning` if the
             pipeline has previously been shut down
@@ -424,22 +514,26 @@ class MQTTPipeline(object):
         """
         self._verify_running()
         logger.debug("Starting PatchTwinReportedPropertiesOperation on the pipeline")
+        self.flow_control.add()
 
         def on_complete(op, error):
+            self.flow_control.remove()
             callback(error=error)
 
-        self._pipeline.run_op(
-            pipeline_ops_iothub.PatchTwinReportedPropertiesOperation(
-                patch=patch, callback=on_complete
-            )
+        op = pipeline_ops_iothub.PatchTwinReportedPropertiesOperation(
+            patch=patch, callback=on_complete
         )
+        op.deadline = deadline
+        self._pipeline.run_op(op)
 
-    def enable_feature(self, feature_name, callback):
+    def enable_feature(self, feature_name, callback, deadline=None):
         """
         Enable the given feature by subscribing to the appropriate topics.
 
         :param feature_name: one of the feature name constants from constant.py
         :param callback: callback which is called when the feature is enabled
+        :param float deadline: The time (in seconds since the epoch) after which the operation
+            fails with OperationTimeout instead of being sent or retried (optional).
 
         :raises: ValueError if feature_name is invalid
         :raises: :class:`azure.iot.device.iothub.pipeline.exceptions.PipelineNotRunning` if the
@@ -467,11 +561,11 @@ class MQTTPipeline(object):
                 self.feature_enabled[feature_name] = True
             callback(error=error)
 
-        self._pipeline.run_op(
-            pipeline_ops_base.EnableFeatureOperation(
-                feature_name=feature_name, callback=on_complete
-            )
+        op = pipeline_ops_base.EnableFeatureOperation(
+            feature_name=feature_name, callback=on_complete
         )
+        op.deadline = deadline
+        self._pipeline.run_op(op)
 
     def disable_feature(self, feature_name, callback):
         """
@@ -5,9 +5,7 @@
 # --------------------------------------------------------------------------
 
 import logging
-from datetime import date
 import six.moves.urllib as urllib
-from azure.iot.device.common import version_compat
 
 logger = logging.getLogger(__name__)
 
@@ -342,65 +340,9 @@ def encode_message_properties_in_topic(message_to_send, topic):
     "devices/<deviceId>/modules/<moduleId>/messages/events/
     :return: The topic which has been uri-encoded
     """
-    system_properties = []
-    if message_to_send.output_name:
-        system_properties.append(("$.on", str(message_to_send.output_name)))
-    if message_to_send.message_id:
-        system_properties.append(("$.mid", str(message_to_send.message_id)))
-
-    if message_to_send.correlation_id:
-        system_properties.append(("$.cid", str(message_to_send.correlation_id)))
-
-    if message_to_send.user_id:
-        system_properties.append(("$.uid", str(message_to_send.user_id)))
-
-    if message_to_send.content_type:
-        system_properties.append(("$.ct", str(message_to_send.content_type)))
-
-    if message_to_send.content_encoding:
-        system_properties.append(("$.ce", str(message_to_send.content_encoding)))
-
-    if message_to_send.iothub_interface_id:
-        system_properties.append(("$.ifid", str(message_to_send.iothub_interface_id)))
-
-    if message_to_send.expiry_time_utc:
-        system_properties.append(
-            (
-                "$.exp",
-                message_to_send.expiry_time_utc.isoformat()  # returns string
-                if isinstance(message_to_send.expiry_time_utc, date)
-                else message_to_send.expiry_time_utc,
-            )
-        )
-
-    system_properties_encoded = version_compat.urlencode(
-        system_properties, quote_via=urllib.parse.quote
-    )
-    topic += system_properties_encoded
-
-    if message_to_send.custom_properties and len(message_to_send.custom_properties) > 0:
-        if system_properties and len(system_properties) > 0:
-            topic += "&"
-
-        # Convert the custom properties to a sorted list in order to ensure the
-        # resulting ordering in the topic string is consistent across versions of Python.
-        # Convert to the properties to strings for safety.
-        custom_prop_seq = [
-            (str(i[0]), str(i[1])) for i in list(message_to_send.custom_properties.items())
-        ]
-        custom_prop_seq.sort()
-
-        # Validate that string conversion has not created duplicate keys
-        keys = [i[0] for i in custom_prop_seq]
-        if len(keys) != len(set(keys)):
-            raise ValueError("Duplicate keys in custom properties!")
-
-        user_properties_encoded = version_compat.urlencode(
-            custom_prop_seq, quote_via=urllib.parse.quote
-        )
-        topic += user_properties_encoded
-
-    return topic
+    # The message caches the encoding, so it isn't repeated if it was already done to check the
+    # size of the message
+    return topic + message_to_send.get_encoded_properties()
 
 
 def _extract_properties(properties_str):
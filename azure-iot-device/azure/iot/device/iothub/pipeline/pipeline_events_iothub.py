@@ -11,6 +11,8 @@ class C2DMessageEvent(PipelineEvent):
     created by some converter stage based on a protocol-specific event
     """
 
+    __slots__ = ("message",)
+
     def __init__(self, message):
         """
         Initializer for C2DMessageEvent objects.
@@ -27,6 +29,8 @@ class InputMessageEvent(PipelineEvent):
     created by some converter stage based on a protocol-specific event
     """
 
+    __slots__ = ("message",)
+
     def __init__(self, message):
         """
         Initializer for InputMessageEvent objects.
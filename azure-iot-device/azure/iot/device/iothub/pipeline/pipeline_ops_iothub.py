@@ -3,7 +3,7 @@
 # Licensed under the MIT License. See License.txt in the project root for
 # license information.
 # --------------------------------------------------------------------------
-from azure.iot.device.common.pipeline import PipelineOperation
+from azure.iot.device.common.pipeline import PipelineOperation, pipeline_ops_base
 
 
 class SendD2CMessageOperation(PipelineOperation):
@@ -13,6 +13,8 @@ class SendD2CMessageOperation(PipelineOperation):
     This operation is in the group of IoTHub operations because it is very specific to the IoTHub client
     """
 
+    __slots__ = ("message",)
+
     def __init__(self, message, callback):
         """
         Initializer for SendD2CMessageOperation objects.
@@ -23,6 +25,7 @@ class SendD2CMessageOperation(PipelineOperation):
          has completed or failed.
         """
         super(SendD2CMessageOperation, self).__init__(callback=callback)
+        self.priority = pipeline_ops_base.PRIORITY_TELEMETRY
         self.message = message
 
 
@@ -33,6 +36,8 @@ class SendOutputMessageOperation(PipelineOperation):
     This operation is in the group of IoTHub operations because it is very specific to the IoTHub client
     """
 
+    __slots__ = ("message",)
+
     def __init__(self, message, callback):
         """
         Initializer for SendOutputMessageOperation objects.
@@ -44,6 +49,7 @@ class SendOutputMessageOperation(PipelineOperation):
          has completed or failed.
         """
         super(SendOutputMessageOperation, self).__init__(callback=callback)
+        self.priority = pipeline_ops_base.PRIORITY_TELEMETRY
         self.message = message
 
 
@@ -66,6 +72,7 @@ class SendMethodResponseOperation(PipelineOperation):
         :type callback: Function/callable
         """
         super(SendMethodResponseOperation, self).__init__(callback=callback)
+        self.priority = pipeline_ops_base.PRIORITY_METHOD_RESPONSE
         self.method_response = method_response
 
 
@@ -83,6 +90,7 @@ class GetTwinOperation(PipelineOperation):
         Initializer for GetTwinOperation objects.
         """
         super(GetTwinOperation, self).__init__(callback=callback)
+        self.priority = pipeline_ops_base.PRIORITY_TWIN
         self.twin = None
 
 
@@ -100,4 +108,5 @@ class PatchTwinReportedPropertiesOperation(PipelineOperation):
         :type patch: dict, str, int, float, bool, or None (JSON compatible values)
         """
         super(PatchTwinReportedPropertiesOperation, self).__init__(callback=callback)
+        self.priority = pipeline_ops_base.PRIORITY_TWIN
         self.patch = patch
@@ -4,8 +4,10 @@
 # license information.
 # --------------------------------------------------------------------------
 
-import json
+import copy
 import logging
+import time
+import weakref
 from azure.iot.device.common.pipeline import (
     pipeline_events_base,
     pipeline_ops_base,
@@ -13,8 +15,9 @@ from azure.iot.device.common.pipeline import (
     pipeline_thread,
 )
 from azure.iot.device import exceptions
-from azure.iot.device.common import handle_exceptions
+from azure.iot.device.common import handle_exceptions, json_codec, alarm
 from azure.iot.device.common.callable_weak_method import CallableWeakMethod
+from azure.iot.device.iothub.models import DesiredPropertiesPatch
 from . import pipeline_events_iothub, pipeline_ops_iothub
 from . import constant
 
@@ -27,10 +30,17 @@ class EnsureDesiredPropertiesStage(PipelineStage):
     It does this by sending diwn a GetTwinOperation after a connection is reestablished, and, if
     the desired properties have changed since the last time a patch was received, it will send up
     an artificial patch event to send those updated properties to the app.
+
+    The stage also keeps a copy of the desired properties as the app last saw them (from the
+    twins it gets, and the patches it passes up), so that the artificial patch only contains the
+    properties that changed.  Every patch sent up is a DesiredPropertiesPatch, which carries the
+    same changes as a list of JSON patch operations whenever the previous desired properties are
+    known.
     """
 
     def __init__(self):
         self.last_version_seen = None
+        self.last_desired_seen = None
         self.pending_get_request = None
         super(EnsureDesiredPropertiesStage, self).__init__()
 
@@ -42,12 +52,25 @@ class EnsureDesiredPropertiesStage(PipelineStage):
             # sees this -1, it will send a GetTwinOperation to refresh desired properties.
 
             if op.feature_name == constant.TWIN_PATCHES:
-                logger.debug(
-                    "{}: enabling twin patches.  setting last_version_seen".format(self.name)
-                )
+                logger.debug("%s: enabling twin patches.  setting last_version_seen", self.name)
                 self.last_version_seen = -1
+        elif isinstance(op, pipeline_ops_iothub.GetTwinOperation):
+            # The app sees the desired properties in the twin it gets, so they are the base for
+            # the next artificial patch.
+            op.add_callback(CallableWeakMethod(self, "_on_app_get_twin_complete"))
         self.send_op_down(op)
 
+    @pipeline_thread.runs_on_pipeline_thread
+    def _on_app_get_twin_complete(self, op, error):
+        if error or not isinstance(op.twin, dict) or not isinstance(op.twin.get("desired"), dict):
+            return
+        desired = op.twin["desired"]
+        # A twin retrieved before a patch may complete after it, so don't go back in versions
+        if self.last_desired_seen is not None:
+            if desired.get("$version", 0) < self.last_desired_seen.get("$version", 0):
+                return
+        self.last_desired_seen = copy.deepcopy(desired)
+
     @pipeline_thread.runs_on_pipeline_thread
     def _ensure_get_op(self):
         """
@@ -58,14 +81,14 @@ class EnsureDesiredPropertiesStage(PipelineStage):
         GetTwinOperation.
         """
         if not self.pending_get_request:
-            logger.info("{}: sending twin GET to ensure freshness".format(self.name))
+            logger.info("%s: sending twin GET to ensure freshness", self.name)
             self.pending_get_request = pipeline_ops_iothub.GetTwinOperation(
                 callback=CallableWeakMethod(self, "_on_get_twin_complete")
             )
             self.send_op_down(self.pending_get_request)
         else:
             logger.debug(
-                "{}: Outstanding twin GET already exists.  Not sending anything".format(self.name)
+                "%s: Outstanding twin GET already exists.  Not sending anything", self.name
             )
 
     @pipeline_thread.runs_on_pipeline_thread
@@ -82,35 +105,62 @@ class EnsureDesiredPropertiesStage(PipelineStage):
             # repeating this forever and might need to add logic to "give up" after some
             # number of failures, but we don't have any real reason to add that just yet.
 
-            logger.debug("{}: Twin GET failed with error {}.  Resubmitting.".format(self, error))
+            logger.debug("%s: Twin GET failed with error %s.  Resubmitting.", self, error)
             self._ensure_get_op()
         else:
-            logger.debug("{} Twin GET response received.  Checking versions".format(self))
-            new_version = op.twin["desired"]["$version"]
+            logger.debug("%s Twin GET response received.  Checking versions", self)
+            new_desired = op.twin["desired"]
+            new_version = new_desired["$version"]
             logger.debug(
-                "{}: old version = {}, new version = {}".format(
-                    self.name, self.last_version_seen, new_version
-                )
+                "%s: old version = %s, new version = %s",
+                self.name,
+                self.last_version_seen,
+                new_version,
             )
             if self.last_version_seen != new_version:
                 # The twin we received has different (presumably newer) desired properties.
                 # Make an artificial patch and send it up
 
-                logger.debug("{}: Version changed.  Sending up new patch event".format(self.name))
+                logger.debug("%s: Version changed.  Sending up new patch event", self.name)
                 self.last_version_seen = new_version
                 self.send_event_up(
-                    pipeline_events_iothub.TwinDesiredPropertiesPatchEvent(op.twin["desired"])
+                    pipeline_events_iothub.TwinDesiredPropertiesPatchEvent(
+                        self._diff_desired(new_desired)
+                    )
                 )
+            elif self.last_desired_seen is None:
+                self.last_desired_seen = copy.deepcopy(new_desired)
+
+    @pipeline_thread.runs_on_pipeline_thread
+    def _diff_desired(self, new_desired):
+        """
+        Make the artificial patch which takes the app from the desired properties it last saw to
+        `new_desired`, and remember `new_desired` as the desired properties the app has seen.
+        """
+        if self.last_desired_seen is None:
+            # We don't know what the app has seen, so all we can do is send everything
+            logger.debug("%s: No previous desired properties.  Sending all of them", self.name)
+            patch = DesiredPropertiesPatch(new_desired)
+        else:
+            merge_patch, json_patch = diff_json_objects(self.last_desired_seen, new_desired)
+            merge_patch["$version"] = new_desired["$version"]
+            logger.debug("%s: %s desired propert(ies) changed", self.name, len(json_patch))
+            patch = DesiredPropertiesPatch(merge_patch, json_patch)
+        self.last_desired_seen = copy.deepcopy(new_desired)
+        return patch
 
     @pipeline_thread.runs_on_pipeline_thread
     def _handle_pipeline_event(self, event):
         if isinstance(event, pipeline_events_iothub.TwinDesiredPropertiesPatchEvent):
             # remember the $version when we get a patch.
             version = event.patch["$version"]
-            logger.debug(
-                "{}: Desired patch received.  Saving $version={}".format(self.name, version)
-            )
+            logger.debug("%s: Desired patch received.  Saving $version=%s", self.name, version)
             self.last_version_seen = version
+            json_patch = None
+            if self.last_desired_seen is not None:
+                json_patch = []
+                apply_merge_patch(self.last_desired_seen, event.patch, json_patch=json_patch)
+            event.patch = DesiredPropertiesPatch(event.patch, json_patch)
         elif isinstance(event, pipeline_events_base.ConnectedEvent):
             # If last_version_seen is truthy, that means we've seen desired property patches
             # before (or we've enabled them at least).  If this is the case, get the twin to
@@ -121,6 +171,397 @@ class EnsureDesiredPropertiesStage(PipelineStage):
         self.send_event_up(event)
 
 
+def apply_merge_patch(target, patch, json_patch=None, path=""):
+    """
+    Apply a JSON merge patch (RFC 7386) to a dict in place.  This is the same set of rules that
+    the service uses to apply twin patches: a value of None removes the key, a dict value is
+    merged recursively into any dict already stored at that key, and any other value replaces
+    whatever was stored.
+
+    If a `json_patch` list is given, a JSON patch (RFC 6902) operation is appended to it for each
+    change the patch actually makes to `target`.  Top level keys starting with '$' (such as
+    '$version') are not included.
+    """
+    for key, value in patch.items():
+        key_path = _json_pointer(path, key)
+        record = json_patch is not None and not (not path and key.startswith("$"))
+        if value is None:
+            if key in target:
+                del target[key]
+                if record:
+                    json_patch.append({"op": "remove", "path": key_path})
+        elif isinstance(value, dict) and isinstance(target.get(key), dict):
+            apply_merge_patch(target[key], value, json_patch if record else None, key_path)
+        else:
+            old_value = target.get(key)
+            existed = key in target
+            if isinstance(value, dict):
+                target[key] = {}
+                apply_merge_patch(target[key], value)
+            else:
+                target[key] = copy.deepcopy(value)
+            if record and not (existed and _json_equal(old_value, target[key])):
+                json_patch.append(
+                    {
+                        "op": "replace" if existed else "add",
+                        "path": key_path,
+                        "value": copy.deepcopy(target[key]),
+                    }
+                )
+
+
+def diff_json_objects(old, new, path=""):
+    """
+    Compare two JSON objects (dicts), and return a JSON merge patch (RFC 7386) which turns `old`
+    into `new`, along with the same changes as a list of JSON patch (RFC 6902) operations.  Dicts
+    are compared key by key, and any other value (including lists) as a whole.  Top level keys
+    starting with '$' (such as '$version') are not compared.  Neither argument is modified.
+
+    :returns: A tuple of (merge_patch, json_patch), which are both empty if nothing changed.
+    """
+    merge_patch = {}
+    json_patch = []
+    for key in old:
+        if key not in new and (path or not key.startswith("$")):
+            merge_patch[key] = None
+            json_patch.append({"op": "remove", "path": _json_pointer(path, key)})
+    for key, new_value in new.items():
+        if not path and key.startswith("$"):
+            continue
+        key_path = _json_pointer(path, key)
+        if key not in old:
+            merge_patch[key] = new_value
+            json_patch.append({"op": "add", "path": key_path, "value": copy.deepcopy(new_value)})
+        elif isinstance(old[key], dict) and isinstance(new_value, dict):
+            child_merge_patch, child_json_patch = diff_json_objects(old[key], new_value, key_path)
+            if child_merge_patch:
+                merge_patch[key] = child_merge_patch
+                json_patch.extend(child_json_patch)
+        elif not _json_equal(old[key], new_value):
+            merge_patch[key] = new_value
+            json_patch.append(
+                {"op": "replace", "path": key_path, "value": copy.deepcopy(new_value)}
+            )
+    return merge_patch, json_patch
+
+
+def _json_pointer(path, key):
+    # RFC 6901 escaping of '~' and '/' within a reference token
+    return path + "/" + key.replace("~", "~0").replace("/", "~1")
+
+
+def _json_equal(a, b):
+    # True == 1 and 1 == 1.0 in python, but they are different JSON values
+    return type(a) is type(b) and a == b
+
+
+def combine_merge_patches(first, second):
+    """
+    Combine two JSON merge patches into a single patch with the same effect as applying `first`
+    followed by `second`.  Neither argument is modified.
+
+    :raises: ValueError if the patches can't be expressed as a single merge patch.  This happens
+        when `first` sets a key to a value that isn't an object (including None, which removes
+        it) and `second` sets that key to an object.  Applied in turn, the object replaces
+        whatever the key held before `first`, but a single merge patch would merge into it.
+    """
+    combined = copy.deepcopy(first)
+    for key, value in second.items():
+        if isinstance(value, dict):
+            if key in combined and not isinstance(combined[key], dict):
+                raise ValueError(
+                    "Cannot combine replacement of '{}' with a merge into it".format(key)
+                )
+            elif isinstance(combined.get(key), dict):
+                combined[key] = combine_merge_patches(combined[key], value)
+            else:
+                combined[key] = copy.deepcopy(value)
+        else:
+            combined[key] = copy.deepcopy(value)
+    return combined
+
+
+class ReportedPropertiesCoalescingStage(PipelineStage):
+    """
+    PipelineStage which merges reported properties patches that are submitted within a short
+    window of each other into a single twin PATCH request, when the
+    reported_patch_coalesce_window option is set in the pipeline configuration.
+
+    The first PatchTwinReportedPropertiesOperation in a window schedules an alarm.  Every patch
+    received before the alarm fires is combined into a pending patch using JSON merge patch
+    semantics, and when the alarm fires the combined patch is sent down as a single
+    PatchTwinReportedPropertiesOperation.  All of the ops that were merged are completed with the
+    result of that single operation.
+
+    Patches that aren't JSON objects, and patches that can't be combined with the pending patch,
+    cause the pending patch to be sent immediately before starting a new window.
+    """
+
+    def __init__(self):
+        super(ReportedPropertiesCoalescingStage, self).__init__()
+        self.pending_patch = None
+        self.pending_ops = []
+        self.coalesce_alarm = None
+
+    @pipeline_thread.runs_on_pipeline_thread
+    def _run_op(self, op):
+        window = self.pipeline_root.pipeline_configuration.reported_patch_coalesce_window
+
+        if isinstance(op, pipeline_ops_iothub.PatchTwinReportedPropertiesOperation) and window:
+            if not isinstance(op.patch, dict):
+                # Only JSON objects can be merged.  Keep ordering by sending anything pending
+                # first.
+                self._flush()
+                self.send_op_down(op)
+                return
+
+            if self.pending_patch is not None:
+                try:
+                    self.pending_patch = combine_merge_patches(self.pending_patch, op.patch)
+                except ValueError:
+                    logger.debug(
+                        "%s(%s): Patch conflicts with pending patch.  Flushing", self.name, op.name
+                    )
+                    self._flush()
+
+            if self.pending_patch is None:
+                self.pending_patch = copy.deepcopy(op.patch)
+                self._schedule_coalesce_alarm(window)
+
+            logger.debug(
+                "%s(%s): Added to pending reported properties patch (%s ops pending)",
+                self.name,
+                op.name,
+                len(self.pending_ops) + 1,
+            )
+            self.pending_ops.append(op)
+
+        elif isinstance(op, pipeline_ops_base.ShutdownPipelineOperation):
+            self._flush()
+            self.send_op_down(op)
+
+        else:
+            self.send_op_down(op)
+
+    @pipeline_thread.runs_on_pipeline_thread
+    def _schedule_coalesce_alarm(self, window):
+        self_weakref = weakref.ref(self)
+
+        @pipeline_thread.invoke_on_pipeline_thread_nowait
+        def on_coalesce_alarm():
+            this = self_weakref()
+            if this:
+                this.coalesce_alarm = None
+                this._flush()
+
+        self.coalesce_alarm = alarm.schedule(time.time() + window, on_coalesce_alarm)
+
+    @pipeline_thread.runs_on_pipeline_thread
+    def _flush(self):
+        """Send the pending patch (if any) down as a single operation"""
+        if self.coalesce_alarm:
+            self.coalesce_alarm.cancel()
+            self.coalesce_alarm = None
+
+        if self.pending_patch is None:
+            return
+
+        merged_ops = self.pending_ops
+        patch = self.pending_patch
+        self.pending_ops = []
+        self.pending_patch = None
+
+        @pipeline_thread.runs_on_pipeline_thread
+        def on_patch_complete(op, error):
+            for merged_op in merged_ops:
+                merged_op.complete(error=error)
+
+        logger.debug(
+            "%s: Sending reported properties patch coalesced from %s ops",
+            self.name,
+            len(merged_ops),
+        )
+        coalesced_op = pipeline_ops_iothub.PatchTwinReportedPropertiesOperation(
+            patch=patch, callback=on_patch_complete
+        )
+        # The combined patch is still wanted until the last of the merged ops expires.  If all
+        # of them have expired by now, it is not sent at all.
+        deadlines = [merged_op.deadline for merged_op in merged_ops]
+        coalesced_op.deadline = None if None in deadlines else max(deadlines)
+        self.send_op_down(coalesced_op)
+
+
+class TwinCacheStage(PipelineStage):
+    """
+    PipelineStage which keeps a local copy of the twin when the twin_cache option is set in the
+    pipeline configuration.
+
+    Desired property patches received from the service are applied to the cached twin as they
+    arrive, and GetTwinOperation ops are completed from memory as long as the cached twin is
+    known to be current.  The cached twin is marked stale, and the next GetTwinOperation is sent
+    to the service, when any of the following happen:
+    * the transport disconnects (patches may have been missed while offline)
+    * a gap is detected in the desired properties $version values
+    * a reported properties patch is sent (the service assigns the new reported $version and
+      $metadata, so the reported properties are refreshed from the service rather than patched
+      locally)
+    * twin patches are not enabled (desired properties may change without us knowing)
+
+    This stage needs to be below EnsureDesiredPropertiesStage so that the GetTwinOperation that
+    stage sends after a reconnect refreshes the cache instead of being served from it.
+    """
+
+    def __init__(self):
+        super(TwinCacheStage, self).__init__()
+        self.twin = None
+        self.stale = True
+        self.patches_enabled = False
+        # Number of GetTwinOperation ops sent to the service that haven't completed yet, and
+        # the patches received while waiting.  The response to a GET can be generated before or
+        # after a patch that arrives at the same time, so these patches are re-applied on top
+        # of the GET response if their $version shows they aren't already included.
+        self.gets_in_flight = 0
+        self.patches_during_get = []
+        # Set if a reported properties patch is sent or completes while a GET is in flight, in
+        # which case the GET response may not include it, and the cache stays stale.
+        self.reported_patched_during_get = False
+
+    @pipeline_thread.runs_on_pipeline_thread
+    def _run_op(self, op):
+        if not self.pipeline_root.pipeline_configuration.twin_cache:
+            self.send_op_down(op)
+
+        elif isinstance(op, pipeline_ops_iothub.GetTwinOperation):
+            if self._is_fresh():
+                logger.debug("%s(%s): Completing from twin cache", self.name, op.name)
+                op.twin = copy.deepcopy(self.twin)
+                op.complete()
+            else:
+                logger.debug(
+                    "%s(%s): Twin cache is not fresh.  Sending GET to service", self.name, op.name
+                )
+                self.gets_in_flight += 1
+                op.add_callback(CallableWeakMethod(self, "_on_get_twin_complete"))
+                self.send_op_down(op)
+
+        elif isinstance(op, pipeline_ops_iothub.PatchTwinReportedPropertiesOperation):
+            self._mark_reported_stale()
+            op.add_callback(CallableWeakMethod(self, "_on_patch_reported_complete"))
+            self.send_op_down(op)
+
+        elif (
+            isinstance(op, pipeline_ops_base.EnableFeatureOperation)
+            and op.feature_name == constant.TWIN_PATCHES
+        ):
+            # A twin retrieved before the patch subscription is in place may already be missing
+            # patches, so the cache needs to be refreshed once the subscription is active.
+            self.stale = True
+            op.add_callback(CallableWeakMethod(self, "_on_enable_twin_patches_complete"))
+            self.send_op_down(op)
+
+        elif (
+            isinstance(op, pipeline_ops_base.DisableFeatureOperation)
+            and op.feature_name == constant.TWIN_PATCHES
+        ):
+            self.patches_enabled = False
+            self.stale = True
+            self.send_op_down(op)
+
+        else:
+            self.send_op_down(op)
+
+    @pipeline_thread.runs_on_pipeline_thread
+    def _is_fresh(self):
+        return (
+            self.twin is not None
+            and not self.stale
+            and self.patches_enabled
+            and self.pipeline_root.connected
+        )
+
+    @pipeline_thread.runs_on_pipeline_thread
+    def _on_enable_twin_patches_complete(self, op, error):
+        if not error:
+            self.patches_enabled = True
+
+    @pipeline_thread.runs_on_pipeline_thread
+    def _on_get_twin_complete(self, op, error):
+        self.gets_in_flight -= 1
+        if not error:
+            logger.debug(
+                "%s(%s): Storing twin with desired $version %s",
+                self.name,
+                op.name,
+                op.twin["desired"].get("$version"),
+            )
+            self.twin = copy.deepcopy(op.twin)
+            self.stale = self.reported_patched_during_get
+            for patch in self.patches_during_get:
+                self._apply_desired_patch(patch)
+        if self.gets_in_flight == 0:
+            self.patches_during_get = []
+            self.reported_patched_during_get = False
+
+    @pipeline_thread.runs_on_pipeline_thread
+    def _on_patch_reported_complete(self, op, error):
+        # Whether or not it succeeded, the patch may have been applied on the service by now,
+        # including while a GET sent since it was sent was in flight.
+        self._mark_reported_stale()
+
+    @pipeline_thread.runs_on_pipeline_thread
+    def _mark_reported_stale(self):
+        """
+        Mark the cached twin stale because of a reported properties patch, so that the next
+        GetTwinOperation refreshes it from the service.
+        """
+        logger.debug("%s: Reported properties patched.  Marking twin cache stale", self.name)
+        self.stale = True
+        if self.gets_in_flight:
+            self.reported_patched_during_get = True
+
+    @pipeline_thread.runs_on_pipeline_thread
+    def _apply_desired_patch(self, patch):
+        """
+        Apply a desired properties patch to the cached twin if it is the next patch in sequence.
+        Patches that are already included in the cached twin are ignored, and patches that skip
+        ahead mark the cache as stale.
+        """
+        if self.twin is None:
+            return
+        desired = self.twin.setdefault("desired", {})
+        cached_version = desired.get("$version")
+        new_version = patch.get("$version")
+        if cached_version is None or new_version is None:
+            self.stale = True
+        elif new_version <= cached_version:
+            logger.debug(
+                "%s: Patch $version %s already included in cached twin", self.name, new_version
+            )
+        elif new_version == cached_version + 1:
+            apply_merge_patch(desired, patch)
+            desired["$version"] = new_version
+        else:
+            logger.info(
+                "%s: Gap in desired properties $version (%s -> %s).  Marking twin cache stale",
+                self.name,
+                cached_version,
+                new_version,
+            )
+            self.stale = True
+
+    @pipeline_thread.runs_on_pipeline_thread
+    def _handle_pipeline_event(self, event):
+        if self.pipeline_root.pipeline_configuration.twin_cache:
+            if isinstance(event, pipeline_events_iothub.TwinDesiredPropertiesPatchEvent):
+                if self.gets_in_flight:
+                    self.patches_during_get.append(event.patch)
+                self._apply_desired_patch(event.patch)
+            elif isinstance(event, pipeline_events_base.DisconnectedEvent):
+                logger.debug("%s: Disconnected.  Marking twin cache stale", self.name)
+                self.stale = True
+        self.send_event_up(event)
+
+
 class TwinRequestResponseStage(PipelineStage):
     """
     PipelineStage which handles twin operations. In particular, it converts twin GET and PATCH
@@ -138,8 +579,8 @@ class TwinRequestResponseStage(PipelineStage):
                 return error
             elif twin_op.status_code >= 300:
                 # TODO map error codes to correct exceptions
-                logger.info("Error {} received from twin operation".format(twin_op.status_code))
-                logger.info("response body: {}".format(twin_op.response_body))
+                logger.info("Error %s received from twin operation", twin_op.status_code)
+                logger.info("response body: %s", twin_op.response_body)
                 return exceptions.ServiceError(
                     "twin operation returned status {}".format(twin_op.status_code)
                 )
@@ -151,21 +592,21 @@ class TwinRequestResponseStage(PipelineStage):
             op_waiting_for_response = op
 
             def on_twin_response(op, error):
-                logger.debug("{}({}): Got response for GetTwinOperation".format(self.name, op.name))
+                logger.debug("%s(%s): Got response for GetTwinOperation", self.name, op.name)
                 error = map_twin_error(error=error, twin_op=op)
                 if not error:
-                    op_waiting_for_response.twin = json.loads(op.response_body.decode("utf-8"))
+                    op_waiting_for_response.twin = json_codec.decode(op.response_body)
                 op_waiting_for_response.complete(error=error)
 
-            self.send_op_down(
-                pipeline_ops_base.RequestAndResponseOperation(
-                    request_type=constant.TWIN,
-                    method="GET",
-                    resource_location="/",
-                    request_body=" ",
-                    callback=on_twin_response,
-                )
+            request_op = pipeline_ops_base.RequestAndResponseOperation(
+                request_type=constant.TWIN,
+                method="GET",
+                resource_location="/",
+                request_body=" ",
+                callback=on_twin_response,
             )
+            request_op.deadline = op.deadline
+            self.send_op_down(request_op)
 
         elif isinstance(op, pipeline_ops_iothub.PatchTwinReportedPropertiesOperation):
 
@@ -175,26 +616,26 @@ class TwinRequestResponseStage(PipelineStage):
 
             def on_twin_response(op, error):
                 logger.debug(
-                    "{}({}): Got response for PatchTwinReportedPropertiesOperation operation".format(
-                        self.name, op.name
-                    )
+                    "%s(%s): Got response for PatchTwinReportedPropertiesOperation operation",
+                    self.name,
+                    op.name,
                 )
                 error = map_twin_error(error=error, twin_op=op)
                 op_waiting_for_response.complete(error=error)
 
             logger.debug(
-                "{}({}): Sending reported properties patch: {}".format(self.name, op.name, op.patch)
+                "%s(%s): Sending reported properties patch: %s", self.name, op.name, op.patch
             )
 
-            self.send_op_down(
-                pipeline_ops_base.RequestAndResponseOperation(
-                    request_type=constant.TWIN,
-                    method="PATCH",
-                    resource_location="/properties/reported/",
-                    request_body=json.dumps(op.patch),
-                    callback=on_twin_response,
-                )
+            request_op = pipeline_ops_base.RequestAndResponseOperation(
+                request_type=constant.TWIN,
+                method="PATCH",
+                resource_location="/properties/reported/",
+                request_body=json_codec.encode(op.patch),
+                callback=on_twin_response,
             )
+            request_op.deadline = op.deadline
+            self.send_op_down(request_op)
 
         else:
             super(TwinRequestResponseStage, self)._run_op(op)
@@ -5,8 +5,8 @@
 # --------------------------------------------------------------------------
 
 import logging
-import json
 import six.moves.urllib as urllib
+from azure.iot.device.common import json_codec
 from azure.iot.device.common.pipeline import (
     pipeline_events_base,
     pipeline_ops_base,
@@ -51,7 +51,7 @@ class IoTHubHTTPTranslationStage(PipelineStage):
             )
             #  if the target is a module.
 
-            body = json.dumps(op.method_params)
+            body = json_codec.encode(op.method_params)
             path = http_path_iothub.get_method_invoke_path(op.target_device_id, op.target_module_id)
             # NOTE: we do not add the sas Authorization header here. Instead we add it later on in
             # the HTTPTransportStage
@@ -67,7 +67,7 @@ class IoTHubHTTPTranslationStage(PipelineStage):
             headers = {
                 "Host": self.pipeline_root.pipeline_configuration.gateway_hostname,
                 "Content-Type": "application/json",
-                "Content-Length": len(str(body)),
+                "Content-Length": len(body),
                 "x-ms-edge-moduleId": x_ms_edge_string,
                 "User-Agent": user_agent_string,
             }
@@ -79,21 +79,19 @@ class IoTHubHTTPTranslationStage(PipelineStage):
                 )
                 error = map_http_error(error=error, http_op=op)
                 if not error:
-                    op_waiting_for_response.method_response = json.loads(
-                        op.response_body.decode("utf-8")
-                    )
+                    op_waiting_for_response.method_response = json_codec.decode(op.response_body)
                 op_waiting_for_response.complete(error=error)
 
-            self.send_op_down(
-                pipeline_ops_http.HTTPRequestAndResponseOperation(
-                    method="POST",
-                    path=path,
-                    headers=headers,
-                    body=body,
-                    query_params=query_params,
-                    callback=on_request_response,
-                )
+            http_op = pipeline_ops_http.HTTPRequestAndResponseOperation(
+                method="POST",
+                path=path,
+                headers=headers,
+                body=body,
+                query_params=query_params,
+                callback=on_request_response,
             )
+            http_op.deadline = op.deadline
+            self.send_op_down(http_op)
 
         elif isinstance(op, pipeline_ops_iothub_http.GetStorageInfoOperation):
             logger.debug(
@@ -105,7 +103,7 @@ class IoTHubHTTPTranslationStage(PipelineStage):
             path = http_path_iothub.get_storage_info_for_blob_path(
                 self.pipeline_root.pipeline_configuration.device_id
             )
-            body = json.dumps({"blobName": op.blob_name})
+            body = json_codec.encode({"blobName": op.blob_name})
             user_agent_string = urllib.parse.quote_plus(
                 user_agent.get_iothub_user_agent()
                 + str(self.pipeline_root.pipeline_configuration.product_info)
@@ -114,7 +112,7 @@ class IoTHubHTTPTranslationStage(PipelineStage):
                 "Host": self.pipeline_root.pipeline_configuration.hostname,
                 "Accept": "application/json",
                 "Content-Type": "application/json",
-                "Content-Length": len(str(body)),
+                "Content-Length": len(body),
                 "User-Agent": user_agent_string,
             }
 
@@ -126,21 +124,19 @@ class IoTHubHTTPTranslationStage(PipelineStage):
                 )
                 error = map_http_error(error=error, http_op=op)
                 if not error:
-                    op_waiting_for_response.storage_info = json.loads(
-                        op.response_body.decode("utf-8")
-                    )
+                    op_waiting_for_response.storage_info = json_codec.decode(op.response_body)
                 op_waiting_for_response.complete(error=error)
 
-            self.send_op_down(
-                pipeline_ops_http.HTTPRequestAndResponseOperation(
-                    method="POST",
-                    path=path,
-                    headers=headers,
-                    body=body,
-                    query_params=query_params,
-                    callback=on_request_response,
-                )
+            http_op = pipeline_ops_http.HTTPRequestAndResponseOperation(
+                method="POST",
+                path=path,
+                headers=headers,
+                body=body,
+                query_params=query_params,
+                callback=on_request_response,
             )
+            http_op.deadline = op.deadline
+            self.send_op_down(http_op)
 
         elif isinstance(op, pipeline_ops_iothub_http.NotifyBlobUploadStatusOperation):
             logger.debug(
@@ -152,7 +148,7 @@ class IoTHubHTTPTranslationStage(PipelineStage):
             path = http_path_iothub.get_notify_blob_upload_status_path(
                 self.pipeline_root.pipeline_configuration.device_id
             )
-            body = json.dumps(
+            body = json_codec.encode(
                 {
                     "correlationId": op.correlation_id,
                     "isSuccess": op.is_success,
@@ -170,7 +166,7 @@ class IoTHubHTTPTranslationStage(PipelineStage):
             headers = {
                 "Host": self.pipeline_root.pipeline_configuration.hostname,
                 "Content-Type": "application/json; charset=utf-8",
-                "Content-Length": len(str(body)),
+                "Content-Length": len(body),
                 "User-Agent": user_agent_string,
             }
             op_waiting_for_response = op
@@ -182,16 +178,16 @@ class IoTHubHTTPTranslationStage(PipelineStage):
                 error = map_http_error(error=error, http_op=op)
                 op_waiting_for_response.complete(error=error)
 
-            self.send_op_down(
-                pipeline_ops_http.HTTPRequestAndResponseOperation(
-                    method="POST",
-                    path=path,
-                    headers=headers,
-                    body=body,
-                    query_params=query_params,
-                    callback=on_request_response,
-                )
+            http_op = pipeline_ops_http.HTTPRequestAndResponseOperation(
+                method="POST",
+                path=path,
+                headers=headers,
+                body=body,
+                query_params=query_params,
+                callback=on_request_response,
             )
+            http_op.deadline = op.deadline
+            self.send_op_down(http_op)
 
         else:
             # All other operations get passed down
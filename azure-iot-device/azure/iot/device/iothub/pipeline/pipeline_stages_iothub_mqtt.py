@@ -5,9 +5,8 @@
 # --------------------------------------------------------------------------
 
 import logging
-import json
 from six.moves import urllib
-from azure.iot.device.common import version_compat
+from azure.iot.device.common import version_compat, json_codec
 from azure.iot.device.common.pipeline import (
     pipeline_events_base,
     pipeline_ops_base,
@@ -109,7 +108,7 @@ class IoTHubMQTTTranslationStage(PipelineStage):
             topic = mqtt_topic_iothub.get_method_topic_for_publish(
                 op.method_response.request_id, op.method_response.status
             )
-            payload = json.dumps(op.method_response.payload)
+            payload = json_codec.encode(op.method_response.payload)
             worker_op = op.spawn_worker_op(
                 worker_op_type=pipeline_ops_mqtt.MQTTPublishOperation, topic=topic, payload=payload
             )
@@ -206,7 +205,7 @@ class IoTHubMQTTTranslationStage(PipelineStage):
                 method_received = MethodRequest(
                     request_id=request_id,
                     name=method_name,
-                    payload=json.loads(event.payload.decode("utf-8")),
+                    payload=json_codec.decode(event.payload),
                 )
                 self.send_event_up(pipeline_events_iothub.MethodRequestEvent(method_received))
 
@@ -222,12 +221,12 @@ class IoTHubMQTTTranslationStage(PipelineStage):
             elif mqtt_topic_iothub.is_twin_desired_property_patch_topic(topic):
                 self.send_event_up(
                     pipeline_events_iothub.TwinDesiredPropertiesPatchEvent(
-                        patch=json.loads(event.payload.decode("utf-8"))
+                        patch=json_codec.decode(event.payload)
                     )
                 )
 
             else:
-                logger.debug("Unknown topic: {} passing up to next handler".format(topic))
+                logger.debug("Unknown topic: %s passing up to next handler", topic)
                 self.send_event_up(event)
 
         else:
@@ -13,11 +13,14 @@ from .abstract_clients import (
     AbstractIoTHubClient,
     AbstractIoTHubDeviceClient,
     AbstractIoTHubModuleClient,
+    _deadline_from_timeout,
+    _timeout_from_deadline,
 )
 from .models import Message
 from .inbox_manager import InboxManager
 from .sync_inbox import SyncClientInbox, InboxEmpty
 from . import sync_handler_manager
+from . import blob_upload
 from .pipeline import constant as pipeline_constant
 from .pipeline import exceptions as pipeline_exceptions
 from azure.iot.device import exceptions
@@ -50,6 +53,10 @@ def handle_result(callback):
         raise exceptions.ClientError(
             message="Error in the IoTHub client raised due to proxy connections.", cause=e
         )
+    except pipeline_exceptions.OperationTimeout as e:
+        raise exceptions.OperationTimeout(
+            message="Operation did not complete before its timeout", cause=e
+        )
     except pipeline_exceptions.PipelineNotRunning as e:
         raise exceptions.ClientError(message="Client has already been shut down", cause=e)
     except Exception as e:
@@ -61,7 +68,7 @@ class GenericIoTHubClient(AbstractIoTHubClient):
     This class needs to be extended for specific clients.
     """
 
-    def __init__(self, **kwargs):
+    def __init__(self, handler_executor=None, **kwargs):
         """Initializer for a generic synchronous client.
 
         This initializer should not be called directly.
@@ -71,6 +78,9 @@ class GenericIoTHubClient(AbstractIoTHubClient):
         :type mqtt_pipeline: :class:`azure.iot.device.iothub.pipeline.MQTTPipeline`
         :param http_pipeline: The HTTPPipeline used for the client
         :type http_pipeline: :class:`azure.iot.device.iothub.pipeline.HTTPPipeline`
+        :param handler_executor: Optional executor, shared with other clients, to invoke
+            handlers in.
+        :type handler_executor: :class:`concurrent.futures.Executor`
         """
         # Depending on the subclass calling this __init__, there could be different arguments,
         # and the super() call could call a different class, due to the different MROs
@@ -78,7 +88,9 @@ class GenericIoTHubClient(AbstractIoTHubClient):
         # **kwargs.
         super(GenericIoTHubClient, self).__init__(**kwargs)
         self._inbox_manager = InboxManager(inbox_type=SyncClientInbox)
-        self._handler_manager = sync_handler_manager.SyncHandlerManager(self._inbox_manager)
+        self._handler_manager = sync_handler_manager.SyncHandlerManager(
+            self._inbox_manager, handler_executor=handler_executor
+        )
 
         # Set pipeline handlers
         self._mqtt_pipeline.on_connected = CallableWeakMethod(self, "_on_connected")
@@ -90,7 +102,7 @@ class GenericIoTHubClient(AbstractIoTHubClient):
             self._inbox_manager, "route_twin_patch"
         )
 
-    def _enable_feature(self, feature_name):
+    def _enable_feature(self, feature_name, deadline=None):
         """Enable an Azure IoT Hub feature.
 
         This is a synchronous call, meaning that this function will not return until the feature
@@ -98,12 +110,14 @@ class GenericIoTHubClient(AbstractIoTHubClient):
 
         :param feature_name: The name of the feature to enable.
             See azure.iot.device.common.pipeline.constant for possible values
+        :param float deadline: The time (in seconds since the epoch) by which the feature must be
+            enabled (optional).
         """
         logger.info("Enabling feature:" + feature_name + "...")
         if not self._mqtt_pipeline.feature_enabled[feature_name]:
             callback = EventedCallback()
-            self._mqtt_pipeline.enable_feature(feature_name, callback=callback)
-            callback.wait_for_completion()
+            self._mqtt_pipeline.enable_feature(feature_name, callback=callback, deadline=deadline)
+            handle_result(callback)
 
             logger.info("Successfully enabled feature:" + feature_name)
         else:
@@ -171,7 +185,7 @@ class GenericIoTHubClient(AbstractIoTHubClient):
         # capability for HTTP pipeline.
         logger.info("Client shutdown complete")
 
-    def connect(self):
+    def connect(self, timeout=None):
         """Connects the client to an Azure IoT Hub or Azure IoT Edge Hub instance.
 
         The destination is chosen based on the credentials passed via the auth_provider parameter
@@ -180,6 +194,10 @@ class GenericIoTHubClient(AbstractIoTHubClient):
         This is a synchronous call, meaning that this function will not return until the connection
         to the service has been completely established.
 
+        :param float timeout: The maximum number of seconds to wait for the connection (optional).
+            If it passes first, this call fails, but the client keeps trying to connect in the
+            background.
+
         :raises: :class:`azure.iot.device.exceptions.CredentialError` if credentials are invalid
             and a connection cannot be established.
         :raises: :class:`azure.iot.device.exceptions.ConnectionFailedError` if a establishing a
@@ -188,11 +206,13 @@ class GenericIoTHubClient(AbstractIoTHubClient):
             during execution.
         :raises: :class:`azure.iot.device.exceptions.ClientError` if there is an unexpected failure
             during execution.
+        :raises: :class:`azure.iot.device.exceptions.OperationTimeout` if the timeout passed
+            before the operation completed.
         """
         logger.info("Connecting to Hub...")
 
         callback = EventedCallback()
-        self._mqtt_pipeline.connect(callback=callback)
+        self._mqtt_pipeline.connect(callback=callback, deadline=_deadline_from_timeout(timeout))
         handle_result(callback)
 
         logger.info("Successfully connected to Hub")
@@ -274,7 +294,7 @@ class GenericIoTHubClient(AbstractIoTHubClient):
 
         logger.info("Successfully reauthorized connection to Hub")
 
-    def send_message(self, message):
+    def send_message(self, message, timeout=None):
         """Sends a message to the default events endpoint on the Azure IoT Hub or Azure IoT Edge Hub instance.
 
         This is a synchronous event, meaning that this function will not return until the event
@@ -286,6 +306,8 @@ class GenericIoTHubClient(AbstractIoTHubClient):
         :param message: The actual message to send. Anything passed that is not an instance of the
             Message class will be converted to Message object.
         :type message: :class:`azure.iot.device.Message` or str
+        :param float timeout: The maximum number of seconds to wait for the operation to complete
+            (optional). Once it has passed, the operation is not sent or retried, and fails.
 
         :raises: :class:`azure.iot.device.exceptions.CredentialError` if credentials are invalid
             and a connection cannot be established.
@@ -297,6 +319,8 @@ class GenericIoTHubClient(AbstractIoTHubClient):
             connected (and there is no auto-connect enabled)
         :raises: :class:`azure.iot.device.exceptions.ClientError` if there is an unexpected failure
             during execution.
+        :raises: :class:`azure.iot.device.exceptions.OperationTimeout` if the timeout passed
+            before the operation completed.
         :raises: ValueError if the message fails size validation.
         """
         if not isinstance(message, Message):
@@ -308,11 +332,32 @@ class GenericIoTHubClient(AbstractIoTHubClient):
         logger.info("Sending message to Hub...")
 
         callback = EventedCallback()
-        self._mqtt_pipeline.send_message(message, callback=callback)
+        self._mqtt_pipeline.send_message(
+            message, callback=callback, deadline=_deadline_from_timeout(timeout)
+        )
         handle_result(callback)
 
         logger.info("Successfully sent message to Hub")
 
+    def wait_for_capacity(self, timeout=None):
+        """Wait until the client has capacity for further sends.
+
+        Messages which have been sent but not yet acknowledged (for example, while the client is
+        reconnecting) are held by the client. Sending from multiple threads, or more quickly than
+        the service acknowledges, can therefore use an unbounded amount of memory during an
+        outage. Calling this before each send limits the pending messages to roughly
+        pending_bytes_high_watermark.
+
+        If no high watermark was configured, this returns immediately.
+
+        :param float timeout: Maximum number of seconds to wait. If not provided, waits
+            indefinitely.
+
+        :returns: True if the client has capacity, False if the timeout expired first.
+        :rtype: bool
+        """
+        return self._mqtt_pipeline.flow_control.wait_for_capacity(timeout=timeout)
+
     @deprecation.deprecated(
         deprecated_in="2.3.0",
         current_version=device_constant.VERSION,
@@ -346,7 +391,7 @@ class GenericIoTHubClient(AbstractIoTHubClient):
             logger.info("Did not receive method request")
         return method_request
 
-    def send_method_response(self, method_response):
+    def send_method_response(self, method_response, timeout=None):
         """Send a response to a method request via the Azure IoT Hub or Azure IoT Edge Hub.
 
         This is a synchronous event, meaning that this function will not return until the event
@@ -357,6 +402,8 @@ class GenericIoTHubClient(AbstractIoTHubClient):
 
         :param method_response: The MethodResponse to send.
         :type method_response: :class:`azure.iot.device.MethodResponse`
+        :param float timeout: The maximum number of seconds to wait for the operation to complete
+            (optional). Once it has passed, the operation is not sent or retried, and fails.
 
         :raises: :class:`azure.iot.device.exceptions.CredentialError` if credentials are invalid
             and a connection cannot be established.
@@ -368,22 +415,29 @@ class GenericIoTHubClient(AbstractIoTHubClient):
             connected (and there is no auto-connect enabled)
         :raises: :class:`azure.iot.device.exceptions.ClientError` if there is an unexpected failure
             during execution.
+        :raises: :class:`azure.iot.device.exceptions.OperationTimeout` if the timeout passed
+            before the operation completed.
         """
         logger.info("Sending method response to Hub...")
 
         callback = EventedCallback()
-        self._mqtt_pipeline.send_method_response(method_response, callback=callback)
+        self._mqtt_pipeline.send_method_response(
+            method_response, callback=callback, deadline=_deadline_from_timeout(timeout)
+        )
         handle_result(callback)
 
         logger.info("Successfully sent method response to Hub")
 
-    def get_twin(self):
+    def get_twin(self, timeout=None):
         """
         Gets the device or module twin from the Azure IoT Hub or Azure IoT Edge Hub service.
 
         This is a synchronous call, meaning that this function will not return until the twin
         has been retrieved from the service.
 
+        :param float timeout: The maximum number of seconds to wait for the operation to complete
+            (optional). Once it has passed, the operation is not sent or retried, and fails.
+
         :returns: Complete Twin as a JSON dict
         :rtype: dict
 
@@ -397,18 +451,21 @@ class GenericIoTHubClient(AbstractIoTHubClient):
             connected (and there is no auto-connect enabled)
         :raises: :class:`azure.iot.device.exceptions.ClientError` if there is an unexpected failure
             during execution.
+        :raises: :class:`azure.iot.device.exceptions.OperationTimeout` if the timeout passed
+            before the operation completed.
         """
+        deadline = _deadline_from_timeout(timeout)
         if not self._mqtt_pipeline.feature_enabled[pipeline_constant.TWIN]:
-            self._enable_feature(pipeline_constant.TWIN)
+            self._enable_feature(pipeline_constant.TWIN, deadline=deadline)
 
         callback = EventedCallback(return_arg_name="twin")
-        self._mqtt_pipeline.get_twin(callback=callback)
+        self._mqtt_pipeline.get_twin(callback=callback, deadline=deadline)
         twin = handle_result(callback)
 
         logger.info("Successfully retrieved twin")
         return twin
 
-    def patch_twin_reported_properties(self, reported_properties_patch):
+    def patch_twin_reported_properties(self, reported_properties_patch, timeout=None):
         """
         Update reported properties with the Azure IoT Hub or Azure IoT Edge Hub service.
 
@@ -420,6 +477,8 @@ class GenericIoTHubClient(AbstractIoTHubClient):
 
         :param reported_properties_patch: Twin Reported Properties patch as a JSON dict
         :type reported_properties_patch: dict
+        :param float timeout: The maximum number of seconds to wait for the operation to complete
+            (optional). Once it has passed, the operation is not sent or retried, and fails.
 
         :raises: :class:`azure.iot.device.exceptions.CredentialError` if credentials are invalid
             and a connection cannot be established.
@@ -431,13 +490,16 @@ class GenericIoTHubClient(AbstractIoTHubClient):
             connected (and there is no auto-connect enabled)
         :raises: :class:`azure.iot.device.exceptions.ClientError` if there is an unexpected failure
             during execution.
+        :raises: :class:`azure.iot.device.exceptions.OperationTimeout` if the timeout passed
+            before the operation completed.
         """
+        deadline = _deadline_from_timeout(timeout)
         if not self._mqtt_pipeline.feature_enabled[pipeline_constant.TWIN]:
-            self._enable_feature(pipeline_constant.TWIN)
+            self._enable_feature(pipeline_constant.TWIN, deadline=deadline)
 
         callback = EventedCallback()
         self._mqtt_pipeline.patch_twin_reported_properties(
-            patch=reported_properties_patch, callback=callback
+            patch=reported_properties_patch, callback=callback, deadline=deadline
         )
         handle_result(callback)
 
@@ -494,7 +556,11 @@ class GenericIoTHubClient(AbstractIoTHubClient):
             self._enable_feature(feature_name)
 
         # Disable the feature if necessary
-        elif new_handler is None and self._mqtt_pipeline.feature_enabled[feature_name]:
+        elif (
+            new_handler is None
+            and self._mqtt_pipeline.feature_enabled[feature_name]
+            and not self._message_feature_in_use(handler_name)
+        ):
             self._disable_feature(feature_name)
 
     @property
@@ -503,7 +569,9 @@ class GenericIoTHubClient(AbstractIoTHubClient):
         is received.
 
         The function definition should take one positional argument (the twin patch in the form
-        of a JSON dictionary object)"""
+        of a JSON dictionary object, which is a :class:`azure.iot.device.DesiredPropertiesPatch`).
+        After a reconnect, the patch only contains the desired properties which changed while the
+        client was disconnected."""
         return self._handler_manager.on_twin_desired_properties_patch_received
 
     @on_twin_desired_properties_patch_received.setter
@@ -531,7 +599,7 @@ class IoTHubDeviceClient(GenericIoTHubClient, AbstractIoTHubDeviceClient):
     Intended for usage with Python 2.7 or compatibility scenarios for Python 3.5.3+.
     """
 
-    def __init__(self, mqtt_pipeline, http_pipeline):
+    def __init__(self, mqtt_pipeline, http_pipeline, handler_executor=None):
         """Initializer for a IoTHubDeviceClient.
 
         This initializer should not be called directly.
@@ -539,13 +607,21 @@ class IoTHubDeviceClient(GenericIoTHubClient, AbstractIoTHubDeviceClient):
 
         :param mqtt_pipeline: The pipeline used to connect to the IoTHub endpoint.
         :type mqtt_pipeline: :class:`azure.iot.device.iothub.pipeline.MQTTPipeline`
+        :param handler_executor: Optional executor, shared with other clients, to invoke
+            handlers in.
+        :type handler_executor: :class:`concurrent.futures.Executor`
         """
         super(IoTHubDeviceClient, self).__init__(
-            mqtt_pipeline=mqtt_pipeline, http_pipeline=http_pipeline
+            mqtt_pipeline=mqtt_pipeline,
+            http_pipeline=http_pipeline,
+            handler_executor=handler_executor,
         )
         self._mqtt_pipeline.on_c2d_message_received = CallableWeakMethod(
             self._inbox_manager, "route_c2d_message"
         )
+        self._mqtt_pipeline.on_c2d_messages_received = CallableWeakMethod(
+            self._inbox_manager, "route_c2d_messages"
+        )
 
     @deprecation.deprecated(
         deprecated_in="2.3.0",
@@ -577,21 +653,28 @@ class IoTHubDeviceClient(GenericIoTHubClient, AbstractIoTHubDeviceClient):
             logger.info("No message received.")
         return message
 
-    def get_storage_info_for_blob(self, blob_name):
+    def get_storage_info_for_blob(self, blob_name, timeout=None):
         """Sends a POST request over HTTP to an IoTHub endpoint that will return information for uploading via the Azure Storage Account linked to the IoTHub your device is connected to.
 
         :param str blob_name: The name in string format of the blob that will be uploaded using the storage API. This name will be used to generate the proper credentials for Storage, and needs to match what will be used with the Azure Storage SDK to perform the blob upload.
+        :param float timeout: The maximum number of seconds to wait for the operation to complete
+            (optional). Once it has passed, the operation is not sent or retried, and fails.
 
         :returns: A JSON-like (dictionary) object from IoT Hub that will contain relevant information including: correlationId, hostName, containerName, blobName, sasToken.
+
+        :raises: :class:`azure.iot.device.exceptions.OperationTimeout` if the timeout passed
+            before the operation completed.
         """
         callback = EventedCallback(return_arg_name="storage_info")
-        self._http_pipeline.get_storage_info_for_blob(blob_name, callback=callback)
+        self._http_pipeline.get_storage_info_for_blob(
+            blob_name, callback=callback, deadline=_deadline_from_timeout(timeout)
+        )
         storage_info = handle_result(callback)
         logger.info("Successfully retrieved storage_info")
         return storage_info
 
     def notify_blob_upload_status(
-        self, correlation_id, is_success, status_code, status_description
+        self, correlation_id, is_success, status_code, status_description, timeout=None
     ):
         """When the upload is complete, the device sends a POST request to the IoT Hub endpoint with information on the status of an upload to blob attempt. This is used by IoT Hub to notify listening clients.
 
@@ -599,6 +682,11 @@ class IoTHubDeviceClient(GenericIoTHubClient, AbstractIoTHubDeviceClient):
         :param bool is_success: A boolean that indicates whether the file was uploaded successfully.
         :param int status_code: A numeric status code that is the status for the upload of the fiel to storage.
         :param str status_description: A description that corresponds to the status_code.
+        :param float timeout: The maximum number of seconds to wait for the operation to complete
+            (optional). Once it has passed, the operation is not sent or retried, and fails.
+
+        :raises: :class:`azure.iot.device.exceptions.OperationTimeout` if the timeout passed
+            before the operation completed.
         """
         callback = EventedCallback()
         self._http_pipeline.notify_blob_upload_status(
@@ -607,10 +695,85 @@ class IoTHubDeviceClient(GenericIoTHubClient, AbstractIoTHubDeviceClient):
             status_code=status_code,
             status_description=status_description,
             callback=callback,
+            deadline=_deadline_from_timeout(timeout),
         )
         handle_result(callback)
         logger.info("Successfully notified blob upload status")
 
+    def upload_file(
+        self,
+        blob_name,
+        file_path,
+        block_size=blob_upload.DEFAULT_BLOCK_SIZE,
+        max_concurrency=blob_upload.DEFAULT_MAX_CONCURRENCY,
+        manifest_path=None,
+        timeout=None,
+    ):
+        """Upload a file to the Azure Storage Account linked to the IoTHub, and notify the IoTHub
+        of the result.
+
+        The file is uploaded in blocks which are sent in parallel, so that at most
+        block_size * max_concurrency bytes of the file are held in memory at once. If a
+        manifest_path is given, an upload of the same file to the same blob which was interrupted
+        will resume from the blocks that were already uploaded. Azure Storage is reached using
+        the server_verification_cert, cipher and proxy_options the client was created with, and
+        a failed upload is reported to the IoTHub with the status code returned by Azure Storage.
+
+        :param str blob_name: The name of the blob to upload the file to.
+        :param str file_path: The path of the file to upload.
+        :param int block_size: The size in bytes of each uploaded block.
+        :param int max_concurrency: The number of blocks to upload in parallel.
+        :param str manifest_path: Path of a local file used to track upload progress so that the
+            upload can be resumed.
+        :param float timeout: The maximum number of seconds to wait for the whole upload,
+            including getting the storage info and notifying the IoTHub (optional). The IoTHub is
+            not notified of a failed upload once the timeout has passed.
+
+        :raises: :class:`azure.iot.device.exceptions.ServiceError` if Azure Storage returns an
+            error.
+        :raises: :class:`azure.iot.device.exceptions.ConnectionFailedError` if Azure Storage
+            can't be reached.
+        :raises: :class:`azure.iot.device.exceptions.OperationTimeout` if the timeout passed
+            before the upload and notification were complete.
+        """
+        deadline = _deadline_from_timeout(timeout)
+        storage_info = self.get_storage_info_for_blob(
+            blob_name, timeout=_timeout_from_deadline(deadline)
+        )
+        # Azure Storage is reached with the same TLS and proxy settings as the IoTHub
+        pipeline_configuration = self._mqtt_pipeline.pipeline_configuration
+        uploader = blob_upload.BlobUploader(
+            blob_upload.get_blob_url(storage_info),
+            block_size=block_size,
+            max_concurrency=max_concurrency,
+            manifest_path=manifest_path,
+            server_verification_cert=pipeline_configuration.server_verification_cert,
+            cipher=pipeline_configuration.cipher,
+            proxy_options=pipeline_configuration.proxy_options,
+            deadline=deadline,
+        )
+        try:
+            status_code = uploader.upload_file(file_path)
+        except Exception as e:
+            logger.error("Failed to upload {} to blob {}".format(file_path, blob_name))
+            remaining = _timeout_from_deadline(deadline)
+            if remaining is None or remaining > 0:
+                self.notify_blob_upload_status(
+                    correlation_id=storage_info["correlationId"],
+                    is_success=False,
+                    status_code=blob_upload.get_error_status_code(e),
+                    status_description=blob_upload.get_error_status_description(e),
+                    timeout=remaining,
+                )
+            raise
+        self.notify_blob_upload_status(
+            correlation_id=storage_info["correlationId"],
+            is_success=True,
+            status_code=status_code,
+            status_description="Uploaded {}".format(blob_name),
+            timeout=_timeout_from_deadline(deadline),
+        )
+
     @property
     def on_message_received(self):
         """The handler function that will be called when a message is received.
@@ -623,6 +786,20 @@ class IoTHubDeviceClient(GenericIoTHubClient, AbstractIoTHubDeviceClient):
     def on_message_received(self, value):
         self._generic_handler_setter("on_message_received", pipeline_constant.C2D_MSG, value)
 
+    @property
+    def on_message_batch_received(self):
+        """The handler function that will be called with the messages which have been received,
+        as an alternative to on_message_received for high message rates.
+
+        The function definition should take one positional argument (a list of the
+        :class:`azure.iot.device.Message` objects which have arrived since the last invocation,
+        in the order they arrived). It cannot be set while on_message_received is set."""
+        return self._handler_manager.on_message_batch_received
+
+    @on_message_batch_received.setter
+    def on_message_batch_received(self, value):
+        self._generic_handler_setter("on_message_batch_received", pipeline_constant.C2D_MSG, value)
+
 
 class IoTHubModuleClient(GenericIoTHubClient, AbstractIoTHubModuleClient):
     """A synchronous module client that connects to an Azure IoT Hub or Azure IoT Edge instance.
@@ -630,7 +807,7 @@ class IoTHubModuleClient(GenericIoTHubClient, AbstractIoTHubModuleClient):
     Intended for usage with Python 2.7 or compatibility scenarios for Python 3.5.3+.
     """
 
-    def __init__(self, mqtt_pipeline, http_pipeline):
+    def __init__(self, mqtt_pipeline, http_pipeline, handler_executor=None):
         """Intializer for a IoTHubModuleClient.
 
         This initializer should not be called directly.
@@ -640,15 +817,23 @@ class IoTHubModuleClient(GenericIoTHubClient, AbstractIoTHubModuleClient):
         :type mqtt_pipeline: :class:`azure.iot.device.iothub.pipeline.MQTTPipeline`
         :param http_pipeline: The pipeline used to connect to the IoTHub endpoint via HTTP.
         :type http_pipeline: :class:`azure.iot.device.iothub.pipeline.HTTPPipeline`
+        :param handler_executor: Optional executor, shared with other clients, to invoke
+            handlers in.
+        :type handler_executor: :class:`concurrent.futures.Executor`
         """
         super(IoTHubModuleClient, self).__init__(
-            mqtt_pipeline=mqtt_pipeline, http_pipeline=http_pipeline
+            mqtt_pipeline=mqtt_pipeline,
+            http_pipeline=http_pipeline,
+            handler_executor=handler_executor,
         )
         self._mqtt_pipeline.on_input_message_received = CallableWeakMethod(
             self._inbox_manager, "route_input_message"
         )
+        self._mqtt_pipeline.on_input_messages_received = CallableWeakMethod(
+            self._inbox_manager, "route_input_messages"
+        )
 
-    def send_message_to_output(self, message, output_name):
+    def send_message_to_output(self, message, output_name, timeout=None):
         """Sends an event/message to the given module output.
 
         These are outgoing events and are meant to be "output events".
@@ -663,6 +848,8 @@ class IoTHubModuleClient(GenericIoTHubClient, AbstractIoTHubModuleClient):
             Message class will be converted to Message object.
         :type message: :class:`azure.iot.device.Message` or str
         :param str output_name: Name of the output to send the event to.
+        :param float timeout: The maximum number of seconds to wait for the operation to complete
+            (optional). Once it has passed, the operation is not sent or retried, and fails.
 
         :raises: :class:`azure.iot.device.exceptions.CredentialError` if credentials are invalid
             and a connection cannot be established.
@@ -674,6 +861,8 @@ class IoTHubModuleClient(GenericIoTHubClient, AbstractIoTHubModuleClient):
             connected (and there is no auto-connect enabled)
         :raises: :class:`azure.iot.device.exceptions.ClientError` if there is an unexpected failure
             during execution.
+        :raises: :class:`azure.iot.device.exceptions.OperationTimeout` if the timeout passed
+            before the operation completed.
         :raises: ValueError if the message fails size validation.
         """
         if not isinstance(message, Message):
@@ -687,7 +876,9 @@ class IoTHubModuleClient(GenericIoTHubClient, AbstractIoTHubModuleClient):
         logger.info("Sending message to output:" + output_name + "...")
 
         callback = EventedCallback()
-        self._mqtt_pipeline.send_output_message(message, callback=callback)
+        self._mqtt_pipeline.send_output_message(
+            message, callback=callback, deadline=_deadline_from_timeout(timeout)
+        )
         handle_result(callback)
 
         logger.info("Successfully sent message to output: " + output_name)
@@ -722,23 +913,32 @@ class IoTHubModuleClient(GenericIoTHubClient, AbstractIoTHubModuleClient):
             logger.info("No input message received on: " + input_name)
         return message
 
-    def invoke_method(self, method_params, device_id, module_id=None):
+    def invoke_method(self, method_params, device_id, module_id=None, timeout=None):
         """Invoke a method from your client onto a device or module client, and receive the response to the method call.
 
         :param dict method_params: Should contain a methodName (str), payload (str),
             connectTimeoutInSeconds (int), responseTimeoutInSeconds (int).
         :param str device_id: Device ID of the target device where the method will be invoked.
         :param str module_id: Module ID of the target module where the method will be invoked. (Optional)
+        :param float timeout: The maximum number of seconds to wait for the operation to complete
+            (optional). Once it has passed, the operation is not sent or retried, and fails.
 
         :returns: method_result should contain a status, and a payload
         :rtype: dict
+
+        :raises: :class:`azure.iot.device.exceptions.OperationTimeout` if the timeout passed
+            before the operation completed.
         """
         logger.info(
             "Invoking {} method on {}{}".format(method_params["methodName"], device_id, module_id)
         )
         callback = EventedCallback(return_arg_name="invoke_method_response")
         self._http_pipeline.invoke_method(
-            device_id, method_params, callback=callback, module_id=module_id
+            device_id,
+            method_params,
+            callback=callback,
+            module_id=module_id,
+            deadline=_deadline_from_timeout(timeout),
         )
         invoke_method_response = handle_result(callback)
         logger.info("Successfully invoked method")
@@ -755,3 +955,19 @@ class IoTHubModuleClient(GenericIoTHubClient, AbstractIoTHubModuleClient):
     @on_message_received.setter
     def on_message_received(self, value):
         self._generic_handler_setter("on_message_received", pipeline_constant.INPUT_MSG, value)
+
+    @property
+    def on_message_batch_received(self):
+        """The handler function that will be called with the input messages which have been
+        received, as an alternative to on_message_received for high message rates.
+
+        The function definition should take one positional argument (a list of the
+        :class:`azure.iot.device.Message` objects which have arrived since the last invocation,
+        in the order they arrived). It cannot be set while on_message_received is set."""
+        return self._handler_manager.on_message_batch_received
+
+    @on_message_batch_received.setter
+    def on_message_batch_received(self, value):
+        self._generic_handler_setter(
+            "on_message_batch_received", pipeline_constant.INPUT_MSG, value
+        )
@@ -8,6 +8,7 @@
 import logging
 import threading
 import abc
+import functools
 import six
 from azure.iot.device.common import handle_exceptions
 from azure.iot.device.common.chainable_exception import ChainableException
@@ -17,10 +18,14 @@ import concurrent.futures
 logger = logging.getLogger(__name__)
 
 MESSAGE = "_on_message_received"
+MESSAGE_BATCH = "_on_message_batch_received"
 METHOD = "_on_method_request_received"
 TWIN_DP_PATCH = "_on_twin_desired_properties_patch_received"
 # TODO: add more for "event"
 
+# Largest number of items passed to a batch handler in one invocation
+MAX_BATCH_SIZE = 100
+
 
 class HandlerManagerException(ChainableException):
     """An exception raised by a HandlerManager
@@ -48,6 +53,7 @@ class AbstractHandlerManager(object):
         self._handler_runners = {
             # Inbox handler tasks
             MESSAGE: None,
+            MESSAGE_BATCH: None,
             METHOD: None,
             TWIN_DP_PATCH: None,
             # Other handler tasks
@@ -56,6 +62,7 @@ class AbstractHandlerManager(object):
 
         # Inbox handlers
         self._on_message_received = None
+        self._on_message_batch_received = None
         self._on_method_request_received = None
         self._on_twin_desired_properties_patch_received = None
 
@@ -68,11 +75,31 @@ class AbstractHandlerManager(object):
             return self._inbox_manager.get_method_request_inbox()
         elif handler_name == TWIN_DP_PATCH:
             return self._inbox_manager.get_twin_patch_inbox()
-        elif handler_name == MESSAGE:
+        elif handler_name == MESSAGE or handler_name == MESSAGE_BATCH:
             return self._inbox_manager.get_unified_message_inbox()
         else:
             return None
 
+    def _get_batch(self, get_nowait, first_item):
+        """Get a batch of items for a batch handler: the first item, followed by the items which
+        can be taken from the inbox without waiting, up to MAX_BATCH_SIZE.
+
+        :param get_nowait: Function that removes and returns an item from the inbox, raising
+            InboxEmpty if it is empty
+        :returns: A tuple of the batch, and whether a HandlerRunnerKillerSentinel was found. No
+            more items are taken from the inbox once one has been found.
+        """
+        batch = [first_item]
+        while len(batch) < MAX_BATCH_SIZE:
+            try:
+                item = get_nowait()
+            except InboxEmpty:
+                break
+            if isinstance(item, HandlerRunnerKillerSentinel):
+                return batch, True
+            batch.append(item)
+        return batch, False
+
     @abc.abstractmethod
     def _inbox_handler_runner(self, inbox, handler_name):
         """Run infinite loop that waits for an inbox to receive an object from it, then calls
@@ -136,8 +163,24 @@ class AbstractHandlerManager(object):
 
     @on_message_received.setter
     def on_message_received(self, value):
+        if value is not None and self._on_message_batch_received is not None:
+            raise ValueError(
+                "Cannot set on_message_received while on_message_batch_received is set"
+            )
         self._generic_handler_setter(MESSAGE, value)
 
+    @property
+    def on_message_batch_received(self):
+        return self._on_message_batch_received
+
+    @on_message_batch_received.setter
+    def on_message_batch_received(self, value):
+        if value is not None and self._on_message_received is not None:
+            raise ValueError(
+                "Cannot set on_message_batch_received while on_message_received is set"
+            )
+        self._generic_handler_setter(MESSAGE_BATCH, value)
+
     @property
     def on_method_request_received(self):
         return self._on_method_request_received
@@ -156,7 +199,27 @@ class AbstractHandlerManager(object):
 
 
 class SyncHandlerManager(AbstractHandlerManager):
-    """Handler manager for use with synchronous clients"""
+    """Handler manager for use with synchronous clients.
+
+    By default, each handler that is set gets its own runner thread, and its own pool of
+    threads to invoke the handler in.  If a handler_executor is provided, no threads are created.
+    Instead, the handler is invoked in the (shared) executor for each item put in the inbox.
+    """
+
+    def __init__(self, inbox_manager, handler_executor=None):
+        """Initializer for SyncHandlerManager
+
+        :param inbox_manager: The InboxManager for the client
+        :param handler_executor: Optional Executor to invoke handlers in. It may be shared with
+            the handler managers of other clients.
+        :type handler_executor: :class:`concurrent.futures.Executor`
+        """
+        super(SyncHandlerManager, self).__init__(inbox_manager)
+        self._handler_executor = handler_executor
+        # Number of invocations submitted to the handler_executor which have not finished,
+        # by handler
+        self._pending_invocations = {}
+        self._pending_invocations_cv = threading.Condition()
 
     def _inbox_handler_runner(self, inbox, handler_name):
         """Run infinite loop that waits for an inbox to receive an object from it, then calls
@@ -205,6 +268,11 @@ class SyncHandlerManager(AbstractHandlerManager):
                 )
                 tpe.shutdown()
                 break
+            found_sentinel = False
+            if handler_name == MESSAGE_BATCH:
+                # Deliver everything which has arrived in one invocation
+                get_nowait = functools.partial(inbox.get, block=False)
+                handler_arg, found_sentinel = self._get_batch(get_nowait, handler_arg)
             # NOTE: we MUST use getattr here using the handler name, as opposed to directly passing
             # the handler in order for the handler to be able to be updated without cancelling
             # the running task created for this coroutine
@@ -212,14 +280,74 @@ class SyncHandlerManager(AbstractHandlerManager):
             logger.debug("HANDLER RUNNER ({}): Invoking handler".format(handler_name))
             fut = tpe.submit(handler, handler_arg)
             fut.add_done_callback(_handler_callback)
+            if found_sentinel:
+                logger.debug(
+                    "HANDLER RUNNER ({}): HandlerRunnerKillerSentinel found in inbox. Exiting.".format(
+                        handler_name
+                    )
+                )
+                tpe.shutdown()
+                break
 
     def _event_handler_runner(self, handler_name):
         # TODO: implement
         logger.error(".event_handler_runner() not yet implemented")
 
-    def _start_handler_runner(self, handler_name):
-        """Start and store a handler runner thread
+    def _submit_handler_invocation(self, inbox, handler_name):
+        """Submit an invocation of the handler for the next item in the inbox to the
+        handler_executor
         """
+        with self._pending_invocations_cv:
+            self._pending_invocations[handler_name] += 1
+        self._handler_executor.submit(self._invoke_handler_for_next_item, inbox, handler_name)
+
+    def _invoke_handler_for_next_item(self, inbox, handler_name):
+        try:
+            handler_arg = inbox.get(block=False)
+            if isinstance(handler_arg, HandlerRunnerKillerSentinel):
+                self._stop_submitting_handler_invocations(inbox, handler_name)
+                return
+            if handler_name == MESSAGE_BATCH:
+                # Also take the items for the invocations submitted after this one, which will
+                # find the inbox empty
+                get_nowait = functools.partial(inbox.get, block=False)
+                handler_arg, found_sentinel = self._get_batch(get_nowait, handler_arg)
+                if found_sentinel:
+                    # As with the runner thread, the batch taken so far is still handled
+                    self._stop_submitting_handler_invocations(inbox, handler_name)
+            # NOTE: as with the runner thread, use getattr so the handler can be updated
+            handler = getattr(self, handler_name)
+            logger.debug("HANDLER (%s): Invoking handler", handler_name)
+            handler(handler_arg)
+        except InboxEmpty:
+            # Another invocation already took the item
+            pass
+        except Exception as e:
+            new_err = HandlerManagerException(
+                message="HANDLER ({}): Error during invocation".format(handler_name),
+                cause=e,
+            )
+            handle_exceptions.handle_background_exception(new_err)
+        else:
+            logger.debug("HANDLER (%s): Successfully completed invocation", handler_name)
+        finally:
+            with self._pending_invocations_cv:
+                self._pending_invocations[handler_name] -= 1
+                self._pending_invocations_cv.notify_all()
+
+    def _stop_submitting_handler_invocations(self, inbox, handler_name):
+        """Stop submitting invocations of the handler when items are put in the inbox, once a
+        HandlerRunnerKillerSentinel has been found in it"""
+        logger.debug(
+            "HANDLER (%s): HandlerRunnerKillerSentinel found in inbox. Stopping.", handler_name
+        )
+        inbox.on_item_put = None
+
+    def _start_handler_runner(self, handler_name):
+        """Start and store a handler runner thread"""
+        if self._handler_executor:
+            self._start_executor_handler_runner(handler_name)
+            return
         if self._handler_runners[handler_name] is not None:
             # This branch of code should NOT be reachable due to checks prior to the invocation
             # of this method. The branch exists for safety.
@@ -244,10 +372,37 @@ class SyncHandlerManager(AbstractHandlerManager):
         self._handler_runners[handler_name] = thread
         thread.start()
 
+    def _start_executor_handler_runner(self, handler_name):
+        """Start invoking the handler in the handler_executor when items are put in the inbox"""
+        inbox = self._get_inbox_for_handler(handler_name)
+        runner = functools.partial(self._submit_handler_invocation, inbox, handler_name)
+        with self._pending_invocations_cv:
+            self._pending_invocations[handler_name] = 0
+        self._handler_runners[handler_name] = runner
+        inbox.on_item_put = runner
+        # Handle any items that arrived while there was no handler
+        for _ in range(inbox.qsize()):
+            runner()
+
+    def _stop_executor_handler_runner(self, handler_name):
+        """Stop invoking the handler when items are put in the inbox, and wait for the items
+        which have already been submitted to be handled
+        """
+        inbox = self._get_inbox_for_handler(handler_name)
+        inbox.on_item_put = None
+        with self._pending_invocations_cv:
+            while self._pending_invocations[handler_name]:
+                self._pending_invocations_cv.wait()
+        self._handler_runners[handler_name] = None
+        logger.debug("Handler runner for %s has been stopped", handler_name)
+
     def _stop_handler_runner(self, handler_name):
         """Stop and remove a handler runner task.
         All pending items in the corresponding inbox will be handled by the handler before stoppage.
         """
+        if self._handler_executor:
+            self._stop_executor_handler_runner(handler_name)
+            return
         # Add a Handler Runner Killer Sentinel to the relevant inbox
         logger.debug(
             "Adding HandlerRunnerKillerSentinel to inbox corresponding to {} handler runner".format(
@@ -35,6 +35,18 @@ class AbstractInbox:
         """
         pass
 
+    @abstractmethod
+    def _put_many(self, items):
+        """Put multiple items into the Inbox, in order.
+
+        Implementation should be more efficient than putting each item individually.
+        Implementation MUST be a synchronous function.
+        Only to be used by the InboxManager.
+
+        :param list items: The items to put in the Inbox.
+        """
+        pass
+
     @abstractmethod
     def get(self):
         """Remove and return an item from the inbox.
@@ -61,6 +73,29 @@ class AbstractInbox:
         pass
 
 
+class _InboxQueue(queue.Queue):
+    """An unbounded Queue, which can also put several items at once, and be cleared"""
+
+    def put_many(self, items):
+        """Put items into the queue, in order, waking up waiting getters only once"""
+        # The queue is unbounded, so there is no need to wait for free slots
+        with self.mutex:
+            for item in items:
+                self._put(item)
+            self.unfinished_tasks += len(items)
+            self.not_empty.notify(len(items))
+
+    def contains(self, item):
+        """Return True if the item is in the queue"""
+        with self.mutex:
+            return item in self.queue
+
+    def clear(self):
+        """Remove all items from the queue"""
+        with self.mutex:
+            self.queue.clear()
+
+
 class SyncClientInbox(AbstractInbox):
     """Holds generic incoming data for a synchronous client.
 
@@ -69,12 +104,13 @@ class SyncClientInbox(AbstractInbox):
 
     def __init__(self):
         """Initializer for SyncClientInbox"""
-        self._queue = queue.Queue()
+        self._queue = _InboxQueue()
+        # Optional function called after each item is put in the inbox
+        self.on_item_put = None
 
     def __contains__(self, item):
         """Return True if item is in Inbox, False otherwise"""
-        with self._queue.mutex:
-            return item in self._queue.queue
+        return self._queue.contains(item)
 
     def _put(self, item):
         """Put an item into the inbox.
@@ -85,6 +121,20 @@ class SyncClientInbox(AbstractInbox):
         :param item: The item to put in the inbox.
         """
         self._queue.put(item)
+        if self.on_item_put:
+            self.on_item_put()
+
+    def _put_many(self, items):
+        """Put multiple items into the inbox, in order, waking up waiting getters only once.
+
+        Only to be used by the InboxManager.
+
+        :param list items: The items to put in the inbox.
+        """
+        self._queue.put_many(items)
+        if self.on_item_put:
+            for _ in items:
+                self.on_item_put()
 
     def get(self, block=True, timeout=None):
         """Remove and return an item from the inbox.
@@ -103,6 +153,11 @@ class SyncClientInbox(AbstractInbox):
         except queue.Empty:
             raise InboxEmpty("Inbox is empty")
 
+    def qsize(self):
+        """Returns the number of items in the inbox. As with empty(), this may not be accurate.
+        """
+        return self._queue.qsize()
+
     def empty(self):
         """Returns True if the inbox is empty, False otherwise.
 
@@ -123,5 +178,4 @@ class SyncClientInbox(AbstractInbox):
     def clear(self):
         """Remove all items from the inbox.
         """
-        with self._queue.mutex:
-            self._queue.queue.clear()
+        self._queue.clear()
@@ -16,8 +16,8 @@ def execute_patch_for_sync():
     shutdown.__doc__ = IoTHubDeviceClient.shutdown.__doc__
     setattr(IoTHubDeviceClient, "shutdown", shutdown)
 
-    def connect(self):
-        return super(IoTHubDeviceClient, self).connect()
+    def connect(self, timeout=None):
+        return super(IoTHubDeviceClient, self).connect(timeout)
 
     connect.__doc__ = IoTHubDeviceClient.connect.__doc__
     setattr(IoTHubDeviceClient, "connect", connect)
@@ -28,15 +28,15 @@ def execute_patch_for_sync():
     disconnect.__doc__ = IoTHubDeviceClient.disconnect.__doc__
     setattr(IoTHubDeviceClient, "disconnect", disconnect)
 
-    def get_twin(self):
-        return super(IoTHubDeviceClient, self).get_twin()
+    def get_twin(self, timeout=None):
+        return super(IoTHubDeviceClient, self).get_twin(timeout)
 
     get_twin.__doc__ = IoTHubDeviceClient.get_twin.__doc__
     setattr(IoTHubDeviceClient, "get_twin", get_twin)
 
-    def patch_twin_reported_properties(self, reported_properties_patch):
+    def patch_twin_reported_properties(self, reported_properties_patch, timeout=None):
         return super(IoTHubDeviceClient, self).patch_twin_reported_properties(
-            reported_properties_patch
+            reported_properties_patch, timeout
         )
 
     patch_twin_reported_properties.__doc__ = (
@@ -62,14 +62,14 @@ def execute_patch_for_sync():
         receive_twin_desired_properties_patch,
     )
 
-    def send_message(self, message):
-        return super(IoTHubDeviceClient, self).send_message(message)
+    def send_message(self, message, timeout=None):
+        return super(IoTHubDeviceClient, self).send_message(message, timeout)
 
     send_message.__doc__ = IoTHubDeviceClient.send_message.__doc__
     setattr(IoTHubDeviceClient, "send_message", send_message)
 
-    def send_method_response(self, method_response):
-        return super(IoTHubDeviceClient, self).send_method_response(method_response)
+    def send_method_response(self, method_response, timeout=None):
+        return super(IoTHubDeviceClient, self).send_method_response(method_response, timeout)
 
     send_method_response.__doc__ = IoTHubDeviceClient.send_method_response.__doc__
     setattr(IoTHubDeviceClient, "send_method_response", send_method_response)
@@ -138,8 +138,8 @@ def execute_patch_for_sync():
     shutdown.__doc__ = IoTHubModuleClient.shutdown.__doc__
     setattr(IoTHubModuleClient, "shutdown", shutdown)
 
-    def connect(self):
-        return super(IoTHubModuleClient, self).connect()
+    def connect(self, timeout=None):
+        return super(IoTHubModuleClient, self).connect(timeout)
 
     connect.__doc__ = IoTHubModuleClient.connect.__doc__
     setattr(IoTHubModuleClient, "connect", connect)
@@ -150,15 +150,15 @@ def execute_patch_for_sync():
     disconnect.__doc__ = IoTHubModuleClient.disconnect.__doc__
     setattr(IoTHubModuleClient, "disconnect", disconnect)
 
-    def get_twin(self):
-        return super(IoTHubModuleClient, self).get_twin()
+    def get_twin(self, timeout=None):
+        return super(IoTHubModuleClient, self).get_twin(timeout)
 
     get_twin.__doc__ = IoTHubModuleClient.get_twin.__doc__
     setattr(IoTHubModuleClient, "get_twin", get_twin)
 
-    def patch_twin_reported_properties(self, reported_properties_patch):
+    def patch_twin_reported_properties(self, reported_properties_patch, timeout=None):
         return super(IoTHubModuleClient, self).patch_twin_reported_properties(
-            reported_properties_patch
+            reported_properties_patch, timeout
         )
 
     patch_twin_reported_properties.__doc__ = (
@@ -184,14 +184,14 @@ def execute_patch_for_sync():
         receive_twin_desired_properties_patch,
     )
 
-    def send_message(self, message):
-        return super(IoTHubModuleClient, self).send_message(message)
+    def send_message(self, message, timeout=None):
+        return super(IoTHubModuleClient, self).send_message(message, timeout)
 
     send_message.__doc__ = IoTHubModuleClient.send_message.__doc__
     setattr(IoTHubModuleClient, "send_message", send_message)
 
-    def send_method_response(self, method_response):
-        return super(IoTHubModuleClient, self).send_method_response(method_response)
+    def send_method_response(self, method_response, timeout=None):
+        return super(IoTHubModuleClient, self).send_method_response(method_response, timeout)
 
     send_method_response.__doc__ = IoTHubModuleClient.send_method_response.__doc__
     setattr(IoTHubModuleClient, "send_method_response", send_method_response)
@@ -15,6 +15,7 @@ from azure.iot.device.provisioning import pipeline
 
 from azure.iot.device.common.auth import sastoken as st
 from azure.iot.device.common import auth
+from azure.iot.device import exceptions
 
 logger = logging.getLogger(__name__)
 
@@ -23,7 +24,14 @@ def _validate_kwargs(exclude=[], **kwargs):
     """Helper function to validate user provided kwargs.
     Raises TypeError if an invalid option has been provided"""
     # TODO: add support for server_verification_cert
-    valid_kwargs = ["websockets", "cipher", "proxy_options", "sastoken_ttl", "keep_alive"]
+    valid_kwargs = [
+        "websockets",
+        "cipher",
+        "proxy_options",
+        "sastoken_ttl",
+        "keep_alive",
+        "registration_cache",
+    ]
 
     for kwarg in kwargs:
         if (kwarg not in valid_kwargs) or (kwarg in exclude):
@@ -46,6 +54,17 @@ def _get_config_kwargs(**kwargs):
     return config_kwargs
 
 
+# Errors connecting to a hub with a cached registration which mean the registration may no
+# longer be valid, e.g. because the device has been assigned to a different hub, which rejects it.
+CACHE_INVALIDATING_ERRORS = (exceptions.CredentialError,)
+
+# Errors connecting to a hub with a cached registration which mean the hub may be gone, or its
+# hostname may no longer resolve. They are also what a network outage looks like, so the
+# registration is only dropped once connecting with it has failed this many times in a row.
+HUB_FAILURE_ERRORS = (exceptions.ConnectionFailedError,)
+MAX_CACHED_CONNECT_FAILURES = 3
+
+
 def _form_sas_uri(id_scope, registration_id):
     return "{id_scope}/registrations/{registration_id}".format(
         id_scope=id_scope, registration_id=registration_id
@@ -58,7 +77,7 @@ class AbstractProvisioningDeviceClient(object):
     Super class for any client that can be used to register devices to Device Provisioning Service.
     """
 
-    def __init__(self, pipeline):
+    def __init__(self, pipeline, registration_cache=None):
         """
         Initializes the provisioning client.
 
@@ -68,9 +87,12 @@ class AbstractProvisioningDeviceClient(object):
 
         :param pipeline: Instance of the provisioning pipeline object.
         :type pipeline: :class:`azure.iot.device.provisioning.pipeline.MQTTPipeline`
+        :param registration_cache: Optional cache to save registrations in.
+        :type registration_cache: :class:`azure.iot.device.FileRegistrationCache`
         """
         self._pipeline = pipeline
         self._provisioning_payload = None
+        self._registration_cache = registration_cache
 
     @classmethod
     def create_from_symmetric_key(
@@ -107,6 +129,10 @@ class AbstractProvisioningDeviceClient(object):
             broker. If no other messages are being exchanged, this controls the
             rate at which the client will send ping messages to the broker.
             If not provided default value of 60 secs will be used.
+        :param registration_cache: Configuration Option. A cache in which to save the result of
+            successful registrations, so that register_and_connect() can connect with it after a
+            restart without registering again.
+        :type registration_cache: :class:`azure.iot.device.FileRegistrationCache`
         :raises: TypeError if given an unrecognized parameter.
 
         :returns: A ProvisioningDeviceClient instance which can register via Symmetric Key.
@@ -139,7 +165,7 @@ class AbstractProvisioningDeviceClient(object):
         # Pipeline setup
         mqtt_provisioning_pipeline = pipeline.MQTTPipeline(pipeline_configuration)
 
-        return cls(mqtt_provisioning_pipeline)
+        return cls(mqtt_provisioning_pipeline, registration_cache=kwargs.get("registration_cache"))
 
     @classmethod
     def create_from_x509_certificate(
@@ -174,6 +200,10 @@ class AbstractProvisioningDeviceClient(object):
             broker. If no other messages are being exchanged, this controls the
             rate at which the client will send ping messages to the broker.
             If not provided default value of 60 secs will be used.
+        :param registration_cache: Configuration Option. A cache in which to save the result of
+            successful registrations, so that register_and_connect() can connect with it after a
+            restart without registering again.
+        :type registration_cache: :class:`azure.iot.device.FileRegistrationCache`
         :raises: TypeError if given an unrecognized parameter.
 
         :returns: A ProvisioningDeviceClient which can register via X509 client certificates.
@@ -196,7 +226,7 @@ class AbstractProvisioningDeviceClient(object):
         # Pipeline setup
         mqtt_provisioning_pipeline = pipeline.MQTTPipeline(pipeline_configuration)
 
-        return cls(mqtt_provisioning_pipeline)
+        return cls(mqtt_provisioning_pipeline, registration_cache=kwargs.get("registration_cache"))
 
     @abc.abstractmethod
     def register(self):
@@ -205,6 +235,65 @@ class AbstractProvisioningDeviceClient(object):
         """
         pass
 
+    @abc.abstractmethod
+    def register_and_connect(self, connect):
+        """
+        Connect to the hub the device is assigned to, with a cached registration if there is one,
+        and otherwise after registering with the Device Provisioning Service.
+        """
+        pass
+
+    def _load_cached_registration(self):
+        if self._registration_cache is None:
+            return None
+        config = self._pipeline.pipeline_configuration
+        try:
+            result = self._registration_cache.load(config.registration_id, config.id_scope)
+        except Exception as e:
+            logger.warning("Unable to load the cached registration: %s", e)
+            return None
+        if result is not None:
+            logger.info("Using cached registration")
+        return result
+
+    def _save_registration(self, result):
+        if self._registration_cache is None or result is None or result.status != "assigned":
+            return
+        config = self._pipeline.pipeline_configuration
+        try:
+            self._registration_cache.save(config.registration_id, config.id_scope, result)
+        except Exception as e:
+            # The registration is still valid, it just has to be made again on the next start
+            logger.warning("Unable to save the registration to the cache: %s", e)
+
+    def _clear_cached_registration(self):
+        try:
+            self._registration_cache.clear()
+        except Exception as e:
+            logger.warning("Unable to clear the cached registration: %s", e)
+
+    def _record_cached_connect_failure(self):
+        """Returns how many times in a row connecting with the cached registration has failed"""
+        if not hasattr(self._registration_cache, "record_connect_failure"):
+            return MAX_CACHED_CONNECT_FAILURES
+        config = self._pipeline.pipeline_configuration
+        try:
+            return self._registration_cache.record_connect_failure(
+                config.registration_id, config.id_scope
+            )
+        except Exception as e:
+            logger.warning("Unable to record the failure in the registration cache: %s", e)
+            return MAX_CACHED_CONNECT_FAILURES
+
+    def _reset_cached_connect_failures(self):
+        if not hasattr(self._registration_cache, "reset_connect_failures"):
+            return
+        config = self._pipeline.pipeline_configuration
+        try:
+            self._registration_cache.reset_connect_failures(config.registration_id, config.id_scope)
+        except Exception as e:
+            logger.warning("Unable to reset the failures in the registration cache: %s", e)
+
     @property
     def provisioning_payload(self):
         return self._provisioning_payload
@@ -17,6 +17,11 @@ from azure.iot.device.provisioning.abstract_provisioning_device_client import (
 from azure.iot.device.provisioning.abstract_provisioning_device_client import (
     log_on_register_complete,
 )
+from azure.iot.device.provisioning.abstract_provisioning_device_client import (
+    CACHE_INVALIDATING_ERRORS,
+    HUB_FAILURE_ERRORS,
+    MAX_CACHED_CONNECT_FAILURES,
+)
 from azure.iot.device.provisioning.pipeline import exceptions as pipeline_exceptions
 from azure.iot.device import exceptions
 from azure.iot.device.provisioning.pipeline import constant as dps_constant
@@ -90,8 +95,68 @@ class ProvisioningDeviceClient(AbstractProvisioningDeviceClient):
             await handle_result(callback)
             logger.debug("Completed pipeline shutdown operation")
 
+        save_async = async_adapter.emulate_async(self._save_registration)
+        await save_async(result)
+
         return result
 
+    async def register_and_connect(self, connect):
+        """
+        Connect to the hub the device is assigned to.
+
+        If the client was created with a registration_cache holding a registration for this
+        device, that registration is used without contacting the provisioning service. If
+        connecting with it fails with a CredentialError (e.g. because the device has since been
+        assigned to a different hub), or with a ConnectionFailedError several times in a row (e.g.
+        because the hub has been deleted), the cached registration is cleared, and the device is
+        registered again and connected with the new registration. Otherwise, this is the same as
+        calling register(), then connect() with the result.
+
+        :param connect: A coroutine function which takes a RegistrationResult, and connects to the
+            hub it assigns, e.g. by creating an IoTHubDeviceClient with its assigned_hub and
+            device_id, and connecting it. Its return value is returned.
+
+        :returns: A tuple of the RegistrationResult which was used, and the value returned by
+            connect. If registration does not result in an assignment, connect is not called, and
+            the second value is None.
+
+        :raises: Any error raised by register(), or by connect() when it is not using a cached
+            registration.
+        """
+        # The cache may do blocking (e.g. file) I/O, so it is accessed from the executor
+        load_async = async_adapter.emulate_async(self._load_cached_registration)
+        result = await load_async()
+        if result is not None:
+            clear_async = async_adapter.emulate_async(self._clear_cached_registration)
+            try:
+                connected = await connect(result)
+            except CACHE_INVALIDATING_ERRORS as e:
+                logger.info(
+                    "Unable to connect with the cached registration: %s. Registering again.", e
+                )
+                await clear_async()
+            except HUB_FAILURE_ERRORS as e:
+                record_async = async_adapter.emulate_async(self._record_cached_connect_failure)
+                failures = await record_async()
+                if failures < MAX_CACHED_CONNECT_FAILURES:
+                    raise
+                logger.info(
+                    "Unable to connect with the cached registration %s times in a row: %s. "
+                    "Registering again.",
+                    failures,
+                    e,
+                )
+                await clear_async()
+            else:
+                reset_async = async_adapter.emulate_async(self._reset_cached_connect_failures)
+                await reset_async()
+                return result, connected
+
+        result = await self.register()
+        if result is None or result.status != "assigned":
+            return result, None
+        return result, await connect(result)
+
     async def _enable_responses(self):
         """Enable to receive responses from Device Provisioning Service.
         """
@@ -15,19 +15,29 @@ class RegistrationResult(object):
     Values can be "unassigned", "assigning", "assigned", "failed", "disabled"
     :ivar registration_state : Details like device id, assigned hub , date times etc returned
     from the provisioning service.
+    :ivar poll_count: The number of status queries made before the registration process finished.
+    :ivar time_to_assigned: The number of seconds from when registration was first requested until
+    it was assigned, or None if it was not assigned.
     """
 
-    def __init__(self, operation_id, status, registration_state=None):
+    def __init__(
+        self, operation_id, status, registration_state=None, poll_count=0, time_to_assigned=None
+    ):
         """
         :param operation_id: The id of the operation as returned by the initial registration request.
         :param status: The status of the registration process.
         Values can be "unassigned", "assigning", "assigned", "failed", "disabled"
         :param registration_state : Details like device id, assigned hub , date times etc returned
         from the provisioning service.
+        :param poll_count: The number of status queries made before the registration process finished.
+        :param time_to_assigned: The number of seconds from when registration was first requested
+        until it was assigned.
         """
         self._operation_id = operation_id
         self._status = status
         self._registration_state = registration_state
+        self._poll_count = poll_count
+        self._time_to_assigned = time_to_assigned
 
     @property
     def operation_id(self):
@@ -41,6 +51,14 @@ class RegistrationResult(object):
     def registration_state(self):
         return self._registration_state
 
+    @property
+    def poll_count(self):
+        return self._poll_count
+
+    @property
+    def time_to_assigned(self):
+        return self._time_to_assigned
+
     def __str__(self):
         return "\n".join([str(self.registration_state), self.status])
 
@@ -15,6 +15,11 @@ Default interval for polling, to use in case service doesn't provide it to us.
 """
 DEFAULT_POLLING_INTERVAL = 2
 
+"""
+Maximum random jitter added to a polling interval, as a fraction of the interval.
+"""
+POLLING_JITTER = 0.2
+
 """
 Default timeout to use when communicating with the service
 """
@@ -127,6 +127,14 @@ class MQTTPipeline(object):
         # Set the running flag
         self._running = True
 
+    @property
+    def pipeline_configuration(self):
+        """
+        Pipeline Configuration for the pipeline. Note that while a new config object cannot be
+        provided (read-only), the values stored in the config object CAN be changed.
+        """
+        return self._pipeline.pipeline_configuration
+
     def _verify_running(self):
         if not self._running:
             raise pipeline_exceptions.PipelineNotRunning(
@@ -31,6 +31,9 @@ class RegisterOperation(PipelineOperation):
         self.retry_after_timer = None
         self.polling_timer = None
         self.provisioning_timeout_timer = None
+        # Set when the registration is first sent, and used to measure the time to assignment
+        self.start_time = None
+        self.poll_count = 0
 
 
 class PollStatusOperation(PipelineOperation):
@@ -41,12 +44,15 @@ class PollStatusOperation(PipelineOperation):
     This operation is in the group of DPS operations because it is very specific to the DPS client.
     """
 
-    def __init__(self, operation_id, request_payload, callback, registration_result=None):
+    def __init__(
+        self, operation_id, request_payload, callback, registration_result=None, start_time=None
+    ):
         """
         Initializer for PollStatusOperation objects.
 
         :param operation_id: The id of the existing operation for which the polling was started.
         :param request_payload: The request that we are sending to the service
+        :param float start_time: The time at which the registration being polled was first sent.
         :param Function callback: The function that gets called when this operation is complete or has failed.
          The callback function must accept A PipelineOperation object which indicates the specific operation which
          has completed or failed.
@@ -58,3 +64,5 @@ class PollStatusOperation(PipelineOperation):
         self.retry_after_timer = None
         self.polling_timer = None
         self.provisioning_timeout_timer = None
+        self.start_time = start_time
+        self.poll_count = 0
@@ -5,6 +5,7 @@
 # --------------------------------------------------------------------------
 
 from azure.iot.device.common.pipeline import pipeline_ops_base, pipeline_thread
+from azure.iot.device.common import alarm, json_codec
 from azure.iot.device.common.pipeline.pipeline_stages_base import PipelineStage
 from . import pipeline_ops_provisioning
 from azure.iot.device import exceptions
@@ -14,10 +15,9 @@ from azure.iot.device.provisioning.models.registration_result import (
     RegistrationState,
 )
 import logging
-import weakref
-import json
-from threading import Timer
+import random
 import time
+import weakref
 
 logger = logging.getLogger(__name__)
 
@@ -28,8 +28,64 @@ class CommonProvisioningStage(PipelineStage):
     provisioning would both use. It contains some common functions like decoding response
     and retrieving error, retrieving registration status, retrieving operation id
     and forming a complete result.
+
+    The provisioning timeouts, retries and polls of all pipelines are scheduled on the alarm
+    thread shared by the whole process, rather than on a Timer thread for each one.
     """
 
+    def _schedule_alarm(self, interval, method, *args):
+        """Schedule a method of this stage to be called after an interval.
+
+        The alarm only holds a weak reference to the stage, so that a pending (or cancelled, but
+        not yet due) alarm does not keep the stage and its pipeline alive.
+        """
+        self_weakref = weakref.ref(self)
+        function = method.__func__
+
+        def on_alarm(*args):
+            this = self_weakref()
+            if this:
+                function(this, *args)
+
+        return alarm.schedule(time.time() + interval, on_alarm, args=list(args))
+
+    @staticmethod
+    def _get_polling_interval(retry_after):
+        """
+        Return the interval to wait before the next request. This is the Retry-After interval
+        given by the service (or the default polling interval, if none was given), plus a random
+        jitter of up to POLLING_JITTER of that interval, so that devices which were given the same
+        interval don't all poll at once. It is never shorter than the Retry-After interval.
+        """
+        interval = (
+            int(retry_after, 10) if retry_after is not None else constant.DEFAULT_POLLING_INTERVAL
+        )
+        return interval * (1 + random.uniform(0, constant.POLLING_JITTER))
+
+    @pipeline_thread.runs_on_pipeline_thread
+    def _start_timeout_timer(self, op, op_type):
+        logger.debug("{}({}): Creating provisioning timeout timer".format(self.name, op.name))
+        op.provisioning_timeout_timer = self._schedule_alarm(
+            constant.DEFAULT_TIMEOUT_INTERVAL, self._on_provisioning_timeout, op, op_type
+        )
+
+    @pipeline_thread.invoke_on_pipeline_thread_nowait
+    def _on_provisioning_timeout(self, op, op_type):
+        logger.info(
+            "{stage_name}({op_name}): returning timeout error".format(
+                stage_name=self.name, op_name=op.name
+            )
+        )
+        op.complete(
+            error=(
+                exceptions.ServiceError(
+                    "Operation timed out before provisioning service could respond for {op_type} operation".format(
+                        op_type=op_type
+                    )
+                )
+            )
+        )
+
     @pipeline_thread.runs_on_pipeline_thread
     def _clear_timeout_timer(self, op, error):
         """
@@ -41,12 +97,24 @@ class CommonProvisioningStage(PipelineStage):
             op.provisioning_timeout_timer.cancel()
             op.provisioning_timeout_timer = None
 
+    @pipeline_thread.invoke_on_pipeline_thread_nowait
+    def _run_op_again(self, op):
+        logger.info(
+            "{stage_name}({op_name}): retrying".format(stage_name=self.name, op_name=op.name)
+        )
+        op.retry_after_timer = None
+        op.polling_timer = None
+        op.completed = False
+        self.run_op(op)
+
     @staticmethod
     def _decode_response(provisioning_op):
-        return json.loads(provisioning_op.response_body.decode("utf-8"))
+        return json_codec.decode(provisioning_op.response_body)
 
     @staticmethod
-    def _form_complete_result(operation_id, decoded_response, status):
+    def _form_complete_result(
+        operation_id, decoded_response, status, poll_count=0, time_to_assigned=None
+    ):
         """
         Create the registration result from the complete decoded json response for details regarding the registration process.
         """
@@ -64,7 +132,11 @@ class CommonProvisioningStage(PipelineStage):
             )
 
         registration_result = RegistrationResult(
-            operation_id=operation_id, status=status, registration_state=registration_state
+            operation_id=operation_id,
+            status=status,
+            registration_state=registration_state,
+            poll_count=poll_count,
+            time_to_assigned=time_to_assigned,
         )
         return registration_result
 
@@ -94,26 +166,7 @@ class CommonProvisioningStage(PipelineStage):
         )
 
     def _process_retry_status_code(self, error, original_provisioning_op, request_response_op):
-        retry_interval = (
-            int(request_response_op.retry_after, 10)
-            if request_response_op.retry_after is not None
-            else constant.DEFAULT_POLLING_INTERVAL
-        )
-
-        self_weakref = weakref.ref(self)
-
-        @pipeline_thread.invoke_on_pipeline_thread_nowait
-        def do_retry_after():
-            this = self_weakref()
-            logger.info(
-                "{stage_name}({op_name}): retrying".format(
-                    stage_name=this.name, op_name=request_response_op.name
-                )
-            )
-            original_provisioning_op.retry_after_timer.cancel()
-            original_provisioning_op.retry_after_timer = None
-            original_provisioning_op.completed = False
-            this.run_op(original_provisioning_op)
+        retry_interval = self._get_polling_interval(request_response_op.retry_after)
 
         logger.info(
             "{stage_name}({op_name}): Op needs retry with interval {interval} because of {error}. Setting timer.".format(
@@ -125,8 +178,9 @@ class CommonProvisioningStage(PipelineStage):
         )
 
         logger.debug("{}({}): Creating retry timer".format(self.name, request_response_op.name))
-        original_provisioning_op.retry_after_timer = Timer(retry_interval, do_retry_after)
-        original_provisioning_op.retry_after_timer.start()
+        original_provisioning_op.retry_after_timer = self._schedule_alarm(
+            retry_interval, self._run_op_again, original_provisioning_op
+        )
 
     @staticmethod
     def _process_failed_and_assigned_registration_status(
@@ -137,8 +191,20 @@ class CommonProvisioningStage(PipelineStage):
         original_provisioning_op,
         request_response_op,
     ):
+        time_to_assigned = None
+        if registration_status == "assigned" and original_provisioning_op.start_time is not None:
+            time_to_assigned = time.time() - original_provisioning_op.start_time
+            logger.info(
+                "Assigned after {:.3f}s and {} poll(s)".format(
+                    time_to_assigned, original_provisioning_op.poll_count
+                )
+            )
         complete_registration_result = CommonProvisioningStage._form_complete_result(
-            operation_id=operation_id, decoded_response=decoded_response, status=registration_status
+            operation_id=operation_id,
+            decoded_response=decoded_response,
+            status=registration_status,
+            poll_count=original_provisioning_op.poll_count,
+            time_to_assigned=time_to_assigned,
         )
         original_provisioning_op.registration_result = complete_registration_result
         if registration_status == "failed":
@@ -173,31 +239,7 @@ class PollingStatusStage(CommonProvisioningStage):
     def _run_op(self, op):
         if isinstance(op, pipeline_ops_provisioning.PollStatusOperation):
             query_status_op = op
-            self_weakref = weakref.ref(self)
-
-            @pipeline_thread.invoke_on_pipeline_thread_nowait
-            def query_timeout():
-                this = self_weakref()
-                logger.info(
-                    "{stage_name}({op_name}): returning timeout error".format(
-                        stage_name=this.name, op_name=op.name
-                    )
-                )
-                query_status_op.complete(
-                    error=(
-                        exceptions.ServiceError(
-                            "Operation timed out before provisioning service could respond for {op_type} operation".format(
-                                op_type=constant.QUERY
-                            )
-                        )
-                    )
-                )
-
-            logger.debug("{}({}): Creating provisioning timeout timer".format(self.name, op.name))
-            query_status_op.provisioning_timeout_timer = Timer(
-                constant.DEFAULT_TIMEOUT_INTERVAL, query_timeout
-            )
-            query_status_op.provisioning_timeout_timer.start()
+            self._start_timeout_timer(query_status_op, constant.QUERY)
 
             def on_query_response(op, error):
                 self._clear_timeout_timer(query_status_op, error)
@@ -230,25 +272,7 @@ class PollingStatusStage(CommonProvisioningStage):
                         operation_id = decoded_response.get("operationId", None)
                         registration_status = decoded_response.get("status", None)
                         if registration_status == "assigning":
-                            polling_interval = (
-                                int(op.retry_after, 10)
-                                if op.retry_after is not None
-                                else constant.DEFAULT_POLLING_INTERVAL
-                            )
-                            self_weakref = weakref.ref(self)
-
-                            @pipeline_thread.invoke_on_pipeline_thread_nowait
-                            def do_polling():
-                                this = self_weakref()
-                                logger.info(
-                                    "{stage_name}({op_name}): retrying".format(
-                                        stage_name=this.name, op_name=op.name
-                                    )
-                                )
-                                query_status_op.polling_timer.cancel()
-                                query_status_op.polling_timer = None
-                                query_status_op.completed = False
-                                this.run_op(query_status_op)
+                            polling_interval = self._get_polling_interval(op.retry_after)
 
                             logger.debug(
                                 "{stage_name}({op_name}): Op needs retry with interval {interval} because of {error}. Setting timer.".format(
@@ -262,8 +286,9 @@ class PollingStatusStage(CommonProvisioningStage):
                             logger.debug(
                                 "{}({}): Creating polling timer".format(self.name, op.name)
                             )
-                            query_status_op.polling_timer = Timer(polling_interval, do_polling)
-                            query_status_op.polling_timer.start()
+                            query_status_op.polling_timer = self._schedule_alarm(
+                                polling_interval, self._run_op_again, query_status_op
+                            )
 
                         elif registration_status == "assigned" or registration_status == "failed":
                             self._process_failed_and_assigned_registration_status(
@@ -282,6 +307,7 @@ class PollingStatusStage(CommonProvisioningStage):
                                 request_response_op=op,
                             )
 
+            query_status_op.poll_count += 1
             self.send_op_down(
                 pipeline_ops_base.RequestAndResponseOperation(
                     request_type=constant.QUERY,
@@ -311,31 +337,9 @@ class RegistrationStage(CommonProvisioningStage):
     def _run_op(self, op):
         if isinstance(op, pipeline_ops_provisioning.RegisterOperation):
             initial_register_op = op
-            self_weakref = weakref.ref(self)
-
-            @pipeline_thread.invoke_on_pipeline_thread_nowait
-            def register_timeout():
-                this = self_weakref()
-                logger.info(
-                    "{stage_name}({op_name}): returning timeout error".format(
-                        stage_name=this.name, op_name=op.name
-                    )
-                )
-                initial_register_op.complete(
-                    error=(
-                        exceptions.ServiceError(
-                            "Operation timed out before provisioning service could respond for {op_type} operation".format(
-                                op_type=constant.REGISTER
-                            )
-                        )
-                    )
-                )
-
-            logger.debug("{}({}): Creating provisioning timeout timer".format(self.name, op.name))
-            initial_register_op.provisioning_timeout_timer = Timer(
-                constant.DEFAULT_TIMEOUT_INTERVAL, register_timeout
-            )
-            initial_register_op.provisioning_timeout_timer.start()
+            if initial_register_op.start_time is None:
+                initial_register_op.start_time = time.time()
+            self._start_timeout_timer(initial_register_op, constant.REGISTER)
 
             def on_registration_response(op, error):
                 self._clear_timeout_timer(initial_register_op, error)
@@ -366,51 +370,25 @@ class RegistrationStage(CommonProvisioningStage):
                         registration_status = decoded_response.get("status", None)
 
                         if registration_status == "assigning":
-                            self_weakref = weakref.ref(self)
-
-                            def copy_result_to_original_op(op, error):
-                                logger.debug(
-                                    "Copying registration result from Query Status Op to Registration Op"
-                                )
-                                initial_register_op.registration_result = op.registration_result
-                                initial_register_op.error = error
-
-                            @pipeline_thread.invoke_on_pipeline_thread_nowait
-                            def do_query_after_interval():
-                                this = self_weakref()
-                                initial_register_op.polling_timer.cancel()
-                                initial_register_op.polling_timer = None
-
-                                logger.info(
-                                    "{stage_name}({op_name}): polling".format(
-                                        stage_name=this.name, op_name=op.name
-                                    )
-                                )
-
-                                query_worker_op = initial_register_op.spawn_worker_op(
-                                    worker_op_type=pipeline_ops_provisioning.PollStatusOperation,
-                                    request_payload=" ",
-                                    operation_id=operation_id,
-                                    callback=copy_result_to_original_op,
-                                )
-
-                                self.send_op_down(query_worker_op)
+                            polling_interval = self._get_polling_interval(op.retry_after)
 
                             logger.debug(
                                 "{stage_name}({op_name}): Op will transition into polling after interval {interval}.  Setting timer.".format(
                                     stage_name=self.name,
                                     op_name=op.name,
-                                    interval=constant.DEFAULT_POLLING_INTERVAL,
+                                    interval=polling_interval,
                                 )
                             )
 
                             logger.debug(
                                 "{}({}): Creating polling timer".format(self.name, op.name)
                             )
-                            initial_register_op.polling_timer = Timer(
-                                constant.DEFAULT_POLLING_INTERVAL, do_query_after_interval
+                            initial_register_op.polling_timer = self._schedule_alarm(
+                                polling_interval,
+                                self._start_polling,
+                                initial_register_op,
+                                operation_id,
                             )
-                            initial_register_op.polling_timer.start()
 
                         elif registration_status == "failed" or registration_status == "assigned":
                             self._process_failed_and_assigned_registration_status(
@@ -438,7 +416,7 @@ class RegistrationStage(CommonProvisioningStage):
                     request_type=constant.REGISTER,
                     method="PUT",
                     resource_location="/",
-                    request_body=registration_payload.get_json_string(),
+                    request_body=registration_payload.get_json_bytes(),
                     callback=on_registration_response,
                 )
             )
@@ -446,6 +424,32 @@ class RegistrationStage(CommonProvisioningStage):
         else:
             super(RegistrationStage, self)._run_op(op)
 
+    @pipeline_thread.invoke_on_pipeline_thread_nowait
+    def _start_polling(self, initial_register_op, operation_id):
+        initial_register_op.polling_timer = None
+
+        logger.info(
+            "{stage_name}({op_name}): polling".format(
+                stage_name=self.name, op_name=initial_register_op.name
+            )
+        )
+
+        def copy_result_to_original_op(op, error):
+            logger.debug("Copying registration result from Query Status Op to Registration Op")
+            initial_register_op.registration_result = op.registration_result
+            initial_register_op.poll_count = op.poll_count
+            initial_register_op.error = error
+
+        query_worker_op = initial_register_op.spawn_worker_op(
+            worker_op_type=pipeline_ops_provisioning.PollStatusOperation,
+            request_payload=" ",
+            operation_id=operation_id,
+            start_time=initial_register_op.start_time,
+            callback=copy_result_to_original_op,
+        )
+
+        self.send_op_down(query_worker_op)
+
 
 class DeviceRegistrationPayload(object):
     """
@@ -458,5 +462,8 @@ class DeviceRegistrationPayload(object):
         self.registrationId = registration_id
         self.payload = custom_payload
 
+    def get_json_bytes(self):
+        return json_codec.encode(self, default=lambda o: o.__dict__, sort_keys=True)
+
     def get_json_string(self):
-        return json.dumps(self, default=lambda o: o.__dict__, sort_keys=True)
+        return self.get_json_bytes().decode("utf-8")
@@ -8,15 +8,17 @@ This module contains user-facing synchronous Provisioning Device Client for Azur
 Device SDK. This client uses Symmetric Key and X509 authentication to register devices with an
 IoT Hub via the Device Provisioning Service.
 """
+
 import logging
 from azure.iot.device.common.evented_callback import EventedCallback
 from .abstract_provisioning_device_client import AbstractProvisioningDeviceClient
 from .abstract_provisioning_device_client import log_on_register_complete
+from .abstract_provisioning_device_client import CACHE_INVALIDATING_ERRORS
+from .abstract_provisioning_device_client import HUB_FAILURE_ERRORS, MAX_CACHED_CONNECT_FAILURES
 from azure.iot.device.provisioning.pipeline import constant as dps_constant
 from .pipeline import exceptions as pipeline_exceptions
 from azure.iot.device import exceptions
 
-
 logger = logging.getLogger(__name__)
 
 
@@ -91,8 +93,62 @@ class ProvisioningDeviceClient(AbstractProvisioningDeviceClient):
             handle_result(shutdown_complete)
             logger.debug("Completed pipeline shutdown operation")
 
+        self._save_registration(result)
+
         return result
 
+    def register_and_connect(self, connect):
+        """
+        Connect to the hub the device is assigned to.
+
+        If the client was created with a registration_cache holding a registration for this
+        device, that registration is used without contacting the provisioning service. If
+        connecting with it fails with a CredentialError (e.g. because the device has since been
+        assigned to a different hub), or with a ConnectionFailedError several times in a row (e.g.
+        because the hub has been deleted), the cached registration is cleared, and the device is
+        registered again and connected with the new registration. Otherwise, this is the same as
+        calling register(), then connect() with the result.
+
+        :param connect: A function which takes a RegistrationResult, and connects to the hub it
+            assigns, e.g. by creating an IoTHubDeviceClient with its assigned_hub and device_id,
+            and connecting it. Its return value is returned.
+
+        :returns: A tuple of the RegistrationResult which was used, and the value returned by
+            connect. If registration does not result in an assignment, connect is not called, and
+            the second value is None.
+
+        :raises: Any error raised by register(), or by connect() when it is not using a cached
+            registration.
+        """
+        result = self._load_cached_registration()
+        if result is not None:
+            try:
+                connected = connect(result)
+            except CACHE_INVALIDATING_ERRORS as e:
+                logger.info(
+                    "Unable to connect with the cached registration: %s. Registering again.", e
+                )
+                self._clear_cached_registration()
+            except HUB_FAILURE_ERRORS as e:
+                failures = self._record_cached_connect_failure()
+                if failures < MAX_CACHED_CONNECT_FAILURES:
+                    raise
+                logger.info(
+                    "Unable to connect with the cached registration %s times in a row: %s. "
+                    "Registering again.",
+                    failures,
+                    e,
+                )
+                self._clear_cached_registration()
+            else:
+                self._reset_cached_connect_failures()
+                return result, connected
+
+        result = self.register()
+        if result is None or result.status != "assigned":
+            return result, None
+        return result, connect(result)
+
     def _enable_responses(self):
         """Enable to receive responses from Device Provisioning Service.
 
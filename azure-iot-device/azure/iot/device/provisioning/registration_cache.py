@@ -0,0 +1,155 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+"""This module contains a persistent cache of registration results, which lets a device that
+restarts often connect to its assigned hub without registering with the Device Provisioning
+Service every time.
+
+Any object with the same load(), save() and clear() methods as FileRegistrationCache can be used
+as a cache, e.g. to keep the registration in a store other than the local filesystem. It may also
+have the record_connect_failure() and reset_connect_failures() methods, without which a cached
+registration is dropped the first time its hub can't be reached.
+"""
+
+import io
+import json
+import logging
+import os
+import six
+from .models.registration_result import RegistrationResult, RegistrationState
+
+logger = logging.getLogger(__name__)
+
+
+class FileRegistrationCache(object):
+    """A registration cache kept in a JSON file.
+
+    The file holds a single registration, along with the registration ID and ID scope it was made
+    with, so a cache file copied to (or left on) a different device is not used by it.
+    """
+
+    def __init__(self, path):
+        """Initializer for a FileRegistrationCache
+
+        :param str path: The path of the cache file. Its directory must exist.
+        """
+        self.path = path
+
+    def load(self, registration_id, id_scope):
+        """Load the cached registration.
+
+        :param str registration_id: The registration ID the registration must have been made with.
+        :param str id_scope: The ID scope the registration must have been made with.
+
+        :returns: The cached RegistrationResult, or None if there is no (readable) cached
+            registration for the registration ID and ID scope.
+        :rtype: :class:`azure.iot.device.RegistrationResult`
+        """
+        entry = self._read(registration_id, id_scope)
+        if entry is None:
+            return None
+        state = entry.get("registrationState") or {}
+        registration_state = RegistrationState(
+            device_id=state.get("deviceId"),
+            assigned_hub=state.get("assignedHub"),
+            sub_status=state.get("substatus"),
+            created_date_time=state.get("createdDateTimeUtc"),
+            last_update_date_time=state.get("lastUpdatedDateTimeUtc"),
+            etag=state.get("etag"),
+            payload=state.get("payload"),
+        )
+        return RegistrationResult(
+            operation_id=entry.get("operationId"),
+            status=entry.get("status"),
+            registration_state=registration_state,
+        )
+
+    def save(self, registration_id, id_scope, registration_result):
+        """Save a registration, replacing any registration already cached.
+
+        :param str registration_id: The registration ID the registration was made with.
+        :param str id_scope: The ID scope the registration was made with.
+        :param registration_result: The registration to save.
+        :type registration_result: :class:`azure.iot.device.RegistrationResult`
+        """
+        state = registration_result.registration_state
+        entry = {
+            "registrationId": registration_id,
+            "idScope": id_scope,
+            "operationId": registration_result.operation_id,
+            "status": registration_result.status,
+            "registrationState": {
+                "deviceId": state.device_id,
+                "assignedHub": state.assigned_hub,
+                "substatus": state.sub_status,
+                "createdDateTimeUtc": state.created_date_time,
+                "lastUpdatedDateTimeUtc": state.last_update_date_time,
+                "etag": state.etag,
+                "payload": json.loads(state.response_payload),
+            },
+        }
+        self._write(entry)
+
+    def record_connect_failure(self, registration_id, id_scope):
+        """Record that connecting to the hub with the cached registration has failed.
+
+        :param str registration_id: The registration ID the registration was made with.
+        :param str id_scope: The ID scope the registration was made with.
+
+        :returns: The number of times in a row connecting with the cached registration has failed,
+            or 0 if there is no cached registration for the registration ID and ID scope.
+        """
+        entry = self._read(registration_id, id_scope)
+        if entry is None:
+            return 0
+        entry["connectFailures"] = entry.get("connectFailures", 0) + 1
+        self._write(entry)
+        return entry["connectFailures"]
+
+    def reset_connect_failures(self, registration_id, id_scope):
+        """Record that connecting to the hub with the cached registration has succeeded.
+
+        :param str registration_id: The registration ID the registration was made with.
+        :param str id_scope: The ID scope the registration was made with.
+        """
+        entry = self._read(registration_id, id_scope)
+        # Only rewrite the file if there were failures, so a normal start doesn't write to it
+        if entry is not None and entry.pop("connectFailures", 0):
+            self._write(entry)
+
+    def clear(self):
+        """Remove the cached registration, if there is one"""
+        try:
+            os.remove(self.path)
+        except (IOError, OSError):
+            pass
+
+    def _read(self, registration_id, id_scope):
+        try:
+            with io.open(self.path, "r", encoding="utf-8") as cache_file:
+                entry = json.load(cache_file)
+        except (IOError, OSError):
+            return None
+        except ValueError:
+            logger.warning("Ignoring unreadable registration cache file %s", self.path)
+            return None
+        if entry.get("registrationId") != registration_id or entry.get("idScope") != id_scope:
+            logger.info("Ignoring registration cache file for a different registration")
+            return None
+        return entry
+
+    def _write(self, entry):
+        # Write to a temporary file and move it into place, so that a process stopped part way
+        # through never leaves a truncated cache file behind
+        temp_path = self.path + ".tmp"
+        with io.open(temp_path, "w", encoding="utf-8") as cache_file:
+            cache_file.write(six.text_type(json.dumps(entry, sort_keys=True, ensure_ascii=False)))
+        if hasattr(os, "replace"):
+            os.replace(temp_path, self.path)
+        else:
+            # Python 2.7
+            if os.path.exists(self.path):
+                os.remove(self.path)
+            os.rename(temp_path, self.path)
@@ -89,7 +89,11 @@ setup(
         "PySocks",
         "win-inet-pton;python_version == '2.7'",
     ],
-    extras_require={":python_version<'3.0'": ["azure-iot-nspkg>=1.0.1"]},
+    extras_require={
+        ":python_version<'3.0'": ["azure-iot-nspkg>=1.0.1"],
+        # Faster JSON encoding and decoding of twin, method and provisioning payloads
+        "orjson": ["orjson>=3.0.0;python_version>='3.6'"],
+    },
     python_requires=">=2.7.9, !=3.0.*, !=3.1.*, !=3.2.*, !=3.3.*, !=3.4.*, !=3.5.0, !=3.5.1, !=3.5.2, <4",
     packages=find_packages(
         exclude=[
@@ -179,6 +179,99 @@ class TestRenewableSasTokenRefresh(RenewableSasTokenTestConfig):
             sastoken.refresh()
         assert e_info.value.__cause__ is arbitrary_exception
 
+    @pytest.mark.it(
+        "Uses the token prepared by .prepare_refresh() without signing again, if at least half of its lifespan remains"
+    )
+    def test_uses_prepared_token(self, mocker, signing_mechanism, sastoken):
+        mocker.patch.object(time, "time", return_value=1000)
+        signing_mechanism.sign.return_value = "prepared_signature"
+        sastoken.prepare_refresh()
+        signing_mechanism.reset_mock()
+        signing_mechanism.sign.return_value = "new_signature"
+        time.time.return_value = 1000 + sastoken.ttl / 2
+
+        sastoken.refresh()
+
+        assert signing_mechanism.sign.call_count == 0
+        assert sastoken.expiry_time == 1000 + sastoken.ttl
+        assert token_parser(str(sastoken))["sig"] == "prepared_signature"
+
+    @pytest.mark.it(
+        "Signs a new token if the token prepared by .prepare_refresh() has less than half of its lifespan remaining"
+    )
+    def test_stale_prepared_token(self, mocker, signing_mechanism, sastoken):
+        mocker.patch.object(time, "time", return_value=1000)
+        sastoken.prepare_refresh()
+        signing_mechanism.reset_mock()
+        signing_mechanism.sign.return_value = "new_signature"
+        time.time.return_value = 1001 + sastoken.ttl / 2
+
+        sastoken.refresh()
+
+        assert signing_mechanism.sign.call_count == 1
+        assert sastoken.expiry_time == int(1001 + sastoken.ttl / 2 + sastoken.ttl)
+        assert token_parser(str(sastoken))["sig"] == "new_signature"
+
+    @pytest.mark.it("Only uses a prepared token once")
+    def test_prepared_token_used_once(self, signing_mechanism, sastoken):
+        sastoken.prepare_refresh()
+        sastoken.refresh()
+        signing_mechanism.reset_mock()
+
+        sastoken.refresh()
+
+        assert signing_mechanism.sign.call_count == 1
+
+    @pytest.mark.it("Does not change the token if an exception is raised by the signing mechanism")
+    def test_signing_mechanism_raises_token_unchanged(
+        self, signing_mechanism, sastoken, arbitrary_exception
+    ):
+        old_token_str = str(sastoken)
+        old_expiry_time = sastoken.expiry_time
+        signing_mechanism.sign.side_effect = arbitrary_exception
+
+        with pytest.raises(SasTokenError):
+            sastoken.refresh()
+        assert str(sastoken) == old_token_str
+        assert sastoken.expiry_time == old_expiry_time
+
+
+@pytest.mark.describe("RenewableSasToken - .prepare_refresh()")
+class TestRenewableSasTokenPrepareRefresh(RenewableSasTokenTestConfig):
+    @pytest.mark.it(
+        "Uses the token's signing mechanism to sign a token with an expiry time of TTL seconds in the future"
+    )
+    def test_signs_token(self, mocker, signing_mechanism, sastoken):
+        mocker.patch.object(time, "time", return_value=1000)
+        signing_mechanism.reset_mock()
+
+        sastoken.prepare_refresh()
+
+        assert signing_mechanism.sign.call_count == 1
+        assert signing_mechanism.sign.call_args == mocker.call(
+            urllib.parse.quote(sastoken._uri, safe="") + "\n" + str(1000 + sastoken.ttl)
+        )
+
+    @pytest.mark.it("Does not change the current token or expiry time")
+    def test_token_unchanged(self, mocker, signing_mechanism, sastoken):
+        old_token_str = str(sastoken)
+        old_expiry_time = sastoken.expiry_time
+        mocker.patch.object(time, "time", return_value=old_expiry_time)
+        signing_mechanism.sign.return_value = "new_signature"
+
+        sastoken.prepare_refresh()
+
+        assert str(sastoken) == old_token_str
+        assert sastoken.expiry_time == old_expiry_time
+
+    @pytest.mark.it("Raises a SasTokenError if an exception is raised by the signing mechanism")
+    def test_signing_mechanism_raises(self, signing_mechanism, sastoken, arbitrary_exception):
+        signing_mechanism.sign.side_effect = arbitrary_exception
+
+        with pytest.raises(SasTokenError) as e_info:
+            sastoken.prepare_refresh()
+        assert e_info.value.__cause__ is arbitrary_exception
+
 
 @pytest.mark.describe("NonRenewableSasToken")
 class TestNonRenewableSasToken(object):
@@ -5,7 +5,10 @@
 # --------------------------------------------------------------------------
 
 import pytest
+import socket
 import sys
+import threading
+from azure.iot.device.common import ssl_context_cache
 
 collect_ignore = []
 
@@ -18,3 +21,106 @@ if sys.version_info < (3, 5):
 @pytest.fixture
 def fake_return_arg_value():
     return "__fake_return_arg_value__"
+
+
+@pytest.fixture(autouse=True)
+def clear_ssl_context_cache():
+    # Transports created with the same TLS settings share an SSLContext, so don't let a context
+    # (possibly a mock) created by one test be used by another
+    ssl_context_cache.clear()
+    yield
+    ssl_context_cache.clear()
+
+
+CONNECT = 0x10
+PUBLISH = 0x30
+PINGREQ = 0xC0
+DISCONNECT = 0xE0
+
+
+class FakeBroker(object):
+    """Just enough of an MQTT broker to accept connections and acknowledge QoS 1 publishes.
+
+    Python 3 only.
+    """
+
+    def __init__(self):
+        self._server = socket.socket()
+        self._server.bind(("127.0.0.1", 0))
+        self._server.listen(16)
+        self.port = self._server.getsockname()[1]
+        self.publishes = []
+        self.pings = 0
+        self._lock = threading.Lock()
+        self._connections = []
+        self._thread = threading.Thread(target=self._accept)
+        self._thread.daemon = True
+        self._thread.start()
+
+    def close(self):
+        self._server.close()
+        for conn in self._connections:
+            conn.close()
+
+    def _accept(self):
+        while True:
+            try:
+                conn, _ = self._server.accept()
+            except (socket.error, OSError):
+                return
+            self._connections.append(conn)
+            thread = threading.Thread(target=self._serve, args=(conn,))
+            thread.daemon = True
+            thread.start()
+
+    def _read_exactly(self, conn, n):
+        data = b""
+        while len(data) < n:
+            chunk = conn.recv(n - len(data))
+            if not chunk:
+                raise EOFError
+            data += chunk
+        return data
+
+    def _read_packet(self, conn):
+        header = self._read_exactly(conn, 1)[0]
+        length = 0
+        multiplier = 1
+        while True:
+            byte = self._read_exactly(conn, 1)[0]
+            length += (byte & 0x7F) * multiplier
+            multiplier *= 128
+            if not byte & 0x80:
+                break
+        return header, self._read_exactly(conn, length)
+
+    def _serve(self, conn):
+        try:
+            while True:
+                header, body = self._read_packet(conn)
+                packet_type = header & 0xF0
+                if packet_type == CONNECT:
+                    conn.sendall(b"\x20\x02\x00\x00")
+                elif packet_type == PUBLISH:
+                    topic_length = (body[0] << 8) + body[1]
+                    topic = body[2 : 2 + topic_length].decode("utf-8")
+                    mid = body[2 + topic_length : 4 + topic_length]
+                    with self._lock:
+                        self.publishes.append(topic)
+                    conn.sendall(b"\x40\x02" + mid)
+                elif packet_type == PINGREQ:
+                    with self._lock:
+                        self.pings += 1
+                    conn.sendall(b"\xd0\x00")
+                elif packet_type == DISCONNECT:
+                    conn.close()
+                    return
+        except (EOFError, socket.error, OSError):
+            return
+
+
+@pytest.fixture
+def broker():
+    broker = FakeBroker()
+    yield broker
+    broker.close()
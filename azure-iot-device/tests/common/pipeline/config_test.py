@@ -297,3 +297,46 @@ class PipelineConfigInstantiationTestBase(object):
     def test_auto_connect_default(self, config_cls, required_kwargs, sastoken):
         config = config_cls(sastoken=sastoken, **required_kwargs)
         assert config.auto_connect is True
+
+    @pytest.mark.it(
+        "Instantiates with the 'network_loop' attribute set to the provided 'network_loop' parameter"
+    )
+    def test_network_loop_set(self, mocker, config_cls, required_kwargs, sastoken):
+        network_loop = mocker.MagicMock()
+        config = config_cls(sastoken=sastoken, network_loop=network_loop, **required_kwargs)
+        assert config.network_loop is network_loop
+
+    @pytest.mark.it(
+        "Instantiates with the 'network_loop' attribute set to 'None' if no 'network_loop' parameter is provided"
+    )
+    def test_network_loop_default(self, config_cls, required_kwargs, sastoken):
+        config = config_cls(sastoken=sastoken, **required_kwargs)
+        assert config.network_loop is None
+
+    @pytest.mark.it(
+        "Instantiates with the 'adaptive_keep_alive' attribute set to the provided 'adaptive_keep_alive' parameter"
+    )
+    def test_adaptive_keep_alive_set(self, config_cls, required_kwargs, sastoken):
+        config = config_cls(sastoken=sastoken, adaptive_keep_alive=True, **required_kwargs)
+        assert config.adaptive_keep_alive is True
+
+    @pytest.mark.it(
+        "Instantiates with the 'adaptive_keep_alive' attribute set to 'False' if no 'adaptive_keep_alive' parameter is provided"
+    )
+    def test_adaptive_keep_alive_default(self, config_cls, required_kwargs, sastoken):
+        config = config_cls(sastoken=sastoken, **required_kwargs)
+        assert config.adaptive_keep_alive is False
+
+    @pytest.mark.it(
+        "Instantiates with the 'ack_timeout' attribute set to the provided 'ack_timeout' parameter"
+    )
+    def test_ack_timeout_set(self, config_cls, required_kwargs, sastoken):
+        config = config_cls(sastoken=sastoken, ack_timeout=30, **required_kwargs)
+        assert config.ack_timeout == 30
+
+    @pytest.mark.it(
+        "Instantiates with the 'ack_timeout' attribute set to 'None' if no 'ack_timeout' parameter is provided"
+    )
+    def test_ack_timeout_default(self, config_cls, required_kwargs, sastoken):
+        config = config_cls(sastoken=sastoken, **required_kwargs)
+        assert config.ack_timeout is None
@@ -6,10 +6,12 @@
 import inspect
 import pytest
 import functools
+import time
 from threading import Event
 from azure.iot.device.common import handle_exceptions
 from azure.iot.device.common.pipeline import (
     pipeline_events_base,
+    pipeline_exceptions,
     pipeline_ops_base,
     pipeline_stages_base,
     pipeline_events_mqtt,
@@ -49,6 +51,19 @@ class StageRunOpTestBase(object):
             stage.run_op(op)
         assert e_info.value is arbitrary_base_exception
 
+    @pytest.mark.it(
+        "Completes the operation with an OperationTimeout, without executing it, if the operation's deadline has passed"
+    )
+    def test_deadline_passed(self, mocker, stage, op):
+        stage._run_op = mocker.MagicMock()
+        op.deadline = time.time() - 1
+
+        stage.run_op(op)
+
+        assert stage._run_op.call_count == 0
+        assert op.completed
+        assert isinstance(op.error, pipeline_exceptions.OperationTimeout)
+
 
 class StageHandlePipelineEventTestBase(object):
     """All PipelineStage .handle_pipeline_event() tests should inherit from this base class.
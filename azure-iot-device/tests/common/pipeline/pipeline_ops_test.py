@@ -8,6 +8,7 @@ import logging
 import threading
 
 from azure.iot.device.common.pipeline.pipeline_ops_base import PipelineOperation
+from azure.iot.device.common.pipeline import pipeline_ops_base
 from azure.iot.device.common import handle_exceptions
 from azure.iot.device.common.pipeline import pipeline_exceptions
 
@@ -41,7 +42,9 @@ def add_operation_tests(
     class OperationTestConfigClass(op_test_config_class):
         @pytest.fixture
         def op(self, cls_type, init_kwargs, mocker):
-            op = cls_type(**init_kwargs)
+            # Methods can't be spied on per instance for operations that define __slots__, so
+            # use an instance of a (__dict__ enabled) subclass with the same name instead.
+            op = type(cls_type.__name__, (cls_type,), {})(**init_kwargs)
             mocker.spy(op, "complete")
             return op
 
@@ -73,6 +76,17 @@ def add_operation_tests(
             op = cls_type(**init_kwargs)
             assert op.needs_connection is False
 
+        # NOTE: this test should be overridden for operations with a different priority class
+        @pytest.mark.it("Initializes 'priority' attribute as PRIORITY_CONTROL")
+        def test_priority(self, cls_type, init_kwargs):
+            op = cls_type(**init_kwargs)
+            assert op.priority == pipeline_ops_base.PRIORITY_CONTROL
+
+        @pytest.mark.it("Initializes 'deadline' attribute as None")
+        def test_deadline(self, cls_type, init_kwargs):
+            op = cls_type(**init_kwargs)
+            assert op.deadline is None
+
         @pytest.mark.it("Initializes 'callback_stack' list attribute with the provided callback")
         def test_callback_added_to_list(self, cls_type, init_kwargs):
             op = cls_type(**init_kwargs)
@@ -213,6 +227,23 @@ def add_operation_tests(
             assert mock_instance.add_callback.call_count == 1
             assert mock_instance.add_callback.call_args == mocker.call(worker_op_kwargs["callback"])
 
+        @pytest.mark.it("Gives the worker operation the same priority as the operation")
+        @pytest.mark.parametrize(
+            "priority",
+            [pipeline_ops_base.PRIORITY_METHOD_RESPONSE, pipeline_ops_base.PRIORITY_TELEMETRY],
+        )
+        def test_worker_op_priority(self, op, worker_op_type, worker_op_kwargs, priority):
+            op.priority = priority
+            worker_op = op.spawn_worker_op(worker_op_type, **worker_op_kwargs)
+            assert worker_op.priority == priority
+
+        @pytest.mark.it("Gives the worker operation the same deadline as the operation")
+        @pytest.mark.parametrize("deadline", [None, 1234567890.0])
+        def test_worker_op_deadline(self, op, worker_op_type, worker_op_kwargs, deadline):
+            op.deadline = deadline
+            worker_op = op.spawn_worker_op(worker_op_type, **worker_op_kwargs)
+            assert worker_op.deadline == deadline
+
         @pytest.mark.it(
             "Raises TypeError if the provided **kwargs parameters do not match the constructor for the class provided in the 'worker_op_type' parameter"
         )
@@ -661,6 +692,82 @@ def add_operation_tests(
             # Callback was called passing 'None' as the error
             assert cb_mock.call_args == mocker.call(op=op, error=None)
 
+    @pytest.mark.describe("{} - .abandon()".format(op_class_under_test.__name__))
+    class OperationAbandonTests(OperationTestConfigClass):
+        @pytest.fixture
+        def callbacks(self, mocker):
+            # The first two are added above the abandoning stage, the last one below it
+            return [mocker.MagicMock(), mocker.MagicMock(), mocker.MagicMock()]
+
+        @pytest.fixture
+        def boundary_callback(self, mocker):
+            return mocker.MagicMock()
+
+        @pytest.fixture
+        def op(self, cls_type, init_kwargs, callbacks, boundary_callback):
+            init_kwargs["callback"] = callbacks[0]
+            op = cls_type(**init_kwargs)
+            op.add_callback(callbacks[1])
+            op.add_callback(boundary_callback)
+            op.add_callback(callbacks[2])
+            return op
+
+        @pytest.mark.it(
+            "Triggers and removes the callbacks added before the given callback, in LIFO order, passing the operation and the error to each callback"
+        )
+        def test_triggers_callbacks_above(
+            self, mocker, op, callbacks, boundary_callback, arbitrary_exception
+        ):
+            order = []
+            callbacks[0].side_effect = lambda **kwargs: order.append(0)
+            callbacks[1].side_effect = lambda **kwargs: order.append(1)
+
+            op.abandon(boundary_callback, error=arbitrary_exception)
+
+            assert order == [1, 0]
+            assert callbacks[0].call_args == mocker.call(op=op, error=arbitrary_exception)
+            assert callbacks[1].call_args == mocker.call(op=op, error=arbitrary_exception)
+
+        @pytest.mark.it(
+            "Removes the given callback without triggering it, and leaves the callbacks added after it to be triggered when the operation is completed"
+        )
+        def test_leaves_callbacks_below(
+            self, mocker, op, callbacks, boundary_callback, arbitrary_exception
+        ):
+            op.abandon(boundary_callback, error=arbitrary_exception)
+
+            assert op.callback_stack == [callbacks[2]]
+            assert boundary_callback.call_count == 0
+            assert callbacks[2].call_count == 0
+            assert not op.completed
+            assert not op.completing
+            assert op.error is None
+
+            op.complete()
+
+            assert op.completed
+            assert callbacks[2].call_args == mocker.call(op=op, error=None)
+            assert callbacks[0].call_count == 1
+            assert callbacks[1].call_count == 1
+            assert boundary_callback.call_count == 0
+
+        @pytest.mark.it(
+            "Handles any Exceptions raised by a callback by sending them to the background exception handler, and continuing on with the rest"
+        )
+        def test_callback_raises_error(
+            self, mocker, op, callbacks, boundary_callback, arbitrary_exception
+        ):
+            mocker.spy(handle_exceptions, "handle_background_exception")
+            callbacks[1].side_effect = arbitrary_exception
+
+            op.abandon(boundary_callback, error=pipeline_exceptions.OperationTimeout())
+
+            assert callbacks[0].call_count == 1
+            assert handle_exceptions.handle_background_exception.call_count == 1
+            assert handle_exceptions.handle_background_exception.call_args == mocker.call(
+                arbitrary_exception
+            )
+
     @pytest.mark.describe("{} - .halt_completion()".format(op_class_under_test.__name__))
     class OperationHaltCompletionTests(OperationTestConfigClass):
         @pytest.fixture(
@@ -770,6 +877,9 @@ def add_operation_tests(
         "Test{}AddCallback".format(op_class_under_test.__name__),
         OperationAddCallbackTests,
     )
+    setattr(
+        test_module, "Test{}Abandon".format(op_class_under_test.__name__), OperationAbandonTests
+    )
     setattr(
         test_module,
         "Test{}HaltCompletion".format(op_class_under_test.__name__),
@@ -194,6 +194,11 @@ class RequestAndResponseOperationTestConfig(object):
 
 
 class RequestAndResponseOperationInstantiationTests(RequestAndResponseOperationTestConfig):
+    @pytest.mark.it("Initializes 'priority' attribute as PRIORITY_TWIN")
+    def test_priority(self, cls_type, init_kwargs):
+        op = cls_type(**init_kwargs)
+        assert op.priority == pipeline_ops_base.PRIORITY_TWIN
+
     @pytest.mark.it(
         "Initializes 'request_type' attribute with the provided 'request_type' parameter"
     )
@@ -258,6 +263,11 @@ class RequestOperationTestConfig(object):
 
 
 class RequestOperationInstantiationTests(RequestOperationTestConfig):
+    @pytest.mark.it("Initializes 'priority' attribute as PRIORITY_TWIN")
+    def test_priority(self, cls_type, init_kwargs):
+        op = cls_type(**init_kwargs)
+        assert op.priority == pipeline_ops_base.PRIORITY_TWIN
+
     @pytest.mark.it("Initializes the 'method' attribute with the provided 'method' parameter")
     def test_method(self, cls_type, init_kwargs):
         op = cls_type(**init_kwargs)
@@ -6,7 +6,7 @@
 import pytest
 import sys
 import logging
-from azure.iot.device.common.pipeline import pipeline_ops_mqtt
+from azure.iot.device.common.pipeline import pipeline_ops_base, pipeline_ops_mqtt
 from tests.common.pipeline import pipeline_ops_test
 
 logging.basicConfig(level=logging.DEBUG)
@@ -26,6 +26,11 @@ class MQTTPublishOperationTestConfig(object):
 
 
 class MQTTPublishOperationInstantiationTests(MQTTPublishOperationTestConfig):
+    @pytest.mark.it("Initializes 'priority' attribute as PRIORITY_TELEMETRY")
+    def test_priority(self, cls_type, init_kwargs):
+        op = cls_type(**init_kwargs)
+        assert op.priority == pipeline_ops_base.PRIORITY_TELEMETRY
+
     @pytest.mark.it("Initializes 'topic' attribute with the provided 'topic' parameter")
     def test_topic(self, cls_type, init_kwargs):
         op = cls_type(**init_kwargs)
@@ -41,6 +46,11 @@ class MQTTPublishOperationInstantiationTests(MQTTPublishOperationTestConfig):
         op = cls_type(**init_kwargs)
         assert op.needs_connection is True
 
+    @pytest.mark.it("Stores all attributes in slots, without a __dict__")
+    def test_slots(self, cls_type, init_kwargs):
+        op = cls_type(**init_kwargs)
+        assert not hasattr(op, "__dict__")
+
 
 pipeline_ops_test.add_operation_tests(
     test_module=this_module,
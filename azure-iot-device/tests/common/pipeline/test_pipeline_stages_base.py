@@ -11,7 +11,6 @@ import sys
 import six
 import threading
 import random
-import uuid
 from six.moves import queue
 from azure.iot.device.common import transport_exceptions, handle_exceptions, alarm
 from azure.iot.device.common.auth import sastoken as st
@@ -21,9 +20,10 @@ from azure.iot.device.common.pipeline import (
     pipeline_ops_mqtt,
     pipeline_events_base,
     pipeline_exceptions,
+    pipeline_thread,
 )
 from .helpers import StageRunOpTestBase, StageHandlePipelineEventTestBase
-from .fixtures import ArbitraryOperation
+from .fixtures import ArbitraryOperation, ArbitraryEvent
 from tests.common.pipeline import pipeline_stage_test
 
 this_module = sys.modules[__name__]
@@ -46,7 +46,7 @@ def mock_timer(mocker):
 
 @pytest.fixture
 def mock_alarm(mocker):
-    return mocker.patch.object(alarm, "Alarm")
+    return mocker.patch.object(alarm, "schedule")
 
 
 # Not a fixture, but useful for sharing
@@ -230,6 +230,264 @@ class TestPipelineRootStageHandlePipelineEventWithArbitraryEvent(
         assert mock_handler.call_args == mocker.call(event)
 
 
+@pytest.mark.describe("PipelineRootStage - .handle_pipeline_event() -- Event batching")
+class TestPipelineRootStageHandlePipelineEventBatching(PipelineRootStageTestConfig):
+    @pytest.fixture
+    def callback_thread(self):
+        """Blocks the callback thread until released, so that events can arrive while a batch
+        is waiting to be delivered
+        """
+        release = threading.Event()
+        pipeline_thread.invoke_on_callback_thread_nowait(release.wait)()
+
+        class CallbackThread(object):
+            def release(self):
+                release.set()
+                # Wait for everything scheduled on the callback thread so far
+                pipeline_thread.invoke_on_callback_thread_nowait(lambda: None)().result()
+
+        yield CallbackThread()
+        release.set()
+
+    @pytest.fixture
+    def events(self):
+        return [ArbitraryEvent() for _ in range(5)]
+
+    @pytest.mark.it(
+        "Invokes the 'on_pipeline_event_batch_handler' handler function once, with all of the events which arrive while the callback thread is busy, in order"
+    )
+    def test_batch_handler(self, mocker, stage, callback_thread, events):
+        mock_handler = mocker.MagicMock()
+        stage.on_pipeline_event_batch_handler = mock_handler
+        for event in events:
+            stage.handle_pipeline_event(event)
+        callback_thread.release()
+
+        assert mock_handler.call_count == 1
+        assert mock_handler.call_args == mocker.call(events)
+
+    @pytest.mark.it(
+        "Invokes the 'on_pipeline_event_handler' handler function for each event in the batch, if there is no batch handler"
+    )
+    def test_event_handler(self, mocker, stage, callback_thread, events):
+        mock_handler = mocker.MagicMock()
+        stage.on_pipeline_event_handler = mock_handler
+        for event in events:
+            stage.handle_pipeline_event(event)
+        callback_thread.release()
+
+        assert mock_handler.call_args_list == [mocker.call(event) for event in events]
+
+    @pytest.mark.it(
+        "Continues invoking the 'on_pipeline_event_handler' handler function for the rest of the batch if it raises an exception"
+    )
+    def test_event_handler_raises(
+        self, mocker, stage, callback_thread, events, arbitrary_exception
+    ):
+        mock_handler = mocker.MagicMock(side_effect=arbitrary_exception)
+        stage.on_pipeline_event_handler = mock_handler
+        spy_handle_background_exception = mocker.spy(
+            handle_exceptions, "handle_background_exception"
+        )
+        for event in events:
+            stage.handle_pipeline_event(event)
+        callback_thread.release()
+
+        assert mock_handler.call_count == len(events)
+        assert spy_handle_background_exception.call_count == len(events)
+
+    @pytest.mark.it(
+        "Delivers events which arrive after a ConnectedEvent or DisconnectedEvent in a new batch, after the connection state handler has been invoked"
+    )
+    @pytest.mark.parametrize(
+        "connection_event, handler_name",
+        [
+            pytest.param(
+                pipeline_events_base.ConnectedEvent(), "on_connected_handler", id="Connected"
+            ),
+            pytest.param(
+                pipeline_events_base.DisconnectedEvent(),
+                "on_disconnected_handler",
+                id="Disconnected",
+            ),
+        ],
+    )
+    def test_connection_events(
+        self, mocker, stage, callback_thread, events, connection_event, handler_name
+    ):
+        calls = []
+        stage.on_pipeline_event_batch_handler = lambda batch: calls.append(batch)
+        setattr(stage, handler_name, lambda: calls.append(handler_name))
+        stage.handle_pipeline_event(events[0])
+        stage.handle_pipeline_event(connection_event)
+        stage.handle_pipeline_event(events[1])
+        callback_thread.release()
+
+        assert calls == [[events[0]], handler_name, [events[1]]]
+
+
+#####################
+# OP DEADLINE STAGE #
+#####################
+
+
+class OpDeadlineStageTestConfig(object):
+    @pytest.fixture
+    def cls_type(self):
+        return pipeline_stages_base.OpDeadlineStage
+
+    @pytest.fixture
+    def init_kwargs(self, mocker):
+        return {}
+
+    @pytest.fixture
+    def stage(self, mocker, cls_type, init_kwargs):
+        stage = cls_type(**init_kwargs)
+        stage.pipeline_root = pipeline_stages_base.PipelineRootStage(
+            pipeline_configuration=mocker.MagicMock()
+        )
+        stage.send_op_down = mocker.MagicMock()
+        stage.send_event_up = mocker.MagicMock()
+        return stage
+
+
+pipeline_stage_test.add_base_pipeline_stage_tests(
+    test_module=this_module,
+    stage_class_under_test=pipeline_stages_base.OpDeadlineStage,
+    stage_test_config_class=OpDeadlineStageTestConfig,
+)
+
+
+@pytest.mark.describe("OpDeadlineStage - .run_op() -- Called with an operation that has a deadline")
+class TestOpDeadlineStageRunOpWithDeadline(OpDeadlineStageTestConfig, StageRunOpTestBase):
+    @pytest.fixture
+    def op(self, arbitrary_op):
+        arbitrary_op.deadline = time.time() + 60
+        return arbitrary_op
+
+    @pytest.mark.it("Schedules an alarm for the operation's deadline")
+    def test_schedules_alarm(self, mocker, stage, op, mock_alarm):
+        stage.run_op(op)
+
+        assert mock_alarm.call_count == 1
+        assert mock_alarm.call_args == mocker.call(op.deadline, stage._on_deadline, args=[op])
+        assert stage.deadline_alarms == {op: mock_alarm.return_value}
+
+    @pytest.mark.it("Sends the operation down the pipeline")
+    def test_sends_down(self, mocker, stage, op, mock_alarm):
+        stage.run_op(op)
+
+        assert stage.send_op_down.call_count == 1
+        assert stage.send_op_down.call_args == mocker.call(op)
+
+
+@pytest.mark.describe(
+    "OpDeadlineStage - .run_op() -- Called with an operation that does not have a deadline"
+)
+class TestOpDeadlineStageRunOpWithoutDeadline(OpDeadlineStageTestConfig, StageRunOpTestBase):
+    @pytest.fixture
+    def op(self, arbitrary_op):
+        return arbitrary_op
+
+    @pytest.mark.it("Sends the operation down the pipeline without scheduling an alarm")
+    def test_sends_down(self, mocker, stage, op, mock_alarm):
+        stage.run_op(op)
+
+        assert stage.send_op_down.call_count == 1
+        assert stage.send_op_down.call_args == mocker.call(op)
+        assert mock_alarm.call_count == 0
+
+
+@pytest.mark.describe("OpDeadlineStage - OCCURANCE: Deadline alarm expires")
+class TestOpDeadlineStageOCCURANCEAlarmExpires(OpDeadlineStageTestConfig):
+    @pytest.fixture
+    def op(self, arbitrary_op):
+        arbitrary_op.deadline = time.time() + 60
+        return arbitrary_op
+
+    @pytest.fixture
+    def on_deadline(self, stage, op, mock_alarm):
+        stage.run_op(op)
+        on_deadline = mock_alarm.call_args[0][1]
+        args = mock_alarm.call_args[1]["args"]
+        return lambda: on_deadline(*args)
+
+    @pytest.mark.it(
+        "Triggers the callbacks added to the operation before this stage with an OperationTimeout"
+    )
+    def test_fails_callbacks_above(self, mocker, stage, op, on_deadline):
+        callback = op.callback_stack[0]
+        assert not op.completed
+
+        on_deadline()
+
+        assert callback.call_count == 1
+        assert isinstance(callback.call_args[1]["error"], pipeline_exceptions.OperationTimeout)
+        assert op.callback_stack == []
+
+    @pytest.mark.it(
+        "Leaves the operation to be completed by the stage below that is holding it, triggering the callbacks added below this stage only then"
+    )
+    def test_leaves_op_below(self, mocker, stage, op, on_deadline):
+        callback = op.callback_stack[0]
+        # e.g. a ConnectionLockStage, which releases its lock when the connect completes
+        lower_callback = mocker.MagicMock()
+        op.add_callback(lower_callback)
+
+        on_deadline()
+
+        assert not op.completed
+        assert lower_callback.call_count == 0
+
+        op.complete()
+
+        assert op.completed
+        assert lower_callback.call_args == mocker.call(op=op, error=None)
+        assert callback.call_count == 1
+
+    @pytest.mark.it("Does not send anything to the background exception handler")
+    def test_no_background_exception(self, mocker, stage, op, on_deadline):
+        mocker.spy(handle_exceptions, "handle_background_exception")
+
+        on_deadline()
+        op.complete()
+
+        assert handle_exceptions.handle_background_exception.call_count == 0
+
+    @pytest.mark.it("Does nothing if the operation has already completed")
+    def test_already_completed(self, mocker, stage, op, on_deadline):
+        callback = op.callback_stack[0]
+        op.complete()
+
+        on_deadline()
+
+        assert op.completed
+        assert op.error is None
+        assert callback.call_count == 1
+        assert callback.call_args == mocker.call(op=op, error=None)
+
+
+@pytest.mark.describe("OpDeadlineStage - OCCURANCE: Operation completes before its deadline")
+class TestOpDeadlineStageOCCURANCEOpCompletes(OpDeadlineStageTestConfig):
+    @pytest.fixture
+    def op(self, arbitrary_op):
+        arbitrary_op.deadline = time.time() + 60
+        return arbitrary_op
+
+    @pytest.mark.it("Cancels the deadline alarm")
+    @pytest.mark.parametrize(
+        "error", [None, Exception()], ids=["Completed successfully", "Completed with error"]
+    )
+    def test_cancels_alarm(self, mocker, stage, op, mock_alarm, error):
+        stage.run_op(op)
+        assert mock_alarm.return_value.cancel.call_count == 0
+
+        op.complete(error=error)
+
+        assert mock_alarm.return_value.cancel.call_count == 1
+        assert stage.deadline_alarms == {}
+
+
 ###########################
 # SAS TOKEN RENEWAL STAGE #
 ###########################
@@ -272,6 +530,11 @@ class SasTokenRenewalStageInstantationTests(SasTokenRenewalStageTestConfig):
         stage = pipeline_stages_base.SasTokenRenewalStage(**init_kwargs)
         assert stage._token_renewal_alarm is None
 
+    @pytest.mark.it("Initializes with the token prepare alarm set to 'None'")
+    def test_token_prepare_alarm(self, init_kwargs):
+        stage = pipeline_stages_base.SasTokenRenewalStage(**init_kwargs)
+        assert stage._token_prepare_alarm is None
+
     @pytest.mark.it("Uses 120 seconds as the Renewal Margin by default")
     def test_renewal_margin(self, init_kwargs):
         # NOTE: currently, renewal margin isn't set as an instance attribute really, it just uses
@@ -280,6 +543,11 @@ class SasTokenRenewalStageInstantationTests(SasTokenRenewalStageTestConfig):
         stage = pipeline_stages_base.SasTokenRenewalStage(**init_kwargs)
         assert stage.DEFAULT_TOKEN_RENEWAL_MARGIN == 120
 
+    @pytest.mark.it("Uses 60 seconds as the Prepare Lead Time by default")
+    def test_prepare_lead_time(self, init_kwargs):
+        stage = pipeline_stages_base.SasTokenRenewalStage(**init_kwargs)
+        assert stage.DEFAULT_TOKEN_PREPARE_LEAD_TIME == 60
+
 
 pipeline_stage_test.add_base_pipeline_stage_tests(
     test_module=this_module,
@@ -299,14 +567,21 @@ class TestSasTokenRenewalStageRunOpWithInitializePipelineOpSasTokenConfig(
     def op(self, mocker):
         return pipeline_ops_base.InitializePipelineOperation(callback=mocker.MagicMock())
 
-    @pytest.mark.it("Cancels any existing token renewal alarm that may have been set")
+    @pytest.mark.it(
+        "Cancels any existing token renewal and token prepare alarms that may have been set"
+    )
     def test_cancels_existing_alarm(self, mocker, mock_alarm, stage, op):
-        stage._token_renewal_alarm = mock_alarm
+        old_renewal_alarm = mocker.MagicMock()
+        old_prepare_alarm = mocker.MagicMock()
+        stage._token_renewal_alarm = old_renewal_alarm
+        stage._token_prepare_alarm = old_prepare_alarm
 
         stage.run_op(op)
 
-        assert mock_alarm.cancel.call_count == 1
-        assert mock_alarm.cancel.call_args == mocker.call()
+        assert old_renewal_alarm.cancel.call_count == 1
+        assert old_renewal_alarm.cancel.call_args == mocker.call()
+        assert old_prepare_alarm.cancel.call_count == 1
+        assert old_prepare_alarm.cancel.call_args == mocker.call()
 
     @pytest.mark.it("Resets the token renewal alarm to None until a new one is set")
     # Edge case, since unless something goes wrong, the alarm WILL be set, and it's like
@@ -326,9 +601,10 @@ class TestSasTokenRenewalStageRunOpWithInitializePipelineOpSasTokenConfig(
         assert op.complete
         assert op.error is arbitrary_exception
         assert stage._token_renewal_alarm is None
+        assert stage._token_prepare_alarm is None
 
     @pytest.mark.it(
-        "Starts a background renewal alarm that will trigger 'Renewal Margin' number of seconds prior to SasToken expiration"
+        "Schedules a renewal alarm on the shared alarm thread that will trigger 'Renewal Margin' number of seconds prior to SasToken expiration"
     )
     def test_sets_alarm(self, mocker, stage, op, mock_alarm):
         expected_alarm_time = (
@@ -338,11 +614,25 @@ class TestSasTokenRenewalStageRunOpWithInitializePipelineOpSasTokenConfig(
 
         stage.run_op(op)
 
-        assert mock_alarm.call_count == 1
+        assert mock_alarm.call_count == 2
         assert mock_alarm.call_args[0][0] == expected_alarm_time
-        assert mock_alarm.return_value.daemon is True
-        assert mock_alarm.return_value.start.call_count == 1
-        assert mock_alarm.return_value.start.call_args == mocker.call()
+        assert stage._token_renewal_alarm is mock_alarm.return_value
+
+    @pytest.mark.it(
+        "Schedules an alarm to prepare the renewal, which will trigger 'Prepare Lead Time' number of seconds prior to the renewal alarm"
+    )
+    def test_sets_prepare_alarm(self, mocker, stage, op, mock_alarm):
+        expected_alarm_time = (
+            stage.pipeline_root.pipeline_configuration.sastoken.expiry_time
+            - pipeline_stages_base.SasTokenRenewalStage.DEFAULT_TOKEN_RENEWAL_MARGIN
+            - pipeline_stages_base.SasTokenRenewalStage.DEFAULT_TOKEN_PREPARE_LEAD_TIME
+        )
+
+        stage.run_op(op)
+
+        assert mock_alarm.call_count == 2
+        assert mock_alarm.call_args_list[0][0][0] == expected_alarm_time
+        assert stage._token_prepare_alarm is mock_alarm.return_value
 
 
 @pytest.mark.describe(
@@ -375,6 +665,7 @@ class TestSasTokenRenewalStageRunOpWithInitializePipelineOpNoSasTokenConfig(
         assert stage.send_op_down.call_count == 1
         assert stage.send_op_down.call_args == mocker.call(op)
         assert stage._token_renewal_alarm is None
+        assert stage._token_prepare_alarm is None
         assert mock_alarm.call_count == 0
 
 
@@ -387,16 +678,19 @@ class TestSasTokenRenewalStageRunOpWithShutdownPipelineOp(
         return pipeline_ops_base.ShutdownPipelineOperation(callback=mocker.MagicMock())
 
     @pytest.mark.it(
-        "Cancels the token renewal alarm, and then sends the operation down, if an alarm exists"
+        "Cancels the token renewal and token prepare alarms, and then sends the operation down, if the alarms exist"
     )
     def test_with_timer(self, mocker, stage, op, mock_alarm):
         stage._token_renewal_alarm = mock_alarm
+        stage._token_prepare_alarm = mock_alarm
         assert mock_alarm.cancel.call_count == 0
         assert stage.send_op_down.call_count == 0
 
         stage.run_op(op)
 
-        assert mock_alarm.cancel.call_count == 1
+        assert mock_alarm.cancel.call_count == 2
+        assert stage._token_renewal_alarm is None
+        assert stage._token_prepare_alarm is None
         assert stage.send_op_down.call_count == 1
         assert stage.send_op_down.call_args == mocker.call(op)
 
@@ -417,6 +711,40 @@ class TestSasTokenRenewalStageOCCURANCETimerExpires(SasTokenRenewalStageTestConf
     def op(self, mocker):
         return pipeline_ops_base.InitializePipelineOperation(callback=mocker.MagicMock())
 
+    @pytest.fixture(autouse=True)
+    def mock_sastoken_thread(self, mocker):
+        # Run the work handed off to the SAS token thread inline
+        return mocker.patch.object(
+            pipeline_thread, "invoke_on_sastoken_thread_nowait", side_effect=lambda func: func
+        )
+
+    @pytest.mark.it(
+        "Prepares the SasToken refresh in the SAS token thread, rather than in the alarm thread, when the prepare alarm expires"
+    )
+    def test_hands_off_prepare(self, mocker, stage, op, mock_alarm, mock_sastoken_thread):
+        handed_off = []
+
+        def fake_invoke(func):
+            return lambda: handed_off.append(func)
+
+        mock_sastoken_thread.side_effect = fake_invoke
+        stage.run_op(op)
+        token = stage.pipeline_root.pipeline_configuration.sastoken
+        mocker.patch.object(token, "prepare_refresh")
+
+        # Call prepare alarm complete callback (as if alarm expired)
+        on_prepare_alarm_complete = mock_alarm.call_args_list[0][0][1]
+        on_prepare_alarm_complete()
+
+        # Nothing was signed in the alarm thread
+        assert len(handed_off) == 1
+        assert token.prepare_refresh.call_count == 0
+
+        # The work runs once the SAS token thread gets to it, without refreshing the token
+        handed_off[0]()
+        assert token.prepare_refresh.call_count == 1
+        assert token.refresh.call_count == 0
+
     @pytest.mark.it("Refreshes the pipeline's SasToken")
     @pytest.mark.parametrize(
         "connected",
@@ -435,7 +763,7 @@ class TestSasTokenRenewalStageOCCURANCETimerExpires(SasTokenRenewalStageTestConf
         # Token has not been refreshed
         token = stage.pipeline_root.pipeline_configuration.sastoken
         assert token.refresh.call_count == 0
-        assert mock_alarm.call_count == 1
+        assert mock_alarm.call_count == 2
 
         # Call alarm complete callback (as if alarm expired)
         on_alarm_complete = mock_alarm.call_args[0][1]
@@ -444,6 +772,39 @@ class TestSasTokenRenewalStageOCCURANCETimerExpires(SasTokenRenewalStageTestConf
         # Token has now been refreshed
         assert token.refresh.call_count == 1
 
+    @pytest.mark.it(
+        "Refreshes the SasToken without preparing it again, if the refresh was prepared by the prepare alarm"
+    )
+    def test_prepares_refresh(self, mocker, stage, op, mock_alarm):
+        stage.run_op(op)
+        token = stage.pipeline_root.pipeline_configuration.sastoken
+        manager = mocker.MagicMock()
+        mocker.patch.object(token, "prepare_refresh", manager.prepare_refresh)
+        token.refresh = manager.refresh
+
+        # Call prepare alarm, then renewal alarm complete callbacks (as if the alarms expired)
+        on_prepare_alarm_complete = mock_alarm.call_args_list[0][0][1]
+        on_alarm_complete = mock_alarm.call_args_list[1][0][1]
+        on_prepare_alarm_complete()
+        on_alarm_complete()
+
+        assert manager.mock_calls == [mocker.call.prepare_refresh(), mocker.call.refresh()]
+
+    @pytest.mark.it("Still refreshes the SasToken if preparing the refresh raises an exception")
+    def test_prepare_refresh_raises(self, mocker, stage, op, mock_alarm, arbitrary_exception):
+        stage.run_op(op)
+        token = stage.pipeline_root.pipeline_configuration.sastoken
+        mocker.patch.object(token, "prepare_refresh", side_effect=arbitrary_exception)
+
+        # Call prepare alarm, then renewal alarm complete callbacks (as if the alarms expired)
+        on_prepare_alarm_complete = mock_alarm.call_args_list[0][0][1]
+        on_alarm_complete = mock_alarm.call_args_list[1][0][1]
+        on_prepare_alarm_complete()
+        on_alarm_complete()
+
+        assert token.prepare_refresh.call_count == 1
+        assert token.refresh.call_count == 1
+
     @pytest.mark.it(
         "Sends a ReauthorizeConnectionOperation down the pipeline if the pipeline is in a 'connected' state"
     )
@@ -460,7 +821,7 @@ class TestSasTokenRenewalStageOCCURANCETimerExpires(SasTokenRenewalStageTestConf
         assert stage.pipeline_root.connected is True
 
         # Call alarm complete callback (as if alarm expired)
-        assert mock_alarm.call_count == 1
+        assert mock_alarm.call_count == 2
         on_alarm_complete = mock_alarm.call_args[0][1]
         on_alarm_complete()
 
@@ -505,7 +866,7 @@ class TestSasTokenRenewalStageOCCURANCETimerExpires(SasTokenRenewalStageTestConf
         stage.run_op(op)
 
         # Call alarm complete callback (as if alarm expired)
-        assert mock_alarm.call_count == 1
+        assert mock_alarm.call_count == 2
         on_alarm_complete = mock_alarm.call_args[0][1]
         on_alarm_complete()
 
@@ -546,17 +907,17 @@ class TestSasTokenRenewalStageOCCURANCETimerExpires(SasTokenRenewalStageTestConf
         assert stage.send_op_down.call_count == 1
         assert stage.send_op_down.call_args == mocker.call(op)
 
-        # Only one alarm has been created and started. No cancellation.
-        assert mock_alarm.call_count == 1
-        assert mock_alarm.return_value.start.call_count == 1
+        # Only one renewal alarm (and the alarm preparing for it) has been scheduled.
+        # No cancellation.
+        assert mock_alarm.call_count == 2
         assert mock_alarm.return_value.cancel.call_count == 0
 
         # Call alarm complete callback (as if alarm expired)
         on_alarm_complete = mock_alarm.call_args[0][1]
         on_alarm_complete()
 
-        # Existing alarm was cancelled
-        assert mock_alarm.return_value.cancel.call_count == 1
+        # Existing alarms were cancelled
+        assert mock_alarm.return_value.cancel.call_count == 2
 
         # Token was refreshed
         assert token.refresh.call_count == 1
@@ -570,17 +931,14 @@ class TestSasTokenRenewalStageOCCURANCETimerExpires(SasTokenRenewalStageTestConf
         else:
             assert stage.send_op_down.call_count == 1
 
-        # Another alarm was created and started for the expected time
-        assert mock_alarm.call_count == 2
+        # Another alarm was scheduled for the expected time
+        assert mock_alarm.call_count == 4
         expected_alarm_time = (
             stage.pipeline_root.pipeline_configuration.sastoken.expiry_time
             - pipeline_stages_base.SasTokenRenewalStage.DEFAULT_TOKEN_RENEWAL_MARGIN
         )
         assert mock_alarm.call_args[0][0] == expected_alarm_time
         assert stage._token_renewal_alarm is mock_alarm.return_value
-        assert stage._token_renewal_alarm.daemon is True
-        assert stage._token_renewal_alarm.start.call_count == 2
-        assert stage._token_renewal_alarm.start.call_args == mocker.call()
 
         # When THAT alarm expires, the token is refreshed, and the reauth is sent, etc. etc. etc.
         # ... recursion :)
@@ -596,7 +954,7 @@ class TestSasTokenRenewalStageOCCURANCETimerExpires(SasTokenRenewalStageTestConf
         else:
             assert stage.send_op_down.call_count == 1
 
-        assert mock_alarm.call_count == 3
+        assert mock_alarm.call_count == 6
         # .... and on and on for infinity
 
 
@@ -826,6 +1184,26 @@ class TestAutoConnectStageRunOpWithOpThatRequiresConnectionNotConnected(
         assert stage.send_op_down.call_count == 1
         assert stage.send_op_down.call_args == mocker.call(mock_connect_op)
 
+    @pytest.mark.it("Gives the ConnectOperation the priority of the operation")
+    @pytest.mark.parametrize(
+        "priority",
+        [
+            pipeline_ops_base.PRIORITY_CONTROL,
+            pipeline_ops_base.PRIORITY_METHOD_RESPONSE,
+            pipeline_ops_base.PRIORITY_TWIN,
+            pipeline_ops_base.PRIORITY_TELEMETRY,
+        ],
+    )
+    def test_connect_op_priority(self, mocker, stage, op, priority):
+        stage.pipeline_root.connected = False
+        op.priority = priority
+
+        stage.run_op(op)
+
+        connect_op = stage.send_op_down.call_args[0][0]
+        assert isinstance(connect_op, pipeline_ops_base.ConnectOperation)
+        assert connect_op.priority == priority
+
     @pytest.mark.it(
         "Sends the operation down the pipeline once the ConnectOperation completes successfully"
     )
@@ -1117,9 +1495,10 @@ class ConnectionLockStageTestConfig(object):
 
 
 class ConnectionLockStageInstantiationTests(ConnectionLockStageTestConfig):
-    @pytest.mark.it("Initializes 'queue' as an empty Queue object")
+    @pytest.mark.it("Initializes 'queue' as an empty OperationPriorityQueue object")
     def test_queue(self, init_kwargs):
         stage = pipeline_stages_base.ConnectionLockStage(**init_kwargs)
+        assert isinstance(stage.queue, pipeline_stages_base.OperationPriorityQueue)
         assert isinstance(stage.queue, queue.Queue)
         assert stage.queue.empty()
 
@@ -1474,6 +1853,71 @@ class TestConnectionLockStageBlockingOpCompletedNoError(
         # the .run_op() calls, this could end up having items, but that case is covered by a different test
         assert stage.queue.qsize() == 0
 
+    @pytest.mark.it(
+        "Re-runs pending operations of a higher priority class before those of a lower priority class"
+    )
+    def test_priority_order(self, mocker, blocked_stage, pending_ops, blocking_op):
+        stage = blocked_stage
+        telemetry_op = ArbitraryOperation(callback=mocker.MagicMock())
+        telemetry_op.priority = pipeline_ops_base.PRIORITY_TELEMETRY
+        twin_op = ArbitraryOperation(callback=mocker.MagicMock())
+        twin_op.priority = pipeline_ops_base.PRIORITY_TWIN
+        method_response_op = ArbitraryOperation(callback=mocker.MagicMock())
+        method_response_op.priority = pipeline_ops_base.PRIORITY_METHOD_RESPONSE
+        stage.run_op(telemetry_op)
+        stage.run_op(twin_op)
+        stage.run_op(method_response_op)
+        stage.run_op.reset_mock()
+
+        blocking_op.complete()
+
+        # pending_ops are control operations, which keep their FIFO order
+        assert stage.run_op.call_args_list == [mocker.call(op) for op in pending_ops] + [
+            mocker.call(method_response_op),
+            mocker.call(twin_op),
+            mocker.call(telemetry_op),
+        ]
+
+    @pytest.mark.it(
+        "Re-runs operations queued before a queued connect, disconnect, or reauthorize operation before it, regardless of priority"
+    )
+    @pytest.mark.parametrize("barrier_op_cls", connection_ops)
+    def test_priority_order_barrier(
+        self, mocker, blocked_stage, pending_ops, blocking_op, barrier_op_cls
+    ):
+        stage = blocked_stage
+        # e.g. send_message() followed by disconnect()
+        telemetry_op = ArbitraryOperation(callback=mocker.MagicMock())
+        telemetry_op.priority = pipeline_ops_base.PRIORITY_TELEMETRY
+        barrier_op = barrier_op_cls(callback=mocker.MagicMock())
+        later_telemetry_op = ArbitraryOperation(callback=mocker.MagicMock())
+        later_telemetry_op.priority = pipeline_ops_base.PRIORITY_TELEMETRY
+        later_twin_op = ArbitraryOperation(callback=mocker.MagicMock())
+        later_twin_op.priority = pipeline_ops_base.PRIORITY_TWIN
+        stage.run_op(telemetry_op)
+        stage.run_op(barrier_op)
+        stage.run_op(later_telemetry_op)
+        stage.run_op(later_twin_op)
+        stage.run_op.reset_mock()
+        # Leave the barrier op pending once it is re-run, so it blocks the stage again
+        stage.pipeline_root.connected = not isinstance(
+            barrier_op, pipeline_ops_base.ConnectOperation
+        )
+
+        blocking_op.complete()
+
+        assert stage.run_op.call_args_list[: len(pending_ops) + 2] == [
+            mocker.call(op) for op in pending_ops
+        ] + [mocker.call(telemetry_op), mocker.call(barrier_op)]
+        assert telemetry_op in [c[0][0] for c in stage.send_op_down.call_args_list]
+        # The ops queued after the barrier are queued again, behind it, in priority order
+        stage.run_op.reset_mock()
+        barrier_op.complete()
+        assert stage.run_op.call_args_list == [
+            mocker.call(later_twin_op),
+            mocker.call(later_telemetry_op),
+        ]
+
     @pytest.mark.it("Unblocks the ConnectionLockStage prior to re-running any pending operations")
     def test_unblocks_before_rerun(self, mocker, blocked_stage, blocking_op, pending_ops):
         stage = blocked_stage
@@ -1619,11 +2063,21 @@ class TestConnectionLockStageBlockingOpCompletedWithError(
 
 
 @pytest.fixture
-def fake_uuid(mocker):
-    my_uuid = "0f4f876b-f445-432e-a8de-43bbd66e4668"
-    uuid4_mock = mocker.patch.object(uuid, "uuid4")
-    uuid4_mock.return_value.__str__.return_value = my_uuid
-    return my_uuid
+def fake_request_id(mocker):
+    my_request_id = "0f4f876b2a"
+    mocker.patch.object(
+        pipeline_stages_base.CoordinateRequestAndResponseStage,
+        "_get_next_request_id",
+        return_value=my_request_id,
+    )
+    return my_request_id
+
+
+@pytest.fixture
+def mock_time(mocker):
+    mock = mocker.patch.object(time, "time")
+    mock.return_value = 1000.0
+    return mock
 
 
 class CoordinateRequestAndResponseStageTestConfig(object):
@@ -1654,6 +2108,41 @@ class CoordinateRequestAndResponseStageInstantiationTests(
         stage = pipeline_stages_base.CoordinateRequestAndResponseStage(**init_kwargs)
         assert stage.pending_responses == {}
 
+    @pytest.mark.it("Initializes 'response_timeout' as 60 seconds")
+    def test_response_timeout(self, init_kwargs):
+        stage = pipeline_stages_base.CoordinateRequestAndResponseStage(**init_kwargs)
+        assert stage.response_timeout == 60
+
+    @pytest.mark.it(
+        "Initializes 'response_timeouts' from the 'response_timeouts' parameter, or as an empty dict"
+    )
+    @pytest.mark.parametrize(
+        "response_timeouts", [None, {"some_request_type": 10}], ids=["Not provided", "Provided"]
+    )
+    def test_response_timeouts(self, response_timeouts):
+        stage = pipeline_stages_base.CoordinateRequestAndResponseStage(
+            response_timeouts=response_timeouts
+        )
+        assert stage.response_timeouts == (response_timeouts or {})
+
+    @pytest.mark.it("Initializes 'deadline_alarm' as None")
+    def test_deadline_alarm(self, init_kwargs):
+        stage = pipeline_stages_base.CoordinateRequestAndResponseStage(**init_kwargs)
+        assert stage.deadline_alarm is None
+
+    @pytest.mark.it("Initializes the 'pending', 'expired' and 'late' response counts as 0")
+    def test_counters(self, init_kwargs):
+        stage = pipeline_stages_base.CoordinateRequestAndResponseStage(**init_kwargs)
+        assert stage.pending_response_count == 0
+        assert stage.expired_response_count == 0
+        assert stage.late_response_count == 0
+
+    @pytest.mark.it("Initializes 'request_id_prefix' with a different value for each instance")
+    def test_request_id_prefix(self, init_kwargs):
+        stage1 = pipeline_stages_base.CoordinateRequestAndResponseStage(**init_kwargs)
+        stage2 = pipeline_stages_base.CoordinateRequestAndResponseStage(**init_kwargs)
+        assert stage1.request_id_prefix != stage2.request_id_prefix
+
 
 pipeline_stage_test.add_base_pipeline_stage_tests(
     test_module=this_module,
@@ -1680,18 +2169,18 @@ class TestCoordinateRequestAndResponseStageRunOpWithRequestAndResponseOperation(
         )
 
     @pytest.mark.it(
-        "Stores the operation in the 'pending_responses' dictionary, mapped with a generated UUID"
+        "Stores the operation in the 'pending_responses' dictionary, mapped with a generated request id"
     )
-    def test_stores_op(self, mocker, stage, op, fake_uuid):
+    def test_stores_op(self, mocker, stage, op, fake_request_id):
         stage.run_op(op)
 
-        assert stage.pending_responses[fake_uuid] is op
+        assert stage.pending_responses[fake_request_id] is op
         assert not op.completed
 
     @pytest.mark.it(
-        "Creates and a new RequestOperation using the generated UUID and sends it down the pipeline"
+        "Creates and a new RequestOperation using the generated request id and sends it down the pipeline"
     )
-    def test_sends_down_new_request_op(self, mocker, stage, op, fake_uuid):
+    def test_sends_down_new_request_op(self, mocker, stage, op, fake_request_id):
         stage.run_op(op)
 
         assert stage.send_op_down.call_count == 1
@@ -1701,12 +2190,30 @@ class TestCoordinateRequestAndResponseStageRunOpWithRequestAndResponseOperation(
         assert request_op.resource_location == op.resource_location
         assert request_op.request_body == op.request_body
         assert request_op.request_type == op.request_type
-        assert request_op.request_id == fake_uuid
+        assert request_op.request_id == fake_request_id
 
     @pytest.mark.it(
-        "Generates a unique UUID for each RequestAndResponseOperation/RequestOperation pair"
+        "Gives the new RequestOperation the earlier of the operation's deadline and the deadline for the response"
+    )
+    @pytest.mark.parametrize(
+        "timeout, expected_timeout",
+        [
+            pytest.param(None, 60, id="No deadline"),
+            pytest.param(30, 30, id="Earlier deadline"),
+            pytest.param(90, 60, id="Later deadline"),
+        ],
     )
-    def test_unique_uuid(self, mocker, stage, op):
+    def test_request_op_deadline(self, mocker, stage, op, mock_time, timeout, expected_timeout):
+        op.deadline = None if timeout is None else 1000 + timeout
+        stage.run_op(op)
+
+        request_op = stage.send_op_down.call_args[0][0]
+        assert request_op.deadline == 1000 + expected_timeout
+
+    @pytest.mark.it(
+        "Generates a unique request id for each RequestAndResponseOperation/RequestOperation pair"
+    )
+    def test_unique_request_id(self, mocker, stage, op):
         op1 = op
         op2 = copy.deepcopy(op)
         op3 = copy.deepcopy(op)
@@ -1726,6 +2233,60 @@ class TestCoordinateRequestAndResponseStageRunOpWithRequestAndResponseOperation(
         assert stage.pending_responses[uuid2] is op2
         assert stage.pending_responses[uuid3] is op3
 
+    @pytest.mark.it(
+        "Generates request ids made of the stage's 'request_id_prefix' followed by a sequence number"
+    )
+    def test_request_id_format(self, mocker, stage, op):
+        stage.run_op(op)
+        stage.run_op(copy.deepcopy(op))
+
+        assert stage.send_op_down.call_args_list[0][0][0].request_id == (
+            stage.request_id_prefix + "0"
+        )
+        assert stage.send_op_down.call_args_list[1][0][0].request_id == (
+            stage.request_id_prefix + "1"
+        )
+
+    @pytest.mark.it(
+        "Schedules the deadline alarm for the 'response_timeout' if it is not already scheduled"
+    )
+    def test_schedules_deadline_alarm(self, mocker, stage, op, mock_alarm, mock_time):
+        stage.run_op(op)
+
+        assert mock_alarm.call_count == 1
+        assert mock_alarm.call_args[0][0] == 1000 + stage.response_timeout
+        assert stage.deadline_alarm is mock_alarm.return_value
+
+    @pytest.mark.it("Uses the timeout in 'response_timeouts' for the request type, if there is one")
+    def test_response_timeouts(self, mocker, stage, op, mock_alarm, mock_time):
+        stage.response_timeouts[op.request_type] = 10
+        stage.run_op(op)
+
+        assert mock_alarm.call_args[0][0] == 1000 + 10
+
+    @pytest.mark.it("Does not schedule another deadline alarm for a later deadline")
+    def test_shares_deadline_alarm(self, mocker, stage, op, mock_alarm, mock_time):
+        stage.run_op(op)
+        mock_time.return_value += 1
+        stage.run_op(copy.deepcopy(op))
+
+        assert mock_alarm.call_count == 1
+        assert stage.pending_response_count == 2
+
+    @pytest.mark.it(
+        "Reschedules the deadline alarm for an earlier deadline, e.g. a request type with a shorter timeout"
+    )
+    def test_earlier_deadline(self, mocker, stage, op, mock_alarm, mock_time):
+        stage.run_op(op)
+        short_op = copy.deepcopy(op)
+        short_op.request_type = "short_request_type"
+        stage.response_timeouts["short_request_type"] = 10
+        stage.run_op(short_op)
+
+        assert mock_alarm.call_count == 2
+        assert mock_alarm.return_value.cancel.call_count == 1
+        assert mock_alarm.call_args[0][0] == 1000 + 10
+
 
 @pytest.mark.describe(
     "CoordinateRequestAndResponseStage - .run_op() -- Called with an arbitrary other operation"
@@ -1783,6 +2344,24 @@ class TestCoordinateRequestAndResponseStageRequestOperationCompleted(
         with pytest.raises(KeyError):
             stage.pending_responses[request_op.request_id]
 
+    @pytest.mark.it(
+        "Completes the associated RequestAndResponseOperation with a PipelineTimeoutError if the RequestOperation is completed unsuccessfully after the deadline for the response"
+    )
+    def test_request_completed_after_deadline(
+        self, mocker, stage, op, arbitrary_exception, mock_alarm, mock_time
+    ):
+        stage.run_op(op)
+        request_op = stage.send_op_down.call_args[0][0]
+
+        # e.g. the request was held below while the pipeline was disconnected
+        mock_time.return_value += stage.response_timeout
+        request_op.complete(error=arbitrary_exception)
+
+        assert op.completed
+        assert isinstance(op.error, pipeline_exceptions.PipelineTimeoutError)
+        assert stage.pending_response_count == 0
+        assert stage.expired_response_count == 1
+
     @pytest.mark.it(
         "Does not complete or remove the RequestAndResponseOperation from the 'pending_responses' dict if the RequestOperation is completed successfully"
     )
@@ -1804,9 +2383,9 @@ class TestCoordinateRequestAndResponseStageHandlePipelineEventWithResponseEvent(
     CoordinateRequestAndResponseStageTestConfig, StageHandlePipelineEventTestBase
 ):
     @pytest.fixture
-    def event(self, fake_uuid):
+    def event(self, fake_request_id):
         return pipeline_events_base.ResponseEvent(
-            request_id=fake_uuid, status_code=200, response_body="response body"
+            request_id=fake_request_id, status_code=200, response_body="response body"
         )
 
     @pytest.fixture
@@ -1820,7 +2399,7 @@ class TestCoordinateRequestAndResponseStageHandlePipelineEventWithResponseEvent(
         )
 
     @pytest.fixture
-    def stage(self, mocker, cls_type, init_kwargs, fake_uuid, pending_op):
+    def stage(self, mocker, cls_type, init_kwargs, fake_request_id, pending_op):
         stage = cls_type(**init_kwargs)
         stage.pipeline_root = pipeline_stages_base.PipelineRootStage(
             pipeline_configuration=mocker.MagicMock()
@@ -1836,13 +2415,13 @@ class TestCoordinateRequestAndResponseStageHandlePipelineEventWithResponseEvent(
         "Successfully completes a pending RequestAndResponseOperation that matches the 'request_id' of the ResponseEvent, and removes it from the 'pending_responses' dictionary"
     )
     def test_completes_matching_request_and_response_operation(
-        self, mocker, stage, pending_op, event, fake_uuid
+        self, mocker, stage, pending_op, event, fake_request_id
     ):
-        assert stage.pending_responses[fake_uuid] is pending_op
+        assert stage.pending_responses[fake_request_id] is pending_op
         assert not pending_op.completed
 
         # Handle the ResponseEvent
-        assert event.request_id == fake_uuid
+        assert event.request_id == fake_request_id
         stage.handle_pipeline_event(event)
 
         # The pending RequestAndResponseOperation is complete
@@ -1850,7 +2429,7 @@ class TestCoordinateRequestAndResponseStageHandlePipelineEventWithResponseEvent(
 
         # The RequestAndResponseOperation has been removed from the dictionary
         with pytest.raises(KeyError):
-            stage.pending_responses[fake_uuid]
+            stage.pending_responses[fake_request_id]
 
     @pytest.mark.it(
         "Sets the 'status_code' and 'response_body' attributes on the completed RequestAndResponseOperation with values from the ResponseEvent"
@@ -1869,18 +2448,50 @@ class TestCoordinateRequestAndResponseStageHandlePipelineEventWithResponseEvent(
     @pytest.mark.it(
         "Does nothing if there is no pending RequestAndResponseOperation that matches the 'request_id' of the ResponseEvent"
     )
-    def test_no_matching_request_id(self, mocker, stage, pending_op, event, fake_uuid):
-        assert stage.pending_responses[fake_uuid] is pending_op
+    def test_no_matching_request_id(self, mocker, stage, pending_op, event, fake_request_id):
+        assert stage.pending_responses[fake_request_id] is pending_op
         assert not pending_op.completed
 
-        # Use a nonmatching UUID
-        event.request_id = "non-matching-uuid"
-        assert event.request_id != fake_uuid
+        # Use a nonmatching request id
+        event.request_id = "non-matching-request-id"
+        assert event.request_id != fake_request_id
         stage.handle_pipeline_event(event)
 
         # Nothing has changed
-        assert stage.pending_responses[fake_uuid] is pending_op
+        assert stage.pending_responses[fake_request_id] is pending_op
         assert not pending_op.completed
+        assert stage.late_response_count == 0
+
+    @pytest.mark.it(
+        "Increments the 'late_response_count' if the 'request_id' of the ResponseEvent was generated by the stage but is no longer pending"
+    )
+    def test_late_response(self, mocker, cls_type, init_kwargs):
+        stage = cls_type(**init_kwargs)
+        stage.pipeline_root = pipeline_stages_base.PipelineRootStage(
+            pipeline_configuration=mocker.MagicMock()
+        )
+        stage.send_event_up = mocker.MagicMock()
+        stage.send_op_down = mocker.MagicMock()
+        op = pipeline_ops_base.RequestAndResponseOperation(
+            request_type="some_request_type",
+            method="SOME_METHOD",
+            resource_location="some/resource/location",
+            request_body="some_request_body",
+            callback=mocker.MagicMock(),
+        )
+        stage.run_op(op)
+        request_id = stage.send_op_down.call_args[0][0].request_id
+        event = pipeline_events_base.ResponseEvent(
+            request_id=request_id, status_code=200, response_body="response body"
+        )
+
+        stage.handle_pipeline_event(event)
+        assert op.completed
+        assert stage.late_response_count == 0
+
+        # Same response again
+        stage.handle_pipeline_event(event)
+        assert stage.late_response_count == 1
 
 
 @pytest.mark.describe(
@@ -2142,6 +2753,162 @@ class TestCoordinateRequestAndResponseStageHandlePipelineEventWithArbitraryEvent
         assert stage.send_event_up.call_args == mocker.call(event)
 
 
+@pytest.mark.describe(
+    "CoordinateRequestAndResponseStage - .handle_pipeline_event() -- Called with DisconnectedEvent"
+)
+class TestCoordinateRequestAndResponseStageHandlePipelineEventWithDisconnectedEvent(
+    CoordinateRequestAndResponseStageTestConfig, StageHandlePipelineEventTestBase
+):
+    @pytest.fixture
+    def event(self):
+        return pipeline_events_base.DisconnectedEvent()
+
+    def make_new_request_response_op(self, mocker):
+        return pipeline_ops_base.RequestAndResponseOperation(
+            request_type="some_request_type",
+            method="SOME_METHOD",
+            resource_location="some/resource/location",
+            request_body="some_request_body",
+            callback=mocker.MagicMock(),
+        )
+
+    @pytest.mark.it("Sends the event up the pipeline")
+    def test_sends_up(self, mocker, stage, event):
+        stage.handle_pipeline_event(event)
+
+        assert stage.send_event_up.call_count == 1
+        assert stage.send_event_up.call_args == mocker.call(event)
+
+    @pytest.mark.it(
+        "Completes all pending RequestAndResponseOperations which are past their deadline with a PipelineTimeoutError"
+    )
+    def test_expires_requests(self, mocker, stage, event, mock_alarm, mock_time):
+        expired_ops = [self.make_new_request_response_op(mocker) for _ in range(2)]
+        for op in expired_ops:
+            stage.run_op(op)
+        mock_time.return_value += stage.response_timeout / 2
+        live_op = self.make_new_request_response_op(mocker)
+        stage.run_op(live_op)
+        mock_time.return_value += stage.response_timeout / 2
+
+        stage.handle_pipeline_event(event)
+
+        for op in expired_ops:
+            assert op.completed
+            assert isinstance(op.error, pipeline_exceptions.PipelineTimeoutError)
+        assert not live_op.completed
+        assert stage.pending_response_count == 1
+        assert stage.expired_response_count == 2
+
+    @pytest.mark.it(
+        "Cancels the deadline alarm if no RequestAndResponseOperations are left pending"
+    )
+    def test_cancels_alarm(self, mocker, stage, event, mock_alarm, mock_time):
+        stage.run_op(self.make_new_request_response_op(mocker))
+        mock_time.return_value += stage.response_timeout
+
+        stage.handle_pipeline_event(event)
+
+        assert stage.pending_response_count == 0
+        assert mock_alarm.return_value.cancel.call_count == 1
+        assert stage.deadline_alarm is None
+
+
+@pytest.mark.describe("CoordinateRequestAndResponseStage - OCCURANCE: Deadline alarm fires")
+class TestCoordinateRequestAndResponseStageOCCURANCEDeadlineAlarmFires(
+    CoordinateRequestAndResponseStageTestConfig
+):
+    def make_new_request_response_op(self, mocker):
+        return pipeline_ops_base.RequestAndResponseOperation(
+            request_type="some_request_type",
+            method="SOME_METHOD",
+            resource_location="some/resource/location",
+            request_body="some_request_body",
+            callback=mocker.MagicMock(),
+        )
+
+    @pytest.mark.it(
+        "Completes every pending RequestAndResponseOperation which is past its deadline with a PipelineTimeoutError"
+    )
+    def test_expires_requests(self, mocker, stage, mock_alarm, mock_time):
+        op1 = self.make_new_request_response_op(mocker)
+        op2 = self.make_new_request_response_op(mocker)
+        stage.run_op(op1)
+        stage.run_op(op2)
+        on_alarm = mock_alarm.call_args[0][1]
+
+        mock_time.return_value += stage.response_timeout
+        on_alarm()
+
+        for op in [op1, op2]:
+            assert op.completed
+            assert isinstance(op.error, pipeline_exceptions.PipelineTimeoutError)
+        assert stage.pending_responses == {}
+        assert stage.expired_response_count == 2
+        assert stage.deadline_alarm is None
+
+    @pytest.mark.it(
+        "Schedules the deadline alarm for the earliest remaining deadline if requests are still pending"
+    )
+    def test_reschedules_alarm(self, mocker, stage, mock_alarm, mock_time):
+        op1 = self.make_new_request_response_op(mocker)
+        op2 = self.make_new_request_response_op(mocker)
+        stage.run_op(op1)
+        mock_time.return_value += 10
+        stage.run_op(op2)
+        on_alarm = mock_alarm.call_args[0][1]
+
+        mock_time.return_value += stage.response_timeout - 10
+        on_alarm()
+
+        assert op1.completed
+        assert not op2.completed
+        assert mock_alarm.call_count == 2
+        assert mock_alarm.call_args[0][0] == 1010 + stage.response_timeout
+        assert stage.deadline_alarm is mock_alarm.return_value
+
+    @pytest.mark.it("Does not complete requests which received a response")
+    def test_answered_requests(self, mocker, stage, mock_alarm, mock_time):
+        op = self.make_new_request_response_op(mocker)
+        stage.run_op(op)
+        on_alarm = mock_alarm.call_args[0][1]
+        request_id = stage.send_op_down.call_args[0][0].request_id
+        stage.handle_pipeline_event(
+            pipeline_events_base.ResponseEvent(
+                request_id=request_id, status_code=200, response_body="response body"
+            )
+        )
+        assert op.completed
+        assert op.error is None
+
+        mock_time.return_value += stage.response_timeout
+        on_alarm()
+
+        assert op.error is None
+        assert stage.expired_response_count == 0
+
+    @pytest.mark.it(
+        "Does not re-send expired requests on a subsequent ConnectedEvent, and counts their responses as late"
+    )
+    def test_no_resend_after_expiry(self, mocker, stage, mock_alarm, mock_time):
+        op = self.make_new_request_response_op(mocker)
+        stage.run_op(op)
+        request_id = stage.send_op_down.call_args[0][0].request_id
+        on_alarm = mock_alarm.call_args[0][1]
+        mock_time.return_value += stage.response_timeout
+        on_alarm()
+
+        stage.handle_pipeline_event(pipeline_events_base.ConnectedEvent())
+        assert stage.send_op_down.call_count == 1
+
+        stage.handle_pipeline_event(
+            pipeline_events_base.ResponseEvent(
+                request_id=request_id, status_code=200, response_body="response body"
+            )
+        )
+        assert stage.late_response_count == 1
+
+
 ####################
 # OP TIMEOUT STAGE #
 ####################
@@ -2592,6 +3359,45 @@ class TestRetryStageRetryableOperationCompletedWithRetryableError(RetryStageTest
         assert stage.run_op.call_args == mocker.call(op3)
 
 
+@pytest.mark.describe(
+    "RetryStage - OCCURANCE: Retryable operation with a deadline completes unsuccessfully with a retryable error after call to .run_op()"
+)
+class TestRetryStageRetryableOperationWithDeadlineCompletedWithRetryableError(RetryStageTestConfig):
+    @pytest.fixture(params=retryable_ops, ids=[x[0].__name__ for x in retryable_ops])
+    def op(self, request, mocker):
+        op_cls = request.param[0]
+        init_kwargs = request.param[1]
+        return op_cls(**init_kwargs)
+
+    @pytest.fixture(params=retryable_exceptions)
+    def error(self, request):
+        return request.param()
+
+    @pytest.mark.it(
+        "Completes the operation with an OperationTimeout, without retrying it, if the deadline would pass before the retry"
+    )
+    def test_deadline_would_pass(self, mocker, stage, op, error, mock_timer):
+        op.deadline = time.time() + stage.retry_intervals[type(op)] - 1
+        stage.run_op(op)
+        op.complete(error=error)
+
+        assert op.completed
+        assert isinstance(op.error, pipeline_exceptions.OperationTimeout)
+        assert op.error.__cause__ is error
+        assert mock_timer.call_count == 0
+        assert op not in stage.ops_waiting_to_retry
+
+    @pytest.mark.it("Retries the operation if the deadline would not pass before the retry")
+    def test_deadline_would_not_pass(self, mocker, stage, op, error, mock_timer):
+        op.deadline = time.time() + stage.retry_intervals[type(op)] + 60
+        stage.run_op(op)
+        op.complete(error=error)
+
+        assert not op.completed
+        assert mock_timer.call_count == 1
+        assert op in stage.ops_waiting_to_retry
+
+
 @pytest.mark.describe(
     "RetryStage - OCCURANCE: Retryable operation completes unsucessfully with a non-retryable error after call to .run_op()"
 )
@@ -3709,6 +4515,39 @@ class TestReconnectStageConnectOperationForReconnectIsCompleted(ReconnectStageTe
             assert op.original_callback.call_count == 1
             assert op.original_callback.call_args == mocker.call(op=op, error=None)
 
+    @pytest.mark.it(
+        "Completes waiting ops of a higher priority class before those of a lower priority class, and ops of the same priority in the order they arrived, if the connect succeeds"
+    )
+    def test_completes_waiting_connect_ops_in_priority_order(
+        self, stage, connect_op, state, mocker, never_connected
+    ):
+        stage.state = state
+        stage.never_connected = never_connected
+        completed = []
+        priorities = [
+            pipeline_ops_base.PRIORITY_TELEMETRY,
+            pipeline_ops_base.PRIORITY_TWIN,
+            pipeline_ops_base.PRIORITY_TELEMETRY,
+            pipeline_ops_base.PRIORITY_METHOD_RESPONSE,
+            pipeline_ops_base.PRIORITY_TWIN,
+        ]
+        waiting_ops = []
+        for priority in priorities:
+            op = pipeline_ops_base.ConnectOperation(callback=lambda op, error: completed.append(op))
+            op.priority = priority
+            waiting_ops.append(op)
+        stage.waiting_connect_ops = list(waiting_ops)
+
+        connect_op.complete()
+
+        assert completed == [
+            waiting_ops[3],
+            waiting_ops[1],
+            waiting_ops[4],
+            waiting_ops[0],
+            waiting_ops[2],
+        ]
+
     @pytest.mark.it(
         "Changes the state to LOGICALLY_DISCONNECTED if the connection fails with an arbitrary (permanent) error"
     )
@@ -3839,3 +4678,108 @@ class TestReconnectStageConnectOperationForReconnectIsCompleted(ReconnectStageTe
         assert mock_timer.call_count == 1
         assert mock_timer.call_args[0][0] == 10
         assert mock_timer.return_value.start.call_count == 1
+
+
+class TransportStageForReconnectTest(pipeline_stages_base.PipelineStage):
+    """Bottom of a pipeline, which holds ConnectOperations until the test completes them, and
+    records every other op it is sent"""
+
+    def __init__(self):
+        super(TransportStageForReconnectTest, self).__init__()
+        self.connect_ops = []
+        self.sent_ops = []
+
+    def _run_op(self, op):
+        if isinstance(op, pipeline_ops_base.ConnectOperation):
+            self.connect_ops.append(op)
+        else:
+            self.sent_ops.append(op)
+
+
+@pytest.mark.describe(
+    "AutoConnectStage, ReconnectStage and ConnectionLockStage - OCCURANCE: Many operations are sent while reconnecting"
+)
+class TestOperationsSentWhileReconnecting(object):
+    @pytest.fixture
+    def transport(self):
+        return TransportStageForReconnectTest()
+
+    @pytest.fixture
+    def reconnect_stage(self):
+        return pipeline_stages_base.ReconnectStage()
+
+    @pytest.fixture
+    def pipeline(self, mocker, transport, reconnect_stage):
+        root = pipeline_stages_base.PipelineRootStage(
+            pipeline_configuration=mocker.MagicMock(auto_connect=True)
+        )
+        root.append_stage(pipeline_stages_base.AutoConnectStage())
+        root.append_stage(reconnect_stage)
+        root.append_stage(pipeline_stages_base.ConnectionLockStage())
+        root.append_stage(transport)
+        # The pipeline was connected, and then the connection dropped
+        root.connected = True
+        reconnect_stage.state = pipeline_stages_base.ReconnectState.LOGICALLY_CONNECTED
+        reconnect_stage.never_connected = False
+        return root
+
+    @pytest.fixture
+    def flood(self, mocker):
+        """Ops in the order the application sends them: a backlog of telemetry, with twin
+        operations and method responses sent in the middle of it"""
+        ops = []
+        for i in range(50):
+            if i % 10 == 3:
+                priority = pipeline_ops_base.PRIORITY_METHOD_RESPONSE
+            elif i % 10 == 7:
+                priority = pipeline_ops_base.PRIORITY_TWIN
+            else:
+                priority = pipeline_ops_base.PRIORITY_TELEMETRY
+            op = pipeline_ops_mqtt.MQTTPublishOperation(
+                topic="topic", payload=str(i), callback=mocker.MagicMock()
+            )
+            op.priority = priority
+            ops.append(op)
+        return ops
+
+    def expected_order(self, ops):
+        return sorted(ops, key=lambda op: op.priority)
+
+    @pytest.mark.it(
+        "Sends operations flooded in while waiting to reconnect in priority order once reconnected"
+    )
+    def test_waiting_to_reconnect(self, mock_timer, pipeline, transport, reconnect_stage, flood):
+        reconnect_stage.handle_pipeline_event(pipeline_events_base.DisconnectedEvent())
+        assert reconnect_stage.state == pipeline_stages_base.ReconnectState.WAITING_TO_RECONNECT
+
+        for op in flood:
+            pipeline.next.run_op(op)
+        assert transport.sent_ops == []
+        assert transport.connect_ops == []
+
+        # The reconnect timer fires, and the connection is established
+        timer_callback = mock_timer.call_args[0][1]
+        timer_callback()
+        assert len(transport.connect_ops) == 1
+        pipeline.connected = True
+        transport.connect_ops[0].complete()
+
+        assert transport.sent_ops == self.expected_order(flood)
+
+    @pytest.mark.it(
+        "Sends operations flooded in while a connection is being established in priority order once connected"
+    )
+    def test_connecting(self, pipeline, transport, reconnect_stage, flood):
+        pipeline.connected = False
+        reconnect_stage.state = pipeline_stages_base.ReconnectState.LOGICALLY_DISCONNECTED
+
+        for op in flood:
+            pipeline.next.run_op(op)
+        assert transport.sent_ops == []
+        # The first connect is sent to the transport, the others are held behind it
+        assert len(transport.connect_ops) == 1
+
+        pipeline.connected = True
+        transport.connect_ops[0].complete()
+
+        assert transport.sent_ops == self.expected_order(flood)
@@ -191,6 +191,9 @@ class TestMQTTTransportStageRunOpCalledWithInitializePipelineOperation(
             cipher=cipher,
             proxy_options=proxy_options,
             keep_alive=keep_alive,
+            network_loop=stage.pipeline_root.pipeline_configuration.network_loop,
+            adaptive_keep_alive=stage.pipeline_root.pipeline_configuration.adaptive_keep_alive,
+            ack_timeout=stage.pipeline_root.pipeline_configuration.ack_timeout,
         )
         assert stage.transport is mock_transport.return_value
 
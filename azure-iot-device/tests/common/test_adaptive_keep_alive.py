@@ -0,0 +1,114 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+import pytest
+import logging
+from azure.iot.device.common import adaptive_keep_alive
+from azure.iot.device.common.adaptive_keep_alive import AdaptiveKeepAlive
+
+logging.basicConfig(level=logging.DEBUG)
+
+
+def probe(keep_alive, nat_timeout, max_steps=50):
+    """Run the probing against a NAT which drops flows idle for nat_timeout seconds"""
+    for _ in range(max_steps):
+        if keep_alive.settled:
+            return keep_alive.interval
+        interval = keep_alive.interval
+        if interval < nat_timeout:
+            keep_alive.on_interval_succeeded(interval)
+        else:
+            keep_alive.on_interval_failed(interval)
+    raise AssertionError("Keep alive interval did not settle")
+
+
+@pytest.mark.describe("AdaptiveKeepAlive - Instantiation")
+class TestAdaptiveKeepAliveInstantiation(object):
+    @pytest.mark.it("Starts at MIN_INTERVAL, which is assumed to be safe")
+    def test_starts_at_min(self):
+        keep_alive = AdaptiveKeepAlive(max_interval=1200)
+        assert keep_alive.interval == adaptive_keep_alive.MIN_INTERVAL
+        assert keep_alive.safe_interval == adaptive_keep_alive.MIN_INTERVAL
+        assert keep_alive.unsafe_interval is None
+        assert not keep_alive.settled
+
+    @pytest.mark.it("Uses the maximum interval, settled, if it is less than MIN_INTERVAL")
+    def test_max_less_than_min(self):
+        keep_alive = AdaptiveKeepAlive(max_interval=10)
+        assert keep_alive.interval == 10
+        assert keep_alive.settled
+
+
+@pytest.mark.describe("AdaptiveKeepAlive - .on_interval_succeeded()")
+class TestAdaptiveKeepAliveOnIntervalSucceeded(object):
+    @pytest.mark.it("Doubles the interval while no interval has failed")
+    def test_doubles(self):
+        keep_alive = AdaptiveKeepAlive(max_interval=1200)
+        assert keep_alive.on_interval_succeeded(30) == 60
+        assert keep_alive.on_interval_succeeded(60) == 120
+        assert keep_alive.safe_interval == 60
+
+    @pytest.mark.it("Does not exceed the maximum interval, and settles once it has succeeded")
+    def test_max(self):
+        keep_alive = AdaptiveKeepAlive(max_interval=100)
+        assert keep_alive.on_interval_succeeded(30) == 60
+        assert keep_alive.on_interval_succeeded(60) == 100
+        assert not keep_alive.settled
+        assert keep_alive.on_interval_succeeded(100) == 100
+        assert keep_alive.settled
+
+    @pytest.mark.it("Uses the interval halfway to the shortest failed interval once one has failed")
+    def test_binary_search(self):
+        keep_alive = AdaptiveKeepAlive(max_interval=1200)
+        keep_alive.on_interval_succeeded(30)
+        keep_alive.on_interval_failed(60)
+        assert keep_alive.on_interval_succeeded(30) == 45
+
+
+@pytest.mark.describe("AdaptiveKeepAlive - .on_interval_failed()")
+class TestAdaptiveKeepAliveOnIntervalFailed(object):
+    @pytest.mark.it("Goes back to the longest interval that has succeeded")
+    def test_back_to_safe(self):
+        keep_alive = AdaptiveKeepAlive(max_interval=1200)
+        keep_alive.on_interval_succeeded(30)
+        keep_alive.on_interval_succeeded(60)
+        assert keep_alive.on_interval_failed(120) == 60
+        assert keep_alive.unsafe_interval == 120
+
+    @pytest.mark.it(
+        "Starts probing again from half the interval if an interval that had succeeded fails"
+    )
+    def test_network_changed(self):
+        keep_alive = AdaptiveKeepAlive(max_interval=1200)
+        assert probe(keep_alive, nat_timeout=300) > 280
+        settled_interval = keep_alive.interval
+
+        assert keep_alive.on_interval_failed(settled_interval) == settled_interval // 2
+        assert not keep_alive.settled
+        assert probe(keep_alive, nat_timeout=100) < 100
+
+    @pytest.mark.it("Does not go below MIN_INTERVAL")
+    def test_min(self):
+        keep_alive = AdaptiveKeepAlive(max_interval=1200)
+        assert keep_alive.on_interval_failed(30) == 30
+        assert keep_alive.unsafe_interval is None
+
+
+@pytest.mark.describe("AdaptiveKeepAlive - Probing")
+class TestAdaptiveKeepAliveProbing(object):
+    @pytest.mark.it(
+        "Settles on an interval within RESOLUTION of the NAT timeout, without exceeding it"
+    )
+    @pytest.mark.parametrize("nat_timeout", [45, 60, 100, 299, 600, 1000])
+    def test_settles(self, nat_timeout):
+        keep_alive = AdaptiveKeepAlive(max_interval=1200)
+        interval = probe(keep_alive, nat_timeout)
+        assert interval < nat_timeout
+        assert nat_timeout - interval <= adaptive_keep_alive.RESOLUTION + 1
+
+    @pytest.mark.it("Settles on the maximum interval if the NAT timeout is longer")
+    def test_settles_max(self):
+        keep_alive = AdaptiveKeepAlive(max_interval=1200)
+        assert probe(keep_alive, nat_timeout=3600) == 1200
@@ -5,78 +5,217 @@
 # --------------------------------------------------------------------------
 import pytest
 import logging
+import threading
 import time
 import six
-from azure.iot.device.common.alarm import Alarm
+from azure.iot.device.common import alarm, handle_exceptions
+from azure.iot.device.common.alarm import AlarmScheduler
 
 logging.basicConfig(level=logging.DEBUG)
 
 
-@pytest.mark.describe("Alarm")
-class TestAlarm(object):
+def wait_for(condition, timeout=5):
+    end = time.time() + timeout
+    while not condition():
+        if time.time() > end:
+            return False
+        time.sleep(0.01)
+    return True
+
+
+@pytest.mark.describe("AlarmScheduler")
+class TestAlarmScheduler(object):
+    @pytest.fixture
+    def scheduler(self):
+        scheduler = AlarmScheduler()
+        yield scheduler
+        scheduler.stop()
+
     @pytest.fixture
-    def desired_function(self, mocker):
-        return mocker.MagicMock()
+    def mock_time(self, mocker):
+        mock_time = mocker.patch.object(alarm, "time")
+        mock_time.time.return_value = 1000
+        return mock_time
 
     @pytest.mark.it(
-        "Invokes the given function with the given args and kwargs at the given alarm time once started"
-    )
-    @pytest.mark.parametrize(
-        "args", [pytest.param(["arg1", "arg2"], id="W/ args"), pytest.param([], id="No args")]
-    )
-    @pytest.mark.parametrize(
-        "kwargs",
-        [
-            pytest.param({"kwarg1": "value1", "kwarg2": "value2"}, id="W/ kwargs"),
-            pytest.param({}, id="No kwargs"),
-        ],
+        "Invokes the given function with the given args and kwargs at the given alarm time"
     )
-    def test_fn_called_w_args(self, mocker, desired_function, args, kwargs):
-        alarm_time = time.time() + 2  # call fn in 2 seconds
-        a = Alarm(alarm_time=alarm_time, function=desired_function, args=args, kwargs=kwargs)
-        a.start()
+    def test_fn_called_w_args(self, mocker, scheduler):
+        called = threading.Event()
+        desired_function = mocker.MagicMock(side_effect=lambda *args, **kwargs: called.set())
+        start = time.time()
+        scheduler.schedule(
+            start + 0.5, desired_function, args=["arg1"], kwargs={"kwarg1": "value1"}
+        )
 
         assert desired_function.call_count == 0
-        time.sleep(1)  # hasn't been 2 seconds yet
-        assert desired_function.call_count == 0
-        time.sleep(1.1)  # it has now been just over 2 seconds, so the call HAS been made
-        assert desired_function.call_count == 1
-        assert desired_function.call_args == mocker.call(*args, **kwargs)
+        assert called.wait(5)
+        assert time.time() >= start + 0.5
+        assert desired_function.call_args == mocker.call("arg1", kwarg1="value1")
 
-    @pytest.mark.it("Invokes the function with no args or kwargs by default if none are provided")
-    def test_fn_called_no_args(self, mocker, desired_function):
-        alarm_time = time.time() + 1  # call fn in 1 seconds
-        a = Alarm(alarm_time=alarm_time, function=desired_function)
-        a.start()
+    @pytest.mark.it("Invokes the functions of all alarms on a single thread, in alarm time order")
+    def test_single_thread(self, scheduler):
+        threads_before = threading.active_count()
+        calls = []
+        now = time.time()
+        for i in reversed(range(10)):
+            scheduler.schedule(
+                now + 0.05 * i, lambda i=i: calls.append((i, threading.current_thread()))
+            )
 
-        assert desired_function.call_count == 0
-        time.sleep(1.1)  # it has now been just over 1 second, so the call HAS been made
-        assert desired_function.call_count == 1
-        desired_function.call_args == mocker.call()
+        assert threading.active_count() == threads_before + 1
+        assert wait_for(lambda: len(calls) == 10)
+        assert [i for (i, _) in calls] == list(range(10))
+        assert len(set(thread for (_, thread) in calls)) == 1
 
     @pytest.mark.it("Invokes the function immediately if the given alarm time is in the past")
-    def test_alarm_already_expired(self, mocker, desired_function):
-        alarm_time = time.time() - 1
-        a = Alarm(alarm_time=alarm_time, function=desired_function)
-        a.start()
+    def test_alarm_already_expired(self, mocker, scheduler):
+        called = threading.Event()
+        scheduler.schedule(time.time() - 1, called.set)
+        assert called.wait(1)
+
+    @pytest.mark.it("Invokes an earlier alarm scheduled while waiting for a later one on time")
+    def test_earlier_alarm(self, scheduler):
+        later = threading.Event()
+        earlier = threading.Event()
+        scheduler.schedule(time.time() + 60, later.set)
+        time.sleep(0.1)
+        scheduler.schedule(time.time() + 0.1, earlier.set)
+
+        assert earlier.wait(1)
+        assert not later.is_set()
+
+    @pytest.mark.it("Does not invoke the function if the alarm was cancelled before the alarm time")
+    def test_cancel_alarm(self, mocker, mock_time, scheduler):
+        desired_function = mocker.MagicMock()
+        other = threading.Event()
+        scheduled_alarm = scheduler.schedule(1000 + 1, desired_function)
+        scheduler.schedule(1000 + 2, other.set)
+        assert scheduler.pending_count == 2
 
-        if six.PY2:
-            # A slight timing issue in Python 2 only
-            time.sleep(0.1)
+        scheduled_alarm.cancel()
+        assert scheduler.pending_count == 1
 
-        assert desired_function.call_count == 1
+        # Both alarm times pass. The cancelled alarm is due first, so it has been skipped by the
+        # time the other one fires
+        mock_time.time.return_value = 1000 + 2
+
+        assert other.wait(5)
+        assert desired_function.call_count == 0
+        assert scheduler.pending_count == 0
+
+    @pytest.mark.it("Drops its references to the function and its arguments once cancelled")
+    def test_cancel_drops_references(self, mocker, scheduler):
+        scheduled_alarm = scheduler.schedule(
+            time.time() + 60, mocker.MagicMock(), args=[mocker.MagicMock()], kwargs={"k": "v"}
+        )
+        scheduled_alarm.cancel()
+
+        assert scheduled_alarm.function is None
+        assert scheduled_alarm.args is None
+        assert scheduled_alarm.kwargs is None
+
+    @pytest.mark.it("Does not keep many cancelled alarms until their alarm time")
+    def test_cancel_many(self, mocker, scheduler):
+        scheduled_alarms = [
+            scheduler.schedule(time.time() + 60, mocker.MagicMock()) for _ in range(10)
+        ]
+        for scheduled_alarm in scheduled_alarms[:6]:
+            scheduled_alarm.cancel()
+
+        assert scheduler.pending_count == 4
+        assert len(scheduler._heap) < 10
+
+    @pytest.mark.it("Sleeps until the earliest alarm time, if it is sooner than MAX_SLEEP_INTERVAL")
+    def test_sleeps_until_alarm_time(self, mocker, scheduler):
+        spy_wait = mocker.spy(scheduler._cv, "wait")
+        scheduler.schedule(time.time() + 0.5, mocker.MagicMock())
+        time.sleep(0.3)
+
+        assert spy_wait.call_count == 1
+        assert 0.4 < spy_wait.call_args[0][0] <= 0.5
 
     @pytest.mark.it(
-        "Does not invoke the given function at the given alarm time if the alarm was cancelled before the given alarm time"
+        "Sleeps for at most MAX_SLEEP_INTERVAL at a time, checking the time again in between"
     )
-    def test_cancel_alarm(self, mocker, desired_function):
-        alarm_time = time.time() + 2  # call fn in 2 seconds
-        a = Alarm(alarm_time=alarm_time, function=desired_function)
-        a.start()
+    def test_sleep_capped(self, mocker, scheduler):
+        spy_wait = mocker.spy(scheduler._cv, "wait")
+        scheduler.schedule(time.time() + 60, mocker.MagicMock())
+
+        assert wait_for(lambda: spy_wait.call_count >= 2)
+        for call in spy_wait.call_args_list:
+            assert call[0][0] <= alarm.MAX_SLEEP_INTERVAL
+
+    @pytest.mark.it(
+        "Invokes a function promptly if the system time jumps past its alarm time (e.g. after the system is resumed)"
+    )
+    def test_time_jump(self, mocker, mock_time, scheduler):
+        called = threading.Event()
+        scheduler.schedule(1000 + 3600, called.set)
+        time.sleep(0.1)
+        assert not called.is_set()
+
+        mock_time.time.return_value = 1000 + 3600
+
+        assert called.wait(alarm.MAX_SLEEP_INTERVAL + 1)
+
+    @pytest.mark.it(
+        "Wakes up when the alarm it is waiting for is cancelled, and waits for the next one"
+    )
+    def test_cancel_next_alarm(self, mocker, scheduler):
+        spy_wait = mocker.spy(scheduler._cv, "wait")
+        scheduled_alarm = scheduler.schedule(time.time() + 0.8, mocker.MagicMock())
+        scheduler.schedule(time.time() + 60, mocker.MagicMock())
+        assert wait_for(lambda: spy_wait.called and 0.7 < spy_wait.call_args[0][0] <= 0.8)
+
+        scheduled_alarm.cancel()
+
+        # Woken before the cancelled alarm was due, to wait for the next one instead
+        assert wait_for(
+            lambda: spy_wait.call_args[0][0] == alarm.MAX_SLEEP_INTERVAL, timeout=0.5
+        )
+        assert len(scheduler._heap) == 1
+
+    @pytest.mark.it(
+        "Sends an exception raised by a function to the background exception handler, and continues to invoke other functions"
+    )
+    def test_function_raises(self, mocker, scheduler, arbitrary_exception):
+        spy_handle = mocker.spy(handle_exceptions, "handle_background_exception")
+        called = threading.Event()
+        scheduler.schedule(time.time(), mocker.MagicMock(side_effect=arbitrary_exception))
+        scheduler.schedule(time.time() + 0.1, called.set)
+
+        assert called.wait(5)
+        assert spy_handle.call_args == mocker.call(arbitrary_exception)
+
+    @pytest.mark.it("Does not invoke pending functions once stopped")
+    def test_stop(self, mocker, mock_time, scheduler):
+        desired_function = mocker.MagicMock()
+        scheduler.schedule(1000 + 1, desired_function)
+
+        scheduler.stop()
+        mock_time.time.return_value = 1000 + 1
 
         assert desired_function.call_count == 0
-        time.sleep(1)  # hasn't been 2 seconds yet
-        assert desired_function.call_count == 0
-        a.cancel()  # cancel the alarm
-        time.sleep(1.5)  # it has now been more than 2 seconds
-        assert desired_function.call_count == 0  # still not called
+        assert not scheduler._thread.is_alive()
+
+    @pytest.mark.it("Raises a RuntimeError if an alarm is scheduled once stopped")
+    def test_schedule_after_stop(self, mocker, scheduler):
+        scheduler.stop()
+        with pytest.raises(RuntimeError):
+            scheduler.schedule(time.time(), mocker.MagicMock())
+
+
+@pytest.mark.describe("schedule()")
+class TestSchedule(object):
+    @pytest.mark.it("Schedules the alarm on a scheduler shared by the whole process")
+    def test_shared_scheduler(self, mocker):
+        first = threading.Event()
+        second = threading.Event()
+        alarm1 = alarm.schedule(time.time(), first.set)
+        alarm2 = alarm.schedule(time.time(), second.set)
+
+        assert first.wait(5)
+        assert second.wait(5)
+        assert isinstance(alarm1, alarm.ScheduledAlarm)
+        assert alarm1._scheduler is alarm2._scheduler
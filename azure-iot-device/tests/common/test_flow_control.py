@@ -0,0 +1,171 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+import pytest
+import logging
+import threading
+import time
+from azure.iot.device.common import handle_exceptions
+from azure.iot.device.common.flow_control import FlowControl
+
+logging.basicConfig(level=logging.DEBUG)
+
+
+@pytest.mark.describe("FlowControl - Instantiation")
+class TestFlowControlInstantiation(object):
+    @pytest.mark.it("Starts with no pending ops or bytes, and with capacity")
+    def test_initial(self):
+        flow_control = FlowControl(high_watermark=100, low_watermark=50)
+        assert flow_control.pending_ops == 0
+        assert flow_control.pending_bytes == 0
+        assert flow_control.has_capacity
+
+    @pytest.mark.it("Uses half of the high watermark as the low watermark, if none is provided")
+    def test_default_low_watermark(self):
+        flow_control = FlowControl(high_watermark=100)
+        assert flow_control.low_watermark == 50
+
+
+@pytest.mark.describe("FlowControl - .add() and .remove()")
+class TestFlowControlAddRemove(object):
+    @pytest.mark.it("Tracks the number of pending ops and bytes")
+    def test_pending(self):
+        flow_control = FlowControl()
+        flow_control.add(10)
+        flow_control.add(20)
+        flow_control.add()
+        assert flow_control.pending_ops == 3
+        assert flow_control.pending_bytes == 30
+        flow_control.remove(20)
+        assert flow_control.pending_ops == 2
+        assert flow_control.pending_bytes == 10
+
+    @pytest.mark.it("Always has capacity if there is no high watermark")
+    def test_no_high_watermark(self):
+        flow_control = FlowControl()
+        flow_control.add(10**9)
+        assert flow_control.has_capacity
+
+    @pytest.mark.it(
+        "Has no capacity from when the pending bytes go above the high watermark until they drop to the low watermark"
+    )
+    def test_hysteresis(self):
+        flow_control = FlowControl(high_watermark=100, low_watermark=50)
+        flow_control.add(100)
+        assert flow_control.has_capacity
+        flow_control.add(30)
+        assert not flow_control.has_capacity
+        flow_control.remove(30)
+        assert not flow_control.has_capacity
+        flow_control.add(10)
+        flow_control.remove(60)
+        assert flow_control.pending_bytes == 50
+        assert flow_control.has_capacity
+        flow_control.add(50)
+        assert flow_control.has_capacity
+
+
+@pytest.mark.describe("FlowControl - .wait_for_capacity()")
+class TestFlowControlWaitForCapacity(object):
+    @pytest.mark.it("Returns True immediately if there is capacity")
+    def test_capacity(self):
+        flow_control = FlowControl(high_watermark=100)
+        assert flow_control.wait_for_capacity() is True
+        assert flow_control.wait_for_capacity(timeout=0) is True
+
+    @pytest.mark.it("Blocks until there is capacity, then returns True")
+    @pytest.mark.parametrize("timeout", [None, 5], ids=["No timeout", "Timeout"])
+    def test_blocks(self, timeout):
+        flow_control = FlowControl(high_watermark=100)
+        flow_control.add(200)
+        timer = threading.Timer(0.05, flow_control.remove, args=[200])
+        timer.start()
+        assert flow_control.wait_for_capacity(timeout=timeout) is True
+        assert flow_control.pending_bytes == 0
+        timer.join()
+
+    @pytest.mark.it("Returns False if the timeout expires before there is capacity")
+    def test_timeout(self):
+        flow_control = FlowControl(high_watermark=100)
+        flow_control.add(200)
+        start = time.time()
+        assert flow_control.wait_for_capacity(timeout=0.05) is False
+        assert time.time() - start >= 0.05
+
+
+@pytest.mark.describe("FlowControl - .on_capacity()")
+class TestFlowControlOnCapacity(object):
+    @pytest.mark.it("Calls the callback immediately if there is capacity")
+    def test_capacity(self, mocker):
+        flow_control = FlowControl(high_watermark=100)
+        callback = mocker.MagicMock()
+        flow_control.on_capacity(callback)
+        assert callback.call_count == 1
+
+    @pytest.mark.it("Calls the callback once, when there is capacity again")
+    def test_no_capacity(self, mocker):
+        flow_control = FlowControl(high_watermark=100, low_watermark=50)
+        callback = mocker.MagicMock()
+        flow_control.add(60)
+        flow_control.add(60)
+        flow_control.on_capacity(callback)
+        flow_control.remove(60)
+        assert callback.call_count == 0
+        flow_control.remove(60)
+        assert callback.call_count == 1
+
+        # Not called again the next time capacity is regained
+        flow_control.add(200)
+        flow_control.remove(200)
+        assert callback.call_count == 1
+
+    @pytest.mark.it(
+        "Calls the remaining callbacks, and sends the exception to the background exception handler, if a callback raises"
+    )
+    def test_callback_raises(self, mocker, arbitrary_exception):
+        spy_handle = mocker.spy(handle_exceptions, "handle_background_exception")
+        flow_control = FlowControl(high_watermark=100)
+        failing_callback = mocker.MagicMock(side_effect=arbitrary_exception)
+        callback = mocker.MagicMock()
+        flow_control.add(200)
+        flow_control.on_capacity(failing_callback)
+        flow_control.on_capacity(callback)
+
+        # Does not raise
+        flow_control.remove(200)
+
+        assert failing_callback.call_count == 1
+        assert callback.call_count == 1
+        assert spy_handle.call_args == mocker.call(arbitrary_exception)
+        assert flow_control.pending_bytes == 0
+
+
+@pytest.mark.describe("FlowControl - .remove_capacity_callback()")
+class TestFlowControlRemoveCapacityCallback(object):
+    @pytest.mark.it("Removes a callback so that it is not called when there is capacity again")
+    def test_removes(self, mocker):
+        flow_control = FlowControl(high_watermark=100)
+        callback = mocker.MagicMock()
+        other_callback = mocker.MagicMock()
+        flow_control.add(200)
+        flow_control.on_capacity(callback)
+        flow_control.on_capacity(other_callback)
+
+        flow_control.remove_capacity_callback(callback)
+        flow_control.remove(200)
+
+        assert callback.call_count == 0
+        assert other_callback.call_count == 1
+
+    @pytest.mark.it("Does nothing if the callback has already been called, or was never added")
+    def test_not_pending(self, mocker):
+        flow_control = FlowControl(high_watermark=100)
+        callback = mocker.MagicMock()
+        flow_control.on_capacity(callback)
+
+        flow_control.remove_capacity_callback(callback)
+        flow_control.remove_capacity_callback(mocker.MagicMock())
+
+        assert callback.call_count == 1
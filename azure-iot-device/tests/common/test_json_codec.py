@@ -0,0 +1,160 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+import pytest
+import logging
+import json
+from azure.iot.device.common import json_codec
+
+logging.basicConfig(level=logging.DEBUG)
+
+fake_object = {"b": [1, 2.5, None, True], "a": {"nested": "été"}}
+
+
+class FakeRegistrationPayload(object):
+    def __init__(self):
+        self.registrationId = "MyPensieve"
+        self.payload = None
+
+
+@pytest.fixture(autouse=True)
+def reset_codec():
+    yield
+    json_codec.set_codec(None)
+
+
+class SharedCodecTests(object):
+    @pytest.mark.it("Encodes an object as UTF-8 encoded JSON bytes")
+    def test_encode(self, codec):
+        data = codec.encode(fake_object)
+        assert isinstance(data, bytes)
+        assert json.loads(data.decode("utf-8")) == fake_object
+
+    @pytest.mark.it("Sorts the keys of dictionaries if sort_keys is True")
+    def test_sort_keys(self, codec):
+        data = codec.encode({"b": 1, "a": 2}, sort_keys=True)
+        assert data.decode("utf-8").replace(" ", "") == '{"a":2,"b":1}'
+
+    @pytest.mark.it("Uses the default function for objects which can not otherwise be encoded")
+    def test_default(self, codec):
+        data = codec.encode(FakeRegistrationPayload(), default=lambda o: o.__dict__)
+        assert json.loads(data.decode("utf-8")) == {"registrationId": "MyPensieve", "payload": None}
+
+    @pytest.mark.it("Raises a TypeError if an object can not be encoded")
+    def test_encode_error(self, codec):
+        with pytest.raises(TypeError):
+            codec.encode(FakeRegistrationPayload())
+
+    @pytest.mark.it("Decodes UTF-8 encoded JSON from bytes, bytearray or str")
+    @pytest.mark.parametrize(
+        "convert",
+        [
+            pytest.param(lambda s: s.encode("utf-8"), id="bytes"),
+            pytest.param(lambda s: bytearray(s.encode("utf-8")), id="bytearray"),
+            pytest.param(lambda s: s, id="str"),
+        ],
+    )
+    def test_decode(self, codec, convert):
+        assert codec.decode(convert(json.dumps(fake_object))) == fake_object
+
+    @pytest.mark.it("Raises a ValueError if the data is not valid JSON")
+    def test_decode_error(self, codec):
+        with pytest.raises(ValueError):
+            codec.decode(b'{"a": ')
+
+
+@pytest.mark.describe("StandardJsonCodec")
+class TestStandardJsonCodec(SharedCodecTests):
+    @pytest.fixture
+    def codec(self):
+        return json_codec.StandardJsonCodec()
+
+    @pytest.mark.it("Encodes with the same output as json.dumps()")
+    def test_same_as_json(self, codec):
+        assert codec.encode(fake_object) == json.dumps(fake_object).encode("utf-8")
+
+
+@pytest.mark.describe("OrjsonCodec")
+@pytest.mark.skipif(json_codec.orjson is None, reason="orjson is not installed")
+class TestOrjsonCodec(SharedCodecTests):
+    @pytest.fixture
+    def codec(self):
+        return json_codec.OrjsonCodec()
+
+    @pytest.mark.it("Falls back to the json module for values orjson does not support")
+    def test_fallback(self, codec):
+        # orjson only supports 64 bit integers
+        big_int = 2 << 70
+        assert json.loads(codec.encode({"big": big_int}).decode("utf-8")) == {"big": big_int}
+        # orjson does not decode NaN
+        value = codec.decode(b'{"value": NaN}')["value"]
+        assert value != value
+
+    @pytest.mark.it(
+        "Encodes NaN and infinity with the json module, rather than as null like orjson does"
+    )
+    @pytest.mark.parametrize(
+        "value",
+        [
+            pytest.param(float("nan"), id="NaN"),
+            pytest.param(float("inf"), id="Infinity"),
+            pytest.param(float("-inf"), id="-Infinity"),
+        ],
+    )
+    @pytest.mark.parametrize(
+        "make_obj",
+        [
+            pytest.param(lambda value: {"t": value}, id="Property"),
+            pytest.param(lambda value: {"a": None, "b": {"c": [1, value]}}, id="Nested"),
+        ],
+    )
+    def test_non_finite_float(self, codec, value, make_obj):
+        obj = make_obj(value)
+        assert codec.encode(obj) == json.dumps(obj).encode("utf-8")
+
+    @pytest.mark.it("Encodes NaN returned by the default function with the json module")
+    def test_non_finite_float_default(self, codec):
+        payload = FakeRegistrationPayload()
+        payload.payload = float("nan")
+        data = codec.encode(payload, default=lambda o: o.__dict__)
+        assert b"NaN" in data
+
+    @pytest.mark.it("Encodes null, and finite floats, with orjson")
+    def test_null(self, mocker, codec):
+        spy_fallback = mocker.spy(codec._fallback, "encode")
+        data = codec.encode({"a": None, "b": 2.5})
+        assert json.loads(data.decode("utf-8")) == {"a": None, "b": 2.5}
+        assert spy_fallback.call_count == 0
+
+
+@pytest.mark.describe("JSON codec module")
+class TestJsonCodecModule(object):
+    @pytest.mark.it(
+        "Uses the OrjsonCodec by default if orjson is installed, else StandardJsonCodec"
+    )
+    def test_default_codec(self):
+        codec = json_codec.get_codec()
+        if json_codec.orjson is None:
+            assert isinstance(codec, json_codec.StandardJsonCodec)
+        else:
+            assert isinstance(codec, json_codec.OrjsonCodec)
+
+    @pytest.mark.it("Encodes and decodes with the codec set with set_codec()")
+    def test_set_codec(self, mocker):
+        codec = mocker.MagicMock()
+        json_codec.set_codec(codec)
+
+        assert json_codec.get_codec() is codec
+        assert json_codec.encode(fake_object, sort_keys=True) is codec.encode.return_value
+        assert codec.encode.call_args == mocker.call(fake_object, default=None, sort_keys=True)
+        assert json_codec.decode(b"{}") is codec.decode.return_value
+        assert codec.decode.call_args == mocker.call(b"{}")
+
+    @pytest.mark.it("Goes back to the default codec if set_codec() is given None")
+    def test_reset_codec(self, mocker):
+        default_codec_type = type(json_codec.get_codec())
+        json_codec.set_codec(mocker.MagicMock())
+        json_codec.set_codec(None)
+        assert type(json_codec.get_codec()) is default_codec_type
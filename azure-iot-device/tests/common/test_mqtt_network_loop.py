@@ -0,0 +1,101 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+import pytest
+import logging
+import sys
+import threading
+import paho.mqtt.client as mqtt
+from azure.iot.device.common import mqtt_network_loop
+from azure.iot.device.common.mqtt_network_loop import MQTTNetworkLoop
+
+logging.basicConfig(level=logging.DEBUG)
+
+pytestmark = pytest.mark.skipif(
+    sys.version_info < (3, 0), reason="MQTTNetworkLoop requires Python 3"
+)
+
+
+@pytest.fixture
+def network_loop():
+    network_loop = MQTTNetworkLoop()
+    yield network_loop
+    network_loop.stop()
+
+
+def connect_client(broker, network_loop, client_id, keepalive=60):
+    client = mqtt.Client(client_id=client_id, protocol=mqtt.MQTTv311)
+    connected = threading.Event()
+    client.on_connect = lambda *args: connected.set()
+    client.connect("127.0.0.1", broker.port, keepalive=keepalive)
+    network_loop.add_client(client)
+    assert connected.wait(5)
+    return client
+
+
+@pytest.mark.describe("MQTTNetworkLoop")
+class TestMQTTNetworkLoop(object):
+    @pytest.mark.it("Starts a single daemon thread")
+    def test_thread(self, network_loop):
+        assert network_loop._thread.is_alive()
+        assert network_loop._thread.daemon
+
+    @pytest.mark.it("Drives the connections of many Paho clients from its thread")
+    def test_many_clients(self, broker, network_loop):
+        threads_before = threading.active_count()
+        clients = [connect_client(broker, network_loop, "client{}".format(i)) for i in range(20)]
+        # No loop threads were started for the clients
+        assert threading.active_count() - threads_before <= len(clients) + 1  # broker threads
+        assert network_loop.client_count == 20
+
+        published = threading.Semaphore(0)
+        for client in clients:
+            client.on_publish = lambda *args: published.release()
+        for i, client in enumerate(clients):
+            client.publish("topic/{}".format(i), b"payload", qos=1)
+        for _ in clients:
+            assert published.acquire(timeout=5)
+        assert sorted(broker.publishes) == sorted("topic/{}".format(i) for i in range(20))
+
+    @pytest.mark.it("Calls loop_misc() on its clients, so keep alive pings are sent")
+    def test_keep_alive(self, mocker, broker):
+        mocker.patch.object(mqtt_network_loop, "MISC_INTERVAL", 0.1)
+        network_loop = MQTTNetworkLoop()
+        try:
+            connect_client(broker, network_loop, "client", keepalive=1)
+            for _ in range(50):
+                if broker.pings:
+                    break
+                threading.Event().wait(0.1)
+            assert broker.pings
+        finally:
+            network_loop.stop()
+
+    @pytest.mark.it("Stops driving a client once it is removed")
+    def test_remove_client(self, broker, network_loop):
+        client = connect_client(broker, network_loop, "client")
+        network_loop.remove_client(client)
+        assert network_loop.client_count == 0
+        assert not network_loop._selector.get_map() or all(
+            key.data is None for key in network_loop._selector.get_map().values()
+        )
+
+    @pytest.mark.it("Forgets a client once the client has disconnected")
+    def test_disconnect(self, broker, network_loop):
+        client = connect_client(broker, network_loop, "client")
+        disconnected = threading.Event()
+        client.on_disconnect = lambda *args: disconnected.set()
+        client.disconnect()
+        assert disconnected.wait(5)
+        for _ in range(50):
+            if network_loop.client_count == 0:
+                break
+            threading.Event().wait(0.1)
+        assert network_loop.client_count == 0
+
+    @pytest.mark.it("Does nothing when removing a client that was never added")
+    def test_remove_unknown_client(self, mocker, network_loop):
+        network_loop.remove_client(mocker.MagicMock())
+        assert network_loop.client_count == 0
@@ -6,16 +6,20 @@
 
 import azure.iot.device.common.mqtt_transport as mqtt_transport
 from azure.iot.device.common.mqtt_transport import MQTTTransport, OperationManager
+from azure.iot.device.common.http_transport import HTTPTransport
 from azure.iot.device.common.models.x509 import X509
 from azure.iot.device.common import transport_exceptions as errors
+from azure.iot.device.common import trace_buffer, alarm
 import paho.mqtt.client as mqtt
 import ssl
 import copy
 import pytest
 import logging
 import socket
+import sys
 import socks
 import threading
+import time
 import gc
 import weakref
 import azure.iot.device.common.pipeline.config as pipeline_config
@@ -296,6 +300,31 @@ class TestInstantiation(object):
             fake_client_cert.pass_phrase,
         )
 
+    @pytest.mark.it(
+        "Shares the TLS/SSL context with other MQTT and HTTP transports that have the same TLS settings"
+    )
+    def test_shares_tls_context(self, mocker, mock_mqtt_client):
+        mocker.patch.object(ssl, "SSLContext", side_effect=lambda **kwargs: mocker.MagicMock())
+
+        # NOTE: The transports are kept alive in this list, as a context is only shared while
+        # it is in use
+        transports = [
+            MQTTTransport(client_id=fake_device_id, hostname=fake_hostname, username=fake_username),
+            MQTTTransport(
+                client_id=fake_device_id,
+                hostname=fake_hostname,
+                username=fake_username,
+                cipher=fake_cipher,
+            ),
+            MQTTTransport(client_id="other", hostname=fake_hostname, username="other"),
+            HTTPTransport(hostname=fake_hostname),
+        ]
+
+        contexts = [call[1]["context"] for call in mock_mqtt_client.tls_set_context.call_args_list]
+        assert contexts[0] is not contexts[1]
+        assert contexts[0] is contexts[2]
+        assert contexts[0] is transports[3]._ssl_context
+
     @pytest.mark.it("Sets Paho MQTT Client callbacks")
     def test_sets_paho_callbacks(self, mocker):
         mock_mqtt_client = mocker.patch.object(mqtt, "Client").return_value
@@ -433,6 +462,26 @@ class TestConnect(object):
         assert mock_mqtt_client.loop_start.call_count == 1
         assert mock_mqtt_client.loop_start.call_args == mocker.call()
 
+    @pytest.mark.it(
+        "Adds the Paho client to the network loop instead of starting a Paho loop thread, if a network loop was provided"
+    )
+    def test_adds_client_to_network_loop(self, mocker, mock_mqtt_client):
+        network_loop = mocker.MagicMock()
+        transport = MQTTTransport(
+            client_id=fake_device_id,
+            hostname=fake_hostname,
+            username=fake_username,
+            network_loop=network_loop,
+        )
+        transport.connect(fake_password)
+
+        assert mock_mqtt_client.loop_start.call_count == 0
+        assert network_loop.add_client.call_count == 1
+        assert network_loop.add_client.call_args == mocker.call(mock_mqtt_client)
+        # Any previous connection was removed from the network loop before connecting
+        assert network_loop.remove_client.call_count == 1
+        assert network_loop.remove_client.call_args == mocker.call(mock_mqtt_client)
+
     @pytest.mark.it("Raises a ProtocolClientError if Paho connect raises an unexpected Exception")
     def test_client_raises_unexpected_error(
         self, mocker, mock_mqtt_client, transport, arbitrary_exception
@@ -865,6 +914,23 @@ class TestDisconnect(object):
         assert mock_mqtt_client.loop_stop.call_count == 1
         assert mock_mqtt_client.loop_stop.call_args == mocker.call()
 
+    @pytest.mark.it(
+        "Removes the Paho client from the network loop instead of stopping the Paho loop thread, if a network loop was provided"
+    )
+    def test_removes_client_from_network_loop(self, mocker, mock_mqtt_client):
+        network_loop = mocker.MagicMock()
+        transport = MQTTTransport(
+            client_id=fake_device_id,
+            hostname=fake_hostname,
+            username=fake_username,
+            network_loop=network_loop,
+        )
+        transport.disconnect()
+
+        assert mock_mqtt_client.loop_stop.call_count == 0
+        assert network_loop.remove_client.call_count == 1
+        assert network_loop.remove_client.call_args == mocker.call(mock_mqtt_client)
+
     @pytest.mark.it(
         "Sets Paho's _thread to None if disconnect does not raise an exception while running in the Paho thread"
     )
@@ -1028,6 +1094,18 @@ class TestEventDisconnectCompleted(object):
         mock_mqtt_client.on_disconnect(client=mock_mqtt_client, userdata=None, rc=fake_failed_rc)
         assert mock_mqtt_client.loop_stop.call_count == 1
 
+    @pytest.mark.it("Dumps the trace buffer to the log if cause is not None")
+    def test_dumps_trace_with_cause(self, mocker, mock_mqtt_client, transport):
+        mock_dump = mocker.patch.object(trace_buffer, "dump")
+        mock_mqtt_client.on_disconnect(client=mock_mqtt_client, userdata=None, rc=fake_failed_rc)
+        assert mock_dump.call_count == 1
+
+    @pytest.mark.it("Does not dump the trace buffer if cause is None")
+    def test_does_not_dump_trace_without_cause(self, mocker, mock_mqtt_client, transport):
+        mock_dump = mocker.patch.object(trace_buffer, "dump")
+        mock_mqtt_client.on_disconnect(client=mock_mqtt_client, userdata=None, rc=fake_success_rc)
+        assert mock_dump.call_count == 0
+
     @pytest.mark.it("Does not calls Paho's loop_stop() if cause is None")
     def test_does_not_call_loop_stop(self, mock_mqtt_client, transport):
         mock_mqtt_client.on_disconnect(client=mock_mqtt_client, userdata=None, rc=fake_success_rc)
@@ -1714,6 +1792,22 @@ class TestPublish(object):
             topic=fake_topic, payload=fake_payload, qos=qos
         )
 
+    @pytest.mark.it("Records the publish and its PUBACK in the trace buffer, if tracing is enabled")
+    def test_records_trace(self, mock_mqtt_client, transport, message_info):
+        mock_mqtt_client.publish.return_value = message_info
+        trace_buffer.enable()
+        try:
+            transport.publish(topic=fake_topic, payload=fake_payload)
+            mock_mqtt_client.on_publish(client=mock_mqtt_client, userdata=None, mid=fake_mid)
+            records = trace_buffer.get_records()
+        finally:
+            trace_buffer.disable()
+
+        assert [(r[1], r[2]) for r in records] == [
+            (trace_buffer.PUBLISH, fake_mid),
+            (trace_buffer.PUBACK, fake_mid),
+        ]
+
     @pytest.mark.it("Raises ValueError on invalid QoS")
     @pytest.mark.parametrize("qos", [pytest.param(-1, id="QoS < 0"), pytest.param(3, id="Qos > 2")])
     def test_raises_value_error_invalid_qos(self, qos):
@@ -2122,6 +2216,448 @@ class TestMisc(object):
         assert callback3.call_count == 1
 
 
+@pytest.fixture
+def mock_schedule(mocker):
+    return mocker.patch.object(alarm, "schedule")
+
+
+def fire_scheduled_alarm(mock_schedule, index=-1):
+    """Call the function of an alarm scheduled with the mocked alarm.schedule"""
+    mock_schedule.call_args_list[index][0][1]()
+
+
+@pytest.mark.describe("MQTTTransport - Adaptive keep alive")
+class TestAdaptiveKeepAlive(object):
+    @pytest.fixture
+    def transport(self, mock_mqtt_client):
+        return MQTTTransport(
+            client_id=fake_device_id,
+            hostname=fake_hostname,
+            username=fake_username,
+            keep_alive=1200,
+            adaptive_keep_alive=True,
+        )
+
+    @pytest.fixture
+    def mock_time(self, mocker):
+        mock_time = mocker.patch.object(time, "time")
+        mock_time.return_value = 1000
+        return mock_time
+
+    def connect(self, transport, mock_mqtt_client):
+        transport.connect(fake_password)
+        mock_mqtt_client.on_connect(client=mock_mqtt_client, userdata=None, flags=None, rc=fake_rc)
+
+    def reconnect(self, transport, mock_mqtt_client):
+        transport.disconnect()
+        mock_mqtt_client.on_disconnect(client=mock_mqtt_client, userdata=None, rc=fake_success_rc)
+        self.connect(transport, mock_mqtt_client)
+
+    @pytest.mark.it("Does not adapt the keep alive interval if not enabled")
+    def test_not_enabled(self, mocker, mock_mqtt_client, mock_schedule):
+        transport = MQTTTransport(
+            client_id=fake_device_id,
+            hostname=fake_hostname,
+            username=fake_username,
+            keep_alive=fake_keepalive,
+        )
+        self.connect(transport, mock_mqtt_client)
+
+        assert transport._adaptive_keep_alive is None
+        assert mock_mqtt_client.connect.call_args[1]["keepalive"] == fake_keepalive
+        assert mock_schedule.call_count == 0
+
+    @pytest.mark.it("Connects with the adaptive interval, which is shorter than the keep_alive")
+    def test_interval_on_connect(self, mock_mqtt_client, transport, mock_schedule):
+        self.connect(transport, mock_mqtt_client)
+
+        keep_alive = mock_mqtt_client.connect.call_args[1]["keepalive"]
+        assert keep_alive == transport._adaptive_keep_alive.interval
+        assert keep_alive < 1200
+
+    @pytest.mark.it("Does not change Paho's keep alive on a live connection")
+    def test_no_private_keepalive(self, mock_mqtt_client, transport, mock_time):
+        mock_mqtt_client._keepalive = "untouched"
+        self.connect(transport, mock_mqtt_client)
+        self.idle_ping(transport, mock_mqtt_client, mock_time)
+
+        assert mock_mqtt_client._keepalive == "untouched"
+
+    def log(self, mock_mqtt_client, buf):
+        mock_mqtt_client.on_log(
+            client=mock_mqtt_client, userdata=None, level=mqtt.MQTT_LOG_DEBUG, buf=buf
+        )
+
+    def idle_ping(self, transport, mock_mqtt_client, mock_time, respond=True):
+        """Go idle for the connection's interval, then ping (and get a response)"""
+        mock_time.return_value += mock_mqtt_client.connect.call_args[1]["keepalive"]
+        self.log(mock_mqtt_client, "Sending PINGREQ")
+        if respond:
+            mock_time.return_value += 1
+            self.log(mock_mqtt_client, "Received PINGRESP")
+
+    @pytest.mark.it(
+        "Connects with a longer interval next time, once a ping sent after the connection was idle for the interval is answered"
+    )
+    def test_idle_ping_succeeds(self, mock_mqtt_client, transport, mock_time):
+        self.connect(transport, mock_mqtt_client)
+        interval = transport._adaptive_keep_alive.interval
+
+        self.idle_ping(transport, mock_mqtt_client, mock_time)
+
+        assert transport._adaptive_keep_alive.safe_interval == interval
+        # The connection keeps its interval
+        self.reconnect(transport, mock_mqtt_client)
+        assert mock_mqtt_client.connect.call_args[1]["keepalive"] > interval
+
+    @pytest.mark.it(
+        "Does not lengthen the interval for a ping that was not preceded by an idle interval"
+    )
+    @pytest.mark.parametrize(
+        "traffic",
+        [
+            pytest.param("Sending PUBLISH (d0, q1, r0, m1), 'topic', ... (5 bytes)", id="Sent"),
+            pytest.param(
+                "Received PUBLISH (d0, q1, r0, m1), 'topic', ...  (5 bytes)", id="Received"
+            ),
+        ],
+    )
+    def test_busy_ping(self, mock_mqtt_client, transport, mock_time, traffic):
+        # e.g. Paho pings when nothing has been received for an interval, even while sending
+        self.connect(transport, mock_mqtt_client)
+        interval = transport._adaptive_keep_alive.interval
+        mock_time.return_value += interval - 10
+        self.log(mock_mqtt_client, traffic)
+        mock_time.return_value += 10
+        self.log(mock_mqtt_client, "Sending PINGREQ")
+        self.log(mock_mqtt_client, "Received PINGRESP")
+
+        assert transport._adaptive_keep_alive.interval == interval
+
+    @pytest.mark.it("Does not lengthen the interval for a connection that only stays up")
+    def test_no_ping(self, mock_mqtt_client, transport, mock_time):
+        self.connect(transport, mock_mqtt_client)
+        interval = transport._adaptive_keep_alive.interval
+        mock_time.return_value += 10 * interval
+        self.log(mock_mqtt_client, "Received PINGRESP")
+
+        self.reconnect(transport, mock_mqtt_client)
+        assert mock_mqtt_client.connect.call_args[1]["keepalive"] == interval
+
+    @pytest.mark.it(
+        "Shortens the interval if the connection drops while waiting for the response to a ping sent after an idle interval"
+    )
+    def test_idle_ping_fails(self, mock_mqtt_client, transport, mock_time):
+        self.connect(transport, mock_mqtt_client)
+        self.idle_ping(transport, mock_mqtt_client, mock_time)
+        self.reconnect(transport, mock_mqtt_client)
+        interval = mock_mqtt_client.connect.call_args[1]["keepalive"]
+
+        self.idle_ping(transport, mock_mqtt_client, mock_time, respond=False)
+        mock_time.return_value += interval
+        mock_mqtt_client.on_disconnect(client=mock_mqtt_client, userdata=None, rc=fake_failed_rc)
+
+        assert transport._adaptive_keep_alive.unsafe_interval == interval
+        assert transport._adaptive_keep_alive.interval < interval
+        self.connect(transport, mock_mqtt_client)
+        assert mock_mqtt_client.connect.call_args[1]["keepalive"] < interval
+
+    @pytest.mark.it(
+        "Does not shorten the interval if the connection drops without an idle ping outstanding, however long it was up"
+    )
+    @pytest.mark.parametrize(
+        "answered", [pytest.param(True, id="Ping answered"), pytest.param(False, id="No ping")]
+    )
+    def test_connection_dropped(self, mock_mqtt_client, transport, mock_time, answered):
+        self.connect(transport, mock_mqtt_client)
+        self.idle_ping(transport, mock_mqtt_client, mock_time)
+        self.reconnect(transport, mock_mqtt_client)
+        interval = transport._adaptive_keep_alive.interval
+
+        if answered:
+            self.idle_ping(transport, mock_mqtt_client, mock_time)
+        mock_time.return_value += 10 * interval
+        self.log(mock_mqtt_client, "Sending PUBLISH (d0, q1, r0, m1), 'topic', ... (5 bytes)")
+        mock_mqtt_client.on_disconnect(client=mock_mqtt_client, userdata=None, rc=fake_failed_rc)
+
+        assert transport._adaptive_keep_alive.unsafe_interval is None
+        assert transport._adaptive_keep_alive.interval >= interval
+
+    @pytest.mark.it("Does not shorten the interval after a requested disconnect")
+    def test_disconnect(self, mock_mqtt_client, transport, mock_time):
+        self.connect(transport, mock_mqtt_client)
+        self.idle_ping(transport, mock_mqtt_client, mock_time, respond=False)
+
+        transport.disconnect()
+        mock_mqtt_client.on_disconnect(client=mock_mqtt_client, userdata=None, rc=fake_success_rc)
+
+        assert transport._adaptive_keep_alive.unsafe_interval is None
+
+
+@pytest.mark.describe("MQTTTransport - Paho log")
+@pytest.mark.skipif(sys.version_info < (3, 0), reason="The fake broker requires Python 3")
+class TestPahoLog(object):
+    """The adaptive keep alive relies on the lines Paho logs for the packets it sends and receives,
+    so this checks them against the real Paho client"""
+
+    @pytest.fixture
+    def client(self, broker):
+        client = mqtt.Client(client_id=fake_device_id, protocol=mqtt.MQTTv311)
+        client.logs = []
+        client.on_log = lambda client, userdata, level, buf: client.logs.append(buf)
+        yield client
+        client.disconnect()
+        client.loop_stop()
+
+    def wait_for_log(self, client, prefix):
+        for _ in range(50):
+            if any(buf.startswith(prefix) for buf in client.logs):
+                return True
+            threading.Event().wait(0.1)
+        return False
+
+    @pytest.mark.it("Logs a ping being sent, and its response being received")
+    def test_ping(self, broker, client):
+        client.connect("127.0.0.1", broker.port, keepalive=1)
+        client.loop_start()
+
+        assert self.wait_for_log(client, mqtt_transport.PAHO_LOG_PING_SENT)
+        assert self.wait_for_log(client, mqtt_transport.PAHO_LOG_PING_RESPONSE)
+
+    @pytest.mark.it("Logs other packets being sent and received, distinctly from pings")
+    def test_traffic(self, broker, client):
+        client.connect("127.0.0.1", broker.port, keepalive=60)
+        client.loop_start()
+        client.publish(topic=fake_topic, payload=fake_payload, qos=1)
+
+        assert self.wait_for_log(client, mqtt_transport.PAHO_LOG_SENT + "PUBLISH")
+        assert self.wait_for_log(client, mqtt_transport.PAHO_LOG_RECEIVED + "PUBACK")
+        assert not any(
+            buf.startswith(mqtt_transport.PAHO_LOG_PING_SENT)
+            or buf.startswith(mqtt_transport.PAHO_LOG_PING_RESPONSE)
+            for buf in client.logs
+        )
+
+
+@pytest.mark.describe("MQTTTransport - Dead connection detection")
+class TestDeadConnectionDetection(object):
+    @pytest.fixture
+    def transport(self, mock_mqtt_client):
+        return MQTTTransport(
+            client_id=fake_device_id,
+            hostname=fake_hostname,
+            username=fake_username,
+            keep_alive=60,
+            ack_timeout=30,
+        )
+
+    @pytest.fixture
+    def mock_time(self, mocker):
+        mock_time = mocker.patch.object(time, "time")
+        mock_time.return_value = 1000
+        return mock_time
+
+    @pytest.fixture
+    def connected_transport(self, mock_mqtt_client, transport, mock_time):
+        transport.connect(fake_password)
+        mock_mqtt_client.on_connect(client=mock_mqtt_client, userdata=None, flags=None, rc=fake_rc)
+        return transport
+
+    @pytest.fixture(params=["Publish", "Subscribe", "Unsubscribe"])
+    def start_op(self, request, connected_transport):
+        if request.param == "Publish":
+            return lambda: connected_transport.publish(topic=fake_topic, payload=fake_payload)
+        elif request.param == "Subscribe":
+            return lambda: connected_transport.subscribe(topic=fake_topic)
+        else:
+            return lambda: connected_transport.unsubscribe(topic=fake_topic)
+
+    @pytest.mark.it(
+        "Schedules a check for the ack_timeout after an operation is sent, if there is none scheduled"
+    )
+    def test_schedules_check(self, mocker, mock_schedule, mock_time, start_op):
+        start_op()
+        mock_time.return_value += 5
+        start_op()
+
+        assert mock_schedule.call_count == 1
+        assert mock_schedule.call_args[0][0] == 1000 + 30
+
+    @pytest.mark.it("Does not schedule a check if there is no ack_timeout, even with a keep alive")
+    def test_no_ack_timeout(self, mock_mqtt_client, mock_schedule):
+        transport = MQTTTransport(
+            client_id=fake_device_id, hostname=fake_hostname, username=fake_username, keep_alive=60
+        )
+        transport.connect(fake_password)
+        mock_mqtt_client.on_connect(client=mock_mqtt_client, userdata=None, flags=None, rc=fake_rc)
+        transport.publish(topic=fake_topic, payload=fake_payload)
+
+        assert mock_schedule.call_count == 0
+
+    @pytest.fixture
+    def mock_fromfd(self, mocker):
+        return mocker.patch.object(socket, "fromfd")
+
+    def disconnect(self, mock_mqtt_client, rc=fake_failed_rc):
+        mock_mqtt_client.on_disconnect(client=mock_mqtt_client, userdata=None, rc=rc)
+
+    @pytest.mark.it(
+        "Shuts down the socket, if nothing is acknowledged for the ack_timeout while an operation is pending"
+    )
+    def test_dead(
+        self, mocker, mock_mqtt_client, mock_schedule, mock_time, mock_fromfd, start_op
+    ):
+        mock_mqtt_client.socket.return_value.fileno.return_value = 42
+        start_op()
+
+        mock_time.return_value += 30
+        fire_scheduled_alarm(mock_schedule)
+
+        assert mock_fromfd.call_count == 1
+        assert mock_fromfd.call_args[0] == (42, socket.AF_INET, socket.SOCK_STREAM)
+        assert mock_fromfd.return_value.shutdown.call_args == mocker.call(socket.SHUT_RDWR)
+        assert mock_fromfd.return_value.close.call_count == 1
+
+    @pytest.mark.it(
+        "Does not disconnect or stop the loop on the alarm thread, as that waits for the Paho thread"
+    )
+    def test_dead_no_disconnect(
+        self, mocker, mock_mqtt_client, connected_transport, mock_schedule, mock_time, mock_fromfd
+    ):
+        disconnected_handler = mocker.MagicMock()
+        connected_transport.on_mqtt_disconnected_handler = disconnected_handler
+        connected_transport.publish(topic=fake_topic, payload=fake_payload)
+
+        mock_time.return_value += 30
+        fire_scheduled_alarm(mock_schedule)
+
+        assert mock_mqtt_client.disconnect.call_count == 0
+        assert mock_mqtt_client.loop_stop.call_count == 0
+        assert disconnected_handler.call_count == 0
+
+    @pytest.mark.it(
+        "Reports the disconnect that Paho sees for the dead connection as a ConnectionDroppedError, and cleans it up"
+    )
+    def test_dead_paho_disconnect(
+        self, mocker, mock_mqtt_client, connected_transport, mock_schedule, mock_time, mock_fromfd
+    ):
+        disconnected_handler = mocker.MagicMock()
+        connected_transport.on_mqtt_disconnected_handler = disconnected_handler
+        connected_transport.publish(topic=fake_topic, payload=fake_payload)
+        mock_time.return_value += 30
+        fire_scheduled_alarm(mock_schedule)
+
+        self.disconnect(mock_mqtt_client)
+
+        assert mock_mqtt_client.disconnect.call_count == 1
+        assert mock_mqtt_client.loop_stop.call_count == 1
+        assert disconnected_handler.call_count == 1
+        cause = disconnected_handler.call_args[0][0]
+        assert isinstance(cause, errors.ConnectionDroppedError)
+        assert cause.args == ("Operations were not acknowledged",)
+
+    @pytest.mark.it("Reports later disconnects by their own cause, after the next connect")
+    def test_dead_reconnect(
+        self, mocker, mock_mqtt_client, connected_transport, mock_schedule, mock_time, mock_fromfd
+    ):
+        disconnected_handler = mocker.MagicMock()
+        connected_transport.on_mqtt_disconnected_handler = disconnected_handler
+        connected_transport.publish(topic=fake_topic, payload=fake_payload)
+        mock_time.return_value += 30
+        fire_scheduled_alarm(mock_schedule)
+        self.disconnect(mock_mqtt_client)
+
+        connected_transport.connect(fake_password)
+        mock_mqtt_client.on_connect(client=mock_mqtt_client, userdata=None, flags=None, rc=fake_rc)
+        self.disconnect(mock_mqtt_client)
+
+        assert disconnected_handler.call_count == 2
+        cause = disconnected_handler.call_args[0][0]
+        assert cause.args != ("Operations were not acknowledged",)
+
+    @pytest.mark.it("Does not shut down a socket if Paho no longer has one")
+    def test_dead_no_socket(
+        self, mock_mqtt_client, connected_transport, mock_schedule, mock_time, mock_fromfd
+    ):
+        mock_mqtt_client.socket.return_value = None
+        connected_transport.publish(topic=fake_topic, payload=fake_payload)
+
+        mock_time.return_value += 30
+        fire_scheduled_alarm(mock_schedule)
+
+        assert mock_fromfd.call_count == 0
+
+    @pytest.mark.it("Does not raise if the socket cannot be shut down")
+    def test_dead_shutdown_fails(
+        self, mock_mqtt_client, connected_transport, mock_schedule, mock_time, mock_fromfd
+    ):
+        mock_fromfd.return_value.shutdown.side_effect = OSError("Not connected")
+        connected_transport.publish(topic=fake_topic, payload=fake_payload)
+
+        mock_time.return_value += 30
+        fire_scheduled_alarm(mock_schedule)
+
+        assert mock_fromfd.return_value.close.call_count == 1
+
+    @pytest.mark.it(
+        "Does not drop the connection while acknowledgements keep arriving, however long the oldest operation has been pending"
+    )
+    def test_acknowledged(
+        self, mocker, mock_mqtt_client, connected_transport, mock_schedule, mock_time
+    ):
+        # e.g. a backlog queued by Paho beyond its in-flight limit, and acknowledged in turn
+        disconnected_handler = mocker.MagicMock()
+        connected_transport.on_mqtt_disconnected_handler = disconnected_handler
+        mock_mqtt_client.publish.side_effect = [(fake_rc, mid) for mid in range(1, 5)]
+        for _ in range(4):
+            connected_transport.publish(topic=fake_topic, payload=fake_payload)
+
+        for mid in range(1, 4):
+            mock_time.return_value += 20
+            mock_mqtt_client.on_publish(client=mock_mqtt_client, userdata=None, mid=mid)
+            mock_time.return_value += 10
+            fire_scheduled_alarm(mock_schedule)
+
+        assert disconnected_handler.call_count == 0
+        assert mock_mqtt_client.disconnect.call_count == 0
+        assert mock_schedule.call_count == 4
+        assert mock_schedule.call_args[0][0] == mock_time.return_value - 10 + 30
+
+    @pytest.mark.it("Does not schedule another check once all operations are acknowledged")
+    def test_all_acknowledged(
+        self, mocker, mock_mqtt_client, connected_transport, mock_schedule, mock_time
+    ):
+        connected_transport.publish(topic=fake_topic, payload=fake_payload)
+        mock_mqtt_client.on_publish(client=mock_mqtt_client, userdata=None, mid=fake_mid)
+
+        mock_time.return_value += 30
+        fire_scheduled_alarm(mock_schedule)
+
+        assert mock_schedule.call_count == 1
+        assert mock_mqtt_client.disconnect.call_count == 0
+
+    @pytest.mark.it(
+        "Times operations sent before a reconnect from the reconnect, as they are sent again"
+    )
+    def test_reconnect(self, mock_mqtt_client, connected_transport, mock_schedule, mock_time):
+        connected_transport.publish(topic=fake_topic, payload=fake_payload)
+        mock_mqtt_client.on_disconnect(client=mock_mqtt_client, userdata=None, rc=fake_failed_rc)
+        assert mock_schedule.return_value.cancel.call_count == 1
+
+        mock_time.return_value += 100
+        connected_transport.connect(fake_password)
+        mock_mqtt_client.on_connect(client=mock_mqtt_client, userdata=None, flags=None, rc=fake_rc)
+
+        assert mock_schedule.call_count == 2
+        assert mock_schedule.call_args[0][0] == 1100 + 30
+
+    @pytest.mark.it("Cancels any scheduled check when shut down")
+    def test_shutdown(self, mock_mqtt_client, connected_transport, mock_schedule):
+        connected_transport.publish(topic=fake_topic, payload=fake_payload)
+        connected_transport.shutdown()
+        assert mock_schedule.return_value.cancel.call_count == 1
+
+
 @pytest.mark.describe("OperationManager")
 class TestOperationManager(object):
     @pytest.mark.it("Instantiates with no operation tracking information")
@@ -2479,3 +3015,46 @@ class TestOperationManagerCancelAllOperations(object):
         # Callbacks WERE NOT called while the lock was held
         assert mocker.call.cb1() not in calls_during_lock
         assert mocker.call.cb2() not in calls_during_lock
+
+
+@pytest.mark.describe("OperationManager - .get_waiting_since()")
+class TestOperationManagerGetWaitingSince(object):
+    @pytest.mark.it("Returns None if there are no pending operations")
+    def test_no_pending_ops(self):
+        manager = OperationManager()
+        assert manager.get_waiting_since() is None
+
+    @pytest.mark.it(
+        "Returns the time of the last acknowledgement, or of the first operation established since there were none pending"
+    )
+    def test_waiting_since(self, mocker):
+        mock_time = mocker.patch.object(time, "time", return_value=1000)
+        manager = OperationManager()
+        manager.establish_operation(mid=1)
+        mock_time.return_value = 1010
+        manager.establish_operation(mid=2)
+        mock_time.return_value = 1020
+        manager.establish_operation(mid=3)
+        assert manager.get_waiting_since() == 1000
+
+        mock_time.return_value = 1030
+        manager.complete_operation(mid=1)
+        assert manager.get_waiting_since() == 1030
+        mock_time.return_value = 1040
+        manager.complete_operation(mid=3)
+        assert manager.get_waiting_since() == 1040
+        manager.complete_operation(mid=2)
+        assert manager.get_waiting_since() is None
+
+        mock_time.return_value = 1100
+        manager.establish_operation(mid=4)
+        assert manager.get_waiting_since() == 1100
+        manager.cancel_all_operations()
+        assert manager.get_waiting_since() is None
+
+    @pytest.mark.it("Does not track an operation which was completed before it was established")
+    def test_completed_early(self):
+        manager = OperationManager()
+        manager.complete_operation(mid=1)
+        manager.establish_operation(mid=1)
+        assert manager.get_waiting_since() is None
@@ -0,0 +1,136 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+import pytest
+import logging
+import gc
+import os
+import ssl
+from azure.iot.device.common import ssl_context_cache
+from azure.iot.device.common.models.x509 import X509
+
+logging.basicConfig(level=logging.DEBUG)
+
+fake_server_verification_cert = "__fake_server_verification_cert__"
+fake_cipher = "DHE-RSA-AES128-SHA"
+
+
+@pytest.fixture
+def mock_ssl_context_constructor(mocker):
+    # Every construction returns a new mock context, like the real constructor
+    return mocker.patch.object(ssl, "SSLContext", side_effect=lambda **kwargs: mocker.MagicMock())
+
+
+@pytest.fixture
+def x509(tmpdir):
+    cert_file = tmpdir.join("cert.pem")
+    cert_file.write("cert")
+    key_file = tmpdir.join("key.pem")
+    key_file.write("key")
+    return X509(str(cert_file), str(key_file), "pass_phrase")
+
+
+@pytest.mark.describe("ssl_context_cache - .get_ssl_context()")
+class TestGetSSLContext(object):
+    @pytest.mark.it("Creates a new SSLContext configured with the given settings")
+    def test_creates_context(self, mocker, mock_ssl_context_constructor, x509):
+        ssl_context = ssl_context_cache.get_ssl_context(
+            server_verification_cert=fake_server_verification_cert,
+            cipher=fake_cipher,
+            x509_cert=x509,
+        )
+
+        assert mock_ssl_context_constructor.call_count == 1
+        assert mock_ssl_context_constructor.call_args == mocker.call(protocol=ssl.PROTOCOL_TLSv1_2)
+        assert ssl_context.load_verify_locations.call_args == mocker.call(
+            cadata=fake_server_verification_cert
+        )
+        assert ssl_context.set_ciphers.call_args == mocker.call(fake_cipher)
+        assert ssl_context.load_cert_chain.call_args == mocker.call(
+            x509.certificate_file, x509.key_file, x509.pass_phrase
+        )
+        assert ssl_context.verify_mode == ssl.CERT_REQUIRED
+        assert ssl_context.check_hostname is True
+
+    @pytest.mark.it("Returns the same SSLContext for the same settings while it is in use")
+    @pytest.mark.parametrize("use_x509", [False, True], ids=["No X509", "X509"])
+    def test_same_settings(self, mock_ssl_context_constructor, x509, use_x509):
+        x509_cert = x509 if use_x509 else None
+        ssl_context1 = ssl_context_cache.get_ssl_context(cipher=fake_cipher, x509_cert=x509_cert)
+        # Equal, but not the same, X509 object
+        if use_x509:
+            x509_cert = X509(x509.certificate_file, x509.key_file, x509.pass_phrase)
+        ssl_context2 = ssl_context_cache.get_ssl_context(cipher=fake_cipher, x509_cert=x509_cert)
+
+        assert ssl_context1 is ssl_context2
+        assert mock_ssl_context_constructor.call_count == 1
+
+    @pytest.mark.it("Returns a different SSLContext for different settings")
+    @pytest.mark.parametrize(
+        "setting",
+        [
+            pytest.param("server_verification_cert", id="Server verification cert"),
+            pytest.param("cipher", id="Cipher"),
+            pytest.param("x509_pass_phrase", id="X509 pass phrase"),
+        ],
+    )
+    def test_different_settings(self, mock_ssl_context_constructor, x509, setting):
+        kwargs = {
+            "server_verification_cert": fake_server_verification_cert,
+            "cipher": fake_cipher,
+            "x509_cert": x509,
+        }
+        ssl_context1 = ssl_context_cache.get_ssl_context(**kwargs)
+        if setting == "x509_pass_phrase":
+            kwargs["x509_cert"] = X509(x509.certificate_file, x509.key_file, "other")
+        else:
+            kwargs[setting] = "other"
+        ssl_context2 = ssl_context_cache.get_ssl_context(**kwargs)
+
+        assert ssl_context1 is not ssl_context2
+        assert mock_ssl_context_constructor.call_count == 2
+
+    @pytest.mark.it("Returns a new SSLContext if the X509 certificate file has changed on disk")
+    def test_x509_file_changed(self, mock_ssl_context_constructor, x509):
+        ssl_context1 = ssl_context_cache.get_ssl_context(x509_cert=x509)
+        stat = os.stat(x509.certificate_file)
+        os.utime(x509.certificate_file, (stat.st_atime, stat.st_mtime + 10))
+        ssl_context2 = ssl_context_cache.get_ssl_context(x509_cert=x509)
+
+        assert ssl_context1 is not ssl_context2
+        assert mock_ssl_context_constructor.call_count == 2
+
+    @pytest.mark.it("Returns a new SSLContext once the previous one is no longer in use")
+    def test_not_in_use(self, mock_ssl_context_constructor):
+        ssl_context = ssl_context_cache.get_ssl_context()
+        del ssl_context
+        gc.collect()
+        ssl_context_cache.get_ssl_context()
+
+        assert mock_ssl_context_constructor.call_count == 2
+
+    @pytest.mark.it("Does not cache an SSLContext if configuring it fails")
+    def test_error(self, mocker, mock_ssl_context_constructor):
+        mock_ssl_context = mocker.MagicMock()
+        mock_ssl_context.set_ciphers.side_effect = ssl.SSLError("bad cipher")
+        mock_ssl_context_constructor.side_effect = lambda **kwargs: mock_ssl_context
+
+        with pytest.raises(ssl.SSLError):
+            ssl_context_cache.get_ssl_context(cipher="bad")
+        with pytest.raises(ssl.SSLError):
+            ssl_context_cache.get_ssl_context(cipher="bad")
+        assert mock_ssl_context_constructor.call_count == 2
+
+
+@pytest.mark.describe("ssl_context_cache - .clear()")
+class TestClear(object):
+    @pytest.mark.it("Causes a new SSLContext to be created for settings that were cached")
+    def test_clear(self, mock_ssl_context_constructor):
+        ssl_context1 = ssl_context_cache.get_ssl_context()
+        ssl_context_cache.clear()
+        ssl_context2 = ssl_context_cache.get_ssl_context()
+
+        assert ssl_context1 is not ssl_context2
+        assert mock_ssl_context_constructor.call_count == 2
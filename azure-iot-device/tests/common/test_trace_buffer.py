@@ -0,0 +1,110 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+import pytest
+import logging
+from azure.iot.device.common import trace_buffer
+from azure.iot.device.common.trace_buffer import TraceBuffer
+
+logging.basicConfig(level=logging.DEBUG)
+
+
+@pytest.fixture(autouse=True)
+def disable_tracing():
+    yield
+    trace_buffer.disable()
+
+
+@pytest.mark.describe("TraceBuffer")
+class TestTraceBuffer(object):
+    @pytest.mark.it("Returns recorded events oldest first, with a timestamp")
+    def test_records(self, mocker):
+        mocker.patch.object(trace_buffer.time, "time", side_effect=[1.5, 2.5])
+        tb = TraceBuffer(capacity=4)
+        tb.record(trace_buffer.PUBLISH, 12)
+        tb.record(trace_buffer.PUBACK, 12)
+
+        assert tb.get_records() == [(1.5, trace_buffer.PUBLISH, 12), (2.5, trace_buffer.PUBACK, 12)]
+
+    @pytest.mark.it("Overwrites the oldest events once the capacity is reached")
+    def test_wraps(self):
+        tb = TraceBuffer(capacity=3)
+        for mid in range(5):
+            tb.record(trace_buffer.PUBLISH, mid)
+
+        assert [r[2] for r in tb.get_records()] == [2, 3, 4]
+
+    @pytest.mark.it("Discards all events when cleared")
+    def test_clear(self):
+        tb = TraceBuffer(capacity=3)
+        tb.record(trace_buffer.PUBLISH, 1)
+        tb.clear()
+
+        assert tb.get_records() == []
+
+    @pytest.mark.it("Raises a ValueError if the capacity is not positive")
+    @pytest.mark.parametrize("capacity", [0, -1])
+    def test_bad_capacity(self, capacity):
+        with pytest.raises(ValueError):
+            TraceBuffer(capacity=capacity)
+
+
+@pytest.mark.describe("trace_buffer - .record()")
+class TestRecord(object):
+    @pytest.mark.it("Does nothing if tracing is not enabled")
+    def test_disabled(self):
+        trace_buffer.record(trace_buffer.PUBLISH, 1)
+
+        assert not trace_buffer.is_enabled()
+        assert trace_buffer.get_records() == []
+
+    @pytest.mark.it("Records the event if tracing is enabled")
+    def test_enabled(self):
+        trace_buffer.enable(capacity=8)
+        trace_buffer.record(trace_buffer.SUBSCRIBE, 3)
+
+        assert trace_buffer.is_enabled()
+        assert [(r[1], r[2]) for r in trace_buffer.get_records()] == [(trace_buffer.SUBSCRIBE, 3)]
+
+    @pytest.mark.it("Discards recorded events when tracing is disabled")
+    def test_disable(self):
+        trace_buffer.enable()
+        trace_buffer.record(trace_buffer.SUBSCRIBE, 3)
+        trace_buffer.disable()
+
+        assert trace_buffer.get_records() == []
+
+
+@pytest.mark.describe("trace_buffer - .dump()")
+class TestDump(object):
+    @pytest.mark.it("Logs each recorded event, oldest first")
+    def test_logs_events(self, mocker):
+        mocker.patch.object(trace_buffer.logger, "isEnabledFor", return_value=True)
+        mock_log = mocker.patch.object(trace_buffer.logger, "log")
+        trace_buffer.enable()
+        trace_buffer.record(trace_buffer.PUBLISH, 7)
+        trace_buffer.record(trace_buffer.DISCONNECT, 1)
+        trace_buffer.dump()
+
+        assert mock_log.call_count == 3
+        assert mock_log.call_args_list[1][0][3:] == ("PUBLISH", 7)
+        assert mock_log.call_args_list[2][0][3:] == ("DISCONNECT", 1)
+
+    @pytest.mark.it("Logs nothing if tracing is not enabled")
+    def test_disabled(self, mocker):
+        mock_log = mocker.patch.object(trace_buffer.logger, "log")
+        trace_buffer.dump()
+
+        assert mock_log.call_count == 0
+
+    @pytest.mark.it("Logs nothing if the logger is not enabled for the given level")
+    def test_level_disabled(self, mocker):
+        mocker.patch.object(trace_buffer.logger, "isEnabledFor", return_value=False)
+        mock_log = mocker.patch.object(trace_buffer.logger, "log")
+        trace_buffer.enable()
+        trace_buffer.record(trace_buffer.PUBLISH, 7)
+        trace_buffer.dump()
+
+        assert mock_log.call_count == 0
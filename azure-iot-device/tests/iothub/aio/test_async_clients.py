@@ -11,10 +11,12 @@ import threading
 import time
 import os
 import io
+import requests
 import sys
 import six.moves.urllib as urllib
 from azure.iot.device import exceptions as client_exceptions
 from azure.iot.device.common.auth import sastoken as st
+from azure.iot.device.common.flow_control import FlowControl
 from azure.iot.device.iothub.aio import IoTHubDeviceClient, IoTHubModuleClient
 from azure.iot.device.iothub.pipeline import constant as pipeline_constant
 from azure.iot.device.iothub.pipeline import exceptions as pipeline_exceptions
@@ -26,12 +28,14 @@ from azure.iot.device.iothub.abstract_clients import (
     RECEIVE_TYPE_API,
 )
 from azure.iot.device.iothub.aio.async_inbox import AsyncClientInbox
+from azure.iot.device.iothub import blob_upload
 from azure.iot.device.common import async_adapter
 from azure.iot.device import constant as device_constant
 from ..shared_client_tests import (
     SharedIoTHubClientInstantiationTests,
     SharedIoTHubClientPROPERTYHandlerTests,
     SharedIoTHubClientPROPERTYConnectedTests,
+    SharedIoTHubClientPROPERTYFlowControlTests,
     SharedIoTHubClientOCCURANCEConnectTests,
     SharedIoTHubClientOCCURANCEDisconnectTests,
     SharedIoTHubClientCreateFromConnectionStringTests,
@@ -153,6 +157,20 @@ class SharedClientConnectTests(object):
         await client.connect()
         assert mqtt_pipeline.connect.call_count == 1
 
+    @pytest.mark.it(
+        "Passes a deadline `timeout` seconds from now to the 'connect' pipeline operation, if a timeout is given"
+    )
+    @pytest.mark.parametrize("timeout", [None, 5], ids=["No timeout", "Timeout"])
+    async def test_passes_deadline_from_timeout(self, client, mqtt_pipeline, timeout):
+        before = time.time()
+        await client.connect(timeout=timeout)
+        after = time.time()
+        deadline = mqtt_pipeline.connect.call_args[1]["deadline"]
+        if timeout is None:
+            assert deadline is None
+        else:
+            assert before + timeout <= deadline <= after + timeout
+
     @pytest.mark.it("Waits for the completion of the 'connect' pipeline operation before returning")
     async def test_waits_for_pipeline_op_completion(self, mocker, client, mqtt_pipeline):
         cb_mock = mocker.patch.object(async_adapter, "AwaitableCallback").return_value
@@ -201,6 +219,11 @@ class SharedClientConnectTests(object):
                 client_exceptions.ClientError,
                 id="ProtocolProxyError->ClientError",
             ),
+            pytest.param(
+                pipeline_exceptions.OperationTimeout,
+                client_exceptions.OperationTimeout,
+                id="OperationTimeout->OperationTimeout",
+            ),
             pytest.param(Exception, client_exceptions.ClientError, id="Exception->ClientError"),
         ],
     )
@@ -209,7 +232,7 @@ class SharedClientConnectTests(object):
     ):
         my_pipeline_error = pipeline_error()
 
-        def fail_connect(callback):
+        def fail_connect(callback, deadline=None):
             callback(error=my_pipeline_error)
 
         mqtt_pipeline.connect = mocker.MagicMock(side_effect=fail_connect)
@@ -503,6 +526,20 @@ class SharedClientSendD2CMessageTests(object):
         assert mqtt_pipeline.send_message.call_count == 1
         assert mqtt_pipeline.send_message.call_args[0][0] is message
 
+    @pytest.mark.it(
+        "Passes a deadline `timeout` seconds from now to the 'send_message' pipeline operation, if a timeout is given"
+    )
+    @pytest.mark.parametrize("timeout", [None, 5], ids=["No timeout", "Timeout"])
+    async def test_passes_deadline_from_timeout(self, client, mqtt_pipeline, message, timeout):
+        before = time.time()
+        await client.send_message(message, timeout=timeout)
+        after = time.time()
+        deadline = mqtt_pipeline.send_message.call_args[1]["deadline"]
+        if timeout is None:
+            assert deadline is None
+        else:
+            assert before + timeout <= deadline <= after + timeout
+
     @pytest.mark.it(
         "Waits for the completion of the 'send_message' pipeline operation before returning"
     )
@@ -548,6 +585,11 @@ class SharedClientSendD2CMessageTests(object):
                 client_exceptions.ClientError,
                 id="ProtocolClientError->ClientError",
             ),
+            pytest.param(
+                pipeline_exceptions.OperationTimeout,
+                client_exceptions.OperationTimeout,
+                id="OperationTimeout->OperationTimeout",
+            ),
             pytest.param(Exception, client_exceptions.ClientError, id="Exception->ClientError"),
         ],
     )
@@ -556,7 +598,7 @@ class SharedClientSendD2CMessageTests(object):
     ):
         my_pipeline_error = pipeline_error()
 
-        def fail_send_message(message, callback):
+        def fail_send_message(message, callback, deadline=None):
             callback(error=my_pipeline_error)
 
         mqtt_pipeline.send_message = mocker.MagicMock(side_effect=fail_send_message)
@@ -609,7 +651,7 @@ class SharedClientSendD2CMessageTests(object):
 
     @pytest.mark.it("Does not raises error when message data size is equal to 256 KB")
     async def test_raises_error_when_message_data_equal_to_256(self, client, mqtt_pipeline):
-        data_input = "a" * 262095
+        data_input = "a" * 262144
         message = Message(data_input)
         # This check was put as message class may undergo the default content type encoding change
         # and the above calculation will change.
@@ -624,6 +666,51 @@ class SharedClientSendD2CMessageTests(object):
         assert sent_message.data == data_input
 
 
+class SharedClientWaitForCapacityTests(object):
+    @pytest.fixture
+    def flow_control(self, mqtt_pipeline):
+        mqtt_pipeline.flow_control = FlowControl(high_watermark=100, low_watermark=50)
+        return mqtt_pipeline.flow_control
+
+    @pytest.mark.it("Returns immediately if the client has capacity")
+    async def test_has_capacity(self, client, flow_control):
+        flow_control.add(100)
+        await asyncio.wait_for(client.wait_for_capacity(), 1)
+
+    @pytest.mark.it(
+        "Waits until completed sends have dropped the pending bytes to the low watermark"
+    )
+    async def test_waits_until_low_watermark(self, client, flow_control):
+        flow_control.add(60)
+        flow_control.add(60)
+
+        def complete_sends():
+            time.sleep(0.05)
+            flow_control.remove(60)
+            time.sleep(0.05)
+            flow_control.remove(60)
+
+        thread = threading.Thread(target=complete_sends)
+        thread.start()
+        await asyncio.wait_for(client.wait_for_capacity(), 5)
+        assert flow_control.pending_bytes == 0
+        thread.join()
+
+    @pytest.mark.it("Can be cancelled while waiting")
+    async def test_cancelled(self, client, flow_control):
+        flow_control.add(120)
+        with pytest.raises(asyncio.TimeoutError):
+            await asyncio.wait_for(client.wait_for_capacity(), 0.05)
+
+        # The callback waiting for capacity has been removed
+        assert flow_control._capacity_callbacks == []
+
+        # Capacity becoming available after the cancellation does not fail
+        flow_control.remove(120)
+        await asyncio.sleep(0.01)
+        assert client.has_capacity
+
+
 class SharedClientReceiveMethodRequestTests(object):
     @pytest.mark.it("Implicitly enables methods feature if not already enabled")
     @pytest.mark.parametrize(
@@ -764,6 +851,22 @@ class SharedClientSendMethodResponseTests(object):
         assert mqtt_pipeline.send_method_response.call_count == 1
         assert mqtt_pipeline.send_method_response.call_args[0][0] is method_response
 
+    @pytest.mark.it(
+        "Passes a deadline `timeout` seconds from now to the 'send_method_response' pipeline operation, if a timeout is given"
+    )
+    @pytest.mark.parametrize("timeout", [None, 5], ids=["No timeout", "Timeout"])
+    async def test_passes_deadline_from_timeout(
+        self, client, mqtt_pipeline, method_response, timeout
+    ):
+        before = time.time()
+        await client.send_method_response(method_response, timeout=timeout)
+        after = time.time()
+        deadline = mqtt_pipeline.send_method_response.call_args[1]["deadline"]
+        if timeout is None:
+            assert deadline is None
+        else:
+            assert before + timeout <= deadline <= after + timeout
+
     @pytest.mark.it(
         "Waits for the completion of the 'send_method_response' pipeline operation before returning"
     )
@@ -811,6 +914,11 @@ class SharedClientSendMethodResponseTests(object):
                 client_exceptions.ClientError,
                 id="ProtocolClientError->ClientError",
             ),
+            pytest.param(
+                pipeline_exceptions.OperationTimeout,
+                client_exceptions.OperationTimeout,
+                id="OperationTimeout->OperationTimeout",
+            ),
             pytest.param(Exception, client_exceptions.ClientError, id="Exception->ClientError"),
         ],
     )
@@ -819,7 +927,7 @@ class SharedClientSendMethodResponseTests(object):
     ):
         my_pipeline_error = pipeline_error()
 
-        def fail_send_method_response(response, callback):
+        def fail_send_method_response(response, callback, deadline=None):
             callback(error=my_pipeline_error)
 
         mqtt_pipeline.send_method_response = mocker.MagicMock(side_effect=fail_send_method_response)
@@ -835,7 +943,7 @@ class SharedClientGetTwinTests(object):
         self, mocker, client, mqtt_pipeline, fake_twin
     ):
         # patch this so get_twin won't block
-        def immediate_callback(callback):
+        def immediate_callback(callback, deadline=None):
             callback(twin=fake_twin)
 
         mocker.patch.object(mqtt_pipeline, "get_twin", side_effect=immediate_callback)
@@ -855,13 +963,29 @@ class SharedClientGetTwinTests(object):
 
     @pytest.mark.it("Begins a 'get_twin' pipeline operation")
     async def test_get_twin_calls_pipeline(self, client, mqtt_pipeline, mocker, fake_twin):
-        def immediate_callback(callback):
+        def immediate_callback(callback, deadline=None):
             callback(twin=fake_twin)
 
         mocker.patch.object(mqtt_pipeline, "get_twin", side_effect=immediate_callback)
         await client.get_twin()
         assert mqtt_pipeline.get_twin.call_count == 1
 
+    @pytest.mark.it(
+        "Passes a deadline `timeout` seconds from now to the 'get_twin' pipeline operation (and to enabling twin, if needed), if a timeout is given"
+    )
+    @pytest.mark.parametrize("timeout", [None, 5], ids=["No timeout", "Timeout"])
+    async def test_passes_deadline_from_timeout(self, client, mqtt_pipeline, timeout):
+        mqtt_pipeline.feature_enabled.__getitem__.return_value = False
+        before = time.time()
+        await client.get_twin(timeout=timeout)
+        after = time.time()
+        deadline = mqtt_pipeline.get_twin.call_args[1]["deadline"]
+        if timeout is None:
+            assert deadline is None
+        else:
+            assert before + timeout <= deadline <= after + timeout
+        assert mqtt_pipeline.enable_feature.call_args[1]["deadline"] == deadline
+
     @pytest.mark.it(
         "Waits for the completion of the 'get_twin' pipeline operation before returning"
     )
@@ -908,6 +1032,11 @@ class SharedClientGetTwinTests(object):
                 client_exceptions.ClientError,
                 id="ProtocolClientError->ClientError",
             ),
+            pytest.param(
+                pipeline_exceptions.OperationTimeout,
+                client_exceptions.OperationTimeout,
+                id="OperationTimeout->OperationTimeout",
+            ),
             pytest.param(Exception, client_exceptions.ClientError, id="Exception->ClientError"),
         ],
     )
@@ -916,7 +1045,7 @@ class SharedClientGetTwinTests(object):
     ):
         my_pipeline_error = pipeline_error()
 
-        def fail_get_twin(callback):
+        def fail_get_twin(callback, deadline=None):
             callback(error=my_pipeline_error)
 
         mqtt_pipeline.get_twin = mocker.MagicMock(side_effect=fail_get_twin)
@@ -929,7 +1058,7 @@ class SharedClientGetTwinTests(object):
     async def test_verifies_twin_returned(self, mocker, client, mqtt_pipeline, fake_twin):
 
         # make the pipeline the twin
-        def immediate_callback(callback):
+        def immediate_callback(callback, deadline=None):
             callback(twin=fake_twin)
 
         mocker.patch.object(mqtt_pipeline, "get_twin", side_effect=immediate_callback)
@@ -944,7 +1073,7 @@ class SharedClientPatchTwinReportedPropertiesTests(object):
         self, mocker, client, mqtt_pipeline, twin_patch_reported
     ):
         # patch this so x_get_twin won't block
-        def immediate_callback(patch, callback):
+        def immediate_callback(patch, callback, deadline=None):
             callback()
 
         mocker.patch.object(
@@ -975,6 +1104,24 @@ class SharedClientPatchTwinReportedPropertiesTests(object):
             is twin_patch_reported
         )
 
+    @pytest.mark.it(
+        "Passes a deadline `timeout` seconds from now to the 'patch_twin_reported_properties' pipeline operation (and to enabling twin, if needed), if a timeout is given"
+    )
+    @pytest.mark.parametrize("timeout", [None, 5], ids=["No timeout", "Timeout"])
+    async def test_passes_deadline_from_timeout(
+        self, client, mqtt_pipeline, twin_patch_reported, timeout
+    ):
+        mqtt_pipeline.feature_enabled.__getitem__.return_value = False
+        before = time.time()
+        await client.patch_twin_reported_properties(twin_patch_reported, timeout=timeout)
+        after = time.time()
+        deadline = mqtt_pipeline.patch_twin_reported_properties.call_args[1]["deadline"]
+        if timeout is None:
+            assert deadline is None
+        else:
+            assert before + timeout <= deadline <= after + timeout
+        assert mqtt_pipeline.enable_feature.call_args[1]["deadline"] == deadline
+
     @pytest.mark.it(
         "Waits for the completion of the 'patch_twin_reported_properties' pipeline operation before returning"
     )
@@ -1023,6 +1170,11 @@ class SharedClientPatchTwinReportedPropertiesTests(object):
                 client_exceptions.ClientError,
                 id="ProtocolClientError->ClientError",
             ),
+            pytest.param(
+                pipeline_exceptions.OperationTimeout,
+                client_exceptions.OperationTimeout,
+                id="OperationTimeout->OperationTimeout",
+            ),
             pytest.param(Exception, client_exceptions.ClientError, id="Exception->ClientError"),
         ],
     )
@@ -1031,7 +1183,7 @@ class SharedClientPatchTwinReportedPropertiesTests(object):
     ):
         my_pipeline_error = pipeline_error()
 
-        def fail_patch_twin_reported_properties(patch, callback):
+        def fail_patch_twin_reported_properties(patch, callback, deadline=None):
             callback(error=my_pipeline_error)
 
         mqtt_pipeline.patch_twin_reported_properties = mocker.MagicMock(
@@ -1177,6 +1329,18 @@ class TestIoTHubDeviceClientInstantiation(
             client._mqtt_pipeline.on_c2d_message_received == client._inbox_manager.route_c2d_message
         )
 
+    @pytest.mark.it("Sets on_c2d_messages_received handler in the MQTTPipeline")
+    async def test_sets_on_c2d_messages_received_handler_in_pipeline(
+        self, client_class, mqtt_pipeline, http_pipeline
+    ):
+        client = client_class(mqtt_pipeline, http_pipeline)
+
+        assert client._mqtt_pipeline.on_c2d_messages_received is not None
+        assert (
+            client._mqtt_pipeline.on_c2d_messages_received
+            == client._inbox_manager.route_c2d_messages
+        )
+
 
 @pytest.mark.describe("IoTHubDeviceClient (Asynchronous) - .create_from_connection_string()")
 class TestIoTHubDeviceClientCreateFromConnectionString(
@@ -1279,6 +1443,13 @@ class TestIoTHubDeviceClientSendD2CMessage(
     pass
 
 
+@pytest.mark.describe("IoTHubDeviceClient (Asynchronous) - .wait_for_capacity()")
+class TestIoTHubDeviceClientWaitForCapacity(
+    IoTHubDeviceClientTestsConfig, SharedClientWaitForCapacityTests
+):
+    pass
+
+
 @pytest.mark.describe("IoTHubDeviceClient (Asynchronous) - .receive_message()")
 class TestIoTHubDeviceClientReceiveC2DMessage(IoTHubDeviceClientTestsConfig):
     @pytest.mark.it("Implicitly enables C2D messaging feature if not already enabled")
@@ -1405,6 +1576,20 @@ class TestIoTHubDeviceClientGetStorageInfo(IoTHubDeviceClientTestsConfig):
         assert http_pipeline.get_storage_info_for_blob.call_count == 1
         assert http_pipeline.get_storage_info_for_blob.call_args[1]["blob_name"] is fake_blob_name
 
+    @pytest.mark.it(
+        "Passes a deadline `timeout` seconds from now to the 'get_storage_info_for_blob' pipeline operation, if a timeout is given"
+    )
+    @pytest.mark.parametrize("timeout", [None, 5], ids=["No timeout", "Timeout"])
+    async def test_passes_deadline_from_timeout(self, client, http_pipeline, timeout):
+        before = time.time()
+        await client.get_storage_info_for_blob("__fake_blob_name__", timeout=timeout)
+        after = time.time()
+        deadline = http_pipeline.get_storage_info_for_blob.call_args[1]["deadline"]
+        if timeout is None:
+            assert deadline is None
+        else:
+            assert before + timeout <= deadline <= after + timeout
+
     @pytest.mark.it(
         "Waits for the completion of the 'get_storage_info_for_blob' pipeline operation before returning"
     )
@@ -1431,6 +1616,11 @@ class TestIoTHubDeviceClientGetStorageInfo(IoTHubDeviceClientTestsConfig):
                 client_exceptions.ClientError,
                 id="ProtocolClientError->ClientError",
             ),
+            pytest.param(
+                pipeline_exceptions.OperationTimeout,
+                client_exceptions.OperationTimeout,
+                id="OperationTimeout->OperationTimeout",
+            ),
             pytest.param(Exception, client_exceptions.ClientError, id="Exception->ClientError"),
         ],
     )
@@ -1441,7 +1631,7 @@ class TestIoTHubDeviceClientGetStorageInfo(IoTHubDeviceClientTestsConfig):
 
         my_pipeline_error = pipeline_error()
 
-        def fail_get_storage_info_for_blob(blob_name, callback):
+        def fail_get_storage_info_for_blob(blob_name, callback, deadline=None):
             callback(error=my_pipeline_error)
 
         http_pipeline.get_storage_info_for_blob = mocker.MagicMock(
@@ -1483,6 +1673,26 @@ class TestIoTHubDeviceClientNotifyBlobUploadStatus(IoTHubDeviceClientTestsConfig
         assert kwargs["status_code"] is status_code
         assert kwargs["status_description"] is status_description
 
+    @pytest.mark.it(
+        "Passes a deadline `timeout` seconds from now to the 'notify_blob_upload_status' pipeline operation, if a timeout is given"
+    )
+    @pytest.mark.parametrize("timeout", [None, 5], ids=["No timeout", "Timeout"])
+    async def test_passes_deadline_from_timeout(self, client, http_pipeline, timeout):
+        before = time.time()
+        await client.notify_blob_upload_status(
+            correlation_id="__fake_correlation_id__",
+            is_success="__fake_is_success__",
+            status_code="__fake_status_code__",
+            status_description="__fake_status_description__",
+            timeout=timeout,
+        )
+        after = time.time()
+        deadline = http_pipeline.notify_blob_upload_status.call_args[1]["deadline"]
+        if timeout is None:
+            assert deadline is None
+        else:
+            assert before + timeout <= deadline <= after + timeout
+
     @pytest.mark.it(
         "Waits for the completion of the 'notify_blob_upload_status' pipeline operation before returning"
     )
@@ -1513,6 +1723,11 @@ class TestIoTHubDeviceClientNotifyBlobUploadStatus(IoTHubDeviceClientTestsConfig
                 client_exceptions.ClientError,
                 id="ProtocolClientError->ClientError",
             ),
+            pytest.param(
+                pipeline_exceptions.OperationTimeout,
+                client_exceptions.OperationTimeout,
+                id="OperationTimeout->OperationTimeout",
+            ),
             pytest.param(Exception, client_exceptions.ClientError, id="Exception->ClientError"),
         ],
     )
@@ -1526,7 +1741,7 @@ class TestIoTHubDeviceClientNotifyBlobUploadStatus(IoTHubDeviceClientTestsConfig
         my_pipeline_error = pipeline_error()
 
         def fail_notify_blob_upload_status(
-            correlation_id, is_success, status_code, status_description, callback
+            correlation_id, is_success, status_code, status_description, callback, deadline=None
         ):
             callback(error=my_pipeline_error)
 
@@ -1541,6 +1756,160 @@ class TestIoTHubDeviceClientNotifyBlobUploadStatus(IoTHubDeviceClientTestsConfig
             assert e_info.value.__cause__ is my_pipeline_error
 
 
+@pytest.mark.describe("IoTHubDeviceClient (Asynchronous) - .upload_file()")
+class TestIoTHubDeviceClientUploadFile(IoTHubDeviceClientTestsConfig):
+    @pytest.fixture
+    def storage_info(self):
+        return {
+            "correlationId": "__fake_correlation_id__",
+            "hostName": "__fake_host_name__",
+            "containerName": "__fake_container_name__",
+            "blobName": "__fake_blob_name__",
+            "sasToken": "?__fake_sas_token__",
+        }
+
+    @pytest.fixture
+    def mock_uploader_cls(self, mocker):
+        mock_cls = mocker.patch.object(blob_upload, "BlobUploader")
+        mock_cls.return_value.upload_file.return_value = 201
+        return mock_cls
+
+    @pytest.fixture
+    def upload_client(self, mocker, client, storage_info):
+        client._mqtt_pipeline.pipeline_configuration = mocker.MagicMock()
+
+        async def fake_get_storage_info_for_blob(blob_name, timeout=None):
+            return storage_info
+
+        async def fake_notify_blob_upload_status(**kwargs):
+            pass
+
+        mocker.patch.object(
+            client, "get_storage_info_for_blob", side_effect=fake_get_storage_info_for_blob
+        )
+        mocker.patch.object(
+            client, "notify_blob_upload_status", side_effect=fake_notify_blob_upload_status
+        )
+        return client
+
+    @pytest.mark.it(
+        "Uploads the file with a BlobUploader for the blob URL from the storage info, using the client's TLS and proxy settings"
+    )
+    async def test_uploads_file(self, mocker, upload_client, mock_uploader_cls, storage_info):
+        pipeline_configuration = upload_client._mqtt_pipeline.pipeline_configuration
+        await upload_client.upload_file(
+            "__fake_blob_name__",
+            "some/file/path",
+            block_size=1024,
+            max_concurrency=2,
+            manifest_path="some/manifest/path",
+        )
+        assert upload_client.get_storage_info_for_blob.call_args == mocker.call(
+            "__fake_blob_name__", timeout=None
+        )
+        assert mock_uploader_cls.call_args == mocker.call(
+            blob_upload.get_blob_url(storage_info),
+            block_size=1024,
+            max_concurrency=2,
+            manifest_path="some/manifest/path",
+            server_verification_cert=pipeline_configuration.server_verification_cert,
+            cipher=pipeline_configuration.cipher,
+            proxy_options=pipeline_configuration.proxy_options,
+            deadline=None,
+        )
+        assert mock_uploader_cls.return_value.upload_file.call_args == mocker.call("some/file/path")
+
+    @pytest.mark.it("Notifies the IoTHub of a successful upload")
+    async def test_notifies_success(self, upload_client, mock_uploader_cls, storage_info):
+        await upload_client.upload_file("__fake_blob_name__", "some/file/path")
+        assert upload_client.notify_blob_upload_status.call_count == 1
+        kwargs = upload_client.notify_blob_upload_status.call_args[1]
+        assert kwargs["correlation_id"] == storage_info["correlationId"]
+        assert kwargs["is_success"] is True
+        assert kwargs["status_code"] == 201
+        assert kwargs["status_description"] == "Uploaded __fake_blob_name__"
+
+    @pytest.mark.it(
+        "Does not send the local path of the file to the IoTHub, even if reading the file fails"
+    )
+    async def test_no_file_path(self, upload_client, mock_uploader_cls):
+        await upload_client.upload_file("__fake_blob_name__", "some/file/path")
+        kwargs = upload_client.notify_blob_upload_status.call_args[1]
+        assert "some/file/path" not in kwargs["status_description"]
+
+        my_error = IOError(2, "No such file or directory", "some/file/path")
+        mock_uploader_cls.return_value.upload_file.side_effect = my_error
+        with pytest.raises(IOError):
+            await upload_client.upload_file("__fake_blob_name__", "some/file/path")
+        kwargs = upload_client.notify_blob_upload_status.call_args[1]
+        assert "some/file/path" not in kwargs["status_description"]
+
+    @pytest.mark.it(
+        "Notifies the IoTHub of a failed upload and raises the error, if the upload fails"
+    )
+    async def test_notifies_failure(self, upload_client, mock_uploader_cls, storage_info):
+        my_error = client_exceptions.ServiceError("Azure Storage returned 403")
+        mock_uploader_cls.return_value.upload_file.side_effect = my_error
+        with pytest.raises(client_exceptions.ServiceError) as e_info:
+            await upload_client.upload_file("__fake_blob_name__", "some/file/path")
+        assert e_info.value is my_error
+        assert upload_client.notify_blob_upload_status.call_count == 1
+        kwargs = upload_client.notify_blob_upload_status.call_args[1]
+        assert kwargs["correlation_id"] == storage_info["correlationId"]
+        assert kwargs["is_success"] is False
+
+    @pytest.mark.it(
+        "Notifies the IoTHub of a failed upload with the status code returned by Azure Storage"
+    )
+    @pytest.mark.parametrize(
+        "response_status_code, expected_status_code",
+        [pytest.param(403, 403, id="Error response"), pytest.param(None, 500, id="No response")],
+    )
+    async def test_notifies_failure_status_code(
+        self, upload_client, mock_uploader_cls, response_status_code, expected_status_code
+    ):
+        if response_status_code is None:
+            cause = requests.exceptions.ConnectionError()
+        else:
+            response = requests.Response()
+            response.status_code = response_status_code
+            cause = requests.exceptions.HTTPError(response=response)
+        my_error = client_exceptions.ServiceError("Azure Storage returned an error", cause=cause)
+        mock_uploader_cls.return_value.upload_file.side_effect = my_error
+        with pytest.raises(client_exceptions.ServiceError):
+            await upload_client.upload_file("__fake_blob_name__", "some/file/path")
+        kwargs = upload_client.notify_blob_upload_status.call_args[1]
+        assert kwargs["status_code"] == expected_status_code
+
+    @pytest.mark.it(
+        "Bounds getting the storage info, the upload and the notification by the timeout, if one is given"
+    )
+    async def test_timeout(self, mocker, upload_client, mock_uploader_cls):
+        mocker.patch.object(time, "time", return_value=1000.0)
+        await upload_client.upload_file("__fake_blob_name__", "some/file/path", timeout=30)
+
+        assert upload_client.get_storage_info_for_blob.call_args[1]["timeout"] == 30
+        assert mock_uploader_cls.call_args[1]["deadline"] == 1030.0
+        assert upload_client.notify_blob_upload_status.call_args[1]["timeout"] == 30
+
+    @pytest.mark.it(
+        "Raises an upload's OperationTimeout without notifying the IoTHub, if the timeout has passed"
+    )
+    async def test_timeout_passed(self, mocker, upload_client, mock_uploader_cls):
+        mock_time = mocker.patch.object(time, "time", return_value=1000.0)
+        my_error = client_exceptions.OperationTimeout("Upload did not complete")
+
+        def upload_file(file_path):
+            mock_time.return_value = 1031.0
+            raise my_error
+
+        mock_uploader_cls.return_value.upload_file.side_effect = upload_file
+        with pytest.raises(client_exceptions.OperationTimeout) as e_info:
+            await upload_client.upload_file("__fake_blob_name__", "some/file/path", timeout=30)
+        assert e_info.value is my_error
+        assert upload_client.notify_blob_upload_status.call_count == 0
+
+
 @pytest.mark.describe("IoTHubDeviceClient (Asynchronous) - PROPERTY .on_message_received")
 class TestIoTHubDeviceClientPROPERTYOnMessageReceivedHandler(
     IoTHubDeviceClientTestsConfig, SharedIoTHubClientPROPERTYHandlerTests
@@ -1554,6 +1923,28 @@ class TestIoTHubDeviceClientPROPERTYOnMessageReceivedHandler(
         return pipeline_constant.C2D_MSG
 
 
+@pytest.mark.describe("IoTHubDeviceClient (Asynchronous) - PROPERTY .on_message_batch_received")
+class TestIoTHubDeviceClientPROPERTYOnMessageBatchReceivedHandler(
+    IoTHubDeviceClientTestsConfig, SharedIoTHubClientPROPERTYHandlerTests
+):
+    @pytest.fixture
+    def handler_name(self):
+        return "on_message_batch_received"
+
+    @pytest.fixture
+    def feature_name(self):
+        return pipeline_constant.C2D_MSG
+
+    @pytest.mark.it(
+        "Does not disable the corresponding feature when .on_message_received is set to None while it is set"
+    )
+    async def test_on_message_received_set_to_none(self, client, handler, mqtt_pipeline):
+        client.on_message_batch_received = handler
+        mqtt_pipeline.feature_enabled.__getitem__.return_value = True
+        client.on_message_received = None
+        assert mqtt_pipeline.disable_feature.call_count == 0
+
+
 @pytest.mark.describe("IoTHubDeviceClient (Asynchronous) - PROPERTY .on_method_request_received")
 class TestIoTHubDeviceClientPROPERTYOnMethodRequestReceivedHandler(
     IoTHubDeviceClientTestsConfig, SharedIoTHubClientPROPERTYHandlerTests
@@ -1589,6 +1980,15 @@ class TestIoTHubDeviceClientPROPERTYConnected(
     pass
 
 
+@pytest.mark.describe(
+    "IoTHubDeviceClient (Asynchronous) - PROPERTY .pending_ops, .pending_bytes, .has_capacity"
+)
+class TestIoTHubDeviceClientPROPERTYFlowControl(
+    IoTHubDeviceClientTestsConfig, SharedIoTHubClientPROPERTYFlowControlTests
+):
+    pass
+
+
 @pytest.mark.describe("IoTHubDeviceClient (Asynchronous) - OCCURANCE: Connect")
 class TestIoTHubDeviceClientOCCURANCEConnect(
     IoTHubDeviceClientTestsConfig, SharedIoTHubClientOCCURANCEConnectTests
@@ -1653,6 +2053,18 @@ class TestIoTHubModuleClientInstantiation(
             == client._inbox_manager.route_input_message
         )
 
+    @pytest.mark.it("Sets on_input_messages_received handler in the MQTTPipeline")
+    async def test_sets_on_input_messages_received_handler_in_pipeline(
+        self, client_class, mqtt_pipeline, http_pipeline
+    ):
+        client = client_class(mqtt_pipeline, http_pipeline)
+
+        assert client._mqtt_pipeline.on_input_messages_received is not None
+        assert (
+            client._mqtt_pipeline.on_input_messages_received
+            == client._inbox_manager.route_input_messages
+        )
+
 
 @pytest.mark.describe("IoTHubModuleClient (Asynchronous) - .create_from_connection_string()")
 class TestIoTHubModuleClientCreateFromConnectionString(
@@ -1808,6 +2220,13 @@ class TestIoTHubNModuleClientSendD2CMessage(
     pass
 
 
+@pytest.mark.describe("IoTHubModuleClient (Asynchronous) - .wait_for_capacity()")
+class TestIoTHubModuleClientWaitForCapacity(
+    IoTHubModuleClientTestsConfig, SharedClientWaitForCapacityTests
+):
+    pass
+
+
 @pytest.mark.describe("IoTHubModuleClient (Asynchronous) - .send_message_to_output()")
 class TestIoTHubModuleClientSendToOutput(IoTHubModuleClientTestsConfig):
     @pytest.mark.it("Begins a 'send_output_message' pipeline operation")
@@ -1818,6 +2237,20 @@ class TestIoTHubModuleClientSendToOutput(IoTHubModuleClientTestsConfig):
         assert mqtt_pipeline.send_output_message.call_args[0][0] is message
         assert message.output_name == output_name
 
+    @pytest.mark.it(
+        "Passes a deadline `timeout` seconds from now to the 'send_output_message' pipeline operation, if a timeout is given"
+    )
+    @pytest.mark.parametrize("timeout", [None, 5], ids=["No timeout", "Timeout"])
+    async def test_passes_deadline_from_timeout(self, client, mqtt_pipeline, message, timeout):
+        before = time.time()
+        await client.send_message_to_output(message, "some_output", timeout=timeout)
+        after = time.time()
+        deadline = mqtt_pipeline.send_output_message.call_args[1]["deadline"]
+        if timeout is None:
+            assert deadline is None
+        else:
+            assert before + timeout <= deadline <= after + timeout
+
     @pytest.mark.it(
         "Waits for the completion of the 'send_output_message' pipeline operation before returning"
     )
@@ -1864,6 +2297,11 @@ class TestIoTHubModuleClientSendToOutput(IoTHubModuleClientTestsConfig):
                 client_exceptions.ClientError,
                 id="ProtocolClientError->ClientError",
             ),
+            pytest.param(
+                pipeline_exceptions.OperationTimeout,
+                client_exceptions.OperationTimeout,
+                id="OperationTimeout->OperationTimeout",
+            ),
             pytest.param(Exception, client_exceptions.ClientError, id="Exception->ClientError"),
         ],
     )
@@ -1872,7 +2310,7 @@ class TestIoTHubModuleClientSendToOutput(IoTHubModuleClientTestsConfig):
     ):
         my_pipeline_error = pipeline_error()
 
-        def fail_send_output_message(message, callback):
+        def fail_send_output_message(message, callback, deadline=None):
             callback(error=my_pipeline_error)
 
         mqtt_pipeline.send_output_message = mocker.MagicMock(side_effect=fail_send_output_message)
@@ -1936,7 +2374,7 @@ class TestIoTHubModuleClientSendToOutput(IoTHubModuleClientTestsConfig):
         self, client, mqtt_pipeline
     ):
         output_name = "some_output"
-        data_input = "a" * 262095
+        data_input = "a" * 262144
         message = Message(data_input)
         # This check was put as message class may undergo the default content type encoding change
         # and the above calculation will change.
@@ -2084,8 +2522,24 @@ class TestIoTHubModuleClientInvokeMethod(IoTHubModuleClientTestsConfig):
         await client.invoke_method(method_params, device_id)
         assert http_pipeline.invoke_method.call_count == 1
         assert http_pipeline.invoke_method.call_args == mocker.call(
-            device_id, method_params, callback=mocker.ANY, module_id=None
+            device_id, method_params, callback=mocker.ANY, module_id=None, deadline=None
+        )
+
+    @pytest.mark.it(
+        "Passes a deadline `timeout` seconds from now to the 'invoke_method' pipeline operation, if a timeout is given"
+    )
+    @pytest.mark.parametrize("timeout", [None, 5], ids=["No timeout", "Timeout"])
+    async def test_passes_deadline_from_timeout(self, client, http_pipeline, timeout):
+        before = time.time()
+        await client.invoke_method(
+            {"methodName": "__fake_method_name__"}, "__fake_device_id__", timeout=timeout
         )
+        after = time.time()
+        deadline = http_pipeline.invoke_method.call_args[1]["deadline"]
+        if timeout is None:
+            assert deadline is None
+        else:
+            assert before + timeout <= deadline <= after + timeout
 
     @pytest.mark.it("Begins a 'invoke_method' HTTPPipeline operation where the target is a module")
     async def test_calls_pipeline_invoke_method_for_module(self, mocker, client, http_pipeline):
@@ -2097,7 +2551,7 @@ class TestIoTHubModuleClientInvokeMethod(IoTHubModuleClientTestsConfig):
         # assert http_pipeline.invoke_method.call_args[0][0] is device_id
         # assert http_pipeline.invoke_method.call_args[0][1] is method_params
         assert http_pipeline.invoke_method.call_args == mocker.call(
-            device_id, method_params, callback=mocker.ANY, module_id=module_id
+            device_id, method_params, callback=mocker.ANY, module_id=module_id, deadline=None
         )
 
     @pytest.mark.it(
@@ -2128,6 +2582,11 @@ class TestIoTHubModuleClientInvokeMethod(IoTHubModuleClientTestsConfig):
                 client_exceptions.ClientError,
                 id="ProtocolClientError->ClientError",
             ),
+            pytest.param(
+                pipeline_exceptions.OperationTimeout,
+                client_exceptions.OperationTimeout,
+                id="OperationTimeout->OperationTimeout",
+            ),
             pytest.param(Exception, client_exceptions.ClientError, id="Exception->ClientError"),
         ],
     )
@@ -2139,7 +2598,7 @@ class TestIoTHubModuleClientInvokeMethod(IoTHubModuleClientTestsConfig):
         module_id = "__fake_module_id__"
         my_pipeline_error = pipeline_error()
 
-        def fail_invoke_method(method_params, device_id, callback, module_id=None):
+        def fail_invoke_method(method_params, device_id, callback, module_id=None, deadline=None):
             return callback(error=my_pipeline_error)
 
         http_pipeline.invoke_method = mocker.MagicMock(side_effect=fail_invoke_method)
@@ -2163,6 +2622,28 @@ class TestIoTHubModuleClientPROPERTYOnMessageReceivedHandler(
         return pipeline_constant.INPUT_MSG
 
 
+@pytest.mark.describe("IoTHubModuleClient (Asynchronous) - PROPERTY .on_message_batch_received")
+class TestIoTHubModuleClientPROPERTYOnMessageBatchReceivedHandler(
+    IoTHubModuleClientTestsConfig, SharedIoTHubClientPROPERTYHandlerTests
+):
+    @pytest.fixture
+    def handler_name(self):
+        return "on_message_batch_received"
+
+    @pytest.fixture
+    def feature_name(self):
+        return pipeline_constant.INPUT_MSG
+
+    @pytest.mark.it(
+        "Does not disable the corresponding feature when .on_message_received is set to None while it is set"
+    )
+    async def test_on_message_received_set_to_none(self, client, handler, mqtt_pipeline):
+        client.on_message_batch_received = handler
+        mqtt_pipeline.feature_enabled.__getitem__.return_value = True
+        client.on_message_received = None
+        assert mqtt_pipeline.disable_feature.call_count == 0
+
+
 @pytest.mark.describe("IoTHubModuleClient (Asynchronous) - PROPERTY .on_method_request_received")
 class TestIoTHubModuleClientPROPERTYOnMethodRequestReceivedHandler(
     IoTHubModuleClientTestsConfig, SharedIoTHubClientPROPERTYHandlerTests
@@ -2198,6 +2679,15 @@ class TestIoTHubModuleClientPROPERTYConnected(
     pass
 
 
+@pytest.mark.describe(
+    "IoTHubModuleClient (Asynchronous) - PROPERTY .pending_ops, .pending_bytes, .has_capacity"
+)
+class TestIoTHubModuleClientPROPERTYFlowControl(
+    IoTHubModuleClientTestsConfig, SharedIoTHubClientPROPERTYFlowControlTests
+):
+    pass
+
+
 @pytest.mark.describe("IoTHubModuleClient (Asynchronous) - OCCURANCE: Connect")
 class TestIoTHubModuleClientOCCURANCEConnect(
     IoTHubModuleClientTestsConfig, SharedIoTHubClientOCCURANCEConnectTests
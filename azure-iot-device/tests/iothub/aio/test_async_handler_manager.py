@@ -13,6 +13,7 @@ from azure.iot.device.common import handle_exceptions
 from azure.iot.device.iothub.aio.async_handler_manager import AsyncHandlerManager
 from azure.iot.device.iothub.sync_handler_manager import HandlerManagerException
 from azure.iot.device.iothub.sync_handler_manager import MESSAGE, METHOD, TWIN_DP_PATCH
+from azure.iot.device.iothub.sync_handler_manager import MESSAGE_BATCH, MAX_BATCH_SIZE
 from azure.iot.device.iothub.inbox_manager import InboxManager
 from azure.iot.device.iothub.aio.async_inbox import AsyncClientInbox
 
@@ -36,6 +37,23 @@ all_internal_handlers = [MESSAGE, METHOD, TWIN_DP_PATCH]
 all_handlers = [s.lstrip("_") for s in all_internal_handlers]
 
 
+class BatchRecorder(object):
+    """Handler which records the batches it is invoked with, in a threadsafe manner"""
+
+    def __init__(self):
+        self.batches = []
+        self.lock = threading.Lock()
+
+    def __call__(self, batch):
+        with self.lock:
+            self.batches.append(batch)
+
+    @property
+    def items(self):
+        with self.lock:
+            return [item for batch in self.batches for item in batch]
+
+
 class ThreadsafeMock(object):
     """ This class provides (some) Mock functionality in a threadsafe manner, specifically, it
     ensures that the 'call_count' attribute will be accurate when the mock is called from another
@@ -496,3 +514,53 @@ class TestAsyncHandlerManagerPropertyOnTwinDesiredPropertiesPatchReceived(
     @pytest.fixture
     def inbox(self, inbox_manager):
         return inbox_manager.get_twin_patch_inbox()
+
+
+@pytest.mark.describe("AsyncHandlerManager - PROPERTY: .on_message_batch_received")
+class TestAsyncHandlerManagerPropertyOnMessageBatchReceived(object):
+    @pytest.fixture
+    def handler_manager(self, inbox_manager):
+        hm = AsyncHandlerManager(inbox_manager)
+        yield hm
+        hm.stop()
+
+    @pytest.fixture
+    def inbox(self, inbox_manager):
+        return inbox_manager.get_unified_message_inbox()
+
+    @pytest.mark.it("Is initialized to None, and can be both read and written to")
+    async def test_read_write(self, handler_manager, handler):
+        assert handler_manager.on_message_batch_received is None
+        handler_manager.on_message_batch_received = handler
+        assert handler_manager.on_message_batch_received is handler
+        assert handler_manager._handler_runners[MESSAGE_BATCH] is not None
+        handler_manager.on_message_batch_received = None
+        assert handler_manager.on_message_batch_received is None
+        assert handler_manager._handler_runners[MESSAGE_BATCH] is None
+
+    @pytest.mark.it(
+        "Is invoked with lists of all the items waiting in the unified message inbox, in order, with at most MAX_BATCH_SIZE items in each"
+    )
+    async def test_invoked_with_batch(self, mocker, handler_manager, inbox):
+        items = [mocker.MagicMock() for _ in range(MAX_BATCH_SIZE + 20)]
+        for item in items:
+            inbox._put(item)
+        recorder = BatchRecorder()
+        handler_manager.on_message_batch_received = recorder
+        handler_manager.stop()
+        await asyncio.sleep(0.1)
+
+        assert recorder.items == items
+        assert len(recorder.batches) < len(items)
+        assert max(len(batch) for batch in recorder.batches) <= MAX_BATCH_SIZE
+        assert inbox.empty()
+
+    @pytest.mark.it("Raises a ValueError if set while .on_message_received is set, or vice versa")
+    async def test_exclusive_with_on_message_received(self, handler_manager, handler):
+        handler_manager.on_message_received = handler
+        with pytest.raises(ValueError):
+            handler_manager.on_message_batch_received = handler
+        handler_manager.on_message_received = None
+        handler_manager.on_message_batch_received = handler
+        with pytest.raises(ValueError):
+            handler_manager.on_message_received = handler
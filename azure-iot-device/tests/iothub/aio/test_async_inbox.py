@@ -73,6 +73,36 @@ class TestAsyncClientInboxPut(object):
         assert item in inbox
 
 
+@pytest.mark.describe("AsyncClientInbox - ._put_many()")
+class TestAsyncClientInboxPutMany(object):
+    @pytest.mark.it("Adds the given items to the inbox, in order")
+    def test_adds_items(self, mocker):
+        inbox = AsyncClientInbox()
+        items = [mocker.MagicMock() for _ in range(3)]
+        inbox._put_many(items)
+        assert [inbox.get_nowait() for _ in items] == items
+        assert inbox.empty()
+
+    @pytest.mark.it("Wakes up a coroutine waiting for each item")
+    @pytest.mark.asyncio
+    async def test_wakes_getters(self, mocker):
+        inbox = AsyncClientInbox()
+        items = [mocker.MagicMock() for _ in range(3)]
+
+        async def insert_items():
+            await asyncio.sleep(1)  # wait before adding items to ensure the getters are first
+            inbox._put_many(items)
+
+        gotten = await asyncio.gather(*[inbox.get() for _ in items], insert_items())
+        assert sorted(gotten[:-1], key=id) == sorted(items, key=id)
+
+    @pytest.mark.it("Does nothing if there are no items")
+    def test_no_items(self):
+        inbox = AsyncClientInbox()
+        inbox._put_many([])
+        assert inbox.empty()
+
+
 @pytest.mark.describe("AsyncClientInbox - .get()")
 @pytest.mark.asyncio
 class TestAsyncClientInboxGet(object):
@@ -200,7 +200,7 @@ class FakeIoTHubPipeline:
     def shutdown(self, callback):
         callback()
 
-    def connect(self, callback):
+    def connect(self, callback, deadline=None):
         callback()
 
     def disconnect(self, callback):
@@ -209,25 +209,25 @@ class FakeIoTHubPipeline:
     def reauthorize_connection(self, callback):
         callback()
 
-    def enable_feature(self, feature_name, callback):
+    def enable_feature(self, feature_name, callback, deadline=None):
         callback()
 
     def disable_feature(self, feature_name, callback):
         callback()
 
-    def send_message(self, event, callback):
+    def send_message(self, event, callback, deadline=None):
         callback()
 
-    def send_output_message(self, event, callback):
+    def send_output_message(self, event, callback, deadline=None):
         callback()
 
-    def send_method_response(self, method_response, callback):
+    def send_method_response(self, method_response, callback, deadline=None):
         callback()
 
-    def get_twin(self, callback):
+    def get_twin(self, callback, deadline=None):
         callback(twin={})
 
-    def patch_twin_reported_properties(self, patch, callback):
+    def patch_twin_reported_properties(self, patch, callback, deadline=None):
         callback()
 
 
@@ -235,14 +235,14 @@ class FakeHTTPPipeline:
     def __init__(self):
         pass
 
-    def invoke_method(self, device_id, method_params, callback, module_id=None):
+    def invoke_method(self, device_id, method_params, callback, module_id=None, deadline=None):
         callback(invoke_method_response="__fake_method_response__")
 
-    def get_storage_info_for_blob(self, blob_name, callback):
+    def get_storage_info_for_blob(self, blob_name, callback, deadline=None):
         callback(storage_info="__fake_storage_info__")
 
     def notify_blob_upload_status(
-        self, correlation_id, is_success, status_code, status_description, callback
+        self, correlation_id, is_success, status_code, status_description, callback, deadline=None
     ):
         callback()
 
@@ -7,6 +7,8 @@
 import pytest
 import logging
 from azure.iot.device.iothub.models import Message
+from azure.iot.device.iothub.pipeline import mqtt_topic_iothub
+from azure.iot.device.common import version_compat
 from azure.iot.device import constant
 
 logging.basicConfig(level=logging.DEBUG)
@@ -104,3 +106,121 @@ class TestMessage(object):
         assert msg.iothub_interface_id is None
         msg.set_as_security_message()
         assert msg.iothub_interface_id == constant.SECURITY_MESSAGE_INTERFACE_ID
+
+
+@pytest.mark.describe("Message - .get_size()")
+class TestMessageGetSize(object):
+    @pytest.mark.it("Returns the size of the encoded payload when there are no properties")
+    @pytest.mark.parametrize(
+        "data, expected_size",
+        [
+            pytest.param("abc", 3, id="String"),
+            pytest.param(
+                b"\xc3\xa9t\xc3\xa9".decode("utf-8"), 5, id="Non-ASCII string (UTF-8 encoded)"
+            ),
+            pytest.param(b"abcd", 4, id="Bytes"),
+            pytest.param(bytearray(b"abcde"), 5, id="Bytearray"),
+            pytest.param(12345, 5, id="Integer"),
+            pytest.param(None, 0, id="None"),
+        ],
+    )
+    def test_payload_size(self, data, expected_size):
+        msg = Message(data)
+        assert msg.get_size() == expected_size
+
+    @pytest.mark.it("Includes the size of the properties as they are encoded in the topic")
+    def test_properties_size(self):
+        msg = Message("abc", message_id="mid", content_encoding="utf-8")
+        msg.custom_properties["some key"] = "some value"
+        topic = mqtt_topic_iothub.encode_message_properties_in_topic(msg, "")
+        assert msg.get_size() == 3 + len(topic)
+
+    @pytest.mark.it("Raises a ValueError if custom property keys are duplicated as strings")
+    def test_duplicate_keys(self):
+        msg = Message("abc")
+        msg.custom_properties[1] = "a"
+        msg.custom_properties["1"] = "b"
+        with pytest.raises(ValueError):
+            msg.get_size()
+
+
+@pytest.mark.describe("Message - Property encoding")
+class TestMessagePropertyEncoding(object):
+    @pytest.fixture
+    def msg(self):
+        msg = Message("abc", message_id="mid")
+        for i in range(25):
+            msg.custom_properties["key{}".format(i)] = "value {}".format(i)
+        return msg
+
+    @pytest.fixture
+    def spy_urlencode(self, mocker):
+        return mocker.spy(version_compat, "urlencode")
+
+    @pytest.mark.it(
+        "Reuses the encoding from .get_size() when encoding the properties in the topic"
+    )
+    def test_reuses_encoding(self, msg, spy_urlencode):
+        size = msg.get_size()
+        encode_count = spy_urlencode.call_count
+        topic = mqtt_topic_iothub.encode_message_properties_in_topic(msg, "topic/")
+
+        assert spy_urlencode.call_count == encode_count
+        assert size == 3 + len(topic) - len("topic/")
+
+    @pytest.mark.it("Encodes the properties again if they have changed")
+    @pytest.mark.parametrize(
+        "change",
+        [
+            pytest.param("system", id="System property set"),
+            pytest.param("custom_set", id="Custom property set"),
+            pytest.param("custom_del", id="Custom property deleted"),
+            pytest.param("custom_type", id="Custom property set to an equal value of another type"),
+            pytest.param("custom_replace", id="Custom properties replaced"),
+            pytest.param("custom_mutate", id="Custom property value modified in place"),
+        ],
+    )
+    def test_properties_changed(self, msg, spy_urlencode, change):
+        msg.get_size()
+        encode_count = spy_urlencode.call_count
+        if change == "system":
+            msg.correlation_id = "cid"
+        elif change == "custom_set":
+            msg.custom_properties["key0"] = "new value"
+        elif change == "custom_del":
+            del msg.custom_properties["key0"]
+        elif change == "custom_type":
+            msg.custom_properties["key0"] = 1
+            msg.get_size()
+            encode_count = spy_urlencode.call_count
+            msg.custom_properties["key0"] = True
+        elif change == "custom_mutate":
+            msg.custom_properties["key0"] = ["a"]
+            msg.get_size()
+            encode_count = spy_urlencode.call_count
+            msg.custom_properties["key0"].append("b")
+        else:
+            msg.custom_properties = {"other key": "other value"}
+        topic = mqtt_topic_iothub.encode_message_properties_in_topic(msg, "")
+
+        assert spy_urlencode.call_count > encode_count
+        new_msg = Message(msg.data, message_id=msg.message_id)
+        new_msg.correlation_id = msg.correlation_id
+        new_msg.custom_properties = dict(msg.custom_properties)
+        assert topic == mqtt_topic_iothub.encode_message_properties_in_topic(new_msg, "")
+
+    @pytest.mark.it(
+        "Returns the system and custom properties uri-encoded as key-value pairs from .get_encoded_properties(), with the custom properties sorted by key"
+    )
+    def test_get_encoded_properties(self):
+        msg = Message("abc", message_id="my id")
+        msg.custom_properties["b"] = "value 2"
+        msg.custom_properties["a"] = "value&1"
+
+        assert msg.get_encoded_properties() == "%24.mid=my%20id&a=value%261&b=value%202"
+
+    @pytest.mark.it("Recalculates the payload size if the payload has been replaced")
+    def test_payload_changed(self, msg):
+        size = msg.get_size()
+        msg.data = "abcdef"
+        assert msg.get_size() == size + 3
@@ -71,6 +71,100 @@ class TestIoTHubPipelineConfigInstantiation(PipelineConfigInstantiationTestBase)
         config = IoTHubPipelineConfig(device_id=device_id, hostname=hostname, sastoken=sastoken)
         assert config.product_info == ""
 
+    @pytest.mark.it(
+        "Instantiates with the 'twin_cache' attribute set to the provided 'twin_cache' parameter"
+    )
+    def test_twin_cache_set(self, sastoken):
+        config = IoTHubPipelineConfig(
+            device_id=device_id, hostname=hostname, twin_cache=True, sastoken=sastoken
+        )
+        assert config.twin_cache is True
+
+    @pytest.mark.it(
+        "Instantiates with the 'twin_cache' attribute set to False if no 'twin_cache' parameter is provided"
+    )
+    def test_twin_cache_default(self, sastoken):
+        config = IoTHubPipelineConfig(device_id=device_id, hostname=hostname, sastoken=sastoken)
+        assert config.twin_cache is False
+
+    @pytest.mark.it(
+        "Instantiates with the 'reported_patch_coalesce_window' attribute set to the provided 'reported_patch_coalesce_window' parameter"
+    )
+    def test_reported_patch_coalesce_window_set(self, sastoken):
+        config = IoTHubPipelineConfig(
+            device_id=device_id,
+            hostname=hostname,
+            reported_patch_coalesce_window=0.5,
+            sastoken=sastoken,
+        )
+        assert config.reported_patch_coalesce_window == 0.5
+
+    @pytest.mark.it(
+        "Instantiates with the 'reported_patch_coalesce_window' attribute set to 0 if no 'reported_patch_coalesce_window' parameter is provided"
+    )
+    def test_reported_patch_coalesce_window_default(self, sastoken):
+        config = IoTHubPipelineConfig(device_id=device_id, hostname=hostname, sastoken=sastoken)
+        assert config.reported_patch_coalesce_window == 0
+
+    @pytest.mark.it(
+        "Raises a ValueError if the 'reported_patch_coalesce_window' parameter is negative or not a number"
+    )
+    @pytest.mark.parametrize("window", [-1, "sectumsempra"], ids=["Negative", "Not a number"])
+    def test_reported_patch_coalesce_window_invalid(self, sastoken, window):
+        with pytest.raises(ValueError):
+            IoTHubPipelineConfig(
+                device_id=device_id,
+                hostname=hostname,
+                reported_patch_coalesce_window=window,
+                sastoken=sastoken,
+            )
+
+    @pytest.mark.it(
+        "Instantiates with the 'pending_bytes_high_watermark' and 'pending_bytes_low_watermark' attributes set to the provided parameters"
+    )
+    def test_pending_bytes_watermarks_set(self, sastoken):
+        config = IoTHubPipelineConfig(
+            device_id=device_id,
+            hostname=hostname,
+            pending_bytes_high_watermark=1000,
+            pending_bytes_low_watermark=400,
+            sastoken=sastoken,
+        )
+        assert config.pending_bytes_high_watermark == 1000
+        assert config.pending_bytes_low_watermark == 400
+
+    @pytest.mark.it(
+        "Instantiates with the 'pending_bytes_high_watermark' and 'pending_bytes_low_watermark' attributes set to None if the parameters are not provided"
+    )
+    def test_pending_bytes_watermarks_default(self, sastoken):
+        config = IoTHubPipelineConfig(device_id=device_id, hostname=hostname, sastoken=sastoken)
+        assert config.pending_bytes_high_watermark is None
+        assert config.pending_bytes_low_watermark is None
+
+    @pytest.mark.it(
+        "Raises a ValueError if the 'pending_bytes_high_watermark' or 'pending_bytes_low_watermark' parameters are invalid"
+    )
+    @pytest.mark.parametrize(
+        "high_watermark, low_watermark",
+        [
+            pytest.param(-1, None, id="Negative high watermark"),
+            pytest.param(1.5, None, id="High watermark not an int"),
+            pytest.param(1000, -1, id="Negative low watermark"),
+            pytest.param(1000, "sectumsempra", id="Low watermark not an int"),
+            pytest.param(None, 400, id="Low watermark without high watermark"),
+            pytest.param(1000, 2000, id="Low watermark greater than high watermark"),
+        ],
+    )
+    def test_pending_bytes_watermarks_invalid(self, sastoken, high_watermark, low_watermark):
+        with pytest.raises(ValueError):
+            IoTHubPipelineConfig(
+                device_id=device_id,
+                hostname=hostname,
+                pending_bytes_high_watermark=high_watermark,
+                pending_bytes_low_watermark=low_watermark,
+                sastoken=sastoken,
+            )
+
     @pytest.mark.it("Instantiates with the 'blob_upload' attribute set to False")
     def test_blob_upload(self, sastoken):
         config = IoTHubPipelineConfig(device_id=device_id, hostname=hostname, sastoken=sastoken)
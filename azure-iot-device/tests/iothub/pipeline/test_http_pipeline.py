@@ -67,6 +67,7 @@ class TestHTTPPipelineInstantiation(object):
 
         expected_stage_order = [
             pipeline_stages_base.PipelineRootStage,
+            pipeline_stages_base.OpDeadlineStage,
             pipeline_stages_iothub_http.IoTHubHTTPTranslationStage,
             pipeline_stages_http.HTTPTransportStage,
         ]
@@ -131,6 +132,19 @@ class TestHTTPPipelineInvokeMethod(object):
             pipeline_ops_iothub_http.MethodInvokeOperation,
         )
 
+    @pytest.mark.it("Sets the provided deadline (if any) on the MethodInvokeOperation")
+    @pytest.mark.parametrize("deadline", [None, 1234567890.5], ids=["No deadline", "Deadline"])
+    def test_deadline(self, mocker, pipeline, deadline):
+        pipeline.invoke_method(
+            device_id=fake_device_id,
+            module_id=fake_module_id,
+            method_params=mocker.MagicMock(),
+            callback=mocker.MagicMock(),
+            deadline=deadline,
+        )
+        op = pipeline._pipeline.run_op.call_args[0][0]
+        assert op.deadline == deadline
+
     @pytest.mark.it(
         "Calls the callback with the error if the pipeline_configuration.method_invoke is not True"
     )
@@ -222,6 +236,15 @@ class TestHTTPPipelineGetStorageInfo(object):
             pipeline_ops_iothub_http.GetStorageInfoOperation,
         )
 
+    @pytest.mark.it("Sets the provided deadline (if any) on the GetStorageInfoOperation")
+    @pytest.mark.parametrize("deadline", [None, 1234567890.5], ids=["No deadline", "Deadline"])
+    def test_deadline(self, mocker, pipeline, deadline):
+        pipeline.get_storage_info_for_blob(
+            blob_name="__fake_blob_name__", callback=mocker.MagicMock(), deadline=deadline
+        )
+        op = pipeline._pipeline.run_op.call_args[0][0]
+        assert op.deadline == deadline
+
     @pytest.mark.it(
         "Calls the callback with the error upon unsuccessful completion of the GetStorageInfoOperation"
     )
@@ -283,6 +306,20 @@ class TestHTTPPipelineNotifyBlobUploadStatus(object):
         assert pipeline._pipeline.run_op.call_count == 1
         assert isinstance(op, pipeline_ops_iothub_http.NotifyBlobUploadStatusOperation)
 
+    @pytest.mark.it("Sets the provided deadline (if any) on the NotifyBlobUploadStatusOperation")
+    @pytest.mark.parametrize("deadline", [None, 1234567890.5], ids=["No deadline", "Deadline"])
+    def test_deadline(self, mocker, pipeline, deadline):
+        pipeline.notify_blob_upload_status(
+            correlation_id="__fake_correlation_id__",
+            is_success="__fake_is_success__",
+            status_code="__fake_status_code__",
+            status_description="__fake_status_description__",
+            callback=mocker.MagicMock(),
+            deadline=deadline,
+        )
+        op = pipeline._pipeline.run_op.call_args[0][0]
+        assert op.deadline == deadline
+
     @pytest.mark.it(
         "Calls the callback with the error if pipeline_configuration.blob_upload is not True"
     )
@@ -84,13 +84,28 @@ class TestMQTTPipelineInstantiation(object):
         assert pipeline.on_disconnected is None
         assert pipeline.on_c2d_message_received is None
         assert pipeline.on_input_message_received is None
+        assert pipeline.on_c2d_messages_received is None
+        assert pipeline.on_input_messages_received is None
         assert pipeline.on_method_request_received is None
         assert pipeline.on_twin_patch_received is None
 
+    @pytest.mark.it(
+        "Creates a FlowControl with the pending bytes watermarks from the pipeline configuration"
+    )
+    def test_flow_control(self, pipeline_configuration):
+        pipeline_configuration.pending_bytes_high_watermark = 1000
+        pipeline_configuration.pending_bytes_low_watermark = 200
+        pipeline = MQTTPipeline(pipeline_configuration)
+        assert pipeline.flow_control.high_watermark == 1000
+        assert pipeline.flow_control.low_watermark == 200
+        assert pipeline.flow_control.pending_ops == 0
+        assert pipeline.flow_control.pending_bytes == 0
+
     @pytest.mark.it("Configures the pipeline to trigger handlers in response to external events")
     def test_handlers_configured(self, pipeline_configuration):
         pipeline = MQTTPipeline(pipeline_configuration)
         assert pipeline._pipeline.on_pipeline_event_handler is not None
+        assert pipeline._pipeline.on_pipeline_event_batch_handler is not None
         assert pipeline._pipeline.on_connected_handler is not None
         assert pipeline._pipeline.on_disconnected_handler is not None
 
@@ -101,8 +116,11 @@ class TestMQTTPipelineInstantiation(object):
 
         expected_stage_order = [
             pipeline_stages_base.PipelineRootStage,
+            pipeline_stages_base.OpDeadlineStage,
             pipeline_stages_base.SasTokenRenewalStage,
             pipeline_stages_iothub.EnsureDesiredPropertiesStage,
+            pipeline_stages_iothub.ReportedPropertiesCoalescingStage,
+            pipeline_stages_iothub.TwinCacheStage,
             pipeline_stages_iothub.TwinRequestResponseStage,
             pipeline_stages_base.CoordinateRequestAndResponseStage,
             pipeline_stages_iothub_mqtt.IoTHubMQTTTranslationStage,
@@ -273,6 +291,13 @@ class TestMQTTPipelineConnect(object):
             pipeline._pipeline.run_op.call_args[0][0], pipeline_ops_base.ConnectOperation
         )
 
+    @pytest.mark.it("Sets the provided deadline (if any) on the ConnectOperation")
+    @pytest.mark.parametrize("deadline", [None, 1234567890.5], ids=["No deadline", "Deadline"])
+    def test_deadline(self, mocker, pipeline, deadline):
+        pipeline.connect(callback=mocker.MagicMock(), deadline=deadline)
+        op = pipeline._pipeline.run_op.call_args[0][0]
+        assert op.deadline == deadline
+
     @pytest.mark.it("Triggers the callback upon successful completion of the ConnectOperation")
     def test_op_success_with_callback(self, mocker, pipeline):
         cb = mocker.MagicMock()
@@ -421,6 +446,13 @@ class TestMQTTPipelineSendD2CMessage(object):
         assert isinstance(op, pipeline_ops_iothub.SendD2CMessageOperation)
         assert op.message == message
 
+    @pytest.mark.it("Sets the provided deadline (if any) on the SendD2CMessageOperation")
+    @pytest.mark.parametrize("deadline", [None, 1234567890.5], ids=["No deadline", "Deadline"])
+    def test_deadline(self, mocker, pipeline, message, deadline):
+        pipeline.send_message(message, callback=mocker.MagicMock(), deadline=deadline)
+        op = pipeline._pipeline.run_op.call_args[0][0]
+        assert op.deadline == deadline
+
     @pytest.mark.it(
         "Triggers the callback upon successful completion of the SendD2CMessageOperation"
     )
@@ -451,6 +483,21 @@ class TestMQTTPipelineSendD2CMessage(object):
         assert cb.call_count == 1
         assert cb.call_args == mocker.call(error=arbitrary_exception)
 
+    @pytest.mark.it(
+        "Counts the SendD2CMessageOperation as pending in the flow control until the operation completes"
+    )
+    @pytest.mark.parametrize("error", [False, True], ids=["Success", "Failure"])
+    def test_flow_control(self, mocker, pipeline, message, arbitrary_exception, error):
+        pipeline.send_message(message, callback=mocker.MagicMock())
+        assert pipeline.flow_control.pending_ops == 1
+        assert pipeline.flow_control.pending_bytes == message.get_size()
+
+        op = pipeline._pipeline.run_op.call_args[0][0]
+        op.complete(error=arbitrary_exception if error else None)
+
+        assert pipeline.flow_control.pending_ops == 0
+        assert pipeline.flow_control.pending_bytes == 0
+
 
 @pytest.mark.describe("MQTTPipeline - .send_output_message()")
 class TestMQTTPipelineSendOutputMessage(object):
@@ -478,6 +525,13 @@ class TestMQTTPipelineSendOutputMessage(object):
         assert isinstance(op, pipeline_ops_iothub.SendOutputMessageOperation)
         assert op.message == message
 
+    @pytest.mark.it("Sets the provided deadline (if any) on the SendOutputMessageOperation")
+    @pytest.mark.parametrize("deadline", [None, 1234567890.5], ids=["No deadline", "Deadline"])
+    def test_deadline(self, mocker, pipeline, message, deadline):
+        pipeline.send_output_message(message, callback=mocker.MagicMock(), deadline=deadline)
+        op = pipeline._pipeline.run_op.call_args[0][0]
+        assert op.deadline == deadline
+
     @pytest.mark.it(
         "Triggers the callback upon successful completion of the SendOutputMessageOperation"
     )
@@ -508,6 +562,21 @@ class TestMQTTPipelineSendOutputMessage(object):
         assert cb.call_count == 1
         assert cb.call_args == mocker.call(error=arbitrary_exception)
 
+    @pytest.mark.it(
+        "Counts the SendOutputMessageOperation as pending in the flow control until the operation completes"
+    )
+    @pytest.mark.parametrize("error", [False, True], ids=["Success", "Failure"])
+    def test_flow_control(self, mocker, pipeline, message, arbitrary_exception, error):
+        pipeline.send_output_message(message, callback=mocker.MagicMock())
+        assert pipeline.flow_control.pending_ops == 1
+        assert pipeline.flow_control.pending_bytes == message.get_size()
+
+        op = pipeline._pipeline.run_op.call_args[0][0]
+        op.complete(error=arbitrary_exception if error else None)
+
+        assert pipeline.flow_control.pending_ops == 0
+        assert pipeline.flow_control.pending_bytes == 0
+
 
 @pytest.mark.describe("MQTTPipeline - .send_method_response()")
 class TestMQTTPipelineSendMethodResponse(object):
@@ -531,6 +600,15 @@ class TestMQTTPipelineSendMethodResponse(object):
         assert isinstance(op, pipeline_ops_iothub.SendMethodResponseOperation)
         assert op.method_response == method_response
 
+    @pytest.mark.it("Sets the provided deadline (if any) on the SendMethodResponseOperation")
+    @pytest.mark.parametrize("deadline", [None, 1234567890.5], ids=["No deadline", "Deadline"])
+    def test_deadline(self, mocker, pipeline, method_response, deadline):
+        pipeline.send_method_response(
+            method_response, callback=mocker.MagicMock(), deadline=deadline
+        )
+        op = pipeline._pipeline.run_op.call_args[0][0]
+        assert op.deadline == deadline
+
     @pytest.mark.it(
         "Triggers the callback upon successful completion of the SendMethodResponseOperation"
     )
@@ -561,6 +639,21 @@ class TestMQTTPipelineSendMethodResponse(object):
         assert cb.call_count == 1
         assert cb.call_args == mocker.call(error=arbitrary_exception)
 
+    @pytest.mark.it(
+        "Counts the SendMethodResponseOperation as pending in the flow control until the operation completes"
+    )
+    @pytest.mark.parametrize("error", [False, True], ids=["Success", "Failure"])
+    def test_flow_control(self, mocker, pipeline, method_response, arbitrary_exception, error):
+        pipeline.send_method_response(method_response, callback=mocker.MagicMock())
+        assert pipeline.flow_control.pending_ops == 1
+        assert pipeline.flow_control.pending_bytes == 0
+
+        op = pipeline._pipeline.run_op.call_args[0][0]
+        op.complete(error=arbitrary_exception if error else None)
+
+        assert pipeline.flow_control.pending_ops == 0
+        assert pipeline.flow_control.pending_bytes == 0
+
 
 @pytest.mark.describe("MQTTPipeline - .get_twin()")
 class TestMQTTPipelineGetTwin(object):
@@ -582,6 +675,13 @@ class TestMQTTPipelineGetTwin(object):
             pipeline._pipeline.run_op.call_args[0][0], pipeline_ops_iothub.GetTwinOperation
         )
 
+    @pytest.mark.it("Sets the provided deadline (if any) on the GetTwinOperation")
+    @pytest.mark.parametrize("deadline", [None, 1234567890.5], ids=["No deadline", "Deadline"])
+    def test_deadline(self, mocker, pipeline, deadline):
+        pipeline.get_twin(callback=mocker.MagicMock(), deadline=deadline)
+        op = pipeline._pipeline.run_op.call_args[0][0]
+        assert op.deadline == deadline
+
     @pytest.mark.it(
         "Triggers the provided callback upon successful completion of the GetTwinOperation"
     )
@@ -635,6 +735,17 @@ class TestMQTTPipelinePatchTwinReportedProperties(object):
         assert isinstance(op, pipeline_ops_iothub.PatchTwinReportedPropertiesOperation)
         assert op.patch == twin_patch
 
+    @pytest.mark.it(
+        "Sets the provided deadline (if any) on the PatchTwinReportedPropertiesOperation"
+    )
+    @pytest.mark.parametrize("deadline", [None, 1234567890.5], ids=["No deadline", "Deadline"])
+    def test_deadline(self, mocker, pipeline, twin_patch, deadline):
+        pipeline.patch_twin_reported_properties(
+            twin_patch, callback=mocker.MagicMock(), deadline=deadline
+        )
+        op = pipeline._pipeline.run_op.call_args[0][0]
+        assert op.deadline == deadline
+
     @pytest.mark.it(
         "Triggers the callback upon successful completion of the PatchTwinReportedPropertiesOperation"
     )
@@ -698,6 +809,13 @@ class TestMQTTPipelineEnableFeature(object):
         assert isinstance(op, pipeline_ops_base.EnableFeatureOperation)
         assert op.feature_name == feature
 
+    @pytest.mark.it("Sets the provided deadline (if any) on the EnableFeatureOperation")
+    @pytest.mark.parametrize("deadline", [None, 1234567890.5], ids=["No deadline", "Deadline"])
+    def test_deadline(self, mocker, pipeline, deadline):
+        pipeline.enable_feature(constant.C2D_MSG, callback=mocker.MagicMock(), deadline=deadline)
+        op = pipeline._pipeline.run_op.call_args[0][0]
+        assert op.deadline == deadline
+
     @pytest.mark.it("Does not mark the feature as enabled before the callback is complete")
     @pytest.mark.parametrize("feature", all_features)
     def test_mark_feature_not_enabled(self, pipeline, feature, mocker):
@@ -1050,6 +1168,94 @@ class TestMQTTPipelineEVENTReceiveDesiredPropertiesPatch(object):
         # No assertions required - not throwing an exception means the test passed
 
 
+@pytest.mark.describe("MQTTPipeline - OCCURANCE: Batch of Events Received")
+class TestMQTTPipelineEVENTReceiveEventBatch(object):
+    @pytest.fixture
+    def c2d_events(self):
+        return [pipeline_events_iothub.C2DMessageEvent(Message(str(i))) for i in range(3)]
+
+    @pytest.fixture
+    def input_events(self):
+        events = [pipeline_events_iothub.InputMessageEvent(Message(str(i))) for i in range(3)]
+        for event in events:
+            event.message.input_name = "some_input"
+        return events
+
+    @pytest.mark.it(
+        "Triggers the 'on_c2d_messages_received' handler once for each run of consecutive C2D messages, passing the messages as a list"
+    )
+    def test_c2d_batch_handler(self, mocker, pipeline, c2d_events, method_request):
+        pipeline.on_c2d_messages_received = mocker.MagicMock()
+        pipeline.on_c2d_message_received = mocker.MagicMock()
+        pipeline.on_method_request_received = mocker.MagicMock()
+        method_request_event = pipeline_events_iothub.MethodRequestEvent(method_request)
+
+        pipeline._pipeline.on_pipeline_event_batch_handler(
+            c2d_events[:2] + [method_request_event] + c2d_events[2:]
+        )
+
+        assert pipeline.on_c2d_messages_received.call_args_list == [
+            mocker.call([c2d_events[0].message, c2d_events[1].message]),
+            mocker.call([c2d_events[2].message]),
+        ]
+        assert pipeline.on_c2d_message_received.call_count == 0
+        assert pipeline.on_method_request_received.call_args == mocker.call(method_request)
+
+    @pytest.mark.it(
+        "Triggers the 'on_input_messages_received' handler once for each run of consecutive input messages, passing the messages as a list"
+    )
+    def test_input_batch_handler(self, mocker, pipeline, input_events, c2d_events):
+        pipeline.on_input_messages_received = mocker.MagicMock()
+        pipeline.on_c2d_messages_received = mocker.MagicMock()
+
+        pipeline._pipeline.on_pipeline_event_batch_handler(
+            input_events[:2] + c2d_events + input_events[2:]
+        )
+
+        assert pipeline.on_input_messages_received.call_args_list == [
+            mocker.call([input_events[0].message, input_events[1].message]),
+            mocker.call([input_events[2].message]),
+        ]
+        assert pipeline.on_c2d_messages_received.call_args_list == [
+            mocker.call([event.message for event in c2d_events])
+        ]
+
+    @pytest.mark.it(
+        "Triggers the single message handlers for each message if the batch handlers are not set"
+    )
+    def test_no_batch_handler(self, mocker, pipeline, input_events, c2d_events):
+        pipeline.on_input_message_received = mocker.MagicMock()
+        pipeline.on_c2d_message_received = mocker.MagicMock()
+
+        pipeline._pipeline.on_pipeline_event_batch_handler(c2d_events + input_events)
+
+        assert pipeline.on_c2d_message_received.call_args_list == [
+            mocker.call(event.message) for event in c2d_events
+        ]
+        assert pipeline.on_input_message_received.call_args_list == [
+            mocker.call(event.message) for event in input_events
+        ]
+
+    @pytest.mark.it("Continues delivering the rest of the batch if a handler raises an exception")
+    def test_handler_raises(
+        self, mocker, pipeline, c2d_events, method_request, arbitrary_exception
+    ):
+        pipeline.on_c2d_messages_received = mocker.MagicMock(side_effect=arbitrary_exception)
+        pipeline.on_method_request_received = mocker.MagicMock(side_effect=arbitrary_exception)
+        spy_handle_background_exception = mocker.spy(
+            handle_exceptions, "handle_background_exception"
+        )
+        method_request_event = pipeline_events_iothub.MethodRequestEvent(method_request)
+
+        pipeline._pipeline.on_pipeline_event_batch_handler(
+            [c2d_events[0], method_request_event, c2d_events[1]]
+        )
+
+        assert pipeline.on_c2d_messages_received.call_count == 2
+        assert pipeline.on_method_request_received.call_count == 1
+        assert spy_handle_background_exception.call_count == 3
+
+
 @pytest.mark.describe("MQTTPipeline - PROPERTY .pipeline_configuration")
 class TestMQTTPipelinePROPERTYPipelineConfiguration(object):
     @pytest.mark.it("Value of the object cannot be changed")
@@ -7,6 +7,7 @@ import pytest
 import sys
 import logging
 from azure.iot.device.iothub.pipeline import pipeline_ops_iothub
+from azure.iot.device.common.pipeline import pipeline_ops_base
 from tests.common.pipeline import pipeline_ops_test
 
 logging.basicConfig(level=logging.DEBUG)
@@ -26,11 +27,21 @@ class SendD2CMessageOperationTestConfig(object):
 
 
 class SendD2CMessageOperationInstantiationTests(SendD2CMessageOperationTestConfig):
+    @pytest.mark.it("Initializes 'priority' attribute as PRIORITY_TELEMETRY")
+    def test_priority(self, cls_type, init_kwargs):
+        op = cls_type(**init_kwargs)
+        assert op.priority == pipeline_ops_base.PRIORITY_TELEMETRY
+
     @pytest.mark.it("Initializes 'message' attribute with the provided 'message' parameter")
     def test_message(self, cls_type, init_kwargs):
         op = cls_type(**init_kwargs)
         assert op.message is init_kwargs["message"]
 
+    @pytest.mark.it("Stores all attributes in slots, without a __dict__")
+    def test_slots(self, cls_type, init_kwargs):
+        op = cls_type(**init_kwargs)
+        assert not hasattr(op, "__dict__")
+
 
 pipeline_ops_test.add_operation_tests(
     test_module=this_module,
@@ -52,11 +63,21 @@ class SendOutputMessageOperationTestConfig(object):
 
 
 class SendOutputMessageOperationInstantiationTests(SendOutputMessageOperationTestConfig):
+    @pytest.mark.it("Initializes 'priority' attribute as PRIORITY_TELEMETRY")
+    def test_priority(self, cls_type, init_kwargs):
+        op = cls_type(**init_kwargs)
+        assert op.priority == pipeline_ops_base.PRIORITY_TELEMETRY
+
     @pytest.mark.it("Initializes 'message' attribute with the provided 'message' parameter")
     def test_message(self, cls_type, init_kwargs):
         op = cls_type(**init_kwargs)
         assert op.message is init_kwargs["message"]
 
+    @pytest.mark.it("Stores all attributes in slots, without a __dict__")
+    def test_slots(self, cls_type, init_kwargs):
+        op = cls_type(**init_kwargs)
+        assert not hasattr(op, "__dict__")
+
 
 pipeline_ops_test.add_operation_tests(
     test_module=this_module,
@@ -78,6 +99,11 @@ class SendMethodResponseOperationTestConfig(object):
 
 
 class SendMethodResponseOperationInstantiationTests(SendMethodResponseOperationTestConfig):
+    @pytest.mark.it("Initializes 'priority' attribute as PRIORITY_METHOD_RESPONSE")
+    def test_priority(self, cls_type, init_kwargs):
+        op = cls_type(**init_kwargs)
+        assert op.priority == pipeline_ops_base.PRIORITY_METHOD_RESPONSE
+
     @pytest.mark.it(
         "Initializes 'method_response' attribute with the provided 'method_response' parameter"
     )
@@ -106,6 +132,11 @@ class GetTwinOperationTestConfig(object):
 
 
 class GetTwinOperationInstantiationTests(GetTwinOperationTestConfig):
+    @pytest.mark.it("Initializes 'priority' attribute as PRIORITY_TWIN")
+    def test_priority(self, cls_type, init_kwargs):
+        op = cls_type(**init_kwargs)
+        assert op.priority == pipeline_ops_base.PRIORITY_TWIN
+
     @pytest.mark.it("Initializes 'twin' attribute as None")
     def test_twin(self, cls_type, init_kwargs):
         op = cls_type(**init_kwargs)
@@ -134,6 +165,11 @@ class PatchTwinReportedPropertiesOperationTestConfig(object):
 class PatchTwinReportedPropertiesOperationInstantiationTests(
     PatchTwinReportedPropertiesOperationTestConfig
 ):
+    @pytest.mark.it("Initializes 'priority' attribute as PRIORITY_TWIN")
+    def test_priority(self, cls_type, init_kwargs):
+        op = cls_type(**init_kwargs)
+        assert op.priority == pipeline_ops_base.PRIORITY_TWIN
+
     @pytest.mark.it("Initializes 'patch' attribute with the provided 'patch' parameter")
     def test_patch(self, cls_type, init_kwargs):
         op = cls_type(**init_kwargs)
@@ -3,19 +3,26 @@
 # Licensed under the MIT License. See License.txt in the project root for
 # license information.
 # --------------------------------------------------------------------------
+import copy
 import json
 import logging
 import pytest
 import sys
+import time
 from azure.iot.device.exceptions import ServiceError
-from azure.iot.device.common import handle_exceptions
+from azure.iot.device.common import handle_exceptions, alarm
+from azure.iot.device.iothub.models import DesiredPropertiesPatch
 from azure.iot.device.iothub.pipeline import (
     pipeline_events_iothub,
     pipeline_ops_iothub,
     pipeline_stages_iothub,
     constant as pipeline_constants,
 )
-from azure.iot.device.common.pipeline import pipeline_events_base, pipeline_ops_base
+from azure.iot.device.common.pipeline import (
+    pipeline_events_base,
+    pipeline_ops_base,
+    pipeline_stages_base,
+)
 from tests.common.pipeline.helpers import StageRunOpTestBase, StageHandlePipelineEventTestBase
 from tests.common.pipeline import pipeline_stage_test
 
@@ -88,6 +95,11 @@ class EnsureDesiredPropertiesStageInstantiationTests(EnsureDesiredPropertiesStag
         stage = pipeline_stages_iothub.EnsureDesiredPropertiesStage(**init_kwargs)
         assert stage.pending_get_request is None
 
+    @pytest.mark.it("Initializes 'last_desired_seen' None")
+    def test_last_desired_seen(self, init_kwargs):
+        stage = pipeline_stages_iothub.EnsureDesiredPropertiesStage(**init_kwargs)
+        assert stage.last_desired_seen is None
+
 
 pipeline_stage_test.add_base_pipeline_stage_tests(
     test_module=this_module,
@@ -413,6 +425,835 @@ class TestEnsureDesiredPropertiesStageWhenGetTwinOperationCompletes(
         assert stage.last_version_seen == new_version
 
 
+@pytest.mark.describe(
+    "EnsureDesiredPropertiesStage - OCCURANCE: TwinDesiredPropertiesPatchEvent received with known desired properties"
+)
+class TestEnsureDesiredPropertiesStageWhenPatchReceivedWithKnownDesired(
+    EnsureDesiredPropertiesStageTestConfig
+):
+    @pytest.fixture
+    def stage(self, mocker, cls_type, init_kwargs):
+        stage = cls_type(**init_kwargs)
+        stage.send_op_down = mocker.MagicMock()
+        stage.send_event_up = mocker.MagicMock()
+        stage.last_desired_seen = {"$version": 5, "foo": 1, "bar": {"baz": 2, "qux": 3}}
+        return stage
+
+    @pytest.mark.it(
+        "Sends the patch up as a DesiredPropertiesPatch, with the changes it makes as JSON patch operations"
+    )
+    def test_json_patch(self, stage):
+        patch = {"$version": 6, "foo": 1, "bar": {"baz": None, "qux": 4}, "new": {"a": 1}}
+        stage.handle_pipeline_event(pipeline_events_iothub.TwinDesiredPropertiesPatchEvent(patch))
+
+        sent_patch = stage.send_event_up.call_args[0][0].patch
+        assert isinstance(sent_patch, DesiredPropertiesPatch)
+        assert sent_patch == patch
+        assert sorted(sent_patch.json_patch, key=lambda op: op["path"]) == [
+            {"op": "remove", "path": "/bar/baz"},
+            {"op": "replace", "path": "/bar/qux", "value": 4},
+            {"op": "add", "path": "/new", "value": {"a": 1}},
+        ]
+
+    @pytest.mark.it("Applies the patch to `last_desired_seen`")
+    def test_applies_patch(self, stage):
+        patch = {"$version": 6, "bar": {"baz": None}}
+        stage.handle_pipeline_event(pipeline_events_iothub.TwinDesiredPropertiesPatchEvent(patch))
+
+        assert stage.last_desired_seen == {"$version": 6, "foo": 1, "bar": {"qux": 3}}
+
+    @pytest.mark.it(
+        "Sends the patch up with no JSON patch operations if the previous desired properties are not known"
+    )
+    def test_unknown_desired(self, stage):
+        stage.last_desired_seen = None
+        patch = {"$version": 6, "foo": 2}
+        stage.handle_pipeline_event(pipeline_events_iothub.TwinDesiredPropertiesPatchEvent(patch))
+
+        sent_patch = stage.send_event_up.call_args[0][0].patch
+        assert sent_patch == patch
+        assert sent_patch.json_patch is None
+        assert stage.last_desired_seen is None
+
+
+@pytest.mark.describe(
+    "EnsureDesiredPropertiesStage - OCCURANCE: GetTwinOperation that was sent down by this stage completes with changed desired properties"
+)
+class TestEnsureDesiredPropertiesStageWhenGetTwinOperationCompletesWithChanges(
+    EnsureDesiredPropertiesStageTestConfig
+):
+    @pytest.fixture
+    def stage(self, mocker, cls_type, init_kwargs):
+        stage = cls_type(**init_kwargs)
+        stage.send_op_down = mocker.MagicMock()
+        stage.send_event_up = mocker.MagicMock()
+        return stage
+
+    @pytest.fixture
+    def get_twin_op(self, stage):
+        stage.last_version_seen = 5
+        stage.handle_pipeline_event(pipeline_events_base.ConnectedEvent())
+        get_twin_op = stage.send_op_down.call_args[0][0]
+        stage.send_op_down.reset_mock()
+        stage.send_event_up.reset_mock()
+        return get_twin_op
+
+    @pytest.fixture
+    def new_desired(self):
+        return {"$version": 8, "foo": 1, "bar": {"baz": 2, "qux": 4}, "a/b": [1, 2]}
+
+    @pytest.mark.it(
+        "Sends a patch with only the properties which differ from `last_desired_seen`, in merge patch and JSON patch form"
+    )
+    def test_sends_diff(self, stage, get_twin_op, new_desired):
+        stage.last_desired_seen = {"$version": 5, "foo": 1, "bar": {"baz": 2, "qux": 3}, "old": 1}
+
+        get_twin_op.twin = {"desired": new_desired, "reported": {}}
+        get_twin_op.complete()
+
+        patch = stage.send_event_up.call_args[0][0].patch
+        assert isinstance(patch, DesiredPropertiesPatch)
+        assert patch == {"$version": 8, "bar": {"qux": 4}, "a/b": [1, 2], "old": None}
+        assert sorted(patch.json_patch, key=lambda op: op["path"]) == [
+            {"op": "add", "path": "/a~1b", "value": [1, 2]},
+            {"op": "replace", "path": "/bar/qux", "value": 4},
+            {"op": "remove", "path": "/old"},
+        ]
+
+    @pytest.mark.it("Sends all of the desired properties if `last_desired_seen` is not known")
+    def test_sends_all(self, stage, get_twin_op, new_desired):
+        get_twin_op.twin = {"desired": new_desired, "reported": {}}
+        get_twin_op.complete()
+
+        patch = stage.send_event_up.call_args[0][0].patch
+        assert isinstance(patch, DesiredPropertiesPatch)
+        assert patch == new_desired
+        assert patch.json_patch is None
+
+    @pytest.mark.it("Sets `last_desired_seen` to a copy of the new desired properties")
+    def test_sets_last_desired_seen(self, stage, get_twin_op, new_desired):
+        get_twin_op.twin = {"desired": new_desired, "reported": {}}
+        get_twin_op.complete()
+
+        assert stage.last_desired_seen == new_desired
+        assert stage.last_desired_seen is not new_desired
+
+
+@pytest.mark.describe(
+    "EnsureDesiredPropertiesStage - OCCURANCE: GetTwinOperation sent by the application completes"
+)
+class TestEnsureDesiredPropertiesStageWhenAppGetTwinOperationCompletes(
+    EnsureDesiredPropertiesStageTestConfig
+):
+    @pytest.fixture
+    def stage(self, mocker, cls_type, init_kwargs):
+        stage = cls_type(**init_kwargs)
+        stage.send_op_down = mocker.MagicMock()
+        stage.send_event_up = mocker.MagicMock()
+        return stage
+
+    @pytest.fixture
+    def op(self, mocker):
+        return pipeline_ops_iothub.GetTwinOperation(callback=mocker.MagicMock())
+
+    @pytest.mark.it("Sends the op down")
+    def test_sends_op_down(self, mocker, stage, op):
+        stage.run_op(op)
+        assert stage.send_op_down.call_args == mocker.call(op)
+
+    @pytest.mark.it("Sets `last_desired_seen` to a copy of the desired properties in the twin")
+    def test_sets_last_desired_seen(self, stage, op):
+        stage.run_op(op)
+        op.twin = {"desired": {"$version": 3, "foo": 1}, "reported": {}}
+        op.complete()
+
+        assert stage.last_desired_seen == {"$version": 3, "foo": 1}
+        assert stage.last_desired_seen is not op.twin["desired"]
+
+    @pytest.mark.it(
+        "Does not change `last_desired_seen` if the twin is older than it, or the op fails"
+    )
+    def test_older_twin(self, stage, op, arbitrary_exception):
+        stage.last_desired_seen = {"$version": 4, "foo": 2}
+        stage.run_op(op)
+        op.twin = {"desired": {"$version": 3, "foo": 1}, "reported": {}}
+        op.complete()
+
+        failed_op = pipeline_ops_iothub.GetTwinOperation(callback=lambda op, error: None)
+        stage.run_op(failed_op)
+        failed_op.complete(error=arbitrary_exception)
+
+        assert stage.last_desired_seen == {"$version": 4, "foo": 2}
+
+
+@pytest.mark.describe("diff_json_objects()")
+class TestDiffJsonObjects(object):
+    @pytest.mark.it("Returns empty patches if the objects are equal, ignoring top level '$' keys")
+    def test_equal(self):
+        assert pipeline_stages_iothub.diff_json_objects(
+            {"$version": 1, "a": {"b": [1]}}, {"$version": 2, "a": {"b": [1]}}
+        ) == ({}, [])
+
+    @pytest.mark.it("Returns a merge patch which turns the old object into the new one")
+    def test_merge_patch_round_trip(self):
+        old = {"a": 1, "b": {"c": 2, "d": {"e": 3}}, "f": True, "g": "x"}
+        new = {"a": 1, "b": {"d": {"e": 4}, "h": 5}, "f": 1, "i": {"j": None}}
+
+        merge_patch, json_patch = pipeline_stages_iothub.diff_json_objects(old, new)
+
+        pipeline_stages_iothub.apply_merge_patch(old, merge_patch)
+        assert old == {"a": 1, "b": {"d": {"e": 4}, "h": 5}, "f": 1, "i": {}}
+        # A bool replaced with an equal int is still a change
+        assert {"op": "replace", "path": "/f", "value": 1} in json_patch
+
+    @pytest.mark.it("Does not modify either object, or share values with the JSON patch")
+    def test_no_modification(self):
+        old = {"a": {"b": 1}}
+        new = {"a": {"b": 2}, "c": {"d": 1}}
+
+        merge_patch, json_patch = pipeline_stages_iothub.diff_json_objects(old, new)
+
+        assert old == {"a": {"b": 1}}
+        assert new == {"a": {"b": 2}, "c": {"d": 1}}
+        add_op = [op for op in json_patch if op["path"] == "/c"][0]
+        assert add_op["value"] == new["c"] and add_op["value"] is not new["c"]
+
+
+@pytest.mark.describe("combine_merge_patches()")
+class TestCombineMergePatches(object):
+    @pytest.mark.it("Returns a patch with the same effect as applying both patches in turn")
+    @pytest.mark.parametrize(
+        "first, second",
+        [
+            pytest.param({"a": 1, "b": {"c": 2}}, {"b": {"d": 3}, "e": None}, id="Merge"),
+            pytest.param({"k": {"a": {"x": 1}}}, {"k": {"a": {"y": 2}}}, id="Nested merge"),
+            pytest.param({"k": {"c": 3}}, {"k": 5}, id="Object replaced by a value"),
+            pytest.param({"k": 5}, {"k": 6}, id="Value replaced by a value"),
+        ],
+    )
+    def test_equivalent(self, first, second):
+        original = {"k": {"a": 1}, "b": {"x": 1}}
+        applied_in_turn = copy.deepcopy(original)
+        pipeline_stages_iothub.apply_merge_patch(applied_in_turn, first)
+        pipeline_stages_iothub.apply_merge_patch(applied_in_turn, second)
+
+        combined = pipeline_stages_iothub.combine_merge_patches(first, second)
+        applied_combined = copy.deepcopy(original)
+        pipeline_stages_iothub.apply_merge_patch(applied_combined, combined)
+
+        assert applied_combined == applied_in_turn
+
+    @pytest.mark.it(
+        "Raises ValueError if the first patch sets a key to a value that isn't an object, and the second merges an object into it"
+    )
+    @pytest.mark.parametrize(
+        "value",
+        [
+            pytest.param(None, id="None"),
+            pytest.param(5, id="Integer"),
+            pytest.param("x", id="String"),
+            pytest.param([1], id="List"),
+        ],
+    )
+    def test_replaced_then_merged(self, value):
+        with pytest.raises(ValueError):
+            pipeline_stages_iothub.combine_merge_patches({"k": value}, {"k": {"c": 3}})
+
+    @pytest.mark.it("Does not modify either patch")
+    def test_no_modification(self):
+        first = {"a": {"b": 1}}
+        second = {"a": {"c": 2}}
+
+        combined = pipeline_stages_iothub.combine_merge_patches(first, second)
+
+        assert combined == {"a": {"b": 1, "c": 2}}
+        assert first == {"a": {"b": 1}}
+        assert second == {"a": {"c": 2}}
+
+
+#########################################
+# REPORTED PROPERTIES COALESCING STAGE #
+#########################################
+
+
+@pytest.fixture
+def mock_alarm(mocker):
+    return mocker.patch.object(alarm, "schedule")
+
+
+class ReportedPropertiesCoalescingStageTestConfig(object):
+    @pytest.fixture
+    def cls_type(self):
+        return pipeline_stages_iothub.ReportedPropertiesCoalescingStage
+
+    @pytest.fixture
+    def init_kwargs(self):
+        return {}
+
+    @pytest.fixture
+    def pl_config(self, mocker):
+        pl_cfg = mocker.MagicMock()
+        pl_cfg.reported_patch_coalesce_window = 0.1
+        return pl_cfg
+
+    @pytest.fixture
+    def stage(self, mocker, pl_config, cls_type, init_kwargs):
+        stage = cls_type(**init_kwargs)
+        stage.pipeline_root = pipeline_stages_base.PipelineRootStage(
+            pipeline_configuration=pl_config
+        )
+        stage.send_op_down = mocker.MagicMock()
+        stage.send_event_up = mocker.MagicMock()
+        return stage
+
+
+class ReportedPropertiesCoalescingStageInstantiationTests(
+    ReportedPropertiesCoalescingStageTestConfig
+):
+    @pytest.mark.it("Initializes 'pending_patch' as None")
+    def test_pending_patch(self, init_kwargs):
+        stage = pipeline_stages_iothub.ReportedPropertiesCoalescingStage(**init_kwargs)
+        assert stage.pending_patch is None
+
+    @pytest.mark.it("Initializes 'pending_ops' as an empty list")
+    def test_pending_ops(self, init_kwargs):
+        stage = pipeline_stages_iothub.ReportedPropertiesCoalescingStage(**init_kwargs)
+        assert stage.pending_ops == []
+
+    @pytest.mark.it("Initializes 'coalesce_alarm' as None")
+    def test_coalesce_alarm(self, init_kwargs):
+        stage = pipeline_stages_iothub.ReportedPropertiesCoalescingStage(**init_kwargs)
+        assert stage.coalesce_alarm is None
+
+
+pipeline_stage_test.add_base_pipeline_stage_tests(
+    test_module=this_module,
+    stage_class_under_test=pipeline_stages_iothub.ReportedPropertiesCoalescingStage,
+    stage_test_config_class=ReportedPropertiesCoalescingStageTestConfig,
+    extended_stage_instantiation_test_class=ReportedPropertiesCoalescingStageInstantiationTests,
+)
+
+
+@pytest.mark.describe(
+    "ReportedPropertiesCoalescingStage - .run_op() -- Called with PatchTwinReportedPropertiesOperation"
+)
+class TestReportedPropertiesCoalescingStageRunOpWithPatchOperation(
+    StageRunOpTestBase, ReportedPropertiesCoalescingStageTestConfig
+):
+    @pytest.fixture
+    def op(self, mocker):
+        return pipeline_ops_iothub.PatchTwinReportedPropertiesOperation(
+            patch={"a": 1, "b": {"c": 2}}, callback=mocker.MagicMock()
+        )
+
+    @pytest.fixture
+    def second_op(self, mocker):
+        return pipeline_ops_iothub.PatchTwinReportedPropertiesOperation(
+            patch={"b": {"d": 3}, "e": None}, callback=mocker.MagicMock()
+        )
+
+    @pytest.mark.it("Sends the op down if the reported_patch_coalesce_window option is 0")
+    def test_coalescing_disabled(self, mocker, stage, pl_config, op, mock_alarm):
+        pl_config.reported_patch_coalesce_window = 0
+        stage.run_op(op)
+        assert stage.send_op_down.call_count == 1
+        assert stage.send_op_down.call_args == mocker.call(op)
+        assert mock_alarm.call_count == 0
+
+    @pytest.mark.it(
+        "Holds the op and schedules an alarm for the end of the coalesce window if no patch is pending"
+    )
+    def test_starts_window(self, mocker, stage, pl_config, op, mock_alarm):
+        mocker.patch.object(time, "time", return_value=1000.0)
+        stage.run_op(op)
+        assert stage.send_op_down.call_count == 0
+        assert not op.completed
+        assert stage.pending_ops == [op]
+        assert stage.pending_patch == op.patch
+        assert mock_alarm.call_count == 1
+        assert mock_alarm.call_args[0][0] == 1000.0 + pl_config.reported_patch_coalesce_window
+        assert stage.coalesce_alarm is mock_alarm.return_value
+
+    @pytest.mark.it("Merges the op's patch into the pending patch if a patch is pending")
+    def test_merges(self, stage, op, second_op, mock_alarm):
+        stage.run_op(op)
+        stage.run_op(second_op)
+        assert stage.send_op_down.call_count == 0
+        assert stage.pending_ops == [op, second_op]
+        assert stage.pending_patch == {"a": 1, "b": {"c": 2, "d": 3}, "e": None}
+        assert mock_alarm.call_count == 1
+
+    @pytest.mark.it(
+        "Sends the pending patch down and starts a new window if the op's patch conflicts with the pending patch"
+    )
+    @pytest.mark.parametrize(
+        "value", [pytest.param(None, id="Key removed"), pytest.param(5, id="Key set to a value")]
+    )
+    def test_conflict(self, mocker, stage, op, mock_alarm, value):
+        stage.run_op(op)
+        removal_op = pipeline_ops_iothub.PatchTwinReportedPropertiesOperation(
+            patch={"x": value}, callback=mocker.MagicMock()
+        )
+        stage.run_op(removal_op)
+        conflicting_op = pipeline_ops_iothub.PatchTwinReportedPropertiesOperation(
+            patch={"x": {"y": 1}}, callback=mocker.MagicMock()
+        )
+        stage.run_op(conflicting_op)
+
+        assert stage.send_op_down.call_count == 1
+        sent_op = stage.send_op_down.call_args[0][0]
+        assert sent_op.patch == {"a": 1, "b": {"c": 2}, "x": value}
+        assert stage.pending_ops == [conflicting_op]
+        assert stage.pending_patch == {"x": {"y": 1}}
+        assert mock_alarm.return_value.cancel.call_count == 1
+        assert mock_alarm.call_count == 2
+
+    @pytest.mark.it(
+        "Sends the pending patch down, followed by the op, if the op's patch is not a JSON object"
+    )
+    def test_non_dict_patch(self, mocker, stage, op):
+        stage.run_op(op)
+        non_dict_op = pipeline_ops_iothub.PatchTwinReportedPropertiesOperation(
+            patch="some_string", callback=mocker.MagicMock()
+        )
+        stage.run_op(non_dict_op)
+
+        assert stage.send_op_down.call_count == 2
+        assert stage.send_op_down.call_args_list[0][0][0].patch == op.patch
+        assert stage.send_op_down.call_args_list[1] == mocker.call(non_dict_op)
+        assert stage.pending_patch is None
+        assert stage.pending_ops == []
+
+    @pytest.mark.it("Does not modify the patches of the ops being merged")
+    def test_patches_unmodified(self, stage, op, second_op):
+        stage.run_op(op)
+        stage.run_op(second_op)
+        assert op.patch == {"a": 1, "b": {"c": 2}}
+        assert second_op.patch == {"b": {"d": 3}, "e": None}
+
+
+@pytest.mark.describe(
+    "ReportedPropertiesCoalescingStage - .run_op() -- Called with ShutdownPipelineOperation"
+)
+class TestReportedPropertiesCoalescingStageRunOpWithShutdownOperation(
+    StageRunOpTestBase, ReportedPropertiesCoalescingStageTestConfig
+):
+    @pytest.fixture
+    def op(self, mocker):
+        return pipeline_ops_base.ShutdownPipelineOperation(callback=mocker.MagicMock())
+
+    @pytest.mark.it("Sends any pending patch down before sending the op down")
+    def test_flushes(self, mocker, stage, op, mock_alarm):
+        patch_op = pipeline_ops_iothub.PatchTwinReportedPropertiesOperation(
+            patch={"a": 1}, callback=mocker.MagicMock()
+        )
+        stage.run_op(patch_op)
+        stage.run_op(op)
+        assert stage.send_op_down.call_count == 2
+        assert stage.send_op_down.call_args_list[0][0][0].patch == {"a": 1}
+        assert stage.send_op_down.call_args_list[1] == mocker.call(op)
+        assert mock_alarm.return_value.cancel.call_count == 1
+
+    @pytest.mark.it("Sends the op down if there is no pending patch")
+    def test_no_pending(self, mocker, stage, op):
+        stage.run_op(op)
+        assert stage.send_op_down.call_count == 1
+        assert stage.send_op_down.call_args == mocker.call(op)
+
+
+@pytest.mark.describe(
+    "ReportedPropertiesCoalescingStage - .run_op() -- Called with other arbitrary operation"
+)
+class TestReportedPropertiesCoalescingStageRunOpWithArbitraryOperation(
+    StageRunOpTestBase, ReportedPropertiesCoalescingStageTestConfig
+):
+    @pytest.fixture
+    def op(self, arbitrary_op):
+        return arbitrary_op
+
+    @pytest.mark.it("Sends the operation down the pipeline")
+    def test_sends_op_down(self, mocker, stage, op):
+        stage.run_op(op)
+        assert stage.send_op_down.call_count == 1
+        assert stage.send_op_down.call_args == mocker.call(op)
+
+
+@pytest.mark.describe("ReportedPropertiesCoalescingStage - OCCURANCE: Coalesce alarm fires")
+class TestReportedPropertiesCoalescingStageOCCURANCECoalesceAlarmFires(
+    ReportedPropertiesCoalescingStageTestConfig
+):
+    @pytest.fixture
+    def ops(self, mocker):
+        return [
+            pipeline_ops_iothub.PatchTwinReportedPropertiesOperation(
+                patch={"a": 1}, callback=mocker.MagicMock()
+            ),
+            pipeline_ops_iothub.PatchTwinReportedPropertiesOperation(
+                patch={"a": None, "b": 2}, callback=mocker.MagicMock()
+            ),
+        ]
+
+    @pytest.fixture
+    def expired_stage(self, stage, ops, mock_alarm):
+        for op in ops:
+            stage.run_op(op)
+        on_alarm = mock_alarm.call_args[0][1]
+        on_alarm()
+        return stage
+
+    @pytest.mark.it(
+        "Sends a single PatchTwinReportedPropertiesOperation down with the merged patch"
+    )
+    def test_sends_merged_patch(self, expired_stage):
+        assert expired_stage.send_op_down.call_count == 1
+        sent_op = expired_stage.send_op_down.call_args[0][0]
+        assert isinstance(sent_op, pipeline_ops_iothub.PatchTwinReportedPropertiesOperation)
+        assert sent_op.patch == {"a": None, "b": 2}
+        assert expired_stage.pending_patch is None
+        assert expired_stage.pending_ops == []
+        assert expired_stage.coalesce_alarm is None
+
+    @pytest.mark.it("Gives the sent op the latest deadline of the merged ops")
+    def test_deadline(self, stage, ops, mock_alarm):
+        ops[0].deadline = time.time() + 60
+        ops[1].deadline = time.time() + 120
+        for op in ops:
+            stage.run_op(op)
+        mock_alarm.call_args[0][1]()
+
+        sent_op = stage.send_op_down.call_args[0][0]
+        assert sent_op.deadline == ops[1].deadline
+
+    @pytest.mark.it("Gives the sent op no deadline if any of the merged ops has no deadline")
+    def test_no_deadline(self, stage, ops, mock_alarm):
+        ops[0].deadline = time.time() + 60
+        for op in ops:
+            stage.run_op(op)
+        mock_alarm.call_args[0][1]()
+
+        sent_op = stage.send_op_down.call_args[0][0]
+        assert sent_op.deadline is None
+
+    @pytest.mark.it("Completes all merged ops successfully when the sent op completes successfully")
+    def test_complete_success(self, expired_stage, ops):
+        sent_op = expired_stage.send_op_down.call_args[0][0]
+        for op in ops:
+            assert not op.completed
+        sent_op.complete()
+        for op in ops:
+            assert op.completed
+            assert op.error is None
+
+    @pytest.mark.it(
+        "Completes all merged ops with the same error when the sent op completes with an error"
+    )
+    def test_complete_error(self, expired_stage, ops, arbitrary_exception):
+        sent_op = expired_stage.send_op_down.call_args[0][0]
+        sent_op.complete(error=arbitrary_exception)
+        for op in ops:
+            assert op.completed
+            assert op.error is arbitrary_exception
+
+
+####################
+# TWIN CACHE STAGE #
+####################
+
+
+class TwinCacheStageTestConfig(object):
+    @pytest.fixture
+    def cls_type(self):
+        return pipeline_stages_iothub.TwinCacheStage
+
+    @pytest.fixture
+    def init_kwargs(self):
+        return {}
+
+    @pytest.fixture
+    def pl_config(self, mocker):
+        pl_cfg = mocker.MagicMock()
+        pl_cfg.twin_cache = True
+        return pl_cfg
+
+    @pytest.fixture
+    def stage(self, mocker, pl_config, cls_type, init_kwargs):
+        stage = cls_type(**init_kwargs)
+        stage.pipeline_root = pipeline_stages_base.PipelineRootStage(
+            pipeline_configuration=pl_config
+        )
+        stage.pipeline_root.connected = True
+        stage.send_op_down = mocker.MagicMock()
+        stage.send_event_up = mocker.MagicMock()
+        return stage
+
+    @pytest.fixture
+    def twin(self):
+        return {
+            "desired": {"$version": 5, "foo": 1, "bar": {"baz": 2}},
+            "reported": {"$version": 3, "status": "ok"},
+        }
+
+    @pytest.fixture
+    def cached_stage(self, mocker, stage, twin):
+        """A stage with twin patches enabled and a twin in the cache"""
+        enable_op = pipeline_ops_base.EnableFeatureOperation(
+            feature_name=pipeline_constants.TWIN_PATCHES, callback=mocker.MagicMock()
+        )
+        stage.run_op(enable_op)
+        enable_op.complete()
+        get_op = pipeline_ops_iothub.GetTwinOperation(callback=mocker.MagicMock())
+        stage.run_op(get_op)
+        get_op.twin = twin
+        get_op.complete()
+        stage.send_op_down.reset_mock()
+        return stage
+
+
+class TwinCacheStageInstantiationTests(TwinCacheStageTestConfig):
+    @pytest.mark.it("Initializes 'twin' as None")
+    def test_twin(self, init_kwargs):
+        stage = pipeline_stages_iothub.TwinCacheStage(**init_kwargs)
+        assert stage.twin is None
+
+    @pytest.mark.it("Initializes 'stale' as True")
+    def test_stale(self, init_kwargs):
+        stage = pipeline_stages_iothub.TwinCacheStage(**init_kwargs)
+        assert stage.stale is True
+
+    @pytest.mark.it("Initializes 'reported_patched_during_get' as False")
+    def test_reported_patched_during_get(self, init_kwargs):
+        stage = pipeline_stages_iothub.TwinCacheStage(**init_kwargs)
+        assert stage.reported_patched_during_get is False
+
+
+pipeline_stage_test.add_base_pipeline_stage_tests(
+    test_module=this_module,
+    stage_class_under_test=pipeline_stages_iothub.TwinCacheStage,
+    stage_test_config_class=TwinCacheStageTestConfig,
+    extended_stage_instantiation_test_class=TwinCacheStageInstantiationTests,
+)
+
+
+@pytest.mark.describe("TwinCacheStage - .run_op() -- Called with GetTwinOperation")
+class TestTwinCacheStageRunOpWithGetTwinOperation(StageRunOpTestBase, TwinCacheStageTestConfig):
+    @pytest.fixture
+    def op(self, mocker):
+        return pipeline_ops_iothub.GetTwinOperation(callback=mocker.MagicMock())
+
+    @pytest.mark.it("Sends the op down if the twin_cache option is not enabled")
+    def test_cache_disabled(self, mocker, cached_stage, pl_config, op):
+        pl_config.twin_cache = False
+        cached_stage.run_op(op)
+        assert cached_stage.send_op_down.call_count == 1
+        assert cached_stage.send_op_down.call_args == mocker.call(op)
+
+    @pytest.mark.it("Sends the op down if there is no cached twin")
+    def test_no_cached_twin(self, mocker, stage, op):
+        stage.run_op(op)
+        assert stage.send_op_down.call_count == 1
+        assert stage.send_op_down.call_args == mocker.call(op)
+
+    @pytest.mark.it("Completes the op with a copy of the cached twin if the cache is fresh")
+    def test_fresh_cache(self, cached_stage, op, twin):
+        cached_stage.run_op(op)
+        assert cached_stage.send_op_down.call_count == 0
+        assert op.completed
+        assert op.error is None
+        assert op.twin == twin
+        assert op.twin is not cached_stage.twin
+
+    @pytest.mark.it("Sends the op down if the pipeline is not connected")
+    def test_not_connected(self, cached_stage, op):
+        cached_stage.pipeline_root.connected = False
+        cached_stage.run_op(op)
+        assert cached_stage.send_op_down.call_count == 1
+        assert not op.completed
+
+    @pytest.mark.it("Sends the op down if twin patches are not enabled")
+    def test_patches_not_enabled(self, mocker, cached_stage, op):
+        disable_op = pipeline_ops_base.DisableFeatureOperation(
+            feature_name=pipeline_constants.TWIN_PATCHES, callback=mocker.MagicMock()
+        )
+        cached_stage.run_op(disable_op)
+        cached_stage.send_op_down.reset_mock()
+
+        cached_stage.run_op(op)
+        assert cached_stage.send_op_down.call_count == 1
+        assert not op.completed
+
+    @pytest.mark.it("Stores the twin returned by the service when the op completes successfully")
+    def test_stores_twin(self, stage, op, twin):
+        stage.run_op(op)
+        op.twin = twin
+        op.complete()
+        assert stage.twin == twin
+        assert stage.stale is False
+
+    @pytest.mark.it("Does not store anything if the op completes with an error")
+    def test_error(self, stage, op, arbitrary_exception):
+        stage.run_op(op)
+        op.complete(error=arbitrary_exception)
+        assert stage.twin is None
+        assert stage.stale is True
+
+
+@pytest.mark.describe(
+    "TwinCacheStage - .run_op() -- Called with PatchTwinReportedPropertiesOperation"
+)
+class TestTwinCacheStageRunOpWithPatchTwinReportedPropertiesOperation(
+    StageRunOpTestBase, TwinCacheStageTestConfig
+):
+    @pytest.fixture
+    def op(self, mocker):
+        return pipeline_ops_iothub.PatchTwinReportedPropertiesOperation(
+            patch={"status": None, "temp": 20}, callback=mocker.MagicMock()
+        )
+
+    @pytest.mark.it("Sends the op down")
+    def test_sends_down(self, mocker, cached_stage, op):
+        cached_stage.run_op(op)
+        assert cached_stage.send_op_down.call_count == 1
+        assert cached_stage.send_op_down.call_args == mocker.call(op)
+
+    @pytest.mark.it(
+        "Marks the cache stale, so that the next GetTwinOperation is sent to the service"
+    )
+    def test_marks_stale(self, mocker, cached_stage, op):
+        cached_stage.run_op(op)
+        assert cached_stage.stale is True
+
+        get_op = pipeline_ops_iothub.GetTwinOperation(callback=mocker.MagicMock())
+        cached_stage.run_op(get_op)
+        assert cached_stage.send_op_down.call_count == 2
+        assert cached_stage.send_op_down.call_args == mocker.call(get_op)
+
+    @pytest.mark.it(
+        "Does not change the cached reported properties, whose $version and $metadata are assigned by the service"
+    )
+    def test_reported_unchanged(self, cached_stage, op, twin):
+        cached_stage.run_op(op)
+        op.complete()
+        assert cached_stage.twin["reported"] == twin["reported"]
+
+    @pytest.mark.it("Leaves the cache stale when the op completes")
+    @pytest.mark.parametrize(
+        "error", [pytest.param(False, id="Success"), pytest.param(True, id="Error")]
+    )
+    def test_complete(self, cached_stage, op, arbitrary_exception, error):
+        cached_stage.run_op(op)
+        op.complete(error=arbitrary_exception if error else None)
+        assert cached_stage.stale is True
+
+    @pytest.mark.it(
+        "Leaves the cache stale after a GetTwinOperation that was in flight when the op was sent or completed"
+    )
+    @pytest.mark.parametrize(
+        "complete_patch_during_get",
+        [pytest.param(False, id="Sent during GET"), pytest.param(True, id="Completed during GET")],
+    )
+    def test_during_get(self, mocker, cached_stage, op, twin, complete_patch_during_get):
+        if complete_patch_during_get:
+            cached_stage.run_op(op)
+        get_op = pipeline_ops_iothub.GetTwinOperation(callback=mocker.MagicMock())
+        cached_stage.run_op(get_op)
+        if complete_patch_during_get:
+            op.complete()
+        else:
+            cached_stage.run_op(op)
+        # The GET response may have been generated before the patch was applied
+        get_op.twin = twin
+        get_op.complete()
+        assert cached_stage.stale is True
+
+        # The next GET refreshes the cache
+        get_op = pipeline_ops_iothub.GetTwinOperation(callback=mocker.MagicMock())
+        cached_stage.run_op(get_op)
+        get_op.twin = twin
+        get_op.complete()
+        assert cached_stage.stale is False
+
+
+@pytest.mark.describe("TwinCacheStage - .run_op() -- Called with other arbitrary operation")
+class TestTwinCacheStageRunOpWithArbitraryOperation(StageRunOpTestBase, TwinCacheStageTestConfig):
+    @pytest.fixture
+    def op(self, arbitrary_op):
+        return arbitrary_op
+
+    @pytest.mark.it("Sends the operation down the pipeline")
+    def test_sends_op_down(self, mocker, stage, op):
+        stage.run_op(op)
+        assert stage.send_op_down.call_count == 1
+        assert stage.send_op_down.call_args == mocker.call(op)
+
+
+@pytest.mark.describe("TwinCacheStage - OCCURANCE: TwinDesiredPropertiesPatchEvent received")
+class TestTwinCacheStageWhenTwinDesiredPropertiesPatchEventReceived(
+    TwinCacheStageTestConfig, StageHandlePipelineEventTestBase
+):
+    @pytest.fixture
+    def event(self):
+        return pipeline_events_iothub.TwinDesiredPropertiesPatchEvent(
+            patch={"$version": 6, "foo": None, "bar": {"qux": 3}}
+        )
+
+    @pytest.mark.it("Applies the next patch in sequence to the cached desired properties")
+    def test_applies_patch(self, cached_stage, event):
+        cached_stage.handle_pipeline_event(event)
+        assert cached_stage.twin["desired"] == {"$version": 6, "bar": {"baz": 2, "qux": 3}}
+        assert cached_stage.stale is False
+
+    @pytest.mark.it("Ignores a patch whose $version is already included in the cached twin")
+    def test_ignores_old_patch(self, cached_stage, event, twin):
+        event.patch["$version"] = 5
+        cached_stage.handle_pipeline_event(event)
+        assert cached_stage.twin == twin
+        assert cached_stage.stale is False
+
+    @pytest.mark.it("Marks the cache stale if there is a gap in $version values")
+    def test_gap(self, cached_stage, event):
+        event.patch["$version"] = 8
+        cached_stage.handle_pipeline_event(event)
+        assert cached_stage.stale is True
+
+    @pytest.mark.it(
+        "Applies patches received while a GET is pending on top of the GET response, if they are newer"
+    )
+    def test_patch_during_get(self, mocker, stage, event, twin):
+        get_op = pipeline_ops_iothub.GetTwinOperation(callback=mocker.MagicMock())
+        stage.run_op(get_op)
+        stage.handle_pipeline_event(event)
+        get_op.twin = twin
+        get_op.complete()
+        assert stage.twin["desired"]["$version"] == 6
+        assert "foo" not in stage.twin["desired"]
+
+    @pytest.mark.it("Sends the event to the previous stage")
+    def test_sends_event_up(self, mocker, stage, event):
+        stage.handle_pipeline_event(event)
+        assert stage.send_event_up.call_count == 1
+        assert stage.send_event_up.call_args == mocker.call(event)
+
+
+@pytest.mark.describe("TwinCacheStage - OCCURANCE: DisconnectedEvent received")
+class TestTwinCacheStageWhenDisconnectedEventReceived(
+    TwinCacheStageTestConfig, StageHandlePipelineEventTestBase
+):
+    @pytest.fixture
+    def event(self):
+        return pipeline_events_base.DisconnectedEvent()
+
+    @pytest.mark.it("Marks the cache stale")
+    def test_marks_stale(self, cached_stage, event):
+        cached_stage.handle_pipeline_event(event)
+        assert cached_stage.stale is True
+
+    @pytest.mark.it("Sends the event to the previous stage")
+    def test_sends_event_up(self, mocker, stage, event):
+        stage.handle_pipeline_event(event)
+        assert stage.send_event_up.call_count == 1
+        assert stage.send_event_up.call_args == mocker.call(event)
+
+
 ###############################
 # TWIN REQUEST RESPONSE STAGE #
 ###############################
@@ -464,6 +1305,14 @@ class TestTwinRequestResponseStageRunOpWithGetTwinOperation(
         assert new_op.resource_location == "/"
         assert new_op.request_body == " "
 
+    @pytest.mark.it("Gives the RequestAndResponseOperation the same deadline as the operation")
+    def test_request_and_response_op_deadline(self, mocker, stage, op):
+        op.deadline = time.time() + 60
+        stage.run_op(op)
+
+        new_op = stage.send_op_down.call_args[0][0]
+        assert new_op.deadline == op.deadline
+
 
 @pytest.mark.describe(
     "TwinRequestResponseStage - .run_op() -- Called with PatchTwinReportedPropertiesOperation"
@@ -500,7 +1349,15 @@ class TestTwinRequestResponseStageRunOpWithPatchTwinReportedPropertiesOperation(
         assert new_op.request_type == "twin"
         assert new_op.method == "PATCH"
         assert new_op.resource_location == "/properties/reported/"
-        assert new_op.request_body == json.dumps(op.patch)
+        assert json.loads(new_op.request_body.decode("utf-8")) == op.patch
+
+    @pytest.mark.it("Gives the RequestAndResponseOperation the same deadline as the operation")
+    def test_request_and_response_op_deadline(self, mocker, stage, op):
+        op.deadline = time.time() + 60
+        stage.run_op(op)
+
+        new_op = stage.send_op_down.call_args[0][0]
+        assert new_op.deadline == op.deadline
 
 
 @pytest.mark.describe(
@@ -7,6 +7,7 @@ import logging
 import pytest
 import json
 import sys
+import time
 import six.moves.urllib as urllib
 from azure.iot.device.common.pipeline import pipeline_stages_base, pipeline_ops_http
 from azure.iot.device.iothub.pipeline import (
@@ -133,6 +134,14 @@ class TestIoTHubHTTPTranslationStageRunOpCalledWithMethodInvokeOperation(
         new_op = stage.send_op_down.call_args[0][0]
         assert isinstance(new_op, pipeline_ops_http.HTTPRequestAndResponseOperation)
 
+    @pytest.mark.it("Gives the HTTPRequestAndResponseOperation the same deadline as the operation")
+    def test_deadline(self, mocker, stage, op):
+        op.deadline = time.time() + 60
+        stage.run_op(op)
+
+        new_op = stage.send_op_down.call_args[0][0]
+        assert new_op.deadline == op.deadline
+
     @pytest.mark.it(
         "Configures the HTTPRequestAndResponseOperation with request details for sending a Method Invoke request"
     )
@@ -202,7 +211,7 @@ class TestIoTHubHTTPTranslationStageRunOpCalledWithMethodInvokeOperation(
         assert isinstance(new_op, pipeline_ops_http.HTTPRequestAndResponseOperation)
 
         # Validate body
-        assert new_op.body == json.dumps(op.method_params)
+        assert json.loads(new_op.body.decode("utf-8")) == op.method_params
 
     @pytest.mark.it(
         "Completes the original MethodInvokeOperation op (no error) if the new HTTPRequestAndResponseOperation op is completed later on (no error) with a status code indicating success"
@@ -361,6 +370,14 @@ class TestIoTHubHTTPTranslationStageRunOpCalledWithGetStorageInfoOperation(
         new_op = stage.send_op_down.call_args[0][0]
         assert isinstance(new_op, pipeline_ops_http.HTTPRequestAndResponseOperation)
 
+    @pytest.mark.it("Gives the HTTPRequestAndResponseOperation the same deadline as the operation")
+    def test_deadline(self, mocker, stage, op):
+        op.deadline = time.time() + 60
+        stage.run_op(op)
+
+        new_op = stage.send_op_down.call_args[0][0]
+        assert new_op.deadline == op.deadline
+
     @pytest.mark.it(
         "Configures the HTTPRequestAndResponseOperation with request details for sending a Get Storage Info request"
     )
@@ -431,7 +448,7 @@ class TestIoTHubHTTPTranslationStageRunOpCalledWithGetStorageInfoOperation(
         assert isinstance(new_op, pipeline_ops_http.HTTPRequestAndResponseOperation)
 
         # Validate body
-        assert new_op.body == '{{"blobName": "{}"}}'.format(op.blob_name)
+        assert json.loads(new_op.body.decode("utf-8")) == {"blobName": op.blob_name}
 
     @pytest.mark.it(
         "Completes the original GetStorageInfoOperation op (no error) if the new HTTPRequestAndResponseOperation is completed later on (no error) with a status code indicating success"
@@ -591,6 +608,14 @@ class TestIoTHubHTTPTranslationStageRunOpCalledWithNotifyBlobUploadStatusOperati
         new_op = stage.send_op_down.call_args[0][0]
         assert isinstance(new_op, pipeline_ops_http.HTTPRequestAndResponseOperation)
 
+    @pytest.mark.it("Gives the HTTPRequestAndResponseOperation the same deadline as the operation")
+    def test_deadline(self, mocker, stage, op):
+        op.deadline = time.time() + 60
+        stage.run_op(op)
+
+        new_op = stage.send_op_down.call_args[0][0]
+        assert new_op.deadline == op.deadline
+
     @pytest.mark.it(
         "Configures the HTTPRequestAndResponseOperation with request details for sending a Notify Blob Upload Status request"
     )
@@ -666,7 +691,7 @@ class TestIoTHubHTTPTranslationStageRunOpCalledWithNotifyBlobUploadStatusOperati
             "statusCode": op.request_status_code,
             "statusDescription": op.status_description,
         }
-        assert new_op.body == json.dumps(header_dict)
+        assert json.loads(new_op.body.decode("utf-8")) == header_dict
 
     @pytest.mark.it(
         "Completes the original NotifyBlobUploadStatusOperation op (no error) if the new HTTPRequestAndResponseOperation is completed later on (no error) with a status code indicating success"
@@ -493,19 +493,17 @@ class TestIoTHubMQTTTranslationStageWithSendMethodResponseOperation(
         )
 
     @pytest.mark.it(
-        "Sends a new MQTTPublishOperation down the pipeline with the original op's payload in JSON string format, and the derived topic string"
+        "Sends a new MQTTPublishOperation down the pipeline with the original op's payload in UTF-8 encoded JSON format, and the derived topic string"
     )
     @pytest.mark.parametrize(
-        "payload, expected_string",
+        "payload",
         [
-            pytest.param(None, "null", id="No payload"),
-            pytest.param({"some": "json"}, '{"some": "json"}', id="Dictionary payload"),
-            pytest.param("payload", '"payload"', id="String payload"),
+            pytest.param(None, id="No payload"),
+            pytest.param({"some": "json"}, id="Dictionary payload"),
+            pytest.param("payload", id="String payload"),
         ],
     )
-    def test_sends_mqtt_publish_op_down(
-        self, mocker, stage, op, mock_mqtt_topic, payload, expected_string
-    ):
+    def test_sends_mqtt_publish_op_down(self, mocker, stage, op, mock_mqtt_topic, payload):
         op.method_response.payload = payload
         stage.run_op(op)
 
@@ -513,7 +511,8 @@ class TestIoTHubMQTTTranslationStageWithSendMethodResponseOperation(
         new_op = stage.send_op_down.call_args[0][0]
         assert isinstance(new_op, pipeline_ops_mqtt.MQTTPublishOperation)
         assert new_op.topic == mock_mqtt_topic.get_method_topic_for_publish.return_value
-        assert new_op.payload == expected_string
+        assert isinstance(new_op.payload, bytes)
+        assert json.loads(new_op.payload.decode("utf-8")) == payload
 
     @pytest.mark.it("Completes the original op upon completion of the new MQTTPublishOperation")
     def test_complete_resulting_op(self, stage, op, op_error):
@@ -13,10 +13,12 @@ import io
 import six
 import socks
 import time
+import threading
 import six.moves.urllib as urllib
 from azure.iot.device.common import auth
 from azure.iot.device.common.auth import sastoken as st
 from azure.iot.device.common.auth import connection_string as cs
+from azure.iot.device.common.flow_control import FlowControl
 from azure.iot.device.iothub.pipeline import IoTHubPipelineConfig
 from azure.iot.device.common.pipeline.config import DEFAULT_KEEPALIVE
 from azure.iot.device.iothub.abstract_clients import (
@@ -269,6 +271,139 @@ class SharedIoTHubClientCreateMethodUserOptionTests(object):
 
         assert config.auto_connect == auto_connect_value
 
+    @pytest.mark.it(
+        "Sets the 'twin_cache' user option parameter on the PipelineConfig, if provided"
+    )
+    def test_twin_cache_option(
+        self,
+        option_test_required_patching,
+        client_create_method,
+        create_method_args,
+        mock_mqtt_pipeline_init,
+        mock_http_pipeline_init,
+    ):
+        client_create_method(*create_method_args, twin_cache=True)
+
+        # Get configuration object, and ensure it was used for both protocol pipelines
+        assert mock_mqtt_pipeline_init.call_count == 1
+        config = mock_mqtt_pipeline_init.call_args[0][0]
+        assert isinstance(config, IoTHubPipelineConfig)
+        assert config == mock_http_pipeline_init.call_args[0][0]
+
+        assert config.twin_cache is True
+
+    @pytest.mark.it(
+        "Sets the 'reported_patch_coalesce_window' user option parameter on the PipelineConfig, if provided"
+    )
+    def test_reported_patch_coalesce_window_option(
+        self,
+        option_test_required_patching,
+        client_create_method,
+        create_method_args,
+        mock_mqtt_pipeline_init,
+        mock_http_pipeline_init,
+    ):
+        client_create_method(*create_method_args, reported_patch_coalesce_window=0.25)
+
+        # Get configuration object, and ensure it was used for both protocol pipelines
+        assert mock_mqtt_pipeline_init.call_count == 1
+        config = mock_mqtt_pipeline_init.call_args[0][0]
+        assert isinstance(config, IoTHubPipelineConfig)
+        assert config == mock_http_pipeline_init.call_args[0][0]
+
+        assert config.reported_patch_coalesce_window == 0.25
+
+    @pytest.mark.it(
+        "Sets the 'pending_bytes_high_watermark' and 'pending_bytes_low_watermark' user option parameters on the PipelineConfig, if provided"
+    )
+    def test_pending_bytes_watermark_options(
+        self,
+        option_test_required_patching,
+        client_create_method,
+        create_method_args,
+        mock_mqtt_pipeline_init,
+        mock_http_pipeline_init,
+    ):
+        client_create_method(
+            *create_method_args,
+            pending_bytes_high_watermark=1000000,
+            pending_bytes_low_watermark=500000
+        )
+
+        # Get configuration object, and ensure it was used for both protocol pipelines
+        assert mock_mqtt_pipeline_init.call_count == 1
+        config = mock_mqtt_pipeline_init.call_args[0][0]
+        assert isinstance(config, IoTHubPipelineConfig)
+        assert config == mock_http_pipeline_init.call_args[0][0]
+
+        assert config.pending_bytes_high_watermark == 1000000
+        assert config.pending_bytes_low_watermark == 500000
+
+    @pytest.mark.it(
+        "Sets the 'network_loop' user option parameter on the PipelineConfig, if provided"
+    )
+    def test_network_loop_option(
+        self,
+        mocker,
+        option_test_required_patching,
+        client_create_method,
+        create_method_args,
+        mock_mqtt_pipeline_init,
+        mock_http_pipeline_init,
+    ):
+        network_loop = mocker.MagicMock()
+        client_create_method(*create_method_args, network_loop=network_loop)
+
+        # Get configuration object, and ensure it was used for both protocol pipelines
+        assert mock_mqtt_pipeline_init.call_count == 1
+        config = mock_mqtt_pipeline_init.call_args[0][0]
+        assert isinstance(config, IoTHubPipelineConfig)
+        assert config == mock_http_pipeline_init.call_args[0][0]
+
+        assert config.network_loop is network_loop
+
+    @pytest.mark.it(
+        "Sets the 'adaptive_keep_alive' user option parameter on the PipelineConfig, if provided"
+    )
+    def test_adaptive_keep_alive_option(
+        self,
+        option_test_required_patching,
+        client_create_method,
+        create_method_args,
+        mock_mqtt_pipeline_init,
+        mock_http_pipeline_init,
+    ):
+        client_create_method(*create_method_args, adaptive_keep_alive=True)
+
+        # Get configuration object, and ensure it was used for both protocol pipelines
+        assert mock_mqtt_pipeline_init.call_count == 1
+        config = mock_mqtt_pipeline_init.call_args[0][0]
+        assert isinstance(config, IoTHubPipelineConfig)
+        assert config == mock_http_pipeline_init.call_args[0][0]
+
+        assert config.adaptive_keep_alive is True
+
+    @pytest.mark.it(
+        "Sets the 'ack_timeout' user option parameter on the PipelineConfig, if provided"
+    )
+    def test_ack_timeout_option(
+        self,
+        option_test_required_patching,
+        client_create_method,
+        create_method_args,
+        mock_mqtt_pipeline_init,
+        mock_http_pipeline_init,
+    ):
+        client_create_method(*create_method_args, ack_timeout=30)
+
+        # Get configuration object, and ensure it was used for both protocol pipelines
+        assert mock_mqtt_pipeline_init.call_count == 1
+        config = mock_mqtt_pipeline_init.call_args[0][0]
+        assert isinstance(config, IoTHubPipelineConfig)
+        assert config == mock_http_pipeline_init.call_args[0][0]
+
+        assert config.ack_timeout == 30
+
     @pytest.mark.it("Raises a TypeError if an invalid user option parameter is provided")
     def test_invalid_option(
         self, option_test_required_patching, client_create_method, create_method_args
@@ -302,6 +437,13 @@ class SharedIoTHubClientCreateMethodUserOptionTests(object):
         assert config.proxy_options is None
         assert config.server_verification_cert is None
         assert config.keep_alive == DEFAULT_KEEPALIVE
+        assert config.twin_cache is False
+        assert config.reported_patch_coalesce_window == 0
+        assert config.pending_bytes_high_watermark is None
+        assert config.pending_bytes_low_watermark is None
+        assert config.network_loop is None
+        assert config.adaptive_keep_alive is False
+        assert config.ack_timeout is None
 
 
 # TODO: consider splitting this test class up into device/module specific test classes to avoid
@@ -576,6 +718,43 @@ class SharedIoTHubClientPROPERTYConnectedTests(object):
         assert not client.connected
 
 
+class SharedIoTHubClientPROPERTYFlowControlTests(object):
+    @pytest.fixture
+    def flow_control(self, mqtt_pipeline):
+        mqtt_pipeline.flow_control = FlowControl(high_watermark=100, low_watermark=50)
+        return mqtt_pipeline.flow_control
+
+    @pytest.mark.it("Cannot be changed")
+    @pytest.mark.parametrize("property_name", ["pending_ops", "pending_bytes", "has_capacity"])
+    def test_read_only(self, client, flow_control, property_name):
+        with pytest.raises(AttributeError):
+            setattr(client, property_name, getattr(client, property_name))
+
+    @pytest.mark.it(
+        "Reflects the pending ops and bytes, and the capacity, of the MQTTPipeline's flow control"
+    )
+    def test_reflects_flow_control(self, client, flow_control):
+        assert client.pending_ops == 0
+        assert client.pending_bytes == 0
+        assert client.has_capacity
+
+        flow_control.add(60)
+        flow_control.add(60)
+        assert client.pending_ops == 2
+        assert client.pending_bytes == 120
+        assert not client.has_capacity
+
+        flow_control.remove(60)
+        assert client.pending_ops == 1
+        assert client.pending_bytes == 60
+        assert not client.has_capacity
+
+        flow_control.remove(60)
+        assert client.pending_ops == 0
+        assert client.pending_bytes == 0
+        assert client.has_capacity
+
+
 class SharedIoTHubClientOCCURANCEConnectTests(object):
     @pytest.mark.it("Ensures that the HandlerManager is running")
     def test_ensure_handler_manager_running_on_connect(self, client, mocker):
@@ -1192,6 +1371,13 @@ class SharedIoTHubModuleClientClientCreateFromEdgeEnvironmentUserOptionTests(
         assert config.cipher == ""
         assert config.proxy_options is None
         assert config.keep_alive == DEFAULT_KEEPALIVE
+        assert config.twin_cache is False
+        assert config.reported_patch_coalesce_window == 0
+        assert config.pending_bytes_high_watermark is None
+        assert config.pending_bytes_low_watermark is None
+        assert config.network_loop is None
+        assert config.adaptive_keep_alive is False
+        assert config.ack_timeout is None
 
 
 @pytest.mark.usefixtures("mock_mqtt_pipeline_init", "mock_http_pipeline_init")
@@ -1401,6 +1587,51 @@ class SharedIoTHubModuleClientCreateFromEdgeEnvironmentWithContainerEnvTests(
             client_class.create_from_edge_environment()
         assert e_info.value.__cause__ is token_err
 
+    @pytest.mark.it(
+        "Raises OSError if both retrieving the server verification certificate and SasToken creation result in failure"
+    )
+    def test_bad_edge_auth_and_sastoken_failure(
+        self, mocker, client_class, edge_container_environment, mock_edge_hsm
+    ):
+        mocker.patch.dict(os.environ, edge_container_environment, clear=True)
+        my_edge_error = edge_hsm.IoTEdgeError()
+        mock_edge_hsm.return_value.get_certificate.side_effect = my_edge_error
+        sastoken_mock = mocker.patch.object(st, "RenewableSasToken")
+        sastoken_mock.side_effect = st.SasTokenError("Some SasToken failure")
+
+        with pytest.raises(OSError) as e_info:
+            client_class.create_from_edge_environment()
+        assert e_info.value.__cause__ is my_edge_error
+
+    @pytest.mark.it(
+        "Retrieves the server verification certificate in another thread, while the first SasToken is signed"
+    )
+    def test_concurrent_startup(
+        self, mocker, client_class, edge_container_environment, mock_edge_hsm
+    ):
+        mocker.patch.dict(os.environ, edge_container_environment, clear=True)
+        signing = threading.Event()
+        certificate_threads = []
+
+        def get_certificate():
+            certificate_threads.append(threading.current_thread())
+            # The certificate can't be retrieved unless the token is being signed at the same time
+            assert signing.wait(5)
+            return "__FAKE_SERVER_VERIFICATION_CERTIFICATE__"
+
+        def sign(data_str):
+            signing.set()
+            return "8NJRMT83CcplGrAGaUVIUM/md5914KpWVNngSVoF9/M="
+
+        mock_edge_hsm.return_value.get_certificate.side_effect = get_certificate
+        mock_edge_hsm.return_value.sign.side_effect = sign
+
+        client_class.create_from_edge_environment()
+
+        assert len(certificate_threads) == 1
+        assert certificate_threads[0] is not threading.current_thread()
+        assert mock_edge_hsm.return_value.sign.call_count == 1
+
 
 @pytest.mark.usefixtures("mock_mqtt_pipeline_init", "mock_http_pipeline_init")
 class SharedIoTHubModuleClientCreateFromEdgeEnvironmentWithDebugEnvTests(
@@ -0,0 +1,453 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+
+import pytest
+import logging
+import json
+import os
+import socks
+import threading
+import time
+import xml.etree.ElementTree as ET
+from six.moves import BaseHTTPServer, socketserver, urllib
+from azure.iot.device.iothub import blob_upload
+from azure.iot.device.common import ssl_context_cache
+from azure.iot.device import exceptions, ProxyOptions
+
+logging.basicConfig(level=logging.DEBUG)
+
+
+class FakeBlobStorageHandler(BaseHTTPServer.BaseHTTPRequestHandler):
+    """Minimal stand-in for the Azure Storage Put Block and Put Block List APIs"""
+
+    def log_message(self, format, *args):
+        pass
+
+    def do_PUT(self):
+        url = urllib.parse.urlparse(self.path)
+        query = dict(urllib.parse.parse_qsl(url.query))
+        body = self.rfile.read(int(self.headers["Content-Length"]))
+        storage = self.server.storage
+
+        with storage.lock:
+            storage.requests.append((query.get("comp"), query.get("blockid")))
+            storage.in_flight += 1
+            storage.max_in_flight = max(storage.max_in_flight, storage.in_flight)
+            status = storage.responses.pop(0) if storage.responses else None
+        try:
+            if status is None and query.get("comp") == "block":
+                with storage.lock:
+                    storage.uncommitted.setdefault(url.path, {})[query["blockid"]] = body
+                status = 201
+            elif status is None and query.get("comp") == "blocklist":
+                block_ids = [e.text for e in ET.fromstring(body).findall("Latest")]
+                with storage.lock:
+                    blocks = storage.uncommitted.get(url.path, {})
+                    if all(block_id in blocks for block_id in block_ids):
+                        storage.blobs[url.path] = b"".join(blocks[b] for b in block_ids)
+                        status = 201
+                    else:
+                        status = 400
+            elif status is None:
+                status = 400
+            self.send_response(status)
+            self.send_header("Content-Length", "0")
+            self.end_headers()
+        finally:
+            with storage.lock:
+                storage.in_flight -= 1
+
+
+class FakeBlobStorage(object):
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.uncommitted = {}
+        self.blobs = {}
+        self.requests = []
+        # Status codes to return for the next requests, instead of handling them
+        self.responses = []
+        self.in_flight = 0
+        self.max_in_flight = 0
+
+    def block_requests(self):
+        return [r for r in self.requests if r[0] == "block"]
+
+
+class ThreadingHTTPServer(socketserver.ThreadingMixIn, BaseHTTPServer.HTTPServer):
+    daemon_threads = True
+
+
+@pytest.fixture
+def storage():
+    storage = FakeBlobStorage()
+    server = ThreadingHTTPServer(("127.0.0.1", 0), FakeBlobStorageHandler)
+    server.storage = storage
+    thread = threading.Thread(target=server.serve_forever)
+    thread.daemon = True
+    thread.start()
+    storage.url = "http://127.0.0.1:{}".format(server.server_address[1])
+    yield storage
+    server.shutdown()
+    server.server_close()
+
+
+@pytest.fixture
+def blob_url(storage):
+    return blob_upload.get_blob_url(
+        {
+            "hostName": storage.url.split("://")[1],
+            "containerName": "container",
+            "blobName": "device/diagnostics.bin",
+            "sasToken": "?sv=2018-03-28&sig=fake",
+        },
+        scheme="http",
+    )
+
+
+@pytest.fixture
+def file_data():
+    return os.urandom(10 * 1024 + 17)
+
+
+@pytest.fixture
+def file_path(tmpdir, file_data):
+    path = str(tmpdir.join("diagnostics.bin"))
+    with open(path, "wb") as f:
+        f.write(file_data)
+    return path
+
+
+@pytest.fixture
+def manifest_path(tmpdir):
+    return str(tmpdir.join("diagnostics.bin.manifest"))
+
+
+@pytest.fixture(autouse=True)
+def mock_sleep(mocker):
+    return mocker.patch.object(blob_upload.time, "sleep")
+
+
+@pytest.mark.describe("get_blob_url()")
+class TestGetBlobUrl(object):
+    @pytest.mark.it("Returns the SAS URL of the blob described by the storage info")
+    def test_url(self):
+        url = blob_upload.get_blob_url(
+            {
+                "hostName": "account.blob.core.windows.net",
+                "containerName": "container",
+                "blobName": "device/my file.txt",
+                "sasToken": "?sv=2018-03-28&sig=fake",
+            }
+        )
+        assert (
+            url
+            == "https://account.blob.core.windows.net/container/device/my%20file.txt?sv=2018-03-28&sig=fake"
+        )
+
+
+@pytest.mark.describe("BlobUploader - .upload_file()")
+class TestBlobUploaderUploadFile(object):
+    @pytest.mark.it("Uploads the file in blocks of 'block_size' and commits them in order")
+    def test_uploads_in_blocks(self, storage, blob_url, file_path, file_data):
+        uploader = blob_upload.BlobUploader(blob_url, block_size=1024)
+        status_code = uploader.upload_file(file_path)
+
+        assert status_code == 201
+        assert storage.blobs["/container/device/diagnostics.bin"] == file_data
+        assert len(storage.block_requests()) == 11
+        assert storage.requests[-1][0] == "blocklist"
+
+    @pytest.mark.it("Uploads an empty file as a single empty block")
+    def test_empty_file(self, storage, blob_url, tmpdir):
+        path = str(tmpdir.join("empty.bin"))
+        open(path, "wb").close()
+        blob_upload.BlobUploader(blob_url).upload_file(path)
+
+        assert storage.blobs["/container/device/diagnostics.bin"] == b""
+
+    @pytest.mark.it("Uploads no more than 'max_concurrency' blocks at once")
+    def test_bounded_concurrency(self, storage, blob_url, file_path):
+        uploader = blob_upload.BlobUploader(blob_url, block_size=512, max_concurrency=3)
+        uploader.upload_file(file_path)
+
+        assert 1 <= storage.max_in_flight <= 3
+
+    @pytest.mark.it("Retries blocks which fail with a transient error")
+    def test_retries_transient_error(self, storage, blob_url, file_path, file_data):
+        storage.responses = [503, 500]
+        uploader = blob_upload.BlobUploader(blob_url, block_size=4096, max_concurrency=1)
+        uploader.upload_file(file_path)
+
+        assert storage.blobs["/container/device/diagnostics.bin"] == file_data
+        assert len(storage.block_requests()) == 5
+
+    @pytest.mark.it(
+        "Raises a ServiceError without committing the blob if a block fails with a non-transient error"
+    )
+    def test_non_transient_error(self, storage, blob_url, file_path):
+        storage.responses = [403]
+        uploader = blob_upload.BlobUploader(blob_url, block_size=4096, max_concurrency=1)
+        with pytest.raises(exceptions.ServiceError):
+            uploader.upload_file(file_path)
+
+        assert storage.blobs == {}
+        assert "blocklist" not in [r[0] for r in storage.requests]
+
+    @pytest.mark.it("Raises a ConnectionFailedError if Azure Storage can't be reached")
+    def test_connection_failed(self, blob_url, file_path):
+        uploader = blob_upload.BlobUploader(
+            "http://127.0.0.1:1/container/blob", block_size=4096, max_retries=1
+        )
+        with pytest.raises(exceptions.ConnectionFailedError):
+            uploader.upload_file(file_path)
+
+    @pytest.mark.it("Records uploaded blocks in the manifest while the upload is in progress")
+    def test_manifest_written(self, storage, blob_url, file_path, manifest_path):
+        storage.responses = [201, 201, 403]
+        uploader = blob_upload.BlobUploader(
+            blob_url, block_size=1024, max_concurrency=1, manifest_path=manifest_path
+        )
+        with pytest.raises(exceptions.ServiceError):
+            uploader.upload_file(file_path)
+
+        with open(manifest_path) as f:
+            lines = f.read().splitlines()
+        assert json.loads(lines[0])["block_size"] == 1024
+        assert sorted(int(line) for line in lines[1:]) == [0, 1]
+
+    @pytest.mark.it("Appends each uploaded block to the manifest, rather than rewriting it")
+    def test_manifest_appended(self, mocker, storage, blob_url, file_path, manifest_path):
+        replace_spy = mocker.spy(blob_upload, "_replace_file")
+        uploader = blob_upload.BlobUploader(
+            blob_url, block_size=1024, max_concurrency=1, manifest_path=manifest_path
+        )
+        uploader.upload_file(file_path)
+
+        # Only when the manifest is started
+        assert replace_spy.call_count == 1
+
+    @pytest.mark.it(
+        "Resumes an interrupted upload without re-sending blocks recorded in the manifest"
+    )
+    def test_resume(self, storage, blob_url, file_path, file_data, manifest_path):
+        # The first attempt fails after 4 blocks have been uploaded
+        storage.responses = [None] * 4 + [403]
+        uploader = blob_upload.BlobUploader(
+            blob_url, block_size=1024, max_concurrency=1, manifest_path=manifest_path
+        )
+        with pytest.raises(exceptions.ServiceError):
+            uploader.upload_file(file_path)
+        assert len(storage.block_requests()) == 5
+        del storage.requests[:]
+
+        # A new SAS token is issued for the retry
+        resume_url = blob_url.replace("sig=fake", "sig=other")
+        uploader = blob_upload.BlobUploader(
+            resume_url, block_size=1024, max_concurrency=1, manifest_path=manifest_path
+        )
+        uploader.upload_file(file_path)
+
+        assert storage.blobs["/container/device/diagnostics.bin"] == file_data
+        assert len(storage.block_requests()) == 7
+        assert not os.path.exists(manifest_path)
+
+    @pytest.mark.it("Ignores a block record in the manifest which was cut short")
+    def test_resume_cut_short(self, storage, blob_url, file_path, file_data, manifest_path):
+        storage.responses = [None] * 4 + [403]
+        uploader = blob_upload.BlobUploader(
+            blob_url, block_size=1024, max_concurrency=1, manifest_path=manifest_path
+        )
+        with pytest.raises(exceptions.ServiceError):
+            uploader.upload_file(file_path)
+        # e.g. the process was killed while it recorded block 4
+        with open(manifest_path, "a") as f:
+            f.write("4")
+        del storage.requests[:]
+
+        uploader = blob_upload.BlobUploader(
+            blob_url, block_size=1024, max_concurrency=1, manifest_path=manifest_path
+        )
+        uploader.upload_file(file_path)
+
+        assert storage.blobs["/container/device/diagnostics.bin"] == file_data
+        assert len(storage.block_requests()) == 7
+
+    @pytest.mark.it("Starts over if the manifest is for a different file or block size")
+    def test_manifest_mismatch(self, storage, blob_url, file_path, file_data, manifest_path):
+        storage.responses = [None] * 4 + [403]
+        uploader = blob_upload.BlobUploader(
+            blob_url, block_size=1024, max_concurrency=1, manifest_path=manifest_path
+        )
+        with pytest.raises(exceptions.ServiceError):
+            uploader.upload_file(file_path)
+        del storage.requests[:]
+
+        uploader = blob_upload.BlobUploader(
+            blob_url, block_size=2048, max_concurrency=1, manifest_path=manifest_path
+        )
+        uploader.upload_file(file_path)
+
+        assert storage.blobs["/container/device/diagnostics.bin"] == file_data
+        assert len(storage.block_requests()) == 6
+
+    @pytest.mark.it("Raises a ValueError if the file needs more blocks than Azure Storage allows")
+    def test_too_many_blocks(self, mocker, blob_url, file_path):
+        mocker.patch.object(blob_upload, "MAX_BLOCKS", 2)
+        uploader = blob_upload.BlobUploader(blob_url, block_size=1024)
+        with pytest.raises(ValueError):
+            uploader.upload_file(file_path)
+
+
+@pytest.mark.describe("BlobUploader - Deadline")
+class TestBlobUploaderDeadline(object):
+    @pytest.mark.it(
+        "Raises an OperationTimeout without making any request if the deadline has passed"
+    )
+    def test_deadline_passed(self, storage, blob_url, file_path):
+        uploader = blob_upload.BlobUploader(blob_url, block_size=4096, deadline=time.time() - 1)
+        with pytest.raises(exceptions.OperationTimeout):
+            uploader.upload_file(file_path)
+
+        assert storage.requests == []
+
+    @pytest.mark.it("Raises an OperationTimeout instead of retrying a request past the deadline")
+    def test_no_retry_past_deadline(self, storage, blob_url, file_path, mock_sleep):
+        storage.responses = [503]
+        uploader = blob_upload.BlobUploader(
+            blob_url, block_size=4096, max_concurrency=1, deadline=time.time() + 0.5
+        )
+        with pytest.raises(exceptions.OperationTimeout):
+            uploader.upload_file(file_path)
+
+        assert len(storage.block_requests()) == 1
+        assert mock_sleep.call_count == 0
+        assert storage.blobs == {}
+
+    @pytest.mark.it("Limits the timeout of each request to the time left before the deadline")
+    def test_request_timeout(self, mocker, storage, blob_url, file_path, file_data):
+        uploader = blob_upload.BlobUploader(
+            blob_url, block_size=4096, timeout=60, deadline=time.time() + 10
+        )
+        request_spy = mocker.spy(uploader._session, "request")
+        uploader.upload_file(file_path)
+
+        assert storage.blobs["/container/device/diagnostics.bin"] == file_data
+        assert request_spy.call_count == 4
+        for call in request_spy.call_args_list:
+            assert 0 < call[1]["timeout"] <= 10
+
+
+@pytest.mark.describe("BlobUploader - TLS and proxy settings")
+class TestBlobUploaderSettings(object):
+    @pytest.mark.it("Sends requests through the proxy server described by 'proxy_options'")
+    def test_proxy(self, storage, file_path, file_data):
+        # The fake storage also works as an HTTP proxy, since it only looks at the path
+        proxy_port = int(storage.url.rsplit(":", 1)[1])
+        uploader = blob_upload.BlobUploader(
+            "http://unreachable.invalid/container/device/diagnostics.bin?sig=fake",
+            proxy_options=ProxyOptions(
+                proxy_type=socks.HTTP, proxy_addr="127.0.0.1", proxy_port=proxy_port
+            ),
+        )
+        uploader.upload_file(file_path)
+
+        assert storage.blobs["/container/device/diagnostics.bin"] == file_data
+
+    @pytest.mark.it("Includes the proxy type and credentials from 'proxy_options' in the proxy URL")
+    @pytest.mark.parametrize(
+        "proxy_type, expected_scheme",
+        [
+            pytest.param(socks.HTTP, "http", id="HTTP"),
+            pytest.param(socks.SOCKS4, "socks4", id="SOCKS4"),
+            pytest.param(socks.SOCKS5, "socks5h", id="SOCKS5"),
+        ],
+    )
+    def test_proxy_url(self, mocker, blob_url, file_path, proxy_type, expected_scheme):
+        mock_request = mocker.patch.object(blob_upload.requests.Session, "request")
+        mock_request.return_value.status_code = 201
+        uploader = blob_upload.BlobUploader(
+            blob_url,
+            proxy_options=ProxyOptions(
+                proxy_type=proxy_type,
+                proxy_addr="proxy.example.com",
+                proxy_port=1080,
+                proxy_username="user",
+                proxy_password="p@ss",
+            ),
+        )
+        uploader.upload_file(file_path)
+
+        expected_url = expected_scheme + "://user:p%40ss@proxy.example.com:1080"
+        for call in mock_request.call_args_list:
+            assert call[1]["proxies"] == {"http": expected_url, "https": expected_url}
+
+    @pytest.mark.it(
+        "Makes TLS connections with an SSLContext for the 'server_verification_cert' and 'cipher', if provided"
+    )
+    def test_ssl_context(self, mocker, blob_url):
+        mock_create = mocker.patch.object(ssl_context_cache, "create_ssl_context")
+        uploader = blob_upload.BlobUploader(
+            blob_url, server_verification_cert="__fake_cert__", cipher="__fake_cipher__"
+        )
+
+        assert mock_create.call_args == mocker.call(
+            server_verification_cert="__fake_cert__", cipher="__fake_cipher__"
+        )
+        adapter = uploader._session.get_adapter("https://account.blob.core.windows.net")
+        assert adapter.poolmanager.connection_pool_kw["ssl_context"] is mock_create.return_value
+
+    @pytest.mark.it("Uses the default TLS settings if no 'server_verification_cert' or 'cipher'")
+    def test_default_ssl_context(self, mocker, blob_url):
+        mock_create = mocker.patch.object(ssl_context_cache, "create_ssl_context")
+        uploader = blob_upload.BlobUploader(blob_url)
+
+        assert mock_create.call_count == 0
+        adapter = uploader._session.get_adapter("https://account.blob.core.windows.net")
+        assert "ssl_context" not in adapter.poolmanager.connection_pool_kw
+
+
+@pytest.mark.describe("get_error_status_code()")
+class TestGetErrorStatusCode(object):
+    @pytest.mark.it("Returns the status code of the error response from Azure Storage")
+    def test_error_response(self, storage, blob_url, file_path):
+        storage.responses = [403]
+        uploader = blob_upload.BlobUploader(blob_url, max_concurrency=1)
+        with pytest.raises(exceptions.ServiceError) as e_info:
+            uploader.upload_file(file_path)
+
+        assert blob_upload.get_error_status_code(e_info.value) == 403
+
+    @pytest.mark.it("Returns DEFAULT_ERROR_STATUS_CODE if Azure Storage did not respond")
+    def test_no_response(self, file_path):
+        uploader = blob_upload.BlobUploader("http://127.0.0.1:1/container/blob", max_retries=0)
+        with pytest.raises(exceptions.ConnectionFailedError) as e_info:
+            uploader.upload_file(file_path)
+
+        assert (
+            blob_upload.get_error_status_code(e_info.value) == blob_upload.DEFAULT_ERROR_STATUS_CODE
+        )
+
+
+@pytest.mark.describe("get_error_status_description()")
+class TestGetErrorStatusDescription(object):
+    @pytest.mark.it("Returns the description of an error from Azure Storage")
+    def test_error_response(self, storage, blob_url, file_path):
+        storage.responses = [403]
+        uploader = blob_upload.BlobUploader(blob_url, max_concurrency=1)
+        with pytest.raises(exceptions.ServiceError) as e_info:
+            uploader.upload_file(file_path)
+
+        assert blob_upload.get_error_status_description(e_info.value) == str(e_info.value)
+
+    @pytest.mark.it("Does not include the local path of a file which could not be read")
+    def test_file_error(self, blob_url, tmpdir):
+        missing_path = str(tmpdir.join("missing.bin"))
+        uploader = blob_upload.BlobUploader(blob_url)
+        with pytest.raises(EnvironmentError) as e_info:
+            uploader.upload_file(missing_path)
+
+        description = blob_upload.get_error_status_description(e_info.value)
+        assert str(tmpdir) not in description
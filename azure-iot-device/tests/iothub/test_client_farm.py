@@ -0,0 +1,142 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+import pytest
+import logging
+import sys
+from azure.iot.device.iothub import IoTHubDeviceClient
+from azure.iot.device.iothub.client_farm import DeviceClientFarm
+from azure.iot.device.iothub.sync_handler_manager import SyncHandlerManager
+from azure.iot.device.common.mqtt_network_loop import MQTTNetworkLoop
+from .client_fixtures import shared_access_key, hostname
+
+logging.basicConfig(level=logging.DEBUG)
+
+pytestmark = [
+    pytest.mark.skipif(sys.version_info < (3, 0), reason="MQTTNetworkLoop requires Python 3"),
+    pytest.mark.usefixtures("mock_mqtt_pipeline_init", "mock_http_pipeline_init"),
+]
+
+
+@pytest.fixture
+def farm(mocker):
+    farm = DeviceClientFarm(network_threads=2, handler_threads=4)
+    yield farm
+    # The pipelines are mocked, so disconnecting would never complete
+    for client in farm.clients:
+        mocker.patch.object(client, "disconnect")
+    farm.shutdown()
+
+
+@pytest.mark.describe("DeviceClientFarm - Instantiation")
+class TestDeviceClientFarmInstantiation(object):
+    @pytest.mark.it("Creates the given number of network loops")
+    def test_network_loops(self, farm):
+        assert len(farm._network_loops) == 2
+        for network_loop in farm._network_loops:
+            assert isinstance(network_loop, MQTTNetworkLoop)
+
+    @pytest.mark.it("Creates a handler executor with the given number of threads")
+    def test_handler_executor(self, farm):
+        assert farm._handler_executor._max_workers == 4
+
+    @pytest.mark.it("Raises a ValueError if a thread count is less than 1")
+    @pytest.mark.parametrize(
+        "kwargs",
+        [
+            pytest.param({"network_threads": 0}, id="network_threads"),
+            pytest.param({"handler_threads": 0}, id="handler_threads"),
+        ],
+    )
+    def test_invalid_thread_count(self, kwargs):
+        with pytest.raises(ValueError):
+            DeviceClientFarm(**kwargs)
+
+
+@pytest.mark.describe("DeviceClientFarm - .create_from_*()")
+class TestDeviceClientFarmCreate(object):
+    @pytest.fixture(
+        params=["create_from_connection_string", "create_from_symmetric_key", "x509"],
+        ids=["Connection String", "Symmetric Key", "X509 Certificate"],
+    )
+    def create(self, request, farm, device_connection_string, x509):
+        if request.param == "create_from_connection_string":
+            return lambda **kwargs: farm.create_from_connection_string(
+                device_connection_string, **kwargs
+            )
+        elif request.param == "create_from_symmetric_key":
+            return lambda **kwargs: farm.create_from_symmetric_key(
+                shared_access_key, hostname, "some_device", **kwargs
+            )
+        else:
+            return lambda **kwargs: farm.create_from_x509_certificate(
+                x509, hostname, "some_device", **kwargs
+            )
+
+    @pytest.mark.it("Returns an IoTHubDeviceClient, and adds it to the farm's clients")
+    def test_returns_client(self, farm, create):
+        client = create()
+        assert isinstance(client, IoTHubDeviceClient)
+        assert farm.clients == [client]
+
+    @pytest.mark.it("Assigns the network loops to the clients in turn")
+    def test_network_loop(self, farm, create, mock_mqtt_pipeline_init):
+        for _ in range(4):
+            create()
+        configs = [call[0][0] for call in mock_mqtt_pipeline_init.call_args_list]
+        assert [config.network_loop for config in configs] == farm._network_loops * 2
+
+    @pytest.mark.it("Gives the client a handler manager that uses the farm's handler executor")
+    def test_handler_manager(self, farm, create):
+        client = create()
+        assert isinstance(client._handler_manager, SyncHandlerManager)
+        assert client._handler_manager._handler_executor is farm._handler_executor
+        assert client._handler_manager._inbox_manager is client._inbox_manager
+
+    @pytest.mark.it("Passes other options through to the client")
+    def test_options(self, create, mock_mqtt_pipeline_init):
+        create(keep_alive=42)
+        config = mock_mqtt_pipeline_init.call_args[0][0]
+        assert config.keep_alive == 42
+
+    @pytest.mark.it("Raises a TypeError if a network_loop or handler_executor is provided")
+    @pytest.mark.parametrize("kwarg", ["network_loop", "handler_executor"])
+    def test_shared_resource_option(self, mocker, create, kwarg):
+        with pytest.raises(TypeError):
+            create(**{kwarg: mocker.MagicMock()})
+
+    @pytest.mark.it("Raises a RuntimeError if the farm has been shut down")
+    def test_shut_down(self, farm, create):
+        farm.shutdown()
+        with pytest.raises(RuntimeError):
+            create()
+
+
+@pytest.mark.describe("DeviceClientFarm - .shutdown()")
+class TestDeviceClientFarmShutdown(object):
+    @pytest.mark.it("Disconnects all clients, then stops the network loops and handler executor")
+    def test_shutdown(self, mocker, farm, device_connection_string):
+        clients = [farm.create_from_connection_string(device_connection_string) for _ in range(3)]
+        for client in clients:
+            mocker.patch.object(client, "disconnect")
+        spy_executor_shutdown = mocker.spy(farm._handler_executor, "shutdown")
+
+        farm.shutdown()
+
+        for client in clients:
+            assert client.disconnect.call_count == 1
+        for network_loop in farm._network_loops:
+            assert not network_loop._thread.is_alive()
+        assert spy_executor_shutdown.call_count == 1
+
+    @pytest.mark.it("Stops the handlers of a client if disconnecting it fails")
+    def test_disconnect_fails(self, mocker, farm, device_connection_string, arbitrary_exception):
+        client = farm.create_from_connection_string(device_connection_string)
+        mocker.patch.object(client, "disconnect", side_effect=arbitrary_exception)
+        spy_stop = mocker.spy(client._handler_manager, "stop")
+
+        farm.shutdown()
+
+        assert spy_stop.call_count == 1
@@ -9,13 +9,43 @@ import logging
 import requests
 import json
 import base64
+import calendar
+import os
+import socket
+import ssl
+import sys
+import tempfile
+import threading
+import time
 from six.moves import urllib
+from azure.iot.device.iothub import edge_hsm as edge_hsm_module
 from azure.iot.device.iothub.edge_hsm import IoTEdgeHsm, IoTEdgeError
 from azure.iot.device import user_agent
 
-
 logging.basicConfig(level=logging.DEBUG)
 
+# Self-signed certificate which expires Oct 13 18:41:08 2036 GMT
+fake_certificate = """-----BEGIN CERTIFICATE-----
+MIIBgzCCASmgAwIBAgIUG6YWipRIGkvVbqAppew+gXUvvyswCgYIKoZIzj0EAwIw
+FzEVMBMGA1UEAwwMZWRnZS10ZXN0LWNhMB4XDTI2MTAxNjE4NDEwOFoXDTM2MTAx
+MzE4NDEwOFowFzEVMBMGA1UEAwwMZWRnZS10ZXN0LWNhMFkwEwYHKoZIzj0CAQYI
+KoZIzj0DAQcDQgAESltCSmELwkvl9FmrbmywRKY8+OVA8JD763SkROzlO5nG2rSn
+e9C2wHb5RpdzpQDZx39FN34MdvVzIS23ULZD9KNTMFEwHQYDVR0OBBYEFJxa3px5
+/pHkwi5bdeXid77IG3IsMB8GA1UdIwQYMBaAFJxa3px5/pHkwi5bdeXid77IG3Is
+MA8GA1UdEwEB/wQFMAMBAf8wCgYIKoZIzj0EAwIDSAAwRQIhAKqXaxAwfPmVBBMj
+AXEzanTcwE57dBdkR6WI5vmcbnoGAiA0eyYFNCX//ZxzwZyDzcvZqDGqx0gwoMRp
+8HkdNUdhAA==
+-----END CERTIFICATE-----
+"""
+fake_certificate_expiry = calendar.timegm((2036, 10, 13, 18, 41, 8))
+
+
+@pytest.fixture(autouse=True)
+def clear_certificate_cache():
+    edge_hsm_module.clear_certificate_cache()
+    yield
+    edge_hsm_module.clear_certificate_cache()
+
 
 @pytest.fixture
 def edge_hsm():
@@ -167,6 +197,135 @@ class TestIoTEdgeHsmGetCertificate(object):
         with pytest.raises(IoTEdgeError):
             edge_hsm.get_certificate()
 
+    @pytest.mark.it(
+        "Returns the cached certificate without a request to Edge, for an IoTEdgeHsm with the same workload URI and API version"
+    )
+    def test_cached(self, mocker, edge_hsm):
+        mock_request_get = mocker.patch.object(requests, "get")
+        mock_request_get.return_value.json.return_value = {"certificate": fake_certificate}
+        edge_hsm.get_certificate()
+        other_edge_hsm = IoTEdgeHsm(
+            module_id="other_module_id",
+            generation_id="other_generation_id",
+            workload_uri="unix:///var/run/iotedge/workload.sock",
+            api_version="my_api_version",
+        )
+
+        returned_cert = other_edge_hsm.get_certificate()
+
+        assert returned_cert == fake_certificate
+        assert mock_request_get.call_count == 1
+
+    @pytest.mark.it(
+        "Does not use the cached certificate for a different workload URI or API version"
+    )
+    @pytest.mark.parametrize(
+        "workload_uri, api_version",
+        [
+            pytest.param("unix:///var/run/iotedge/other.sock", "my_api_version", id="Workload URI"),
+            pytest.param("unix:///var/run/iotedge/workload.sock", "other", id="API version"),
+        ],
+    )
+    def test_not_cached(self, mocker, edge_hsm, workload_uri, api_version):
+        mock_request_get = mocker.patch.object(requests, "get")
+        mock_request_get.return_value.json.return_value = {"certificate": fake_certificate}
+        edge_hsm.get_certificate()
+        other_edge_hsm = IoTEdgeHsm(
+            module_id="my_module_id",
+            generation_id="module_generation_id",
+            workload_uri=workload_uri,
+            api_version=api_version,
+        )
+
+        other_edge_hsm.get_certificate()
+
+        assert mock_request_get.call_count == 2
+
+    @pytest.mark.it(
+        "Requests the trust bundle from Edge again once TRUST_BUNDLE_MAX_AGE has passed since it was cached"
+    )
+    def test_cache_max_age(self, mocker, edge_hsm):
+        mock_request_get = mocker.patch.object(requests, "get")
+        mock_request_get.return_value.json.return_value = {"certificate": fake_certificate}
+        mocker.patch.object(time, "time", return_value=1000)
+        edge_hsm.get_certificate()
+
+        time.time.return_value = 1000 + edge_hsm_module.TRUST_BUNDLE_MAX_AGE - 1
+        edge_hsm.get_certificate()
+        assert mock_request_get.call_count == 1
+
+        time.time.return_value = 1000 + edge_hsm_module.TRUST_BUNDLE_MAX_AGE
+        edge_hsm.get_certificate()
+        assert mock_request_get.call_count == 2
+
+    @pytest.mark.it(
+        "Requests the trust bundle from Edge again once a certificate in it has expired, if that is sooner than TRUST_BUNDLE_MAX_AGE"
+    )
+    def test_cache_certificate_expiry(self, mocker, edge_hsm):
+        mock_request_get = mocker.patch.object(requests, "get")
+        mock_request_get.return_value.json.return_value = {"certificate": fake_certificate}
+        mocker.patch.object(time, "time", return_value=fake_certificate_expiry - 10)
+        edge_hsm.get_certificate()
+
+        time.time.return_value = fake_certificate_expiry - 1
+        edge_hsm.get_certificate()
+        assert mock_request_get.call_count == 1
+
+        time.time.return_value = fake_certificate_expiry
+        edge_hsm.get_certificate()
+        assert mock_request_get.call_count == 2
+
+    @pytest.mark.it("Does not cache the certificate if the request to Edge fails")
+    def test_not_cached_on_failure(self, mocker, edge_hsm):
+        mock_request_get = mocker.patch.object(requests, "get")
+        mock_request_get.return_value.raise_for_status.side_effect = requests.exceptions.HTTPError()
+        with pytest.raises(IoTEdgeError):
+            edge_hsm.get_certificate()
+
+        mock_request_get.return_value.raise_for_status.side_effect = None
+        mock_request_get.return_value.json.return_value = {"certificate": fake_certificate}
+        assert edge_hsm.get_certificate() == fake_certificate
+        assert mock_request_get.call_count == 2
+
+
+@pytest.mark.describe("IoTEdgeHsm - Certificate expiry")
+class TestIoTEdgeHsmCertificateExpiry(object):
+    @pytest.mark.it("Returns the expiry time of a PEM certificate")
+    def test_expiry(self):
+        assert edge_hsm_module._get_earliest_certificate_expiry(fake_certificate) == (
+            fake_certificate_expiry
+        )
+
+    @pytest.mark.it("Returns the earliest expiry time of the certificates in a PEM bundle")
+    def test_earliest_expiry(self, mocker):
+        mock_context = mocker.patch.object(ssl, "SSLContext").return_value
+        mock_context.get_ca_certs.return_value = [
+            {"notAfter": "Oct 13 18:41:08 2036 GMT"},
+            {"notAfter": "Jan  1 00:16:40 1970 GMT"},
+            {"notAfter": "Oct 13 18:41:09 2036 GMT"},
+        ]
+        bundle = fake_certificate * 3
+
+        assert edge_hsm_module._get_earliest_certificate_expiry(bundle) == 1000
+        assert mock_context.load_verify_locations.call_args == mocker.call(cadata=bundle)
+
+    @pytest.mark.it("Returns None if a certificate in the bundle can't be parsed")
+    @pytest.mark.parametrize(
+        "pem",
+        [
+            pytest.param(
+                "-----BEGIN CERTIFICATE-----\nMIIBgz\n-----END CERTIFICATE-----\n", id="Truncated"
+            ),
+            pytest.param(
+                "-----BEGIN CERTIFICATE-----\n!!!\n-----END CERTIFICATE-----\n", id="Bad base64"
+            ),
+            pytest.param("not a certificate", id="No certificates"),
+            pytest.param(None, id="Not a string"),
+        ],
+    )
+    def test_bad_certificate(self, pem):
+        assert edge_hsm_module._get_earliest_certificate_expiry(pem) is None
+
 
 @pytest.mark.describe("IoTEdgeHsm - .sign()")
 class TestIoTEdgeHsmSign(object):
@@ -251,3 +410,142 @@ class TestIoTEdgeHsmSign(object):
 
         with pytest.raises(IoTEdgeError):
             edge_hsm.sign("somedata")
+
+
+class FakeWorkloadAPIHandler(object):
+    """Handles requests to the fake workload API"""
+
+    def __init__(self):
+        self.requests = []
+        self.lock = threading.Lock()
+        # Delay before responding to each request, to make concurrency observable
+        self.delay = 0
+
+    def handle(self, method, path, body):
+        with self.lock:
+            self.requests.append((method, path))
+        time.sleep(self.delay)
+        if method == "GET" and path.startswith("/trust-bundle?"):
+            return 200, {"certificate": fake_certificate}
+        elif method == "POST" and "/sign?" in path:
+            data = base64.b64decode(json.loads(body)["data"])
+            return 200, {"digest": base64.b64encode(data[::-1]).decode()}
+        return 404, {"message": "not found"}
+
+
+@pytest.fixture
+def workload_api():
+    """A stand-in for the IoT Edge workload API, served over HTTP on a Unix socket"""
+    from six.moves import BaseHTTPServer, socketserver
+
+    handler = FakeWorkloadAPIHandler()
+
+    class RequestHandler(BaseHTTPServer.BaseHTTPRequestHandler):
+        protocol_version = "HTTP/1.1"
+
+        def address_string(self):
+            return "workload-socket"
+
+        def _respond(self):
+            length = int(self.headers.get("Content-Length") or 0)
+            body = self.rfile.read(length).decode("utf-8") if length else ""
+            status, response = handler.handle(self.command, self.path, body)
+            data = json.dumps(response).encode("utf-8")
+            self.send_response(status)
+            self.send_header("Content-Type", "application/json")
+            self.send_header("Content-Length", str(len(data)))
+            self.end_headers()
+            self.wfile.write(data)
+
+        do_GET = _respond
+        do_POST = _respond
+
+        def log_message(self, *args):
+            pass
+
+    class Server(socketserver.ThreadingMixIn, socketserver.UnixStreamServer):
+        daemon_threads = True
+
+        def get_request(self):
+            request, _ = self.socket.accept()
+            # BaseHTTPRequestHandler expects a (host, port) client address
+            return request, ("workload-socket", 0)
+
+    socket_dir = tempfile.mkdtemp()
+    socket_path = os.path.join(socket_dir, "workload.sock")
+    server = Server(socket_path, RequestHandler)
+    thread = threading.Thread(target=server.serve_forever)
+    thread.daemon = True
+    thread.start()
+    handler.workload_uri = "unix://" + socket_path
+    yield handler
+    server.shutdown()
+    server.server_close()
+    os.remove(socket_path)
+    os.rmdir(socket_dir)
+
+
+@pytest.mark.skipif(
+    not hasattr(socket, "AF_UNIX") or sys.version_info < (3, 0),
+    reason="Requires Unix domain sockets",
+)
+@pytest.mark.describe("IoTEdgeHsm - Workload API stand-in on a Unix socket")
+class TestIoTEdgeHsmWorkloadAPI(object):
+    @pytest.fixture
+    def edge_hsm(self, workload_api):
+        return IoTEdgeHsm(
+            module_id="my_module_id",
+            generation_id="module_generation_id",
+            workload_uri=workload_api.workload_uri,
+            api_version="2019-01-30",
+        )
+
+    @pytest.mark.it("Retrieves the certificate from the workload API, and caches it")
+    def test_get_certificate(self, edge_hsm, workload_api):
+        assert edge_hsm.get_certificate() == fake_certificate
+        assert edge_hsm.get_certificate() == fake_certificate
+        assert workload_api.requests == [("GET", "/trust-bundle?api-version=2019-01-30")]
+
+    @pytest.mark.it("Signs data with the workload API")
+    def test_sign(self, edge_hsm, workload_api):
+        signature = edge_hsm.sign("some data")
+
+        assert base64.b64decode(signature) == b"atad emos"
+        assert workload_api.requests == [
+            (
+                "POST",
+                "/modules/my_module_id/genid/module_generation_id/sign?api-version=2019-01-30",
+            )
+        ]
+
+    @pytest.mark.it(
+        "Creates a module client from the Edge environment, retrieving the certificate and signing the first SasToken concurrently"
+    )
+    def test_create_from_edge_environment(self, mocker, workload_api):
+        from azure.iot.device import IoTHubModuleClient
+
+        mocker.patch("azure.iot.device.iothub.pipeline.MQTTPipeline")
+        mocker.patch("azure.iot.device.iothub.pipeline.HTTPPipeline")
+        mocker.patch.dict(
+            os.environ,
+            {
+                "IOTEDGE_MODULEID": "my_module_id",
+                "IOTEDGE_DEVICEID": "my_device_id",
+                "IOTEDGE_IOTHUBHOSTNAME": "my.azure-devices.net",
+                "IOTEDGE_GATEWAYHOSTNAME": "my-gateway",
+                "IOTEDGE_APIVERSION": "2019-01-30",
+                "IOTEDGE_MODULEGENERATIONID": "module_generation_id",
+                "IOTEDGE_WORKLOADURI": workload_api.workload_uri,
+            },
+            clear=True,
+        )
+        workload_api.delay = 0.5
+
+        start = time.time()
+        client = IoTHubModuleClient.create_from_edge_environment()
+        elapsed = time.time() - start
+
+        # Both requests were made, at the same time
+        assert sorted(method for (method, _) in workload_api.requests) == ["GET", "POST"]
+        assert elapsed < 2 * workload_api.delay
+        assert isinstance(client, IoTHubModuleClient)
@@ -9,7 +9,9 @@ import logging
 import sys
 import six
 import abc
+import functools
 from azure.iot.device.iothub.inbox_manager import InboxManager
+from azure.iot.device.iothub.sync_inbox import InboxEmpty
 from azure.iot.device.iothub.models import Message, MethodRequest
 
 logging.basicConfig(level=logging.DEBUG)
@@ -56,6 +58,20 @@ def method_request():
     return MethodRequest(request_id="1", name="some_method", payload="{'key': 'value'}")
 
 
+def take_all(inbox):
+    """Remove and return all of the items in the inbox, in order"""
+    if isinstance(inbox, SyncClientInbox):
+        get_nowait = functools.partial(inbox.get, block=False)
+    else:
+        get_nowait = inbox.get_nowait
+    items = []
+    while True:
+        try:
+            items.append(get_nowait())
+        except InboxEmpty:
+            return items
+
+
 @pytest.mark.describe("InboxManager")
 class TestInboxManager(object):
     @pytest.mark.it("Instantiates with 'Unified Message Mode' turned off")
@@ -337,6 +353,70 @@ class TestInboxManagerRouteInputMessageUnified(object):
         assert input_inbox.empty()
 
 
+@pytest.mark.describe("InboxManager - .route_input_messages()")
+class TestInboxManagerRouteInputMessages(object):
+    @pytest.mark.it(
+        "Adds each Message to the input message inbox that corresponds to its input name, in order"
+    )
+    def test_adds_messages_to_input_message_inboxes(self, manager):
+        messages = [Message(str(i)) for i in range(4)]
+        messages[0].input_name = messages[2].input_name = "input1"
+        messages[1].input_name = messages[3].input_name = "input2"
+        input1_inbox = manager.get_input_message_inbox("input1")
+        input2_inbox = manager.get_input_message_inbox("input2")
+        delivered = manager.route_input_messages(messages)
+        assert delivered
+        assert take_all(input1_inbox) == [messages[0], messages[2]]
+        assert take_all(input2_inbox) == [messages[1], messages[3]]
+
+    @pytest.mark.it(
+        "Drops the Messages with input names that do not correspond to an input message inbox"
+    )
+    def test_drops_messages_to_unknown_input(self, manager):
+        messages = [Message("known"), Message("unknown")]
+        messages[0].input_name = "some_input"
+        messages[1].input_name = "not_a_real_input"
+        input_inbox = manager.get_input_message_inbox("some_input")
+        delivered = manager.route_input_messages(messages)
+        assert not delivered
+        assert take_all(input_inbox) == [messages[0]]
+
+    @pytest.mark.it("Adds the Messages to the unified message inbox, in Unified Message Mode")
+    def test_unified_mode(self, manager_unified_mode):
+        manager = manager_unified_mode
+        messages = [Message(str(i)) for i in range(3)]
+        for message in messages:
+            message.input_name = "some_input"
+        input_inbox = manager.get_input_message_inbox("some_input")
+        um_inbox = manager.get_unified_message_inbox()
+        delivered = manager.route_input_messages(messages)
+        assert delivered
+        assert input_inbox.empty()
+        assert take_all(um_inbox) == messages
+
+
+@pytest.mark.describe("InboxManager - .route_c2d_messages()")
+class TestInboxManagerRouteC2DMessages(object):
+    @pytest.mark.it("Adds the Messages to the C2D message inbox, in order")
+    def test_adds_messages_to_c2d_message_inbox(self, manager):
+        messages = [Message(str(i)) for i in range(3)]
+        c2d_inbox = manager.get_c2d_message_inbox()
+        delivered = manager.route_c2d_messages(messages)
+        assert delivered
+        assert take_all(c2d_inbox) == messages
+
+    @pytest.mark.it("Adds the Messages to the unified message inbox, in Unified Message Mode")
+    def test_unified_mode(self, manager_unified_mode):
+        manager = manager_unified_mode
+        messages = [Message(str(i)) for i in range(3)]
+        c2d_inbox = manager.get_c2d_message_inbox()
+        um_inbox = manager.get_unified_message_inbox()
+        delivered = manager.route_c2d_messages(messages)
+        assert delivered
+        assert c2d_inbox.empty()
+        assert take_all(um_inbox) == messages
+
+
 @pytest.mark.describe("InboxManager - .route_method_request()")
 class TestInboxManagerRouteMethodRequest(object):
     @pytest.mark.it(
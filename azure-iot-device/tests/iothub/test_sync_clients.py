@@ -10,16 +10,19 @@ import threading
 import time
 import os
 import io
+import requests
 import six
 import six.moves.urllib as urllib
 from azure.iot.device.iothub import IoTHubDeviceClient, IoTHubModuleClient
 from azure.iot.device import exceptions as client_exceptions
 from azure.iot.device.common.auth import sastoken as st
+from azure.iot.device.common.flow_control import FlowControl
 from azure.iot.device.iothub.pipeline import constant as pipeline_constant
 from azure.iot.device.iothub.pipeline import exceptions as pipeline_exceptions
 from azure.iot.device.iothub.pipeline import IoTHubPipelineConfig
 from azure.iot.device.iothub.models import Message, MethodRequest
 from azure.iot.device.iothub.sync_inbox import SyncClientInbox
+from azure.iot.device.iothub import blob_upload
 from azure.iot.device.iothub.abstract_clients import (
     RECEIVE_TYPE_NONE_SET,
     RECEIVE_TYPE_HANDLER,
@@ -30,6 +33,7 @@ from .shared_client_tests import (
     SharedIoTHubClientInstantiationTests,
     SharedIoTHubClientPROPERTYHandlerTests,
     SharedIoTHubClientPROPERTYConnectedTests,
+    SharedIoTHubClientPROPERTYFlowControlTests,
     SharedIoTHubClientOCCURANCEConnectTests,
     SharedIoTHubClientOCCURANCEDisconnectTests,
     SharedIoTHubClientCreateFromConnectionStringTests,
@@ -155,6 +159,20 @@ class SharedClientConnectTests(WaitsForEventCompletion):
         client.connect()
         assert mqtt_pipeline.connect.call_count == 1
 
+    @pytest.mark.it(
+        "Passes a deadline `timeout` seconds from now to the 'connect' pipeline operation, if a timeout is given"
+    )
+    @pytest.mark.parametrize("timeout", [None, 5], ids=["No timeout", "Timeout"])
+    def test_passes_deadline_from_timeout(self, client, mqtt_pipeline, timeout):
+        before = time.time()
+        client.connect(timeout=timeout)
+        after = time.time()
+        deadline = mqtt_pipeline.connect.call_args[1]["deadline"]
+        if timeout is None:
+            assert deadline is None
+        else:
+            assert before + timeout <= deadline <= after + timeout
+
     @pytest.mark.it("Waits for the completion of the 'connect' pipeline operation before returning")
     def test_waits_for_pipeline_op_completion(
         self, mocker, client_manual_cb, mqtt_pipeline_manual_cb
@@ -200,6 +218,11 @@ class SharedClientConnectTests(WaitsForEventCompletion):
                 client_exceptions.ClientError,
                 id="ProtocolProxyError->ClientError",
             ),
+            pytest.param(
+                pipeline_exceptions.OperationTimeout,
+                client_exceptions.OperationTimeout,
+                id="OperationTimeout->OperationTimeout",
+            ),
             pytest.param(Exception, client_exceptions.ClientError, id="Exception->ClientError"),
         ],
     )
@@ -490,6 +513,20 @@ class SharedClientSendD2CMessageTests(WaitsForEventCompletion):
         assert mqtt_pipeline.send_message.call_count == 1
         assert mqtt_pipeline.send_message.call_args[0][0] is message
 
+    @pytest.mark.it(
+        "Passes a deadline `timeout` seconds from now to the 'send_message' pipeline operation, if a timeout is given"
+    )
+    @pytest.mark.parametrize("timeout", [None, 5], ids=["No timeout", "Timeout"])
+    def test_passes_deadline_from_timeout(self, client, mqtt_pipeline, message, timeout):
+        before = time.time()
+        client.send_message(message, timeout=timeout)
+        after = time.time()
+        deadline = mqtt_pipeline.send_message.call_args[1]["deadline"]
+        if timeout is None:
+            assert deadline is None
+        else:
+            assert before + timeout <= deadline <= after + timeout
+
     @pytest.mark.it(
         "Waits for the completion of the 'send_message' pipeline operation before returning"
     )
@@ -532,6 +569,11 @@ class SharedClientSendD2CMessageTests(WaitsForEventCompletion):
                 client_exceptions.ClientError,
                 id="ProtocolClientError->ClientError",
             ),
+            pytest.param(
+                pipeline_exceptions.OperationTimeout,
+                client_exceptions.OperationTimeout,
+                id="OperationTimeout->OperationTimeout",
+            ),
             pytest.param(Exception, client_exceptions.ClientError, id="Exception->ClientError"),
         ],
     )
@@ -598,7 +640,7 @@ class SharedClientSendD2CMessageTests(WaitsForEventCompletion):
 
     @pytest.mark.it("Does not raises error when message data size is equal to 256 KB")
     def test_raises_error_when_message_data_equal_to_256(self, client, mqtt_pipeline):
-        data_input = "a" * 262095
+        data_input = "a" * 262144
         message = Message(data_input)
         # This check was put as message class may undergo the default content type encoding change
         # and the above calculation will change.
@@ -614,6 +656,42 @@ class SharedClientSendD2CMessageTests(WaitsForEventCompletion):
         assert sent_message.data == data_input
 
 
+class SharedClientWaitForCapacityTests(object):
+    @pytest.fixture
+    def flow_control(self, mqtt_pipeline):
+        mqtt_pipeline.flow_control = FlowControl(high_watermark=100, low_watermark=50)
+        return mqtt_pipeline.flow_control
+
+    @pytest.mark.it("Returns True immediately if the client has capacity")
+    def test_has_capacity(self, client, flow_control):
+        flow_control.add(100)
+        assert client.wait_for_capacity() is True
+
+    @pytest.mark.it(
+        "Blocks until completed sends have dropped the pending bytes to the low watermark, then returns True"
+    )
+    def test_blocks_until_low_watermark(self, client, flow_control):
+        flow_control.add(60)
+        flow_control.add(60)
+
+        def complete_sends():
+            time.sleep(0.05)
+            flow_control.remove(60)
+            time.sleep(0.05)
+            flow_control.remove(60)
+
+        thread = threading.Thread(target=complete_sends)
+        thread.start()
+        assert client.wait_for_capacity() is True
+        assert flow_control.pending_bytes == 0
+        thread.join()
+
+    @pytest.mark.it("Returns False if the timeout expires before the client has capacity")
+    def test_timeout(self, client, flow_control):
+        flow_control.add(120)
+        assert client.wait_for_capacity(timeout=0.05) is False
+
+
 class SharedClientReceiveMethodRequestTests(object):
     @pytest.mark.it("Implicitly enables methods feature if not already enabled")
     @pytest.mark.parametrize(
@@ -864,6 +942,20 @@ class SharedClientSendMethodResponseTests(WaitsForEventCompletion):
         assert mqtt_pipeline.send_method_response.call_count == 1
         assert mqtt_pipeline.send_method_response.call_args[0][0] is method_response
 
+    @pytest.mark.it(
+        "Passes a deadline `timeout` seconds from now to the 'send_method_response' pipeline operation, if a timeout is given"
+    )
+    @pytest.mark.parametrize("timeout", [None, 5], ids=["No timeout", "Timeout"])
+    def test_passes_deadline_from_timeout(self, client, mqtt_pipeline, method_response, timeout):
+        before = time.time()
+        client.send_method_response(method_response, timeout=timeout)
+        after = time.time()
+        deadline = mqtt_pipeline.send_method_response.call_args[1]["deadline"]
+        if timeout is None:
+            assert deadline is None
+        else:
+            assert before + timeout <= deadline <= after + timeout
+
     @pytest.mark.it(
         "Waits for the completion of the 'send_method_response' pipeline operation before returning"
     )
@@ -906,6 +998,11 @@ class SharedClientSendMethodResponseTests(WaitsForEventCompletion):
                 client_exceptions.ClientError,
                 id="ProtocolClientError->ClientError",
             ),
+            pytest.param(
+                pipeline_exceptions.OperationTimeout,
+                client_exceptions.OperationTimeout,
+                id="OperationTimeout->OperationTimeout",
+            ),
             pytest.param(Exception, client_exceptions.ClientError, id="Exception->ClientError"),
         ],
     )
@@ -932,7 +1029,7 @@ class SharedClientSendMethodResponseTests(WaitsForEventCompletion):
 class SharedClientGetTwinTests(WaitsForEventCompletion):
     @pytest.fixture
     def patch_get_twin_to_return_fake_twin(self, fake_twin, mocker, mqtt_pipeline):
-        def immediate_callback(callback):
+        def immediate_callback(callback, deadline=None):
             callback(twin=fake_twin)
 
         mocker.patch.object(mqtt_pipeline, "get_twin", side_effect=immediate_callback)
@@ -959,6 +1056,22 @@ class SharedClientGetTwinTests(WaitsForEventCompletion):
         client.get_twin()
         assert mqtt_pipeline.get_twin.call_count == 1
 
+    @pytest.mark.it(
+        "Passes a deadline `timeout` seconds from now to the 'get_twin' pipeline operation (and to enabling twin, if needed), if a timeout is given"
+    )
+    @pytest.mark.parametrize("timeout", [None, 5], ids=["No timeout", "Timeout"])
+    def test_passes_deadline_from_timeout(self, client, mqtt_pipeline, timeout):
+        mqtt_pipeline.feature_enabled.__getitem__.return_value = False
+        before = time.time()
+        client.get_twin(timeout=timeout)
+        after = time.time()
+        deadline = mqtt_pipeline.get_twin.call_args[1]["deadline"]
+        if timeout is None:
+            assert deadline is None
+        else:
+            assert before + timeout <= deadline <= after + timeout
+        assert mqtt_pipeline.enable_feature.call_args[1]["deadline"] == deadline
+
     @pytest.mark.it(
         "Waits for the completion of the 'get_twin' pipeline operation before returning"
     )
@@ -1003,6 +1116,11 @@ class SharedClientGetTwinTests(WaitsForEventCompletion):
                 client_exceptions.ClientError,
                 id="ProtocolClientError->ClientError",
             ),
+            pytest.param(
+                pipeline_exceptions.OperationTimeout,
+                client_exceptions.OperationTimeout,
+                id="OperationTimeout->OperationTimeout",
+            ),
             pytest.param(Exception, client_exceptions.ClientError, id="Exception->ClientError"),
         ],
     )
@@ -1038,7 +1156,7 @@ class SharedClientPatchTwinReportedPropertiesTests(WaitsForEventCompletion):
         self, mocker, client, mqtt_pipeline, twin_patch_reported
     ):
         # patch this so x_get_twin won't block
-        def immediate_callback(patch, callback):
+        def immediate_callback(patch, callback, deadline=None):
             callback()
 
         mocker.patch.object(
@@ -1069,6 +1187,24 @@ class SharedClientPatchTwinReportedPropertiesTests(WaitsForEventCompletion):
             is twin_patch_reported
         )
 
+    @pytest.mark.it(
+        "Passes a deadline `timeout` seconds from now to the 'patch_twin_reported_properties' pipeline operation (and to enabling twin, if needed), if a timeout is given"
+    )
+    @pytest.mark.parametrize("timeout", [None, 5], ids=["No timeout", "Timeout"])
+    def test_passes_deadline_from_timeout(
+        self, client, mqtt_pipeline, twin_patch_reported, timeout
+    ):
+        mqtt_pipeline.feature_enabled.__getitem__.return_value = False
+        before = time.time()
+        client.patch_twin_reported_properties(twin_patch_reported, timeout=timeout)
+        after = time.time()
+        deadline = mqtt_pipeline.patch_twin_reported_properties.call_args[1]["deadline"]
+        if timeout is None:
+            assert deadline is None
+        else:
+            assert before + timeout <= deadline <= after + timeout
+        assert mqtt_pipeline.enable_feature.call_args[1]["deadline"] == deadline
+
     @pytest.mark.it(
         "Waits for the completion of the 'patch_twin_reported_properties' pipeline operation before returning"
     )
@@ -1111,6 +1247,11 @@ class SharedClientPatchTwinReportedPropertiesTests(WaitsForEventCompletion):
                 client_exceptions.ClientError,
                 id="ProtocolClientError->ClientError",
             ),
+            pytest.param(
+                pipeline_exceptions.OperationTimeout,
+                client_exceptions.OperationTimeout,
+                id="OperationTimeout->OperationTimeout",
+            ),
             pytest.param(Exception, client_exceptions.ClientError, id="Exception->ClientError"),
         ],
     )
@@ -1341,6 +1482,18 @@ class TestIoTHubDeviceClientInstantiation(
             client._mqtt_pipeline.on_c2d_message_received == client._inbox_manager.route_c2d_message
         )
 
+    @pytest.mark.it("Sets on_c2d_messages_received handler in the MQTTPipeline")
+    def test_sets_on_c2d_messages_received_handler_in_pipeline(
+        self, client_class, mqtt_pipeline, http_pipeline
+    ):
+        client = client_class(mqtt_pipeline, http_pipeline)
+
+        assert client._mqtt_pipeline.on_c2d_messages_received is not None
+        assert (
+            client._mqtt_pipeline.on_c2d_messages_received
+            == client._inbox_manager.route_c2d_messages
+        )
+
 
 @pytest.mark.describe("IoTHubDeviceClient (Synchronous) - .create_from_connection_string()")
 class TestIoTHubDeviceClientCreateFromConnectionString(
@@ -1450,6 +1603,13 @@ class TestIoTHubDeviceClientSendD2CMessage(
     pass
 
 
+@pytest.mark.describe("IoTHubDeviceClient (Synchronous) - .wait_for_capacity()")
+class TestIoTHubDeviceClientWaitForCapacity(
+    IoTHubDeviceClientTestsConfig, SharedClientWaitForCapacityTests
+):
+    pass
+
+
 @pytest.mark.describe("IoTHubDeviceClient (Synchronous) - .receive_message()")
 class TestIoTHubDeviceClientReceiveC2DMessage(
     IoTHubDeviceClientTestsConfig, WaitsForEventCompletion
@@ -1645,9 +1805,23 @@ class TestIoTHubDeviceClientGetStorageInfo(WaitsForEventCompletion, IoTHubDevice
         client.get_storage_info_for_blob(fake_blob_name)
         assert http_pipeline.get_storage_info_for_blob.call_count == 1
         assert http_pipeline.get_storage_info_for_blob.call_args == mocker.call(
-            fake_blob_name, callback=mocker.ANY
+            fake_blob_name, callback=mocker.ANY, deadline=None
         )
 
+    @pytest.mark.it(
+        "Passes a deadline `timeout` seconds from now to the 'get_storage_info_for_blob' pipeline operation, if a timeout is given"
+    )
+    @pytest.mark.parametrize("timeout", [None, 5], ids=["No timeout", "Timeout"])
+    def test_passes_deadline_from_timeout(self, client, http_pipeline, timeout):
+        before = time.time()
+        client.get_storage_info_for_blob("__fake_blob_name__", timeout=timeout)
+        after = time.time()
+        deadline = http_pipeline.get_storage_info_for_blob.call_args[1]["deadline"]
+        if timeout is None:
+            assert deadline is None
+        else:
+            assert before + timeout <= deadline <= after + timeout
+
     @pytest.mark.it(
         "Waits for the completion of the 'get_storage_info_for_blob' pipeline operation before returning"
     )
@@ -1675,6 +1849,11 @@ class TestIoTHubDeviceClientGetStorageInfo(WaitsForEventCompletion, IoTHubDevice
                 client_exceptions.ClientError,
                 id="ProtocolClientError->ClientError",
             ),
+            pytest.param(
+                pipeline_exceptions.OperationTimeout,
+                client_exceptions.OperationTimeout,
+                id="OperationTimeout->OperationTimeout",
+            ),
             pytest.param(Exception, client_exceptions.ClientError, id="Exception->ClientError"),
         ],
     )
@@ -1699,7 +1878,7 @@ class TestIoTHubDeviceClientGetStorageInfo(WaitsForEventCompletion, IoTHubDevice
         received_storage_info = client.get_storage_info_for_blob(fake_blob_name)
         assert http_pipeline.get_storage_info_for_blob.call_count == 1
         assert http_pipeline.get_storage_info_for_blob.call_args == mocker.call(
-            fake_blob_name, callback=mocker.ANY
+            fake_blob_name, callback=mocker.ANY, deadline=None
         )
 
         assert (
@@ -1727,6 +1906,26 @@ class TestIoTHubDeviceClientNotifyBlobUploadStatus(
         assert kwargs["status_code"] is status_code
         assert kwargs["status_description"] is status_description
 
+    @pytest.mark.it(
+        "Passes a deadline `timeout` seconds from now to the 'notify_blob_upload_status' pipeline operation, if a timeout is given"
+    )
+    @pytest.mark.parametrize("timeout", [None, 5], ids=["No timeout", "Timeout"])
+    def test_passes_deadline_from_timeout(self, client, http_pipeline, timeout):
+        before = time.time()
+        client.notify_blob_upload_status(
+            correlation_id="__fake_correlation_id__",
+            is_success="__fake_is_success__",
+            status_code="__fake_status_code__",
+            status_description="__fake_status_description__",
+            timeout=timeout,
+        )
+        after = time.time()
+        deadline = http_pipeline.notify_blob_upload_status.call_args[1]["deadline"]
+        if timeout is None:
+            assert deadline is None
+        else:
+            assert before + timeout <= deadline <= after + timeout
+
     @pytest.mark.it(
         "Waits for the completion of the 'notify_blob_upload_status' pipeline operation before returning"
     )
@@ -1756,6 +1955,11 @@ class TestIoTHubDeviceClientNotifyBlobUploadStatus(
                 client_exceptions.ClientError,
                 id="ProtocolClientError->ClientError",
             ),
+            pytest.param(
+                pipeline_exceptions.OperationTimeout,
+                client_exceptions.OperationTimeout,
+                id="OperationTimeout->OperationTimeout",
+            ),
             pytest.param(Exception, client_exceptions.ClientError, id="Exception->ClientError"),
         ],
     )
@@ -1779,6 +1983,155 @@ class TestIoTHubDeviceClientNotifyBlobUploadStatus(
             assert e_info.value.__cause__ is my_pipeline_error
 
 
+@pytest.mark.describe("IoTHubDeviceClient (Synchronous) - .upload_file()")
+class TestIoTHubDeviceClientUploadFile(IoTHubDeviceClientTestsConfig):
+    @pytest.fixture
+    def storage_info(self):
+        return {
+            "correlationId": "__fake_correlation_id__",
+            "hostName": "__fake_host_name__",
+            "containerName": "__fake_container_name__",
+            "blobName": "__fake_blob_name__",
+            "sasToken": "?__fake_sas_token__",
+        }
+
+    @pytest.fixture
+    def mock_uploader_cls(self, mocker):
+        mock_cls = mocker.patch.object(blob_upload, "BlobUploader")
+        mock_cls.return_value.upload_file.return_value = 201
+        return mock_cls
+
+    @pytest.fixture
+    def upload_client(self, mocker, client, storage_info):
+        client._mqtt_pipeline.pipeline_configuration = mocker.MagicMock()
+        mocker.patch.object(client, "get_storage_info_for_blob", return_value=storage_info)
+        mocker.patch.object(client, "notify_blob_upload_status")
+        return client
+
+    @pytest.mark.it("Gets storage info for the blob")
+    def test_gets_storage_info(self, mocker, upload_client, mock_uploader_cls):
+        upload_client.upload_file("__fake_blob_name__", "some/file/path")
+        assert upload_client.get_storage_info_for_blob.call_count == 1
+        assert upload_client.get_storage_info_for_blob.call_args == mocker.call(
+            "__fake_blob_name__", timeout=None
+        )
+
+    @pytest.mark.it(
+        "Uploads the file with a BlobUploader for the blob URL from the storage info, using the client's TLS and proxy settings"
+    )
+    def test_uploads_file(self, mocker, upload_client, mock_uploader_cls, storage_info):
+        pipeline_configuration = upload_client._mqtt_pipeline.pipeline_configuration
+        upload_client.upload_file(
+            "__fake_blob_name__",
+            "some/file/path",
+            block_size=1024,
+            max_concurrency=2,
+            manifest_path="some/manifest/path",
+        )
+        assert mock_uploader_cls.call_count == 1
+        assert mock_uploader_cls.call_args == mocker.call(
+            blob_upload.get_blob_url(storage_info),
+            block_size=1024,
+            max_concurrency=2,
+            manifest_path="some/manifest/path",
+            server_verification_cert=pipeline_configuration.server_verification_cert,
+            cipher=pipeline_configuration.cipher,
+            proxy_options=pipeline_configuration.proxy_options,
+            deadline=None,
+        )
+        assert mock_uploader_cls.return_value.upload_file.call_args == mocker.call("some/file/path")
+
+    @pytest.mark.it("Notifies the IoTHub of a successful upload")
+    def test_notifies_success(self, mocker, upload_client, mock_uploader_cls, storage_info):
+        upload_client.upload_file("__fake_blob_name__", "some/file/path")
+        assert upload_client.notify_blob_upload_status.call_count == 1
+        kwargs = upload_client.notify_blob_upload_status.call_args[1]
+        assert kwargs["correlation_id"] == storage_info["correlationId"]
+        assert kwargs["is_success"] is True
+        assert kwargs["status_code"] == 201
+        assert kwargs["status_description"] == "Uploaded __fake_blob_name__"
+
+    @pytest.mark.it(
+        "Does not send the local path of the file to the IoTHub, even if reading the file fails"
+    )
+    def test_no_file_path(self, upload_client, mock_uploader_cls):
+        upload_client.upload_file("__fake_blob_name__", "some/file/path")
+        kwargs = upload_client.notify_blob_upload_status.call_args[1]
+        assert "some/file/path" not in kwargs["status_description"]
+
+        my_error = IOError(2, "No such file or directory", "some/file/path")
+        mock_uploader_cls.return_value.upload_file.side_effect = my_error
+        with pytest.raises(IOError):
+            upload_client.upload_file("__fake_blob_name__", "some/file/path")
+        kwargs = upload_client.notify_blob_upload_status.call_args[1]
+        assert "some/file/path" not in kwargs["status_description"]
+
+    @pytest.mark.it(
+        "Notifies the IoTHub of a failed upload and raises the error, if the upload fails"
+    )
+    def test_notifies_failure(self, mocker, upload_client, mock_uploader_cls, storage_info):
+        my_error = client_exceptions.ServiceError("Azure Storage returned 403")
+        mock_uploader_cls.return_value.upload_file.side_effect = my_error
+        with pytest.raises(client_exceptions.ServiceError) as e_info:
+            upload_client.upload_file("__fake_blob_name__", "some/file/path")
+        assert e_info.value is my_error
+        assert upload_client.notify_blob_upload_status.call_count == 1
+        kwargs = upload_client.notify_blob_upload_status.call_args[1]
+        assert kwargs["correlation_id"] == storage_info["correlationId"]
+        assert kwargs["is_success"] is False
+
+    @pytest.mark.it(
+        "Notifies the IoTHub of a failed upload with the status code returned by Azure Storage"
+    )
+    @pytest.mark.parametrize(
+        "response_status_code, expected_status_code",
+        [pytest.param(403, 403, id="Error response"), pytest.param(None, 500, id="No response")],
+    )
+    def test_notifies_failure_status_code(
+        self, upload_client, mock_uploader_cls, response_status_code, expected_status_code
+    ):
+        if response_status_code is None:
+            cause = requests.exceptions.ConnectionError()
+        else:
+            response = requests.Response()
+            response.status_code = response_status_code
+            cause = requests.exceptions.HTTPError(response=response)
+        my_error = client_exceptions.ServiceError("Azure Storage returned an error", cause=cause)
+        mock_uploader_cls.return_value.upload_file.side_effect = my_error
+        with pytest.raises(client_exceptions.ServiceError):
+            upload_client.upload_file("__fake_blob_name__", "some/file/path")
+        kwargs = upload_client.notify_blob_upload_status.call_args[1]
+        assert kwargs["status_code"] == expected_status_code
+
+    @pytest.mark.it(
+        "Bounds getting the storage info, the upload and the notification by the timeout, if one is given"
+    )
+    def test_timeout(self, mocker, upload_client, mock_uploader_cls):
+        mocker.patch.object(time, "time", return_value=1000.0)
+        upload_client.upload_file("__fake_blob_name__", "some/file/path", timeout=30)
+
+        assert upload_client.get_storage_info_for_blob.call_args[1]["timeout"] == 30
+        assert mock_uploader_cls.call_args[1]["deadline"] == 1030.0
+        assert upload_client.notify_blob_upload_status.call_args[1]["timeout"] == 30
+
+    @pytest.mark.it(
+        "Raises an upload's OperationTimeout without notifying the IoTHub, if the timeout has passed"
+    )
+    def test_timeout_passed(self, mocker, upload_client, mock_uploader_cls):
+        mock_time = mocker.patch.object(time, "time", return_value=1000.0)
+        my_error = client_exceptions.OperationTimeout("Upload did not complete")
+
+        def upload_file(file_path):
+            mock_time.return_value = 1031.0
+            raise my_error
+
+        mock_uploader_cls.return_value.upload_file.side_effect = upload_file
+        with pytest.raises(client_exceptions.OperationTimeout) as e_info:
+            upload_client.upload_file("__fake_blob_name__", "some/file/path", timeout=30)
+        assert e_info.value is my_error
+        assert upload_client.notify_blob_upload_status.call_count == 0
+
+
 @pytest.mark.describe("IoTHubDeviceClient (Synchronous) - PROPERTY .on_message_received")
 class TestIoTHubDeviceClientPROPERTYOnMessageReceivedHandler(
     IoTHubDeviceClientTestsConfig, SharedIoTHubClientPROPERTYHandlerTests
@@ -1792,6 +2145,28 @@ class TestIoTHubDeviceClientPROPERTYOnMessageReceivedHandler(
         return pipeline_constant.C2D_MSG
 
 
+@pytest.mark.describe("IoTHubDeviceClient (Synchronous) - PROPERTY .on_message_batch_received")
+class TestIoTHubDeviceClientPROPERTYOnMessageBatchReceivedHandler(
+    IoTHubDeviceClientTestsConfig, SharedIoTHubClientPROPERTYHandlerTests
+):
+    @pytest.fixture
+    def handler_name(self):
+        return "on_message_batch_received"
+
+    @pytest.fixture
+    def feature_name(self):
+        return pipeline_constant.C2D_MSG
+
+    @pytest.mark.it(
+        "Does not disable the corresponding feature when .on_message_received is set to None while it is set"
+    )
+    def test_on_message_received_set_to_none(self, client, handler, mqtt_pipeline):
+        client.on_message_batch_received = handler
+        mqtt_pipeline.feature_enabled.__getitem__.return_value = True
+        client.on_message_received = None
+        assert mqtt_pipeline.disable_feature.call_count == 0
+
+
 @pytest.mark.describe("IoTHubDeviceClient (Synchronous) - PROPERTY .on_method_request_received")
 class TestIoTHubDeviceClientPROPERTYOnMethodRequestReceivedHandler(
     IoTHubDeviceClientTestsConfig, SharedIoTHubClientPROPERTYHandlerTests
@@ -1827,6 +2202,15 @@ class TestIoTHubDeviceClientPROPERTYConnected(
     pass
 
 
+@pytest.mark.describe(
+    "IoTHubDeviceClient (Synchronous) - PROPERTY .pending_ops, .pending_bytes, .has_capacity"
+)
+class TestIoTHubDeviceClientPROPERTYFlowControl(
+    IoTHubDeviceClientTestsConfig, SharedIoTHubClientPROPERTYFlowControlTests
+):
+    pass
+
+
 @pytest.mark.describe("IoTHubDeviceClient (Synchronous) - OCCURANCE: Connect")
 class TestIoTHubDeviceClientOCCURANCEConnect(
     IoTHubDeviceClientTestsConfig, SharedIoTHubClientOCCURANCEConnectTests
@@ -1891,6 +2275,18 @@ class TestIoTHubModuleClientInstantiation(
             == client._inbox_manager.route_input_message
         )
 
+    @pytest.mark.it("Sets on_input_messages_received handler in the MQTTPipeline")
+    def test_sets_on_input_messages_received_handler_in_pipeline(
+        self, client_class, mqtt_pipeline, http_pipeline
+    ):
+        client = client_class(mqtt_pipeline, http_pipeline)
+
+        assert client._mqtt_pipeline.on_input_messages_received is not None
+        assert (
+            client._mqtt_pipeline.on_input_messages_received
+            == client._inbox_manager.route_input_messages
+        )
+
 
 @pytest.mark.describe("IoTHubModuleClient (Synchronous) - .create_from_connection_string()")
 class TestIoTHubModuleClientCreateFromConnectionString(
@@ -2039,6 +2435,13 @@ class TestIoTHubNModuleClientSendD2CMessage(
     pass
 
 
+@pytest.mark.describe("IoTHubModuleClient (Synchronous) - .wait_for_capacity()")
+class TestIoTHubModuleClientWaitForCapacity(
+    IoTHubModuleClientTestsConfig, SharedClientWaitForCapacityTests
+):
+    pass
+
+
 @pytest.mark.describe("IoTHubModuleClient (Synchronous) - .send_message_to_output()")
 class TestIoTHubModuleClientSendToOutput(IoTHubModuleClientTestsConfig, WaitsForEventCompletion):
     @pytest.mark.it("Begins a 'send_output_message' pipeline operation")
@@ -2049,6 +2452,20 @@ class TestIoTHubModuleClientSendToOutput(IoTHubModuleClientTestsConfig, WaitsFor
         assert mqtt_pipeline.send_output_message.call_args[0][0] is message
         assert message.output_name == output_name
 
+    @pytest.mark.it(
+        "Passes a deadline `timeout` seconds from now to the 'send_output_message' pipeline operation, if a timeout is given"
+    )
+    @pytest.mark.parametrize("timeout", [None, 5], ids=["No timeout", "Timeout"])
+    def test_passes_deadline_from_timeout(self, client, mqtt_pipeline, message, timeout):
+        before = time.time()
+        client.send_message_to_output(message, "some_output", timeout=timeout)
+        after = time.time()
+        deadline = mqtt_pipeline.send_output_message.call_args[1]["deadline"]
+        if timeout is None:
+            assert deadline is None
+        else:
+            assert before + timeout <= deadline <= after + timeout
+
     @pytest.mark.it(
         "Waits for the completion of the 'send_output_message' pipeline operation before returning"
     )
@@ -2092,6 +2509,11 @@ class TestIoTHubModuleClientSendToOutput(IoTHubModuleClientTestsConfig, WaitsFor
                 client_exceptions.ClientError,
                 id="ProtocolClientError->ClientError",
             ),
+            pytest.param(
+                pipeline_exceptions.OperationTimeout,
+                client_exceptions.OperationTimeout,
+                id="OperationTimeout->OperationTimeout",
+            ),
             pytest.param(Exception, client_exceptions.ClientError, id="Exception->ClientError"),
         ],
     )
@@ -2163,7 +2585,7 @@ class TestIoTHubModuleClientSendToOutput(IoTHubModuleClientTestsConfig, WaitsFor
     @pytest.mark.it("Does not raises error when message data size is equal to 256 KB")
     def test_raises_error_when_message_to_output_data_equal_to_256(self, client, mqtt_pipeline):
         output_name = "some_output"
-        data_input = "a" * 262095
+        data_input = "a" * 262144
         message = Message(data_input)
         # This check was put as message class may undergo the default content type encoding change
         # and the above calculation will change.
@@ -2402,6 +2824,22 @@ class TestIoTHubModuleClientInvokeMethod(WaitsForEventCompletion, IoTHubModuleCl
         assert http_pipeline.invoke_method.call_args[0][0] is device_id
         assert http_pipeline.invoke_method.call_args[0][1] is method_params
 
+    @pytest.mark.it(
+        "Passes a deadline `timeout` seconds from now to the 'invoke_method' pipeline operation, if a timeout is given"
+    )
+    @pytest.mark.parametrize("timeout", [None, 5], ids=["No timeout", "Timeout"])
+    def test_passes_deadline_from_timeout(self, client, http_pipeline, timeout):
+        before = time.time()
+        client.invoke_method(
+            {"methodName": "__fake_method_name__"}, "__fake_device_id__", timeout=timeout
+        )
+        after = time.time()
+        deadline = http_pipeline.invoke_method.call_args[1]["deadline"]
+        if timeout is None:
+            assert deadline is None
+        else:
+            assert before + timeout <= deadline <= after + timeout
+
     @pytest.mark.it("Begins a 'invoke_method' HTTPPipeline operation where the target is a module")
     def test_calls_pipeline_invoke_method_for_module(self, client, http_pipeline):
         method_params = {"methodName": "__fake_method_name__"}
@@ -2441,6 +2879,11 @@ class TestIoTHubModuleClientInvokeMethod(WaitsForEventCompletion, IoTHubModuleCl
                 client_exceptions.ClientError,
                 id="ProtocolClientError->ClientError",
             ),
+            pytest.param(
+                pipeline_exceptions.OperationTimeout,
+                client_exceptions.OperationTimeout,
+                id="OperationTimeout->OperationTimeout",
+            ),
             pytest.param(Exception, client_exceptions.ClientError, id="Exception->ClientError"),
         ],
     )
@@ -2474,6 +2917,28 @@ class TestIoTHubModuleClientPROPERTYOnMessageReceivedHandler(
         return pipeline_constant.INPUT_MSG
 
 
+@pytest.mark.describe("IoTHubModuleClient (Synchronous) - PROPERTY .on_message_batch_received")
+class TestIoTHubModuleClientPROPERTYOnMessageBatchReceivedHandler(
+    IoTHubModuleClientTestsConfig, SharedIoTHubClientPROPERTYHandlerTests
+):
+    @pytest.fixture
+    def handler_name(self):
+        return "on_message_batch_received"
+
+    @pytest.fixture
+    def feature_name(self):
+        return pipeline_constant.INPUT_MSG
+
+    @pytest.mark.it(
+        "Does not disable the corresponding feature when .on_message_received is set to None while it is set"
+    )
+    def test_on_message_received_set_to_none(self, client, handler, mqtt_pipeline):
+        client.on_message_batch_received = handler
+        mqtt_pipeline.feature_enabled.__getitem__.return_value = True
+        client.on_message_received = None
+        assert mqtt_pipeline.disable_feature.call_count == 0
+
+
 @pytest.mark.describe("IoTHubModuleClient (Synchronous) - PROPERTY .on_method_request_received")
 class TestIoTHubModuleClientPROPERTYOnMethodRequestReceivedHandler(
     IoTHubModuleClientTestsConfig, SharedIoTHubClientPROPERTYHandlerTests
@@ -2509,6 +2974,15 @@ class TestIoTHubModuleClientPROPERTYConnected(
     pass
 
 
+@pytest.mark.describe(
+    "IoTHubModuleClient (Synchronous) - PROPERTY .pending_ops, .pending_bytes, .has_capacity"
+)
+class TestIoTHubModuleClientPROPERTYFlowControl(
+    IoTHubModuleClientTestsConfig, SharedIoTHubClientPROPERTYFlowControlTests
+):
+    pass
+
+
 @pytest.mark.describe("IoTHubModuleClient (Synchronous) - OCCURANCE: Connect")
 class TestIoTHubModuleClientOCCURANCEConnect(
     IoTHubModuleClientTestsConfig, SharedIoTHubClientOCCURANCEConnectTests
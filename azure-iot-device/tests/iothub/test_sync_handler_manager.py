@@ -8,9 +8,12 @@ import pytest
 import threading
 import time
 import sys
+import concurrent.futures
 from azure.iot.device.common import handle_exceptions
 from azure.iot.device.iothub.sync_handler_manager import SyncHandlerManager, HandlerManagerException
+from azure.iot.device.iothub.sync_handler_manager import HandlerRunnerKillerSentinel
 from azure.iot.device.iothub.sync_handler_manager import MESSAGE, METHOD, TWIN_DP_PATCH
+from azure.iot.device.iothub.sync_handler_manager import MESSAGE_BATCH, MAX_BATCH_SIZE
 from azure.iot.device.iothub.inbox_manager import InboxManager
 from azure.iot.device.iothub.sync_inbox import SyncClientInbox
 
@@ -32,6 +35,23 @@ all_internal_handlers = [MESSAGE, METHOD, TWIN_DP_PATCH]
 all_handlers = [s.lstrip("_") for s in all_internal_handlers]
 
 
+class BatchRecorder(object):
+    """Handler which records the batches it is invoked with, in a threadsafe manner"""
+
+    def __init__(self):
+        self.batches = []
+        self.lock = threading.Lock()
+
+    def __call__(self, batch):
+        with self.lock:
+            self.batches.append(batch)
+
+    @property
+    def items(self):
+        with self.lock:
+            return [item for batch in self.batches for item in batch]
+
+
 class ThreadsafeMock(object):
     """ This class provides (some) Mock functionality in a threadsafe manner, specifically, it
     ensures that the 'call_count' attribute will be accurate when the mock is called from another
@@ -124,6 +144,138 @@ class TestStop(object):
         assert mth_inbox.empty()
 
 
+def wait_for_runner_to_stop(inbox, timeout=5):
+    """Wait for the handler invocations to stop being submitted for items put in the inbox"""
+    deadline = time.time() + timeout
+    while inbox.on_item_put is not None:
+        assert time.time() < deadline, "Handler invocations are still being submitted"
+        time.sleep(0.01)
+
+
+@pytest.mark.describe("SyncHandlerManager - Shared handler executor")
+class TestSharedHandlerExecutor(object):
+    @pytest.fixture
+    def handler_executor(self):
+        executor = concurrent.futures.ThreadPoolExecutor(max_workers=2)
+        yield executor
+        executor.shutdown()
+
+    @pytest.fixture
+    def handler_manager(self, inbox_manager, handler_executor):
+        hm = SyncHandlerManager(inbox_manager, handler_executor=handler_executor)
+        yield hm
+        hm.stop()
+
+    @pytest.mark.it("Does not start a runner thread when a handler is set")
+    @pytest.mark.parametrize("handler_name", all_handlers)
+    def test_no_thread(self, handler_manager, handler, handler_name):
+        threads_before = threading.active_count()
+        setattr(handler_manager, handler_name, handler)
+        assert threading.active_count() == threads_before
+
+    @pytest.mark.it("Invokes the handler in the shared executor for each item put in the inbox")
+    def test_invokes_handler(self, mocker, inbox_manager, handler_manager, handler_executor):
+        invoked_on = []
+        invoked = threading.Semaphore(0)
+
+        def handler(arg):
+            invoked_on.append(arg)
+            invoked.release()
+
+        spy_submit = mocker.spy(handler_executor, "submit")
+        handler_manager.on_message_received = handler
+        inbox = inbox_manager.get_unified_message_inbox()
+        items = [mocker.MagicMock() for _ in range(10)]
+        for item in items:
+            inbox._put(item)
+        for _ in items:
+            assert invoked.acquire(timeout=5)
+        assert spy_submit.call_count == 10
+        assert sorted(invoked_on, key=id) == sorted(items, key=id)
+        assert inbox.empty()
+
+    @pytest.mark.it("Invokes the handler for items that were in the inbox before it was set")
+    def test_invokes_handler_for_existing_items(self, mocker, inbox_manager, handler_manager):
+        mock_handler = ThreadsafeMock()
+        inbox = inbox_manager.get_method_request_inbox()
+        for _ in range(5):
+            inbox._put(mocker.MagicMock())
+        handler_manager.on_method_request_received = mock_handler
+        handler_manager.stop()
+        assert mock_handler.call_count == 5
+        assert inbox.empty()
+
+    @pytest.mark.it("Completes all pending handler invocations when stopped")
+    def test_completes_pending(self, mocker, inbox_manager, handler_manager):
+        mock_handler = ThreadsafeMock()
+        handler_manager.on_message_received = mock_handler
+        inbox = inbox_manager.get_unified_message_inbox()
+        for _ in range(200):
+            inbox._put(mocker.MagicMock())
+        handler_manager.stop()
+        assert mock_handler.call_count == 200
+        assert handler_manager._handler_runners[MESSAGE] is None
+        assert inbox.on_item_put is None
+
+    @pytest.mark.it(
+        "Sends a HandlerManagerException to the background exception handler if the handler raises"
+    )
+    def test_handler_raises(self, mocker, inbox_manager, handler_manager, arbitrary_exception):
+        background_exc_spy = mocker.spy(handle_exceptions, "handle_background_exception")
+
+        def handler(arg):
+            raise arbitrary_exception
+
+        handler_manager.on_message_received = handler
+        inbox_manager.get_unified_message_inbox()._put(mocker.MagicMock())
+        handler_manager.stop()
+        assert background_exc_spy.call_count == 1
+        e = background_exc_spy.call_args[0][0]
+        assert isinstance(e, HandlerManagerException)
+        assert e.__cause__ is arbitrary_exception
+
+    @pytest.mark.it(
+        "Stops invoking the handler, without passing it the HandlerRunnerKillerSentinel, if one is found in the inbox"
+    )
+    def test_sentinel(self, mocker, inbox_manager, handler_manager):
+        mock_handler = ThreadsafeMock()
+        handler_manager.on_message_received = mock_handler
+        inbox = inbox_manager.get_unified_message_inbox()
+        item = mocker.MagicMock()
+        # Put everything in the inbox before the invocation is submitted
+        runner = inbox.on_item_put
+        inbox.on_item_put = None
+        inbox._put_many([HandlerRunnerKillerSentinel(), item])
+        inbox.on_item_put = runner
+        runner()
+        wait_for_runner_to_stop(inbox)
+        handler_manager.stop()
+
+        assert mock_handler.call_count == 0
+        assert item in inbox
+
+    @pytest.mark.it(
+        "Invokes a batch handler with the items before a HandlerRunnerKillerSentinel, then stops invoking it"
+    )
+    def test_sentinel_in_batch(self, mocker, inbox_manager, handler_manager):
+        recorder = BatchRecorder()
+        handler_manager.on_message_batch_received = recorder
+        inbox = inbox_manager.get_unified_message_inbox()
+        items = [mocker.MagicMock() for _ in range(3)]
+        # Put everything in the inbox before the invocation is submitted, so that it is all taken
+        # by a single invocation
+        runner = inbox.on_item_put
+        inbox.on_item_put = None
+        inbox._put_many(items[:2] + [HandlerRunnerKillerSentinel()] + items[2:])
+        inbox.on_item_put = runner
+        runner()
+        wait_for_runner_to_stop(inbox)
+        handler_manager.stop()
+
+        assert recorder.batches == [items[:2]]
+        assert items[2] in inbox
+
+
 @pytest.mark.describe("SyncHandlerManager - .ensure_running()")
 class TestEnsureRunning(object):
     @pytest.fixture(
@@ -404,3 +556,92 @@ class TestSyncHandlerManagerPropertyOnTwinDesiredPropertiesPatchReceived(
     @pytest.fixture
     def inbox(self, inbox_manager):
         return inbox_manager.get_twin_patch_inbox()
+
+
+@pytest.mark.describe("SyncHandlerManager - PROPERTY: .on_message_batch_received")
+class TestSyncHandlerManagerPropertyOnMessageBatchReceived(object):
+    @pytest.fixture(params=["Runner thread", "Shared handler executor"])
+    def handler_manager(self, request, inbox_manager):
+        if request.param == "Runner thread":
+            hm = SyncHandlerManager(inbox_manager)
+            yield hm
+            hm.stop()
+        else:
+            executor = concurrent.futures.ThreadPoolExecutor(max_workers=2)
+            hm = SyncHandlerManager(inbox_manager, handler_executor=executor)
+            yield hm
+            hm.stop()
+            executor.shutdown()
+
+    @pytest.fixture
+    def inbox(self, inbox_manager):
+        return inbox_manager.get_unified_message_inbox()
+
+    @pytest.mark.it("Is initialized to None, and can be both read and written to")
+    def test_read_write(self, handler_manager, handler):
+        assert handler_manager.on_message_batch_received is None
+        handler_manager.on_message_batch_received = handler
+        assert handler_manager.on_message_batch_received is handler
+        handler_manager.on_message_batch_received = None
+        assert handler_manager.on_message_batch_received is None
+
+    @pytest.mark.it("Starts a handler runner when set, and stops it when set back to None")
+    def test_runner(self, handler_manager, handler):
+        assert handler_manager._handler_runners[MESSAGE_BATCH] is None
+        handler_manager.on_message_batch_received = handler
+        assert handler_manager._handler_runners[MESSAGE_BATCH] is not None
+        handler_manager.on_message_batch_received = None
+        assert handler_manager._handler_runners[MESSAGE_BATCH] is None
+
+    @pytest.mark.it(
+        "Is invoked with a list of all the items waiting in the unified message inbox, in order"
+    )
+    def test_invoked_with_batch(self, mocker, handler_manager, inbox):
+        items = [mocker.MagicMock() for _ in range(20)]
+        for item in items:
+            inbox._put(item)
+        recorder = BatchRecorder()
+        handler_manager.on_message_batch_received = recorder
+        handler_manager.stop()
+
+        assert recorder.items == items
+        assert len(recorder.batches) < len(items)
+        assert inbox.empty()
+
+    @pytest.mark.it("Is invoked with at most MAX_BATCH_SIZE items at a time")
+    def test_max_batch_size(self, mocker, handler_manager, inbox):
+        items = [mocker.MagicMock() for _ in range(MAX_BATCH_SIZE * 2 + 1)]
+        for item in items:
+            inbox._put(item)
+        recorder = BatchRecorder()
+        handler_manager.on_message_batch_received = recorder
+        handler_manager.stop()
+
+        assert recorder.items == items
+        assert max(len(batch) for batch in recorder.batches) <= MAX_BATCH_SIZE
+
+    @pytest.mark.it("Is invoked for items which are put in the inbox while it is set")
+    def test_invoked_for_new_items(self, mocker, handler_manager, inbox):
+        recorder = BatchRecorder()
+        handler_manager.on_message_batch_received = recorder
+        items = [mocker.MagicMock() for _ in range(10)]
+        inbox._put_many(items)
+        handler_manager.stop()
+
+        assert recorder.items == items
+
+    @pytest.mark.it("Raises a ValueError if set while .on_message_received is set")
+    def test_exclusive_with_on_message_received(self, handler_manager, handler):
+        handler_manager.on_message_received = handler
+        with pytest.raises(ValueError):
+            handler_manager.on_message_batch_received = handler
+        assert handler_manager.on_message_batch_received is None
+
+    @pytest.mark.it(
+        "Causes a ValueError to be raised if .on_message_received is set while it is set"
+    )
+    def test_on_message_received_exclusive(self, handler_manager, handler):
+        handler_manager.on_message_batch_received = handler
+        with pytest.raises(ValueError):
+            handler_manager.on_message_received = handler
+        assert handler_manager.on_message_received is None
@@ -65,6 +65,58 @@ class TestSyncClientInboxPut(object):
         assert not inbox.empty()
         assert item in inbox
 
+    @pytest.mark.it("Calls the on_item_put function after adding the item, if one is set")
+    def test_calls_on_item_put(self, mocker):
+        inbox = SyncClientInbox()
+        item = mocker.MagicMock()
+        inbox.on_item_put = mocker.MagicMock(side_effect=lambda: item in inbox)
+        inbox._put(item)
+        assert inbox.on_item_put.call_count == 1
+        assert inbox.on_item_put.call_args == mocker.call()
+
+
+@pytest.mark.describe("SyncClientInbox - ._put_many()")
+class TestSyncClientInboxPutMany(object):
+    @pytest.mark.it("Adds the given items to the inbox, in order")
+    def test_adds_items(self, mocker):
+        inbox = SyncClientInbox()
+        items = [mocker.MagicMock() for _ in range(3)]
+        inbox._put_many(items)
+        assert inbox.qsize() == 3
+        assert [inbox.get(block=False) for _ in items] == items
+
+    @pytest.mark.it("Wakes up a getter waiting for each item")
+    def test_wakes_getters(self, mocker):
+        inbox = SyncClientInbox()
+        items = [mocker.MagicMock() for _ in range(3)]
+        gotten = []
+        threads = [
+            threading.Thread(target=lambda: gotten.append(inbox.get(timeout=5))) for _ in items
+        ]
+        for thread in threads:
+            thread.start()
+        inbox._put_many(items)
+        for thread in threads:
+            thread.join()
+        assert sorted(gotten, key=id) == sorted(items, key=id)
+
+    @pytest.mark.it("Counts the items as tasks to be done, for .join()")
+    def test_join(self, mocker):
+        inbox = SyncClientInbox()
+        inbox._put_many([mocker.MagicMock(), mocker.MagicMock()])
+        assert inbox._queue.unfinished_tasks == 2
+        for _ in range(2):
+            inbox.get()
+            inbox._queue.task_done()
+        inbox.join()
+
+    @pytest.mark.it("Calls the on_item_put function once for each item, if one is set")
+    def test_calls_on_item_put(self, mocker):
+        inbox = SyncClientInbox()
+        inbox.on_item_put = mocker.MagicMock()
+        inbox._put_many([mocker.MagicMock(), mocker.MagicMock()])
+        assert inbox.on_item_put.call_count == 2
+
 
 @pytest.mark.describe("SyncClientInbox - .get()")
 class TestSyncClientInboxGet(object):
@@ -117,6 +169,19 @@ class TestSyncClientInboxGet(object):
             inbox.get(block=False)
 
 
+@pytest.mark.describe("SyncClientInbox - .qsize()")
+class TestSyncClientInboxQsize(object):
+    @pytest.mark.it("Returns the number of items in the inbox")
+    def test_qsize(self, mocker):
+        inbox = SyncClientInbox()
+        assert inbox.qsize() == 0
+        inbox._put(mocker.MagicMock())
+        inbox._put(mocker.MagicMock())
+        assert inbox.qsize() == 2
+        inbox.get()
+        assert inbox.qsize() == 1
+
+
 @pytest.mark.describe("SyncClientInbox - .clear()")
 class TestSyncClientInboxClear(object):
     @pytest.mark.it("Clears all items from the inbox")
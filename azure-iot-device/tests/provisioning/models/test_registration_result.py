@@ -45,6 +45,20 @@ class TestRegistrationResult(object):
         assert registration_result.registration_state.last_update_date_time == fake_last_update_dttm
         assert registration_result.registration_state.etag == fake_etag
 
+    @pytest.mark.it("Has a poll count of 0 and no time to assigned by default")
+    def test_registration_result_default_latency(self):
+        registration_result = create_registration_result()
+        assert registration_result.poll_count == 0
+        assert registration_result.time_to_assigned is None
+
+    @pytest.mark.it("Instantiates with a poll count and time to assigned")
+    def test_registration_result_latency(self):
+        registration_result = RegistrationResult(
+            fake_operation_id, "assigned", poll_count=3, time_to_assigned=4.5
+        )
+        assert registration_result.poll_count == 3
+        assert registration_result.time_to_assigned == 4.5
+
     @pytest.mark.it("Has a to string representation composed of registration state and status")
     def test_registration_result_to_string(self):
         fake_registration_state = create_registration_state()
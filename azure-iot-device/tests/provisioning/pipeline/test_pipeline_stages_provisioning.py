@@ -13,6 +13,7 @@ from azure.iot.device.provisioning.pipeline import (
     pipeline_ops_provisioning,
 )
 from azure.iot.device.common.pipeline import pipeline_ops_base, pipeline_events_base
+from azure.iot.device.common import alarm
 from tests.common.pipeline import pipeline_stage_test
 from azure.iot.device.exceptions import ServiceError
 
@@ -24,6 +25,9 @@ from tests.common.pipeline.helpers import StageRunOpTestBase
 from azure.iot.device import exceptions
 from azure.iot.device.provisioning.pipeline import constant
 import threading
+import time
+import weakref
+import gc
 
 logging.basicConfig(level=logging.DEBUG)
 this_module = sys.modules[__name__]
@@ -51,6 +55,11 @@ fake_x509_cert_key_file = "where_to_find_them"
 fake_pass_phrase = "alohomora"
 
 
+def fire_alarm(mock_alarm_schedule):
+    function = mock_alarm_schedule.call_args[0][1]
+    function(*mock_alarm_schedule.call_args[1]["args"])
+
+
 class FakeRegistrationResult(object):
     def __init__(self, operation_id, status, state):
         self.operationId = operation_id
@@ -143,9 +152,7 @@ class TestRegistrationStageWithRegisterOperation(StageRunOpTestBase, Registratio
 
     @pytest.fixture
     def request_body(self, request_payload):
-        return '{{"payload": {json_payload}, "registrationId": "{reg_id}"}}'.format(
-            reg_id=fake_registration_id, json_payload=json.dumps(request_payload)
-        )
+        return {"payload": request_payload, "registrationId": fake_registration_id}
 
     @pytest.mark.it(
         "Sends a new RequestAndResponseOperation down the pipeline, configured to request a registration from provisioning service"
@@ -159,7 +166,7 @@ class TestRegistrationStageWithRegisterOperation(StageRunOpTestBase, Registratio
         assert new_op.request_type == "register"
         assert new_op.method == "PUT"
         assert new_op.resource_location == "/"
-        assert new_op.request_body == request_body
+        assert json.loads(new_op.request_body.decode("utf-8")) == request_body
 
         # kill the timer
         new_op.complete()
@@ -214,9 +221,7 @@ class TestRegistrationStageWithRegisterOperationCompleted(RegistrationStageConfi
 
     @pytest.fixture
     def request_body(self, request_payload):
-        return '{{"payload": {json_payload}, "registrationId": "{reg_id}"}}'.format(
-            reg_id=fake_registration_id, json_payload=json.dumps(request_payload)
-        )
+        return {"payload": request_payload, "registrationId": fake_registration_id}
 
     @pytest.mark.it(
         "Completes the RegisterOperation unsuccessfully, with the error from the RequestAndResponseOperation, if the RequestAndResponseOperation is completed unsuccessfully"
@@ -372,9 +377,7 @@ class TestRegistrationStageWithRegisterOperationCompleted(RegistrationStageConfi
     def test_spawns_another_op_request_and_response_op_completed_success_with_status_assigning(
         self, mocker, stage, request_payload, send_registration_op, request_and_response_op
     ):
-        mock_timer = mocker.patch(
-            "azure.iot.device.provisioning.pipeline.pipeline_stages_provisioning.Timer"
-        )
+        mock_alarm_schedule = mocker.patch.object(alarm, "schedule")
 
         mocker.spy(send_registration_op, "spawn_worker_op")
         registration_result = create_registration_result(request_payload, "assigning")
@@ -391,8 +394,7 @@ class TestRegistrationStageWithRegisterOperationCompleted(RegistrationStageConfi
 
         assert send_registration_op.retry_after_timer is None
         assert send_registration_op.polling_timer is not None
-        timer_callback = mock_timer.call_args[0][1]
-        timer_callback()
+        fire_alarm(mock_alarm_schedule)
 
         assert request_and_response_op.completed
         assert request_and_response_op.error is None
@@ -435,9 +437,7 @@ class TestRegistrationStageWithRetryOfRegisterOperation(RetryStageConfig):
 
     @pytest.fixture
     def request_body(self, request_payload):
-        return '{{"payload": {json_payload}, "registrationId": "{reg_id}"}}'.format(
-            reg_id=fake_registration_id, json_payload=json.dumps(request_payload)
-        )
+        return {"payload": request_payload, "registrationId": fake_registration_id}
 
     @pytest.mark.it(
         "Decodes, deserializes the response from RequestAndResponseOperation and retries the op if the status code > 429"
@@ -445,9 +445,7 @@ class TestRegistrationStageWithRetryOfRegisterOperation(RetryStageConfig):
     def test_stage_retries_op_if_next_stage_responds_with_status_code_greater_than_429(
         self, mocker, stage, op, request_body, request_payload
     ):
-        mock_timer = mocker.patch(
-            "azure.iot.device.provisioning.pipeline.pipeline_stages_provisioning.Timer"
-        )
+        mock_alarm_schedule = mocker.patch.object(alarm, "schedule")
 
         stage.run_op(op)
         assert stage.send_op_down.call_count == 1
@@ -462,8 +460,7 @@ class TestRegistrationStageWithRetryOfRegisterOperation(RetryStageConfig):
 
         assert op.retry_after_timer is not None
         assert op.polling_timer is None
-        timer_callback = mock_timer.call_args[0][1]
-        timer_callback()
+        fire_alarm(mock_alarm_schedule)
 
         assert stage.run_op.call_count == 2
         assert stage.send_op_down.call_count == 2
@@ -473,7 +470,7 @@ class TestRegistrationStageWithRetryOfRegisterOperation(RetryStageConfig):
         assert next_op_2.request_type == "register"
         assert next_op_2.method == "PUT"
         assert next_op_2.resource_location == "/"
-        assert next_op_2.request_body == request_body
+        assert json.loads(next_op_2.request_body.decode("utf-8")) == request_body
 
 
 @pytest.mark.describe(
@@ -490,27 +487,24 @@ class TestRegistrationStageWithTimeoutOfRegisterOperation(
         return op
 
     @pytest.fixture
-    def mock_timer(self, mocker):
-        return mocker.patch(
-            "azure.iot.device.provisioning.pipeline.pipeline_stages_provisioning.Timer"
-        )
+    def mock_alarm_schedule(self, mocker):
+        return mocker.patch.object(alarm, "schedule")
 
     @pytest.mark.it(
-        "Adds a provisioning timeout timer with the interval specified in the configuration to the operation, and starts it"
+        "Adds a provisioning timeout alarm, due after the interval specified in the configuration, to the operation"
     )
-    def test_adds_timer(self, mocker, stage, op, mock_timer):
+    def test_adds_timer(self, mocker, stage, op, mock_alarm_schedule):
+        mocker.patch.object(time, "time", return_value=1000)
         stage.run_op(op)
 
-        assert mock_timer.call_count == 1
-        assert mock_timer.call_args == mocker.call(constant.DEFAULT_TIMEOUT_INTERVAL, mocker.ANY)
-        assert op.provisioning_timeout_timer is mock_timer.return_value
-        assert op.provisioning_timeout_timer.start.call_count == 1
-        assert op.provisioning_timeout_timer.start.call_args == mocker.call()
+        assert mock_alarm_schedule.call_count == 1
+        assert mock_alarm_schedule.call_args[0][0] == 1000 + constant.DEFAULT_TIMEOUT_INTERVAL
+        assert op.provisioning_timeout_timer is mock_alarm_schedule.return_value
 
     @pytest.mark.it(
         "Sends converted RequestResponse Op down the pipeline after attaching timer to the original op"
     )
-    def test_sends_down(self, mocker, stage, op, mock_timer):
+    def test_sends_down(self, mocker, stage, op, mock_alarm_schedule):
         stage.run_op(op)
 
         assert stage.send_op_down.call_count == 1
@@ -518,18 +512,16 @@ class TestRegistrationStageWithTimeoutOfRegisterOperation(
         new_op = stage.send_op_down.call_args[0][0]
         assert isinstance(new_op, pipeline_ops_base.RequestAndResponseOperation)
 
-        assert op.provisioning_timeout_timer is mock_timer.return_value
+        assert op.provisioning_timeout_timer is mock_alarm_schedule.return_value
 
     @pytest.mark.it("Completes the operation unsuccessfully, with a ServiceError due to timeout")
-    def test_not_complete_timeout(self, mocker, stage, op, mock_timer):
+    def test_not_complete_timeout(self, mocker, stage, op, mock_alarm_schedule):
         # Apply the timer
         stage.run_op(op)
         assert not op.completed
-        assert mock_timer.call_count == 1
-        on_timer_complete = mock_timer.call_args[0][1]
-
-        # Call timer complete callback (indicating timer completion)
-        on_timer_complete()
+        assert mock_alarm_schedule.call_count == 1
+        # Fire the alarm (indicating timer completion)
+        fire_alarm(mock_alarm_schedule)
 
         # Op is now completed with error
         assert op.completed
@@ -539,24 +531,43 @@ class TestRegistrationStageWithTimeoutOfRegisterOperation(
     @pytest.mark.it(
         "Completes the operation successfully, cancels and clears the operation's timeout timer"
     )
-    def test_complete_before_timeout(self, mocker, stage, op, mock_timer):
+    def test_complete_before_timeout(self, mocker, stage, op, mock_alarm_schedule):
         # Apply the timer
         stage.run_op(op)
         assert not op.completed
-        assert mock_timer.call_count == 1
-        mock_timer_inst = op.provisioning_timeout_timer
-        assert mock_timer_inst is mock_timer.return_value
-        assert mock_timer_inst.cancel.call_count == 0
+        assert mock_alarm_schedule.call_count == 1
+        mock_alarm = op.provisioning_timeout_timer
+        assert mock_alarm is mock_alarm_schedule.return_value
+        assert mock_alarm.cancel.call_count == 0
 
         # Complete the next operation
         new_op = stage.send_op_down.call_args[0][0]
         new_op.complete()
 
-        # Timer is now cancelled and cleared
-        assert mock_timer_inst.cancel.call_count == 1
-        assert mock_timer_inst.cancel.call_args == mocker.call()
+        # Alarm is now cancelled and cleared
+        assert mock_alarm.cancel.call_count == 1
+        assert mock_alarm.cancel.call_args == mocker.call()
         assert op.provisioning_timeout_timer is None
 
+    @pytest.mark.it("Does not keep the stage alive while the timeout alarm is pending")
+    def test_alarm_holds_weak_reference(
+        self, mocker, cls_type, init_kwargs, op, mock_alarm_schedule
+    ):
+        stage = cls_type(**init_kwargs)
+        stage.send_op_down = mocker.MagicMock()
+        stage.run_op(op)
+        assert mock_alarm_schedule.call_count == 1
+        # Drop everything else that refers to the stage
+        stage.send_op_down.reset_mock()
+        stage_weakref = weakref.ref(stage)
+        del stage
+        gc.collect()
+
+        assert stage_weakref() is None
+        # Firing the alarm once the stage is gone does nothing
+        fire_alarm(mock_alarm_schedule)
+        assert not op.completed
+
 
 class PollingStageConfig(object):
     @pytest.fixture
@@ -820,9 +831,7 @@ class TestPollingStatusStageWithPollStatusRetryOperation(RetryStageConfig):
     def test_stage_retries_op_if_next_stage_responds_with_status_code_greater_than_429(
         self, mocker, stage, op
     ):
-        mock_timer = mocker.patch(
-            "azure.iot.device.provisioning.pipeline.pipeline_stages_provisioning.Timer"
-        )
+        mock_alarm_schedule = mocker.patch.object(alarm, "schedule")
 
         stage.run_op(op)
         assert stage.send_op_down.call_count == 1
@@ -837,8 +846,7 @@ class TestPollingStatusStageWithPollStatusRetryOperation(RetryStageConfig):
 
         assert op.retry_after_timer is not None
         assert op.polling_timer is None
-        timer_callback = mock_timer.call_args[0][1]
-        timer_callback()
+        fire_alarm(mock_alarm_schedule)
 
         assert stage.run_op.call_count == 2
         assert stage.send_op_down.call_count == 2
@@ -854,9 +862,7 @@ class TestPollingStatusStageWithPollStatusRetryOperation(RetryStageConfig):
         "Decodes, deserializes the response from RequestAndResponseOperation and retries the op if the status code < 300 and if status is 'assigning'"
     )
     def test_stage_retries_op_if_next_stage_responds_with_status_assigning(self, mocker, stage, op):
-        mock_timer = mocker.patch(
-            "azure.iot.device.provisioning.pipeline.pipeline_stages_provisioning.Timer"
-        )
+        mock_alarm_schedule = mocker.patch.object(alarm, "schedule")
 
         stage.run_op(op)
         assert stage.send_op_down.call_count == 1
@@ -871,8 +877,7 @@ class TestPollingStatusStageWithPollStatusRetryOperation(RetryStageConfig):
 
         assert op.retry_after_timer is None
         assert op.polling_timer is not None
-        timer_callback = mock_timer.call_args[0][1]
-        timer_callback()
+        fire_alarm(mock_alarm_schedule)
 
         assert stage.run_op.call_count == 2
         assert stage.send_op_down.call_count == 2
@@ -897,27 +902,24 @@ class TestPollingStageWithTimeoutOfQueryOperation(StageRunOpTestBase, PollingSta
         return op
 
     @pytest.fixture
-    def mock_timer(self, mocker):
-        return mocker.patch(
-            "azure.iot.device.provisioning.pipeline.pipeline_stages_provisioning.Timer"
-        )
+    def mock_alarm_schedule(self, mocker):
+        return mocker.patch.object(alarm, "schedule")
 
     @pytest.mark.it(
-        "Adds a provisioning timeout timer with the interval specified in the configuration to the operation, and starts it"
+        "Adds a provisioning timeout alarm, due after the interval specified in the configuration, to the operation"
     )
-    def test_adds_timer(self, mocker, stage, op, mock_timer):
+    def test_adds_timer(self, mocker, stage, op, mock_alarm_schedule):
+        mocker.patch.object(time, "time", return_value=1000)
         stage.run_op(op)
 
-        assert mock_timer.call_count == 1
-        assert mock_timer.call_args == mocker.call(constant.DEFAULT_TIMEOUT_INTERVAL, mocker.ANY)
-        assert op.provisioning_timeout_timer is mock_timer.return_value
-        assert op.provisioning_timeout_timer.start.call_count == 1
-        assert op.provisioning_timeout_timer.start.call_args == mocker.call()
+        assert mock_alarm_schedule.call_count == 1
+        assert mock_alarm_schedule.call_args[0][0] == 1000 + constant.DEFAULT_TIMEOUT_INTERVAL
+        assert op.provisioning_timeout_timer is mock_alarm_schedule.return_value
 
     @pytest.mark.it(
         "Sends converted RequestResponse Op down the pipeline after attaching timer to the original op"
     )
-    def test_sends_down(self, mocker, stage, op, mock_timer):
+    def test_sends_down(self, mocker, stage, op, mock_alarm_schedule):
         stage.run_op(op)
 
         assert stage.send_op_down.call_count == 1
@@ -925,18 +927,16 @@ class TestPollingStageWithTimeoutOfQueryOperation(StageRunOpTestBase, PollingSta
         new_op = stage.send_op_down.call_args[0][0]
         assert isinstance(new_op, pipeline_ops_base.RequestAndResponseOperation)
 
-        assert op.provisioning_timeout_timer is mock_timer.return_value
+        assert op.provisioning_timeout_timer is mock_alarm_schedule.return_value
 
     @pytest.mark.it("Completes the operation unsuccessfully, with a ServiceError due to timeout")
-    def test_not_complete_timeout(self, mocker, stage, op, mock_timer):
+    def test_not_complete_timeout(self, mocker, stage, op, mock_alarm_schedule):
         # Apply the timer
         stage.run_op(op)
         assert not op.completed
-        assert mock_timer.call_count == 1
-        on_timer_complete = mock_timer.call_args[0][1]
-
-        # Call timer complete callback (indicating timer completion)
-        on_timer_complete()
+        assert mock_alarm_schedule.call_count == 1
+        # Fire the alarm (indicating timer completion)
+        fire_alarm(mock_alarm_schedule)
 
         # Op is now completed with error
         assert op.completed
@@ -946,20 +946,162 @@ class TestPollingStageWithTimeoutOfQueryOperation(StageRunOpTestBase, PollingSta
     @pytest.mark.it(
         "Completes the operation successfully, cancels and clears the operation's timeout timer"
     )
-    def test_complete_before_timeout(self, mocker, stage, op, mock_timer):
+    def test_complete_before_timeout(self, mocker, stage, op, mock_alarm_schedule):
         # Apply the timer
         stage.run_op(op)
         assert not op.completed
-        assert mock_timer.call_count == 1
-        mock_timer_inst = op.provisioning_timeout_timer
-        assert mock_timer_inst is mock_timer.return_value
-        assert mock_timer_inst.cancel.call_count == 0
+        assert mock_alarm_schedule.call_count == 1
+        mock_alarm = op.provisioning_timeout_timer
+        assert mock_alarm is mock_alarm_schedule.return_value
+        assert mock_alarm.cancel.call_count == 0
 
         # Complete the next operation
         new_op = stage.send_op_down.call_args[0][0]
         new_op.complete()
 
-        # Timer is now cancelled and cleared
-        assert mock_timer_inst.cancel.call_count == 1
-        assert mock_timer_inst.cancel.call_args == mocker.call()
+        # Alarm is now cancelled and cleared
+        assert mock_alarm.cancel.call_count == 1
+        assert mock_alarm.cancel.call_args == mocker.call()
         assert op.provisioning_timeout_timer is None
+
+
+@pytest.mark.describe("CommonProvisioningStage - Polling interval")
+class TestPollingInterval(object):
+    @pytest.mark.it(
+        "Adds a random jitter of up to POLLING_JITTER of the interval to the Retry-After interval, or to the default interval if there is none"
+    )
+    @pytest.mark.parametrize(
+        "retry_after, interval",
+        [
+            pytest.param("3", 3, id="Retry-After"),
+            pytest.param(None, constant.DEFAULT_POLLING_INTERVAL, id="No Retry-After"),
+        ],
+    )
+    @pytest.mark.parametrize("jitter", [0, 0.1, constant.POLLING_JITTER])
+    def test_jitter(self, mocker, retry_after, interval, jitter):
+        mock_uniform = mocker.patch.object(
+            pipeline_stages_provisioning.random, "uniform", return_value=jitter
+        )
+
+        polling_interval = (
+            pipeline_stages_provisioning.CommonProvisioningStage._get_polling_interval(retry_after)
+        )
+
+        assert mock_uniform.call_args == mocker.call(0, constant.POLLING_JITTER)
+        assert polling_interval == pytest.approx(interval * (1 + jitter))
+        assert polling_interval >= interval
+
+    @pytest.mark.it("Waits for the Retry-After interval, plus jitter, before starting to poll")
+    def test_registration_polling_honors_retry_after(self, mocker):
+        mocker.patch.object(time, "time", return_value=1000)
+        mocker.patch.object(pipeline_stages_provisioning.random, "uniform", return_value=0.1)
+        mock_alarm_schedule = mocker.patch.object(alarm, "schedule")
+        stage = pipeline_stages_provisioning.RegistrationStage()
+        stage.send_op_down = mocker.MagicMock()
+        op = pipeline_ops_provisioning.RegisterOperation(
+            " ", fake_registration_id, callback=mocker.MagicMock()
+        )
+
+        stage.run_op(op)
+        next_op = stage.send_op_down.call_args[0][0]
+        next_op.status_code = 202
+        next_op.retry_after = "5"
+        next_op.response_body = get_registration_result_as_bytes(
+            create_registration_result(" ", "assigning")
+        )
+        next_op.complete()
+
+        assert op.polling_timer is mock_alarm_schedule.return_value
+        assert mock_alarm_schedule.call_args[0][0] == pytest.approx(1000 + 5 * 1.1)
+
+
+@pytest.mark.describe("RegistrationStage and PollingStatusStage - Provisioning latency")
+class TestProvisioningLatency(object):
+    @pytest.fixture
+    def mock_time(self, mocker):
+        mocker.patch.object(alarm, "schedule")
+        return mocker.patch.object(time, "time", return_value=1000)
+
+    def complete_request(self, stage, status):
+        next_op = stage.send_op_down.call_args[0][0]
+        next_op.status_code = 200
+        next_op.retry_after = None
+        next_op.response_body = get_registration_result_as_bytes(
+            create_registration_result(" ", status)
+        )
+        next_op.complete()
+
+    @pytest.mark.it(
+        "Sets the time to assigned, and a poll count of 0, on the RegistrationResult if registration is assigned without polling"
+    )
+    def test_register_assigned(self, mocker, mock_time):
+        stage = pipeline_stages_provisioning.RegistrationStage()
+        stage.send_op_down = mocker.MagicMock()
+        op = pipeline_ops_provisioning.RegisterOperation(
+            " ", fake_registration_id, callback=mocker.MagicMock()
+        )
+
+        stage.run_op(op)
+        assert op.start_time == 1000
+        mock_time.return_value = 1002.5
+        self.complete_request(stage, "assigned")
+
+        assert op.registration_result.time_to_assigned == 2.5
+        assert op.registration_result.poll_count == 0
+
+    @pytest.mark.it(
+        "Counts each status query, and measures the time to assigned from the start of registration"
+    )
+    def test_polling_assigned(self, mocker, mock_time):
+        stage = pipeline_stages_provisioning.PollingStatusStage()
+        stage.send_op_down = mocker.MagicMock()
+        op = pipeline_ops_provisioning.PollStatusOperation(
+            fake_operation_id, " ", callback=mocker.MagicMock(), start_time=990
+        )
+
+        stage.run_op(op)
+        self.complete_request(stage, "assigning")
+        stage._run_op_again(op)
+        self.complete_request(stage, "assigning")
+        stage._run_op_again(op)
+        self.complete_request(stage, "assigned")
+
+        assert op.completed
+        assert op.registration_result.poll_count == 3
+        assert op.registration_result.time_to_assigned == 10
+
+    @pytest.mark.it("Does not set a time to assigned if registration fails")
+    def test_failed(self, mocker, mock_time):
+        stage = pipeline_stages_provisioning.PollingStatusStage()
+        stage.send_op_down = mocker.MagicMock()
+        op = pipeline_ops_provisioning.PollStatusOperation(
+            fake_operation_id, " ", callback=mocker.MagicMock(), start_time=990
+        )
+
+        stage.run_op(op)
+        self.complete_request(stage, "failed")
+
+        assert op.registration_result.poll_count == 1
+        assert op.registration_result.time_to_assigned is None
+
+    @pytest.mark.it(
+        "Passes the start time to the PollStatusOperation, and copies its poll count back to the RegisterOperation"
+    )
+    def test_copies_poll_count(self, mocker, mock_time):
+        stage = pipeline_stages_provisioning.RegistrationStage()
+        stage.send_op_down = mocker.MagicMock()
+        op = pipeline_ops_provisioning.RegisterOperation(
+            " ", fake_registration_id, callback=mocker.MagicMock()
+        )
+        stage.run_op(op)
+        self.complete_request(stage, "assigning")
+
+        stage._start_polling(op, fake_operation_id)
+        query_op = stage.send_op_down.call_args[0][0]
+        assert isinstance(query_op, pipeline_ops_provisioning.PollStatusOperation)
+        assert query_op.start_time == 1000
+        query_op.poll_count = 4
+        query_op.complete()
+
+        assert op.completed
+        assert op.poll_count == 4
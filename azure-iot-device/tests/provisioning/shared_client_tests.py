@@ -101,6 +101,20 @@ class SharedProvisioningClientCreateMethodUserOptionTests(object):
 
         assert config.keep_alive == keepalive_value
 
+    @pytest.mark.it(
+        "Stores the 'registration_cache' user option parameter on the client, if provided"
+    )
+    def test_registration_cache_option(
+        self, mocker, client_create_method, create_method_args, mock_pipeline_init
+    ):
+        registration_cache = mocker.MagicMock()
+        client = client_create_method(*create_method_args, registration_cache=registration_cache)
+
+        assert client._registration_cache is registration_cache
+        # The cache is not part of the pipeline configuration
+        config = mock_pipeline_init.call_args[0][0]
+        assert not hasattr(config, "registration_cache")
+
     @pytest.mark.it("Raises a TypeError if an invalid user option parameter is provided")
     def test_invalid_option(
         self, mocker, client_create_method, create_method_args, mock_pipeline_init
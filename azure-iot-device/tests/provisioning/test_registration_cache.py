@@ -0,0 +1,143 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+import pytest
+import json
+import logging
+import os
+from azure.iot.device.provisioning.registration_cache import FileRegistrationCache
+from azure.iot.device.provisioning.models.registration_result import (
+    RegistrationResult,
+    RegistrationState,
+)
+
+logging.basicConfig(level=logging.DEBUG)
+
+fake_registration_id = "MyPensieve"
+fake_id_scope = "Enchanted0000Ceiling7898"
+fake_operation_id = "quidditch_world_cup"
+fake_device_id = "MyNimbus2000"
+fake_assigned_hub = "Dumbledore'sArmy"
+fake_sub_status = "initialAssignment"
+fake_created_dttm = "2020-01-01T00:00:00Z"
+fake_last_updated_dttm = "2020-01-02T00:00:00Z"
+fake_etag = "HighQualityFlyingBroom"
+fake_payload = {"mascot": "Hippogriff"}
+
+
+@pytest.fixture
+def cache_path(tmpdir):
+    return os.path.join(str(tmpdir), "registration.json")
+
+
+@pytest.fixture
+def cache(cache_path):
+    return FileRegistrationCache(cache_path)
+
+
+@pytest.fixture
+def registration_result():
+    registration_state = RegistrationState(
+        fake_device_id,
+        fake_assigned_hub,
+        fake_sub_status,
+        fake_created_dttm,
+        fake_last_updated_dttm,
+        fake_etag,
+        fake_payload,
+    )
+    return RegistrationResult(fake_operation_id, "assigned", registration_state)
+
+
+@pytest.mark.describe("FileRegistrationCache")
+class TestFileRegistrationCache(object):
+    @pytest.mark.it("Loads the registration it saved")
+    def test_round_trip(self, cache, registration_result):
+        cache.save(fake_registration_id, fake_id_scope, registration_result)
+        result = cache.load(fake_registration_id, fake_id_scope)
+
+        assert isinstance(result, RegistrationResult)
+        assert result.operation_id == fake_operation_id
+        assert result.status == "assigned"
+        state = result.registration_state
+        assert state.device_id == fake_device_id
+        assert state.assigned_hub == fake_assigned_hub
+        assert state.sub_status == fake_sub_status
+        assert state.created_date_time == fake_created_dttm
+        assert state.last_update_date_time == fake_last_updated_dttm
+        assert state.etag == fake_etag
+        assert json.loads(state.response_payload) == fake_payload
+
+    @pytest.mark.it("Replaces a previously saved registration, without leaving a temporary file")
+    def test_replaces(self, cache, cache_path, registration_result):
+        cache.save(fake_registration_id, fake_id_scope, registration_result)
+        registration_result.registration_state._assigned_hub = "Hogsmeade"
+        cache.save(fake_registration_id, fake_id_scope, registration_result)
+
+        result = cache.load(fake_registration_id, fake_id_scope)
+        assert result.registration_state.assigned_hub == "Hogsmeade"
+        assert os.listdir(os.path.dirname(cache_path)) == ["registration.json"]
+
+    @pytest.mark.it("Returns None if there is no cache file")
+    def test_no_file(self, cache):
+        assert cache.load(fake_registration_id, fake_id_scope) is None
+
+    @pytest.mark.it(
+        "Returns None if the registration was made with a different registration ID or ID scope"
+    )
+    @pytest.mark.parametrize(
+        "registration_id, id_scope",
+        [
+            pytest.param("OtherPensieve", fake_id_scope, id="Different registration ID"),
+            pytest.param(fake_registration_id, "OtherScope", id="Different ID scope"),
+        ],
+    )
+    def test_mismatch(self, cache, registration_result, registration_id, id_scope):
+        cache.save(fake_registration_id, fake_id_scope, registration_result)
+        assert cache.load(registration_id, id_scope) is None
+
+    @pytest.mark.it("Returns None if the cache file cannot be parsed")
+    def test_corrupt(self, cache, cache_path):
+        with open(cache_path, "w") as cache_file:
+            cache_file.write('{"registrationId": ')
+        assert cache.load(fake_registration_id, fake_id_scope) is None
+
+    @pytest.mark.it("Removes the cache file on clear(), and does nothing if there is none")
+    def test_clear(self, cache, cache_path, registration_result):
+        cache.save(fake_registration_id, fake_id_scope, registration_result)
+        cache.clear()
+        assert not os.path.exists(cache_path)
+        cache.clear()
+
+    @pytest.mark.it("Counts the connection failures recorded since the registration was saved")
+    def test_record_connect_failure(self, cache, registration_result):
+        cache.save(fake_registration_id, fake_id_scope, registration_result)
+        assert cache.record_connect_failure(fake_registration_id, fake_id_scope) == 1
+        assert cache.record_connect_failure(fake_registration_id, fake_id_scope) == 2
+        assert cache.load(fake_registration_id, fake_id_scope) is not None
+
+        cache.save(fake_registration_id, fake_id_scope, registration_result)
+        assert cache.record_connect_failure(fake_registration_id, fake_id_scope) == 1
+
+    @pytest.mark.it("Records no connection failure if there is no registration for the device")
+    def test_record_connect_failure_no_registration(self, cache, cache_path, registration_result):
+        assert cache.record_connect_failure(fake_registration_id, fake_id_scope) == 0
+        assert not os.path.exists(cache_path)
+        cache.save(fake_registration_id, fake_id_scope, registration_result)
+        assert cache.record_connect_failure("OtherPensieve", fake_id_scope) == 0
+
+    @pytest.mark.it(
+        "Resets the connection failure count, without rewriting the file if there were none"
+    )
+    def test_reset_connect_failures(self, mocker, cache, registration_result):
+        cache.save(fake_registration_id, fake_id_scope, registration_result)
+        cache.record_connect_failure(fake_registration_id, fake_id_scope)
+        cache.reset_connect_failures(fake_registration_id, fake_id_scope)
+        assert cache.record_connect_failure(fake_registration_id, fake_id_scope) == 1
+
+        cache.reset_connect_failures(fake_registration_id, fake_id_scope)
+        write_spy = mocker.spy(cache, "_write")
+        cache.reset_connect_failures(fake_registration_id, fake_id_scope)
+        assert write_spy.call_count == 0
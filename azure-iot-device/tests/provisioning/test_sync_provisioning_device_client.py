@@ -6,17 +6,21 @@
 import pytest
 import logging
 from azure.iot.device.provisioning.provisioning_device_client import ProvisioningDeviceClient
+from azure.iot.device.provisioning.abstract_provisioning_device_client import (
+    MAX_CACHED_CONNECT_FAILURES,
+)
 from azure.iot.device.provisioning.pipeline import exceptions as pipeline_exceptions
 from azure.iot.device.provisioning import pipeline
 import threading
 from azure.iot.device import exceptions as client_exceptions
 from .shared_client_tests import (
+    fake_registration_id,
+    fake_id_scope,
     SharedProvisioningClientInstantiationTests,
     SharedProvisioningClientCreateFromSymmetricKeyTests,
     SharedProvisioningClientCreateFromX509CertificateTests,
 )
 
-
 logging.basicConfig(level=logging.DEBUG)
 
 
@@ -302,6 +306,221 @@ class TestClientRegister(object):
         assert provisioning_pipeline.register.call_count == 1
 
 
+@pytest.mark.describe("ProvisioningDeviceClient (Sync) - .register_and_connect()")
+class TestClientRegisterAndConnect(object):
+    @pytest.fixture
+    def registration_cache(self, mocker):
+        return mocker.MagicMock()
+
+    @pytest.fixture
+    def client(self, mocker, provisioning_pipeline, registration_cache, registration_result):
+        registration_result._status = "assigned"
+
+        def register_complete_success_callback(payload, callback):
+            callback(result=registration_result)
+
+        mocker.patch.object(
+            provisioning_pipeline, "register", side_effect=register_complete_success_callback
+        )
+        provisioning_pipeline.pipeline_configuration = mocker.MagicMock(
+            registration_id=fake_registration_id, id_scope=fake_id_scope
+        )
+        return ProvisioningDeviceClient(
+            provisioning_pipeline, registration_cache=registration_cache
+        )
+
+    @pytest.fixture
+    def connect(self, mocker):
+        return mocker.MagicMock()
+
+    @pytest.mark.it(
+        "Connects with the cached registration, without registering, if there is one for the device"
+    )
+    def test_cached(self, mocker, client, provisioning_pipeline, registration_cache, connect):
+        cached_result = mocker.MagicMock()
+        registration_cache.load.return_value = cached_result
+
+        result, connected = client.register_and_connect(connect)
+
+        assert registration_cache.load.call_args == mocker.call(fake_registration_id, fake_id_scope)
+        assert connect.call_args == mocker.call(cached_result)
+        assert result is cached_result
+        assert connected is connect.return_value
+        assert provisioning_pipeline.register.call_count == 0
+        assert registration_cache.reset_connect_failures.call_args == mocker.call(
+            fake_registration_id, fake_id_scope
+        )
+
+    @pytest.mark.it(
+        "Clears the cache, registers, and connects with the new registration if connecting with the cached registration fails"
+    )
+    @pytest.mark.parametrize(
+        "error",
+        [
+            pytest.param(client_exceptions.CredentialError(), id="CredentialError"),
+        ],
+    )
+    def test_cached_invalid(
+        self,
+        mocker,
+        client,
+        provisioning_pipeline,
+        registration_cache,
+        registration_result,
+        connect,
+        error,
+    ):
+        cached_result = mocker.MagicMock()
+        registration_cache.load.return_value = cached_result
+        connect.side_effect = [error, "connected"]
+
+        result, connected = client.register_and_connect(connect)
+
+        assert registration_cache.clear.call_count == 1
+        assert provisioning_pipeline.register.call_count == 1
+        assert connect.call_args_list == [
+            mocker.call(cached_result),
+            mocker.call(registration_result),
+        ]
+        assert result is registration_result
+        assert connected == "connected"
+        assert registration_cache.save.call_args == mocker.call(
+            fake_registration_id, fake_id_scope, registration_result
+        )
+
+    @pytest.mark.it(
+        "Raises other errors from connecting with the cached registration, including dropped connections, without clearing the cache"
+    )
+    @pytest.mark.parametrize(
+        "error",
+        [
+            pytest.param(client_exceptions.ClientError(), id="ClientError"),
+            pytest.param(client_exceptions.ConnectionDroppedError(), id="ConnectionDroppedError"),
+        ],
+    )
+    def test_cached_other_error(self, mocker, client, registration_cache, connect, error):
+        registration_cache.load.return_value = mocker.MagicMock()
+        connect.side_effect = error
+
+        with pytest.raises(type(error)) as e_info:
+            client.register_and_connect(connect)
+        assert e_info.value is error
+        assert registration_cache.clear.call_count == 0
+
+    @pytest.mark.it(
+        "Raises a connection failure from connecting with the cached registration, without clearing the cache, if it is not yet the last one allowed in a row"
+    )
+    def test_cached_hub_failure(self, mocker, client, registration_cache, connect):
+        registration_cache.load.return_value = mocker.MagicMock()
+        registration_cache.record_connect_failure.return_value = MAX_CACHED_CONNECT_FAILURES - 1
+        error = client_exceptions.ConnectionFailedError()
+        connect.side_effect = error
+
+        with pytest.raises(client_exceptions.ConnectionFailedError) as e_info:
+            client.register_and_connect(connect)
+        assert e_info.value is error
+        assert registration_cache.record_connect_failure.call_args == mocker.call(
+            fake_registration_id, fake_id_scope
+        )
+        assert registration_cache.clear.call_count == 0
+        assert registration_cache.reset_connect_failures.call_count == 0
+
+    @pytest.mark.it(
+        "Clears the cache, registers, and connects with the new registration if connecting with the cached registration has failed too many times in a row"
+    )
+    def test_cached_hub_failure_limit(
+        self,
+        mocker,
+        client,
+        provisioning_pipeline,
+        registration_cache,
+        registration_result,
+        connect,
+    ):
+        cached_result = mocker.MagicMock()
+        registration_cache.load.return_value = cached_result
+        registration_cache.record_connect_failure.return_value = MAX_CACHED_CONNECT_FAILURES
+        error = client_exceptions.ConnectionFailedError()
+        connect.side_effect = [error, "connected"]
+
+        result, connected = client.register_and_connect(connect)
+
+        assert registration_cache.clear.call_count == 1
+        assert provisioning_pipeline.register.call_count == 1
+        assert connect.call_args_list == [
+            mocker.call(cached_result),
+            mocker.call(registration_result),
+        ]
+        assert result is registration_result
+        assert connected == "connected"
+
+    @pytest.mark.it(
+        "Clears the cache and registers after the first connection failure with the cached registration, if the cache cannot count failures"
+    )
+    def test_cached_hub_failure_not_counted(
+        self, mocker, client, provisioning_pipeline, registration_result, connect
+    ):
+        registration_cache = mocker.MagicMock(spec=["load", "save", "clear"])
+        client._registration_cache = registration_cache
+        error = client_exceptions.ConnectionFailedError()
+        connect.side_effect = [error, "connected"]
+
+        result, connected = client.register_and_connect(connect)
+
+        assert registration_cache.clear.call_count == 1
+        assert provisioning_pipeline.register.call_count == 1
+        assert result is registration_result
+        assert connected == "connected"
+
+    @pytest.mark.it(
+        "Registers, saves the registration to the cache, and connects with it if there is no cached registration"
+    )
+    def test_not_cached(
+        self,
+        mocker,
+        client,
+        provisioning_pipeline,
+        registration_cache,
+        registration_result,
+        connect,
+    ):
+        registration_cache.load.return_value = None
+
+        result, connected = client.register_and_connect(connect)
+
+        assert provisioning_pipeline.register.call_count == 1
+        assert registration_cache.save.call_args == mocker.call(
+            fake_registration_id, fake_id_scope, registration_result
+        )
+        assert connect.call_args == mocker.call(registration_result)
+        assert result is registration_result
+        assert connected is connect.return_value
+
+    @pytest.mark.it(
+        "Does not connect or save to the cache if the device is not assigned by registration"
+    )
+    def test_not_assigned(self, client, registration_cache, registration_result, connect):
+        registration_cache.load.return_value = None
+        registration_result._status = "failed"
+
+        result, connected = client.register_and_connect(connect)
+
+        assert result is registration_result
+        assert connected is None
+        assert connect.call_count == 0
+        assert registration_cache.save.call_count == 0
+
+    @pytest.mark.it("Registers and connects if the client has no registration cache")
+    def test_no_cache(self, mocker, provisioning_pipeline, registration_result, client, connect):
+        client._registration_cache = None
+
+        result, connected = client.register_and_connect(connect)
+
+        assert provisioning_pipeline.register.call_count == 1
+        assert connect.call_args == mocker.call(registration_result)
+        assert result is registration_result
+
+
 @pytest.mark.describe("ProvisioningDeviceClient (Sync) - .set_provisioning_payload()")
 class TestClientProvisioningPayload(object):
     @pytest.mark.it("Sets the payload on the provisioning payload attribute")
@@ -9,6 +9,7 @@ from .iothub_job_manager import IoTHubJobManager
 from .iothub_http_runtime_manager import IoTHubHttpRuntimeManager
 from .iothub_amqp_client import IoTHubAmqpClient
 from .digital_twin_client import DigitalTwinClient
+from .service_context import IoTHubServiceContext
 
 __all__ = [
     "IoTHubRegistryManager",
@@ -17,4 +18,5 @@ __all__ = [
     "IoTHubHttpRuntimeManager",
     "IoTHubAmqpClient",
     "DigitalTwinClient",
+    "IoTHubServiceContext",
 ]
@@ -0,0 +1,8 @@
+"""Azure IoTHub Service Library - Asynchronous
+
+This library provides asynchronous helpers for the Azure IoTHub service clients.
+"""
+
+from .async_feedback_consumer import AsyncFeedbackIterator
+
+__all__ = ["AsyncFeedbackIterator"]
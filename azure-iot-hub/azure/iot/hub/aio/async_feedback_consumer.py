@@ -0,0 +1,43 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+"""This module contains the asynchronous iterator over the feedback of a FeedbackConsumer"""
+
+import asyncio
+import functools
+import logging
+
+logger = logging.getLogger(__name__)
+
+
+class AsyncFeedbackIterator(object):
+    """Asynchronous iterator over the batches of feedback received by a FeedbackConsumer.
+
+    Iteration ends once the consumer has been stopped. Usually obtained with
+    ``async for batch in consumer``.
+    """
+
+    def __init__(self, consumer, poll_timeout=1):
+        """Initializer for an AsyncFeedbackIterator
+
+        :param consumer: The started consumer to iterate over.
+        :type consumer: :class:`azure.iot.hub.feedback_consumer.FeedbackConsumer`
+        :param float poll_timeout: The number of seconds to wait for each batch before checking
+            if the consumer has been stopped.
+        """
+        self._consumer = consumer
+        self._poll_timeout = poll_timeout
+
+    def __aiter__(self):
+        return self
+
+    async def __anext__(self):
+        loop = asyncio.get_event_loop()
+        receive = functools.partial(self._consumer.receive, timeout=self._poll_timeout)
+        while not self._consumer.stopped:
+            batch = await loop.run_in_executor(None, receive)
+            if batch is not None:
+                return batch
+        raise StopAsyncIteration
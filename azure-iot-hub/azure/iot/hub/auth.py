@@ -7,6 +7,8 @@
 """Provides authentication classes for use with the msrest library
 """
 
+import threading
+import time
 from msrest.authentication import Authentication, BasicTokenAuthentication
 from .connection_string import ConnectionString
 from .connection_string import HOST_NAME, SHARED_ACCESS_KEY_NAME, SHARED_ACCESS_KEY
@@ -21,13 +23,21 @@ __all__ = ["ConnectionStringAuthentication", "AzureIdentityCredentialAdapter"]
 class ConnectionStringAuthentication(ConnectionString, Authentication):
     """ConnectionString class that can be used with msrest to provide SasToken authentication
 
+    The SasToken is cached, and only rebuilt once it is close to expiry, rather than for every
+    request.
+
     :param connection_string: The connection string to generate SasToken with
     """
 
+    # Number of seconds before expiry at which the cached SasToken is rebuilt
+    _sastoken_refresh_margin = 300
+
     def __init__(self, connection_string):
         super(ConnectionStringAuthentication, self).__init__(
             connection_string
         )  # ConnectionString __init__
+        self._sastoken = None
+        self._sastoken_lock = threading.Lock()
 
     @classmethod
     def create_with_parsed_values(cls, host_name, shared_access_key_name, shared_access_key):
@@ -59,10 +69,19 @@ class ConnectionStringAuthentication(ConnectionString, Authentication):
         session = super(ConnectionStringAuthentication, self).signed_session(session)
 
         # Authorization header
-        sastoken = SasToken(self[HOST_NAME], self[SHARED_ACCESS_KEY], self[SHARED_ACCESS_KEY_NAME])
-        session.headers[self.header] = str(sastoken)
+        session.headers[self.header] = str(self._get_sastoken())
         return session
 
+    def _get_sastoken(self):
+        with self._sastoken_lock:
+            if self._sastoken is None:
+                self._sastoken = SasToken(
+                    self[HOST_NAME], self[SHARED_ACCESS_KEY], self[SHARED_ACCESS_KEY_NAME]
+                )
+            elif self._sastoken.expiry_time - time.time() < self._sastoken_refresh_margin:
+                self._sastoken.refresh()
+            return self._sastoken
+
 
 class AzureIdentityCredentialAdapter(BasicTokenAuthentication):
     def __init__(self, credential, resource_id="https://iothubs.azure.net/.default", **kwargs):
@@ -0,0 +1,419 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+"""This module contains a consumer for the feedback notifications of cloud-to-device messages.
+
+IoTHub delivers feedback in batches, each of which must be completed (or abandoned) with its lock
+token before its lock expires. Receiving and settling one batch at a time, with a blocking round
+trip for each, cannot keep up with a hub delivering many cloud-to-device messages. The
+FeedbackConsumer instead polls continuously on a thread of its own, ahead of the application, and
+settles lock tokens on a set of worker threads, so several settlements are in flight at once.
+Feedback received over AMQP is settled on the receive thread instead, as uamqp is not thread safe.
+"""
+
+import json
+import logging
+import threading
+import time
+import six
+from six.moves import queue
+
+logger = logging.getLogger(__name__)
+
+
+class FeedbackRecord(object):
+    """The feedback for a single cloud-to-device message"""
+
+    __slots__ = [
+        "original_message_id",
+        "device_id",
+        "device_generation_id",
+        "status_code",
+        "description",
+        "enqueued_time_utc",
+    ]
+
+    def __init__(
+        self,
+        original_message_id=None,
+        device_id=None,
+        device_generation_id=None,
+        status_code=None,
+        description=None,
+        enqueued_time_utc=None,
+    ):
+        """Initializer for a FeedbackRecord
+
+        :param str original_message_id: The message id of the cloud-to-device message.
+        :param str device_id: The id of the device the message was sent to.
+        :param str device_generation_id: The generation id of the device.
+        :param str status_code: The outcome of the message: "Success", "Expired",
+            "DeliveryCountExceeded", "Rejected" or "Purged".
+        :param str description: A description of the status code.
+        :param str enqueued_time_utc: The time at which the outcome of the message occurred.
+        """
+        self.original_message_id = original_message_id
+        self.device_id = device_id
+        self.device_generation_id = device_generation_id
+        self.status_code = status_code
+        self.description = description
+        self.enqueued_time_utc = enqueued_time_utc
+
+    @classmethod
+    def from_dict(cls, record):
+        return cls(
+            original_message_id=record.get("originalMessageId"),
+            device_id=record.get("deviceId"),
+            device_generation_id=record.get("deviceGenerationId"),
+            status_code=record.get("statusCode"),
+            description=record.get("description"),
+            enqueued_time_utc=record.get("enqueuedTimeUtc"),
+        )
+
+    def __repr__(self):
+        return "FeedbackRecord(original_message_id={}, device_id={}, status_code={})".format(
+            self.original_message_id, self.device_id, self.status_code
+        )
+
+
+class FeedbackBatch(object):
+    """A batch of feedback records, as delivered by IoTHub.
+
+    The batch must be completed, once its records have been processed, or abandoned, for IoTHub
+    to deliver it again.
+    """
+
+    __slots__ = ["records", "lock_token"]
+
+    def __init__(self, records, lock_token):
+        """Initializer for a FeedbackBatch
+
+        :param list records: The :class:`FeedbackRecord` objects in the batch.
+        :param lock_token: The token used to settle the batch with the receiver it came from.
+        """
+        self.records = records
+        self.lock_token = lock_token
+
+    def __len__(self):
+        return len(self.records)
+
+    def __iter__(self):
+        return iter(self.records)
+
+
+def decode_feedback_batch(body):
+    """Decode the body of a feedback notification into a list of FeedbackRecords
+
+    :param body: The JSON array of feedback records.
+    :type body: bytes or str
+    """
+    if isinstance(body, six.binary_type):
+        body = body.decode("utf-8")
+    if not body:
+        return []
+    return [FeedbackRecord.from_dict(record) for record in json.loads(body)]
+
+
+class HttpFeedbackReceiver(object):
+    """Receives feedback from the /messages/serviceBound/feedback HTTP endpoint"""
+
+    settle_on_receive_thread = False
+
+    def __init__(self, http_runtime_manager):
+        """Initializer for a HttpFeedbackReceiver
+
+        :param http_runtime_manager: The manager to receive feedback with.
+        :type http_runtime_manager: :class:`azure.iot.hub.IoTHubHttpRuntimeManager`
+        """
+        self._operations = http_runtime_manager.protocol.cloud_to_device_messages
+
+    def receive(self):
+        """Receive the next batch of feedback.
+
+        :returns: A list containing the :class:`FeedbackBatch` received, or an empty list if
+            there was no feedback waiting.
+        """
+        response = self._operations.receive_feedback_notification(raw=True).response
+        if response.status_code == 204:
+            return []
+        lock_token = response.headers.get("ETag", "").strip('"')
+        return [FeedbackBatch(decode_feedback_batch(response.content), lock_token)]
+
+    def complete(self, lock_token):
+        self._operations.complete_feedback_notification(lock_token)
+
+    def abandon(self, lock_token):
+        self._operations.abandon_feedback_notification(lock_token)
+
+    def close(self):
+        pass
+
+
+class AmqpFeedbackReceiver(object):
+    """Receives feedback from the /messages/servicebound/feedback AMQP link.
+
+    A single receive can return several batches, and no request is made for each batch, so this
+    has a higher throughput than the HTTP endpoint.
+    """
+
+    # uamqp is not thread safe, so messages are settled on the thread which received them
+    settle_on_receive_thread = True
+
+    def __init__(self, amqp_client, max_batch_count=100, timeout=5):
+        """Initializer for an AmqpFeedbackReceiver
+
+        :param amqp_client: The client to receive feedback with, which is disconnected when the
+            receiver is closed.
+        :type amqp_client: :class:`azure.iot.hub.IoTHubAmqpClient`
+        :param int max_batch_count: The maximum number of batches to return from one receive.
+        :param int timeout: The number of seconds to wait for feedback in each receive.
+        """
+        self._amqp_client = amqp_client
+        self._max_batch_count = max_batch_count
+        self._timeout = timeout
+
+    def receive(self):
+        """Receive the next batches of feedback.
+
+        :returns: A list of the :class:`FeedbackBatch` objects received, which is empty if
+            there was no feedback within the timeout.
+        """
+        messages = self._amqp_client.receive_feedback_notifications(
+            max_batch_size=self._max_batch_count, timeout=self._timeout
+        )
+        # The message itself is the lock token, as it is settled on the link it was received on
+        return [
+            FeedbackBatch(decode_feedback_batch(b"".join(message.get_data())), message)
+            for message in messages
+        ]
+
+    def complete(self, lock_token):
+        lock_token.accept()
+
+    def abandon(self, lock_token):
+        lock_token.release()
+
+    def close(self):
+        self._amqp_client.disconnect_sync()
+
+
+class FeedbackConsumer(object):
+    """Receives feedback notifications continuously, and settles them in the background.
+
+    Feedback is delivered either to the on_feedback_received handler, or through receive() (and
+    iteration, with ``for`` or ``async for``), but not both. It is completed once it has been
+    delivered, unless auto_complete is False, in which case the application must call complete()
+    or abandon() for each batch.
+    """
+
+    def __init__(
+        self,
+        receiver,
+        auto_complete=True,
+        prefetch_count=10,
+        settle_workers=4,
+        poll_interval=1,
+        max_poll_interval=10,
+    ):
+        """Initializer for a FeedbackConsumer
+
+        :param receiver: The receiver to receive feedback with, either a
+            :class:`HttpFeedbackReceiver` or an :class:`AmqpFeedbackReceiver`.
+        :param bool auto_complete: Complete each batch once it has been delivered. If the
+            on_feedback_received handler raises, the batch is abandoned instead. Default is True.
+        :param int prefetch_count: The number of batches to receive ahead of the application.
+        :param int settle_workers: The number of batches which can be settled at once. Not used
+            with a receiver which settles on its receive thread, such as the
+            :class:`AmqpFeedbackReceiver`.
+        :param float poll_interval: The number of seconds to wait before polling again after
+            finding no feedback. This doubles, up to max_poll_interval, for as long as there is
+            no feedback.
+        :param float max_poll_interval: The longest wait between polls.
+        """
+        self._receiver = receiver
+        self._settle_on_receive_thread = getattr(receiver, "settle_on_receive_thread", False)
+        self.auto_complete = auto_complete
+        self._settle_worker_count = settle_workers
+        self._poll_interval = poll_interval
+        self._max_poll_interval = max_poll_interval
+
+        self.on_feedback_received = None
+
+        self._batches = queue.Queue(maxsize=prefetch_count)
+        self._settlements = queue.Queue()
+        self._stop_event = threading.Event()
+        self._threads = []
+
+    def start(self):
+        """Start receiving feedback and settling it in the background"""
+        if self._threads:
+            return
+        self._stop_event.clear()
+        receive_thread = threading.Thread(target=self._receive_loop, name="feedback-receive")
+        receive_thread.daemon = True
+        self._threads.append(receive_thread)
+        settle_worker_count = 0 if self._settle_on_receive_thread else self._settle_worker_count
+        for i in range(settle_worker_count):
+            settle_thread = threading.Thread(
+                target=self._settle_loop, name="feedback-settle-{}".format(i)
+            )
+            settle_thread.daemon = True
+            self._threads.append(settle_thread)
+        for thread in self._threads:
+            thread.start()
+
+    def stop(self):
+        """Stop receiving feedback, once the settlements already requested have been made.
+
+        Batches which have been received but not yet delivered are abandoned, so that IoTHub
+        delivers them again.
+        """
+        if not self._threads:
+            return
+        self._stop_event.set()
+        # The receive thread abandons the batches which have not been delivered before it exits
+        receive_thread = self._threads[0]
+        receive_thread.join()
+        for _ in self._threads[1:]:
+            self._settlements.put(None)
+        for thread in self._threads[1:]:
+            thread.join()
+        self._threads = []
+        self._receiver.close()
+
+    def receive(self, block=True, timeout=None):
+        """Return the next batch of feedback, if the on_feedback_received handler is not set.
+
+        :param bool block: Indicates if the operation should block until a batch is available.
+        :param int timeout: Optionally provide a number of seconds until blocking times out.
+
+        :returns: The next :class:`FeedbackBatch`, or None if none was available.
+        """
+        try:
+            batch = self._batches.get(block=block, timeout=timeout)
+        except queue.Empty:
+            return None
+        if self.auto_complete:
+            self.complete(batch)
+        return batch
+
+    @property
+    def stopped(self):
+        """True if the consumer has not been started, or has been stopped"""
+        return not self._threads or self._stop_event.is_set()
+
+    def __iter__(self):
+        while not self.stopped:
+            batch = self.receive(timeout=1)
+            if batch is not None:
+                yield batch
+
+    def __aiter__(self):
+        # Only available on Python 3.5+, which is the only place it can be used
+        from .aio.async_feedback_consumer import AsyncFeedbackIterator
+
+        return AsyncFeedbackIterator(self)
+
+    def complete(self, batch):
+        """Request that a batch be completed, which removes it from the feedback queue of IoTHub.
+
+        This returns immediately, and the batch is completed in the background.
+        """
+        self._settlements.put((self._receiver.complete, batch))
+
+    def abandon(self, batch):
+        """Request that a batch be abandoned, so that IoTHub delivers it again.
+
+        This returns immediately, and the batch is abandoned in the background.
+        """
+        self._settlements.put((self._receiver.abandon, batch))
+
+    def _receive_loop(self):
+        poll_interval = self._poll_interval
+        while not self._stop_event.is_set():
+            self._settle_pending()
+            try:
+                batches = self._receiver.receive()
+            except Exception as e:
+                logger.error("Failed to receive feedback: %s", e)
+                batches = []
+            if not batches:
+                self._wait(poll_interval)
+                poll_interval = min(poll_interval * 2, self._max_poll_interval)
+                continue
+            poll_interval = self._poll_interval
+            logger.debug("Received %s feedback batch(es)", len(batches))
+            for batch in batches:
+                self._deliver(batch)
+        while True:
+            try:
+                self.abandon(self._batches.get_nowait())
+            except queue.Empty:
+                break
+        self._settle_pending()
+
+    def _wait(self, timeout):
+        """Wait for timeout seconds, or until stopped, making settlements in the meantime if they
+        are made on the receive thread"""
+        if not self._settle_on_receive_thread:
+            self._stop_event.wait(timeout)
+            return
+        deadline = time.time() + timeout
+        while not self._stop_event.is_set():
+            remaining = deadline - time.time()
+            if remaining <= 0:
+                return
+            try:
+                settlement = self._settlements.get(timeout=min(remaining, 0.5))
+            except queue.Empty:
+                continue
+            self._settle(settlement)
+
+    def _settle_pending(self):
+        """Make the settlements requested so far, if they are made on the receive thread"""
+        if not self._settle_on_receive_thread:
+            return
+        while True:
+            try:
+                settlement = self._settlements.get_nowait()
+            except queue.Empty:
+                return
+            self._settle(settlement)
+
+    def _deliver(self, batch):
+        handler = self.on_feedback_received
+        if handler is None:
+            # Wait for the application to take the batch, without missing a stop request
+            while not self._stop_event.is_set():
+                try:
+                    self._batches.put(batch, timeout=0.5)
+                    return
+                except queue.Full:
+                    self._settle_pending()
+            self.abandon(batch)
+            return
+        try:
+            handler(batch)
+        except Exception as e:
+            logger.error("Feedback handler raised %s. Abandoning the batch.", e)
+            self.abandon(batch)
+            return
+        if self.auto_complete:
+            self.complete(batch)
+
+    def _settle_loop(self):
+        while True:
+            settlement = self._settlements.get()
+            if settlement is None:
+                return
+            self._settle(settlement)
+
+    def _settle(self, settlement):
+        settle, batch = settlement
+        try:
+            settle(batch.lock_token)
+        except Exception as e:
+            # Most likely the lock has expired, in which case IoTHub delivers the batch again
+            logger.warning("Failed to settle feedback batch of %s record(s): %s", len(batch), e)
@@ -0,0 +1,344 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+"""This module contains helpers to run import and export jobs on a device registry of any size.
+
+Import and export jobs read and write a blob holding one JSON serialized device per line. The
+helpers write that blob from an iterator of devices a block at a time, and read it back a chunk at
+a time, so memory use is bounded by the block and chunk sizes rather than by the size of the
+registry.
+
+The blob container is accessed through a small interface, implemented by LocalBlobContainer (a
+directory on disk, for tests and local development) and by AzureBlobContainer (an adapter for a
+ContainerClient from the azure-storage-blob package):
+
+    stage_block(blob_name, block_id, data)
+    commit_block_list(blob_name, block_ids)
+    download_chunks(blob_name)
+"""
+
+import json
+import logging
+import os
+import time
+from .protocol.models import ExportImportDevice, JobProperties
+
+logger = logging.getLogger(__name__)
+
+DEFAULT_BLOB_NAME = "devices.txt"
+DEFAULT_BLOCK_SIZE = 4 * 1024 * 1024
+DEFAULT_CHUNK_SIZE = 4 * 1024 * 1024
+
+TERMINAL_JOB_STATUSES = ("completed", "failed", "cancelled")
+
+_UTF8_BOM = b"\xef\xbb\xbf"
+
+
+class ImportExportJobError(Exception):
+    """Error raised when an import/export job does not complete"""
+
+    def __init__(self, message, job_properties=None):
+        """Initializer for ImportExportJobError
+
+        :param str message: Error message
+        :param job_properties: The last known state of the job (optional)
+        :type job_properties: :class:`azure.iot.hub.models.JobProperties`
+        """
+        super(ImportExportJobError, self).__init__(message)
+        self.job_properties = job_properties
+
+
+class LocalBlobContainer(object):
+    """A stand-in for a blob container, which keeps its blobs in a local directory.
+
+    Staged blocks are kept in a subdirectory until they are committed, as they are by the
+    storage service.
+    """
+
+    def __init__(self, path, chunk_size=DEFAULT_CHUNK_SIZE):
+        """Initializer for a LocalBlobContainer
+
+        :param str path: The directory to keep the blobs in. It is created if it does not exist.
+        :param int chunk_size: The number of bytes returned by each iteration of download_chunks().
+        """
+        self.path = path
+        self.chunk_size = chunk_size
+        self._staging_path = os.path.join(path, ".staged")
+        if not os.path.isdir(self._staging_path):
+            os.makedirs(self._staging_path)
+
+    def _staged_block_path(self, blob_name, block_id):
+        return os.path.join(self._staging_path, "{}.{}".format(blob_name, block_id))
+
+    def stage_block(self, blob_name, block_id, data):
+        with open(self._staged_block_path(blob_name, block_id), "wb") as block_file:
+            block_file.write(data)
+
+    def commit_block_list(self, blob_name, block_ids):
+        with open(os.path.join(self.path, blob_name), "wb") as blob_file:
+            for block_id in block_ids:
+                block_path = self._staged_block_path(blob_name, block_id)
+                with open(block_path, "rb") as block_file:
+                    blob_file.write(block_file.read())
+                os.remove(block_path)
+
+    def download_chunks(self, blob_name):
+        with open(os.path.join(self.path, blob_name), "rb") as blob_file:
+            while True:
+                chunk = blob_file.read(self.chunk_size)
+                if not chunk:
+                    return
+                yield chunk
+
+
+class AzureBlobContainer(object):
+    """Adapts a ContainerClient from the azure-storage-blob package to the blob container
+    interface used by the import/export helpers.
+
+    The size of downloaded chunks is set by the max_chunk_get_size option of the ContainerClient.
+    """
+
+    def __init__(self, container_client):
+        """Initializer for an AzureBlobContainer
+
+        :param container_client: The client for the container to read and write blobs in.
+        :type container_client: azure.storage.blob.ContainerClient
+        """
+        self._container_client = container_client
+
+    def stage_block(self, blob_name, block_id, data):
+        self._container_client.get_blob_client(blob_name).stage_block(block_id, data)
+
+    def commit_block_list(self, blob_name, block_ids):
+        self._container_client.get_blob_client(blob_name).commit_block_list(block_ids)
+
+    def download_chunks(self, blob_name):
+        return self._container_client.get_blob_client(blob_name).download_blob().chunks()
+
+
+def write_import_blob(
+    container, devices, blob_name=DEFAULT_BLOB_NAME, block_size=DEFAULT_BLOCK_SIZE
+):
+    """Write the input blob of an import job, uploading it in blocks as the devices are read.
+
+    :param container: The blob container to write to.
+    :param devices: An iterable of :class:`azure.iot.hub.models.ExportImportDevice` objects, or
+        of dicts already in the serialized form of the import file.
+    :param str blob_name: The name of the blob to write.
+    :param int block_size: The number of bytes to buffer before uploading them as a block.
+
+    :returns: The number of devices written.
+    """
+    block_ids = []
+    buffer = bytearray()
+    count = 0
+
+    def stage():
+        block_id = "{:08d}".format(len(block_ids))
+        container.stage_block(blob_name, block_id, bytes(buffer))
+        block_ids.append(block_id)
+        del buffer[:]
+
+    for device in devices:
+        if isinstance(device, ExportImportDevice):
+            device = device.serialize()
+        buffer.extend(json.dumps(device, separators=(",", ":")).encode("utf-8"))
+        buffer.extend(b"\n")
+        count += 1
+        if len(buffer) >= block_size:
+            stage()
+    if buffer:
+        stage()
+    container.commit_block_list(blob_name, block_ids)
+    logger.info("Wrote %s device(s) to %s in %s block(s)", count, blob_name, len(block_ids))
+    return count
+
+
+def read_export_blob(container, blob_name=DEFAULT_BLOB_NAME):
+    """Read the output blob of an export job, a chunk at a time.
+
+    :param container: The blob container to read from.
+    :param str blob_name: The name of the blob to read.
+
+    :returns: A generator of :class:`azure.iot.hub.models.ExportImportDevice` objects.
+    """
+    remainder = b""
+    first = True
+    for chunk in container.download_chunks(blob_name):
+        data = remainder + chunk
+        if first:
+            if len(data) < len(_UTF8_BOM) and _UTF8_BOM.startswith(data):
+                remainder = data
+                continue
+            if data.startswith(_UTF8_BOM):
+                data = data[len(_UTF8_BOM) :]
+            first = False
+        lines = data.split(b"\n")
+        remainder = lines.pop()
+        for line in lines:
+            device = _parse_export_line(line)
+            if device is not None:
+                yield device
+    device = _parse_export_line(remainder)
+    if device is not None:
+        yield device
+
+
+def _parse_export_line(line):
+    line = line.strip()
+    if not line:
+        return None
+    return ExportImportDevice.deserialize(json.loads(line.decode("utf-8")))
+
+
+def wait_for_import_export_job(
+    job_manager, job_id, poll_interval=1, max_poll_interval=30, timeout=None
+):
+    """Poll an import/export job until it has completed, failed or been cancelled.
+
+    The job is first polled immediately. The interval between polls then doubles, up to
+    max_poll_interval, for as long as the progress of the job does not change.
+
+    :param job_manager: The job manager to poll the job with.
+    :type job_manager: :class:`azure.iot.hub.IoTHubJobManager`
+    :param str job_id: The ID of the job.
+    :param float poll_interval: The number of seconds between polls after the progress of the
+        job has changed.
+    :param float max_poll_interval: The longest wait between polls.
+    :param float timeout: The number of seconds to wait for the job. If not provided, waits
+        indefinitely.
+
+    :raises: :class:`ImportExportJobError` if the job has not finished within the timeout.
+
+    :returns: The JobProperties of the finished job.
+    :rtype: :class:`azure.iot.hub.models.JobProperties`
+    """
+    deadline = None if timeout is None else time.time() + timeout
+    interval = poll_interval
+    progress = None
+    while True:
+        job = job_manager.get_import_export_job(job_id)
+        if job.status in TERMINAL_JOB_STATUSES:
+            return job
+        if job.progress != progress:
+            progress = job.progress
+            interval = poll_interval
+        else:
+            interval = min(interval * 2, max_poll_interval)
+        if deadline is not None:
+            remaining = deadline - time.time()
+            if remaining <= 0:
+                raise ImportExportJobError(
+                    "Job {} did not finish within {} seconds".format(job_id, timeout), job
+                )
+            interval = min(interval, remaining)
+        logger.debug("Job %s is %s (%s%%)", job_id, job.status, job.progress)
+        time.sleep(interval)
+
+
+class ImportExportJobPipeline(object):
+    """Runs import and export jobs, streaming the devices to and from a blob container"""
+
+    def __init__(
+        self,
+        job_manager,
+        container,
+        container_uri,
+        block_size=DEFAULT_BLOCK_SIZE,
+        poll_interval=1,
+        max_poll_interval=30,
+    ):
+        """Initializer for an ImportExportJobPipeline
+
+        :param job_manager: The job manager to run the jobs with.
+        :type job_manager: :class:`azure.iot.hub.IoTHubJobManager`
+        :param container: The blob container to write and read the device blobs with, such as
+            an :class:`AzureBlobContainer`.
+        :param str container_uri: The URI, including a SAS token unless identity based
+            authentication is used, by which IoTHub accesses the same container.
+        :param int block_size: The number of bytes uploaded in each block of an import blob.
+        :param float poll_interval: The number of seconds between polls of a job after its
+            progress has changed. A job is first polled as soon as it has been created.
+        :param float max_poll_interval: The longest wait between polls of a job.
+        """
+        self.job_manager = job_manager
+        self.container = container
+        self.container_uri = container_uri
+        self.block_size = block_size
+        self.poll_interval = poll_interval
+        self.max_poll_interval = max_poll_interval
+
+    def import_devices(
+        self, devices, blob_name=DEFAULT_BLOB_NAME, timeout=None, **job_properties_kwargs
+    ):
+        """Write the devices to an input blob, and run an import job on it.
+
+        :param devices: An iterable of :class:`azure.iot.hub.models.ExportImportDevice`
+            objects, each with the import_mode to apply.
+        :param str blob_name: The name of the input blob.
+        :param float timeout: The number of seconds to wait for the job. If not provided, waits
+            indefinitely.
+        :param job_properties_kwargs: Other properties of the job, such as
+            storage_authentication_type.
+
+        :raises: :class:`ImportExportJobError` if the job fails, is cancelled, or does not
+            finish within the timeout.
+
+        :returns: The JobProperties of the completed job.
+        :rtype: :class:`azure.iot.hub.models.JobProperties`
+        """
+        write_import_blob(self.container, devices, blob_name, self.block_size)
+        job_properties = JobProperties(
+            type="import",
+            input_blob_container_uri=self.container_uri,
+            input_blob_name=blob_name,
+            output_blob_container_uri=self.container_uri,
+            **job_properties_kwargs
+        )
+        return self._run(job_properties, timeout)
+
+    def export_devices(
+        self, exclude_keys=True, blob_name=DEFAULT_BLOB_NAME, timeout=None, **job_properties_kwargs
+    ):
+        """Run an export job, and read the devices from its output blob once it has completed.
+
+        :param bool exclude_keys: Leave the authentication keys out of the export.
+        :param str blob_name: The name of the output blob.
+        :param float timeout: The number of seconds to wait for the job. If not provided, waits
+            indefinitely.
+        :param job_properties_kwargs: Other properties of the job, such as
+            storage_authentication_type.
+
+        :raises: :class:`ImportExportJobError` if the job fails, is cancelled, or does not
+            finish within the timeout.
+
+        :returns: A generator of the exported :class:`azure.iot.hub.models.ExportImportDevice`
+            objects, which reads the output blob as it is iterated over.
+        """
+        job_properties = JobProperties(
+            type="export",
+            output_blob_container_uri=self.container_uri,
+            output_blob_name=blob_name,
+            exclude_keys_in_export=exclude_keys,
+            **job_properties_kwargs
+        )
+        self._run(job_properties, timeout)
+        return read_export_blob(self.container, blob_name)
+
+    def _run(self, job_properties, timeout):
+        job = self.job_manager.create_import_export_job(job_properties)
+        logger.info("Created %s job %s", job_properties.type, job.job_id)
+        job = wait_for_import_export_job(
+            self.job_manager,
+            job.job_id,
+            poll_interval=self.poll_interval,
+            max_poll_interval=self.max_poll_interval,
+            timeout=timeout,
+        )
+        if job.status != "completed":
+            raise ImportExportJobError(
+                "Job {} {}: {}".format(job.job_id, job.status, job.failure_reason), job
+            )
+        return job
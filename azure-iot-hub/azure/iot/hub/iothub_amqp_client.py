@@ -20,38 +20,56 @@ except Exception:
     from urllib.parse import quote, quote_plus, urlencode
 
 import uamqp
+from uamqp.authentication import JWTTokenAuth
+from azure.core.credentials import AccessToken
 
-default_sas_expiry = 30
+logger = logging.getLogger(__name__)
+
+# Lifetime of the SAS tokens put on the CBS link of a connection.  uamqp replaces the token on the
+# same connection before it expires, so this does not limit the lifetime of the connection.
+cbs_token_expiry = 3600
+
+# Errors raised by uamqp when the SAS token of a connection is rejected, or could not be refreshed
+# before it expired
+AUTHENTICATION_ERRORS = (uamqp.errors.AuthenticationException, uamqp.errors.TokenExpired)
 
 
 class IoTHubAmqpClient:
-    def _generate_auth_token(self, uri, sas_name, sas_value):
-        sas = base64.b64decode(sas_value)
-        expiry = str(int(time.time() + default_sas_expiry))
-        string_to_sign = (uri + "\n" + expiry).encode("utf-8")
-        signed_hmac_sha256 = hmac.HMAC(sas, string_to_sign, hashlib.sha256)
-        signature = urllib.parse.quote(base64.b64encode(signed_hmac_sha256.digest()))
-        return "SharedAccessSignature sr={}&sig={}&se={}&skn={}".format(
-            uri, signature, expiry, sas_name
-        )
+    def _create_cbs_auth(self):
+        """Create the authentication for a new AMQP connection, which puts a SAS token on the
+        CBS link of the connection, and puts a new one there before it expires.
+
+        Each connection needs an authentication object of its own.
+        """
+
+        def get_token():
+            expiry = int(time.time() + cbs_token_expiry)
+            sas = base64.b64decode(self._shared_access_key + "=")
+            string_to_sign = (self._hostname + "\n" + str(expiry)).encode("utf-8")
+            signed_hmac_sha256 = hmac.HMAC(sas, string_to_sign, hashlib.sha256)
+            signature = urllib.parse.quote(base64.b64encode(signed_hmac_sha256.digest()))
+            token = "SharedAccessSignature sr={}&sig={}&se={}&skn={}".format(
+                self._hostname, signature, expiry, self._shared_access_key_name
+            )
+            return AccessToken(token, expiry)
 
-    def _build_amqp_endpoint(self, hostname, shared_access_key_name, shared_access_key):
-        hub_name = hostname.split(".")[0]
-        endpoint = "{}@sas.root.{}".format(shared_access_key_name, hub_name)
-        endpoint = quote_plus(endpoint)
-        sas_token = self._generate_auth_token(
-            hostname, shared_access_key_name, shared_access_key + "="
+        auth = JWTTokenAuth(
+            audience="https://" + self._hostname,
+            uri="https://" + self._hostname,
+            get_token=get_token,
+            token_type=b"servicebus.windows.net:sastoken",
         )
-        endpoint = endpoint + ":{}@{}".format(quote_plus(sas_token), hostname)
-        return endpoint
+        auth.update_token()
+        return auth
 
     def __init__(self, hostname, shared_access_key_name, shared_access_key):
-        self.endpoint = self._build_amqp_endpoint(
-            hostname, shared_access_key_name, shared_access_key
-        )
-        operation = "/messages/devicebound"
-        target = "amqps://" + self.endpoint + operation
-        self.amqp_client = uamqp.SendClient(target)
+        self._hostname = hostname
+        self._shared_access_key_name = shared_access_key_name
+        self._shared_access_key = shared_access_key
+        # The connection is kept open, and its SAS token refreshed, for as long as the client is used
+        target = "amqps://" + hostname + "/messages/devicebound"
+        self.amqp_client = uamqp.SendClient(target, auth=self._create_cbs_auth())
+        self.feedback_client = None
 
     def disconnect_sync(self):
         """
@@ -60,6 +78,7 @@ class IoTHubAmqpClient:
         if self.amqp_client:
             self.amqp_client.close()
             self.amqp_client = None
+        self.close_feedback_receiver()
 
     def send_message_to_device(self, device_id, message, app_props):
         """Send a message to the specified deivce.
@@ -100,3 +119,46 @@ class IoTHubAmqpClient:
         results = self.amqp_client.send_all_messages(close_on_done=False)
         if uamqp.constants.MessageState.SendFailed in results:
             raise Exception("C2D message send failure")
+
+    def receive_feedback_notifications(self, max_batch_size=100, timeout=5):
+        """Receive feedback notifications for cloud-to-device messages from the
+        /messages/servicebound/feedback link.
+
+        The messages are not settled. Each must be accepted once its feedback has been processed,
+        or released for it to be delivered again, on the thread which received it.
+
+        The SAS token of the link is refreshed on the open connection, so the link stays open
+        (and messages received on it can be settled) for as long as it is used.  If the receive
+        fails, the link is closed, and the next receive opens a new one.
+
+        :param int max_batch_size: The maximum number of messages to receive.
+        :param int timeout: The number of seconds to wait for messages.
+
+        :returns: The list of uamqp messages received, each containing a JSON array of feedback
+            records. The list is empty if there was no feedback within the timeout.
+        """
+        if not self.feedback_client:
+            source = "amqps://" + self._hostname + "/messages/servicebound/feedback"
+            self.feedback_client = uamqp.ReceiveClient(
+                source, auth=self._create_cbs_auth(), auto_complete=False
+            )
+        try:
+            return self.feedback_client.receive_message_batch(
+                max_batch_size=max_batch_size, timeout=timeout * 1000
+            )
+        except Exception:
+            self.close_feedback_receiver()
+            raise
+
+    def close_feedback_receiver(self):
+        """
+        Close the link used to receive feedback notifications, if it is open.
+        """
+        feedback_client = self.feedback_client
+        self.feedback_client = None
+        if feedback_client:
+            try:
+                feedback_client.close()
+            except Exception as e:
+                # The link may already be broken, which is why it is being closed
+                logger.debug("Failed to close the feedback link: %s", e)
@@ -4,8 +4,9 @@
 # license information.
 # --------------------------------------------------------------------------
 
-from .auth import ConnectionStringAuthentication, AzureIdentityCredentialAdapter
-from .protocol.iot_hub_gateway_service_ap_is import IotHubGatewayServiceAPIs as protocol_client
+from .auth import AzureIdentityCredentialAdapter
+from .service_context import IoTHubServiceContext
+from .feedback_consumer import FeedbackConsumer, HttpFeedbackReceiver, AmqpFeedbackReceiver
 
 
 class IoTHubHttpRuntimeManager(object):
@@ -13,7 +14,7 @@ class IoTHubHttpRuntimeManager(object):
     based on top of the auto generated IotHub REST APIs
     """
 
-    def __init__(self, connection_string=None, host=None, auth=None):
+    def __init__(self, connection_string=None, host=None, auth=None, service_context=None):
         """Initializer for a Http Runtime Manager Service client.
 
         After a successful creation the class has been authenticated with IoTHub and
@@ -25,16 +26,22 @@ class IoTHubHttpRuntimeManager(object):
             Default value: None
         :param str auth: The Azure authentication object if we are using token credential authentication.
             Default value: None
+        :param service_context: A context shared with other service clients, to use instead of
+            creating new connections. If provided, the other parameters are ignored.
+            Default value: None
+        :type service_context: :class:`azure.iot.hub.IoTHubServiceContext`
 
         :returns: Instance of the IoTHubHttpRuntimeManager object.
         :rtype: :class:`azure.iot.hub.IoTHubHttpRuntimeManager`
         """
-        if connection_string is not None:
-            self.auth = ConnectionStringAuthentication(connection_string)
-            self.protocol = protocol_client(self.auth, "https://" + self.auth["HostName"])
+        if service_context is None:
+            service_context = IoTHubServiceContext(connection_string, host, auth)
+            self._owns_service_context = True
         else:
-            self.auth = auth
-            self.protocol = protocol_client(self.auth, "https://" + host)
+            self._owns_service_context = False
+        self._service_context = service_context
+        self.auth = service_context.auth
+        self.protocol = service_context.protocol
 
     @classmethod
     def from_connection_string(cls, connection_string):
@@ -68,6 +75,26 @@ class IoTHubHttpRuntimeManager(object):
         auth = AzureIdentityCredentialAdapter(token_credential)
         return cls(host=host, auth=auth)
 
+    @classmethod
+    def from_service_context(cls, service_context):
+        """Classmethod initializer for a IoTHubHttpRuntimeManager Service client.
+        Creates IoTHubHttpRuntimeManager class sharing the connections of a service context with the other
+        service clients created from it.
+
+        :param service_context: The service context to share.
+        :type service_context: :class:`azure.iot.hub.IoTHubServiceContext`
+
+        :rtype: :class:`azure.iot.hub.IoTHubHttpRuntimeManager`
+        """
+        return cls(service_context=service_context)
+
+    def __del__(self):
+        """
+        Deinitializer for a Http Runtime Manager Service client.
+        """
+        if getattr(self, "_owns_service_context", False):
+            self._service_context.close()
+
     def receive_feedback_notification(self):
         """This method is used to retrieve feedback of a cloud-to-device message.
 
@@ -101,3 +128,32 @@ class IoTHubHttpRuntimeManager(object):
         :returns: None.
         """
         return self.protocol.cloud_to_device_messages.abandon_feedback_notification(lock_token)
+
+    def create_feedback_consumer(self, use_amqp=False, **kwargs):
+        """Create a consumer which receives feedback continuously, and completes or abandons it
+        in the background.
+
+        Feedback is delivered to the consumer's on_feedback_received handler, or returned from
+        its receive method (or by iterating over it), once the consumer has been started.
+
+        :param bool use_amqp: Receive feedback over the /messages/servicebound/feedback AMQP
+            link instead of the HTTP endpoint. Requires connection string authentication.
+            Default value: False
+        :param kwargs: Options for the :class:`azure.iot.hub.feedback_consumer.FeedbackConsumer`
+
+        :raises: ValueError if use_amqp is True and the manager was not created from a
+            connection string.
+
+        :returns: The consumer, which has not yet been started.
+        :rtype: :class:`azure.iot.hub.feedback_consumer.FeedbackConsumer`
+        """
+        if use_amqp:
+            # The receiver has a client of its own, as the shared one is replaced when its SAS
+            # token expires
+            amqp_client = self._service_context.create_amqp_client()
+            if amqp_client is None:
+                raise ValueError("Receiving feedback over AMQP requires a connection string")
+            receiver = AmqpFeedbackReceiver(amqp_client)
+        else:
+            receiver = HttpFeedbackReceiver(self)
+        return FeedbackConsumer(receiver, **kwargs)
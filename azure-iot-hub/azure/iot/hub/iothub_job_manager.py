@@ -4,8 +4,8 @@
 # license information.
 # --------------------------------------------------------------------------
 
-from .auth import ConnectionStringAuthentication, AzureIdentityCredentialAdapter
-from .protocol.iot_hub_gateway_service_ap_is import IotHubGatewayServiceAPIs as protocol_client
+from .auth import AzureIdentityCredentialAdapter
+from .service_context import IoTHubServiceContext
 
 
 class IoTHubJobManager(object):
@@ -13,7 +13,7 @@ class IoTHubJobManager(object):
     based on top of the auto generated IotHub REST APIs
     """
 
-    def __init__(self, connection_string=None, host=None, auth=None):
+    def __init__(self, connection_string=None, host=None, auth=None, service_context=None):
         """Initializer for a Job Manager Service client.
 
         After a successful creation the class has been authenticated with IoTHub and
@@ -25,16 +25,22 @@ class IoTHubJobManager(object):
             Default value: None
         :param str auth: The Azure authentication object if we are using token credential authentication.
             Default value: None
+        :param service_context: A context shared with other service clients, to use instead of
+            creating new connections. If provided, the other parameters are ignored.
+            Default value: None
+        :type service_context: :class:`azure.iot.hub.IoTHubServiceContext`
 
         :returns: Instance of the IoTHubJobManager object.
         :rtype: :class:`azure.iot.hub.IoTHubJobManager`
         """
-        if connection_string is not None:
-            self.auth = ConnectionStringAuthentication(connection_string)
-            self.protocol = protocol_client(self.auth, "https://" + self.auth["HostName"])
+        if service_context is None:
+            service_context = IoTHubServiceContext(connection_string, host, auth)
+            self._owns_service_context = True
         else:
-            self.auth = auth
-            self.protocol = protocol_client(self.auth, "https://" + host)
+            self._owns_service_context = False
+        self._service_context = service_context
+        self.auth = service_context.auth
+        self.protocol = service_context.protocol
 
     @classmethod
     def from_connection_string(cls, connection_string):
@@ -68,6 +74,26 @@ class IoTHubJobManager(object):
         auth = AzureIdentityCredentialAdapter(token_credential)
         return cls(host=host, auth=auth)
 
+    @classmethod
+    def from_service_context(cls, service_context):
+        """Classmethod initializer for a IoTHubJobManager Service client.
+        Creates IoTHubJobManager class sharing the connections of a service context with the other
+        service clients created from it.
+
+        :param service_context: The service context to share.
+        :type service_context: :class:`azure.iot.hub.IoTHubServiceContext`
+
+        :rtype: :class:`azure.iot.hub.IoTHubJobManager`
+        """
+        return cls(service_context=service_context)
+
+    def __del__(self):
+        """
+        Deinitializer for a Job Manager Service client.
+        """
+        if getattr(self, "_owns_service_context", False):
+            self._service_context.close()
+
     def create_import_export_job(self, job_properties):
         """Creates a new import/export job on an IoT hub.
 
@@ -3,9 +3,9 @@
 # Licensed under the MIT License. See License.txt in the project root for
 # license information.
 # --------------------------------------------------------------------------
-from .iothub_amqp_client import IoTHubAmqpClient as iothub_amqp_client
-from .auth import ConnectionStringAuthentication, AzureIdentityCredentialAdapter
-from .protocol.iot_hub_gateway_service_ap_is import IotHubGatewayServiceAPIs as protocol_client
+from .auth import AzureIdentityCredentialAdapter
+from .service_context import IoTHubServiceContext
+from .iothub_amqp_client import AUTHENTICATION_ERRORS
 from .protocol.models import (
     Device,
     Module,
@@ -56,7 +56,7 @@ class IoTHubRegistryManager(object):
     based on top of the auto generated IotHub REST APIs
     """
 
-    def __init__(self, connection_string=None, host=None, auth=None):
+    def __init__(self, connection_string=None, host=None, auth=None, service_context=None):
         """Initializer for a Registry Manager Service client.
 
         After a successful creation the class has been authenticated with IoTHub and
@@ -68,22 +68,22 @@ class IoTHubRegistryManager(object):
             Default value: None
         :param str auth: The Azure authentication object if we are using token credential authentication.
             Default value: None
+        :param service_context: A context shared with other service clients, to use instead of
+            creating new connections. If provided, the other parameters are ignored.
+            Default value: None
+        :type service_context: :class:`azure.iot.hub.IoTHubServiceContext`
 
         :returns: Instance of the IoTHubRegistryManager object.
         :rtype: :class:`azure.iot.hub.IoTHubRegistryManager`
         """
-        if connection_string is not None:
-            self.auth = ConnectionStringAuthentication(connection_string)
-            self.protocol = protocol_client(self.auth, "https://" + self.auth["HostName"])
-            self.amqp_svc_client = iothub_amqp_client(
-                self.auth["HostName"],
-                self.auth["SharedAccessKeyName"],
-                self.auth["SharedAccessKey"],
-            )
+        if service_context is None:
+            service_context = IoTHubServiceContext(connection_string, host, auth)
+            self._owns_service_context = True
         else:
-            self.auth = auth
-            self.protocol = protocol_client(self.auth, "https://" + host)
-            self.amqp_svc_client = None
+            self._owns_service_context = False
+        self._service_context = service_context
+        self.auth = service_context.auth
+        self.protocol = service_context.protocol
 
     @classmethod
     def from_connection_string(cls, connection_string):
@@ -117,12 +117,33 @@ class IoTHubRegistryManager(object):
         auth = AzureIdentityCredentialAdapter(token_credential)
         return cls(host=host, auth=auth)
 
+    @classmethod
+    def from_service_context(cls, service_context):
+        """Classmethod initializer for a IoTHubRegistryManager Service client.
+        Creates IoTHubRegistryManager class sharing the connections of a service context with the other
+        service clients created from it.
+
+        :param service_context: The service context to share.
+        :type service_context: :class:`azure.iot.hub.IoTHubServiceContext`
+
+        :rtype: :class:`azure.iot.hub.IoTHubRegistryManager`
+        """
+        return cls(service_context=service_context)
+
     def __del__(self):
         """
         Deinitializer for a Registry Manager Service client.
         """
-        if self.amqp_svc_client:
-            self.amqp_svc_client.disconnect_sync()
+        if getattr(self, "_owns_service_context", False):
+            self._service_context.close()
+
+    @property
+    def amqp_svc_client(self):
+        """The AMQP client used to send cloud-to-device messages, created on first use.
+
+        None if the Registry Manager was not created from a connection string.
+        """
+        return self._service_context.amqp_client
 
     def create_device_with_sas(
         self,
@@ -924,5 +945,11 @@ class IoTHubRegistryManager(object):
         :raises: Exception if the Send command is not able to send the message
         """
 
-        if self.amqp_svc_client:
-            self.amqp_svc_client.send_message_to_device(device_id, message, properties)
+        amqp_svc_client = self.amqp_svc_client
+        if amqp_svc_client:
+            try:
+                amqp_svc_client.send_message_to_device(device_id, message, properties)
+            except AUTHENTICATION_ERRORS:
+                # The SAS token of the AMQP client was rejected. Try once more with a new client.
+                self._service_context.discard_amqp_client(amqp_svc_client)
+                self.amqp_svc_client.send_message_to_device(device_id, message, properties)
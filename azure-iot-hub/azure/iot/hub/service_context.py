@@ -0,0 +1,138 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+
+import threading
+from .auth import ConnectionStringAuthentication, AzureIdentityCredentialAdapter
+from .iothub_amqp_client import IoTHubAmqpClient as iothub_amqp_client
+from .protocol.iot_hub_gateway_service_ap_is import IotHubGatewayServiceAPIs as protocol_client
+
+
+class IoTHubServiceContext(object):
+    """A class holding the connections to an IoTHub which can be shared by the service clients.
+
+    Each service client created on its own has its own HTTP connection pool and its own
+    authentication. Service clients created from the same IoTHubServiceContext instead share a
+    single protocol client (and so a single HTTP connection pool, and the SAS token it caches),
+    and a single AMQP client, which is only created when it is first used. The AMQP connection is
+    kept open, and the SAS token on it refreshed, until the context is closed.
+    """
+
+    def __init__(self, connection_string=None, host=None, auth=None):
+        """Initializer for an IoTHubServiceContext.
+
+        :param str connection_string: The IoTHub connection string used to authenticate connection
+            with IoTHub if we are using connection_str authentication. Default value: None
+        :param str host: The Azure service url if we are using token credential authentication.
+            Default value: None
+        :param str auth: The Azure authentication object if we are using token credential authentication.
+            Default value: None
+
+        :returns: Instance of the IoTHubServiceContext object.
+        :rtype: :class:`azure.iot.hub.IoTHubServiceContext`
+        """
+        if connection_string is not None:
+            self.auth = ConnectionStringAuthentication(connection_string)
+            self.protocol = protocol_client(self.auth, "https://" + self.auth["HostName"])
+        else:
+            self.auth = auth
+            self.protocol = protocol_client(self.auth, "https://" + host)
+        # Keep the HTTP connections open between requests, until close() is called
+        self.protocol.config.keep_alive = True
+        self._amqp_client = None
+        self._amqp_lock = threading.Lock()
+
+    @classmethod
+    def from_connection_string(cls, connection_string):
+        """Classmethod initializer for an IoTHubServiceContext.
+        Creates IoTHubServiceContext class from connection string.
+
+        :param str connection_string: The IoTHub connection string used to authenticate connection
+            with IoTHub.
+
+        :rtype: :class:`azure.iot.hub.IoTHubServiceContext`
+        """
+        return cls(connection_string=connection_string)
+
+    @classmethod
+    def from_token_credential(cls, url, token_credential):
+        """Classmethod initializer for an IoTHubServiceContext.
+        Creates IoTHubServiceContext class from host name url and Azure token credential.
+
+        :param str url: The Azure service url (host name).
+        :param str token_credential: The Azure token credential object.
+
+        :rtype: :class:`azure.iot.hub.IoTHubServiceContext`
+        """
+        host = url
+        auth = AzureIdentityCredentialAdapter(token_credential)
+        return cls(host=host, auth=auth)
+
+    @property
+    def amqp_client(self):
+        """The AMQP client for the IoTHub, created on first use.
+
+        None if the context was not created from a connection string, as the AMQP client only
+        supports shared access key authentication.
+
+        :rtype: :class:`azure.iot.hub.IoTHubAmqpClient`
+        """
+        if not isinstance(self.auth, ConnectionStringAuthentication):
+            return None
+        with self._amqp_lock:
+            if self._amqp_client is None:
+                self._amqp_client = self.create_amqp_client()
+            return self._amqp_client
+
+    def create_amqp_client(self):
+        """Create a new AMQP client for the IoTHub, which is not shared.
+
+        The caller must disconnect it once it is no longer used.
+
+        :returns: The AMQP client, or None if the context was not created from a connection
+            string.
+        :rtype: :class:`azure.iot.hub.IoTHubAmqpClient`
+        """
+        if not isinstance(self.auth, ConnectionStringAuthentication):
+            return None
+        return iothub_amqp_client(
+            self.auth["HostName"],
+            self.auth["SharedAccessKeyName"],
+            self.auth["SharedAccessKey"],
+        )
+
+    def discard_amqp_client(self, amqp_client):
+        """Disconnect the given AMQP client, if it is the one held by the context, so that a new
+        one (with a new connection) is created on next use.
+
+        This is used when the SAS token of the client's connection has been rejected.
+
+        :param amqp_client: The client to discard.
+        :type amqp_client: :class:`azure.iot.hub.IoTHubAmqpClient`
+        """
+        with self._amqp_lock:
+            if self._amqp_client is not amqp_client:
+                return
+            self._amqp_client = None
+        amqp_client.disconnect_sync()
+
+    def disconnect_amqp(self):
+        """Disconnect the AMQP client, if it has been created.
+
+        It is created again if it is used afterwards.
+        """
+        with self._amqp_lock:
+            amqp_client = self._amqp_client
+            self._amqp_client = None
+        if amqp_client:
+            amqp_client.disconnect_sync()
+
+    def close(self):
+        """Close the HTTP connections and the AMQP client of the context.
+
+        The service clients created from the context must not be used once it has been closed.
+        """
+        self.disconnect_amqp()
+        self.protocol.close()
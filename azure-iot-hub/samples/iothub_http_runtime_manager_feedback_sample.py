@@ -0,0 +1,41 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+
+import os
+import time
+from azure.iot.hub import IoTHubHttpRuntimeManager
+
+connection_str = os.getenv("IOTHUB_CONNECTION_STRING")
+# Set to receive the feedback over AMQP rather than HTTP
+use_amqp = os.getenv("IOTHUB_FEEDBACK_USE_AMQP") is not None
+
+
+def on_feedback_received(batch):
+    for record in batch:
+        print(
+            "Message {0} to {1}: {2}".format(
+                record.original_message_id, record.device_id, record.status_code
+            )
+        )
+
+
+try:
+    # Create IoTHubHttpRuntimeManager
+    http_runtime_manager = IoTHubHttpRuntimeManager.from_connection_string(connection_str)
+
+    # Receive feedback continuously. Each batch is completed once the handler has returned.
+    consumer = http_runtime_manager.create_feedback_consumer(use_amqp=use_amqp)
+    consumer.on_feedback_received = on_feedback_received
+    consumer.start()
+
+    while True:
+        time.sleep(1)
+
+except Exception as ex:
+    print("Unexpected error {0}".format(ex))
+except KeyboardInterrupt:
+    print("iothub_http_runtime_manager_feedback stopped")
+    consumer.stop()
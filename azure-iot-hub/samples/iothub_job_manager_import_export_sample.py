@@ -0,0 +1,44 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+
+import os
+from azure.storage.blob import ContainerClient
+from azure.iot.hub import IoTHubJobManager
+from azure.iot.hub.models import ExportImportDevice
+from azure.iot.hub.import_export_job import AzureBlobContainer, ImportExportJobPipeline
+
+iothub_connection_str = os.getenv("IOTHUB_CONNECTION_STRING")
+# A SAS URI for the container, with read, write and list permissions
+container_uri = os.getenv("JOB_EXPORT_IMPORT_OUTPUT_URI")
+
+
+def generate_devices(count):
+    # A generator, so the devices are never all in memory at once
+    for i in range(count):
+        yield ExportImportDevice(id="import-sample-device-{}".format(i), import_mode="create")
+
+
+try:
+    iothub_job_manager = IoTHubJobManager(iothub_connection_str)
+    container = AzureBlobContainer(ContainerClient.from_container_url(container_uri))
+    pipeline = ImportExportJobPipeline(iothub_job_manager, container, container_uri)
+
+    # Import devices, uploading the input blob in blocks as the devices are generated
+    job = pipeline.import_devices(generate_devices(10000), storage_authentication_type="keyBased")
+    print("Import job {} {}".format(job.job_id, job.status))
+
+    # Export the registry, reading the output blob a chunk at a time
+    count = 0
+    for device in pipeline.export_devices(storage_authentication_type="keyBased"):
+        count += 1
+        if count <= 10:
+            print("    {} ({})".format(device.id, device.status))
+    print("Exported {} device(s)".format(count))
+
+except Exception as ex:
+    print("Unexpected error {0}".format(ex))
+except KeyboardInterrupt:
+    print("iothub_job_manager_import_export_sample stopped")
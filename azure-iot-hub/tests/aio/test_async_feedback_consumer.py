@@ -0,0 +1,42 @@
+# --------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+
+import pytest
+from azure.iot.hub.feedback_consumer import FeedbackConsumer
+from azure.iot.hub.aio import AsyncFeedbackIterator
+from ..test_feedback_consumer import FakeReceiver, make_batch
+
+pytestmark = pytest.mark.asyncio
+
+
+@pytest.mark.describe("FeedbackConsumer - async iteration")
+class TestFeedbackConsumerAsyncIteration(object):
+    @pytest.mark.it("Returns an AsyncFeedbackIterator")
+    async def test_aiter(self):
+        consumer = FeedbackConsumer(FakeReceiver())
+        assert isinstance(consumer.__aiter__(), AsyncFeedbackIterator)
+
+    @pytest.mark.it("Yields batches, and completes them, until the consumer is stopped")
+    async def test_iterate(self):
+        receiver = FakeReceiver()
+        consumer = FeedbackConsumer(receiver, poll_interval=0.01)
+        consumer.start()
+        receiver.batches = [make_batch("token1"), make_batch("token2")]
+
+        lock_tokens = []
+        async for batch in consumer:
+            lock_tokens.append(batch.lock_token)
+            if len(lock_tokens) == 2:
+                consumer.stop()
+
+        assert lock_tokens == ["token1", "token2"]
+        assert sorted(receiver.completed) == ["token1", "token2"]
+
+    @pytest.mark.it("Ends immediately if the consumer has not been started")
+    async def test_not_started(self):
+        consumer = FeedbackConsumer(FakeReceiver())
+        async for batch in consumer:
+            assert False
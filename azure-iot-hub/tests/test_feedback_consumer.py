@@ -0,0 +1,425 @@
+# --------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+
+import pytest
+import json
+import threading
+import time
+from azure.iot.hub.feedback_consumer import (
+    FeedbackConsumer,
+    FeedbackBatch,
+    FeedbackRecord,
+    HttpFeedbackReceiver,
+    AmqpFeedbackReceiver,
+    decode_feedback_batch,
+)
+
+"""---Constants---"""
+
+fake_lock_token = "fake_lock_token"
+fake_feedback = [
+    {
+        "originalMessageId": "message1",
+        "deviceGenerationId": "generation1",
+        "deviceId": "device1",
+        "enqueuedTimeUtc": "2020-03-20T18:00:00.0000000Z",
+        "statusCode": "Success",
+        "description": "Success",
+    },
+    {
+        "originalMessageId": "message2",
+        "deviceGenerationId": "generation2",
+        "deviceId": "device2",
+        "enqueuedTimeUtc": "2020-03-20T18:00:01.0000000Z",
+        "statusCode": "Expired",
+        "description": "Message Expired",
+    },
+]
+fake_feedback_body = json.dumps(fake_feedback).encode("utf-8")
+
+
+"""----Shared fixtures----"""
+
+
+class FakeReceiver(object):
+    """Receiver which returns the batches put into it, and records settlements"""
+
+    def __init__(self):
+        self.batches = []
+        self.lock = threading.Lock()
+        self.completed = []
+        self.abandoned = []
+        self.closed = False
+
+    def receive(self):
+        with self.lock:
+            batches = self.batches
+            self.batches = []
+        return batches
+
+    def complete(self, lock_token):
+        with self.lock:
+            self.completed.append(lock_token)
+
+    def abandon(self, lock_token):
+        with self.lock:
+            self.abandoned.append(lock_token)
+
+    def close(self):
+        self.closed = True
+
+
+def make_batch(lock_token):
+    return FeedbackBatch(decode_feedback_batch(fake_feedback_body), lock_token)
+
+
+def wait_for(condition, timeout=5):
+    deadline = time.time() + timeout
+    while not condition():
+        if time.time() > deadline:
+            raise AssertionError("Condition not met within timeout")
+        time.sleep(0.01)
+
+
+@pytest.fixture
+def receiver():
+    return FakeReceiver()
+
+
+@pytest.fixture
+def consumer(receiver):
+    consumer = FeedbackConsumer(receiver, poll_interval=0.01, max_poll_interval=0.05)
+    yield consumer
+    consumer.stop()
+
+
+@pytest.mark.describe("decode_feedback_batch()")
+class TestDecodeFeedbackBatch(object):
+    @pytest.mark.it("Decodes a JSON array of feedback into FeedbackRecords")
+    @pytest.mark.parametrize(
+        "body",
+        [
+            pytest.param(fake_feedback_body, id="bytes"),
+            pytest.param(fake_feedback_body.decode("utf-8"), id="str"),
+        ],
+    )
+    def test_decode(self, body):
+        records = decode_feedback_batch(body)
+        assert len(records) == 2
+        assert all(isinstance(record, FeedbackRecord) for record in records)
+        assert records[0].original_message_id == "message1"
+        assert records[0].device_id == "device1"
+        assert records[0].device_generation_id == "generation1"
+        assert records[0].status_code == "Success"
+        assert records[0].description == "Success"
+        assert records[0].enqueued_time_utc == "2020-03-20T18:00:00.0000000Z"
+        assert records[1].original_message_id == "message2"
+        assert records[1].status_code == "Expired"
+
+    @pytest.mark.it("Returns an empty list for an empty body")
+    def test_empty(self):
+        assert decode_feedback_batch(b"") == []
+
+
+@pytest.mark.describe("HttpFeedbackReceiver")
+class TestHttpFeedbackReceiver(object):
+    @pytest.fixture
+    def operations(self, mocker):
+        return mocker.MagicMock()
+
+    @pytest.fixture
+    def http_receiver(self, mocker, operations):
+        manager = mocker.MagicMock()
+        manager.protocol.cloud_to_device_messages = operations
+        return HttpFeedbackReceiver(manager)
+
+    @pytest.mark.it(
+        "Receives a raw feedback response, and returns a batch with the lock token from the ETag header"
+    )
+    def test_receive(self, mocker, operations, http_receiver):
+        response = operations.receive_feedback_notification.return_value.response
+        response.status_code = 200
+        response.headers = {"ETag": '"{}"'.format(fake_lock_token)}
+        response.content = fake_feedback_body
+
+        batches = http_receiver.receive()
+
+        assert operations.receive_feedback_notification.call_args == mocker.call(raw=True)
+        assert len(batches) == 1
+        assert batches[0].lock_token == fake_lock_token
+        assert [record.original_message_id for record in batches[0]] == ["message1", "message2"]
+
+    @pytest.mark.it("Returns no batches if there is no feedback")
+    def test_receive_no_content(self, operations, http_receiver):
+        operations.receive_feedback_notification.return_value.response.status_code = 204
+        assert http_receiver.receive() == []
+
+    @pytest.mark.it("Completes and abandons feedback with the protocol layer HTTP runtime")
+    def test_settle(self, mocker, operations, http_receiver):
+        http_receiver.complete(fake_lock_token)
+        http_receiver.abandon(fake_lock_token)
+        assert operations.complete_feedback_notification.call_args == mocker.call(fake_lock_token)
+        assert operations.abandon_feedback_notification.call_args == mocker.call(fake_lock_token)
+
+
+@pytest.mark.describe("AmqpFeedbackReceiver")
+class TestAmqpFeedbackReceiver(object):
+    @pytest.mark.it("Returns a batch for each message received on the feedback link")
+    def test_receive(self, mocker):
+        amqp_client = mocker.MagicMock()
+        messages = [mocker.MagicMock(), mocker.MagicMock()]
+        for message in messages:
+            message.get_data.return_value = iter([fake_feedback_body[:10], fake_feedback_body[10:]])
+        amqp_client.receive_feedback_notifications.return_value = messages
+        amqp_receiver = AmqpFeedbackReceiver(amqp_client, max_batch_count=50, timeout=3)
+
+        batches = amqp_receiver.receive()
+
+        assert amqp_client.receive_feedback_notifications.call_args == mocker.call(
+            max_batch_size=50, timeout=3
+        )
+        assert len(batches) == 2
+        assert batches[0].lock_token is messages[0]
+        assert batches[1].lock_token is messages[1]
+        assert len(batches[0]) == 2
+
+    @pytest.mark.it("Accepts completed messages, and releases abandoned messages")
+    def test_settle(self, mocker):
+        amqp_receiver = AmqpFeedbackReceiver(mocker.MagicMock())
+        message = mocker.MagicMock()
+        amqp_receiver.complete(message)
+        assert message.accept.call_count == 1
+        amqp_receiver.abandon(message)
+        assert message.release.call_count == 1
+
+    @pytest.mark.it("Disconnects its AMQP client when closed")
+    def test_close(self, mocker):
+        amqp_client = mocker.MagicMock()
+        AmqpFeedbackReceiver(amqp_client).close()
+        assert amqp_client.disconnect_sync.call_count == 1
+
+    @pytest.mark.it("Requires settlements to be made on the thread which receives")
+    def test_settle_on_receive_thread(self, mocker):
+        assert AmqpFeedbackReceiver(mocker.MagicMock()).settle_on_receive_thread is True
+
+
+@pytest.mark.describe("FeedbackConsumer - Handler")
+class TestFeedbackConsumerHandler(object):
+    @pytest.mark.it("Delivers each batch to on_feedback_received, then completes it")
+    def test_delivers_and_completes(self, receiver, consumer):
+        received = []
+        consumer.on_feedback_received = received.append
+        consumer.start()
+
+        receiver.batches = [make_batch("token1"), make_batch("token2")]
+
+        wait_for(lambda: len(receiver.completed) == 2)
+        assert [batch.lock_token for batch in received] == ["token1", "token2"]
+        assert sorted(receiver.completed) == ["token1", "token2"]
+
+    @pytest.mark.it("Abandons a batch if on_feedback_received raises")
+    def test_handler_raises(self, receiver, consumer):
+        def handler(batch):
+            raise ValueError("can't process")
+
+        consumer.on_feedback_received = handler
+        consumer.start()
+
+        receiver.batches = [make_batch("token1")]
+
+        wait_for(lambda: receiver.abandoned == ["token1"])
+        assert receiver.completed == []
+
+    @pytest.mark.it("Does not complete batches if auto_complete is False")
+    def test_no_auto_complete(self, receiver, consumer):
+        received = []
+        consumer.auto_complete = False
+        consumer.on_feedback_received = received.append
+        consumer.start()
+
+        receiver.batches = [make_batch("token1")]
+
+        wait_for(lambda: len(received) == 1)
+        assert receiver.completed == []
+        consumer.complete(received[0])
+        wait_for(lambda: receiver.completed == ["token1"])
+
+    @pytest.mark.it("Keeps polling if a receive fails")
+    def test_receive_fails(self, receiver, consumer):
+        received = []
+        consumer.on_feedback_received = received.append
+        real_receive = receiver.receive
+        failures = [ValueError("network")]
+
+        def receive():
+            if failures:
+                raise failures.pop()
+            return real_receive()
+
+        receiver.receive = receive
+        consumer.start()
+        receiver.batches = [make_batch("token1")]
+
+        wait_for(lambda: receiver.completed == ["token1"])
+        assert not failures
+
+
+@pytest.mark.describe("FeedbackConsumer - .receive() and iteration")
+class TestFeedbackConsumerReceive(object):
+    @pytest.mark.it("Returns the next batch, and completes it")
+    def test_receive(self, receiver, consumer):
+        consumer.start()
+        receiver.batches = [make_batch("token1")]
+
+        batch = consumer.receive(timeout=5)
+
+        assert batch.lock_token == "token1"
+        wait_for(lambda: receiver.completed == ["token1"])
+
+    @pytest.mark.it("Returns None if no batch is available within the timeout")
+    def test_timeout(self, consumer):
+        consumer.start()
+        assert consumer.receive(timeout=0.05) is None
+        assert consumer.receive(block=False) is None
+
+    @pytest.mark.it("Yields batches when iterated over, until stopped")
+    def test_iterate(self, receiver, consumer):
+        consumer.start()
+        receiver.batches = [make_batch("token1"), make_batch("token2")]
+
+        lock_tokens = []
+        for batch in consumer:
+            lock_tokens.append(batch.lock_token)
+            if len(lock_tokens) == 2:
+                consumer.stop()
+
+        assert lock_tokens == ["token1", "token2"]
+        assert sorted(receiver.completed) == ["token1", "token2"]
+
+
+@pytest.mark.describe("FeedbackConsumer - Settlement")
+class TestFeedbackConsumerSettlement(object):
+    @pytest.mark.it("Settles batches on several threads at once")
+    def test_parallel(self, receiver):
+        consumer = FeedbackConsumer(receiver, settle_workers=4, poll_interval=0.01)
+        in_flight = []
+        max_in_flight = []
+        lock = threading.Lock()
+
+        def slow_complete(lock_token):
+            with lock:
+                in_flight.append(lock_token)
+                max_in_flight.append(len(in_flight))
+            time.sleep(0.1)
+            with lock:
+                in_flight.remove(lock_token)
+                receiver.completed.append(lock_token)
+
+        receiver.complete = slow_complete
+        consumer.on_feedback_received = lambda batch: None
+        consumer.start()
+        receiver.batches = [make_batch("token{}".format(i)) for i in range(8)]
+
+        wait_for(lambda: len(receiver.completed) == 8)
+        consumer.stop()
+        assert max(max_in_flight) == 4
+
+    @pytest.mark.it(
+        "Makes the settlements already requested, abandons undelivered batches, and closes the receiver when stopped"
+    )
+    def test_stop(self, receiver):
+        consumer = FeedbackConsumer(receiver, prefetch_count=5, poll_interval=0.01)
+        consumer.auto_complete = False
+        consumer.start()
+        receiver.batches = [make_batch("token{}".format(i)) for i in range(3)]
+        wait_for(lambda: consumer._batches.qsize() == 3)
+
+        consumer.complete(consumer.receive())
+        consumer.stop()
+
+        assert receiver.completed == ["token0"]
+        assert sorted(receiver.abandoned) == ["token1", "token2"]
+        assert receiver.closed
+        assert consumer.stopped
+
+
+class ReceiveThreadFakeReceiver(FakeReceiver):
+    """Receiver which must be settled on the thread which receives, and records the threads used"""
+
+    settle_on_receive_thread = True
+
+    def __init__(self):
+        super(ReceiveThreadFakeReceiver, self).__init__()
+        self.threads = set()
+
+    def receive(self):
+        self.threads.add(threading.current_thread())
+        return super(ReceiveThreadFakeReceiver, self).receive()
+
+    def complete(self, lock_token):
+        self.threads.add(threading.current_thread())
+        super(ReceiveThreadFakeReceiver, self).complete(lock_token)
+
+    def abandon(self, lock_token):
+        self.threads.add(threading.current_thread())
+        super(ReceiveThreadFakeReceiver, self).abandon(lock_token)
+
+
+@pytest.mark.describe("FeedbackConsumer - Settlement on the receive thread")
+class TestFeedbackConsumerReceiveThreadSettlement(object):
+    @pytest.fixture
+    def receiver(self):
+        return ReceiveThreadFakeReceiver()
+
+    @pytest.mark.it(
+        "Settles batches on the receive thread, without settle workers, if the receiver requires it"
+    )
+    def test_receive_thread(self, receiver, consumer):
+        consumer.on_feedback_received = lambda batch: None
+        consumer.start()
+        assert len(consumer._threads) == 1
+
+        receiver.batches = [make_batch("token1"), make_batch("token2")]
+
+        wait_for(lambda: len(receiver.completed) == 2)
+        assert receiver.threads == {consumer._threads[0]}
+
+    @pytest.mark.it(
+        "Settles batches requested by the application on the receive thread while it waits to poll"
+    )
+    def test_application_settles(self, receiver):
+        consumer = FeedbackConsumer(receiver, poll_interval=60, max_poll_interval=60)
+        consumer.auto_complete = False
+        receiver.batches = [make_batch("token1")]
+        consumer.start()
+        try:
+            batch = consumer.receive(timeout=5)
+
+            consumer.complete(batch)
+
+            wait_for(lambda: receiver.completed == ["token1"])
+            assert receiver.threads == {consumer._threads[0]}
+        finally:
+            consumer.stop()
+
+    @pytest.mark.it(
+        "Makes the settlements already requested, and abandons undelivered batches, on the receive thread when stopped"
+    )
+    def test_stop(self, receiver):
+        consumer = FeedbackConsumer(receiver, prefetch_count=5, poll_interval=0.01)
+        consumer.auto_complete = False
+        consumer.start()
+        receive_thread = consumer._threads[0]
+        receiver.batches = [make_batch("token{}".format(i)) for i in range(3)]
+        wait_for(lambda: consumer._batches.qsize() == 3)
+
+        consumer.complete(consumer.receive())
+        consumer.stop()
+
+        assert receiver.completed == ["token0"]
+        assert sorted(receiver.abandoned) == ["token1", "token2"]
+        assert receiver.threads == {receive_thread}
+        assert receiver.closed
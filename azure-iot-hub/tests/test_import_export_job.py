@@ -0,0 +1,261 @@
+# --------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+
+import pytest
+import json
+import os
+from azure.iot.hub.protocol.models import ExportImportDevice, JobProperties
+from azure.iot.hub.import_export_job import (
+    LocalBlobContainer,
+    AzureBlobContainer,
+    ImportExportJobPipeline,
+    ImportExportJobError,
+    write_import_blob,
+    read_export_blob,
+    wait_for_import_export_job,
+)
+
+"""---Constants---"""
+
+fake_container_uri = "https://fakeaccount.blob.core.windows.net/fakecontainer?sv=fake"
+fake_job_id = "fake_job_id"
+fake_failure_reason = "fake_failure_reason"
+
+
+"""----Shared fixtures----"""
+
+
+def make_devices(count):
+    return (
+        ExportImportDevice(id="device{}".format(i), import_mode="create", tags={"index": i})
+        for i in range(count)
+    )
+
+
+def make_job(status, progress=0):
+    return JobProperties(
+        job_id=fake_job_id, status=status, progress=progress, failure_reason=fake_failure_reason
+    )
+
+
+@pytest.fixture
+def container(tmpdir):
+    return LocalBlobContainer(str(tmpdir), chunk_size=64)
+
+
+@pytest.fixture
+def mock_time(mocker):
+    mock_time = mocker.patch("azure.iot.hub.import_export_job.time")
+    mock_time.time.return_value = 0
+    return mock_time
+
+
+@pytest.fixture
+def job_manager(mocker):
+    job_manager = mocker.MagicMock()
+    job_manager.create_import_export_job.return_value = make_job("enqueued")
+    job_manager.get_import_export_job.return_value = make_job("completed", 100)
+    return job_manager
+
+
+@pytest.mark.describe("write_import_blob()")
+class TestWriteImportBlob(object):
+    @pytest.mark.it("Writes one serialized device per line, and returns the number written")
+    def test_writes_devices(self, container, tmpdir):
+        count = write_import_blob(container, make_devices(3), "import.txt")
+
+        assert count == 3
+        with open(os.path.join(str(tmpdir), "import.txt"), "rb") as blob_file:
+            lines = blob_file.read().splitlines()
+        assert [json.loads(line.decode("utf-8")) for line in lines] == [
+            {"id": "device{}".format(i), "importMode": "create", "tags": {"index": i}}
+            for i in range(3)
+        ]
+
+    @pytest.mark.it("Accepts devices already in serialized form")
+    def test_writes_dicts(self, container):
+        write_import_blob(container, [{"id": "device0", "importMode": "delete"}])
+        devices = list(read_export_blob(container))
+        assert devices[0].id == "device0"
+        assert devices[0].import_mode == "delete"
+
+    @pytest.mark.it("Stages a block each time the buffer reaches the block size, then commits them")
+    def test_blocks(self, mocker, container):
+        stage_block = mocker.spy(container, "stage_block")
+        commit_block_list = mocker.spy(container, "commit_block_list")
+
+        write_import_blob(container, make_devices(10), block_size=100)
+
+        block_ids = [call[0][1] for call in stage_block.call_args_list]
+        assert len(block_ids) > 1
+        assert all(len(call[0][2]) < 200 for call in stage_block.call_args_list)
+        assert commit_block_list.call_args == mocker.call("devices.txt", block_ids)
+
+    @pytest.mark.it("Consumes the device iterator lazily")
+    def test_lazy(self, mocker, container):
+        stage_block = mocker.spy(container, "stage_block")
+        staged_before = []
+
+        def devices():
+            for device in make_devices(10):
+                staged_before.append(stage_block.call_count)
+                yield device
+
+        write_import_blob(container, devices(), block_size=100)
+        assert staged_before[-1] > 0
+
+
+@pytest.mark.describe("read_export_blob()")
+class TestReadExportBlob(object):
+    @pytest.mark.it("Yields ExportImportDevices, with lines split across chunks")
+    def test_reads_devices(self, container):
+        write_import_blob(container, make_devices(20))
+
+        devices = list(read_export_blob(container))
+
+        assert all(isinstance(device, ExportImportDevice) for device in devices)
+        assert [device.id for device in devices] == ["device{}".format(i) for i in range(20)]
+        assert devices[7].tags == {"index": 7}
+
+    @pytest.mark.it(
+        "Skips a UTF-8 byte order mark, blank lines, and handles a missing final newline"
+    )
+    def test_bom(self, container, tmpdir):
+        with open(os.path.join(str(tmpdir), "devices.txt"), "wb") as blob_file:
+            blob_file.write(b'\xef\xbb\xbf{"id":"device0"}\r\n\n{"id":"device1"}')
+        container.chunk_size = 2
+
+        assert [device.id for device in read_export_blob(container)] == ["device0", "device1"]
+
+    @pytest.mark.it("Does not download chunks ahead of iteration")
+    def test_lazy(self, mocker):
+        chunks = iter([b'{"id":"device0"}\n', b'{"id":"device1"}\n'])
+        container = mocker.MagicMock()
+        container.download_chunks.return_value = chunks
+
+        devices = read_export_blob(container)
+        assert next(devices).id == "device0"
+        assert next(chunks) == b'{"id":"device1"}\n'
+
+
+@pytest.mark.describe("AzureBlobContainer")
+class TestAzureBlobContainer(object):
+    @pytest.mark.it("Stages, commits and downloads blocks with the blob clients of the container")
+    def test_container(self, mocker):
+        container_client = mocker.MagicMock()
+        blob_client = container_client.get_blob_client.return_value
+        container = AzureBlobContainer(container_client)
+
+        container.stage_block("devices.txt", "00000000", b"data")
+        container.commit_block_list("devices.txt", ["00000000"])
+        chunks = container.download_chunks("devices.txt")
+
+        assert container_client.get_blob_client.call_args == mocker.call("devices.txt")
+        assert blob_client.stage_block.call_args == mocker.call("00000000", b"data")
+        assert blob_client.commit_block_list.call_args == mocker.call(["00000000"])
+        assert chunks is blob_client.download_blob.return_value.chunks.return_value
+
+
+@pytest.mark.describe("wait_for_import_export_job()")
+class TestWaitForImportExportJob(object):
+    @pytest.mark.it("Returns the job once it has finished")
+    @pytest.mark.parametrize("status", ["completed", "failed", "cancelled"])
+    def test_finished(self, mock_time, job_manager, status):
+        job_manager.get_import_export_job.side_effect = [
+            make_job("enqueued"),
+            make_job("running"),
+            make_job(status),
+        ]
+
+        job = wait_for_import_export_job(job_manager, fake_job_id)
+
+        assert job.status == status
+        assert job_manager.get_import_export_job.call_count == 3
+
+    @pytest.mark.it("Polls the job immediately, without waiting for the poll interval first")
+    def test_polls_immediately(self, mock_time, job_manager):
+        job_manager.get_import_export_job.return_value = make_job("completed")
+
+        wait_for_import_export_job(job_manager, fake_job_id, poll_interval=5)
+
+        assert job_manager.get_import_export_job.call_count == 1
+        assert mock_time.sleep.call_count == 0
+
+    @pytest.mark.it(
+        "Doubles the poll interval up to the maximum while progress is unchanged, and resets it when progress changes"
+    )
+    def test_backoff(self, mocker, mock_time, job_manager):
+        job_manager.get_import_export_job.side_effect = [
+            make_job("running", 10),
+            make_job("running", 10),
+            make_job("running", 10),
+            make_job("running", 10),
+            make_job("running", 20),
+            make_job("completed", 100),
+        ]
+
+        wait_for_import_export_job(job_manager, fake_job_id, poll_interval=1, max_poll_interval=3)
+
+        assert mock_time.sleep.call_args_list == [
+            mocker.call(1),
+            mocker.call(2),
+            mocker.call(3),
+            mocker.call(3),
+            mocker.call(1),
+        ]
+
+    @pytest.mark.it("Raises an ImportExportJobError if the job has not finished within the timeout")
+    def test_timeout(self, mock_time, job_manager):
+        job_manager.get_import_export_job.return_value = make_job("running")
+        mock_time.time.side_effect = [0, 5, 10]
+
+        with pytest.raises(ImportExportJobError) as e_info:
+            wait_for_import_export_job(job_manager, fake_job_id, poll_interval=4, timeout=10)
+        assert e_info.value.job_properties.status == "running"
+        assert mock_time.sleep.call_count == 1
+
+
+@pytest.mark.describe("ImportExportJobPipeline")
+class TestImportExportJobPipeline(object):
+    @pytest.fixture
+    def pipeline(self, job_manager, container):
+        return ImportExportJobPipeline(job_manager, container, fake_container_uri)
+
+    @pytest.mark.it("Writes the input blob, then creates an import job on it and waits for it")
+    def test_import(self, mock_time, job_manager, container, pipeline):
+        job = pipeline.import_devices(make_devices(5), storage_authentication_type="keyBased")
+
+        assert job.status == "completed"
+        job_properties = job_manager.create_import_export_job.call_args[0][0]
+        assert job_properties.type == "import"
+        assert job_properties.input_blob_container_uri == fake_container_uri
+        assert job_properties.input_blob_name == "devices.txt"
+        assert job_properties.output_blob_container_uri == fake_container_uri
+        assert job_properties.storage_authentication_type == "keyBased"
+        assert len(list(read_export_blob(container))) == 5
+
+    @pytest.mark.it("Creates an export job, waits for it, then reads the devices from its output")
+    def test_export(self, mock_time, job_manager, container, pipeline):
+        write_import_blob(container, make_devices(5), "export.txt")
+
+        devices = pipeline.export_devices(exclude_keys=False, blob_name="export.txt")
+
+        job_properties = job_manager.create_import_export_job.call_args[0][0]
+        assert job_properties.type == "export"
+        assert job_properties.output_blob_container_uri == fake_container_uri
+        assert job_properties.output_blob_name == "export.txt"
+        assert job_properties.exclude_keys_in_export is False
+        assert [device.id for device in devices] == ["device{}".format(i) for i in range(5)]
+
+    @pytest.mark.it("Raises an ImportExportJobError if the job fails or is cancelled")
+    @pytest.mark.parametrize("status", ["failed", "cancelled"])
+    def test_failed(self, mock_time, job_manager, pipeline, status):
+        job_manager.get_import_export_job.return_value = make_job(status)
+
+        with pytest.raises(ImportExportJobError) as e_info:
+            pipeline.export_devices()
+        assert e_info.value.job_properties.status == status
+        assert fake_failure_reason in str(e_info.value)
@@ -12,6 +12,7 @@ import hashlib
 import copy
 import logging
 import uamqp
+from uamqp.authentication import JWTTokenAuth
 from azure.iot.hub.iothub_amqp_client import IoTHubAmqpClient
 
 try:
@@ -89,3 +90,121 @@ class TestIoTHubAmqpClient(object):
         iothub_amqp_client.disconnect_sync()
 
         assert amqp_client_obj.close.call_count == 1
+
+    @pytest.mark.it(
+        "Opens the send link on the hub, authenticated with a CBS token which uamqp replaces on the open connection before it expires"
+    )
+    def test_cbs_auth(self, mocker, mock_uamqp_SendClient):
+        mock_time = mocker.patch("azure.iot.hub.iothub_amqp_client.time")
+        mock_time.time.return_value = 1000
+        IoTHubAmqpClient(fake_hostname, fake_shared_access_key_name, fake_shared_access_key)
+
+        target = mock_uamqp_SendClient.call_args[0][0]
+        assert target == "amqps://" + fake_hostname + "/messages/devicebound"
+        auth = mock_uamqp_SendClient.call_args[1]["auth"]
+        assert isinstance(auth, JWTTokenAuth)
+        assert auth.expires_at == 1000 + 3600
+
+        mock_time.time.return_value = 4000
+        assert auth.get_token().expires_on == 4000 + 3600
+
+
+@pytest.fixture(scope="function")
+def mock_uamqp_ReceiveClient(mocker):
+    return mocker.patch.object(uamqp, "ReceiveClient")
+
+
+@pytest.mark.describe("IoTHubAmqpClient - Feedback")
+class TestIoTHubAmqpClientFeedback(object):
+    @pytest.mark.it(
+        "Opens a receive link on /messages/servicebound/feedback, without auto complete, on the first receive"
+    )
+    def test_opens_link(self, mocker, mock_uamqp_ReceiveClient):
+        iothub_amqp_client = IoTHubAmqpClient(
+            fake_hostname, fake_shared_access_key_name, fake_shared_access_key
+        )
+        assert mock_uamqp_ReceiveClient.call_count == 0
+
+        iothub_amqp_client.receive_feedback_notifications()
+        iothub_amqp_client.receive_feedback_notifications()
+
+        assert mock_uamqp_ReceiveClient.call_count == 1
+        source = mock_uamqp_ReceiveClient.call_args[0][0]
+        assert source.startswith("amqps://")
+        assert source.endswith("/messages/servicebound/feedback")
+        assert mock_uamqp_ReceiveClient.call_args[1]["auto_complete"] is False
+
+    @pytest.mark.it("Returns a batch of messages received on the link, with the timeout in ms")
+    def test_receive(self, mocker, mock_uamqp_ReceiveClient):
+        iothub_amqp_client = IoTHubAmqpClient(
+            fake_hostname, fake_shared_access_key_name, fake_shared_access_key
+        )
+        receive_client = mock_uamqp_ReceiveClient.return_value
+
+        messages = iothub_amqp_client.receive_feedback_notifications(max_batch_size=7, timeout=2)
+
+        assert receive_client.receive_message_batch.call_args == mocker.call(
+            max_batch_size=7, timeout=2000
+        )
+        assert messages is receive_client.receive_message_batch.return_value
+
+    @pytest.mark.it(
+        "Authenticates the feedback link with a CBS token, which uamqp replaces on the open connection before it expires"
+    )
+    def test_cbs_auth(self, mocker, mock_uamqp_ReceiveClient):
+        mock_time = mocker.patch("azure.iot.hub.iothub_amqp_client.time")
+        mock_time.time.return_value = 1000
+        iothub_amqp_client = IoTHubAmqpClient(
+            fake_hostname, fake_shared_access_key_name, fake_shared_access_key
+        )
+        iothub_amqp_client.receive_feedback_notifications()
+
+        source = mock_uamqp_ReceiveClient.call_args[0][0]
+        assert source == "amqps://" + fake_hostname + "/messages/servicebound/feedback"
+        auth = mock_uamqp_ReceiveClient.call_args[1]["auth"]
+        assert isinstance(auth, JWTTokenAuth)
+        assert auth.audience == "https://" + fake_hostname
+        assert auth.token_type == b"servicebus.windows.net:sastoken"
+        assert auth.expires_at == 1000 + 3600
+
+        # uamqp asks for a new token when the current one is about to expire
+        mock_time.time.return_value = 4000
+        new_token = auth.get_token()
+        assert new_token.expires_on == 4000 + 3600
+        assert "sr={}&".format(fake_hostname) in new_token.token
+        assert "&se={}&".format(4000 + 3600) in new_token.token
+        assert new_token.token.endswith("&skn=" + fake_shared_access_key_name)
+
+    @pytest.mark.it(
+        "Closes the feedback link and raises if a receive fails, and opens a new link on the next receive"
+    )
+    def test_receive_fails(self, mocker, mock_uamqp_ReceiveClient):
+        failed_client = mocker.MagicMock()
+        failed_client.receive_message_batch.side_effect = ValueError("link detached")
+        new_client = mocker.MagicMock()
+        mock_uamqp_ReceiveClient.side_effect = [failed_client, new_client]
+        iothub_amqp_client = IoTHubAmqpClient(
+            fake_hostname, fake_shared_access_key_name, fake_shared_access_key
+        )
+
+        with pytest.raises(ValueError):
+            iothub_amqp_client.receive_feedback_notifications()
+        assert failed_client.close.call_count == 1
+        assert iothub_amqp_client.feedback_client is None
+
+        messages = iothub_amqp_client.receive_feedback_notifications()
+        assert messages is new_client.receive_message_batch.return_value
+
+    @pytest.mark.it("Closes the feedback link on close_feedback_receiver and disconnect_sync")
+    @pytest.mark.parametrize("method_name", ["close_feedback_receiver", "disconnect_sync"])
+    def test_close(self, mocker, mock_uamqp_ReceiveClient, method_name):
+        iothub_amqp_client = IoTHubAmqpClient(
+            fake_hostname, fake_shared_access_key_name, fake_shared_access_key
+        )
+        iothub_amqp_client.receive_feedback_notifications()
+        receive_client = mock_uamqp_ReceiveClient.return_value
+
+        getattr(iothub_amqp_client, method_name)()
+
+        assert receive_client.close.call_count == 1
+        assert iothub_amqp_client.feedback_client is None
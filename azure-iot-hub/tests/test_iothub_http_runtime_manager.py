@@ -7,6 +7,11 @@
 import pytest
 from azure.iot.hub.protocol.models import AuthenticationMechanism
 from azure.iot.hub.iothub_http_runtime_manager import IoTHubHttpRuntimeManager
+from azure.iot.hub.feedback_consumer import (
+    FeedbackConsumer,
+    HttpFeedbackReceiver,
+    AmqpFeedbackReceiver,
+)
 from azure.iot.hub.auth import ConnectionStringAuthentication
 from azure.iot.hub.protocol.iot_hub_gateway_service_ap_is import IotHubGatewayServiceAPIs
 
@@ -137,3 +142,36 @@ class TestAbandonFeedbackNotification(object):
             fake_lock_token
         )
         assert ret_val == mock_http_runtime_operations.abandon_feedback_notification()
+
+
+@pytest.mark.describe("IoTHubHttpRuntimeManager - .create_feedback_consumer()")
+class TestCreateFeedbackConsumer(object):
+    @pytest.mark.it("Returns a FeedbackConsumer which receives feedback over HTTP by default")
+    def test_http(self, mock_http_runtime_operations, iothub_http_runtime_manager):
+        consumer = iothub_http_runtime_manager.create_feedback_consumer(auto_complete=False)
+        assert isinstance(consumer, FeedbackConsumer)
+        assert isinstance(consumer._receiver, HttpFeedbackReceiver)
+        assert consumer.auto_complete is False
+        assert consumer.stopped
+
+    @pytest.mark.it(
+        "Returns a FeedbackConsumer which receives feedback over AMQP if use_amqp is True"
+    )
+    def test_amqp(self, mocker, iothub_http_runtime_manager):
+        mock_amqp_client_init = mocker.patch("azure.iot.hub.service_context.iothub_amqp_client")
+        consumer = iothub_http_runtime_manager.create_feedback_consumer(use_amqp=True)
+        assert isinstance(consumer._receiver, AmqpFeedbackReceiver)
+        assert mock_amqp_client_init.call_args == mocker.call(
+            fake_hostname, fake_shared_access_key_name, fake_shared_access_key
+        )
+        # The receiver has a client of its own, rather than the shared one
+        assert consumer._receiver._amqp_client is mock_amqp_client_init.return_value
+        assert iothub_http_runtime_manager._service_context._amqp_client is None
+
+    @pytest.mark.it(
+        "Raises a ValueError if use_amqp is True and the manager was created with a token credential"
+    )
+    def test_amqp_token_credential(self, mocker):
+        manager = IoTHubHttpRuntimeManager.from_token_credential(fake_hostname, mocker.MagicMock())
+        with pytest.raises(ValueError):
+            manager.create_feedback_consumer(use_amqp=True)
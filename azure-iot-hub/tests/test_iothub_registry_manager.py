@@ -5,6 +5,7 @@
 # --------------------------------------------------------------------------
 
 import pytest
+import uamqp
 from azure.iot.hub.protocol.models import AuthenticationMechanism
 from azure.iot.hub.iothub_registry_manager import IoTHubRegistryManager
 from azure.iot.hub.iothub_amqp_client import IoTHubAmqpClient as iothub_amqp_client
@@ -1203,6 +1204,27 @@ class TestSendC2dMessage(object):
         )
 
 
+@pytest.mark.describe("IoTHubRegistryManager - .send_c2d_message() with an expired AMQP client")
+class TestSendC2dMessageAuthenticationError(object):
+    @pytest.mark.it(
+        "Discards the AMQP client and sends the message again with a new one if the SAS token is rejected"
+    )
+    def test_retries_with_new_client(self, mocker, iothub_registry_manager):
+        mock_amqp_client_init = mocker.patch("azure.iot.hub.service_context.iothub_amqp_client")
+        expired_client = mocker.MagicMock()
+        expired_client.send_message_to_device.side_effect = uamqp.errors.TokenExpired()
+        new_client = mocker.MagicMock()
+        mock_amqp_client_init.side_effect = [expired_client, new_client]
+
+        iothub_registry_manager.send_c2d_message(fake_device_id, fake_message_to_send)
+
+        assert expired_client.disconnect_sync.call_count == 1
+        assert new_client.send_message_to_device.call_count == 1
+        assert new_client.send_message_to_device.call_args == mocker.call(
+            fake_device_id, fake_message_to_send, {}
+        )
+
+
 @pytest.mark.describe("IoTHubRegistryManager - .send_c2d_message() with properties")
 class TestSendC2dMessageWithProperties(object):
     @pytest.mark.it("Test send c2d message with properties")
@@ -1218,3 +1240,27 @@ class TestSendC2dMessageWithProperties(object):
         assert mock_uamqp_send_message_to_device.call_args == mocker.call(
             fake_device_id, fake_message_to_send, fake_properties
         )
+
+
+@pytest.mark.describe("IoTHubRegistryManager - AMQP client")
+class TestAmqpClient(object):
+    @pytest.mark.it("Does not create the AMQP client until a c2d message is sent")
+    def test_lazy_amqp_client(self, mocker, mock_uamqp_send_message_to_device):
+        mock_amqp_client_init = mocker.patch("azure.iot.hub.service_context.iothub_amqp_client")
+        connection_string = (
+            "HostName={hostname};SharedAccessKeyName={skn};SharedAccessKey={sk}".format(
+                hostname=fake_hostname, skn=fake_shared_access_key_name, sk=fake_shared_access_key
+            )
+        )
+        iothub_registry_manager = IoTHubRegistryManager(connection_string)
+        assert mock_amqp_client_init.call_count == 0
+
+        iothub_registry_manager.send_c2d_message(fake_device_id, fake_message_to_send)
+
+        assert mock_amqp_client_init.call_count == 1
+
+    @pytest.mark.it("Disconnects the AMQP client it created when deleted")
+    def test_del_disconnects(self, mock_uamqp_disconnect_sync, iothub_registry_manager):
+        iothub_registry_manager.amqp_svc_client
+        iothub_registry_manager.__del__()
+        assert mock_uamqp_disconnect_sync.call_count == 1
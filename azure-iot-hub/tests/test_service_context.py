@@ -0,0 +1,208 @@
+# --------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+
+import pytest
+from azure.iot.hub.service_context import IoTHubServiceContext
+from azure.iot.hub.iothub_registry_manager import IoTHubRegistryManager
+from azure.iot.hub.iothub_job_manager import IoTHubJobManager
+from azure.iot.hub.iothub_configuration_manager import IoTHubConfigurationManager
+from azure.iot.hub.iothub_http_runtime_manager import IoTHubHttpRuntimeManager
+from azure.iot.hub.digital_twin_client import DigitalTwinClient
+from azure.iot.hub.auth import ConnectionStringAuthentication, AzureIdentityCredentialAdapter
+from azure.iot.hub.protocol.iot_hub_gateway_service_ap_is import IotHubGatewayServiceAPIs
+
+"""---Constants---"""
+
+fake_hostname = "beauxbatons.academy-net"
+fake_shared_access_key_name = "alohomora"
+fake_shared_access_key = "Zm9vYmFy"
+fake_connection_string = (
+    "HostName={hostname};SharedAccessKeyName={skn};SharedAccessKey={sk}".format(
+        hostname=fake_hostname, skn=fake_shared_access_key_name, sk=fake_shared_access_key
+    )
+)
+
+
+"""----Shared fixtures----"""
+
+
+@pytest.fixture(scope="function")
+def mock_amqp_client_init(mocker):
+    mock_amqp_client_init = mocker.patch("azure.iot.hub.service_context.iothub_amqp_client")
+    # Each client created is a new one
+    mock_amqp_client_init.side_effect = lambda *args: mocker.MagicMock()
+    return mock_amqp_client_init
+
+
+@pytest.fixture(scope="function")
+def service_context():
+    return IoTHubServiceContext.from_connection_string(fake_connection_string)
+
+
+@pytest.mark.describe("IoTHubServiceContext - Instantiation")
+class TestServiceContextInstantiation(object):
+    @pytest.mark.it("Instantiation from a connection string sets the auth and protocol attributes")
+    def test_from_connection_string(self, service_context):
+        assert isinstance(service_context.auth, ConnectionStringAuthentication)
+        assert isinstance(service_context.protocol, IotHubGatewayServiceAPIs)
+
+    @pytest.mark.it("Instantiation from a token credential sets the auth and protocol attributes")
+    def test_from_token_credential(self, mocker):
+        service_context = IoTHubServiceContext.from_token_credential(
+            fake_hostname, mocker.MagicMock()
+        )
+        assert isinstance(service_context.auth, AzureIdentityCredentialAdapter)
+        assert isinstance(service_context.protocol, IotHubGatewayServiceAPIs)
+
+    @pytest.mark.it("Keeps the HTTP connections of the protocol client open between requests")
+    def test_keep_alive(self, service_context):
+        assert service_context.protocol.config.keep_alive is True
+
+    @pytest.mark.it("Does not create an AMQP client on instantiation")
+    def test_no_amqp_client(self, mock_amqp_client_init, service_context):
+        assert mock_amqp_client_init.call_count == 0
+
+
+@pytest.mark.describe("IoTHubServiceContext - .amqp_client")
+class TestServiceContextAmqpClient(object):
+    @pytest.mark.it("Creates the AMQP client on first use, and returns the same one afterwards")
+    def test_lazy(self, mocker, mock_amqp_client_init, service_context):
+        amqp_client = service_context.amqp_client
+        assert service_context.amqp_client is amqp_client
+        assert mock_amqp_client_init.call_count == 1
+        assert mock_amqp_client_init.call_args == mocker.call(
+            fake_hostname, fake_shared_access_key_name, fake_shared_access_key
+        )
+
+    @pytest.mark.it("Keeps using the same AMQP client, however long it has been open")
+    def test_long_lived(self, mocker, mock_amqp_client_init, service_context):
+        mock_time = mocker.patch("time.time")
+        mock_time.return_value = 1000
+        amqp_client = service_context.amqp_client
+
+        mock_time.return_value = 1000 + 24 * 3600
+        assert service_context.amqp_client is amqp_client
+        assert amqp_client.disconnect_sync.call_count == 0
+        assert mock_amqp_client_init.call_count == 1
+
+    @pytest.mark.it(
+        "Disconnects the AMQP client passed to .discard_amqp_client(), and creates a new one on next use"
+    )
+    def test_discard(self, mock_amqp_client_init, service_context):
+        amqp_client = service_context.amqp_client
+        service_context.discard_amqp_client(amqp_client)
+        assert amqp_client.disconnect_sync.call_count == 1
+
+        assert service_context.amqp_client is not amqp_client
+        assert mock_amqp_client_init.call_count == 2
+
+    @pytest.mark.it("Ignores a .discard_amqp_client() for a client which has already been replaced")
+    def test_discard_replaced(self, mocker, mock_amqp_client_init, service_context):
+        old_amqp_client = mocker.MagicMock()
+        amqp_client = service_context.amqp_client
+        service_context.discard_amqp_client(old_amqp_client)
+
+        assert old_amqp_client.disconnect_sync.call_count == 0
+        assert amqp_client.disconnect_sync.call_count == 0
+        assert service_context.amqp_client is amqp_client
+
+    @pytest.mark.it(
+        ".create_amqp_client() creates a new AMQP client each time, which is not shared"
+    )
+    def test_create_amqp_client(self, mocker, mock_amqp_client_init, service_context):
+        amqp_client = service_context.create_amqp_client()
+        assert service_context.create_amqp_client() is not amqp_client
+        assert service_context.amqp_client is not amqp_client
+        assert mock_amqp_client_init.call_count == 3
+        assert mock_amqp_client_init.call_args == mocker.call(
+            fake_hostname, fake_shared_access_key_name, fake_shared_access_key
+        )
+
+    @pytest.mark.it("Is None if the context was created from a token credential")
+    def test_token_credential(self, mocker, mock_amqp_client_init):
+        service_context = IoTHubServiceContext.from_token_credential(
+            fake_hostname, mocker.MagicMock()
+        )
+        assert service_context.amqp_client is None
+        assert mock_amqp_client_init.call_count == 0
+
+    @pytest.mark.it("Is disconnected by .disconnect_amqp(), and created again on next use")
+    def test_disconnect_amqp(self, mock_amqp_client_init, service_context):
+        amqp_client = service_context.amqp_client
+        service_context.disconnect_amqp()
+        assert amqp_client.disconnect_sync.call_count == 1
+
+        service_context.amqp_client
+        assert mock_amqp_client_init.call_count == 2
+
+    @pytest.mark.it("Closes the AMQP client and the HTTP connections on .close()")
+    def test_close(self, mocker, mock_amqp_client_init, service_context):
+        mock_protocol_close = mocker.patch.object(service_context.protocol, "close")
+        amqp_client = service_context.amqp_client
+        service_context.close()
+        assert amqp_client.disconnect_sync.call_count == 1
+        assert mock_protocol_close.call_count == 1
+
+
+@pytest.mark.describe("IoTHubServiceContext - Sharing")
+class TestServiceContextSharing(object):
+    @pytest.mark.it("Service clients created from the same context share its auth and protocol")
+    def test_shared(self, service_context):
+        registry_manager = IoTHubRegistryManager.from_service_context(service_context)
+        job_manager = IoTHubJobManager.from_service_context(service_context)
+        assert registry_manager.auth is service_context.auth
+        assert job_manager.auth is service_context.auth
+        assert registry_manager.protocol is service_context.protocol
+        assert job_manager.protocol is service_context.protocol
+
+    @pytest.mark.it(
+        "Does not disconnect the shared AMQP client or HTTP connections when a service client is deleted"
+    )
+    def test_not_owned(self, mocker, mock_amqp_client_init, service_context):
+        mock_protocol_close = mocker.patch.object(service_context.protocol, "close")
+        registry_manager = IoTHubRegistryManager.from_service_context(service_context)
+        amqp_client = registry_manager.amqp_svc_client
+        registry_manager.__del__()
+        assert amqp_client.disconnect_sync.call_count == 0
+        assert mock_protocol_close.call_count == 0
+
+    @pytest.mark.it(
+        "Closes the AMQP client and HTTP connections of its own context when a service client is deleted"
+    )
+    @pytest.mark.parametrize(
+        "client_class",
+        [
+            IoTHubRegistryManager,
+            IoTHubJobManager,
+            IoTHubConfigurationManager,
+            IoTHubHttpRuntimeManager,
+            DigitalTwinClient,
+        ],
+    )
+    def test_owned(self, mocker, mock_amqp_client_init, client_class):
+        service_client = client_class.from_connection_string(fake_connection_string)
+        mock_close = mocker.patch.object(service_client._service_context, "close")
+        service_client.__del__()
+        assert mock_close.call_count == 1
+
+
+@pytest.mark.describe("ConnectionStringAuthentication - .signed_session()")
+class TestConnectionStringAuthenticationTokenCache(object):
+    @pytest.mark.it("Reuses the SasToken until it is close to expiry")
+    def test_reuses_token(self, mocker, service_context):
+        auth = service_context.auth
+        mock_time = mocker.patch("azure.iot.hub.auth.time")
+        first = auth.signed_session().headers["Authorization"]
+        sastoken = auth._sastoken
+        mock_refresh = mocker.patch.object(sastoken, "refresh")
+
+        mock_time.time.return_value = sastoken.expiry_time - 600
+        assert auth.signed_session().headers["Authorization"] == first
+        assert mock_refresh.call_count == 0
+
+        mock_time.time.return_value = sastoken.expiry_time - 60
+        auth.signed_session()
+        assert mock_refresh.call_count == 1
@@ -0,0 +1,147 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+"""Measure the rate at which a module client can deliver incoming input messages to its handler,
+with on_message_received (one invocation per message) and with on_message_batch_received.
+
+The real client and pipeline are used, with the MQTT transport replaced by a stub.  Messages are
+injected into the stub as if they had arrived from the broker, in bursts of different sizes, and
+the time taken until the handler has been invoked for all of them is measured.  No network
+connection is needed.
+"""
+
+import argparse
+import threading
+import time
+from azure.iot.device import IoTHubModuleClient
+from azure.iot.device.common.auth import sastoken as st
+from azure.iot.device.common.pipeline import pipeline_stages_mqtt
+from azure.iot.device.iothub.pipeline import IoTHubPipelineConfig, MQTTPipeline
+
+INPUT_TOPIC = "devices/bench/modules/bench/inputs/input1/%24.mid=some-message-id&prop=value"
+
+
+class StubTransport(object):
+    def __init__(self, **kwargs):
+        self.on_mqtt_connected_handler = None
+        self.on_mqtt_disconnected_handler = None
+        self.on_mqtt_connection_failure_handler = None
+        self.on_mqtt_message_received_handler = None
+
+    def connect(self, password=None):
+        self.on_mqtt_connected_handler()
+
+    def disconnect(self, clear_pending=False):
+        self.on_mqtt_disconnected_handler(None)
+
+    def shutdown(self):
+        pass
+
+    def subscribe(self, topic, qos=1, callback=None):
+        callback()
+
+    def unsubscribe(self, topic, callback=None):
+        callback()
+
+    def inject(self, count):
+        payload = b'{"temperature": 21.5}'
+        for _ in range(count):
+            self.on_mqtt_message_received_handler(INPUT_TOPIC, payload)
+
+
+class Counter(object):
+    """Counts the messages delivered to the handler, and the number of invocations"""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.condition = threading.Condition(self.lock)
+        self.messages = 0
+        self.invocations = 0
+
+    def add(self, count):
+        with self.lock:
+            self.messages += count
+            self.invocations += 1
+            self.condition.notify_all()
+
+    def wait_for(self, messages):
+        with self.lock:
+            while self.messages < messages:
+                self.condition.wait()
+
+    def reset(self):
+        with self.lock:
+            self.messages = 0
+            self.invocations = 0
+
+
+def make_client():
+    sastoken = st.NonRenewableSasToken(
+        "SharedAccessSignature sr=bench.azure-devices.net%2Fdevices%2Fbench%2Fmodules%2Fbench"
+        "&sig=c2ln&se={}".format(int(time.time()) + 3600)
+    )
+    config = IoTHubPipelineConfig(
+        hostname="bench.azure-devices.net", device_id="bench", module_id="bench", sastoken=sastoken
+    )
+    client = IoTHubModuleClient(MQTTPipeline(config), http_pipeline=None)
+    client.connect()
+    return client
+
+
+def get_transport(client):
+    stage = client._mqtt_pipeline._pipeline
+    while not isinstance(stage, pipeline_stages_mqtt.MQTTTransportStage):
+        stage = stage.next
+    return stage.transport
+
+
+def measure(transport, counter, burst, total):
+    """Inject total messages in bursts of the given size, waiting for each burst to be handled"""
+    counter.reset()
+    start = time.time()
+    for _ in range(total // burst):
+        delivered = counter.messages
+        transport.inject(burst)
+        counter.wait_for(delivered + burst)
+    elapsed = time.time() - start
+    return counter.messages / elapsed, counter.invocations
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--count", type=int, default=5000, help="messages per measurement")
+    parser.add_argument(
+        "--bursts",
+        type=int,
+        nargs="+",
+        default=[1, 10, 100, 1000],
+        help="numbers of messages arriving together",
+    )
+    args = parser.parse_args()
+
+    pipeline_stages_mqtt.MQTTTransport = StubTransport
+
+    print("{:<26} {:>8} {:>12} {:>12}".format("handler", "burst", "messages/s", "invocations"))
+    for handler_name in ["on_message_received", "on_message_batch_received"]:
+        client = make_client()
+        transport = get_transport(client)
+        counter = Counter()
+        if handler_name == "on_message_received":
+            client.on_message_received = lambda message: counter.add(1)
+        else:
+            client.on_message_batch_received = lambda messages: counter.add(len(messages))
+
+        # Warm up, so that executors and threads are already created
+        measure(transport, counter, 10, 100)
+
+        for burst in args.bursts:
+            rate, invocations = measure(transport, counter, burst, max(args.count, burst))
+            print("{:<26} {:>8} {:>12.0f} {:>12}".format(handler_name, burst, rate, invocations))
+
+        client.shutdown()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,366 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+"""A TCP proxy which injects network faults between a client and a broker.
+
+The proxy either forwards every connection to a fixed target, or, if no target is given, acts as
+an HTTP CONNECT proxy, so a device client can be pointed at it with ProxyOptions(socks.HTTP, ...)
+and keep connecting to its usual hostname and port.
+
+Faults apply to the connections that are open when they are set, and to any new ones:
+
+* latency: every chunk of data is delayed, in both directions, by a fixed delay plus a random
+  jitter. The jitter comes from a seeded random number generator, so the same seed gives the same
+  delays for the same traffic. Data is never reordered.
+* bandwidth: data is paced, in each direction, to a number of bytes per second.
+* blackhole: data stops flowing in both directions, and new connections are not answered. Data is
+  held, not dropped, and flows again when the blackhole is lifted, as it would after TCP
+  retransmissions. Either end may give up on the connection in the meantime.
+* refuse: new connections are reset as soon as they are accepted, as if the broker were down.
+* reset: all open connections are reset (RST) on both sides.
+* half-open: all open connections are closed on the broker side only. The client side stays
+  open, but nothing is ever sent to it again, so the client only finds out from its keep alive.
+"""
+
+import argparse
+import asyncio
+import logging
+import random
+import socket
+import struct
+import sys
+import threading
+import time
+
+logger = logging.getLogger(__name__)
+
+CHUNK_SIZE = 16 * 1024
+
+
+class _Pipe(object):
+    """Carries data in one direction of a proxied connection"""
+
+    def __init__(self, proxy, reader, writer):
+        self.proxy = proxy
+        self.reader = reader
+        self.writer = writer
+        self.queue = asyncio.Queue()
+        self.last_due = 0
+        self.next_free = 0
+        self.discard = False
+
+    async def read_loop(self):
+        try:
+            while True:
+                data = await self.reader.read(CHUNK_SIZE)
+                if not data:
+                    break
+                if self.discard:
+                    continue
+                due = time.monotonic() + self.proxy.latency
+                if self.proxy.jitter:
+                    due += self.proxy.rng.uniform(0, self.proxy.jitter)
+                # Never deliver data ahead of data read before it
+                self.last_due = max(due, self.last_due)
+                self.queue.put_nowait((self.last_due, data))
+        except (ConnectionError, OSError):
+            pass
+        self.queue.put_nowait((0, None))
+
+    async def write_loop(self):
+        try:
+            while True:
+                due, data = await self.queue.get()
+                if data is None:
+                    break
+                delay = due - time.monotonic()
+                if delay > 0:
+                    await asyncio.sleep(delay)
+                await self.proxy.flowing.wait()
+                if self.discard:
+                    continue
+                if self.proxy.bandwidth:
+                    now = time.monotonic()
+                    start = max(now, self.next_free)
+                    self.next_free = start + len(data) / self.proxy.bandwidth
+                    await asyncio.sleep(self.next_free - now)
+                self.writer.write(data)
+                await self.writer.drain()
+        except (ConnectionError, OSError):
+            pass
+        if not self.discard:
+            _close(self.writer)
+
+
+class _Connection(object):
+    def __init__(self, proxy, client_reader, client_writer, broker_reader, broker_writer):
+        self.client_writer = client_writer
+        self.broker_writer = broker_writer
+        self.upstream = _Pipe(proxy, client_reader, broker_writer)
+        self.downstream = _Pipe(proxy, broker_reader, client_writer)
+
+
+def _close(writer, reset=False):
+    if writer.is_closing():
+        return
+    if reset:
+        sock = writer.get_extra_info("socket")
+        if sock is not None:
+            try:
+                sock.setsockopt(socket.SOL_SOCKET, socket.SO_LINGER, struct.pack("ii", 1, 0))
+            except OSError:
+                pass
+        writer.transport.abort()
+    else:
+        writer.close()
+
+
+class FaultProxy(object):
+    """A fault-injecting TCP proxy running on its own thread.
+
+    All of the fault methods can be called from any thread.
+    """
+
+    def __init__(self, port, target=None, host="localhost", seed=0):
+        """
+        :param int port: The port to listen on.
+        :param tuple target: The (host, port) to forward connections to, or None to act as an HTTP
+            CONNECT proxy.
+        :param str host: The address to listen on.
+        :param int seed: The seed for the latency jitter.
+        """
+        self.host = host
+        self.port = port
+        self.target = target
+        self.rng = random.Random(seed)
+        self.latency = 0.0
+        self.jitter = 0.0
+        self.bandwidth = None
+        self.refusing = False
+        self.connections_accepted = 0
+        self.connections = set()
+        self.flowing = None
+        self._loop = None
+        self._server = None
+        self._thread = None
+
+    def start(self):
+        """Start the proxy, returning once it is listening"""
+        started = threading.Event()
+
+        def run():
+            self._loop = asyncio.new_event_loop()
+            asyncio.set_event_loop(self._loop)
+            self.flowing = asyncio.Event()
+            self.flowing.set()
+            self._server = self._loop.run_until_complete(
+                asyncio.start_server(self._on_accept, self.host, self.port)
+            )
+            started.set()
+            self._loop.run_forever()
+            self._loop.close()
+
+        self._thread = threading.Thread(target=run, name="fault-proxy", daemon=True)
+        self._thread.start()
+        started.wait()
+        logger.info("Fault proxy listening on %s:%s", self.host, self.port)
+
+    def stop(self):
+        """Close all connections and stop the proxy"""
+
+        def close_all():
+            self._server.close()
+            for connection in list(self.connections):
+                _close(connection.client_writer)
+                _close(connection.broker_writer)
+            self.flowing.set()
+            self._loop.call_later(0.1, self._loop.stop)
+
+        self._loop.call_soon_threadsafe(close_all)
+        self._thread.join()
+
+    def set_latency(self, latency, jitter=0.0):
+        """Delay data in both directions by latency seconds, plus up to jitter seconds"""
+        self.latency = latency
+        self.jitter = jitter
+        logger.info("Latency set to %ss (+ up to %ss)", latency, jitter)
+
+    def set_bandwidth(self, bytes_per_second):
+        """Cap the data rate in each direction, or lift the cap if bytes_per_second is None"""
+        self.bandwidth = bytes_per_second
+        logger.info("Bandwidth set to %s bytes/s", bytes_per_second)
+
+    def blackhole(self, enabled=True):
+        """Stop (or restart) the flow of data, and the answering of new connections"""
+        self._loop.call_soon_threadsafe(self.flowing.clear if enabled else self.flowing.set)
+        logger.info("Blackhole %s", "on" if enabled else "off")
+
+    def refuse(self, enabled=True):
+        """Reset (or stop resetting) new connections as soon as they are accepted"""
+        self.refusing = enabled
+        logger.info("Refusing new connections %s", "on" if enabled else "off")
+
+    def reset(self):
+        """Reset all open connections"""
+
+        def reset_all():
+            logger.info("Resetting %s connection(s)", len(self.connections))
+            for connection in list(self.connections):
+                _close(connection.client_writer, reset=True)
+                _close(connection.broker_writer, reset=True)
+
+        self._loop.call_soon_threadsafe(reset_all)
+
+    def half_open(self):
+        """Close all open connections on the broker side, leaving the client side open"""
+
+        def half_close_all():
+            logger.info("Half-opening %s connection(s)", len(self.connections))
+            for connection in list(self.connections):
+                connection.upstream.discard = True
+                connection.downstream.discard = True
+                _close(connection.broker_writer)
+
+        self._loop.call_soon_threadsafe(half_close_all)
+
+    def clear(self):
+        """Lift all faults"""
+        self.set_latency(0.0)
+        self.set_bandwidth(None)
+        self.refuse(False)
+        self.blackhole(False)
+
+    async def _open_target(self, client_reader, client_writer):
+        if self.target:
+            return await asyncio.open_connection(*self.target)
+        # HTTP CONNECT
+        request = await client_reader.readuntil(b"\r\n\r\n")
+        method, authority = request.split(b"\r\n", 1)[0].split()[:2]
+        if method.upper() != b"CONNECT":
+            client_writer.write(b"HTTP/1.1 405 Method Not Allowed\r\n\r\n")
+            raise ConnectionError("Unsupported proxy request")
+        host, port = authority.decode("ascii").rsplit(":", 1)
+        try:
+            broker = await asyncio.open_connection(host, int(port))
+        except OSError:
+            client_writer.write(b"HTTP/1.1 502 Bad Gateway\r\n\r\n")
+            raise
+        client_writer.write(b"HTTP/1.1 200 Connection established\r\n\r\n")
+        return broker
+
+    async def _on_accept(self, client_reader, client_writer):
+        self.connections_accepted += 1
+        if self.refusing:
+            _close(client_writer, reset=True)
+            return
+        # A blackhole also swallows new connections, until it is lifted
+        await self.flowing.wait()
+        try:
+            broker_reader, broker_writer = await self._open_target(client_reader, client_writer)
+        except (asyncio.IncompleteReadError, ValueError, ConnectionError, OSError) as e:
+            logger.info("Could not open proxied connection: %s", e)
+            _close(client_writer)
+            return
+        connection = _Connection(self, client_reader, client_writer, broker_reader, broker_writer)
+        self.connections.add(connection)
+        try:
+            await asyncio.gather(
+                connection.upstream.read_loop(),
+                connection.upstream.write_loop(),
+                connection.downstream.read_loop(),
+                connection.downstream.write_loop(),
+            )
+        finally:
+            self.connections.discard(connection)
+            _close(client_writer)
+            _close(broker_writer)
+
+
+COMMANDS = """Commands:
+  latency SECONDS [JITTER]   delay data in both directions
+  bandwidth BYTES_PER_SEC    cap the data rate in each direction ("off" to lift)
+  blackhole [SECONDS]        stop all data flowing (for SECONDS, or until "clear")
+  refuse [SECONDS]           reset new connections (for SECONDS, or until "clear")
+  reset                      reset all open connections
+  halfopen                   close all open connections on the broker side only
+  clear                      lift all faults
+  status                     show the open connections and faults
+  quit"""
+
+
+def _run_command(proxy, words):
+    command, args = words[0], words[1:]
+    if command == "latency":
+        proxy.set_latency(float(args[0]), float(args[1]) if len(args) > 1 else 0.0)
+    elif command == "bandwidth":
+        proxy.set_bandwidth(None if args[0] == "off" else float(args[0]))
+    elif command in ("blackhole", "refuse"):
+        fault = proxy.blackhole if command == "blackhole" else proxy.refuse
+        fault(True)
+        if args:
+            timer = threading.Timer(float(args[0]), fault, args=(False,))
+            timer.daemon = True
+            timer.start()
+    elif command == "reset":
+        proxy.reset()
+    elif command == "halfopen":
+        proxy.half_open()
+    elif command == "clear":
+        proxy.clear()
+    elif command == "status":
+        print(
+            "{} open connection(s), {} accepted. latency={}+{} bandwidth={} "
+            "blackhole={} refusing={}".format(
+                len(proxy.connections),
+                proxy.connections_accepted,
+                proxy.latency,
+                proxy.jitter,
+                proxy.bandwidth,
+                not proxy.flowing.is_set(),
+                proxy.refusing,
+            )
+        )
+    else:
+        print(COMMANDS)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--port", type=int, default=8884, help="port to listen on")
+    parser.add_argument(
+        "--target", help="HOST:PORT to forward connections to (default: act as a CONNECT proxy)"
+    )
+    parser.add_argument("--latency", type=float, default=0.0, help="delay in seconds")
+    parser.add_argument("--jitter", type=float, default=0.0, help="maximum extra delay")
+    parser.add_argument("--bandwidth", type=float, help="bytes per second in each direction")
+    parser.add_argument("--seed", type=int, default=0, help="seed for the jitter")
+    args = parser.parse_args()
+
+    logging.basicConfig(level=logging.INFO, format="%(asctime)s %(message)s")
+    target = None
+    if args.target:
+        host, port = args.target.rsplit(":", 1)
+        target = (host, int(port))
+    proxy = FaultProxy(args.port, target=target, seed=args.seed)
+    proxy.start()
+    proxy.set_latency(args.latency, args.jitter)
+    proxy.set_bandwidth(args.bandwidth)
+    print(COMMANDS)
+
+    for line in sys.stdin:
+        words = line.split()
+        if not words:
+            continue
+        if words[0] == "quit":
+            break
+        try:
+            _run_command(proxy, words)
+        except (IndexError, ValueError):
+            print(COMMANDS)
+    proxy.stop()
+
+
+if __name__ == "__main__":
+    main()
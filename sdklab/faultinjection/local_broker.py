@@ -0,0 +1,289 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+"""A minimal MQTT 3.1.1 broker over TLS, for running the fault injection scenarios locally.
+
+It accepts any credentials, and only does what the scenarios need:
+
+* QoS 0 and 1 publishes are acknowledged and passed on to matching subscribers, at up to QoS 1.
+  Messages are not retained, not queued for offline sessions, and not retransmitted.
+* Subscriptions (QoS 2 is granted as QoS 1) are kept across connections for clients that connect
+  with clean_session=False, and the CONNACK reports the session as present.
+* Clients that go quiet for 1.5 times their keep alive are disconnected.
+"""
+
+import argparse
+import asyncio
+import logging
+import os
+import ssl
+import struct
+import subprocess
+import threading
+import time
+
+logger = logging.getLogger(__name__)
+
+CONNECT = 1
+CONNACK = 2
+PUBLISH = 3
+PUBACK = 4
+SUBSCRIBE = 8
+SUBACK = 9
+UNSUBSCRIBE = 10
+UNSUBACK = 11
+PINGREQ = 12
+PINGRESP = 13
+DISCONNECT = 14
+
+
+def create_self_signed_cert(directory, common_name="localhost"):
+    """Create a self signed certificate and key for common_name with the openssl command.
+
+    :returns: The paths of the certificate and the key.
+    """
+    cert_path = os.path.join(directory, "self_cert_{}.pem".format(common_name))
+    key_path = os.path.join(directory, "self_key_{}.pem".format(common_name))
+    if not (os.path.exists(cert_path) and os.path.exists(key_path)):
+        subprocess.check_call(
+            [
+                "openssl",
+                "req",
+                "-x509",
+                "-newkey",
+                "rsa:2048",
+                "-nodes",
+                "-days",
+                "30",
+                "-subj",
+                "/CN={}".format(common_name),
+                "-addext",
+                "subjectAltName=DNS:{}".format(common_name),
+                "-keyout",
+                key_path,
+                "-out",
+                cert_path,
+            ],
+            stdout=subprocess.DEVNULL,
+            stderr=subprocess.DEVNULL,
+        )
+    return cert_path, key_path
+
+
+def topic_matches(topic_filter, topic):
+    filter_levels = topic_filter.split("/")
+    topic_levels = topic.split("/")
+    for i, level in enumerate(filter_levels):
+        if level == "#":
+            return True
+        if i >= len(topic_levels) or (level != "+" and level != topic_levels[i]):
+            return False
+    return len(filter_levels) == len(topic_levels)
+
+
+def _encode_string(value):
+    data = value.encode("utf-8")
+    return struct.pack("!H", len(data)) + data
+
+
+def _decode_string(data, offset):
+    (length,) = struct.unpack_from("!H", data, offset)
+    offset += 2
+    return data[offset : offset + length].decode("utf-8"), offset + length
+
+
+def _packet(packet_type, body, flags=0):
+    header = bytearray([(packet_type << 4) | flags])
+    length = len(body)
+    while True:
+        byte = length % 128
+        length //= 128
+        header.append(byte | 0x80 if length else byte)
+        if not length:
+            return bytes(header) + body
+
+
+class _Session(object):
+    def __init__(self, client_id):
+        self.client_id = client_id
+        self.subscriptions = {}
+        self.writer = None
+        self.next_packet_id = 0
+
+    def packet_id(self):
+        self.next_packet_id = self.next_packet_id % 65535 + 1
+        return self.next_packet_id
+
+
+class LocalBroker(object):
+    """A minimal MQTT broker running on its own thread"""
+
+    def __init__(self, certfile, keyfile, port=8883, host="localhost"):
+        self.host = host
+        self.port = port
+        self.ssl_context = ssl.create_default_context(ssl.Purpose.CLIENT_AUTH)
+        self.ssl_context.load_cert_chain(certfile, keyfile)
+        self.sessions = {}
+        self.connection_count = 0
+        self._loop = None
+        self._server = None
+        self._thread = None
+
+    def start(self):
+        """Start the broker, returning once it is listening"""
+        started = threading.Event()
+
+        def run():
+            self._loop = asyncio.new_event_loop()
+            asyncio.set_event_loop(self._loop)
+            self._server = self._loop.run_until_complete(
+                asyncio.start_server(self._on_accept, self.host, self.port, ssl=self.ssl_context)
+            )
+            started.set()
+            self._loop.run_forever()
+            self._loop.close()
+
+        self._thread = threading.Thread(target=run, name="local-broker", daemon=True)
+        self._thread.start()
+        started.wait()
+        logger.info("Broker listening on %s:%s", self.host, self.port)
+
+    def stop(self):
+        """Disconnect all clients and stop the broker"""
+
+        def close_all():
+            self._server.close()
+            for session in self.sessions.values():
+                if session.writer:
+                    session.writer.close()
+            self._loop.call_later(0.1, self._loop.stop)
+
+        self._loop.call_soon_threadsafe(close_all)
+        self._thread.join()
+
+    async def _read_packet(self, reader):
+        first = await reader.readexactly(1)
+        length = 0
+        multiplier = 1
+        while True:
+            (byte,) = await reader.readexactly(1)
+            length += (byte & 0x7F) * multiplier
+            multiplier *= 128
+            if not byte & 0x80:
+                break
+        body = await reader.readexactly(length) if length else b""
+        return first[0] >> 4, first[0] & 0x0F, body
+
+    async def _on_accept(self, reader, writer):
+        session = None
+        try:
+            packet_type, _, body = await asyncio.wait_for(self._read_packet(reader), 10)
+            if packet_type != CONNECT:
+                return
+            session, keep_alive = self._on_connect(body, writer)
+            self.connection_count += 1
+            timeout = keep_alive * 1.5 if keep_alive else None
+            while True:
+                packet_type, flags, body = await asyncio.wait_for(
+                    self._read_packet(reader), timeout
+                )
+                if packet_type == DISCONNECT:
+                    break
+                self._on_packet(session, packet_type, flags, body, writer)
+        except (asyncio.IncompleteReadError, asyncio.TimeoutError, ConnectionError, OSError):
+            pass
+        except (ValueError, struct.error, UnicodeDecodeError) as e:
+            logger.warning("Disconnecting client after malformed packet: %s", e)
+        finally:
+            if session and session.writer is writer:
+                session.writer = None
+            writer.close()
+
+    def _on_connect(self, body, writer):
+        _, offset = _decode_string(body, 0)  # protocol name
+        level, flags, keep_alive = struct.unpack_from("!BBH", body, offset)
+        client_id, offset = _decode_string(body, offset + 4)
+        clean_session = bool(flags & 0x02)
+
+        session = self.sessions.get(client_id)
+        session_present = session is not None and not clean_session
+        if session is not None and session.writer:
+            # A new connection for a client takes over from the old one
+            session.writer.close()
+        if not session_present:
+            session = _Session(client_id)
+            self.sessions[client_id] = session
+        session.writer = writer
+        writer.write(_packet(CONNACK, bytes([1 if session_present else 0, 0])))
+        logger.debug("%s connected (session present=%s)", client_id, session_present)
+        return session, keep_alive
+
+    def _on_packet(self, session, packet_type, flags, body, writer):
+        if packet_type == PUBLISH:
+            qos = (flags >> 1) & 0x03
+            topic, offset = _decode_string(body, 0)
+            if qos:
+                packet_id = body[offset : offset + 2]
+                offset += 2
+                writer.write(_packet(PUBACK, packet_id))
+            self._route(topic, body[offset:], qos)
+        elif packet_type == SUBSCRIBE:
+            packet_id = body[:2]
+            offset = 2
+            granted = bytearray()
+            while offset < len(body):
+                topic_filter, offset = _decode_string(body, offset)
+                qos = min(body[offset], 1)
+                offset += 1
+                session.subscriptions[topic_filter] = qos
+                granted.append(qos)
+            writer.write(_packet(SUBACK, packet_id + bytes(granted)))
+        elif packet_type == UNSUBSCRIBE:
+            packet_id = body[:2]
+            offset = 2
+            while offset < len(body):
+                topic_filter, offset = _decode_string(body, offset)
+                session.subscriptions.pop(topic_filter, None)
+            writer.write(_packet(UNSUBACK, packet_id))
+        elif packet_type == PINGREQ:
+            writer.write(_packet(PINGRESP, b""))
+        # PUBACKs from subscribers need nothing, as messages are never retransmitted
+
+    def _route(self, topic, payload, qos):
+        for session in self.sessions.values():
+            if not session.writer:
+                continue
+            matches = [q for f, q in session.subscriptions.items() if topic_matches(f, topic)]
+            if not matches:
+                continue
+            out_qos = min(qos, max(matches))
+            body = _encode_string(topic)
+            if out_qos:
+                body += struct.pack("!H", session.packet_id())
+            session.writer.write(_packet(PUBLISH, body + payload, flags=out_qos << 1))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--port", type=int, default=8883)
+    parser.add_argument(
+        "--cert-dir", default=".", help="directory for the self signed certificate and key"
+    )
+    args = parser.parse_args()
+
+    logging.basicConfig(level=logging.INFO, format="%(asctime)s %(message)s")
+    certfile, keyfile = create_self_signed_cert(args.cert_dir)
+    print("Server verification certificate: {}".format(certfile))
+    broker = LocalBroker(certfile, keyfile, port=args.port)
+    broker.start()
+    try:
+        while True:
+            time.sleep(1)
+    except KeyboardInterrupt:
+        broker.stop()
+
+
+if __name__ == "__main__":
+    main()
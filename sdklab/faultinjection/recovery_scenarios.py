@@ -0,0 +1,393 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+"""Measure how a device client recovers from network faults.
+
+A device client connects to a broker through the fault proxy, and sends a numbered message every
+--interval seconds, while a recorder, connected straight to the broker, notes which messages
+arrive. Each scenario injects a fault part way through, and reports:
+
+* how long the client took to notice the connection was gone, and to reconnect
+* the time to recover: from the end of the fault until a send next completes
+* how long it took for all of the messages sent before the end of the fault to complete
+* the messages that were lost (acknowledged but never arrived), failed, or arrived more than once
+
+The reconnect delay (ReconnectStage), retry interval (RetryStage) and subscribe timeout
+(OpTimeoutStage) can be set from the command line, to compare recovery with different values.
+"""
+
+import argparse
+import asyncio
+import collections
+import json
+import logging
+import random
+import ssl
+import tempfile
+import threading
+import time
+import paho.mqtt.client as mqtt
+import socks
+from azure.iot.device import Message, ProxyOptions, exceptions
+from azure.iot.device.aio import IoTHubDeviceClient
+from azure.iot.device.common.pipeline import pipeline_ops_mqtt, pipeline_stages_base
+from azure.iot.device.iothub.pipeline import constant
+from fault_proxy import FaultProxy
+from local_broker import LocalBroker, create_self_signed_cert
+
+CONNECTION_STRING = "HostName={};DeviceId={};SharedAccessKey=Zm9vYmFy"
+
+
+class Recorder(object):
+    """Subscribes to a device's telemetry straight from the broker, and notes each arrival"""
+
+    def __init__(self, broker, ca_cert, device_id):
+        self.arrivals = collections.defaultdict(list)
+        self._lock = threading.Lock()
+        self._subscribed = threading.Event()
+        self._client = mqtt.Client(
+            client_id="faultlab-recorder-" + device_id, clean_session=True, protocol=mqtt.MQTTv311
+        )
+        self._client.tls_set_context(ssl.create_default_context(cafile=ca_cert))
+        self._client.on_message = self._on_message
+        self._client.on_subscribe = lambda *args: self._subscribed.set()
+        self._client.connect(broker[0], broker[1])
+        self._client.subscribe("devices/{}/messages/events/#".format(device_id), qos=1)
+        self._client.loop_start()
+        if not self._subscribed.wait(10):
+            raise RuntimeError("Recorder could not subscribe to the broker")
+
+    def _on_message(self, client, userdata, msg):
+        try:
+            seq = json.loads(msg.payload.decode("utf-8"))["seq"]
+        except (ValueError, KeyError):
+            return
+        with self._lock:
+            self.arrivals[seq].append(time.monotonic())
+
+    def stop(self):
+        self._client.disconnect()
+        self._client.loop_stop()
+
+
+class ScenarioRun(object):
+    """One device client, sending messages through the proxy while a scenario plays out"""
+
+    def __init__(self, name, args, proxy, broker, ca_cert):
+        self.name = name
+        self.args = args
+        self.proxy = proxy
+        self.device_id = "faultlab-" + name
+        self.recorder = Recorder(broker, ca_cert, self.device_id)
+        self.client = IoTHubDeviceClient.create_from_connection_string(
+            CONNECTION_STRING.format(broker[0], self.device_id),
+            keep_alive=args.keep_alive,
+            server_verification_cert=open(ca_cert).read(),
+            proxy_options=ProxyOptions(socks.HTTP, "localhost", args.proxy_port),
+        )
+        tune_pipeline(self.client, args)
+        self.rng = random.Random(args.seed)
+        self.sends = {}
+        self.connection_changes = []
+        self.subscribed_at = None
+        self.fault_start = None
+        self.fault_end = None
+        self._watch_connection()
+
+    def start_fault(self):
+        self.fault_start = time.monotonic()
+
+    def end_fault(self):
+        self.fault_end = time.monotonic()
+
+    async def run(self, scenario):
+        await self.client.connect()
+        stopping = asyncio.Event()
+        sender = asyncio.ensure_future(self._send_loop(stopping))
+        await asyncio.sleep(self.args.warmup)
+
+        await scenario(self)
+        if self.fault_end is None:
+            self.end_fault()
+        await asyncio.sleep(self.args.settle)
+        stopping.set()
+        await sender
+
+        self.proxy.clear()
+        pending = [send for send in self.sends.values() if not send.done()]
+        if pending:
+            await asyncio.wait(pending, timeout=self.args.drain_timeout)
+        # Give the recorder time to see the last messages
+        await asyncio.sleep(1)
+        self.recorder.stop()
+        self.report()
+        try:
+            await self.client.disconnect()
+        except exceptions.NoConnectionError:
+            # The connection was dropped again just before the disconnect
+            pass
+        await self.client.shutdown()
+
+    async def enable_c2d(self):
+        """Subscribe to C2D messages, noting when the subscribe completes"""
+        await self.client._enable_feature(constant.C2D_MSG)
+        self.subscribed_at = time.monotonic()
+
+    async def _send_loop(self, stopping):
+        seq = 0
+        while not stopping.is_set():
+            self.sends[seq] = asyncio.ensure_future(self._send(seq))
+            seq += 1
+            try:
+                await asyncio.wait_for(stopping.wait(), self.args.interval)
+            except asyncio.TimeoutError:
+                pass
+
+    async def _send(self, seq):
+        sent_at = time.monotonic()
+        await self.client.send_message(Message(json.dumps({"seq": seq})))
+        return sent_at, time.monotonic()
+
+    def _watch_connection(self):
+        pipeline = self.client._mqtt_pipeline
+
+        def watch(handler, connected):
+            def on_change():
+                self.connection_changes.append((time.monotonic(), connected))
+                handler()
+
+            return on_change
+
+        pipeline.on_connected = watch(pipeline.on_connected, True)
+        pipeline.on_disconnected = watch(pipeline.on_disconnected, False)
+
+    def report(self):
+        start, end = self.fault_start, self.fault_end
+        done = {}
+        failed = collections.Counter()
+        outstanding = 0
+        for seq, send in self.sends.items():
+            if not send.done():
+                send.cancel()
+                outstanding += 1
+            elif send.exception():
+                failed[type(send.exception()).__name__] += 1
+            else:
+                done[seq] = send.result()
+
+        disconnected_at = next(
+            (t for t, connected in self.connection_changes if t >= start and not connected), None
+        )
+        reconnected_at = None
+        if disconnected_at is not None:
+            reconnected_at = next(
+                (t for t, c in self.connection_changes if t >= disconnected_at and c), None
+            )
+        recovered_at = min((d for s, d in done.values() if d >= end), default=None)
+        before_end = [d for s, d in done.values() if s < end]
+        arrivals = self.recorder.arrivals
+        lost = [seq for seq in done if seq not in arrivals]
+        duplicated = {seq: len(times) for seq, times in arrivals.items() if len(times) > 1}
+        unacknowledged = [seq for seq in arrivals if seq not in done]
+
+        def since(t, origin):
+            return "{:.2f}s".format(t - origin) if t is not None else "-"
+
+        print("")
+        print("Scenario {}: fault lasted {:.2f}s".format(self.name, end - start))
+        print("  disconnect noticed after fault start  {}".format(since(disconnected_at, start)))
+        print("  reconnected after fault end           {}".format(since(reconnected_at, end)))
+        print("  time to recover (next completed send) {}".format(since(recovered_at, end)))
+        if before_end:
+            print("  messages sent before fault end done   {}".format(since(max(before_end), end)))
+        if self.subscribed_at is not None:
+            print(
+                "  C2D subscribe completed after end     {}".format(since(self.subscribed_at, end))
+            )
+        if done:
+            latencies = sorted(d - s for s, d in done.values())
+            print(
+                "  send latency median/max               {:.3f}s / {:.3f}s".format(
+                    latencies[len(latencies) // 2], latencies[-1]
+                )
+            )
+        print(
+            "  messages: {} sent, {} acknowledged, {} failed {}, {} still outstanding".format(
+                len(self.sends), len(done), sum(failed.values()), dict(failed), outstanding
+            )
+        )
+        print(
+            "  lost: {} {}, duplicated: {} {}, arrived unacknowledged: {}".format(
+                len(lost), lost[:10], len(duplicated), duplicated, len(unacknowledged)
+            )
+        )
+        print("  proxy connections accepted so far: {}".format(self.proxy.connections_accepted))
+
+
+def tune_pipeline(client, args):
+    """Override the hardcoded recovery settings of the client's pipeline stages"""
+    stage = client._mqtt_pipeline._pipeline
+    while stage:
+        if isinstance(stage, pipeline_stages_base.ReconnectStage):
+            if args.reconnect_delay is not None:
+                stage.reconnect_delay = args.reconnect_delay
+        elif isinstance(stage, pipeline_stages_base.RetryStage):
+            if args.retry_interval is not None:
+                for op_type in stage.retry_intervals:
+                    stage.retry_intervals[op_type] = args.retry_interval
+        elif isinstance(stage, pipeline_stages_base.OpTimeoutStage):
+            if args.op_timeout is not None:
+                stage.timeout_intervals[pipeline_ops_mqtt.MQTTSubscribeOperation] = args.op_timeout
+                stage.timeout_intervals[pipeline_ops_mqtt.MQTTUnsubscribeOperation] = (
+                    args.op_timeout
+                )
+        stage = stage.next
+
+
+async def reset(run):
+    """The connection is reset. ReconnectStage should reconnect straight away."""
+    run.start_fault()
+    run.proxy.reset()
+    run.end_fault()
+
+
+async def outage(run):
+    """The connection is reset, and new connections are refused for --duration seconds, as when
+    the broker restarts. ReconnectStage retries every reconnect delay."""
+    run.start_fault()
+    run.proxy.refuse(True)
+    run.proxy.reset()
+    await asyncio.sleep(run.args.duration)
+    run.proxy.refuse(False)
+    run.end_fault()
+
+
+async def blackhole(run):
+    """No data flows for --duration seconds. Keep alive should notice the connection is dead if
+    the blackhole lasts long enough, and messages in flight may be sent twice."""
+    run.start_fault()
+    run.proxy.blackhole(True)
+    await asyncio.sleep(run.args.duration)
+    run.proxy.blackhole(False)
+    run.end_fault()
+
+
+async def half_open(run):
+    """The broker side of the connection goes away without the client being told, as when a NAT
+    mapping expires. Only keep alive can notice."""
+    run.start_fault()
+    run.proxy.half_open()
+    run.end_fault()
+
+
+async def subscribe_timeout(run):
+    """A subscribe is made during a --duration second blackhole. OpTimeoutStage fails it once the
+    subscribe timeout passes, and RetryStage sends it again after the retry interval."""
+    run.start_fault()
+    run.proxy.blackhole(True)
+    subscribe = asyncio.ensure_future(run.enable_c2d())
+    await asyncio.sleep(run.args.duration)
+    run.proxy.blackhole(False)
+    run.end_fault()
+    await subscribe
+
+
+async def cellular(run):
+    """--duration seconds of a slow, jittery link with a seeded sequence of short blackholes,
+    resets and half-open connections."""
+    run.start_fault()
+    run.proxy.set_latency(0.3, 0.4)
+    run.proxy.set_bandwidth(4000)
+    deadline = time.monotonic() + run.args.duration
+    while True:
+        await asyncio.sleep(run.rng.uniform(3, 10))
+        if time.monotonic() >= deadline:
+            break
+        fault = run.rng.choice(["blackhole", "blackhole", "reset", "half-open"])
+        if fault == "blackhole":
+            duration = run.rng.uniform(1, 8)
+            logging.info("cellular: blackhole for %.1fs", duration)
+            run.proxy.blackhole(True)
+            await asyncio.sleep(duration)
+            run.proxy.blackhole(False)
+        elif fault == "reset":
+            logging.info("cellular: reset")
+            run.proxy.reset()
+        else:
+            logging.info("cellular: half-open")
+            run.proxy.half_open()
+    run.proxy.set_latency(0.0)
+    run.proxy.set_bandwidth(None)
+    run.end_fault()
+
+
+SCENARIOS = collections.OrderedDict(
+    [
+        ("reset", reset),
+        ("outage", outage),
+        ("blackhole", blackhole),
+        ("half-open", half_open),
+        ("subscribe-timeout", subscribe_timeout),
+        ("cellular", cellular),
+    ]
+)
+
+
+async def main(args):
+    if args.broker:
+        host, port = args.broker.rsplit(":", 1)
+        broker_address = (host, int(port))
+        ca_cert = args.ca_cert
+        broker = None
+    else:
+        broker_address = ("localhost", 8883)
+        ca_cert, keyfile = create_self_signed_cert(args.cert_dir or tempfile.mkdtemp())
+        broker = LocalBroker(ca_cert, keyfile)
+        broker.start()
+    proxy = FaultProxy(args.proxy_port, seed=args.seed)
+    proxy.start()
+
+    names = list(SCENARIOS) if args.scenario == "all" else [args.scenario]
+    try:
+        for name in names:
+            print("\nRunning {}: {}".format(name, " ".join(SCENARIOS[name].__doc__.split())))
+            await ScenarioRun(name, args, proxy, broker_address, ca_cert).run(SCENARIOS[name])
+    finally:
+        proxy.stop()
+        if broker:
+            broker.stop()
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--scenario", choices=["all"] + list(SCENARIOS), default="all")
+    parser.add_argument("--duration", type=float, default=20, help="fault duration in seconds")
+    parser.add_argument("--keep-alive", type=int, default=10, help="client keep alive in seconds")
+    parser.add_argument("--interval", type=float, default=0.5, help="seconds between messages")
+    parser.add_argument("--warmup", type=float, default=3, help="seconds before the fault")
+    parser.add_argument("--settle", type=float, default=15, help="seconds to send after the fault")
+    parser.add_argument(
+        "--drain-timeout", type=float, default=60, help="seconds to wait for outstanding sends"
+    )
+    parser.add_argument("--reconnect-delay", type=float, help="ReconnectStage reconnect delay")
+    parser.add_argument("--retry-interval", type=float, help="RetryStage retry interval")
+    parser.add_argument("--op-timeout", type=float, help="OpTimeoutStage subscribe timeout")
+    parser.add_argument("--seed", type=int, default=0, help="seed for jitter and fault sequences")
+    parser.add_argument("--proxy-port", type=int, default=8884)
+    parser.add_argument(
+        "--broker", help="HOST:PORT of a broker to use, instead of starting one on port 8883"
+    )
+    parser.add_argument("--ca-cert", help="server verification certificate for --broker")
+    parser.add_argument("--cert-dir", help="where to create the local broker's certificate")
+    parser.add_argument("--verbose", action="store_true")
+    args = parser.parse_args()
+    if args.broker and not args.ca_cert:
+        parser.error("--broker needs --ca-cert")
+
+    logging.basicConfig(
+        level=logging.INFO if args.verbose else logging.WARNING,
+        format="%(asctime)s %(name)s %(message)s",
+    )
+    asyncio.run(main(args))
@@ -0,0 +1,89 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+"""Profile the per-message logging cost of the MQTT transport at different log levels.
+
+Each iteration does what the transport does for one QoS 1 telemetry message: publish, then
+receive the PUBACK and complete the operation. Paho is replaced with a stub so that only SDK
+code is measured.
+"""
+import argparse
+import cProfile
+import logging
+import pstats
+import time
+from azure.iot.device.common import mqtt_transport, trace_buffer
+
+
+class StubPahoClient(object):
+    def __init__(self):
+        self.mid = 0
+
+    def publish(self, topic, payload, qos):
+        self.mid += 1
+        return (0, self.mid)
+
+
+class DiscardHandler(logging.Handler):
+    def emit(self, record):
+        # Format the record like a real handler would, but don't write it anywhere
+        self.format(record)
+
+
+def make_transport():
+    transport = mqtt_transport.MQTTTransport.__new__(mqtt_transport.MQTTTransport)
+    transport._mqtt_client = StubPahoClient()
+    transport._op_manager = mqtt_transport.OperationManager()
+    return transport
+
+
+def run(transport, count):
+    op_manager = transport._op_manager
+    for _ in range(count):
+        transport.publish(topic="devices/bench/messages/events/", payload="x" * 64)
+        op_manager.complete_operation(transport._mqtt_client.mid)
+
+
+def count_format_calls(stats):
+    calls = 0
+    for (filename, _, name), (_, ncalls, _, _, _) in stats.stats.items():
+        if name in ("<method 'format' of 'str' objects>", "getMessage"):
+            calls += ncalls
+    return calls
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--count", type=int, default=100000, help="messages per log level")
+    parser.add_argument("--trace", action="store_true", help="also record the binary trace")
+    args = parser.parse_args()
+
+    root = logging.getLogger()
+    root.addHandler(DiscardHandler())
+    if args.trace:
+        trace_buffer.enable()
+
+    print("{:>8} {:>12} {:>18}".format("level", "us/message", "formats/message"))
+    for level in (logging.WARNING, logging.INFO, logging.DEBUG):
+        root.setLevel(level)
+        transport = make_transport()
+
+        start = time.time()
+        run(transport, args.count)
+        elapsed = time.time() - start
+
+        profile = cProfile.Profile()
+        profile.runcall(run, make_transport(), 1000)
+        formats = count_format_calls(pstats.Stats(profile)) / 1000.0
+
+        print(
+            "{:>8} {:>12.2f} {:>18.1f}".format(
+                logging.getLevelName(level), elapsed * 1e6 / args.count, formats
+            )
+        )
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,127 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+"""Measure the memory blocks held per in-flight telemetry message in the IoTHub MQTT pipeline,
+and the time per message.
+
+The real pipeline is used, with the MQTT transport replaced by a stub which holds each publish
+until it is acknowledged.  No network connection is needed.
+"""
+import argparse
+import gc
+import time
+import tracemalloc
+from azure.iot.device import Message
+from azure.iot.device.common.auth import sastoken as st
+from azure.iot.device.common.evented_callback import EventedCallback
+from azure.iot.device.common.pipeline import pipeline_stages_mqtt
+from azure.iot.device.iothub.pipeline import IoTHubPipelineConfig, MQTTPipeline
+
+
+class StubTransport(object):
+    def __init__(self, **kwargs):
+        self.on_mqtt_connected_handler = None
+        self.on_mqtt_disconnected_handler = None
+        self.on_mqtt_connection_failure_handler = None
+        self.on_mqtt_message_received_handler = None
+        self.pending_callbacks = []
+
+    def connect(self, password=None):
+        self.on_mqtt_connected_handler()
+
+    def disconnect(self, clear_pending=False):
+        self.on_mqtt_disconnected_handler(None)
+
+    def shutdown(self):
+        pass
+
+    def publish(self, topic, payload, qos=1, callback=None):
+        self.pending_callbacks.append(callback)
+
+    def ack_all(self):
+        callbacks, self.pending_callbacks = self.pending_callbacks, []
+        for callback in callbacks:
+            callback()
+
+
+def make_pipeline():
+    sastoken = st.NonRenewableSasToken(
+        "SharedAccessSignature sr=bench.azure-devices.net%2Fdevices%2Fbench&sig=c2ln&se={}".format(
+            int(time.time()) + 3600
+        )
+    )
+    config = IoTHubPipelineConfig(
+        hostname="bench.azure-devices.net", device_id="bench", sastoken=sastoken
+    )
+    pipeline = MQTTPipeline(config)
+    connected = EventedCallback()
+    pipeline.connect(callback=connected)
+    connected.wait_for_completion()
+    return pipeline
+
+
+def get_transport(pipeline):
+    stage = pipeline._pipeline
+    while not isinstance(stage, pipeline_stages_mqtt.MQTTTransportStage):
+        stage = stage.next
+    return stage.transport
+
+
+def send(pipeline, transport, count):
+    done = [EventedCallback() for _ in range(count)]
+    for callback in done:
+        pipeline.send_message(Message("x" * 64), callback=callback)
+    # Wait for all the sends to reach the transport
+    while len(transport.pending_callbacks) < count:
+        time.sleep(0.001)
+    return done
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--count", type=int, default=2000, help="messages per measurement")
+    args = parser.parse_args()
+
+    pipeline_stages_mqtt.MQTTTransport = StubTransport
+    pipeline = make_pipeline()
+    transport = get_transport(pipeline)
+
+    # Warm up, so that caches and executors are already created
+    send(pipeline, transport, 100)
+    transport.ack_all()
+
+    gc.collect()
+    tracemalloc.start()
+    before = tracemalloc.take_snapshot()
+    done = send(pipeline, transport, args.count)
+    gc.collect()
+    after = tracemalloc.take_snapshot()
+    tracemalloc.stop()
+    stats = after.compare_to(before, "filename")
+    blocks = sum(stat.count_diff for stat in stats)
+    size = sum(stat.size_diff for stat in stats)
+    transport.ack_all()
+    for callback in done:
+        callback.wait_for_completion()
+
+    start = time.time()
+    for _ in range(10):
+        done = send(pipeline, transport, args.count // 10)
+        transport.ack_all()
+        for callback in done:
+            callback.wait_for_completion()
+    elapsed = time.time() - start
+
+    print("blocks per in-flight message: {:.1f}".format(float(blocks) / args.count))
+    print("bytes per in-flight message:  {:.0f}".format(float(size) / args.count))
+    print("us per message:               {:.1f}".format(elapsed * 1e6 / args.count))
+
+    shutdown = EventedCallback()
+    pipeline.shutdown(callback=shutdown)
+    shutdown.wait_for_completion()
+
+
+if __name__ == "__main__":
+    main()
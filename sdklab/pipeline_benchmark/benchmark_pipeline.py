@@ -0,0 +1,458 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+"""Measure the overhead of the IoTHub MQTT pipeline, apart from the network.
+
+The real pipeline is used, with the MQTT transport replaced by an in-memory fake which
+acknowledges publishes and subscribes, and answers twin requests, from its own thread (as the
+paho network loop does), after a configurable latency and with configurable loss.
+
+For each of the send, receive, twin and method flows it reports:
+* the wall time per op
+* the number of handoffs to the pipeline and callback threads per op
+* the memory blocks (and bytes) allocated by the SDK for each op in flight
+* the time per op spent in each stage (in _run_op and _handle_pipeline_event, excluding the
+  stages below), measured in a separate, instrumented run
+"""
+
+import argparse
+import collections
+import gc
+import heapq
+import itertools
+import random
+import threading
+import time
+import tracemalloc
+from azure.iot.device import Message, MethodResponse
+from azure.iot.device.common.auth import sastoken as st
+from azure.iot.device.common.evented_callback import EventedCallback
+from azure.iot.device.common.pipeline import pipeline_ops_base, pipeline_stages_mqtt
+from azure.iot.device.common.pipeline import pipeline_thread
+from azure.iot.device.iothub.pipeline import IoTHubPipelineConfig, MQTTPipeline, constant
+
+DEVICE_ID = "bench"
+HOSTNAME = "bench.azure-devices.net"
+C2D_TOPIC = "devices/bench/messages/devicebound/%24.mid={}&%24.to=%2Fdevices%2Fbench%2Fmessages%2Fdevicebound"
+METHOD_TOPIC = "$iothub/methods/POST/bench/?$rid={}"
+TWIN_RESPONSE_TOPIC = "$iothub/twin/res/200/?$rid={}"
+TWIN_PAYLOAD = b'{"desired": {"$version": 1, "interval": 5}, "reported": {"$version": 1}}'
+
+perf_counter_ns = getattr(time, "perf_counter_ns", lambda: int(time.perf_counter() * 1e9))
+
+
+class FakeTransport(object):
+    """In-memory stand-in for MQTTTransport.
+
+    Everything the broker would send back (CONNACK, PUBACK, SUBACK, twin responses, and messages
+    injected with inject()) is delivered by a "network" thread after `latency` seconds. With
+    probability `loss`, a delivery is lost, and arrives after a further `retransmit_delay`, as a
+    QoS 1 retransmission would. While the transport is held, deliveries are queued up until it is
+    released.
+    """
+
+    latency = 0.0
+    loss = 0.0
+    retransmit_delay = 0.05
+
+    def __init__(self, **kwargs):
+        self.on_mqtt_connected_handler = None
+        self.on_mqtt_disconnected_handler = None
+        self.on_mqtt_connection_failure_handler = None
+        self.on_mqtt_message_received_handler = None
+        self.retransmits = 0
+        self._random = random.Random(0)
+        self._queue = []
+        self._held = []
+        self._holding = False
+        self._sequence = itertools.count()
+        self._condition = threading.Condition()
+        self._running = True
+        self._thread = threading.Thread(target=self._run, name="fake-network")
+        self._thread.daemon = True
+        self._thread.start()
+
+    def _deliver(self, fn, *args, **kwargs):
+        delay = self.latency
+        if self.loss and self._random.random() < self.loss:
+            self.retransmits += 1
+            delay += self.retransmit_delay
+        entry = (time.time() + delay, next(self._sequence), fn, args)
+        with self._condition:
+            if self._holding and not kwargs.get("bypass_hold"):
+                self._held.append(entry)
+            else:
+                heapq.heappush(self._queue, entry)
+                self._condition.notify()
+
+    def _run(self):
+        while True:
+            with self._condition:
+                while self._running:
+                    timeout = None
+                    if self._queue:
+                        timeout = self._queue[0][0] - time.time()
+                        if timeout <= 0:
+                            break
+                    self._condition.wait(timeout)
+                if not self._running:
+                    return
+                _, _, fn, args = heapq.heappop(self._queue)
+            fn(*args)
+
+    @property
+    def held_count(self):
+        with self._condition:
+            return len(self._held)
+
+    def hold(self):
+        with self._condition:
+            self._holding = True
+
+    def release(self):
+        with self._condition:
+            self._holding = False
+            for entry in self._held:
+                heapq.heappush(self._queue, entry)
+            self._held = []
+            self._condition.notify()
+
+    def inject(self, topic, payload, bypass_hold=False):
+        self._deliver(
+            self.on_mqtt_message_received_handler, topic, payload, bypass_hold=bypass_hold
+        )
+
+    def connect(self, password=None):
+        self._deliver(self.on_mqtt_connected_handler)
+
+    def disconnect(self, clear_pending=False):
+        self._deliver(self.on_mqtt_disconnected_handler, None)
+
+    def shutdown(self):
+        with self._condition:
+            self._running = False
+            self._condition.notify()
+
+    def publish(self, topic, payload, qos=1, callback=None):
+        self._deliver(callback)
+        if topic.startswith("$iothub/twin/GET/"):
+            request_id = topic.split("$rid=")[1].split("&")[0]
+            self.inject(TWIN_RESPONSE_TOPIC.format(request_id), TWIN_PAYLOAD)
+
+    def subscribe(self, topic, qos=1, callback=None):
+        self._deliver(callback)
+
+    def unsubscribe(self, topic, callback=None):
+        self._deliver(callback)
+
+
+class Completions(object):
+    """Thread safe count of completed ops"""
+
+    def __init__(self):
+        self._lock = threading.Lock()
+        self.count = 0
+
+    def __call__(self, *args, **kwargs):
+        with self._lock:
+            self.count += 1
+
+    def wait_for(self, count, timeout=60):
+        deadline = time.time() + timeout
+        while self.count < count:
+            if time.time() > deadline:
+                raise RuntimeError("Only {} of {} ops completed".format(self.count, count))
+            time.sleep(0.0005)
+
+
+class SendFlow(object):
+    """Telemetry: send_message(), completed by the PUBACK"""
+
+    name = "send"
+    held_per_op = 1
+
+    def __init__(self, pipeline, transport, payload_size):
+        self.pipeline = pipeline
+        self.payload = "x" * payload_size
+        self.completions = Completions()
+
+    def start(self, i):
+        self.pipeline.send_message(Message(self.payload), callback=self.completions)
+
+
+class ReceiveFlow(object):
+    """C2D message: from the transport to the on_c2d_message_received handler"""
+
+    name = "receive"
+    held_per_op = 0
+
+    def __init__(self, pipeline, transport, payload_size):
+        self.transport = transport
+        self.payload = b"x" * payload_size
+        self.completions = Completions()
+        self.received = []
+        pipeline.on_c2d_message_received = self.on_message
+
+    def on_message(self, message):
+        self.received.append(message)
+        self.completions()
+
+    def start(self, i):
+        self.transport.inject(C2D_TOPIC.format(i), self.payload, bypass_hold=True)
+
+
+class TwinFlow(object):
+    """Twin: get_twin(), completed by the twin response"""
+
+    name = "twin"
+    held_per_op = 2
+
+    def __init__(self, pipeline, transport, payload_size):
+        self.pipeline = pipeline
+        self.completions = Completions()
+
+    def start(self, i):
+        self.pipeline.get_twin(callback=self.completions)
+
+
+class MethodFlow(object):
+    """Method: from the transport to the on_method_request_received handler, which sends the
+    response, completed by the PUBACK of the response"""
+
+    name = "method"
+    held_per_op = 1
+
+    def __init__(self, pipeline, transport, payload_size):
+        self.pipeline = pipeline
+        self.transport = transport
+        self.payload = ('{"data": "' + "x" * payload_size + '"}').encode("utf-8")
+        self.completions = Completions()
+        pipeline.on_method_request_received = self.on_method_request
+
+    def on_method_request(self, method_request):
+        response = MethodResponse.create_from_method_request(method_request, 200, {"ok": True})
+        self.pipeline.send_method_response(response, callback=self.completions)
+
+    def start(self, i):
+        self.transport.inject(METHOD_TOPIC.format(i), self.payload, bypass_hold=True)
+
+
+FLOWS = collections.OrderedDict(
+    (flow.name, flow) for flow in (SendFlow, ReceiveFlow, TwinFlow, MethodFlow)
+)
+
+
+class StageProfiler(object):
+    """Accumulates the time spent in each stage, excluding the time spent in the stages (and
+    op completions) it calls into"""
+
+    def __init__(self, pipeline_root):
+        self.self_time = collections.OrderedDict()
+        self._local = threading.local()
+        self._wrapped = []
+        stage = pipeline_root
+        while stage:
+            self.self_time[stage.name] = 0
+            for method_name in ("_run_op", "_handle_pipeline_event"):
+                setattr(stage, method_name, self._wrap(stage.name, getattr(stage, method_name)))
+                self._wrapped.append((stage, method_name))
+            stage = stage.next
+        self.self_time["(op completion callbacks)"] = 0
+        self._original_complete = pipeline_ops_base.PipelineOperation.complete
+        wrapped_complete = self._wrap("(op completion callbacks)", self._original_complete)
+        pipeline_ops_base.PipelineOperation.complete = lambda op, *args, **kwargs: wrapped_complete(
+            op, *args, **kwargs
+        )
+
+    def _wrap(self, name, fn):
+        def wrapper(*args, **kwargs):
+            stack = getattr(self._local, "stack", None)
+            if stack is None:
+                stack = self._local.stack = []
+            stack.append(0)
+            start = perf_counter_ns()
+            try:
+                return fn(*args, **kwargs)
+            finally:
+                elapsed = perf_counter_ns() - start
+                self.self_time[name] += elapsed - stack.pop()
+                if stack:
+                    stack[-1] += elapsed
+
+        return wrapper
+
+    def remove(self):
+        for stage, method_name in self._wrapped:
+            delattr(stage, method_name)
+        pipeline_ops_base.PipelineOperation.complete = self._original_complete
+
+
+class HandoffCounter(object):
+    """Counts the functions submitted to the pipeline and callback threads"""
+
+    def __init__(self):
+        self.counts = collections.Counter()
+        self._originals = {}
+        for thread_name, executor in pipeline_thread._executors.items():
+            self._originals[thread_name] = executor.submit
+            executor.submit = self._wrap(thread_name, executor.submit)
+
+    def _wrap(self, thread_name, submit):
+        def wrapper(*args, **kwargs):
+            self.counts[thread_name] += 1
+            return submit(*args, **kwargs)
+
+        return wrapper
+
+    def remove(self):
+        for thread_name, submit in self._originals.items():
+            pipeline_thread._executors[thread_name].submit = submit
+
+
+def make_pipeline():
+    sastoken = st.NonRenewableSasToken(
+        "SharedAccessSignature sr=bench.azure-devices.net%2Fdevices%2Fbench&sig=c2ln&se={}".format(
+            int(time.time()) + 3600
+        )
+    )
+    config = IoTHubPipelineConfig(hostname=HOSTNAME, device_id=DEVICE_ID, sastoken=sastoken)
+    pipeline = MQTTPipeline(config)
+    connected = EventedCallback()
+    pipeline.connect(callback=connected)
+    connected.wait_for_completion()
+    for feature in (constant.C2D_MSG, constant.METHODS, constant.TWIN):
+        enabled = EventedCallback()
+        pipeline.enable_feature(feature, callback=enabled)
+        enabled.wait_for_completion()
+    return pipeline
+
+
+def get_transport(pipeline):
+    stage = pipeline._pipeline
+    while not isinstance(stage, pipeline_stages_mqtt.MQTTTransportStage):
+        stage = stage.next
+    return stage.transport
+
+
+def run(flow, count):
+    target = flow.completions.count + count
+    for i in range(count):
+        flow.start(i)
+    flow.completions.wait_for(target)
+
+
+def wait_until(condition, timeout=60):
+    deadline = time.time() + timeout
+    while not condition():
+        if time.time() > deadline:
+            raise RuntimeError("Timed out")
+        time.sleep(0.0005)
+
+
+def measure_allocations(flow, transport, count):
+    """Memory blocks and bytes allocated by the SDK for each op while it is in flight. Anything
+    allocated by this script (including the fake transport) is excluded."""
+    exclude = [tracemalloc.Filter(False, __file__), tracemalloc.Filter(False, tracemalloc.__file__)]
+    target = flow.completions.count + count
+    gc.collect()
+    tracemalloc.start()
+    before = tracemalloc.take_snapshot().filter_traces(exclude)
+    transport.hold()
+    for i in range(count):
+        flow.start(i)
+    if flow.held_per_op:
+        wait_until(lambda: transport.held_count >= flow.held_per_op * count)
+    else:
+        flow.completions.wait_for(target)
+    gc.collect()
+    after = tracemalloc.take_snapshot().filter_traces(exclude)
+    tracemalloc.stop()
+    transport.release()
+    flow.completions.wait_for(target)
+    stats = after.compare_to(before, "filename")
+    blocks = sum(stat.count_diff for stat in stats)
+    size = sum(stat.size_diff for stat in stats)
+    return float(blocks) / count, float(size) / count
+
+
+def benchmark(flow_class, pipeline, transport, args):
+    flow = flow_class(pipeline, transport, args.payload_size)
+    # Warm up, so that caches and executors are already created
+    run(flow, 100)
+
+    handoffs = HandoffCounter()
+    start = time.time()
+    run(flow, args.count)
+    elapsed = time.time() - start
+    handoffs.remove()
+
+    blocks, size = measure_allocations(flow, transport, args.count)
+    if hasattr(flow, "received"):
+        del flow.received[:]
+
+    profiler = StageProfiler(pipeline._pipeline)
+    run(flow, args.count)
+    profiler.remove()
+
+    print("== {} ({} ops)".format(flow.name, args.count))
+    print("wall time per op:        {:.1f} us".format(elapsed * 1e6 / args.count))
+    print(
+        "thread handoffs per op:  {}".format(
+            ", ".join(
+                "{} {:.2f}".format(name, float(handoffs.counts[name]) / args.count)
+                for name in sorted(pipeline_thread._executors)
+            )
+        )
+    )
+    print("memory blocks per op:    {:.1f} ({:.0f} bytes)".format(blocks, size))
+    print("time per op by stage (instrumented):")
+    for name, total in profiler.self_time.items():
+        print("    {:<40} {:>10,.0f} ns".format(name, float(total) / args.count))
+    print("")
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter
+    )
+    parser.add_argument("--count", type=int, default=2000, help="ops per measurement")
+    parser.add_argument(
+        "--flow", action="append", choices=list(FLOWS), help="flow to run (default: all)"
+    )
+    parser.add_argument(
+        "--latency", type=float, default=0.0, help="seconds before each delivery from the fake"
+    )
+    parser.add_argument(
+        "--loss", type=float, default=0.0, help="fraction of deliveries which are retransmitted"
+    )
+    parser.add_argument(
+        "--retransmit-delay", type=float, default=0.05, help="extra seconds for a retransmission"
+    )
+    parser.add_argument("--payload-size", type=int, default=64, help="bytes per payload")
+    args = parser.parse_args()
+
+    FakeTransport.latency = args.latency
+    FakeTransport.loss = args.loss
+    FakeTransport.retransmit_delay = args.retransmit_delay
+    pipeline_stages_mqtt.MQTTTransport = FakeTransport
+
+    pipeline = make_pipeline()
+    transport = get_transport(pipeline)
+    print(
+        "latency {}s, loss {:.1%}, retransmit delay {}s\n".format(
+            args.latency, args.loss, args.retransmit_delay
+        )
+    )
+    for name in args.flow or list(FLOWS):
+        benchmark(FLOWS[name], pipeline, transport, args)
+    print("retransmitted deliveries: {}".format(transport.retransmits))
+
+    shutdown = EventedCallback()
+    pipeline.shutdown(callback=shutdown)
+    shutdown.wait_for_completion()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,83 @@
+# -------------------------------------------------------------------------
+# Copyright (c) Microsoft Corporation. All rights reserved.
+# Licensed under the MIT License. See License.txt in the project root for
+# license information.
+# --------------------------------------------------------------------------
+"""Measure the startup time and memory used by the TLS contexts of many clients.
+
+Each IoTHub client creates an MQTT transport and an HTTP transport when it is created. This
+script creates the transports for the given number of clients, with the same TLS settings, and
+reports the time taken and the growth in resident memory. No network connection is made.
+"""
+
+import argparse
+import resource
+import sys
+import time
+from azure.iot.device.common import ssl_context_cache
+from azure.iot.device.common.http_transport import HTTPTransport
+from azure.iot.device.common.mqtt_transport import MQTTTransport
+
+
+def rss_kb():
+    # Current resident set size, from /proc where available
+    try:
+        with open("/proc/self/status") as f:
+            for line in f:
+                if line.startswith("VmRSS:"):
+                    return int(line.split()[1])
+    except IOError:
+        pass
+    return resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--clients", type=int, default=1000)
+    parser.add_argument(
+        "--no-cache",
+        action="store_true",
+        help="create a new SSLContext for every transport, as before the cache was added",
+    )
+    args = parser.parse_args()
+
+    hostname = "bench.azure-devices.net"
+    transports = []
+    rss_before = rss_kb()
+    start = time.time()
+    for i in range(args.clients):
+        if args.no_cache:
+            ssl_context_cache.clear()
+        device_id = "device{}".format(i)
+        transports.append(
+            MQTTTransport(
+                client_id=device_id,
+                hostname=hostname,
+                username="{}/{}/?api-version=2019-10-01".format(hostname, device_id),
+            )
+        )
+        if args.no_cache:
+            ssl_context_cache.clear()
+        transports.append(HTTPTransport(hostname=hostname))
+    elapsed = time.time() - start
+    rss_after = rss_kb()
+
+    contexts = set()
+    for transport in transports:
+        if isinstance(transport, HTTPTransport):
+            contexts.add(id(transport._ssl_context))
+        else:
+            contexts.add(id(transport._mqtt_client._ssl_context))
+    print("clients:              {}".format(args.clients))
+    print("distinct SSLContexts: {}".format(len(contexts)))
+    print(
+        "startup time:         {:.2f} s ({:.2f} ms per client)".format(
+            elapsed, elapsed * 1000 / args.clients
+        )
+    )
+    print("RSS growth:           {:.1f} MB".format((rss_after - rss_before) / 1024.0))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())